@@ -0,0 +1,247 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    bytevector.c
+
+    Bytevector Data Type.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The BYTEVECTOR package implements an R7RS-style bytevector, a counted
+    array of bytes for binary data (e.g., network protocol messages).  The
+    "scheme.c" core has no such type; binary data used to be carried in
+    counted strings, which Scheme code could only pick apart a character at
+    a time with STRING-REF and CHAR->INTEGER.
+
+    A bytevector is a cell of its own type, T_BYTEVECTOR, whose CAR points
+    to a counted string cell holding the bytes.  Unlike an opaque cell (see
+    "opaque.c"), the bytevector cell is *not* marked as an atom, so the
+    garbage collector marks the string through the CAR and, when the
+    bytevector is dropped, reclaims the string and frees its bytes just as
+    it would any other string.  No table or finalizer is needed.  The string
+    is never handed to Scheme code, so STRING? is never true of a bytevector
+    or its contents.
+
+        pointer  bytes = mk_bytevector (sc, NULL, 1024) ;
+        ...
+        if (is_bytevector (argument)) {
+            memcpy (buffer, bytevector_data (argument),
+                    bytevector_length (argument)) ;
+            ...
+        }
+
+    Since the interpreter doesn't know the type, DISPLAY prints a bytevector
+    as "#<ERROR>"; EQV? compares bytevectors by identity.  The Scheme-level
+    functions are in "funcs_bvr.c".
+
+
+Public Procedures:
+
+    bytevector_shrink() - shortens a bytevector in place.
+    is_bytevector() - checks if a Scheme cell is a bytevector.
+    mk_bytevector() - makes a bytevector cell.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <string.h>			/* C Library string functions. */
+#include  "tsion.h"			/* TinyScheme I/O Network functions. */
+#include  "scheme-private.h"		/* TinyScheme internals. */
+
+/*!*****************************************************************************
+
+Procedure:
+
+    bytevector_shrink ()
+
+    Shorten a Bytevector in Place.
+
+
+Purpose:
+
+    Function bytevector_shrink() reduces the length of a bytevector; the
+    first LENGTH bytes are kept.  Functions that read data directly into a
+    bytevector allocated for the maximum length use bytevector_shrink() to
+    cut it down to the number of bytes actually read.  The storage is
+    shrunk as described for string_shrink() in "scm_util.c".
+
+
+    Invocation:
+
+        status = bytevector_shrink (sc, cell, length) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <cell>		- I
+            is the bytevector.
+        <length>	- I
+            is the new length of the bytevector, which must not be greater
+            than its current length.
+        <status>	- O
+            returns the status of shortening the bytevector, zero if there
+            were no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  bytevector_shrink (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  cell,
+        size_t  length)
+#    else
+        sc, cell, length)
+
+        scheme  *sc ;
+        pointer  cell ;
+        size_t  length ;
+#    endif
+
+{
+
+    if (!is_bytevector (cell)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(bytevector_shrink) Not a bytevector.\n") ;
+        return (errno) ;
+    }
+
+    return (string_shrink (sc, car (cell), length)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    is_bytevector ()
+
+    Check if a Scheme Cell is a Bytevector.
+
+
+Purpose:
+
+    Function is_bytevector() returns true if a Scheme cell is a bytevector
+    and false otherwise.
+
+
+    Invocation:
+
+        flag = is_bytevector (cell) ;
+
+    where
+
+        <cell>		- I
+            is a Scheme cell.
+        <flag>		- O
+            returns true if the cell is a bytevector and false otherwise.
+
+*******************************************************************************/
+
+
+bool  is_bytevector (
+
+#    if PROTOTYPES
+        pointer  cell)
+#    else
+        cell)
+
+        pointer  cell ;
+#    endif
+
+{
+
+    return ((typeflag (cell) & T_MASKTYPE) == T_BYTEVECTOR) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    mk_bytevector ()
+
+    Make a Bytevector Cell.
+
+
+Purpose:
+
+    Function mk_bytevector() creates a new bytevector of a given length and,
+    optionally, copies data into it.
+
+    TinyScheme's get_cell() function is declared "static" in "scheme.c", so
+    mk_bytevector() allocates the string with mk_ustring() and then conses
+    it onto the empty list - which keeps the string visible to the garbage
+    collector while the second cell is allocated - and converts the pair
+    into a bytevector cell.
+
+    As with any new cell, the bytevector must be put somewhere visible to
+    the garbage collector before the caller allocates any more cells.
+
+
+    Invocation:
+
+        cell = mk_bytevector (sc, data, length) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <data>		- I
+            is the data to be copied into the bytevector; if this argument
+            is NULL, the bytes are left uninitialized for the caller to fill.
+        <length>	- I
+            is the number of bytes in the bytevector.
+        <cell>		- O
+            returns a new bytevector; NULL is returned if the bytevector
+            could not be allocated.
+
+*******************************************************************************/
+
+
+pointer  mk_bytevector (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        const  void  *data,
+        size_t  length)
+#    else
+        sc, data, length)
+
+        scheme  *sc ;
+        void  *data ;
+        size_t  length ;
+#    endif
+
+{    /* Local variables. */
+    pointer  cell, string ;
+
+
+
+    string = mk_ustring (sc, length) ;
+    if (string == NULL) {
+        LGE "(mk_bytevector) Error allocating %lu-byte bytevector.\nmk_ustring: ",
+            (unsigned long) length) ;
+        return (NULL) ;
+    }
+
+    if ((data != NULL) && (length > 0))  memcpy (strvalue (string), data, length) ;
+
+    cell = cons (sc, string, sc->NIL) ;
+    typeflag (cell) = T_BYTEVECTOR ;
+
+    return (cell) ;
+
+}
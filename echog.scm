@@ -0,0 +1,64 @@
+; $Id$
+;*******************************************************************************
+;
+;    ECHOG - is the ECHOD echo server rewritten with green threads (see
+;        GREEN.SCM).  Clients connect to the server on port 10234, and any
+;        data a client sends is echoed back to the client.
+;
+;        Rather than registering callbacks, ECHOG runs one coroutine that
+;        accepts connections and a coroutine per client that reads and
+;        echoes input.  Each is written as a simple loop; WAIT-READABLE
+;        parks the coroutine until its socket has input, letting the other
+;        coroutines run in the meantime.
+;
+;        Invocation:
+;
+;            % tsion echog.scm
+;
+;*******************************************************************************
+
+
+(load "green.scm")
+
+
+;*******************************************************************************
+;    serve-client - echoes a client's input until the client closes its
+;        connection.
+;*******************************************************************************
+
+(define (serve-client client)
+    (wait-readable (tcp-fd client))
+    (let ((buffer (tcp-read client -1024)))
+        (if buffer
+            (begin
+                (tcp-write client buffer)
+                (serve-client client))
+            (tcp-destroy client))))
+
+
+;*******************************************************************************
+;    accept-clients - accepts connection requests and spawns a coroutine to
+;        serve each new client.
+;*******************************************************************************
+
+(define (accept-clients listener)
+    (wait-readable (tcp-fd listener))
+    (let ((client (tcp-answer listener)))
+        (if client
+            (spawn (lambda () (serve-client client)))))
+    (accept-clients listener))
+
+
+;*******************************************************************************
+;    Main Loop.
+;*******************************************************************************
+
+(define listener (tcp-listen 10234))
+
+(green-init (iox-create))
+
+(spawn (lambda () (accept-clients listener)))
+
+(display "Monitoring ...\n")
+
+(green-run)
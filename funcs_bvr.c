@@ -0,0 +1,2471 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    funcs_bvr.c
+
+    Bytevector Functions.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The FUNCS_BVR package defines R7RS-style bytevectors (see "bytevector.c")
+    for handling binary data, such as the messages of a binary network
+    protocol, without going through the string functions a character at a
+    time.  TCP-READ and LFN-READ return the data read as a bytevector when
+    asked to, and TCP-WRITE and LFN-WRITE accept bytevectors as well as
+    strings.
+
+        (define header (tcp-read connection 8 -1 #t))
+        (let ((type (bytevector-u16-ref header 0))	; Big-endian.
+              (length (bytevector-u32-ref header 2 'big))
+              (flags (bytevector-u16-ref header 6 'little)))
+          ...)
+
+    R7RS functions:
+
+        (bytevector <byte> ...)			=> <bytevector>
+        (bytevector? <object>)			=> <flag>
+        (bytevector-append <bytevector> ...)	=> <bytevector>
+        (bytevector-copy <bytevector>
+                         [<start> [<end>]])	=> <bytevector>
+        (bytevector-copy! <to> <at> <from>
+                          [<start> [<end>]])	=> <status>   (#t|#f)
+        (bytevector-length <bytevector>)	=> <length>
+        (bytevector-u8-ref <bytevector> <k>)	=> <byte>
+        (bytevector-u8-set! <bytevector> <k>
+                            <byte>)		=> <status>   (#t|#f)
+        (make-bytevector <length> [<byte>])	=> <bytevector>
+        (string->utf8 <string>
+                      [<start> [<end>]])	=> <bytevector>
+        (utf8->string <bytevector>
+                      [<start> [<end>]])	=> <string>
+
+    R6RS-style functions for multi-byte fields, where <endianness> is the
+    symbol BIG or LITTLE:
+
+        (bytevector-fill! <bytevector> <byte>
+                          [<start> [<end>]])	=> <status>   (#t|#f)
+        (bytevector-ieee-double-ref <bytevector> <k>
+                                    [<endianness>])
+						=> <real>
+        (bytevector-ieee-double-set! <bytevector> <k> <real>
+                                     [<endianness>])
+						=> <status>   (#t|#f)
+        (bytevector-ieee-single-ref <bytevector> <k>
+                                    [<endianness>])
+						=> <real>
+        (bytevector-ieee-single-set! <bytevector> <k> <real>
+                                     [<endianness>])
+						=> <status>   (#t|#f)
+        (bytevector-sint-ref <bytevector> <k>
+                             <endianness> <size>)
+						=> <integer>
+        (bytevector-sint-set! <bytevector> <k> <integer>
+                              <endianness> <size>)
+						=> <status>   (#t|#f)
+        (bytevector-uint-ref <bytevector> <k>
+                             <endianness> <size>)
+						=> <integer>
+        (bytevector-uint-set! <bytevector> <k> <integer>
+                              <endianness> <size>)
+						=> <status>   (#t|#f)
+
+    and, written in Scheme on top of the functions above, the fixed-size
+    accessors BYTEVECTOR-{S8,U8,S16,U16,S32,U32,S64,U64}-{REF,SET!} and
+    BYTEVECTOR-{F32,F64}-{REF,SET!}.  The multi-byte accessors take an
+    optional <endianness> after the offset (and value), which defaults to
+    BIG, network byte order.
+
+    Offsets are byte offsets and need not be aligned.  An index or range
+    outside the bytevector, a byte outside 0..255, or a value that doesn't
+    fit in the field is rejected and #f is returned.  An unsigned value too
+    large for a Scheme integer (e.g., a 64-bit field with its top bit set)
+    is returned as a real, which may lose precision.
+
+
+Public Procedures:
+
+    addFuncsBVR() - registers the functions with the Scheme intepreter.
+
+Private Procedures:
+
+    func_BYTEVECTOR() - implements the BYTEVECTOR function.
+    func_BYTEVECTORp() - implements the BYTEVECTOR? function.
+    func_BYTEVECTOR_APPEND() - implements the BYTEVECTOR-APPEND function.
+    func_BYTEVECTOR_COPY() - implements the BYTEVECTOR-COPY function.
+    func_BYTEVECTOR_COPYx() - implements the BYTEVECTOR-COPY! function.
+    func_BYTEVECTOR_FILLx() - implements the BYTEVECTOR-FILL! function.
+    func_BYTEVECTOR_IEEE_DOUBLE_REF() - implements the
+        BYTEVECTOR-IEEE-DOUBLE-REF function.
+    func_BYTEVECTOR_IEEE_DOUBLE_SETx() - implements the
+        BYTEVECTOR-IEEE-DOUBLE-SET! function.
+    func_BYTEVECTOR_IEEE_SINGLE_REF() - implements the
+        BYTEVECTOR-IEEE-SINGLE-REF function.
+    func_BYTEVECTOR_IEEE_SINGLE_SETx() - implements the
+        BYTEVECTOR-IEEE-SINGLE-SET! function.
+    func_BYTEVECTOR_LENGTH() - implements the BYTEVECTOR-LENGTH function.
+    func_BYTEVECTOR_SINT_REF() - implements the BYTEVECTOR-SINT-REF function.
+    func_BYTEVECTOR_U8_REF() - implements the BYTEVECTOR-U8-REF function.
+    func_BYTEVECTOR_U8_SETx() - implements the BYTEVECTOR-U8-SET! function.
+    func_BYTEVECTOR_UINT_REF() - implements the BYTEVECTOR-UINT-REF function.
+    func_BYTEVECTOR_UINT_SETx() - implements the BYTEVECTOR-UINT-SET! and
+        BYTEVECTOR-SINT-SET! functions.
+    func_MAKE_BYTEVECTOR() - implements the MAKE-BYTEVECTOR function.
+    func_STRING_TO_UTF8() - implements the STRING->UTF8 function.
+    func_UTF8_TO_STRING() - implements the UTF8->STRING function.
+    bvrEndianness() - decodes an optional endianness argument.
+    bvrGet() - gets an unsigned integer from a bytevector.
+    bvrIndex() - decodes an index argument.
+    bvrIntegerRef() - gets a signed or unsigned integer field.
+    bvrPut() - puts an unsigned integer into a bytevector.
+    bvrRange() - decodes optional start and end arguments.
+    bvrRealRef() - gets a floating-point field.
+    bvrRealSet() - sets a floating-point field.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <limits.h>			/* Maximum/minimum value definitions. */
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <string.h>			/* C Library string functions. */
+#include  "tsion.h"			/* TinyScheme I/O Network functions. */
+
+
+/*******************************************************************************
+    Private functions.
+*******************************************************************************/
+
+static  pointer  func_BYTEVECTOR P_((scheme *sc, pointer args)) ;
+static  pointer  func_BYTEVECTORp P_((scheme *sc, pointer args)) ;
+static  pointer  func_BYTEVECTOR_APPEND P_((scheme *sc, pointer args)) ;
+static  pointer  func_BYTEVECTOR_COPY P_((scheme *sc, pointer args)) ;
+static  pointer  func_BYTEVECTOR_COPYx P_((scheme *sc, pointer args)) ;
+static  pointer  func_BYTEVECTOR_FILLx P_((scheme *sc, pointer args)) ;
+static  pointer  func_BYTEVECTOR_IEEE_DOUBLE_REF P_((scheme *sc,
+                                                     pointer args)) ;
+static  pointer  func_BYTEVECTOR_IEEE_DOUBLE_SETx P_((scheme *sc,
+                                                      pointer args)) ;
+static  pointer  func_BYTEVECTOR_IEEE_SINGLE_REF P_((scheme *sc,
+                                                     pointer args)) ;
+static  pointer  func_BYTEVECTOR_IEEE_SINGLE_SETx P_((scheme *sc,
+                                                      pointer args)) ;
+static  pointer  func_BYTEVECTOR_LENGTH P_((scheme *sc, pointer args)) ;
+static  pointer  func_BYTEVECTOR_SINT_REF P_((scheme *sc, pointer args)) ;
+static  pointer  func_BYTEVECTOR_U8_REF P_((scheme *sc, pointer args)) ;
+static  pointer  func_BYTEVECTOR_U8_SETx P_((scheme *sc, pointer args)) ;
+static  pointer  func_BYTEVECTOR_UINT_REF P_((scheme *sc, pointer args)) ;
+static  pointer  func_BYTEVECTOR_UINT_SETx P_((scheme *sc, pointer args)) ;
+static  pointer  func_MAKE_BYTEVECTOR P_((scheme *sc, pointer args)) ;
+static  pointer  func_STRING_TO_UTF8 P_((scheme *sc, pointer args)) ;
+static  pointer  func_UTF8_TO_STRING P_((scheme *sc, pointer args)) ;
+
+static  int  bvrEndianness P_((pointer args)) ;
+
+static  unsigned  long  long  bvrGet P_((const unsigned char *bytes,
+                                         size_t size,
+                                         bool big)) ;
+
+static  bool  bvrIndex P_((pointer argument,
+                           size_t limit,
+                           size_t *index)) ;
+
+static  pointer  bvrIntegerRef P_((scheme *sc,
+                                   pointer args,
+                                   bool isSigned,
+                                   const char *name)) ;
+
+static  void  bvrPut P_((unsigned char *bytes,
+                         size_t size,
+                         bool big,
+                         unsigned long long value)) ;
+
+static  bool  bvrRange P_((scheme *sc,
+                           pointer args,
+                           size_t length,
+                           size_t *start,
+                           size_t *end)) ;
+
+static  pointer  bvrRealRef P_((scheme *sc,
+                                pointer args,
+                                size_t size,
+                                const char *name)) ;
+
+static  pointer  bvrRealSet P_((scheme *sc,
+                                pointer args,
+                                size_t size,
+                                const char *name)) ;
+
+/*!*****************************************************************************
+
+Procedure:
+
+    addFuncsBVR ()
+
+    Register the BVR Functions with the Scheme Interpreter.
+
+
+Purpose:
+
+    Function addFuncsBVR() registers the BVR functions as foreign functions
+    with the Scheme interpreter.
+
+
+    Invocation:
+
+        addFuncsBVR (sc) ;
+
+    where
+
+        <sc>	- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+void  addFuncsBVR (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector"),
+                   mk_foreign_func (sc, func_BYTEVECTOR)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector?"),
+                   mk_foreign_func (sc, func_BYTEVECTORp)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-append"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_APPEND)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-copy"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_COPY)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-copy!"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_COPYx)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-fill!"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_FILLx)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-ieee-double-ref"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_IEEE_DOUBLE_REF)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-ieee-double-set!"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_IEEE_DOUBLE_SETx)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-ieee-single-ref"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_IEEE_SINGLE_REF)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-ieee-single-set!"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_IEEE_SINGLE_SETx)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-length"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_LENGTH)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-sint-ref"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_SINT_REF)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-sint-set!"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_UINT_SETx)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-u8-ref"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_U8_REF)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-u8-set!"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_U8_SETx)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-uint-ref"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_UINT_REF)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "bytevector-uint-set!"),
+                   mk_foreign_func (sc, func_BYTEVECTOR_UINT_SETx)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "make-bytevector"),
+                   mk_foreign_func (sc, func_MAKE_BYTEVECTOR)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "string->utf8"),
+                   mk_foreign_func (sc, func_STRING_TO_UTF8)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "utf8->string"),
+                   mk_foreign_func (sc, func_UTF8_TO_STRING)) ;
+
+/* The fixed-size accessors are written in Scheme; their endianness is
+   optional and defaults to big-endian (network byte order). */
+
+    scheme_load_string (sc,
+        "(define (bytevector-s8-ref b k)"
+        "  (bytevector-sint-ref b k 'big 1))"
+        "(define (bytevector-s8-set! b k n)"
+        "  (bytevector-sint-set! b k n 'big 1))"
+        "(define (bytevector-u16-ref b k . e)"
+        "  (bytevector-uint-ref b k (if (pair? e) (car e) 'big) 2))"
+        "(define (bytevector-u16-set! b k n . e)"
+        "  (bytevector-uint-set! b k n (if (pair? e) (car e) 'big) 2))"
+        "(define (bytevector-s16-ref b k . e)"
+        "  (bytevector-sint-ref b k (if (pair? e) (car e) 'big) 2))"
+        "(define (bytevector-s16-set! b k n . e)"
+        "  (bytevector-sint-set! b k n (if (pair? e) (car e) 'big) 2))"
+        "(define (bytevector-u32-ref b k . e)"
+        "  (bytevector-uint-ref b k (if (pair? e) (car e) 'big) 4))"
+        "(define (bytevector-u32-set! b k n . e)"
+        "  (bytevector-uint-set! b k n (if (pair? e) (car e) 'big) 4))"
+        "(define (bytevector-s32-ref b k . e)"
+        "  (bytevector-sint-ref b k (if (pair? e) (car e) 'big) 4))"
+        "(define (bytevector-s32-set! b k n . e)"
+        "  (bytevector-sint-set! b k n (if (pair? e) (car e) 'big) 4))"
+        "(define (bytevector-u64-ref b k . e)"
+        "  (bytevector-uint-ref b k (if (pair? e) (car e) 'big) 8))"
+        "(define (bytevector-u64-set! b k n . e)"
+        "  (bytevector-uint-set! b k n (if (pair? e) (car e) 'big) 8))"
+        "(define (bytevector-s64-ref b k . e)"
+        "  (bytevector-sint-ref b k (if (pair? e) (car e) 'big) 8))"
+        "(define (bytevector-s64-set! b k n . e)"
+        "  (bytevector-sint-set! b k n (if (pair? e) (car e) 'big) 8))"
+        "(define bytevector-f32-ref bytevector-ieee-single-ref)"
+        "(define bytevector-f32-set! bytevector-ieee-single-set!)"
+        "(define bytevector-f64-ref bytevector-ieee-double-ref)"
+        "(define bytevector-f64-set! bytevector-ieee-double-set!)") ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR ()
+
+    Make a Bytevector from Its Bytes.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR() makes a bytevector from a list of bytes.
+
+        (bytevector <byte> ...)
+
+        Return a new bytevector containing the <byte> arguments, each of
+        which must be an integer from 0 to 255.  #f is returned in the event
+        of an error.
+
+
+    Invocation:
+
+        bytes = func_BYTEVECTOR (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: zero or more bytes.
+        <bytes>		- O
+            returns the new bytevector; #f is returned in the event of an
+            error.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  argument, bytes ;
+    size_t  i, length ;
+
+
+
+/* Check the bytes before allocating the bytevector. */
+
+    for (argument = args, length = 0 ;
+         argument != sc->NIL ;
+         argument = cdr (argument), length++) {
+        if (!isInteger (car (argument)) ||
+            (ivalue (car (argument)) < 0) || (ivalue (car (argument)) > 255)) {
+            SET_ERRNO (EINVAL) ;
+            LGE "(func_BYTEVECTOR) Invalid byte specification: ") ;
+            return (sc->F) ;
+        }
+    }
+
+    bytes = mk_bytevector (sc, NULL, length) ;
+    if (bytes == NULL) {
+        LGE "(func_BYTEVECTOR) Error allocating %lu-byte bytevector.\nmk_bytevector: ",
+            (unsigned long) length) ;
+        return (sc->F) ;
+    }
+
+    for (i = 0 ;  args != sc->NIL ;  args = cdr (args))
+        bytevector_data (bytes)[i++] = (unsigned char) ivalue (car (args)) ;
+
+    return (bytes) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTORp ()
+
+    Check If an Object is a Bytevector.
+
+
+Purpose:
+
+    Function func_BYTEVECTORp() checks whether or not an object is a
+    bytevector.
+
+        (bytevector? <object>)
+
+        Return #t if <object> is a bytevector and #f otherwise.
+
+
+    Invocation:
+
+        flag = func_BYTEVECTORp (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: an object.
+        <flag>		- O
+            returns #t if the object is a bytevector and #f otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTORp (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return (is_bytevector (car (args)) ? sc->T : sc->F) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_APPEND ()
+
+    Concatenate Bytevectors.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_APPEND() concatenates bytevectors.
+
+        (bytevector-append <bytevector> ...)
+
+        Return a new bytevector containing the bytes of the <bytevector>
+        arguments, in order.  #f is returned in the event of an error.
+
+
+    Invocation:
+
+        bytes = func_BYTEVECTOR_APPEND (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: zero or more bytevectors.
+        <bytes>		- O
+            returns the new bytevector; #f is returned in the event of an
+            error.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_APPEND (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  argument, bytes ;
+    size_t  length, offset ;
+
+
+
+    for (argument = args, length = 0 ;
+         argument != sc->NIL ;
+         argument = cdr (argument)) {
+        if (!is_bytevector (car (argument))) {
+            SET_ERRNO (EINVAL) ;
+            LGE "(func_BYTEVECTOR_APPEND) Invalid bytevector specification: ") ;
+            return (sc->F) ;
+        }
+        length += bytevector_length (car (argument)) ;
+    }
+
+    bytes = mk_bytevector (sc, NULL, length) ;
+    if (bytes == NULL) {
+        LGE "(func_BYTEVECTOR_APPEND) Error allocating %lu-byte bytevector.\nmk_bytevector: ",
+            (unsigned long) length) ;
+        return (sc->F) ;
+    }
+
+    for (offset = 0 ;  args != sc->NIL ;  args = cdr (args)) {
+        length = bytevector_length (car (args)) ;
+        if (length > 0)
+            memcpy (bytevector_data (bytes) + offset,
+                    bytevector_data (car (args)), length) ;
+        offset += length ;
+    }
+
+    return (bytes) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_COPY ()
+
+    Copy a Slice of a Bytevector.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_COPY() copies all or part of a bytevector
+    into a new bytevector.
+
+        (bytevector-copy <bytevector> [<start> [<end>]])
+
+        Return a new bytevector containing the bytes of <bytevector> from
+        index <start> (default 0) up to, but not including, index <end>
+        (default the length of <bytevector>).  #f is returned in the event
+        of an error.
+
+
+    Invocation:
+
+        slice = func_BYTEVECTOR_COPY (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector and, optionally, the
+            start and end indices of the slice.
+        <slice>		- O
+            returns the new bytevector; #f is returned in the event of an
+            error.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_COPY (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  bytes, slice ;
+    size_t  end, start ;
+
+
+
+/* Get the argument(s). */
+
+    bytes = car (args) ;
+    if (!is_bytevector (bytes)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_COPY) Invalid bytevector specification: ") ;
+        return (sc->F) ;
+    }
+
+    if (!bvrRange (sc, cdr (args), bytevector_length (bytes), &start, &end)) {
+        LGE "(func_BYTEVECTOR_COPY) Invalid range specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Copy the slice. */
+
+    slice = mk_bytevector (sc, bytevector_data (bytes) + start, end - start) ;
+    if (slice == NULL) {
+        LGE "(func_BYTEVECTOR_COPY) Error allocating %lu-byte bytevector.\nmk_bytevector: ",
+            (unsigned long) (end - start)) ;
+        return (sc->F) ;
+    }
+
+    return (slice) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_COPYx ()
+
+    Copy Bytes from One Bytevector to Another.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_COPYx() copies bytes from one bytevector into
+    another.
+
+        (bytevector-copy! <to> <at> <from> [<start> [<end>]])
+
+        Copy the bytes of bytevector <from> from index <start> (default 0)
+        up to, but not including, index <end> (default the length of <from>)
+        into bytevector <to>, starting at index <at>.  The bytevectors may
+        be the same and the ranges may overlap.  #t is returned if the bytes
+        were copied and #f is returned if the destination is too short or
+        an argument is invalid.
+
+
+    Invocation:
+
+        status = func_BYTEVECTOR_COPYx (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the destination bytevector, the
+            index in the destination, the source bytevector, and, optionally,
+            the start and end indices of the bytes to copy.
+        <status>	- O
+            returns #t if the bytes were copied and #f otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_COPYx (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  from, to ;
+    size_t  at, end, start ;
+
+
+
+/* Get the argument(s). */
+
+    to = car (args) ;
+    from = caddr (args) ;
+    if (!is_bytevector (to) || !is_bytevector (from)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_COPYx) Invalid bytevector specification: ") ;
+        return (sc->F) ;
+    }
+
+    if (!bvrIndex (cadr (args), bytevector_length (to), &at)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_COPYx) Invalid index specification: ") ;
+        return (sc->F) ;
+    }
+
+    if (!bvrRange (sc, cdr (cddr (args)), bytevector_length (from),
+                   &start, &end) ||
+        ((end - start) > (bytevector_length (to) - at))) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_COPYx) Invalid range specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Copy the bytes. */
+
+    if (end > start)
+        memmove (bytevector_data (to) + at, bytevector_data (from) + start,
+                 end - start) ;
+
+    return (sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_FILLx ()
+
+    Fill a Bytevector.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_FILLx() stores a byte in all or part of a
+    bytevector.
+
+        (bytevector-fill! <bytevector> <byte> [<start> [<end>]])
+
+        Store <byte> in the elements of <bytevector> from index <start>
+        (default 0) up to, but not including, index <end> (default the
+        length of <bytevector>).  #t is returned if the bytevector was
+        filled and #f is returned if an argument is invalid.
+
+
+    Invocation:
+
+        status = func_BYTEVECTOR_FILLx (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, the byte, and,
+            optionally, the start and end indices of the range to fill.
+        <status>	- O
+            returns #t if the bytevector was filled and #f otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_FILLx (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  argument, bytes ;
+    size_t  end, start ;
+
+
+
+/* Get the argument(s). */
+
+    bytes = car (args) ;
+    if (!is_bytevector (bytes)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_FILLx) Invalid bytevector specification: ") ;
+        return (sc->F) ;
+    }
+
+    argument = cadr (args) ;
+    if (!isInteger (argument) ||
+        (ivalue (argument) < 0) || (ivalue (argument) > 255)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_FILLx) Invalid byte specification: ") ;
+        return (sc->F) ;
+    }
+
+    if (!bvrRange (sc, cddr (args), bytevector_length (bytes), &start, &end)) {
+        LGE "(func_BYTEVECTOR_FILLx) Invalid range specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Fill the range. */
+
+    if (end > start)
+        memset (bytevector_data (bytes) + start, (int) ivalue (argument),
+                end - start) ;
+
+    return (sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_IEEE_DOUBLE_REF ()
+
+    Get a Double-Precision Floating-Point Field.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_IEEE_DOUBLE_REF() gets an 8-byte IEEE 754
+    floating-point number from a bytevector.
+
+        (bytevector-ieee-double-ref <bytevector> <k> [<endianness>])
+
+        Return the number stored in bytes <k> through <k>+7 of <bytevector>
+        in the given byte order, BIG (the default) or LITTLE.  #f is
+        returned if the field is out of range or an argument is invalid.
+
+
+    Invocation:
+
+        number = func_BYTEVECTOR_IEEE_DOUBLE_REF (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, the index of the field,
+            and, optionally, the byte order.
+        <number>	- O
+            returns the real number; #f is returned in the event of an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_IEEE_DOUBLE_REF (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return (bvrRealRef (sc, args, sizeof (double),
+                        "func_BYTEVECTOR_IEEE_DOUBLE_REF")) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_IEEE_DOUBLE_SETx ()
+
+    Set a Double-Precision Floating-Point Field.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_IEEE_DOUBLE_SETx() stores an 8-byte IEEE 754
+    floating-point number in a bytevector.
+
+        (bytevector-ieee-double-set! <bytevector> <k> <number>
+                                     [<endianness>])
+
+        Store <number> in bytes <k> through <k>+7 of <bytevector> in the
+        given byte order, BIG (the default) or LITTLE.  #t is returned if
+        the number was stored and #f is returned if the field is out of
+        range or an argument is invalid.
+
+
+    Invocation:
+
+        status = func_BYTEVECTOR_IEEE_DOUBLE_SETx (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, the index of the field,
+            the number, and, optionally, the byte order.
+        <status>	- O
+            returns #t if the number was stored and #f otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_IEEE_DOUBLE_SETx (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return (bvrRealSet (sc, args, sizeof (double),
+                        "func_BYTEVECTOR_IEEE_DOUBLE_SETx")) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_IEEE_SINGLE_REF ()
+
+    Get a Single-Precision Floating-Point Field.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_IEEE_SINGLE_REF() gets a 4-byte IEEE 754
+    floating-point number from a bytevector.
+
+        (bytevector-ieee-single-ref <bytevector> <k> [<endianness>])
+
+        Return the number stored in bytes <k> through <k>+3 of <bytevector>
+        in the given byte order, BIG (the default) or LITTLE.  #f is
+        returned if the field is out of range or an argument is invalid.
+
+
+    Invocation:
+
+        number = func_BYTEVECTOR_IEEE_SINGLE_REF (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, the index of the field,
+            and, optionally, the byte order.
+        <number>	- O
+            returns the real number; #f is returned in the event of an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_IEEE_SINGLE_REF (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return (bvrRealRef (sc, args, sizeof (float),
+                        "func_BYTEVECTOR_IEEE_SINGLE_REF")) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_IEEE_SINGLE_SETx ()
+
+    Set a Single-Precision Floating-Point Field.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_IEEE_SINGLE_SETx() stores a 4-byte IEEE 754
+    floating-point number in a bytevector.
+
+        (bytevector-ieee-single-set! <bytevector> <k> <number>
+                                     [<endianness>])
+
+        Store <number>, rounded to single precision, in bytes <k> through
+        <k>+3 of <bytevector> in the given byte order, BIG (the default) or
+        LITTLE.  #t is returned if the number was stored and #f is returned
+        if the field is out of range or an argument is invalid.
+
+
+    Invocation:
+
+        status = func_BYTEVECTOR_IEEE_SINGLE_SETx (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, the index of the field,
+            the number, and, optionally, the byte order.
+        <status>	- O
+            returns #t if the number was stored and #f otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_IEEE_SINGLE_SETx (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return (bvrRealSet (sc, args, sizeof (float),
+                        "func_BYTEVECTOR_IEEE_SINGLE_SETx")) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_LENGTH ()
+
+    Get the Length of a Bytevector.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_LENGTH() returns the number of bytes in a
+    bytevector.
+
+        (bytevector-length <bytevector>)
+
+        Return the number of bytes in <bytevector>; #f is returned if the
+        argument is not a bytevector.
+
+
+    Invocation:
+
+        length = func_BYTEVECTOR_LENGTH (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector.
+        <length>	- O
+            returns the number of bytes in the bytevector; #f is returned
+            in the event of an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_LENGTH (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    if (!is_bytevector (car (args))) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_LENGTH) Invalid bytevector specification: ") ;
+        return (sc->F) ;
+    }
+
+    return (mk_integer (sc, (long) bytevector_length (car (args)))) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_SINT_REF ()
+
+    Get a Signed Integer Field.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_SINT_REF() gets a two's-complement signed
+    integer from a bytevector.
+
+        (bytevector-sint-ref <bytevector> <k> <endianness> <size>)
+
+        Return the integer stored in the <size> bytes (1 to 8) of
+        <bytevector> starting at index <k>, in byte order <endianness>,
+        BIG or LITTLE.  #f is returned if the field is out of range or
+        an argument is invalid.
+
+
+    Invocation:
+
+        number = func_BYTEVECTOR_SINT_REF (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, the index of the field,
+            the byte order, and the size of the field in bytes.
+        <number>	- O
+            returns the integer; #f is returned in the event of an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_SINT_REF (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return (bvrIntegerRef (sc, args, true, "func_BYTEVECTOR_SINT_REF")) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_U8_REF ()
+
+    Get a Byte from a Bytevector.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_U8_REF() gets a byte from a bytevector.
+
+        (bytevector-u8-ref <bytevector> <k>)
+
+        Return byte <k> of <bytevector> as an integer from 0 to 255.  #f is
+        returned if the index is out of range or an argument is invalid.
+
+
+    Invocation:
+
+        byte = func_BYTEVECTOR_U8_REF (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector and an index.
+        <byte>		- O
+            returns the byte; #f is returned in the event of an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_U8_REF (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  bytes ;
+    size_t  index ;
+
+
+
+    bytes = car (args) ;
+    if (!is_bytevector (bytes)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_U8_REF) Invalid bytevector specification: ") ;
+        return (sc->F) ;
+    }
+
+    if ((bytevector_length (bytes) == 0) ||
+        !bvrIndex (cadr (args), bytevector_length (bytes) - 1, &index)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_U8_REF) Invalid index specification: ") ;
+        return (sc->F) ;
+    }
+
+    return (mk_integer (sc, (long) bytevector_data (bytes)[index])) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_U8_SETx ()
+
+    Set a Byte in a Bytevector.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_U8_SETx() stores a byte in a bytevector.
+
+        (bytevector-u8-set! <bytevector> <k> <byte>)
+
+        Store <byte>, an integer from 0 to 255, in byte <k> of <bytevector>.
+        #t is returned if the byte was stored and #f is returned if the index
+        is out of range or an argument is invalid.
+
+
+    Invocation:
+
+        status = func_BYTEVECTOR_U8_SETx (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, an index, and the byte.
+        <status>	- O
+            returns #t if the byte was stored and #f otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_U8_SETx (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  argument, bytes ;
+    size_t  index ;
+
+
+
+    bytes = car (args) ;
+    if (!is_bytevector (bytes)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_U8_SETx) Invalid bytevector specification: ") ;
+        return (sc->F) ;
+    }
+
+    if ((bytevector_length (bytes) == 0) ||
+        !bvrIndex (cadr (args), bytevector_length (bytes) - 1, &index)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_U8_SETx) Invalid index specification: ") ;
+        return (sc->F) ;
+    }
+
+    argument = caddr (args) ;
+    if (!isInteger (argument) ||
+        (ivalue (argument) < 0) || (ivalue (argument) > 255)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_U8_SETx) Invalid byte specification: ") ;
+        return (sc->F) ;
+    }
+
+    bytevector_data (bytes)[index] = (unsigned char) ivalue (argument) ;
+
+    return (sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_UINT_REF ()
+
+    Get an Unsigned Integer Field.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_UINT_REF() gets an unsigned integer from a
+    bytevector.
+
+        (bytevector-uint-ref <bytevector> <k> <endianness> <size>)
+
+        Return the integer stored in the <size> bytes (1 to 8) of
+        <bytevector> starting at index <k>, in byte order <endianness>,
+        BIG or LITTLE.  A value too large for a Scheme integer is returned
+        as a real.  #f is returned if the field is out of range or an
+        argument is invalid.
+
+
+    Invocation:
+
+        number = func_BYTEVECTOR_UINT_REF (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, the index of the field,
+            the byte order, and the size of the field in bytes.
+        <number>	- O
+            returns the integer; #f is returned in the event of an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_UINT_REF (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return (bvrIntegerRef (sc, args, false, "func_BYTEVECTOR_UINT_REF")) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_BYTEVECTOR_UINT_SETx ()
+
+    Set an Integer Field.
+
+
+Purpose:
+
+    Function func_BYTEVECTOR_UINT_SETx() stores an integer in a bytevector.
+    It implements both BYTEVECTOR-UINT-SET! and BYTEVECTOR-SINT-SET!, since
+    a value that fits the field has the same bytes either way.
+
+        (bytevector-uint-set! <bytevector> <k> <integer> <endianness> <size>)
+        (bytevector-sint-set! <bytevector> <k> <integer> <endianness> <size>)
+
+        Store <integer> in the <size> bytes (1 to 8) of <bytevector>
+        starting at index <k>, in byte order <endianness>, BIG or LITTLE.
+        A negative integer is stored in two's-complement form.  An integral
+        real is accepted for unsigned 64-bit values too large for a Scheme
+        integer.  #t is returned if the integer was stored and #f is
+        returned if the field is out of range, the integer doesn't fit in
+        the field, or an argument is invalid.
+
+
+    Invocation:
+
+        status = func_BYTEVECTOR_UINT_SETx (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, the index of the field,
+            the integer, the byte order, and the size of the field in bytes.
+        <status>	- O
+            returns #t if the integer was stored and #f otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_BYTEVECTOR_UINT_SETx (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    bool  negative, valid ;
+    double  real ;
+    int  big ;
+    pointer  argument, bytes ;
+    size_t  index, size ;
+    unsigned  long  long  value ;
+
+
+
+/* Get the argument(s). */
+
+    bytes = car (args) ;
+    if (!is_bytevector (bytes)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_UINT_SETx) Invalid bytevector specification: ") ;
+        return (sc->F) ;
+    }
+
+    argument = car (cddddr (args)) ;
+    if (!isInteger (argument) ||
+        (ivalue (argument) < 1) || (ivalue (argument) > 8)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_UINT_SETx) Invalid size specification: ") ;
+        return (sc->F) ;
+    }
+    size = (size_t) ivalue (argument) ;
+
+    if ((bytevector_length (bytes) < size) ||
+        !bvrIndex (cadr (args), bytevector_length (bytes) - size, &index)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_UINT_SETx) Invalid index specification: ") ;
+        return (sc->F) ;
+    }
+
+    big = bvrEndianness (cdr (cddr (args))) ;
+    if (big < 0) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_UINT_SETx) Invalid endianness specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Convert the value to its bytes, checking that it fits in the field:
+   from -2^(8*size-1) up to, but not including, 2^(8*size). */
+
+    argument = caddr (args) ;
+    valid = true ;
+    if (isInteger (argument)) {
+        negative = (ivalue (argument) < 0) ;
+        value = (unsigned long long) (long long) ivalue (argument) ;
+    } else if (isReal (argument) &&
+               (rvalue (argument) >= -9223372036854775808.0) &&
+               (rvalue (argument) < 18446744073709551616.0)) {
+        real = rvalue (argument) ;
+        negative = (real < 0.0) ;
+        value = negative ? (unsigned long long) (long long) real
+                         : (unsigned long long) real ;
+        valid = ((negative ? (double) (long long) value
+                           : (double) value) == real) ;	/* Integral? */
+    } else {
+        negative = valid = false ;
+        value = 0 ;
+    }
+
+    if (valid && (size < 8))
+        valid = negative ? ((long long) value >=
+                            -((long long) 1 << (size * 8 - 1)))
+                         : ((value >> (size * 8)) == 0) ;
+
+    if (!valid) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_BYTEVECTOR_UINT_SETx) Invalid integer specification: ") ;
+        return (sc->F) ;
+    }
+
+    bvrPut (bytevector_data (bytes) + index, size, (big > 0), value) ;
+
+    return (sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_MAKE_BYTEVECTOR ()
+
+    Make a Bytevector.
+
+
+Purpose:
+
+    Function func_MAKE_BYTEVECTOR() makes a new bytevector.
+
+        (make-bytevector <length> [<byte>])
+
+        Return a new bytevector of <length> bytes, each of which is set to
+        <byte> (default 0).  #f is returned in the event of an error.
+
+
+    Invocation:
+
+        bytes = func_MAKE_BYTEVECTOR (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the length of the bytevector and,
+            optionally, the initial value of its bytes.
+        <bytes>		- O
+            returns the new bytevector; #f is returned in the event of an
+            error.
+
+*******************************************************************************/
+
+
+static  pointer  func_MAKE_BYTEVECTOR (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    int  fill ;
+    pointer  argument, bytes ;
+    size_t  length ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (isInteger (argument) && (ivalue (argument) >= 0)) {
+        length = (size_t) ivalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_MAKE_BYTEVECTOR) Invalid length specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    if (args == sc->NIL) {
+        fill = 0 ;
+    } else if (isInteger (car (args)) &&
+               (ivalue (car (args)) >= 0) && (ivalue (car (args)) <= 255)) {
+        fill = (int) ivalue (car (args)) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_MAKE_BYTEVECTOR) Invalid byte specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Make the bytevector. */
+
+    bytes = mk_bytevector (sc, NULL, length) ;
+    if (bytes == NULL) {
+        LGE "(func_MAKE_BYTEVECTOR) Error allocating %lu-byte bytevector.\nmk_bytevector: ",
+            (unsigned long) length) ;
+        return (sc->F) ;
+    }
+
+    if (length > 0)  memset (bytevector_data (bytes), fill, length) ;
+
+    return (bytes) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_STRING_TO_UTF8 ()
+
+    Convert a String to a Bytevector.
+
+
+Purpose:
+
+    Function func_STRING_TO_UTF8() converts all or part of a string to a
+    bytevector.
+
+        (string->utf8 <string> [<start> [<end>]])
+
+        Return a new bytevector containing the bytes of <string> from index
+        <start> (default 0) up to, but not including, index <end> (default
+        the length of <string>).  TinyScheme strings are strings of bytes,
+        so the bytes are copied as is.  #f is returned in the event of an
+        error.
+
+
+    Invocation:
+
+        bytes = func_STRING_TO_UTF8 (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a string and, optionally, the start
+            and end indices of the characters to convert.
+        <bytes>		- O
+            returns the new bytevector; #f is returned in the event of an
+            error.
+
+*******************************************************************************/
+
+
+static  pointer  func_STRING_TO_UTF8 (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  bytes, string ;
+    size_t  end, start ;
+
+
+
+/* Get the argument(s). */
+
+    string = car (args) ;
+    if (!is_string (string)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_STRING_TO_UTF8) Invalid string specification: ") ;
+        return (sc->F) ;
+    }
+
+    if (!bvrRange (sc, cdr (args), (size_t) strlength (string),
+                   &start, &end)) {
+        LGE "(func_STRING_TO_UTF8) Invalid range specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Copy the bytes. */
+
+    bytes = mk_bytevector (sc, strvalue (string) + start, end - start) ;
+    if (bytes == NULL) {
+        LGE "(func_STRING_TO_UTF8) Error allocating %lu-byte bytevector.\nmk_bytevector: ",
+            (unsigned long) (end - start)) ;
+        return (sc->F) ;
+    }
+
+    return (bytes) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_UTF8_TO_STRING ()
+
+    Convert a Bytevector to a String.
+
+
+Purpose:
+
+    Function func_UTF8_TO_STRING() converts all or part of a bytevector to
+    a string.
+
+        (utf8->string <bytevector> [<start> [<end>]])
+
+        Return a new counted string containing the bytes of <bytevector>
+        from index <start> (default 0) up to, but not including, index
+        <end> (default the length of <bytevector>).  The bytes are copied
+        as is; they are not checked for valid UTF-8.  #f is returned in the
+        event of an error.
+
+
+    Invocation:
+
+        string = func_UTF8_TO_STRING (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector and, optionally, the
+            start and end indices of the bytes to convert.
+        <string>	- O
+            returns the new string; #f is returned in the event of an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_UTF8_TO_STRING (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  bytes ;
+    size_t  end, start ;
+
+
+
+/* Get the argument(s). */
+
+    bytes = car (args) ;
+    if (!is_bytevector (bytes)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_UTF8_TO_STRING) Invalid bytevector specification: ") ;
+        return (sc->F) ;
+    }
+
+    if (!bvrRange (sc, cdr (args), bytevector_length (bytes), &start, &end)) {
+        LGE "(func_UTF8_TO_STRING) Invalid range specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Copy the bytes. */
+
+    return (mk_bstring (sc, (char *) bytevector_data (bytes) + start,
+                        end - start)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    bvrEndianness ()
+
+    Decode an Optional Endianness Argument.
+
+
+Purpose:
+
+    Function bvrEndianness() decodes an optional byte-order argument, the
+    symbol BIG or LITTLE.
+
+
+    Invocation:
+
+        big = bvrEndianness (args) ;
+
+    where
+
+        <args>		- I
+            is the list of the remaining arguments, the first of which, if
+            any, is the byte order.
+        <big>		- O
+            returns 1 if the byte order is big-endian or is not specified,
+            0 if the byte order is little-endian, and -1 if the argument is
+            invalid.
+
+*******************************************************************************/
+
+
+static  int  bvrEndianness (
+
+#    if PROTOTYPES
+        pointer  args)
+#    else
+        args)
+
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  argument ;
+
+
+
+    if (!is_pair (args))  return (1) ;
+
+    argument = car (args) ;
+    if (!is_symbol (argument))  return (-1) ;
+    if (strcmp (symname (argument), "big") == 0)  return (1) ;
+    if (strcmp (symname (argument), "little") == 0)  return (0) ;
+
+    return (-1) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    bvrGet ()
+
+    Get an Unsigned Integer from a Bytevector.
+
+
+Purpose:
+
+    Function bvrGet() assembles an unsigned integer from 1 to 8 bytes in
+    big- or little-endian order.  The bytes are combined one at a time, so
+    the result doesn't depend on the host's byte order or on alignment.
+
+
+    Invocation:
+
+        value = bvrGet (bytes, size, big) ;
+
+    where
+
+        <bytes>		- I
+            is the address of the first byte of the field.
+        <size>		- I
+            is the number of bytes in the field.
+        <big>		- I
+            specifies whether the field is big-endian (true) or
+            little-endian (false).
+        <value>		- O
+            returns the value of the field.
+
+*******************************************************************************/
+
+
+static  unsigned  long  long  bvrGet (
+
+#    if PROTOTYPES
+        const  unsigned  char  *bytes,
+        size_t  size,
+        bool  big)
+#    else
+        bytes, size, big)
+
+        unsigned  char  *bytes ;
+        size_t  size ;
+        bool  big ;
+#    endif
+
+{    /* Local variables. */
+    size_t  i ;
+    unsigned  long  long  value ;
+
+
+
+    value = 0 ;
+
+    if (big) {
+        for (i = 0 ;  i < size ;  i++)
+            value = (value << 8) | bytes[i] ;
+    } else {
+        for (i = size ;  i > 0 ;  i--)
+            value = (value << 8) | bytes[i-1] ;
+    }
+
+    return (value) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    bvrIndex ()
+
+    Decode an Index Argument.
+
+
+Purpose:
+
+    Function bvrIndex() checks that an argument is an integer index within
+    a given limit.
+
+
+    Invocation:
+
+        valid = bvrIndex (argument, limit, &index) ;
+
+    where
+
+        <argument>	- I
+            is the argument.
+        <limit>		- I
+            is the largest valid index.
+        <index>		- O
+            returns the index.
+        <valid>		- O
+            returns true if the argument is an integer from 0 to LIMIT and
+            false otherwise.
+
+*******************************************************************************/
+
+
+static  bool  bvrIndex (
+
+#    if PROTOTYPES
+        pointer  argument,
+        size_t  limit,
+        size_t  *index)
+#    else
+        argument, limit, index)
+
+        pointer  argument ;
+        size_t  limit ;
+        size_t  *index ;
+#    endif
+
+{
+
+    if (!isInteger (argument) || (ivalue (argument) < 0) ||
+        ((unsigned long) ivalue (argument) > limit))
+        return (false) ;
+
+    *index = (size_t) ivalue (argument) ;
+
+    return (true) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    bvrIntegerRef ()
+
+    Get a Signed or Unsigned Integer Field.
+
+
+Purpose:
+
+    Function bvrIntegerRef() implements BYTEVECTOR-SINT-REF and
+    BYTEVECTOR-UINT-REF.
+
+
+    Invocation:
+
+        number = bvrIntegerRef (sc, args, isSigned, name) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, the index of the field,
+            the byte order, and the size of the field in bytes.
+        <isSigned>	- I
+            specifies whether the field is a signed (true) or unsigned
+            (false) integer.
+        <name>		- I
+            is the name of the calling function, for error messages.
+        <number>	- O
+            returns the integer; #f is returned in the event of an error.
+
+*******************************************************************************/
+
+
+static  pointer  bvrIntegerRef (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args,
+        bool  isSigned,
+        const  char  *name)
+#    else
+        sc, args, isSigned, name)
+
+        scheme  *sc ;
+        pointer  args ;
+        bool  isSigned ;
+        char  *name ;
+#    endif
+
+{    /* Local variables. */
+    int  big ;
+    long  long  number ;
+    pointer  argument, bytes ;
+    size_t  index, size ;
+    unsigned  long  long  value ;
+
+
+
+/* Get the argument(s). */
+
+    bytes = car (args) ;
+    if (!is_bytevector (bytes)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid bytevector specification: ", name) ;
+        return (sc->F) ;
+    }
+
+    argument = cadddr (args) ;
+    if (!isInteger (argument) ||
+        (ivalue (argument) < 1) || (ivalue (argument) > 8)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid size specification: ", name) ;
+        return (sc->F) ;
+    }
+    size = (size_t) ivalue (argument) ;
+
+    if ((bytevector_length (bytes) < size) ||
+        !bvrIndex (cadr (args), bytevector_length (bytes) - size, &index)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid index specification: ", name) ;
+        return (sc->F) ;
+    }
+
+    big = bvrEndianness (cddr (args)) ;
+    if (big < 0) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid endianness specification: ", name) ;
+        return (sc->F) ;
+    }
+
+/* Get the field, sign-extending a signed field, and return it as an
+   integer if it fits in a Scheme integer and as a real otherwise. */
+
+    value = bvrGet (bytevector_data (bytes) + index, size, (big > 0)) ;
+
+    if (isSigned) {
+        if ((size < 8) && (value & ((unsigned long long) 1 << (size * 8 - 1))))
+            value |= ~0ULL << (size * 8) ;
+        number = (long long) value ;
+        if ((number < LONG_MIN) || (number > LONG_MAX))
+            return (mk_real (sc, (double) number)) ;
+        return (mk_integer (sc, (long) number)) ;
+    } else {
+        if (value > (unsigned long long) LONG_MAX)
+            return (mk_real (sc, (double) value)) ;
+        return (mk_integer (sc, (long) value)) ;
+    }
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    bvrPut ()
+
+    Put an Unsigned Integer into a Bytevector.
+
+
+Purpose:
+
+    Function bvrPut() stores the low-order 1 to 8 bytes of an unsigned
+    integer in big- or little-endian order.
+
+
+    Invocation:
+
+        bvrPut (bytes, size, big, value) ;
+
+    where
+
+        <bytes>		- O
+            is the address of the first byte of the field.
+        <size>		- I
+            is the number of bytes in the field.
+        <big>		- I
+            specifies whether the field is big-endian (true) or
+            little-endian (false).
+        <value>		- I
+            is the value to store.
+
+*******************************************************************************/
+
+
+static  void  bvrPut (
+
+#    if PROTOTYPES
+        unsigned  char  *bytes,
+        size_t  size,
+        bool  big,
+        unsigned  long  long  value)
+#    else
+        bytes, size, big, value)
+
+        unsigned  char  *bytes ;
+        size_t  size ;
+        bool  big ;
+        unsigned  long  long  value ;
+#    endif
+
+{    /* Local variables. */
+    size_t  i ;
+
+
+
+    if (big) {
+        for (i = size ;  i > 0 ;  i--, value >>= 8)
+            bytes[i-1] = (unsigned char) (value & 0xFF) ;
+    } else {
+        for (i = 0 ;  i < size ;  i++, value >>= 8)
+            bytes[i] = (unsigned char) (value & 0xFF) ;
+    }
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    bvrRange ()
+
+    Decode Optional Start and End Arguments.
+
+
+Purpose:
+
+    Function bvrRange() decodes the optional start and end indices that
+    select a range of a bytevector or string.
+
+
+    Invocation:
+
+        valid = bvrRange (sc, args, length, &start, &end) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is the list of the remaining arguments: optionally, the start
+            index, followed, optionally, by the end index.
+        <length>	- I
+            is the length of the bytevector or string.
+        <start>		- O
+            returns the start index, 0 if not specified.
+        <end>		- O
+            returns the end index, LENGTH if not specified.
+        <valid>		- O
+            returns true if the range is valid (0 <= START <= END <= LENGTH)
+            and false otherwise.
+
+*******************************************************************************/
+
+
+static  bool  bvrRange (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args,
+        size_t  length,
+        size_t  *start,
+        size_t  *end)
+#    else
+        sc, args, length, start, end)
+
+        scheme  *sc ;
+        pointer  args ;
+        size_t  length ;
+        size_t  *start ;
+        size_t  *end ;
+#    endif
+
+{
+
+    *start = 0 ;
+    *end = length ;
+
+    if ((args != sc->NIL) && !bvrIndex (car (args), length, start)) {
+        SET_ERRNO (EINVAL) ;
+        return (false) ;
+    }
+
+    if ((args != sc->NIL) && (cdr (args) != sc->NIL) &&
+        (!bvrIndex (cadr (args), length, end) || (*end < *start))) {
+        SET_ERRNO (EINVAL) ;
+        return (false) ;
+    }
+
+    return (true) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    bvrRealRef ()
+
+    Get a Floating-Point Field.
+
+
+Purpose:
+
+    Function bvrRealRef() implements BYTEVECTOR-IEEE-DOUBLE-REF and
+    BYTEVECTOR-IEEE-SINGLE-REF.  The host's floating-point format is
+    assumed to be IEEE 754.
+
+
+    Invocation:
+
+        number = bvrRealRef (sc, args, size, name) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, the index of the field,
+            and, optionally, the byte order.
+        <size>		- I
+            is the size of the field, sizeof (double) or sizeof (float).
+        <name>		- I
+            is the name of the calling function, for error messages.
+        <number>	- O
+            returns the real number; #f is returned in the event of an error.
+
+*******************************************************************************/
+
+
+static  pointer  bvrRealRef (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args,
+        size_t  size,
+        const  char  *name)
+#    else
+        sc, args, size, name)
+
+        scheme  *sc ;
+        pointer  args ;
+        size_t  size ;
+        char  *name ;
+#    endif
+
+{    /* Local variables. */
+    double  real ;
+    float  single ;
+    int  big ;
+    pointer  bytes ;
+    size_t  index ;
+    unsigned  int  word ;
+    unsigned  long  long  value ;
+
+
+
+/* Get the argument(s). */
+
+    bytes = car (args) ;
+    if (!is_bytevector (bytes)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid bytevector specification: ", name) ;
+        return (sc->F) ;
+    }
+
+    if ((bytevector_length (bytes) < size) ||
+        !bvrIndex (cadr (args), bytevector_length (bytes) - size, &index)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid index specification: ", name) ;
+        return (sc->F) ;
+    }
+
+    big = bvrEndianness (cddr (args)) ;
+    if (big < 0) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid endianness specification: ", name) ;
+        return (sc->F) ;
+    }
+
+/* Get the field's bits and reinterpret them as a floating-point number. */
+
+    value = bvrGet (bytevector_data (bytes) + index, size, (big > 0)) ;
+
+    if (size == sizeof (float)) {
+        word = (unsigned int) value ;
+        memcpy (&single, &word, sizeof single) ;
+        real = (double) single ;
+    } else {
+        memcpy (&real, &value, sizeof real) ;
+    }
+
+    return (mk_real (sc, real)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    bvrRealSet ()
+
+    Set a Floating-Point Field.
+
+
+Purpose:
+
+    Function bvrRealSet() implements BYTEVECTOR-IEEE-DOUBLE-SET! and
+    BYTEVECTOR-IEEE-SINGLE-SET!.  The host's floating-point format is
+    assumed to be IEEE 754.
+
+
+    Invocation:
+
+        status = bvrRealSet (sc, args, size, name) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: a bytevector, the index of the field,
+            the number, and, optionally, the byte order.
+        <size>		- I
+            is the size of the field, sizeof (double) or sizeof (float).
+        <name>		- I
+            is the name of the calling function, for error messages.
+        <status>	- O
+            returns #t if the number was stored and #f otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  bvrRealSet (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args,
+        size_t  size,
+        const  char  *name)
+#    else
+        sc, args, size, name)
+
+        scheme  *sc ;
+        pointer  args ;
+        size_t  size ;
+        char  *name ;
+#    endif
+
+{    /* Local variables. */
+    double  real ;
+    float  single ;
+    int  big ;
+    pointer  argument, bytes ;
+    size_t  index ;
+    unsigned  int  word ;
+    unsigned  long  long  value ;
+
+
+
+/* Get the argument(s). */
+
+    bytes = car (args) ;
+    if (!is_bytevector (bytes)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid bytevector specification: ", name) ;
+        return (sc->F) ;
+    }
+
+    if ((bytevector_length (bytes) < size) ||
+        !bvrIndex (cadr (args), bytevector_length (bytes) - size, &index)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid index specification: ", name) ;
+        return (sc->F) ;
+    }
+
+    argument = caddr (args) ;
+    if (isInteger (argument)) {
+        real = (double) ivalue (argument) ;
+    } else if (isReal (argument)) {
+        real = rvalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid number specification: ", name) ;
+        return (sc->F) ;
+    }
+
+    big = bvrEndianness (cdr (cddr (args))) ;
+    if (big < 0) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid endianness specification: ", name) ;
+        return (sc->F) ;
+    }
+
+/* Store the number's bits in the field. */
+
+    if (size == sizeof (float)) {
+        single = (float) real ;
+        memcpy (&word, &single, sizeof word) ;
+        value = word ;
+    } else {
+        memcpy (&value, &real, sizeof value) ;
+    }
+
+    bvrPut (bytevector_data (bytes) + index, size, (big > 0), value) ;
+
+    return (sc->T) ;
+
+}
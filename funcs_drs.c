@@ -26,6 +26,10 @@ Purpose:
         (drs-get <scan> <index>)		=> <fileName>|#f
 
 
+    A scan that is dropped without calling DRS-DESTROY is destroyed after
+    the garbage collector reclaims its handle (see "opaque.c").
+
+
 Public Procedures:
 
     addFuncsDRS() - registers the functions with the Scheme intepreter.
@@ -38,6 +42,7 @@ Private Procedures:
     func_DRS_NEXT() - implements the DRS-NEXT function.
     func_DRS_COUNT() - implements the DRS-COUNT function.
     func_DRS_GET() - implements the DRS-GET function.
+    funcDrsFinalize() - destroys a leaked directory scan.
 
 *******************************************************************************/
 
@@ -61,6 +66,8 @@ static  pointer  func_DRS_FIRST P_((scheme *sc, pointer args)) ;
 static  pointer  func_DRS_NEXT P_((scheme *sc, pointer args)) ;
 static  pointer  func_DRS_COUNT P_((scheme *sc, pointer args)) ;
 static  pointer  func_DRS_GET P_((scheme *sc, pointer args)) ;
+
+static  errno_t  funcDrsFinalize P_((opaque value)) ;
 
 /*!*****************************************************************************
 
@@ -125,6 +132,8 @@ void  addFuncsDRS (
                    mk_symbol (sc, "drs-get"),
                    mk_foreign_func (sc, func_DRS_GET)) ;
 
+    opaque_finalizer (sc, OpaqueDirectoryScan, funcDrsFinalize) ;
+
     return ;
 
 }
@@ -209,7 +218,7 @@ static  pointer  func_DRS_CREATE (
 
 /* Return the directory scan to the caller. */
 
-    return (mk_opaque (sc, (opaque) scan)) ;
+    return (mk_opaque (sc, (opaque) scan, OpaqueDirectoryScan)) ;
 
 }
 
@@ -270,15 +279,17 @@ static  pointer  func_DRS_DESTROY (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        scan = (DirectoryScan) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDirectoryScan)) {
+        scan = (DirectoryScan) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_DRS_DESTROY) Argument is not a scan: ") ;
         return (sc->F) ;
     }
 
-/* Destroy the directory scan. */
+/* Destroy the directory scan, invalidating any remaining handles for it. */
+
+    opaque_release (sc, (opaque) scan) ;
 
     return (drsDestroy (scan) ? sc->F : sc->T) ;
 
@@ -345,8 +356,8 @@ static  pointer  func_DRS_FIRST (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        scan = (DirectoryScan) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDirectoryScan)) {
+        scan = (DirectoryScan) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_DRS_FIRST) Argument is not a scan: ") ;
@@ -423,8 +434,8 @@ static  pointer  func_DRS_NEXT (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        scan = (DirectoryScan) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDirectoryScan)) {
+        scan = (DirectoryScan) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_DRS_NEXT) Argument is not a scan: ") ;
@@ -497,8 +508,8 @@ static  pointer  func_DRS_COUNT (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        scan = (DirectoryScan) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDirectoryScan)) {
+        scan = (DirectoryScan) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_DRS_COUNT) Argument is not a scan: ") ;
@@ -575,8 +586,8 @@ static  pointer  func_DRS_GET (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        scan = (DirectoryScan) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDirectoryScan)) {
+        scan = (DirectoryScan) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_DRS_GET) Argument is not a scan: ") ;
@@ -600,3 +611,53 @@ static  pointer  func_DRS_GET (
     return ((fileName == NULL) ? sc->F : mk_string (sc, fileName)) ;
 
 }
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcDrsFinalize ()
+
+    Destroy a Leaked Directory Scan.
+
+
+Purpose:
+
+    Function funcDrsFinalize() is registered with the OPAQUE package as the
+    finalizer for directory scans.  It destroys a scan whose handles were
+    all garbage-collected before DRS-DESTROY was called.
+
+
+    Invocation:
+
+        status = funcDrsFinalize (value) ;
+
+    where
+
+        <value>		- I
+            is the directory scan, as an opaque value.
+        <status>	- O
+            returns the status of destroying the scan, zero if there were no
+            errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcDrsFinalize (
+
+#    if PROTOTYPES
+        opaque  value)
+#    else
+        value)
+
+        opaque  value ;
+#    endif
+
+{    /* Local variables. */
+    DirectoryScan  scan = (DirectoryScan) value ;
+
+
+
+    return (drsDestroy (scan) ? errno : 0) ;
+
+}
@@ -0,0 +1,2532 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    funcs_fut.c
+
+    Future (Promise) Functions.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The FUNCS_FUT package defines futures, placeholders for the results of
+    asynchronous operations.  A future is created pending and is settled
+    exactly once, either resolved with a value or rejected with a reason,
+    typically from within a dispatcher callback (see FUNCS_IOX).  Functions
+    attached to a future with FUTURE-THEN or FUTURE-CATCH are called with
+    the value or reason once the future settles; each attachment returns a
+    new future that settles with the function's result, so a sequence of
+    asynchronous steps is written as a flat chain rather than as nested
+    callbacks:
+
+        (define (fetch host)
+            (let ((f (future-create dp)))
+                ... (future-resolve f reply) from an IOX-ONIO callback ...
+                f))
+
+        (future-then
+            (future-timeout (future-all (map fetch hosts)) 5.0)
+            (lambda (replies) (display replies) (newline)))
+        (future-catch ... (lambda (reason) ...))
+
+    If a function returns a future, the derived future follows that future
+    instead of resolving with it.  FUTURE-ALL resolves with the list of its
+    futures' values, in order, once all of them have resolved, or rejects as
+    soon as any one of them rejects.  FUTURE-RACE settles the same way as
+    the first of its futures to settle.  FUTURE-TIMEOUT rejects with the
+    symbol TIMEOUT (or a given reason) if its future hasn't settled in time.
+
+    Functions attached to a future are never called from within the code
+    that settles the future.  Instead, settling a future queues its pending
+    functions with the future's dispatcher, and the queue is run at the start
+    of the dispatcher's next iteration (see soxDefer()).  All the functions
+    queued during an iteration - e.g., the completions of 50 scatter-gather
+    requests whose replies arrived together - are called in one batch, one
+    after the other, rather than from nested callbacks.  Forwarding between
+    futures (FUTURE-ALL, FUTURE-RACE, FUTURE-TIMEOUT, and futures returned
+    by functions) is done directly in C without calling the interpreter.
+
+    A future is an ordinary Scheme list tagged with the symbol *FUTURE*:
+
+        (*future* <state> <value> <waiters> . <dispatcher>)
+
+    where <state> is PENDING, RESOLVED, or REJECTED.  Each step in a chain
+    costs a few cons cells (the waiter record and the derived future); no
+    closures are created.  A function is called with the value and, if one
+    was supplied when the function was attached, a second user-data argument,
+    so that a single top-level function can serve many futures.  If the
+    function signals an error, the derived future is rejected with the
+    symbol ERROR.  If the dispatcher is detached (see IOX-DESTROY) before a
+    queued function is called, the function is not called and the derived
+    future is rejected with the symbol CANCELED.
+
+        (future? <object>)			=> <status>   (#t|#f)
+        (future-after <dp> <seconds> <value>)	=> <future>|#f
+        (future-all <futures>)			=> <future>|#f
+        (future-catch <future> <function>
+                      [<user>])			=> <future>|#f
+        (future-create <dp>)			=> <future>|#f
+        (future-onio <dp> <reason> <fd>)	=> <future>|#f
+        (future-race <futures>)			=> <future>|#f
+        (future-reject <future> <reason>)	=> <status>   (#t|#f)
+        (future-resolve <future> <value>)	=> <status>   (#t|#f)
+        (future-state <future>)			=> <state>    (Symbol)
+        (future-then <future> <function>
+                     [<user>])			=> <future>|#f
+        (future-timeout <future> <seconds>
+                        [<reason>])		=> <future>|#f
+        (future-value <future>)			=> <value>
+
+
+Public Procedures:
+
+    addFuncsFUT() - registers the functions with the Scheme intepreter.
+    releaseFuncsFUT() - releases an interpreter's queues of functions.
+
+Private Procedures:
+
+    func_FUTURE_AFTER() - implements the FUTURE-AFTER function.
+    func_FUTURE_ALL() - implements the FUTURE-ALL function.
+    func_FUTURE_CATCH() - implements the FUTURE-CATCH function.
+    func_FUTURE_CREATE() - implements the FUTURE-CREATE function.
+    func_FUTURE_ONIO() - implements the FUTURE-ONIO function.
+    func_FUTURE_P() - implements the FUTURE? function.
+    func_FUTURE_RACE() - implements the FUTURE-RACE function.
+    func_FUTURE_REJECT() - implements the FUTURE-REJECT function.
+    func_FUTURE_RESOLVE() - implements the FUTURE-RESOLVE function.
+    func_FUTURE_STATE() - implements the FUTURE-STATE function.
+    func_FUTURE_THEN() - implements the FUTURE-THEN function.
+    func_FUTURE_TIMEOUT() - implements the FUTURE-TIMEOUT function.
+    func_FUTURE_VALUE() - implements the FUTURE-VALUE function.
+    futAttach() - attaches a function to a future.
+    futDiscard() - cancels the functions queued with a detached dispatcher.
+    futEnqueue() - queues a function call with a future's dispatcher.
+    futFlush() - calls the functions queued with a dispatcher.
+    futIOCB() - is a C callback function that resolves a future when an
+        I/O event occurs.
+    futIsFuture() - checks if a Scheme object is a future.
+    futNew() - creates a pending future.
+    futNotify() - passes a settled future's outcome to one waiter.
+    futRelease() - rejects a queue's functions and frees the queue.
+    futSettle() - settles a future.
+    futSymbols() - looks up the symbols used by the package.
+    futTimerCB() - is a C timer handler that settles a future when a
+        timer fires.
+    futWait() - adds a waiter to a future.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  "iox_util.h"			/* I/O event dispatcher definitions. */
+#include  "tsion.h"			/* TinyScheme I/O Network functions. */
+#include  "gc_util.h"			/* Garbage collection utilities. */
+#include  "sox_util.h"			/* Scheme dispatcher utilities. */
+
+
+/*******************************************************************************
+    Future layout - (*future* <state> <value> <waiters> . <dispatcher>).
+        The waiters are a list of records, one for each function attached
+        to or future forwarding from the future:
+
+            (<kind> <function> <data> . <target>)
+
+        where <kind> is THEN, CATCH, FORWARD, or ALL, and <target> is the
+        future settled by the waiter.  For THEN and CATCH, <data> is ()
+        or a one-element list holding the user-data argument.  For ALL,
+        <function> is the aggregate, (<count> . <values>), shared by the
+        waiters of a FUTURE-ALL, and <data> is the waiter's pair in the
+        list of values.
+*******************************************************************************/
+
+#define  FUT_STATE(f)		car (cdr (f))
+#define  FUT_VALUE(f)		car (cdr (cdr (f)))
+#define  FUT_WAITERS(f)		car (cdr (cdr (cdr (f))))
+#define  FUT_DISPATCHER(f)	cdr (cdr (cdr (cdr (f))))
+
+#define  WAIT_KIND(w)		car (w)
+#define  WAIT_FUNCTION(w)	car (cdr (w))
+#define  WAIT_DATA(w)		car (cdr (cdr (w)))
+#define  WAIT_TARGET(w)		cdr (cdr (cdr (w)))
+
+/* Symbols used by the package, looked up once per interpreter rather than
+   on every call.  Interned symbols are never garbage collected. */
+
+static  struct  {
+    scheme  *sc ;
+    pointer  tag, pending, resolved, rejected ;
+    pointer  thenKind, catchKind, forwardKind, allKind ;
+    pointer  timeout, error, canceled ;
+}  sym = { NULL } ;
+
+
+/*******************************************************************************
+    FutQueue - the function calls queued with a dispatcher, to be made at the
+        start of the dispatcher's next iteration.  The calls are kept in a
+        protected Scheme list, (#f <entry> ...), where each <entry> is a
+        (<waiter> . <future>) pair.  An interpreter's queues, one for each
+        dispatcher, are listed in its TSION-specific structure; a queue is
+        freed when its dispatcher is detached or the interpreter released.
+*******************************************************************************/
+
+typedef  struct  _FutQueue {
+    struct  _FutQueue  *next ;	/* Link in interpreter's list of queues. */
+    IoxDispatcher  dispatcher ;	/* Dispatcher with which queued. */
+    scheme  *sc ;		/* Scheme interpreter. */
+    UniqueID  headID ;		/* Protected ID of list header. */
+    pointer  head ;		/* List header ... */
+    pointer  tail ;		/* ... and last pair in list. */
+    SoxDeferred  flush ;	/* Deferred call of queued functions. */
+    bool  flushing ;		/* Calling the queued functions? */
+    bool  canceled ;		/* Dispatcher detached? */
+    unsigned  long  batches ;	/* Number of batches run. */
+    unsigned  long  calls ;	/* Number of functions called. */
+}  FutQueue ;
+
+
+/*******************************************************************************
+    FutTimer - settles a future when a wheel timer fires.
+    FutWatch - resolves a future when an I/O event occurs.
+*******************************************************************************/
+
+typedef  struct  FutTimer {
+    scheme  *sc ;		/* Scheme interpreter. */
+    UniqueID  futureID ;	/* Protected ID of future ... */
+    UniqueID  valueID ;		/* ... and of its value or reason. */
+    bool  reject ;		/* Reject (or resolve) the future? */
+}  FutTimer ;
+
+typedef  struct  FutWatch {
+    scheme  *sc ;		/* Scheme interpreter. */
+    UniqueID  futureID ;	/* Protected ID of future. */
+    IoxCallback  callback ;	/* Registered I/O callback. */
+    IoxDispatcher  dispatcher ;	/* Dispatcher with which registered. */
+}  FutWatch ;
+
+
+/*******************************************************************************
+    Private functions.
+*******************************************************************************/
+
+static  pointer  func_FUTURE_AFTER P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_ALL P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_CATCH P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_CREATE P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_ONIO P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_P P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_RACE P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_REJECT P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_RESOLVE P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_STATE P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_THEN P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_TIMEOUT P_((scheme *sc, pointer args)) ;
+static  pointer  func_FUTURE_VALUE P_((scheme *sc, pointer args)) ;
+
+static  pointer  futAttach P_((scheme *sc,
+                               pointer args,
+                               pointer kind,
+                               const char *caller)) ;
+
+static  errno_t  futDiscard P_((void *userData)) ;
+
+static  errno_t  futEnqueue P_((scheme *sc,
+                                pointer future,
+                                pointer waiter)) ;
+
+static  errno_t  futFlush (
+#    if PROTOTYPES
+        void  *userData
+#    endif
+    ) ;
+
+static  errno_t  futIOCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+static  bool  futIsFuture P_((scheme *sc,
+                              pointer object)) ;
+
+static  pointer  futNew P_((scheme *sc,
+                            pointer dispatcher)) ;
+
+static  void  futNotify P_((scheme *sc,
+                            pointer future,
+                            pointer waiter)) ;
+
+static  void  futRelease P_((FutQueue *queue)) ;
+
+static  bool  futSettle P_((scheme *sc,
+                            pointer future,
+                            pointer state,
+                            pointer value)) ;
+
+static  void  futSymbols P_((scheme *sc)) ;
+
+static  errno_t  futTimerCB (
+#    if PROTOTYPES
+        TwlTimer  timer,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+static  void  futWait P_((scheme *sc,
+                          pointer future,
+                          pointer kind,
+                          pointer function,
+                          pointer data,
+                          pointer target)) ;
+
+/*!*****************************************************************************
+
+Procedure:
+
+    addFuncsFUT ()
+
+    Register the Future Functions with the Scheme Interpreter.
+
+
+Purpose:
+
+    Function addFuncsFUT() registers the future functions as foreign
+    functions with the Scheme interpreter.
+
+
+    Invocation:
+
+        addFuncsFUT (sc) ;
+
+    where
+
+        <sc>	- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+void  addFuncsFUT (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future?"),
+                   mk_foreign_func (sc, func_FUTURE_P)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-after"),
+                   mk_foreign_func (sc, func_FUTURE_AFTER)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-all"),
+                   mk_foreign_func (sc, func_FUTURE_ALL)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-catch"),
+                   mk_foreign_func (sc, func_FUTURE_CATCH)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-create"),
+                   mk_foreign_func (sc, func_FUTURE_CREATE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-onio"),
+                   mk_foreign_func (sc, func_FUTURE_ONIO)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-race"),
+                   mk_foreign_func (sc, func_FUTURE_RACE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-reject"),
+                   mk_foreign_func (sc, func_FUTURE_REJECT)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-resolve"),
+                   mk_foreign_func (sc, func_FUTURE_RESOLVE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-state"),
+                   mk_foreign_func (sc, func_FUTURE_STATE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-then"),
+                   mk_foreign_func (sc, func_FUTURE_THEN)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-timeout"),
+                   mk_foreign_func (sc, func_FUTURE_TIMEOUT)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "future-value"),
+                   mk_foreign_func (sc, func_FUTURE_VALUE)) ;
+
+    futSymbols (sc) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    releaseFuncsFUT ()
+
+    Release an Interpreter's Queues of Future Functions.
+
+
+Purpose:
+
+    Function releaseFuncsFUT() removes an interpreter's queues of future
+    functions from their dispatchers and frees them; the derived futures
+    of the functions not yet called are rejected with the symbol CANCELED.
+    The function is called by tsion_release() before the interpreter is
+    destroyed.
+
+
+    Invocation:
+
+        releaseFuncsFUT (sc) ;
+
+    where
+
+        <sc>	- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+void  releaseFuncsFUT (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{    /* Local variables. */
+    FutQueue  *queue ;
+
+
+
+    while ((queue = TS (sc, futQueues)) != NULL) {
+        soxUndefer (queue->dispatcher, &queue->flush) ;
+        queue->canceled = true ;
+        futRelease (queue) ;
+    }
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_AFTER ()
+
+    Create a Future that Resolves after a Delay.
+
+
+Purpose:
+
+    Function func_FUTURE_AFTER() creates a future that is resolved with a
+    given value when a timer fires.
+
+        (future-after <dispatcher> <delay> <value>)
+
+        Create a future and resolve it with <value> after <delay> seconds.
+        The timer is kept in the dispatcher's timing wheel (see IOX-AFTER).
+
+
+    Invocation:
+
+        future = func_FUTURE_AFTER (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher, the delay in seconds,
+            and the value with which to resolve the future.
+        <future>	- O
+            returns the future or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_AFTER (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    double  delay ;
+    FutTimer  *timer ;
+    IoxDispatcher  dispatcher ;
+    pointer  argument, dpCell, future, value ;
+
+
+
+    futSymbols (sc) ;
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+        dpCell = argument ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_AFTER) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        delay = (double) ivalue (argument) ;
+    } else if (isReal (argument)) {
+        delay = rvalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_AFTER) Invalid delay specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    value = car (args) ;
+
+/* Create the future and arm a timer to resolve it. */
+
+    future = futNew (sc, dpCell) ;
+
+    timer = (FutTimer *) malloc (sizeof (FutTimer)) ;
+    if (timer == NULL) {
+        LGE "(func_FUTURE_AFTER) Error allocating FutTimer structure.\nmalloc: ") ;
+        return (sc->F) ;
+    }
+
+    timer->sc = sc ;
+    timer->futureID = gc_protect (sc, future) ;
+    timer->valueID = gc_protect (sc, value) ;
+    timer->reject = false ;
+
+    if (soxAfter (dispatcher, futTimerCB, timer, delay) == NULL) {
+        LGE "(func_FUTURE_AFTER) Error registering timer.\nsoxAfter: ") ;
+        PUSH_ERRNO ;
+        gc_unprotect (sc, timer->futureID) ;
+        gc_unprotect (sc, timer->valueID) ;
+        free (timer) ;
+        POP_ERRNO ;
+        return (sc->F) ;
+    }
+
+    return (future) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_ALL ()
+
+    Wait for All of a List of Futures.
+
+
+Purpose:
+
+    Function func_FUTURE_ALL() creates a future that resolves when all of
+    a list of futures have resolved.
+
+        (future-all <futures>)
+
+        Create a future that is resolved with the list of the values of
+        <futures>, in the same order, once every one of them has resolved.
+        If any of <futures> is rejected, the future is rejected at once
+        with the same reason.  Elements of the list that aren't futures
+        are taken as already-resolved values.  The list must include at
+        least one future, from which the new future takes its dispatcher.
+
+
+    Invocation:
+
+        future = func_FUTURE_ALL (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the list of futures.
+        <future>	- O
+            returns the future or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_ALL (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    long  count ;
+    pointer  aggregate, dpCell, element, future, list, slot, values ;
+
+
+
+    futSymbols (sc) ;
+
+/* Count the futures in the list and pick a dispatcher. */
+
+    list = car (args) ;
+    count = 0 ;
+    dpCell = NULL ;
+
+    for (element = list ;  is_pair (element) ;  element = cdr (element)) {
+        if (futIsFuture (sc, car (element))) {
+            if (dpCell == NULL)  dpCell = FUT_DISPATCHER (car (element)) ;
+            count++ ;
+        }
+    }
+
+    if (count == 0) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_ALL) No futures in list: ") ;
+        return (sc->F) ;
+    }
+
+/* Build the aggregate: the number of futures yet to resolve and the list
+   of values, which starts out as a copy of the argument list. */
+
+    future = futNew (sc, dpCell) ;
+
+    values = sc->NIL ;
+    for (element = list ;  is_pair (element) ;  element = cdr (element))
+        values = cons (sc, car (element), values) ;
+
+    for (list = sc->NIL ;  values != sc->NIL ;  values = element) {
+        element = cdr (values) ;
+        set_cdr (values, list) ;
+        list = values ;
+    }
+
+    aggregate = cons (sc, mk_integer (sc, count), list) ;
+
+/* Have each future report its value to its pair in the list of values.
+   Futures already settled report immediately. */
+
+    for (slot = list ;  slot != sc->NIL ;  slot = cdr (slot)) {
+        element = car (slot) ;
+        if (futIsFuture (sc, element))
+            futWait (sc, element, sym.allKind, aggregate, slot, future) ;
+    }
+
+    return (future) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_CATCH ()
+
+    Attach a Rejection Handler to a Future.
+
+
+Purpose:
+
+    Function func_FUTURE_CATCH() attaches a function to be called if a
+    future is rejected.
+
+        (future-catch <future> <function> [<userData>])
+
+        Create a future that settles with the outcome of <future> - unless
+        <future> is rejected, in which case <function> is called with the
+        reason and, if specified, <userData>, and the new future is resolved
+        with the function's result.
+
+
+    Invocation:
+
+        derived = func_FUTURE_CATCH (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the future, the function, and the
+            optional user data.
+        <derived>	- O
+            returns the derived future or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_CATCH (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    futSymbols (sc) ;
+
+    return (futAttach (sc, args, sym.catchKind, "func_FUTURE_CATCH")) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_CREATE ()
+
+    Create a Future.
+
+
+Purpose:
+
+    Function func_FUTURE_CREATE() creates a pending future.
+
+        (future-create <dispatcher>)
+
+        Create a pending future, to be settled with FUTURE-RESOLVE or
+        FUTURE-REJECT.  Functions attached to the future are called from
+        <dispatcher>.
+
+
+    Invocation:
+
+        future = func_FUTURE_CREATE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher.
+        <future>	- O
+            returns the future or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_CREATE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  argument ;
+
+
+
+    futSymbols (sc) ;
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (!is_opaque (sc, argument, OpaqueDispatcher)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_CREATE) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    return (futNew (sc, argument)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_ONIO ()
+
+    Create a Future that Resolves on an I/O Event.
+
+
+Purpose:
+
+    Function func_FUTURE_ONIO() creates a future that is resolved when an
+    I/O event occurs.
+
+        (future-onio <dispatcher> <reason> <fd>)
+
+        Create a future that is resolved with the reason (e.g., IOX_READ)
+        when the event, or one of the events, <reason> occurs on file
+        descriptor <fd>.  The I/O source is monitored only until the first
+        event.
+
+
+    Invocation:
+
+        future = func_FUTURE_ONIO (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher, the events of
+            interest, and the file descriptor.
+        <future>	- O
+            returns the future or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_ONIO (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    FutWatch  *watch ;
+    IoFd  fd ;
+    IoxDispatcher  dispatcher ;
+    IoxReason  reason ;
+    pointer  argument, dpCell, future ;
+
+
+
+    futSymbols (sc) ;
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+        dpCell = argument ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_ONIO) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        reason = (IoxReason) ivalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_ONIO) Invalid reason specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        fd = (IoFd) ivalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_ONIO) Invalid file descriptor specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Create the future and register the I/O source with the dispatcher. */
+
+    future = futNew (sc, dpCell) ;
+
+    watch = (FutWatch *) malloc (sizeof (FutWatch)) ;
+    if (watch == NULL) {
+        LGE "(func_FUTURE_ONIO) Error allocating FutWatch structure.\nmalloc: ") ;
+        return (sc->F) ;
+    }
+
+    watch->sc = sc ;
+    watch->futureID = gc_protect (sc, future) ;
+    watch->dispatcher = dispatcher ;
+
+    watch->callback = ioxOnIO (dispatcher, futIOCB, watch, reason, fd) ;
+    if (watch->callback == NULL) {
+        LGE "(func_FUTURE_ONIO) Error registering I/O source.\nioxOnIO: ") ;
+        PUSH_ERRNO ;
+        gc_unprotect (sc, watch->futureID) ;
+        free (watch) ;
+        POP_ERRNO ;
+        return (sc->F) ;
+    }
+
+    return (future) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_P ()
+
+    Check if an Object is a Future.
+
+
+Purpose:
+
+    Function func_FUTURE_P() checks if a Scheme object is a future.
+
+        (future? <object>)
+
+        Return #t if <object> is a future and #f otherwise.
+
+
+    Invocation:
+
+        status = func_FUTURE_P (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the object.
+        <status>	- O
+            returns true (#t) if the object is a future and false (#f)
+            otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_P (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    futSymbols (sc) ;
+
+    return (futIsFuture (sc, car (args)) ? sc->T : sc->F) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_RACE ()
+
+    Wait for the First of a List of Futures.
+
+
+Purpose:
+
+    Function func_FUTURE_RACE() creates a future that settles when the
+    first of a list of futures settles.
+
+        (future-race <futures>)
+
+        Create a future that is resolved or rejected in the same way as the
+        first of <futures> to settle.  Elements of the list that aren't
+        futures are taken as already-resolved values.  The list must include
+        at least one future, from which the new future takes its dispatcher.
+
+
+    Invocation:
+
+        future = func_FUTURE_RACE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the list of futures.
+        <future>	- O
+            returns the future or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_RACE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  dpCell, element, future, list ;
+
+
+
+    futSymbols (sc) ;
+
+/* Pick a dispatcher. */
+
+    list = car (args) ;
+    dpCell = NULL ;
+
+    for (element = list ;  is_pair (element) ;  element = cdr (element)) {
+        if (futIsFuture (sc, car (element))) {
+            dpCell = FUT_DISPATCHER (car (element)) ;
+            break ;
+        }
+    }
+
+    if (dpCell == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_RACE) No futures in list: ") ;
+        return (sc->F) ;
+    }
+
+/* Forward each future's outcome to the new future; only the first one
+   to arrive takes effect. */
+
+    future = futNew (sc, dpCell) ;
+
+    for (element = list ;  is_pair (element) ;  element = cdr (element)) {
+        if (futIsFuture (sc, car (element)))
+            futWait (sc, car (element), sym.forwardKind, sc->NIL, sc->NIL, future) ;
+        else
+            futSettle (sc, future, sym.resolved, car (element)) ;
+    }
+
+    return (future) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_REJECT ()
+
+    Reject a Future.
+
+
+Purpose:
+
+    Function func_FUTURE_REJECT() rejects a pending future.
+
+        (future-reject <future> <reason>)
+
+        Reject <future> with <reason>, an arbitrary Scheme value.  Functions
+        waiting on the future are called at the start of the dispatcher's
+        next iteration.
+
+
+    Invocation:
+
+        status = func_FUTURE_REJECT (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the future and the reason.
+        <status>	- O
+            returns true (#t) if the future was rejected and false (#f)
+            if it had already been settled.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_REJECT (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    futSymbols (sc) ;
+
+    if (!futIsFuture (sc, car (args))) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_REJECT) Invalid future specification: ") ;
+        return (sc->F) ;
+    }
+
+    return (futSettle (sc, car (args), sym.rejected, car (cdr (args)))
+            ? sc->T : sc->F) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_RESOLVE ()
+
+    Resolve a Future.
+
+
+Purpose:
+
+    Function func_FUTURE_RESOLVE() resolves a pending future.
+
+        (future-resolve <future> <value>)
+
+        Resolve <future> with <value>.  If <value> is itself a future,
+        <future> instead follows <value> and settles when it does.
+        Functions waiting on the future are called at the start of the
+        dispatcher's next iteration.
+
+
+    Invocation:
+
+        status = func_FUTURE_RESOLVE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the future and the value.
+        <status>	- O
+            returns true (#t) if the future was resolved and false (#f)
+            if it had already been settled.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_RESOLVE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    futSymbols (sc) ;
+
+    if (!futIsFuture (sc, car (args))) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_RESOLVE) Invalid future specification: ") ;
+        return (sc->F) ;
+    }
+
+    return (futSettle (sc, car (args), sym.resolved, car (cdr (args)))
+            ? sc->T : sc->F) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_STATE ()
+
+    Get the State of a Future.
+
+
+Purpose:
+
+    Function func_FUTURE_STATE() returns the state of a future.
+
+        (future-state <future>)
+
+        Return the state of <future>: the symbol PENDING, RESOLVED, or
+        REJECTED.
+
+
+    Invocation:
+
+        state = func_FUTURE_STATE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the future.
+        <state>		- O
+            returns the state of the future or #f if the argument is not
+            a future.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_STATE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    futSymbols (sc) ;
+
+    if (!futIsFuture (sc, car (args))) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_STATE) Invalid future specification: ") ;
+        return (sc->F) ;
+    }
+
+    return (FUT_STATE (car (args))) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_THEN ()
+
+    Attach a Completion Handler to a Future.
+
+
+Purpose:
+
+    Function func_FUTURE_THEN() attaches a function to be called when a
+    future is resolved.
+
+        (future-then <future> <function> [<userData>])
+
+        Create a future that settles with the outcome of <future> - unless
+        <future> is resolved, in which case <function> is called with the
+        value and, if specified, <userData>, and the new future is resolved
+        with the function's result.  If the result is a future, the new
+        future follows it.
+
+
+    Invocation:
+
+        derived = func_FUTURE_THEN (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the future, the function, and the
+            optional user data.
+        <derived>	- O
+            returns the derived future or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_THEN (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    futSymbols (sc) ;
+
+    return (futAttach (sc, args, sym.thenKind, "func_FUTURE_THEN")) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_TIMEOUT ()
+
+    Limit the Time Allowed for a Future.
+
+
+Purpose:
+
+    Function func_FUTURE_TIMEOUT() creates a future that is rejected if
+    another future doesn't settle in time.
+
+        (future-timeout <future> <seconds> [<reason>])
+
+        Create a future that settles with the outcome of <future> if
+        <future> settles within <seconds>; otherwise, the new future is
+        rejected with <reason> (by default, the symbol TIMEOUT).  <future>
+        itself is unaffected.
+
+
+    Invocation:
+
+        derived = func_FUTURE_TIMEOUT (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the future, the time limit in
+            seconds, and the optional reason.
+        <derived>	- O
+            returns the derived future or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_TIMEOUT (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    double  limit ;
+    FutTimer  *timer ;
+    pointer  argument, derived, future, reason ;
+
+
+
+    futSymbols (sc) ;
+
+/* Get the argument(s). */
+
+    future = car (args) ;
+    if (!futIsFuture (sc, future) ||
+        !is_opaque (sc, FUT_DISPATCHER (future), OpaqueDispatcher)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_TIMEOUT) Invalid future specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        limit = (double) ivalue (argument) ;
+    } else if (isReal (argument)) {
+        limit = rvalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_TIMEOUT) Invalid time limit specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    reason = (args == sc->NIL) ? sym.timeout : car (args) ;
+
+/* Forward the future's outcome to the derived future and arm a timer to
+   reject the derived future if the outcome doesn't arrive in time.  (The
+   timer is left to expire harmlessly if it does.) */
+
+    derived = futNew (sc, FUT_DISPATCHER (future)) ;
+    futWait (sc, future, sym.forwardKind, sc->NIL, sc->NIL, derived) ;
+
+    if (FUT_STATE (derived) != sym.pending)  return (derived) ;
+
+    timer = (FutTimer *) malloc (sizeof (FutTimer)) ;
+    if (timer == NULL) {
+        LGE "(func_FUTURE_TIMEOUT) Error allocating FutTimer structure.\nmalloc: ") ;
+        return (sc->F) ;
+    }
+
+    timer->sc = sc ;
+    timer->futureID = gc_protect (sc, derived) ;
+    timer->valueID = gc_protect (sc, reason) ;
+    timer->reject = true ;
+
+    if (soxAfter ((IoxDispatcher) opaque_value (sc, FUT_DISPATCHER (future)),
+                  futTimerCB, timer, limit) == NULL) {
+        LGE "(func_FUTURE_TIMEOUT) Error registering timer.\nsoxAfter: ") ;
+        PUSH_ERRNO ;
+        gc_unprotect (sc, timer->futureID) ;
+        gc_unprotect (sc, timer->valueID) ;
+        free (timer) ;
+        POP_ERRNO ;
+        return (sc->F) ;
+    }
+
+    return (derived) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_FUTURE_VALUE ()
+
+    Get the Value of a Future.
+
+
+Purpose:
+
+    Function func_FUTURE_VALUE() returns the value of a settled future.
+
+        (future-value <future>)
+
+        Return the value with which <future> was resolved or the reason
+        with which it was rejected; see FUTURE-STATE.  If <future> is still
+        pending, #f is returned.
+
+
+    Invocation:
+
+        value = func_FUTURE_VALUE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the future.
+        <value>		- O
+            returns the value or reason, or #f if the future is pending.
+
+*******************************************************************************/
+
+
+static  pointer  func_FUTURE_VALUE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    futSymbols (sc) ;
+
+    if (!futIsFuture (sc, car (args))) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_FUTURE_VALUE) Invalid future specification: ") ;
+        return (sc->F) ;
+    }
+
+    if (FUT_STATE (car (args)) == sym.pending)  return (sc->F) ;
+
+    return (FUT_VALUE (car (args))) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futAttach ()
+
+    Attach a Function to a Future.
+
+
+Purpose:
+
+    Function futAttach() implements FUTURE-THEN and FUTURE-CATCH: it creates
+    the derived future and adds a waiter that will call the function.
+
+
+    Invocation:
+
+        derived = futAttach (sc, args, kind, caller) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the future, the function, and the
+            optional user data.
+        <kind>		- I
+            is the kind of waiter, THEN or CATCH.
+        <caller>	- I
+            is the name of the calling function, for error messages.
+        <derived>	- O
+            returns the derived future or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  futAttach (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args,
+        pointer  kind,
+        const  char  *caller)
+#    else
+        sc, args, kind, caller)
+
+        scheme  *sc ;
+        pointer  args ;
+        pointer  kind ;
+        const  char  *caller ;
+#    endif
+
+{    /* Local variables. */
+    pointer  data, derived, function, future ;
+
+
+
+/* Get the argument(s). */
+
+    future = car (args) ;
+    if (!futIsFuture (sc, future) ||
+        !is_opaque (sc, FUT_DISPATCHER (future), OpaqueDispatcher)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Invalid future specification: ", caller) ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    function = car (args) ;
+
+    args = cdr (args) ;
+    data = args ;		/* () or (<userData>). */
+
+/* Create the derived future and queue the function to be called when the
+   future settles. */
+
+    derived = futNew (sc, FUT_DISPATCHER (future)) ;
+
+    futWait (sc, future, kind, function, data, derived) ;
+
+    return (derived) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futDiscard ()
+
+    Cancel the Functions Queued with a Detached Dispatcher.
+
+
+Purpose:
+
+    Function futDiscard() is called by soxDetach() when it discards a
+    dispatcher's queue of deferred work with a queue of future functions
+    in it.  The functions will never be called, so their derived futures
+    are rejected with the symbol CANCELED and the queue is freed.  If the
+    dispatcher was detached by one of the functions being called by
+    futFlush(), the rest are canceled and the queue freed by futFlush().
+
+
+    Invocation:
+
+        status = futDiscard (userData) ;
+
+    where:
+
+        <userData>	- I
+            is the address of the FutQueue structure.
+        <status>	- O
+            always returns zero.
+
+*******************************************************************************/
+
+
+static  errno_t  futDiscard (
+
+#    if PROTOTYPES
+        void  *userData)
+#    else
+        userData)
+
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    FutQueue  *queue = (FutQueue *) userData ;
+
+
+
+    LGI "(futDiscard) Dispatcher %p detached.\n", (void *) queue->dispatcher) ;
+
+    queue->canceled = true ;
+    if (!queue->flushing)  futRelease (queue) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futEnqueue ()
+
+    Queue a Function Call with a Future's Dispatcher.
+
+
+Purpose:
+
+    Function futEnqueue() queues a THEN or CATCH waiter with the dispatcher
+    of the future on which it was waiting, to be called at the start of
+    the dispatcher's next iteration.  If the dispatcher has been destroyed
+    or detached, the waiter's derived future is rejected instead.
+
+
+    Invocation:
+
+        status = futEnqueue (sc, future, waiter) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <future>	- I
+            is the settled future.
+        <waiter>	- I
+            is the waiter record.
+        <status>	- O
+            returns the status of queuing the call, zero if there were no
+            errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  futEnqueue (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  future,
+        pointer  waiter)
+#    else
+        sc, future, waiter)
+
+        scheme  *sc ;
+        pointer  future ;
+        pointer  waiter ;
+#    endif
+
+{    /* Local variables. */
+    FutQueue  *queue ;
+    IoxDispatcher  dispatcher ;
+    pointer  entry ;
+
+
+
+/* If the dispatcher has been destroyed (its handle released), the function
+   can never be called. */
+
+    dispatcher = (IoxDispatcher) opaque_value (sc, FUT_DISPATCHER (future)) ;
+    if (dispatcher == NULL) {
+        futSettle (sc, WAIT_TARGET (waiter), sym.rejected, sym.canceled) ;
+        return (0) ;
+    }
+
+/* Find or create the dispatcher's queue. */
+
+    for (queue = TS (sc, futQueues) ;  queue != NULL ;  queue = queue->next) {
+        if (queue->dispatcher == dispatcher)  break ;
+    }
+
+    if (queue == NULL) {
+        queue = (FutQueue *) calloc (1, sizeof (FutQueue)) ;
+        if (queue == NULL) {
+            LGE "(futEnqueue) Error allocating FutQueue structure.\ncalloc: ") ;
+            return (errno) ;
+        }
+        queue->dispatcher = dispatcher ;
+        queue->sc = sc ;
+        queue->head = cons (sc, sc->F, sc->NIL) ;
+        queue->headID = gc_protect (sc, queue->head) ;
+        queue->tail = queue->head ;
+        queue->flush.func = futFlush ;
+        queue->flush.discard = futDiscard ;
+        queue->flush.userData = queue ;
+        queue->next = TS (sc, futQueues) ;
+        TS (sc, futQueues) = queue ;
+    }
+
+/* Append the (<waiter> . <future>) entry to the queue.  A canceled queue
+   is no longer deferred; its entries are rejected by futRelease(). */
+
+    entry = cons (sc, cons (sc, waiter, future), sc->NIL) ;
+    set_cdr (queue->tail, entry) ;
+    queue->tail = entry ;
+
+    if (queue->canceled)  return (0) ;
+
+    return (soxDefer (dispatcher, &queue->flush)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futFlush ()
+
+    Call the Functions Queued with a Dispatcher.
+
+
+Purpose:
+
+    Function futFlush() is the deferred-work function for a dispatcher's
+    queue of future functions.  The queue is detached and the functions are
+    called, in the order queued, in a single batch: the batch is bracketed
+    once for the stall watchdog, and settling the derived futures queues
+    any further functions for the next iteration rather than calling them
+    now.  If one of the functions detaches the dispatcher, the functions
+    remaining in the batch are not called; their derived futures are
+    rejected with the symbol CANCELED and the queue is freed.
+
+
+    Invocation:
+
+        status = futFlush (userData) ;
+
+    where:
+
+        <userData>	- I
+            is the address of the FutQueue structure.
+        <status>	- O
+            returns the status of calling the functions, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  futFlush (
+
+#    if PROTOTYPES
+        void  *userData)
+#    else
+        userData)
+
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    bool  failed ;
+    FutQueue  *queue = (FutQueue *) userData ;
+    int  retcode ;
+    pointer  batch, entry, future, state, waiter ;
+    scheme  *sc ;
+    SoxActivity  activity ;
+    UniqueID  batchID ;
+
+
+
+    sc = queue->sc ;
+
+/* Detach the queued entries, keeping them protected until they have all
+   been processed. */
+
+    batch = cdr (queue->head) ;
+    if (batch == sc->NIL)  return (0) ;
+
+    batchID = gc_protect (sc, batch) ;
+    set_cdr (queue->head, sc->NIL) ;
+    queue->tail = queue->head ;
+
+    futSymbols (sc) ;
+
+    activity.kind = "future" ;
+    activity.name = NULL ;
+    activity.sc = sc ;
+
+    soxEnter (queue->dispatcher, &activity) ;
+    queue->flushing = true ;
+
+    for ( ;  batch != sc->NIL ;  batch = cdr (batch)) {
+
+        entry = car (batch) ;
+        waiter = car (entry) ;
+        future = cdr (entry) ;
+        state = FUT_STATE (future) ;
+
+        if (queue->canceled) {
+            futSettle (sc, WAIT_TARGET (waiter), sym.rejected, sym.canceled) ;
+            continue ;
+        }
+
+/* If the function doesn't apply to the outcome (e.g., a CATCH function and
+   the future was resolved), pass the outcome through to the derived future. */
+
+        if (((WAIT_KIND (waiter) == sym.thenKind) && (state != sym.resolved)) ||
+            ((WAIT_KIND (waiter) == sym.catchKind) && (state != sym.rejected))) {
+            futSettle (sc, WAIT_TARGET (waiter), state, FUT_VALUE (future)) ;
+            continue ;
+        }
+
+/* Otherwise, call the function and settle the derived future with the
+   result.  An error in the function rejects the derived future. */
+
+        retcode = sc->retcode ;
+        sc->retcode = 0 ;
+
+        scheme_call (sc, WAIT_FUNCTION (waiter),
+                     cons (sc, FUT_VALUE (future), WAIT_DATA (waiter))) ;
+        queue->calls++ ;
+
+        failed = (sc->retcode != 0) ;
+        if (!failed)  sc->retcode = retcode ;
+
+        if (failed)
+            futSettle (sc, WAIT_TARGET (waiter), sym.rejected, sym.error) ;
+        else
+            futSettle (sc, WAIT_TARGET (waiter), sym.resolved, sc->value) ;
+
+    }
+
+    queue->flushing = false ;
+    soxLeave (queue->dispatcher, &activity) ;
+
+    queue->batches++ ;
+    gc_unprotect (sc, batchID) ;
+
+    LGI "(futFlush) Dispatcher %p: %lu batches, %lu calls.\n",
+        (void *) queue->dispatcher, queue->batches, queue->calls) ;
+
+    if (queue->canceled)  futRelease (queue) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futIOCB ()
+
+    Resolve a Future on an I/O Event.
+
+
+Purpose:
+
+    Function futIOCB() is the IOX callback for FUTURE-ONIO.  On the first
+    I/O event, it resolves the future with the reason and cancels the
+    callback; when the callback is canceled, the FutWatch structure is
+    released.  If the dispatcher is running a bounded slice whose budget
+    is spent, the event is left for the next slice.
+
+
+    Invocation:
+
+        status = futIOCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the IOX callback.
+        <reason>	- I
+            is the reason (e.g., IoxRead, IoxCancel) the callback is being
+            invoked.
+        <userData>	- I
+            is the address of the FutWatch structure.
+        <status>	- O
+            returns the status of handling the event, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  futIOCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    FutWatch  *watch = (FutWatch *) userData ;
+    scheme  *sc ;
+
+
+
+    sc = watch->sc ;
+
+    if (reason == IoxCancel) {
+        gc_unprotect (sc, watch->futureID) ;
+        free (watch) ;
+        return (0) ;
+    }
+
+    if (soxSliceDone (watch->dispatcher))  return (0) ;
+
+    futSymbols (sc) ;
+    futSettle (sc, gc_retrieve (sc, watch->futureID),
+               sym.resolved, mk_integer (sc, (long) reason)) ;
+
+    return (ioxCancel (callback)) ;	/* Releases the FutWatch structure. */
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futIsFuture ()
+
+    Check if a Scheme Object is a Future.
+
+
+Purpose:
+
+    Function futIsFuture() checks if a Scheme object is a future.
+
+
+    Invocation:
+
+        isFuture = futIsFuture (sc, object) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <object>	- I
+            is the object.
+        <isFuture>	- O
+            returns true if the object is a future and false otherwise.
+
+*******************************************************************************/
+
+
+static  bool  futIsFuture (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  object)
+#    else
+        sc, object)
+
+        scheme  *sc ;
+        pointer  object ;
+#    endif
+
+{    /* Local variables. */
+    int  i ;
+
+
+
+    if (!is_pair (object) || (car (object) != sym.tag))  return (false) ;
+
+    for (i = 0 ;  i < 3 ;  i++) {
+        object = cdr (object) ;
+        if (!is_pair (object))  return (false) ;
+    }
+
+    return (true) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futNew ()
+
+    Create a Pending Future.
+
+
+Purpose:
+
+    Function futNew() creates a pending future.
+
+
+    Invocation:
+
+        future = futNew (sc, dispatcher) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <dispatcher>	- I
+            is the Scheme (opaque) object for the future's dispatcher.
+        <future>	- O
+            returns the new future.
+
+*******************************************************************************/
+
+
+static  pointer  futNew (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  dispatcher)
+#    else
+        sc, dispatcher)
+
+        scheme  *sc ;
+        pointer  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    pointer  future ;
+
+
+
+    future = cons (sc, sc->NIL, dispatcher) ;		/* Waiters. */
+    future = cons (sc, sc->F, future) ;			/* Value. */
+    future = cons (sc, sym.pending, future) ;		/* State. */
+    future = cons (sc, sym.tag, future) ;
+
+    return (future) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futNotify ()
+
+    Pass a Settled Future's Outcome to a Waiter.
+
+
+Purpose:
+
+    Function futNotify() passes the outcome of a settled future to one of
+    the future's waiters.  Forwarding waiters settle their targets directly;
+    waiters with functions are queued with the dispatcher.
+
+
+    Invocation:
+
+        futNotify (sc, future, waiter) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <future>	- I
+            is the settled future.
+        <waiter>	- I
+            is the waiter record.
+
+*******************************************************************************/
+
+
+static  void  futNotify (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  future,
+        pointer  waiter)
+#    else
+        sc, future, waiter)
+
+        scheme  *sc ;
+        pointer  future ;
+        pointer  waiter ;
+#    endif
+
+{    /* Local variables. */
+    long  count ;
+    pointer  aggregate, kind, state ;
+
+
+
+    kind = WAIT_KIND (waiter) ;
+    state = FUT_STATE (future) ;
+
+    if (kind == sym.forwardKind) {
+
+        futSettle (sc, WAIT_TARGET (waiter), state, FUT_VALUE (future)) ;
+
+    } else if (kind == sym.allKind) {
+
+        if (state == sym.rejected) {
+            futSettle (sc, WAIT_TARGET (waiter), state, FUT_VALUE (future)) ;
+            return ;
+        }
+
+        aggregate = WAIT_FUNCTION (waiter) ;
+        set_car (WAIT_DATA (waiter), FUT_VALUE (future)) ;
+        count = ivalue (car (aggregate)) - 1 ;
+        set_car (aggregate, mk_integer (sc, count)) ;
+        if (count == 0)
+            futSettle (sc, WAIT_TARGET (waiter), sym.resolved, cdr (aggregate)) ;
+
+    } else {
+
+        futEnqueue (sc, future, waiter) ;
+
+    }
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futRelease ()
+
+    Reject a Queue's Functions and Free the Queue.
+
+
+Purpose:
+
+    Function futRelease() rejects, with the symbol CANCELED, the derived
+    futures of the functions in a canceled queue, unlinks the queue from
+    its interpreter's list, and frees it.  Rejecting a derived future may
+    queue the functions waiting on it; these are appended to the same queue
+    (which is no longer deferred) and rejected in turn.
+
+
+    Invocation:
+
+        futRelease (queue) ;
+
+    where:
+
+        <queue>		- I
+            is the queue, already removed from its dispatcher.
+
+*******************************************************************************/
+
+
+static  void  futRelease (
+
+#    if PROTOTYPES
+        FutQueue  *queue)
+#    else
+        queue)
+
+        FutQueue  *queue ;
+#    endif
+
+{    /* Local variables. */
+    FutQueue  *prev ;
+    pointer  entry ;
+    scheme  *sc = queue->sc ;
+
+
+
+    futSymbols (sc) ;
+
+/* Reject the derived futures.  Each entry is left in the (protected) list
+   until its future has been settled. */
+
+    while ((entry = cdr (queue->head)) != sc->NIL) {
+        futSettle (sc, WAIT_TARGET (car (car (entry))),
+                   sym.rejected, sym.canceled) ;
+        set_cdr (queue->head, cdr (entry)) ;
+        if (queue->tail == entry)  queue->tail = queue->head ;
+    }
+
+/* Unlink the queue and free it. */
+
+    if (TS (sc, futQueues) == queue) {
+        TS (sc, futQueues) = queue->next ;
+    } else {
+        for (prev = TS (sc, futQueues) ;  prev->next != queue ;
+             prev = prev->next)
+            ;
+        prev->next = queue->next ;
+    }
+
+    gc_unprotect (sc, queue->headID) ;
+    free (queue) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futSettle ()
+
+    Settle a Future.
+
+
+Purpose:
+
+    Function futSettle() resolves or rejects a pending future and passes
+    the outcome on to the future's waiters.  Resolving a future with
+    another future makes the first follow the second instead.
+
+
+    Invocation:
+
+        settled = futSettle (sc, future, state, value) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <future>	- I
+            is the future.
+        <state>		- I
+            is the new state, RESOLVED or REJECTED.
+        <value>		- I
+            is the value or reason.
+        <settled>	- O
+            returns true if the future was pending and false if it had
+            already been settled.
+
+*******************************************************************************/
+
+
+static  bool  futSettle (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  future,
+        pointer  state,
+        pointer  value)
+#    else
+        sc, future, state, value)
+
+        scheme  *sc ;
+        pointer  future ;
+        pointer  state ;
+        pointer  value ;
+#    endif
+
+{    /* Local variables. */
+    pointer  list, next, waiters ;
+
+
+
+    if (FUT_STATE (future) != sym.pending)  return (false) ;
+
+/* A future resolved with a future adopts the latter's outcome. */
+
+    if ((state == sym.resolved) && futIsFuture (sc, value) &&
+        (value != future)) {
+        futWait (sc, value, sym.forwardKind, sc->NIL, sc->NIL, future) ;
+        return (true) ;
+    }
+
+    set_car (cdr (future), state) ;
+    set_car (cdr (cdr (future)), value) ;
+
+/* Notify the waiters, in the order they were added (the list is kept in
+   reverse order).  The list is left attached to the future, and thus
+   protected, until all have been notified. */
+
+    waiters = sc->NIL ;
+    for (list = FUT_WAITERS (future) ;  list != sc->NIL ;  list = next) {
+        next = cdr (list) ;
+        set_cdr (list, waiters) ;
+        waiters = list ;
+    }
+    set_car (cdr (cdr (cdr (future))), waiters) ;
+
+    for ( ;  waiters != sc->NIL ;  waiters = cdr (waiters))
+        futNotify (sc, future, car (waiters)) ;
+
+    set_car (cdr (cdr (cdr (future))), sc->NIL) ;
+
+    return (true) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futSymbols ()
+
+    Look Up the Symbols Used by the Package.
+
+
+Purpose:
+
+    Function futSymbols() looks up the symbols used by the FUNCS_FUT package
+    if it hasn't already done so for the interpreter.
+
+
+    Invocation:
+
+        futSymbols (sc) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+static  void  futSymbols (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{
+
+    if (sym.sc == sc)  return ;
+
+    sym.tag = mk_symbol (sc, "*future*") ;
+    sym.pending = mk_symbol (sc, "pending") ;
+    sym.resolved = mk_symbol (sc, "resolved") ;
+    sym.rejected = mk_symbol (sc, "rejected") ;
+    sym.thenKind = mk_symbol (sc, "then") ;
+    sym.catchKind = mk_symbol (sc, "catch") ;
+    sym.forwardKind = mk_symbol (sc, "forward") ;
+    sym.allKind = mk_symbol (sc, "all") ;
+    sym.timeout = mk_symbol (sc, "timeout") ;
+    sym.error = mk_symbol (sc, "error") ;
+    sym.canceled = mk_symbol (sc, "canceled") ;
+    sym.sc = sc ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futTimerCB ()
+
+    Settle a Future when a Timer Fires.
+
+
+Purpose:
+
+    Function futTimerCB() is the wheel timer handler for FUTURE-AFTER and
+    FUTURE-TIMEOUT.  When the timer fires, the future is resolved or
+    rejected (if it is still pending); when the timer is canceled, which
+    happens automatically after it fires, the FutTimer structure is
+    released.
+
+
+    Invocation:
+
+        status = futTimerCB (timer, reason, userData) ;
+
+    where:
+
+        <timer>		- I
+            is the handle of the timer.
+        <reason>	- I
+            is the reason (IoxFire or IoxCancel) the handler is being invoked.
+        <userData>	- I
+            is the address of the FutTimer structure.
+        <status>	- O
+            returns the status of handling the timer, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  futTimerCB (
+
+#    if PROTOTYPES
+        TwlTimer  timer,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        timer, reason, userData)
+
+        TwlTimer  timer ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    FutTimer  *ft = (FutTimer *) userData ;
+    scheme  *sc ;
+
+
+
+    sc = ft->sc ;
+
+    if (reason == IoxCancel) {
+        gc_unprotect (sc, ft->futureID) ;
+        gc_unprotect (sc, ft->valueID) ;
+        free (ft) ;
+        return (0) ;
+    }
+
+    futSymbols (sc) ;
+    futSettle (sc, gc_retrieve (sc, ft->futureID),
+               ft->reject ? sym.rejected : sym.resolved,
+               gc_retrieve (sc, ft->valueID)) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    futWait ()
+
+    Add a Waiter to a Future.
+
+
+Purpose:
+
+    Function futWait() creates a waiter record and adds it to a future's
+    list of waiters.  If the future has already been settled, the waiter
+    is notified at once.
+
+
+    Invocation:
+
+        futWait (sc, future, kind, function, data, target) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <future>	- I
+            is the future to wait on.
+        <kind>		- I
+            is the kind of waiter: THEN, CATCH, FORWARD, or ALL.
+        <function>	- I
+            is the function to call (THEN or CATCH), the aggregate (ALL),
+            or () (FORWARD).
+        <data>		- I
+            is the user-data list (THEN or CATCH), the pair in the list of
+            values (ALL), or () (FORWARD).
+        <target>	- I
+            is the future settled by the waiter.
+
+*******************************************************************************/
+
+
+static  void  futWait (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  future,
+        pointer  kind,
+        pointer  function,
+        pointer  data,
+        pointer  target)
+#    else
+        sc, future, kind, function, data, target)
+
+        scheme  *sc ;
+        pointer  future ;
+        pointer  kind ;
+        pointer  function ;
+        pointer  data ;
+        pointer  target ;
+#    endif
+
+{    /* Local variables. */
+    pointer  waiter, waiters ;
+
+
+
+    waiter = cons (sc, data, target) ;
+    waiter = cons (sc, function, waiter) ;
+    waiter = cons (sc, kind, waiter) ;
+
+/* Add the waiter to the list - even if the future has already settled, so
+   that the waiter is protected while it is being notified. */
+
+    waiters = FUT_WAITERS (future) ;
+    set_car (cdr (cdr (cdr (future))), cons (sc, waiter, waiters)) ;
+
+    if (FUT_STATE (future) != sym.pending) {
+        futNotify (sc, future, waiter) ;
+        set_car (cdr (cdr (cdr (future))), waiters) ;
+    }
+
+    return ;
+
+}
@@ -0,0 +1,2132 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    funcs_htb.c
+
+    Hash Table Functions.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The FUNCS_HTB package defines hash tables in the style of SRFI-69, for
+    the connection tables, caches, and routing maps that would otherwise be
+    association lists searched from front to back.
+
+        (define clients (make-hash-table eqv?))
+        (hash-table-set! clients (tcp-fd client) client)
+        (hash-table-ref/default clients fd #f)
+        (hash-table-update!/default counts name (lambda (n) (+ n 1)) 0)
+        (hash-table-walk clients (lambda (fd client) ...))
+
+    A table compares keys with EQ?, EQV?, EQUAL? (the default), or STRING=?,
+    and hashes them accordingly: by address for EQ?, by value for numbers
+    and characters under EQV?, and by content for strings, lists, vectors,
+    and bytevectors under EQUAL? and STRING=?.  Under EQUAL?, two opaque handles
+    for the same C object are the same key.  (TinyScheme never moves objects,
+    so addresses are stable.)  A hash function passed to MAKE-HASH-TABLE
+    is accepted for compatibility but ignored.
+
+    The tables are built entirely out of ordinary Scheme cells, so the
+    garbage collector traces them like any other object and nothing needs
+    to be freed.  A table is a list tagged with the symbol *HASH-TABLE*:
+
+        (*hash-table* <kind> <count> <base> <split> . <directory>)
+
+    The buckets are association lists kept in "leaf" vectors, which are
+    found through the <directory> vector.  TinyScheme allocates a vector in
+    consecutive cells of a single heap segment, so no one vector can be very
+    large; the leaves are at most HTB_LEAF buckets and the directory, which
+    is replaced by one twice the size when it fills, at most HTB_DIRECTORY
+    leaves.  The first leaves are small and double in size, so a small
+    table costs only a few dozen cells.
+
+    Tables grow by linear hashing: whenever the average bucket holds more
+    than HTB_LOAD entries, one more bucket is added and the entries of a
+    single existing bucket are split between the two.  There is never a
+    pause to rehash the whole table, and a lookup examines one short bucket
+    no matter how large the table becomes.  <base> is the number of buckets
+    at the start of the current round of splitting and <split> is the next
+    bucket to split; the table has <base> + <split> buckets.  Deleting
+    entries does not shrink the table.
+
+        (alist->hash-table <alist> [<equivalence>])
+						=> <table>
+        (hash-table? <object>)			=> <status>   (#t|#f)
+        (hash-table->alist <table>)		=> <alist>
+        (hash-table-clear! <table>)		=> <table>
+        (hash-table-contains? <table> <key>)	=> <status>   (#t|#f)
+        (hash-table-count <table>)		=> <count>
+        (hash-table-delete! <table> <key>)	=> <status>   (#t|#f)
+        (hash-table-entry <table> <key>)	=> (<key> . <value>)|#f
+        (hash-table-exists? <table> <key>)	=> <status>   (#t|#f)
+        (hash-table-fold <table> <kons> <knil>)	=> <value>
+        (hash-table-keys <table>)		=> <list>
+        (hash-table-ref <table> <key> [<thunk>])
+						=> <value>
+        (hash-table-ref/default <table> <key>
+                                <default>)	=> <value>
+        (hash-table-set! <table> <key> <value>)	=> <table>
+        (hash-table-size <table>)		=> <count>
+        (hash-table-stats <table>)		=> <list>     (Statistics)
+        (hash-table-update! <table> <key>
+                            <function> [<thunk>])
+						=> <value>
+        (hash-table-update!/default <table> <key>
+                                    <function> <default>)
+						=> <value>
+        (hash-table-values <table>)		=> <list>
+        (hash-table-walk <table> <function>)
+        (make-hash-table [<equivalence> [<hash>]])
+						=> <table>
+
+    HASH-TABLE-ENTRY returns the pair holding a key and its value, whose
+    value (but not key) may be changed with SET-CDR!.  HASH-TABLE-REF,
+    HASH-TABLE-UPDATE!, and the iteration functions are defined in Scheme
+    on top of the C functions; HASH-TABLE-WALK and HASH-TABLE-FOLD iterate
+    over a snapshot of the table, so the function may modify the table.
+
+
+Public Procedures:
+
+    addFuncsHTB() - registers the functions with the Scheme intepreter.
+
+Private Procedures:
+
+    func_HASH_TABLE_P() - implements the HASH-TABLE? function.
+    func_HASH_TABLE_TO_ALIST() - implements the HASH-TABLE->ALIST function.
+    func_HASH_TABLE_CLEAR() - implements the HASH-TABLE-CLEAR! function.
+    func_HASH_TABLE_COUNT() - implements the HASH-TABLE-COUNT function.
+    func_HASH_TABLE_DELETE() - implements the HASH-TABLE-DELETE! function.
+    func_HASH_TABLE_ENTRY() - implements the HASH-TABLE-ENTRY function.
+    func_HASH_TABLE_EXISTS() - implements the HASH-TABLE-EXISTS? function.
+    func_HASH_TABLE_KEYS() - implements the HASH-TABLE-KEYS function.
+    func_HASH_TABLE_REF_DEFAULT() - implements the HASH-TABLE-REF/DEFAULT
+        function.
+    func_HASH_TABLE_SET() - implements the HASH-TABLE-SET! function.
+    func_HASH_TABLE_STATS() - implements the HASH-TABLE-STATS function.
+    func_HASH_TABLE_VALUES() - implements the HASH-TABLE-VALUES function.
+    func_MAKE_HASH_TABLE() - implements the MAKE-HASH-TABLE function.
+    htbBucket() - locates a bucket in a table.
+    htbEqual() - compares two keys.
+    htbFind() - finds a key's entry in a table.
+    htbHash() - hashes a key.
+    htbInit() - empties a table.
+    htbIsTable() - checks if a Scheme object is a hash table.
+    htbList() - lists a table's entries, keys, or values.
+    htbSplit() - adds a bucket to a table.
+    htbSymbols() - looks up the symbols used by the package.
+    htbVector() - makes a vector.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <string.h>			/* C Library string functions. */
+#include  "tsion.h"			/* TinyScheme I/O Network functions. */
+#include  "gc_util.h"			/* Garbage collection utilities. */
+
+
+/*******************************************************************************
+    Table layout - (*hash-table* <kind> <count> <base> <split> . <directory>).
+        <count>, <base>, and <split> are integer cells private to the table,
+        which are updated in place rather than replaced.
+*******************************************************************************/
+
+#define  HTB_KIND(t)		car (cdr (t))
+#define  HTB_COUNT(t)		car (cdr (cdr (t)))
+#define  HTB_BASE(t)		car (cdr (cdr (cdr (t))))
+#define  HTB_SPLIT(t)		car (cdr (cdr (cdr (cdr (t)))))
+#define  HTB_DIRECTORY(t)	cdr (cdr (cdr (cdr (cdr (t)))))
+
+#define  HTB_SET_INTEGER(p, n)	((p)->_object._number.value.ivalue = (n))
+
+typedef  enum  HtbKind {
+    HtbEq = 0,				/* EQ? */
+    HtbEqv,				/* EQV? */
+    HtbEqual,				/* EQUAL? */
+    HtbString				/* STRING=? */
+}  HtbKind ;
+
+					/* Buckets in a new table. */
+#define  HTB_INITIAL  16
+					/* Largest leaf (buckets). */
+#define  HTB_LEAF  1024
+					/* Largest directory (leaves). */
+#define  HTB_DIRECTORY_MAX  4096
+					/* Average entries per bucket. */
+#ifndef HTB_LOAD
+#    define  HTB_LOAD  2
+#endif
+					/* Nodes hashed in an EQUAL? key. */
+#define  HTB_HASH_NODES  32
+
+/* Leaf vectors 0 through HTB_LEAF_SMALL-1 hold buckets 0-15, 16-31, 32-63,
+   ..., 512-1023, doubling in size; after that, every leaf holds HTB_LEAF
+   buckets. */
+
+#define  HTB_LEAF_SMALL  7
+
+/* Symbols used by the package, looked up once per interpreter rather than
+   on every call.  Interned symbols are never garbage collected. */
+
+static  struct  {
+    scheme  *sc ;
+    pointer  tag ;
+}  sym = { NULL } ;
+
+
+/*******************************************************************************
+    Private functions.
+*******************************************************************************/
+
+static  pointer  func_HASH_TABLE_P P_((scheme *sc, pointer args)) ;
+static  pointer  func_HASH_TABLE_TO_ALIST P_((scheme *sc, pointer args)) ;
+static  pointer  func_HASH_TABLE_CLEAR P_((scheme *sc, pointer args)) ;
+static  pointer  func_HASH_TABLE_COUNT P_((scheme *sc, pointer args)) ;
+static  pointer  func_HASH_TABLE_DELETE P_((scheme *sc, pointer args)) ;
+static  pointer  func_HASH_TABLE_ENTRY P_((scheme *sc, pointer args)) ;
+static  pointer  func_HASH_TABLE_EXISTS P_((scheme *sc, pointer args)) ;
+static  pointer  func_HASH_TABLE_KEYS P_((scheme *sc, pointer args)) ;
+static  pointer  func_HASH_TABLE_REF_DEFAULT P_((scheme *sc, pointer args)) ;
+static  pointer  func_HASH_TABLE_SET P_((scheme *sc, pointer args)) ;
+static  pointer  func_HASH_TABLE_STATS P_((scheme *sc, pointer args)) ;
+static  pointer  func_HASH_TABLE_VALUES P_((scheme *sc, pointer args)) ;
+static  pointer  func_MAKE_HASH_TABLE P_((scheme *sc, pointer args)) ;
+
+static  pointer  htbBucket P_((scheme *sc,
+                               pointer table,
+                               long bucket,
+                               bool create,
+                               int *slot)) ;
+
+static  bool  htbEqual P_((HtbKind kind,
+                           pointer a,
+                           pointer b)) ;
+
+static  pointer  htbFind P_((scheme *sc,
+                             pointer table,
+                             pointer key,
+                             pointer *leaf,
+                             int *slot,
+                             pointer *previous)) ;
+
+static  unsigned  long  htbHash P_((HtbKind kind,
+                                    pointer key)) ;
+
+static  errno_t  htbInit P_((scheme *sc,
+                             pointer table)) ;
+
+static  bool  htbIsTable P_((scheme *sc,
+                             pointer object,
+                             const char *caller)) ;
+
+static  pointer  htbList P_((scheme *sc,
+                             pointer table,
+                             int what)) ;
+
+static  void  htbSplit P_((scheme *sc,
+                           pointer table)) ;
+
+static  void  htbSymbols P_((scheme *sc)) ;
+
+static  pointer  htbVector P_((scheme *sc,
+                               int length)) ;
+
+/*!*****************************************************************************
+
+Procedure:
+
+    addFuncsHTB ()
+
+    Register the Hash Table Functions with the Scheme Interpreter.
+
+
+Purpose:
+
+    Function addFuncsHTB() registers the hash table functions as foreign
+    functions with the Scheme interpreter and defines the functions that
+    are written in Scheme.  It also captures the built-in MAKE-VECTOR
+    procedure, with which the tables' vectors are allocated, and protects
+    it from the garbage collector.
+
+
+    Invocation:
+
+        addFuncsHTB (sc) ;
+
+    where
+
+        <sc>	- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+void  addFuncsHTB (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{
+
+/* Capture MAKE-VECTOR once, rather than looking it up by name whenever a
+   bucket is added; this also keeps tables working if Scheme code redefines
+   MAKE-VECTOR.  The procedure stays protected for the interpreter's life. */
+
+    TS (sc, makeVector) = scheme_eval (sc, mk_symbol (sc, "make-vector")) ;
+    gc_protect (sc, TS (sc, makeVector)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table?"),
+                   mk_foreign_func (sc, func_HASH_TABLE_P)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table->alist"),
+                   mk_foreign_func (sc, func_HASH_TABLE_TO_ALIST)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table-clear!"),
+                   mk_foreign_func (sc, func_HASH_TABLE_CLEAR)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table-count"),
+                   mk_foreign_func (sc, func_HASH_TABLE_COUNT)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table-delete!"),
+                   mk_foreign_func (sc, func_HASH_TABLE_DELETE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table-entry"),
+                   mk_foreign_func (sc, func_HASH_TABLE_ENTRY)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table-exists?"),
+                   mk_foreign_func (sc, func_HASH_TABLE_EXISTS)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table-keys"),
+                   mk_foreign_func (sc, func_HASH_TABLE_KEYS)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table-ref/default"),
+                   mk_foreign_func (sc, func_HASH_TABLE_REF_DEFAULT)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table-set!"),
+                   mk_foreign_func (sc, func_HASH_TABLE_SET)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table-stats"),
+                   mk_foreign_func (sc, func_HASH_TABLE_STATS)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "hash-table-values"),
+                   mk_foreign_func (sc, func_HASH_TABLE_VALUES)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "make-hash-table"),
+                   mk_foreign_func (sc, func_MAKE_HASH_TABLE)) ;
+
+/* Functions that call back into Scheme are written in Scheme. */
+
+    scheme_load_string (sc,
+        "(define hash-table-contains? hash-table-exists?)") ;
+    scheme_load_string (sc,
+        "(define hash-table-size hash-table-count)") ;
+    scheme_load_string (sc,
+        "(define hash-table-ref"
+        "  (let ((missing (list 'missing)))"
+        "    (lambda (table key . thunk)"
+        "      (let ((value (hash-table-ref/default table key missing)))"
+        "        (cond ((not (eq? value missing)) value)"
+        "              ((pair? thunk) ((car thunk)))"
+        "              (else (error \"hash-table-ref: no value for key\""
+        "                           key)))))))") ;
+    scheme_load_string (sc,
+        "(define (hash-table-update! table key function . thunk)"
+        "  (let ((entry (hash-table-entry table key)))"
+        "    (if entry"
+        "        (begin (set-cdr! entry (function (cdr entry))) (cdr entry))"
+        "        (let ((value (function (apply hash-table-ref"
+        "                                      table key thunk))))"
+        "          (hash-table-set! table key value)"
+        "          value))))") ;
+    scheme_load_string (sc,
+        "(define (hash-table-update!/default table key function default)"
+        "  (hash-table-update! table key function (lambda () default)))") ;
+    scheme_load_string (sc,
+        "(define (hash-table-walk table function)"
+        "  (for-each (lambda (entry) (function (car entry) (cdr entry)))"
+        "            (hash-table->alist table)))") ;
+    scheme_load_string (sc,
+        "(define (hash-table-fold table kons knil)"
+        "  (let loop ((entries (hash-table->alist table)) (result knil))"
+        "    (if (null? entries)"
+        "        result"
+        "        (loop (cdr entries)"
+        "              (kons (caar entries) (cdar entries) result)))))") ;
+    scheme_load_string (sc,
+        "(define (alist->hash-table alist . equivalence)"
+        "  (let ((table (apply make-hash-table equivalence)))"
+        "    (for-each (lambda (entry)"
+        "                (if (not (hash-table-exists? table (car entry)))"
+        "                    (hash-table-set! table (car entry) (cdr entry))))"
+        "              alist)"
+        "    table))") ;
+
+    htbSymbols (sc) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_P ()
+
+    Check if an Object is a Hash Table.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_P() checks if an object is a hash table.
+
+        (hash-table? <object>)
+
+        Return #t if <object> is a hash table and #f otherwise.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_P (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the object.
+        <result>	- O
+            returns #t or #f.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_P (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return (htbIsTable (sc, car (args), NULL) ? sc->T : sc->F) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_TO_ALIST ()
+
+    List a Hash Table's Entries.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_TO_ALIST() returns the entries in a hash table
+    as an association list.
+
+        (hash-table->alist <table>)
+
+        Return a new association list of the (<key> . <value>) pairs in
+        <table>, in no particular order.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_TO_ALIST (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the table.
+        <result>	- O
+            returns the association list or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_TO_ALIST (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    if (!htbIsTable (sc, car (args), "func_HASH_TABLE_TO_ALIST"))
+        return (sc->F) ;
+
+    return (htbList (sc, car (args), 0)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_CLEAR ()
+
+    Empty a Hash Table.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_CLEAR() removes all the entries from a hash
+    table.
+
+        (hash-table-clear! <table>)
+
+        Remove all the entries from <table>, which shrinks back to the size
+        of a new table.  The table is returned.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_CLEAR (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the table.
+        <result>	- O
+            returns the table or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_CLEAR (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  table ;
+
+
+
+    table = car (args) ;
+    if (!htbIsTable (sc, table, "func_HASH_TABLE_CLEAR"))  return (sc->F) ;
+
+    if (htbInit (sc, table))  return (sc->F) ;
+
+    return (table) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_COUNT ()
+
+    Get the Number of Entries in a Hash Table.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_COUNT() returns the number of entries in a hash
+    table.
+
+        (hash-table-count <table>)
+
+        Return the number of keys in <table>.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_COUNT (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the table.
+        <result>	- O
+            returns the number of entries or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_COUNT (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    if (!htbIsTable (sc, car (args), "func_HASH_TABLE_COUNT"))
+        return (sc->F) ;
+
+    return (mk_integer (sc, ivalue (HTB_COUNT (car (args))))) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_DELETE ()
+
+    Delete a Key from a Hash Table.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_DELETE() removes a key and its value from a
+    hash table.
+
+        (hash-table-delete! <table> <key>)
+
+        Remove <key> from <table>.  #t is returned if the key was found
+        and #f if it wasn't.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_DELETE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the table and the key.
+        <result>	- O
+            returns #t if the key was removed and #f otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_DELETE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    int  slot ;
+    pointer  leaf, node, previous, table ;
+
+
+
+    table = car (args) ;
+    if (!htbIsTable (sc, table, "func_HASH_TABLE_DELETE"))  return (sc->F) ;
+
+    node = htbFind (sc, table, cadr (args), &leaf, &slot, &previous) ;
+    if (node == sc->NIL)  return (sc->F) ;
+
+    if (previous == sc->NIL)
+        set_vector_elem (leaf, slot, cdr (node)) ;
+    else
+        set_cdr (previous, cdr (node)) ;
+
+    HTB_SET_INTEGER (HTB_COUNT (table), ivalue (HTB_COUNT (table)) - 1) ;
+
+    return (sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_ENTRY ()
+
+    Get a Key's Entry in a Hash Table.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_ENTRY() returns the pair holding a key and its
+    value in a hash table.
+
+        (hash-table-entry <table> <key>)
+
+        Return the (<key> . <value>) pair for <key> in <table>, or #f if the
+        key is not in the table.  The value may be changed in place with
+        SET-CDR!; the key must not be changed.  This lets HASH-TABLE-UPDATE!
+        look up a key only once.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_ENTRY (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the table and the key.
+        <result>	- O
+            returns the entry or #f.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_ENTRY (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    int  slot ;
+    pointer  leaf, node, previous ;
+
+
+
+    if (!htbIsTable (sc, car (args), "func_HASH_TABLE_ENTRY"))
+        return (sc->F) ;
+
+    node = htbFind (sc, car (args), cadr (args), &leaf, &slot, &previous) ;
+
+    return ((node == sc->NIL) ? sc->F : car (node)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_EXISTS ()
+
+    Check if a Key is in a Hash Table.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_EXISTS() checks if a key is in a hash table.
+
+        (hash-table-exists? <table> <key>)
+
+        Return #t if <key> is in <table> and #f otherwise.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_EXISTS (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the table and the key.
+        <result>	- O
+            returns #t or #f.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_EXISTS (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    int  slot ;
+    pointer  leaf, previous ;
+
+
+
+    if (!htbIsTable (sc, car (args), "func_HASH_TABLE_EXISTS"))
+        return (sc->F) ;
+
+    return ((htbFind (sc, car (args), cadr (args), &leaf, &slot, &previous)
+             == sc->NIL) ? sc->F : sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_KEYS ()
+
+    List a Hash Table's Keys.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_KEYS() returns the keys in a hash table.
+
+        (hash-table-keys <table>)
+
+        Return a new list of the keys in <table>, in no particular order.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_KEYS (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the table.
+        <result>	- O
+            returns the list or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_KEYS (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    if (!htbIsTable (sc, car (args), "func_HASH_TABLE_KEYS"))
+        return (sc->F) ;
+
+    return (htbList (sc, car (args), 1)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_REF_DEFAULT ()
+
+    Look Up a Key in a Hash Table.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_REF_DEFAULT() looks up a key's value in a hash
+    table.
+
+        (hash-table-ref/default <table> <key> <default>)
+
+        Return the value of <key> in <table> or, if the key is not in the
+        table, <default>.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_REF_DEFAULT (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the table, the key, and the default
+            value.
+        <result>	- O
+            returns the value.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_REF_DEFAULT (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    int  slot ;
+    pointer  leaf, node, previous ;
+
+
+
+    if (!htbIsTable (sc, car (args), "func_HASH_TABLE_REF_DEFAULT"))
+        return (sc->F) ;
+
+    node = htbFind (sc, car (args), cadr (args), &leaf, &slot, &previous) ;
+
+    return ((node == sc->NIL) ? caddr (args) : cdar (node)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_SET ()
+
+    Set a Key's Value in a Hash Table.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_SET() adds a key to a hash table or changes
+    its value.
+
+        (hash-table-set! <table> <key> <value>)
+
+        Set the value of <key> in <table> to <value>, adding the key if it
+        is not already in the table.  The table is returned.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_SET (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the table, the key, and the value.
+        <result>	- O
+            returns the table or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_SET (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    long  buckets, count ;
+    int  slot ;
+    pointer  key, leaf, node, previous, table, value ;
+
+
+
+    table = car (args) ;
+    if (!htbIsTable (sc, table, "func_HASH_TABLE_SET"))  return (sc->F) ;
+    key = cadr (args) ;
+    value = caddr (args) ;
+
+    if ((ivalue (HTB_KIND (table)) == HtbString) && !is_string (key)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_HASH_TABLE_SET) Key is not a string: ") ;
+        return (sc->F) ;
+    }
+
+/* If the key is already in the table, change its value. */
+
+    node = htbFind (sc, table, key, &leaf, &slot, &previous) ;
+    if (node != sc->NIL) {
+        set_cdr (car (node), value) ;
+        return (table) ;
+    }
+
+/* Otherwise, add the key to the front of its bucket.  The new cells are
+   reachable from the table before anything else is allocated. */
+
+    node = cons (sc, cons (sc, key, value),
+                 vector_elem (leaf, slot)) ;
+    set_vector_elem (leaf, slot, node) ;
+
+    count = ivalue (HTB_COUNT (table)) + 1 ;
+    HTB_SET_INTEGER (HTB_COUNT (table), count) ;
+
+/* If the buckets are getting full, add one. */
+
+    buckets = ivalue (HTB_BASE (table)) + ivalue (HTB_SPLIT (table)) ;
+    if (count > (buckets * HTB_LOAD))  htbSplit (sc, table) ;
+
+    return (table) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_STATS ()
+
+    Get a Hash Table's Statistics.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_STATS() returns statistics about the shape of
+    a hash table, for checking that keys are hashing well.
+
+        (hash-table-stats <table>)
+
+        Return a list, (<count> <buckets> <used> <longest>), of the number
+        of entries in <table>, the number of buckets, the number of buckets
+        that are not empty, and the number of entries in the longest bucket.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_STATS (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the table.
+        <result>	- O
+            returns the list or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_STATS (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    long  bucket, buckets, length, longest, used ;
+    int  slot ;
+    pointer  leaf, node, result, table ;
+
+
+
+    table = car (args) ;
+    if (!htbIsTable (sc, table, "func_HASH_TABLE_STATS"))  return (sc->F) ;
+
+    buckets = ivalue (HTB_BASE (table)) + ivalue (HTB_SPLIT (table)) ;
+    used = longest = 0 ;
+
+    for (bucket = 0 ;  bucket < buckets ;  bucket++) {
+        leaf = htbBucket (sc, table, bucket, false, &slot) ;
+        length = 0 ;
+        for (node = vector_elem (leaf, slot) ;  node != sc->NIL ;
+             node = cdr (node))
+            length++ ;
+        if (length > 0)  used++ ;
+        if (length > longest)  longest = length ;
+    }
+
+    result = cons (sc, mk_integer (sc, longest), sc->NIL) ;
+    result = cons (sc, mk_integer (sc, used), result) ;
+    result = cons (sc, mk_integer (sc, buckets), result) ;
+    result = cons (sc, mk_integer (sc, ivalue (HTB_COUNT (table))), result) ;
+
+    return (result) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_HASH_TABLE_VALUES ()
+
+    List a Hash Table's Values.
+
+
+Purpose:
+
+    Function func_HASH_TABLE_VALUES() returns the values in a hash table.
+
+        (hash-table-values <table>)
+
+        Return a new list of the values in <table>, in no particular order.
+
+
+    Invocation:
+
+        result = func_HASH_TABLE_VALUES (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the table.
+        <result>	- O
+            returns the list or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_HASH_TABLE_VALUES (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    if (!htbIsTable (sc, car (args), "func_HASH_TABLE_VALUES"))
+        return (sc->F) ;
+
+    return (htbList (sc, car (args), 2)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_MAKE_HASH_TABLE ()
+
+    Create a Hash Table.
+
+
+Purpose:
+
+    Function func_MAKE_HASH_TABLE() creates an empty hash table.
+
+        (make-hash-table [<equivalence> [<hash>]])
+
+        Create an empty hash table whose keys are compared with
+        <equivalence>: one of the procedures EQ?, EQV?, EQUAL?, or STRING=?,
+        or one of the symbols EQ, EQV, EQUAL, or STRING.  The default is
+        EQUAL?.  A <hash> function is ignored; keys are hashed in a manner
+        suited to the equivalence.
+
+
+    Invocation:
+
+        result = func_MAKE_HASH_TABLE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the optional equivalence and hash
+            function.
+        <result>	- O
+            returns the table or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_MAKE_HASH_TABLE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    const  char  *name ;
+    HtbKind  kind ;
+    pointer  table ;
+
+
+
+    htbSymbols (sc) ;
+
+/* Determine the equivalence. */
+
+    if (args == sc->NIL) {
+        name = "equal" ;
+    } else if (is_symbol (car (args))) {
+        name = symname (car (args)) ;
+    } else {
+        name = global_name (sc, car (args)) ;
+        if (name == NULL)  name = "" ;
+    }
+
+    if ((strcmp (name, "eq") == 0) || (strcmp (name, "eq?") == 0)) {
+        kind = HtbEq ;
+    } else if ((strcmp (name, "eqv") == 0) || (strcmp (name, "eqv?") == 0)) {
+        kind = HtbEqv ;
+    } else if ((strcmp (name, "equal") == 0) ||
+               (strcmp (name, "equal?") == 0)) {
+        kind = HtbEqual ;
+    } else if ((strcmp (name, "string") == 0) ||
+               (strcmp (name, "string=?") == 0)) {
+        kind = HtbString ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_MAKE_HASH_TABLE) Unsupported equivalence: ") ;
+        return (sc->F) ;
+    }
+
+/* Create the table.  The integer cells are built here and only ever updated
+   in place, so they are never shared with other code. */
+
+    table = cons (sc, mk_integer (sc, 0), sc->F) ;		/* Split. */
+    table = cons (sc, mk_integer (sc, 0), table) ;		/* Base. */
+    table = cons (sc, mk_integer (sc, 0), table) ;		/* Count. */
+    table = cons (sc, mk_integer (sc, (long) kind), table) ;
+    table = cons (sc, sym.tag, table) ;
+
+    sc->value = table ;			/* Visible to GC in htbInit(). */
+    if (htbInit (sc, table))  return (sc->F) ;
+
+    return (table) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    htbBucket ()
+
+    Locate a Bucket in a Table.
+
+
+Purpose:
+
+    Function htbBucket() returns the leaf vector and the slot in it holding
+    a bucket.
+
+
+    Invocation:
+
+        leaf = htbBucket (sc, table, bucket, create, &slot) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <table>		- I
+            is the table.
+        <bucket>	- I
+            is the number of the bucket.
+        <create>	- I
+            specifies if the leaf should be allocated (and the directory
+            enlarged) if it doesn't exist yet.  Allocating a vector runs
+            the interpreter (see htbVector()), so the caller must protect
+            the table from GC beforehand.
+        <slot>		- O
+            returns the index of the bucket in the leaf.
+        <leaf>		- O
+            returns the leaf vector; NULL is returned if the leaf doesn't
+            exist and <create> is false or if the leaf couldn't be allocated.
+
+*******************************************************************************/
+
+
+static  pointer  htbBucket (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  table,
+        long  bucket,
+        bool  create,
+        int  *slot)
+#    else
+        sc, table, bucket, create, slot)
+
+        scheme  *sc ;
+        pointer  table ;
+        long  bucket ;
+        bool  create ;
+        int  *slot ;
+#    endif
+
+{    /* Local variables. */
+    long  first, i, size, length ;
+    pointer  directory, leaf, larger ;
+
+
+
+/* Compute the number of the leaf and the bucket's slot in it. */
+
+    if (bucket < HTB_INITIAL) {
+        i = 0 ;
+        first = 0 ;
+        size = HTB_INITIAL ;
+    } else if (bucket < HTB_LEAF) {
+        for (i = 1, first = HTB_INITIAL ;  (first * 2) <= bucket ;  i++)
+            first *= 2 ;
+        size = first ;
+    } else {
+        i = HTB_LEAF_SMALL + ((bucket - HTB_LEAF) / HTB_LEAF) ;
+        first = HTB_LEAF + ((i - HTB_LEAF_SMALL) * HTB_LEAF) ;
+        size = HTB_LEAF ;
+    }
+    *slot = (int) (bucket - first) ;
+
+    directory = HTB_DIRECTORY (table) ;
+    length = vector_length (directory) ;
+    leaf = (i < length) ? vector_elem (directory, i) : sc->NIL ;
+    if ((leaf != sc->NIL) || !create)
+        return ((leaf == sc->NIL) ? NULL : leaf) ;
+
+/* Allocate the leaf, first replacing the directory with a larger one if
+   the leaf won't fit.  (The caller has protected the table from GC.) */
+
+    if (i >= length) {
+        larger = htbVector (sc, (int) (length * 2)) ;
+        if (larger == NULL)  return (NULL) ;
+        for (first = 0 ;  first < length ;  first++)
+            set_vector_elem (larger, first, vector_elem (directory, first)) ;
+        set_cdr (cdr (cdr (cdr (cdr (table)))), larger) ;
+        directory = larger ;
+    }
+
+    leaf = htbVector (sc, (int) size) ;
+    if (leaf == NULL)  return (NULL) ;
+    set_vector_elem (directory, i, leaf) ;
+
+    return (leaf) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    htbEqual ()
+
+    Compare Two Keys.
+
+
+Purpose:
+
+    Function htbEqual() compares two keys under a table's equivalence.
+
+
+    Invocation:
+
+        isEqual = htbEqual (kind, a, b) ;
+
+    where
+
+        <kind>		- I
+            is the table's equivalence.
+        <a>, <b>	- I
+            are the keys.
+        <isEqual>	- O
+            returns true if the keys are equivalent and false otherwise.
+
+*******************************************************************************/
+
+
+static  bool  htbEqual (
+
+#    if PROTOTYPES
+        HtbKind  kind,
+        pointer  a,
+        pointer  b)
+#    else
+        kind, a, b)
+
+        HtbKind  kind ;
+        pointer  a ;
+        pointer  b ;
+#    endif
+
+{    /* Local variables. */
+    long  i, length ;
+
+
+
+    for ( ; ; ) {
+
+        if (a == b)  return (true) ;
+        if (kind == HtbEq)  return (false) ;
+
+        if ((kind != HtbEqv) && is_string (a) && is_string (b)) {
+            return ((strlength (a) == strlength (b)) &&
+                    (memcmp (strvalue (a), strvalue (b),
+                             (size_t) strlength (a)) == 0)) ;
+        }
+        if (kind != HtbEqual)  return (eqv (a, b) ? true : false) ;
+
+        if ((type (a) == T_OPAQUE) && (type (b) == T_OPAQUE))
+            return (opaque_key (a) == opaque_key (b)) ;	/* Same object? */
+
+        if (is_bytevector (a) && is_bytevector (b)) {
+            return ((bytevector_length (a) == bytevector_length (b)) &&
+                    (memcmp (bytevector_data (a), bytevector_data (b),
+                             bytevector_length (a)) == 0)) ;
+        }
+
+        if (is_vector (a) && is_vector (b)) {
+            length = vector_length (a) ;
+            if (length != vector_length (b))  return (false) ;
+            for (i = 0 ;  i < length ;  i++) {
+                if (!htbEqual (kind, vector_elem (a, i), vector_elem (b, i)))
+                    return (false) ;
+            }
+            return (true) ;
+        }
+
+        if (!is_pair (a) || !is_pair (b))  return (eqv (a, b) ? true : false) ;
+        if (!htbEqual (kind, car (a), car (b)))  return (false) ;
+        a = cdr (a) ;			/* Iterate, not recurse, on the tail. */
+        b = cdr (b) ;
+
+    }
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    htbFind ()
+
+    Find a Key's Entry in a Table.
+
+
+Purpose:
+
+    Function htbFind() looks up a key in a table.
+
+
+    Invocation:
+
+        node = htbFind (sc, table, key, &leaf, &slot, &previous) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <table>		- I
+            is the table.
+        <key>		- I
+            is the key.
+        <leaf>		- O
+            returns the leaf vector holding the key's bucket.
+        <slot>		- O
+            returns the index of the bucket in the leaf.
+        <previous>	- O
+            returns the node before the key's node in the bucket; '() is
+            returned if the key's node is first in the bucket.
+        <node>		- O
+            returns the key's node in the bucket, whose CAR is the key's
+            (<key> . <value>) entry; '() is returned if the key is not in
+            the table.
+
+*******************************************************************************/
+
+
+static  pointer  htbFind (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  table,
+        pointer  key,
+        pointer  *leaf,
+        int  *slot,
+        pointer  *previous)
+#    else
+        sc, table, key, leaf, slot, previous)
+
+        scheme  *sc ;
+        pointer  table ;
+        pointer  key ;
+        pointer  *leaf ;
+        int  *slot ;
+        pointer  *previous ;
+#    endif
+
+{    /* Local variables. */
+    long  base, bucket ;
+    HtbKind  kind ;
+    pointer  node ;
+    unsigned  long  hash ;
+
+
+
+    kind = (HtbKind) ivalue (HTB_KIND (table)) ;
+    hash = htbHash (kind, key) ;
+
+/* Under linear hashing, buckets before the split point have already been
+   split and are addressed with one more bit of the hash. */
+
+    base = ivalue (HTB_BASE (table)) ;
+    bucket = (long) (hash & (unsigned long) (base - 1)) ;
+    if (bucket < ivalue (HTB_SPLIT (table)))
+        bucket = (long) (hash & (unsigned long) (2 * base - 1)) ;
+
+    *leaf = htbBucket (sc, table, bucket, false, slot) ;
+    *previous = sc->NIL ;
+
+    for (node = vector_elem (*leaf, *slot) ;  node != sc->NIL ;
+         node = cdr (node)) {
+        if (htbEqual (kind, caar (node), key))  break ;
+        *previous = node ;
+    }
+
+    return (node) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    htbHash ()
+
+    Hash a Key.
+
+
+Purpose:
+
+    Function htbHash() computes a key's hash value under a table's
+    equivalence.  Equivalent keys always have the same hash value.
+
+
+    Invocation:
+
+        hash = htbHash (kind, key) ;
+
+    where
+
+        <kind>		- I
+            is the table's equivalence.
+        <key>		- I
+            is the key.
+        <hash>		- O
+            returns the hash value.
+
+*******************************************************************************/
+
+
+static  unsigned  long  htbHash (
+
+#    if PROTOTYPES
+        HtbKind  kind,
+        pointer  key)
+#    else
+        kind, key)
+
+        HtbKind  kind ;
+        pointer  key ;
+#    endif
+
+{    /* Local variables. */
+    double  real ;
+    long  i, length ;
+    int  nodes ;
+    pointer  stack[HTB_HASH_NODES] ;
+    int  top ;
+    unsigned  char  *s ;
+    unsigned  long  hash, h ;
+
+
+
+    hash = 2166136261UL ;
+    nodes = 0 ;
+    top = 0 ;
+
+    for ( ; ; ) {
+
+        if (((kind == HtbEqual) || (kind == HtbString)) && is_string (key)) {
+            h = 2166136261UL ;			/* FNV-1a. */
+            s = (unsigned char *) strvalue (key) ;
+            for (i = strlength (key) ;  i > 0 ;  i--)
+                h = (h ^ *s++) * 16777619UL ;
+        } else if ((kind != HtbEq) && isInteger (key)) {
+            h = (unsigned long) ivalue (key) ;
+        } else if ((kind != HtbEq) && is_number (key)) {
+            real = rvalue (key) ;
+            if (real == 0.0)  real = 0.0 ;	/* -0.0 is EQV? to 0.0. */
+            h = 0 ;
+            memcpy (&h, &real, (sizeof h < sizeof real) ? sizeof h
+                                                       : sizeof real) ;
+        } else if ((kind != HtbEq) && is_character (key)) {
+            h = (unsigned long) charvalue (key) ;
+        } else if ((kind == HtbEqual) && (type (key) == T_OPAQUE)) {
+            h = opaque_key (key) ;
+        } else if ((kind == HtbEqual) && is_bytevector (key)) {
+            h = 2166136261UL ;			/* FNV-1a. */
+            s = bytevector_data (key) ;
+            for (i = (long) bytevector_length (key) ;  i > 0 ;  i--)
+                h = (h ^ *s++) * 16777619UL ;
+        } else if ((kind == HtbEqual) && is_pair (key)) {
+            h = 0x9E3779B9UL ;		/* Hash the elements below. */
+            if (top < HTB_HASH_NODES)  stack[top++] = cdr (key) ;
+            if (top < HTB_HASH_NODES)  stack[top++] = car (key) ;
+        } else if ((kind == HtbEqual) && is_vector (key)) {
+            length = vector_length (key) ;
+            h = (unsigned long) length ;
+            for (i = 0 ;  (i < length) && (top < HTB_HASH_NODES) ;  i++)
+                stack[top++] = vector_elem (key, i) ;
+        } else {
+            h = (unsigned long) key >> 3 ;	/* Address. */
+        }
+
+        hash = (hash ^ h) * 16777619UL ;
+
+        if ((top == 0) || (++nodes >= HTB_HASH_NODES))  break ;
+        key = stack[--top] ;
+
+    }
+
+/* Mix the bits, since the table uses the low-order bits of the hash. */
+
+    hash ^= hash >> 16 ;
+    hash *= 0x45D9F3BUL ;
+    hash ^= hash >> 16 ;
+
+    return (hash) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    htbInit ()
+
+    Empty a Table.
+
+
+Purpose:
+
+    Function htbInit() sets a table to an empty table of HTB_INITIAL buckets.
+
+
+    Invocation:
+
+        status = htbInit (sc, table) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <table>		- I
+            is the table.  It must be reachable by the garbage collector
+            (e.g., as a function argument or in SC->VALUE) on entry.
+        <status>	- O
+            returns the status of initializing the table, zero if there were
+            no errors and ERRNO otherwise.  The table is unchanged if there
+            was an error.
+
+*******************************************************************************/
+
+
+static  errno_t  htbInit (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  table)
+#    else
+        sc, table)
+
+        scheme  *sc ;
+        pointer  table ;
+#    endif
+
+{    /* Local variables. */
+    pointer  directory, leaf ;
+    UniqueID  leafID, tableID ;
+
+
+
+/* Allocate the directory and the first leaf.  Allocating a vector runs the
+   interpreter, so the table and the leaf are protected from GC meanwhile. */
+
+    tableID = gc_protect (sc, table) ;
+    leaf = htbVector (sc, HTB_INITIAL) ;
+    directory = NULL ;
+    if (leaf != NULL) {
+        leafID = gc_protect (sc, leaf) ;
+        directory = htbVector (sc, HTB_LEAF_SMALL + 1) ;
+        gc_unprotect (sc, leafID) ;
+    }
+    gc_unprotect (sc, tableID) ;
+
+    if (directory == NULL) {
+        LGE "(htbInit) Error allocating table %p.\nhtbVector: ",
+            (void *) table) ;
+        return (errno) ;
+    }
+
+/* Replace the table's buckets with the new, empty ones. */
+
+    set_vector_elem (directory, 0, leaf) ;
+    set_cdr (cdr (cdr (cdr (cdr (table)))), directory) ;
+
+    HTB_SET_INTEGER (HTB_COUNT (table), 0) ;
+    HTB_SET_INTEGER (HTB_BASE (table), HTB_INITIAL) ;
+    HTB_SET_INTEGER (HTB_SPLIT (table), 0) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    htbIsTable ()
+
+    Check if a Scheme Object is a Hash Table.
+
+
+Purpose:
+
+    Function htbIsTable() checks if a Scheme object is a hash table.
+
+
+    Invocation:
+
+        isTable = htbIsTable (sc, object, caller) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <object>	- I
+            is the object.
+        <caller>	- I
+            is the name of the calling function, for the error message logged
+            if the object is not a table; NULL if no message is wanted.
+        <isTable>	- O
+            returns true if the object is a hash table and false otherwise.
+
+*******************************************************************************/
+
+
+static  bool  htbIsTable (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  object,
+        const  char  *caller)
+#    else
+        sc, object, caller)
+
+        scheme  *sc ;
+        pointer  object ;
+        char  *caller ;
+#    endif
+
+{    /* Local variables. */
+    int  i ;
+    pointer  list ;
+
+
+
+    htbSymbols (sc) ;
+
+    list = object ;
+    if (is_pair (list) && (car (list) == sym.tag)) {
+        for (i = 0 ;  i < 4 ;  i++) {
+            list = cdr (list) ;
+            if (!is_pair (list))  break ;
+        }
+        if ((i == 4) && is_vector (cdr (list)))  return (true) ;
+    }
+
+    if (caller != NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(%s) Argument is not a hash table.\n", caller) ;
+    }
+
+    return (false) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    htbList ()
+
+    List a Table's Entries, Keys, or Values.
+
+
+Purpose:
+
+    Function htbList() builds a new list of the entries, keys, or values
+    in a table.
+
+
+    Invocation:
+
+        list = htbList (sc, table, what) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <table>		- I
+            is the table.
+        <what>		- I
+            is 0 to list copies of the (<key> . <value>) entries, 1 to list
+            the keys, or 2 to list the values.
+        <list>		- O
+            returns the list.
+
+*******************************************************************************/
+
+
+static  pointer  htbList (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  table,
+        int  what)
+#    else
+        sc, table, what)
+
+        scheme  *sc ;
+        pointer  table ;
+        int  what ;
+#    endif
+
+{    /* Local variables. */
+    long  bucket, buckets ;
+    int  slot ;
+    pointer  leaf, node, result ;
+
+
+
+    buckets = ivalue (HTB_BASE (table)) + ivalue (HTB_SPLIT (table)) ;
+    result = sc->NIL ;
+
+    for (bucket = 0 ;  bucket < buckets ;  bucket++) {
+        leaf = htbBucket (sc, table, bucket, false, &slot) ;
+        for (node = vector_elem (leaf, slot) ;  node != sc->NIL ;
+             node = cdr (node)) {
+            sc->value = result ;	/* Hold while allocating. */
+            if (what == 1)
+                result = cons (sc, caar (node), result) ;
+            else if (what == 2)
+                result = cons (sc, cdar (node), result) ;
+            else
+                result = cons (sc, cons (sc, caar (node), cdar (node)),
+                               result) ;
+        }
+    }
+
+    return (result) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    htbSplit ()
+
+    Add a Bucket to a Table.
+
+
+Purpose:
+
+    Function htbSplit() adds a bucket to a table and moves into it the
+    entries from the bucket at the split point that now hash to it.  The
+    bucket's nodes are relinked, not copied, so no cells are allocated
+    except, occasionally, a new leaf or directory.
+
+
+    Invocation:
+
+        htbSplit (sc, table) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <table>		- I
+            is the table.  It must be reachable by the garbage collector
+            (e.g., as a function argument) on entry.
+
+*******************************************************************************/
+
+
+static  void  htbSplit (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  table)
+#    else
+        sc, table)
+
+        scheme  *sc ;
+        pointer  table ;
+#    endif
+
+{    /* Local variables. */
+    long  base, split, target ;
+    int  newSlot, oldSlot ;
+    HtbKind  kind ;
+    pointer  keep, move, newLeaf, next, node, oldLeaf ;
+    UniqueID  tableID ;
+    unsigned  long  mask ;
+
+
+
+    base = ivalue (HTB_BASE (table)) ;
+    split = ivalue (HTB_SPLIT (table)) ;
+    target = base + split ;
+    if (target >= (HTB_LEAF * (HTB_DIRECTORY_MAX - HTB_LEAF_SMALL + 1)))
+        return ;			/* As large as it gets. */
+
+/* Every so often, the new bucket starts a new leaf.  Allocating the leaf
+   runs the interpreter, so protect the table from GC meanwhile.  If the
+   leaf can't be allocated, the table simply stays its current size. */
+
+    newLeaf = htbBucket (sc, table, target, false, &newSlot) ;
+    if (newLeaf == NULL) {
+        tableID = gc_protect (sc, table) ;
+        newLeaf = htbBucket (sc, table, target, true, &newSlot) ;
+        gc_unprotect (sc, tableID) ;
+        if (newLeaf == NULL)  return ;
+    }
+
+    oldLeaf = htbBucket (sc, table, split, false, &oldSlot) ;
+
+/* Divide the old bucket's nodes between the two buckets. */
+
+    kind = (HtbKind) ivalue (HTB_KIND (table)) ;
+    mask = (unsigned long) (2 * base - 1) ;
+    keep = move = sc->NIL ;
+
+    for (node = vector_elem (oldLeaf, oldSlot) ;  node != sc->NIL ;
+         node = next) {
+        next = cdr (node) ;
+        if ((long) (htbHash (kind, caar (node)) & mask) == target) {
+            set_cdr (node, move) ;
+            move = node ;
+        } else {
+            set_cdr (node, keep) ;
+            keep = node ;
+        }
+    }
+
+    set_vector_elem (oldLeaf, oldSlot, keep) ;
+    set_vector_elem (newLeaf, newSlot, move) ;
+
+/* Advance the split point, starting a new round when every bucket of the
+   current round has been split. */
+
+    if (++split == base) {
+        HTB_SET_INTEGER (HTB_BASE (table), 2 * base) ;
+        split = 0 ;
+    }
+    HTB_SET_INTEGER (HTB_SPLIT (table), split) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    htbSymbols ()
+
+    Look Up the Symbols Used by the Package.
+
+
+Purpose:
+
+    Function htbSymbols() looks up the symbols used by the package in an
+    interpreter, if they haven't been looked up already.
+
+
+    Invocation:
+
+        htbSymbols (sc) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+static  void  htbSymbols (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{
+
+    if (sym.sc == sc)  return ;
+
+    sym.tag = mk_symbol (sc, "*hash-table*") ;
+    sym.sc = sc ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    htbVector ()
+
+    Make a Vector.
+
+
+Purpose:
+
+    Function htbVector() makes a vector, its elements initialized to the
+    empty list.  A vector occupies consecutive cells, which only the
+    interpreter can allocate, so htbVector() applies the MAKE-VECTOR
+    procedure captured by addFuncsHTB().  This is a nested call to the
+    interpreter (see "scm_util.c"): the arguments of the foreign function
+    calling htbVector() are no longer visible to the garbage collector,
+    so cells the caller still needs must be protected beforehand (e.g.,
+    with gc_protect()).
+
+
+    Invocation:
+
+        vector = htbVector (sc, length) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <length>	- I
+            is the number of elements in the vector.
+        <vector>	- O
+            returns the new vector; NULL is returned if the vector could
+            not be allocated.
+
+*******************************************************************************/
+
+
+static  pointer  htbVector (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        int  length)
+#    else
+        sc, length)
+
+        scheme  *sc ;
+        int  length ;
+#    endif
+
+{    /* Local variables. */
+    pointer  vector ;
+
+
+
+/* Build the arguments, (<length> ()), in the interpreter's argument
+   register, which the garbage collector treats as a root. */
+
+    sc->args = cons (sc, mk_integer (sc, length), sc->NIL) ;
+    set_cdr (sc->args, cons (sc, sc->NIL, sc->NIL)) ;
+
+    if (apply_function (sc, TS (sc, makeVector), sc->args, &vector) ||
+        !is_vector (vector) || (vector_length (vector) != length)) {
+        SET_ERRNO (ENOMEM) ;
+        LGE "(htbVector) Error allocating %d-element vector.\n", length) ;
+        return (NULL) ;
+    }
+
+    return (vector) ;
+
+}
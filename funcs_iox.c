@@ -16,8 +16,78 @@ Purpose:
     The FUNCS_IOX package defines functions for monitoring and responding to
     network I/O events.
 
+    Timers registered with IOX-AFTER and IOX-EVERY are kept in a timing wheel
+    attached to the dispatcher (see SOX_UTIL and TWL_UTIL) rather than in the
+    dispatcher's own timer list, so registering, canceling, and rescheduling
+    a timer are constant-time operations even with many thousands of timers.
+    Timer expirations are rounded up to the wheel's resolution, TWL_RESOLUTION
+    (10 milliseconds by default), and timers expiring in the same interval are
+    fired together.  Delays shorter than the resolution are not rounded: a
+    timer with a delay of zero, (iox-after dp function data 0), is called in
+    the dispatcher's next iteration, as before.
+
+    I/O sources registered with IOX-ONIO-GROUP under the same dispatcher and
+    function form a group.  Rather than calling the function once for each
+    ready source, the events detected for the group's members during one
+    iteration of the dispatcher are collected and delivered in a single call
+    at the start of the next iteration.  With many ready sockets, this cuts
+    the number of entries into the interpreter by the average number of
+    ready members.
+
+    Every call to a Scheme callback function is timed, and a count, total
+    and maximum time, and a coarse latency histogram are kept for each
+    callback; see IOX-STATS.  If a slow-callback threshold has been set
+    with IOX-SLOW, calls exceeding the threshold are logged to standard
+    error along with how the callback was registered and the name, if it
+    has one, of the function.  The cost is two time-of-day reads per call.
+
+    Each dispatcher also samples its event-loop lag, the lateness of its
+    timers; see IOX-LAG.  A stall threshold can be set with IOX-WATCHDOG,
+    in which case a watchdog thread reports any callback that runs longer
+    than the threshold, naming the callback function and, if the callback
+    is blocked in one, the foreign (C) function being executed.
+
+    IOX-ONSIGNAL delivers signals (e.g., SIGTERM or SIGHUP) as dispatcher
+    events: the callback function is called between other callbacks, never
+    asynchronously, so it can safely do anything another callback can.
+
+    IOX-POST queues a function call in a dispatcher's mailbox (see SOX_UTIL),
+    to be made at the start of the dispatcher's next iteration.  The same
+    mailbox is used by C extensions to hand results from helper threads back
+    to the dispatcher's thread.
+
+    Given an event budget, IOX-MONITOR runs the dispatcher in a bounded
+    slice (see soxRunSlice()) and returns, so that a host application can
+    interleave TSION's I/O with its own main loop.  I/O callbacks that come
+    ready after the budget is spent are left for the next slice.
+
+    IOX-SPAWN runs a program as a child process (see SPX_UTIL) with pipes
+    to its standard input, output, and error.  The callback function
+    receives the child's output as it arrives and, finally, its exit code;
+    input is fed to the child with IOX-SPAWN-WRITE.  Nothing blocks, so a
+    single dispatcher can run many children alongside its other sources.
+
+    IOX-ATTACH-NATIVE hands a TCP/IP connection to a built-in C handler
+    (see NTV_UTIL) for fixed-function data paths - echoing, relaying to
+    another connection, discarding, or splitting into queued lines - so
+    the data moves without Scheme strings or Scheme calls.  Scheme remains
+    the control plane: the callback function is only called when the
+    handler stops.
+
+    IOX-TRACE records the events delivered to a dispatcher's callbacks, and
+    the results of the program's TCP and LFN I/O, to a trace file (see
+    TRC_UTIL); IOX-REPLAY later feeds the trace back through the same
+    program's callbacks without any real I/O or waiting, making a repeatable
+    benchmark of the program's event handling.  Callbacks are identified in
+    the trace by serial numbers assigned in order of registration.
+
         (iox-after <dp> <function> <user>
                    <seconds>)			=> <cb>|#f    (Callback)
+        (iox-alloc-profile <dp>
+                           [<cells>|<pathname>])	=> <list>|<status>
+        (iox-attach-native <dp> <kind> <src>
+                           <sink>|#f
+                           [<function> <user>])	=> <cb>|#f    (Callback)
         (iox-cancel <cb>)			=> <status>   (#t|#f)
         (iox-create)				=> <dp>|#f    (Dispatcher)
         (iox-debug <value>)
@@ -25,9 +95,32 @@ Purpose:
         (iox-dispatcher <cb>)			=> <dp>|#f    (Dispatcher)
         (iox-every <dp> <function> <user>
                    <delay> <interval>)		=> <cb>|#f    (Callback)
+        (iox-idle-gc <dp> <occupancy>
+                     [<budget>])		=> <cb>|#f    (Callback)
+        (iox-lag <dp> [<probe>])		=> <list>     (Statistics)
         (iox-monitor <dp> [<seconds>])		=> <status>   (#f)
+        (iox-monitor <dp> <seconds>
+                     <events>)			=> (<handled> . <next>)
+        (iox-native-lines <cb> [<count>])	=> <list>     (Strings)
         (iox-onio <dp> <function> <user>
                   <reason> <fd>)		=> <cb>|#f    (Callback)
+        (iox-onio-group <dp> <function> <user>
+                        <reason> <fd>)		=> <cb>|#f    (Callback)
+        (iox-onsignal <dp> <function> <user>
+                      <signal>)			=> <cb>|#f    (Callback)
+        (iox-post <dp> <function> <user>)	=> <status>   (#t|#f)
+        (iox-replay <dp> <pathname>)		=> <list>     (Statistics)
+        (iox-reschedule <cb> <seconds>)		=> <status>   (#t|#f)
+        (iox-slow <dp> <seconds>)		=> <status>   (#t|#f)
+        (iox-spawn <dp> <function> <user>
+                   <argv>)			=> <cb>|#f    (Callback)
+        (iox-spawn-kill <cb> <signal>)		=> <status>   (#t|#f)
+        (iox-spawn-write <cb> <string>|#f)	=> <status>   (#t|#f)
+        (iox-stats <dp>)			=> <list>     (Statistics)
+        (iox-timeline <pathname>|#f
+                      [<capacity>])		=> <status>|<list>
+        (iox-trace <dp> <pathname>|#f)		=> <status>|<list>
+        (iox-watchdog <dp> <seconds>)		=> <status>   (#t|#f)
         (iox-whenidle <dp> <function> <user>)	=> <cb>|#f    (Callback)
 
 
@@ -38,29 +131,96 @@ Public Procedures:
 Private Procedures:
 
     func_IOX_AFTER() - implements the IOX-AFTER function.
+    func_IOX_ALLOC_PROFILE() - implements the IOX-ALLOC-PROFILE function.
+    func_IOX_ATTACH_NATIVE() - implements the IOX-ATTACH-NATIVE function.
     func_IOX_CANCEL() - implements the IOX-CANCEL function.
     func_IOX_CREATE() - implements the IOX-CREATE function.
     func_IOX_DEBUG() - implements the IOX-DEBUG function.
     func_IOX_DESTROY() - implements the IOX-DESTROY function.
     func_IOX_DISPATCHER() - implements the IOX-DISPATCHER function.
     func_IOX_EVERY() - implements the IOX-EVERY function.
+    func_IOX_IDLE_GC() - implements the IOX-IDLE-GC function.
+    func_IOX_LAG() - implements the IOX-LAG function.
     func_IOX_MONITOR() - implements the IOX-MONITOR function.
+    func_IOX_NATIVE_LINES() - implements the IOX-NATIVE-LINES function.
     func_IOX_ONIO() - implements the IOX-ONIO function.
+    func_IOX_ONIO_GROUP() - implements the IOX-ONIO-GROUP function.
+    func_IOX_ONSIGNAL() - implements the IOX-ONSIGNAL function.
+    func_IOX_POST() - implements the IOX-POST function.
+    func_IOX_REPLAY() - implements the IOX-REPLAY function.
+    func_IOX_RESCHEDULE() - implements the IOX-RESCHEDULE function.
+    func_IOX_SLOW() - implements the IOX-SLOW function.
+    func_IOX_SPAWN() - implements the IOX-SPAWN function.
+    func_IOX_SPAWN_KILL() - implements the IOX-SPAWN-KILL function.
+    func_IOX_SPAWN_WRITE() - implements the IOX-SPAWN-WRITE function.
+    func_IOX_STATS() - implements the IOX-STATS function.
+    func_IOX_TIMELINE() - implements the IOX-TIMELINE function.
+    func_IOX_TRACE() - implements the IOX-TRACE function.
+    func_IOX_WATCHDOG() - implements the IOX-WATCHDOG function.
     func_IOX_WHENIDLE() - implements the IOX-WHENIDLE function.
+    funcGroupCB() - is a C callback function that records an event for
+        a member of an I/O group.
+    funcGroupFlush() - calls a group's Scheme function with the events
+        recorded for its members.
+    funcGroupFree() - deallocates an I/O group.
+    funcIdleGCCB() - is a C idle handler that runs idle-time garbage
+        collections for IOX-IDLE-GC.
     funcIOXCB() - is a generic C callback function that calls the Scheme
         callback function when a monitored event occurs.
+    funcName() - looks up the name of a callback function.
+    funcNativeCB() - is a C close function that calls the Scheme callback
+        function when a native handler stops.
+    funcNativePin() - pins/unpins a native handler's endpoints.
+    funcPostCB() - calls a Scheme function posted with IOX-POST.
+    funcSignalCB() - is a C signal handler that calls the Scheme callback
+        function when a signal is received.
+    funcSoxCall() - calls the Scheme function bound to a callback.
+    funcSoxFind() - finds a callback registered during a replay.
+    funcSoxFree() - deallocates a SoxCallback structure.
+    funcSoxLink() - adds a SoxCallback structure to the list of callbacks.
+    funcSpawnCB() - is a C process handler that calls the Scheme callback
+        function with a spawned process's output and exit code.
+    funcStats() - records the timing of a Scheme call.
+    funcStatsList() - formats a callback's statistics as a Scheme list.
+    funcTWLCB() - is a C timer handler that calls the Scheme callback
+        function when a timer fires.
 
 *******************************************************************************/
 
 
 #include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
 
+#include  <limits.h>			/* Maximum/minimum value definitions. */
+#include  <signal.h>			/* Signal definitions. */
 #include  <stdio.h>			/* Standard I/O definitions. */
 #include  <stdlib.h>			/* Standard C Library definitions. */
 #include  <string.h>			/* C Library string functions. */
 #include  "iox_util.h"			/* I/O event dispatcher definitions. */
 #include  "tsion.h"			/* TinyScheme I/O Network functions. */
 #include  "gc_util.h"			/* Garbage collection utilities. */
+#include  "ntv_util.h"			/* Native stream handlers. */
+#include  "sox_util.h"			/* Scheme dispatcher utilities. */
+#include  "spx_util.h"			/* Spawned processes. */
+#include  "tev_util.h"			/* Trace-event timelines. */
+#include  "trc_util.h"			/* Event trace record/replay. */
+#include  "tv_util.h"			/* "timeval" manipulation functions. */
+
+
+/*******************************************************************************
+    SoxStats - timing statistics for the Scheme calls made on behalf of a
+        callback.  The histogram counts the calls in decade-wide buckets:
+        under 10 microseconds, under 100 microseconds, ..., under 1 second,
+        and 1 second or more.
+*******************************************************************************/
+
+#define  SOX_BUCKETS  7
+
+typedef  struct  SoxStats {
+    unsigned  long  count ;	/* Number of calls. */
+    double  total ;		/* Total time in calls (seconds). */
+    double  max ;		/* Longest call (seconds). */
+    unsigned  long  histogram[SOX_BUCKETS] ;
+}  SoxStats ;
 
 
 /*******************************************************************************
@@ -68,26 +228,165 @@ Private Procedures:
 *******************************************************************************/
 
 typedef  struct  SoxCallback {
-    IoxCallback  callback ;	/* The registered IOX callback. */
+    IoxCallback  callback ;	/* The registered IOX callback ... */
+    TwlTimer  timer ;		/* ... or the registered wheel timer ... */
+    SoxSignal  signal ;		/* ... or the registered signal watcher ... */
+    SpxProcess  process ;	/* ... or the spawned process ... */
+    NtvHandler  native ;	/* ... or the native handler. */
+    bool  pinned ;		/* Native handler's endpoints pinned? */
+    IoxDispatcher  dispatcher ;	/* Dispatcher with which registered. */
     scheme  *sc ;		/* Scheme interpreter. */
     UniqueID  functionID ;	/* ID bound to Scheme function. */
     UniqueID  userDataID ;	/* ID bound to Scheme user data. */
+    struct  SoxGroup  *group ;	/* I/O group, if any, of which a member. */
+    struct  SoxCallback  *nextPending ;	/* Link in group's pending list. */
+    IoxReason  pendingReason ;	/* Events pending delivery; 0 if none. */
+    const  char  *kind ;	/* Registering function; e.g., "iox-onio". */
+    struct  SoxCallback  *prev ;	/* Links in list of callbacks. */
+    struct  SoxCallback  *next ;
+    int  busy ;			/* Number of active Scheme calls. */
+    bool  dead ;		/* Canceled during a Scheme call? */
+    SoxStats  stats ;		/* Timing statistics. */
+    unsigned  long  traceID ;	/* Serial number in event traces. */
+    bool  traced ;		/* In the replay index? */
+    struct  SoxCallback  *nextTraced ;	/* Link in replay index bucket. */
 }  SoxCallback ;
 
+static  SoxCallback  *soxList = NULL ;
+
+/* Callbacks registered during a replay (see IOX-REPLAY), hashed by serial
+   number so that the replay can find the callback for each recorded event. */
+
+#define  SOX_TRACE_BUCKETS  4096
+
+static  SoxCallback  *traceIndex[SOX_TRACE_BUCKETS] ;
+
+/* Names of callback functions, looked up by funcName() only when needed
+   (for the stall watchdog, the slow-callback log, or the allocation
+   profiler) and cached, since the
+   lookup is a search of the global environment. */
+
+#define  SOX_NAME_CACHE  64
+
+static  struct  {
+    scheme  *sc ;
+    pointer  function ;
+    const  char  *name ;
+}  nameCache[SOX_NAME_CACHE] ;
+
+
+/*******************************************************************************
+    SoxGroup - collects the events for the members of an I/O group (all the
+        I/O sources registered with IOX-ONIO-GROUP under the same dispatcher
+        and Scheme function) for delivery in a single call.
+*******************************************************************************/
+
+typedef  struct  SoxGroup {
+    struct  SoxGroup  *next ;	/* Link in list of groups. */
+    IoxDispatcher  dispatcher ;	/* Dispatcher with which registered. */
+    scheme  *sc ;		/* Scheme interpreter. */
+    pointer  function ;		/* Scheme function ... */
+    UniqueID  functionID ;	/* ... and its protected ID. */
+    int  numMembers ;		/* Number of registered members. */
+    SoxCallback  *pending ;	/* Members with events pending ... */
+    SoxCallback  *lastPending ;	/* ... in order of occurrence. */
+    SoxDeferred  flush ;	/* Deferred delivery of pending events. */
+    int  busy ;			/* Number of active Scheme calls. */
+    SoxStats  stats ;		/* Timing statistics. */
+}  SoxGroup ;
+
+static  SoxGroup  *groupList = NULL ;
+
+
+/*******************************************************************************
+    SoxPosted - a Scheme function call posted with IOX-POST.
+*******************************************************************************/
+
+typedef  struct  SoxPosted {
+    IoxDispatcher  dispatcher ;	/* Dispatcher to which call was posted. */
+    scheme  *sc ;		/* Scheme interpreter. */
+    UniqueID  functionID ;	/* Scheme function to call. */
+    UniqueID  userDataID ;	/* Argument to pass to function. */
+}  SoxPosted ;
+
+
+/*******************************************************************************
+    Signal names - the signals for which Scheme variables (e.g., SIGTERM) are
+        defined for use with IOX-ONSIGNAL and IOX-SPAWN-KILL.
+*******************************************************************************/
+
+static  const  struct  {
+    const  char  *name ;
+    int  number ;
+}  signalNames[] = {
+#ifdef SIGHUP
+    { "SIGHUP", SIGHUP },
+#endif
+#ifdef SIGINT
+    { "SIGINT", SIGINT },
+#endif
+#ifdef SIGQUIT
+    { "SIGQUIT", SIGQUIT },
+#endif
+#ifdef SIGKILL
+    { "SIGKILL", SIGKILL },
+#endif
+#ifdef SIGPIPE
+    { "SIGPIPE", SIGPIPE },
+#endif
+#ifdef SIGALRM
+    { "SIGALRM", SIGALRM },
+#endif
+#ifdef SIGTERM
+    { "SIGTERM", SIGTERM },
+#endif
+#ifdef SIGCHLD
+    { "SIGCHLD", SIGCHLD },
+#endif
+#ifdef SIGUSR1
+    { "SIGUSR1", SIGUSR1 },
+#endif
+#ifdef SIGUSR2
+    { "SIGUSR2", SIGUSR2 },
+#endif
+#ifdef SIGWINCH
+    { "SIGWINCH", SIGWINCH },
+#endif
+    { NULL, 0 }
+} ;
+
 
 /*******************************************************************************
     Private functions.
 *******************************************************************************/
 
 static  pointer  func_IOX_AFTER P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_ALLOC_PROFILE P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_ATTACH_NATIVE P_((scheme *sc, pointer args)) ;
 static  pointer  func_IOX_CANCEL P_((scheme *sc, pointer args)) ;
 static  pointer  func_IOX_CREATE P_((scheme *sc, pointer args)) ;
 static  pointer  func_IOX_DEBUG P_((scheme *sc, pointer args)) ;
 static  pointer  func_IOX_DESTROY P_((scheme *sc, pointer args)) ;
 static  pointer  func_IOX_DISPATCHER P_((scheme *sc, pointer args)) ;
 static  pointer  func_IOX_EVERY P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_IDLE_GC P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_LAG P_((scheme *sc, pointer args)) ;
 static  pointer  func_IOX_MONITOR P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_NATIVE_LINES P_((scheme *sc, pointer args)) ;
 static  pointer  func_IOX_ONIO P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_ONIO_GROUP P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_ONSIGNAL P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_POST P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_REPLAY P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_RESCHEDULE P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_SLOW P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_SPAWN P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_SPAWN_KILL P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_SPAWN_WRITE P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_STATS P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_TIMELINE P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_TRACE P_((scheme *sc, pointer args)) ;
+static  pointer  func_IOX_WATCHDOG P_((scheme *sc, pointer args)) ;
 static  pointer  func_IOX_WHENIDLE P_((scheme *sc, pointer args)) ;
 
 static  errno_t  funcIOXCB (
@@ -97,6 +396,83 @@ static  errno_t  funcIOXCB (
         void  *userData
 #    endif
     ) ;
+
+static  errno_t  funcGroupCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+static  errno_t  funcGroupFlush (
+#    if PROTOTYPES
+        void  *userData
+#    endif
+    ) ;
+
+static  void  funcGroupFree P_((SoxGroup *group)) ;
+
+static  errno_t  funcIdleGCCB P_((IoxCallback callback,
+                                  IoxReason reason,
+                                  void *userData)) ;
+
+static  const  char  *funcName P_((scheme *sc,
+                                   pointer function)) ;
+
+static  errno_t  funcNativeCB P_((NtvHandler handler,
+                                  IoxReason reason,
+                                  errno_t error,
+                                  void *userData)) ;
+
+static  void  funcNativePin P_((SoxCallback *sox,
+                                bool pin)) ;
+
+static  errno_t  funcPostCB P_((IoxReason reason,
+                                void *userData)) ;
+
+static  errno_t  funcSignalCB P_((SoxSignal watcher,
+                                  IoxReason reason,
+                                  void *userData)) ;
+
+static  errno_t  funcSoxCall P_((SoxCallback *sox,
+                                 IoxReason reason,
+                                 pointer extra)) ;
+
+static  SoxCallback  *funcSoxFind P_((IoxDispatcher dispatcher,
+                                      unsigned long id)) ;
+
+static  void  funcSoxFree P_((SoxCallback *sox)) ;
+
+static  void  funcSoxLink P_((SoxCallback *sox,
+                              const char *kind)) ;
+
+static  errno_t  funcSpawnCB P_((SpxProcess process,
+                                 IoxReason reason,
+                                 const char *data,
+                                 size_t length,
+                                 void *userData)) ;
+
+static  void  funcStats P_((SoxStats *stats,
+                            double elapsed,
+                            scheme *sc,
+                            IoxDispatcher dispatcher,
+                            const char *kind,
+                            pointer function)) ;
+
+static  pointer  funcStatsList P_((scheme *sc,
+                                   pointer handle,
+                                   const char *kind,
+                                   pointer function,
+                                   SoxStats *stats)) ;
+
+static  errno_t  funcTWLCB (
+#    if PROTOTYPES
+        TwlTimer  timer,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
 
 /*!*****************************************************************************
 
@@ -135,12 +511,23 @@ void  addFuncsIOX (
         scheme  *sc ;
 #    endif
 
-{
+{    /* Local variables. */
+    int  i ;
+
+
 
     scheme_define (sc, sc->global_env,
                    mk_symbol (sc, "iox-after"),
                    mk_foreign_func (sc, func_IOX_AFTER)) ;
 
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-alloc-profile"),
+                   mk_foreign_func (sc, func_IOX_ALLOC_PROFILE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-attach-native"),
+                   mk_foreign_func (sc, func_IOX_ATTACH_NATIVE)) ;
+
     scheme_define (sc, sc->global_env,
                    mk_symbol (sc, "iox-cancel"),
                    mk_foreign_func (sc, func_IOX_CANCEL)) ;
@@ -165,14 +552,78 @@ void  addFuncsIOX (
                    mk_symbol (sc, "iox-every"),
                    mk_foreign_func (sc, func_IOX_EVERY)) ;
 
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-idle-gc"),
+                   mk_foreign_func (sc, func_IOX_IDLE_GC)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-lag"),
+                   mk_foreign_func (sc, func_IOX_LAG)) ;
+
     scheme_define (sc, sc->global_env,
                    mk_symbol (sc, "iox-monitor"),
                    mk_foreign_func (sc, func_IOX_MONITOR)) ;
 
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-native-lines"),
+                   mk_foreign_func (sc, func_IOX_NATIVE_LINES)) ;
+
     scheme_define (sc, sc->global_env,
                    mk_symbol (sc, "iox-onio"),
                    mk_foreign_func (sc, func_IOX_ONIO)) ;
 
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-onio-group"),
+                   mk_foreign_func (sc, func_IOX_ONIO_GROUP)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-onsignal"),
+                   mk_foreign_func (sc, func_IOX_ONSIGNAL)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-post"),
+                   mk_foreign_func (sc, func_IOX_POST)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-replay"),
+                   mk_foreign_func (sc, func_IOX_REPLAY)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-reschedule"),
+                   mk_foreign_func (sc, func_IOX_RESCHEDULE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-slow"),
+                   mk_foreign_func (sc, func_IOX_SLOW)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-spawn"),
+                   mk_foreign_func (sc, func_IOX_SPAWN)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-spawn-kill"),
+                   mk_foreign_func (sc, func_IOX_SPAWN_KILL)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-spawn-write"),
+                   mk_foreign_func (sc, func_IOX_SPAWN_WRITE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-stats"),
+                   mk_foreign_func (sc, func_IOX_STATS)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-timeline"),
+                   mk_foreign_func (sc, func_IOX_TIMELINE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-trace"),
+                   mk_foreign_func (sc, func_IOX_TRACE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "iox-watchdog"),
+                   mk_foreign_func (sc, func_IOX_WATCHDOG)) ;
+
     scheme_define (sc, sc->global_env,
                    mk_symbol (sc, "iox-whenidle"),
                    mk_foreign_func (sc, func_IOX_WHENIDLE)) ;
@@ -183,6 +634,17 @@ void  addFuncsIOX (
     scheme_load_string (sc, "(define IOX_IO 7)") ;
     scheme_load_string (sc, "(define IOX_FIRE 8)") ;
     scheme_load_string (sc, "(define IOX_IDLE 16)") ;
+    scheme_load_string (sc, "(define IOX_SIGNAL 64)") ;
+    scheme_load_string (sc, "(define IOX_STDOUT 256)") ;
+    scheme_load_string (sc, "(define IOX_STDERR 512)") ;
+    scheme_load_string (sc, "(define IOX_EXIT 1024)") ;
+    scheme_load_string (sc, "(define IOX_CLOSE 2048)") ;
+
+    for (i = 0 ;  signalNames[i].name != NULL ;  i++) {
+        scheme_define (sc, sc->global_env,
+                       mk_symbol (sc, signalNames[i].name),
+                       mk_integer (sc, (long) signalNames[i].number)) ;
+    }
 
     return ;
 
@@ -260,8 +722,8 @@ static  pointer  func_IOX_AFTER (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        dispatcher = (IoxDispatcher) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_IOX_AFTER) Invalid dispatcher specification: ") ;
@@ -299,17 +761,28 @@ static  pointer  func_IOX_AFTER (
     }
 
     sox->callback = NULL ;
+    sox->timer = NULL ;
+    sox->signal = NULL ;
+    sox->process = NULL ;
+    sox->native = NULL ;
+    sox->pinned = false ;
+    sox->dispatcher = dispatcher ;
     sox->sc = sc ;
-
-/* Register the timer with the dispatcher.  When the specified interval has
-   elapsed, the dispatcher will call funcIOXCB(), which, in turn, will call
-   the Scheme function in the SoxCallback structure. */
-
-    sox->callback = ioxAfter (dispatcher, funcIOXCB, sox, interval) ;
-    if (sox->callback == NULL) {
-        LGE "(func_IOX_AFTER) Error registering callback.\nioxAfter: ") ;
-        PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
-        return (sc->F) ;
+    sox->group = NULL ;
+    sox->nextPending = NULL ;
+    sox->pendingReason = 0 ;
+
+/* Register the timer with the dispatcher's timing wheel.  When the specified
+   interval has elapsed, the wheel will call funcTWLCB(), which, in turn, will
+   call the Scheme function in the SoxCallback structure. */
+
+    if (!trcReplaying (sc, dispatcher)) {
+        sox->timer = soxAfter (dispatcher, funcTWLCB, sox, interval) ;
+        if (sox->timer == NULL) {
+            LGE "(func_IOX_AFTER) Error registering callback.\nsoxAfter: ") ;
+            PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
+            return (sc->F) ;
+        }
     }
 
 /* Protect the function object and the user-supplied data from the garbage
@@ -318,9 +791,11 @@ static  pointer  func_IOX_AFTER (
     sox->functionID = gc_protect (sc, function) ;
     sox->userDataID = gc_protect (sc, userData) ;
 
+    funcSoxLink (sox, "iox-after") ;
+
 /* Return the callback to the caller. */
 
-    return (mk_opaque (sc, (opaque) sox->callback)) ;
+    return (mk_opaque (sc, (opaque) sox, OpaqueCallback)) ;
 
 }
 
@@ -328,40 +803,61 @@ static  pointer  func_IOX_AFTER (
 
 Procedure:
 
-    func_IOX_CANCEL ()
+    func_IOX_ALLOC_PROFILE ()
 
-    Cancel a Callback.
+    Profile the Cells Allocated by Callbacks.
 
 
 Purpose:
 
-    Function func_IOX_CANCEL() cancels a previously registered callback.
+    Function func_IOX_ALLOC_PROFILE() controls a dispatcher's sampling
+    allocation profiler (see "sox_util.c"), which shows which callbacks
+    allocate the most cells.
 
-        (iox-cancel <callback>)
+        (iox-alloc-profile <dispatcher> <cells>)
 
-        Cancel <callback>, where <callback> is the opaque handle returned when
-        the callback was registered.  The status of canceling the callback,
-        #t or #f, is returned to the caller.
+        Start sampling the dispatcher's callbacks every <cells> cells
+        allocated, discarding any previous profile, or, if <cells> is zero,
+        stop sampling.  The status, #t or #f, is returned to the caller.
+        Each sample charges <cells> cells to the stack of callbacks in
+        progress, e.g., "iox-onio:handle-input" (the callback's kind and the
+        global variable bound to its function) or, for callbacks dispatched
+        by a nested IOX-MONITOR, "iox-every:poll;iox-onio:handle-input".
+        The interpreter's allocations are only checked when callbacks start
+        and finish, so the cells allocated by a callback are charged to the
+        callback as a whole, not to the procedures it calls.
+
+        (iox-alloc-profile <dispatcher>)
+
+        Return the profile as a list of (<stack> <cells> <samples>) entries,
+        one for each stack sampled, in the order first sampled.
+
+        (iox-alloc-profile <dispatcher> <pathname>)
+
+        Write the profile to file <pathname> as folded stacks, one line per
+        stack, "<stack> <cells>", the format read by flame-graph tools.  The
+        status, #t or #f, is returned to the caller.
 
 
     Invocation:
 
-        status = func_IOX_CANCEL (sc, args) ;
+        result = func_IOX_ALLOC_PROFILE (sc, args) ;
 
     where
 
         <sc>		- I
             is the Scheme interpreter.
         <args>		- I
-            is a list of the arguments: the callback to be cancelled.
-        <status>	- O
-            returns true (#t) if the callback was cancelled successfully
-            and false (#f) otherwise.
+            is a list of the arguments: the dispatcher and, optionally,
+            the sampling period or a pathname.
+        <result>	- O
+            returns the profile or the status, as described above; #f is
+            returned in the event of an error.
 
 *******************************************************************************/
 
 
-static  pointer  func_IOX_CANCEL (
+static  pointer  func_IOX_ALLOC_PROFILE (
 
 #    if PROTOTYPES
         scheme  *sc,
@@ -374,64 +870,142 @@ static  pointer  func_IOX_CANCEL (
 #    endif
 
 {    /* Local variables. */
-    IoxCallback  callback ;
-    pointer  argument ;
+    const  char  *frames ;
+    FILE  *file ;
+    IoxDispatcher  dispatcher ;
+    long  i ;
+    pointer  argument, entry, list ;
+    unsigned  long  cells, samples ;
 
 
 
-/* Get the argument(s). */
+/* Get the dispatcher. */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        callback = (IoxCallback) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
-        LGE "(func_IOX_CANCEL) Argument is not a callback: ") ;
+        LGE "(func_IOX_ALLOC_PROFILE) Argument is not a dispatcher: ") ;
         return (sc->F) ;
     }
 
-/* Cancel the callback. */
+/* Start or stop the profiler. */
+
+    args = cdr (args) ;
+    if (args != sc->NIL) {
+        argument = car (args) ;
+        if (isInteger (argument)) {
+            return (soxProfile (dispatcher, ivalue (argument)) ? sc->F : sc->T) ;
+        } else if (!is_string (argument)) {
+            SET_ERRNO (EINVAL) ;
+            LGE "(func_IOX_ALLOC_PROFILE) Invalid sampling period or pathname: ") ;
+            return (sc->F) ;
+        }
+
+/* Write the profile to a file. */
+
+        file = fopen (strvalue (argument), "w") ;
+        if (file == NULL) {
+            LGE "(func_IOX_ALLOC_PROFILE) Error opening %s.\nfopen: ",
+                strvalue (argument)) ;
+            return (sc->F) ;
+        }
+        if (soxProfileWrite (dispatcher, file)) {
+            PUSH_ERRNO ;  fclose (file) ;  POP_ERRNO ;
+            return (sc->F) ;
+        }
+        if (fclose (file)) {
+            LGE "(func_IOX_ALLOC_PROFILE) Error closing %s.\nfclose: ",
+                strvalue (argument)) ;
+            return (sc->F) ;
+        }
+        return (sc->T) ;
+    }
+
+/* Return the profile, building the list backwards. */
+
+    for (i = 0 ;  soxProfileStack (dispatcher, i, &cells, &samples) != NULL ;
+         i++)
+        ;
+
+    list = sc->NIL ;
+    while (i-- > 0) {
+        frames = soxProfileStack (dispatcher, i, &cells, &samples) ;
+        entry = cons (sc, mk_integer (sc, (long) samples), sc->NIL) ;
+        entry = cons (sc, mk_integer (sc, (long) cells), entry) ;
+        entry = cons (sc, mk_string (sc, frames), entry) ;
+        list = cons (sc, entry, list) ;
+    }
 
-    return (ioxCancel (callback) ? sc->F : sc->T) ;
+    return (list) ;
 
 }
-
+
 /*!*****************************************************************************
 
 Procedure:
 
-    func_IOX_CREATE ()
+    func_IOX_ATTACH_NATIVE ()
 
-    Create an I/O Event Dispatcher.
+    Attach a Native Handler to a Network Connection.
 
 
 Purpose:
 
-    Function func_IOX_CREATE() creates an I/O event dispatcher.
-
-        (iox-create)
-
-        Create an I/O event dispatcher.  An opaque handle is returned for the
-        dispatcher; #f is returned in the event of an error.
+    Function func_IOX_ATTACH_NATIVE() attaches a built-in C handler (see
+    NTV_UTIL) to a TCP/IP data connection, so that a fixed-function data
+    path runs without calling Scheme for each chunk of data.
+
+        (iox-attach-native <dispatcher> <kind> <source> <sink>|#f
+                           [<function> <userData>])
+
+        Attach a handler of <kind> to endpoint <source>, which is monitored
+        by <dispatcher>.  <kind> is one of the symbols DISCARD (read and
+        drop the input), ECHO (write the input back to <source>), RELAY
+        (write the input to endpoint <sink>), or LINES (queue the input's
+        lines for IOX-NATIVE-LINES); <sink> is only used by RELAY and is
+        otherwise #f.  Writes never block: if <sink> falls behind, <source>
+        is not read until <sink> catches up.  An opaque handle for the
+        handler is returned to the caller and can be used to stop the
+        handler with IOX-CANCEL, which leaves the endpoints open.  #f is
+        returned in the event of an error.
+
+        When <source> closes its connection or an I/O error occurs, the
+        handler stops and <function> is called with 4 arguments: the
+        handler handle, the reason IOX_CLOSE, the application-supplied
+        <userData>, and the error number (0 if <source> simply closed).
+        The function is responsible for destroying the endpoints.  If no
+        function is given, the handler destroys <source> and <sink> itself
+        when it stops; the program must not use them afterwards.  While the
+        handler runs, the endpoints are not finalized (see "opaque.c") even
+        if the program drops its handles for them.
+
+        During a replay (see IOX-REPLAY), the handler is not attached; the
+        recorded IOX_CLOSE event is delivered to <function> instead.
 
 
     Invocation:
 
-        dispatcher = func_IOX_CREATE (sc, args) ;
+        callback = func_IOX_ATTACH_NATIVE (sc, args) ;
 
     where
 
         <sc>		- I
             is the Scheme interpreter.
         <args>		- I
-            is a list of the arguments, which are ignored.
-        <dispatcher>	- O
-            returns an I/O event dispatcher.
+            is a list of the arguments: the dispatcher, the kind of handler,
+            the source and sink endpoints, and, optionally, a function to be
+            called when the handler stops and a user-supplied value to pass
+            to the function.
+        <callback>	- O
+            returns a callback handle if the handler was successfully
+            attached and #f if there was an error.
 
 *******************************************************************************/
 
 
-static  pointer  func_IOX_CREATE (
+static  pointer  func_IOX_ATTACH_NATIVE (
 
 #    if PROTOTYPES
         scheme  *sc,
@@ -444,59 +1018,164 @@ static  pointer  func_IOX_CREATE (
 #    endif
 
 {    /* Local variables. */
+    char  *name ;
     IoxDispatcher  dispatcher ;
+    NtvKind  kind ;
+    pointer  argument, function, userData ;
+    SoxCallback  *sox ;
+    TcpEndpoint  sink, source ;
 
 
 
-/* Create the dispatcher. */
+/* Get the argument(s). */
 
-    if (ioxCreate (&dispatcher)) {
-        LGE "(func_IOX_CREATE) Error creating dispatcher.\nioxCreate: ") ;
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ATTACH_NATIVE) Invalid dispatcher specification: ") ;
         return (sc->F) ;
     }
 
-/* Return the dispatcher to the caller. */
+    args = cdr (args) ;
+    argument = car (args) ;
+    name = is_symbol (argument) ? symname (argument) : "" ;
+    if (strcmp (name, "discard") == 0) {
+        kind = NtvDiscard ;
+    } else if (strcmp (name, "echo") == 0) {
+        kind = NtvEcho ;
+    } else if (strcmp (name, "lines") == 0) {
+        kind = NtvLines ;
+    } else if (strcmp (name, "relay") == 0) {
+        kind = NtvRelay ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ATTACH_NATIVE) Invalid kind of handler: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        source = (TcpEndpoint) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ATTACH_NATIVE) Invalid source endpoint: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        sink = (TcpEndpoint) opaque_value (sc, argument) ;
+    } else if ((argument == sc->F) && (kind != NtvRelay)) {
+        sink = NULL ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ATTACH_NATIVE) Invalid sink endpoint: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    if (args == sc->NIL) {
+        function = sc->NIL ;
+        userData = sc->NIL ;
+    } else {
+        function = car (args) ;
+        args = cdr (args) ;
+        userData = (args == sc->NIL) ? sc->NIL : car (args) ;
+    }
+
+/* Allocate a structure to hold the Scheme callback function and the user
+   parameter; a pointer to this structure will be passed to funcNativeCB()
+   when the handler stops. */
+
+    sox = (SoxCallback *) malloc (sizeof (SoxCallback)) ;
+    if (sox == NULL) {
+        LGE "(func_IOX_ATTACH_NATIVE) Error allocating SoxCallback structure.\nmalloc: ") ;
+        return (sc->F) ;
+    }
+
+    sox->callback = NULL ;
+    sox->timer = NULL ;
+    sox->signal = NULL ;
+    sox->process = NULL ;
+    sox->native = NULL ;
+    sox->pinned = false ;
+    sox->dispatcher = dispatcher ;
+    sox->sc = sc ;
+    sox->group = NULL ;
+    sox->nextPending = NULL ;
+    sox->pendingReason = 0 ;
+
+/* Attach the handler.  When the handler stops, it will call funcNativeCB(),
+   which, in turn, will call the Scheme function in the SoxCallback
+   structure. */
+
+    if (!trcReplaying (sc, dispatcher)) {
+        sox->native = ntvAttach (dispatcher, kind, source, sink,
+                                 funcNativeCB, sox) ;
+        if (sox->native == NULL) {
+            LGE "(func_IOX_ATTACH_NATIVE) Error attaching handler.\nntvAttach: ") ;
+            PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
+            return (sc->F) ;
+        }
+        funcNativePin (sox, true) ;
+    }
+
+/* Protect the function object and the user-supplied data from the garbage
+   collector. */
+
+    sox->functionID = (function == sc->NIL) ? 0 : gc_protect (sc, function) ;
+    sox->userDataID = gc_protect (sc, userData) ;
 
-    return (mk_opaque (sc, (opaque) dispatcher)) ;
+    funcSoxLink (sox, "iox-attach-native") ;
+
+/* Return the callback to the caller. */
+
+    return (mk_opaque (sc, (opaque) sox, OpaqueCallback)) ;
 
 }
-
+
 /*!*****************************************************************************
 
 Procedure:
 
-    func_IOX_DEBUG ()
+    func_IOX_CANCEL ()
 
-    Enable/Disable I/O Event Dispatching Debug Output.
+    Cancel a Callback.
 
 
 Purpose:
 
-    Function func_IOX_DEBUG() enables or disables I/O event dispatching debug.
+    Function func_IOX_CANCEL() cancels a previously registered callback.
 
-        (iox-debug <value>)
+        (iox-cancel <callback>)
 
-        Set the I/O event dispatcher debug flag to <value>, an integer number.
-        A value of 0 disables debug; a non-zero value enables debug.  Debug is
-        written to standard output.
+        Cancel <callback>, where <callback> is the opaque handle returned when
+        the callback was registered.  The status of canceling the callback,
+        #t or #f, is returned to the caller.
 
 
     Invocation:
 
-        func_IOX_DEBUG (sc, args) ;
+        status = func_IOX_CANCEL (sc, args) ;
 
     where
 
         <sc>		- I
             is the Scheme interpreter.
         <args>		- I
-            is a list of the arguments: an integer indicating the desired
-            debug level.
+            is a list of the arguments: the callback to be cancelled.
+        <status>	- O
+            returns true (#t) if the callback was cancelled successfully
+            and false (#f) otherwise.
 
 *******************************************************************************/
 
 
-static  pointer  func_IOX_DEBUG (
+static  pointer  func_IOX_CANCEL (
 
 #    if PROTOTYPES
         scheme  *sc,
@@ -510,13 +1189,168 @@ static  pointer  func_IOX_DEBUG (
 
 {    /* Local variables. */
     pointer  argument ;
+    SoxCallback  *sox ;
 
 
 
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (!is_number (argument)) {
+    if (is_opaque (sc, argument, OpaqueCallback)) {
+        sox = (SoxCallback *) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_CANCEL) Argument is not a callback: ") ;
+        return (sc->F) ;
+    }
+
+/* Cancel the callback.  A callback canceled from within its own function
+   is already gone as far as the dispatcher is concerned. */
+
+    if (sox->dead)  return (sc->T) ;
+
+    if (sox->traced) {			/* Registered during a replay? */
+        if (sox->group != NULL)
+            funcGroupCB (NULL, IoxCancel, sox) ;
+        else
+            funcSoxCall (sox, IoxCancel, NULL) ;
+        return (sc->T) ;
+    }
+
+    if (sox->timer != NULL)
+        return (twlCancel (sox->timer) ? sc->F : sc->T) ;
+    else if (sox->signal != NULL)
+        return (soxCancelSignal (sox->signal) ? sc->F : sc->T) ;
+    else if (sox->process != NULL)
+        return (spxCancel (sox->process) ? sc->F : sc->T) ;
+    else if (sox->native != NULL)
+        return (ntvCancel (sox->native) ? sc->F : sc->T) ;
+    else
+        return (ioxCancel (sox->callback) ? sc->F : sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_CREATE ()
+
+    Create an I/O Event Dispatcher.
+
+
+Purpose:
+
+    Function func_IOX_CREATE() creates an I/O event dispatcher.
+
+        (iox-create)
+
+        Create an I/O event dispatcher.  An opaque handle is returned for the
+        dispatcher; #f is returned in the event of an error.
+
+
+    Invocation:
+
+        dispatcher = func_IOX_CREATE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments, which are ignored.
+        <dispatcher>	- O
+            returns an I/O event dispatcher.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_CREATE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    IoxDispatcher  dispatcher ;
+
+
+
+/* Create the dispatcher. */
+
+    if (ioxCreate (&dispatcher)) {
+        LGE "(func_IOX_CREATE) Error creating dispatcher.\nioxCreate: ") ;
+        return (sc->F) ;
+    }
+
+/* Return the dispatcher to the caller. */
+
+    return (mk_opaque (sc, (opaque) dispatcher, OpaqueDispatcher)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_DEBUG ()
+
+    Enable/Disable I/O Event Dispatching Debug Output.
+
+
+Purpose:
+
+    Function func_IOX_DEBUG() enables or disables I/O event dispatching debug.
+
+        (iox-debug <value>)
+
+        Set the I/O event dispatcher debug flag to <value>, an integer number.
+        A value of 0 disables debug; a non-zero value enables debug.  Debug is
+        written to standard output.
+
+
+    Invocation:
+
+        func_IOX_DEBUG (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: an integer indicating the desired
+            debug level.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_DEBUG (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  argument ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (!is_number (argument)) {
         SET_ERRNO (EINVAL) ;
         LGE "(func_IOX_DEBUG) Argument is not a number: ") ;
         return (sc->F) ;
@@ -546,8 +1380,8 @@ Purpose:
 
         (iox-destroy <dispatcher>)
 
-        Invoke each of <dispatcher>'s registered callbacks with reason
-        IOX_CANCEL and then destroy the dispatcher.
+        Invoke each of <dispatcher>'s registered callbacks (including its
+        timers) with reason IOX_CANCEL and then destroy the dispatcher.
 
 
     Invocation:
@@ -588,15 +1422,19 @@ static  pointer  func_IOX_DESTROY (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        dispatcher = (IoxDispatcher) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_IOX_DESTROY) Argument is not a dispatcher: ") ;
         return (sc->F) ;
     }
 
-/* Destroy the dispatcher. */
+/* Cancel the timers in the dispatcher's timing wheel and then destroy the
+   dispatcher.  (Its callbacks' handles are released as they are canceled.) */
+
+    soxDetach (dispatcher) ;
+    opaque_release (sc, (opaque) dispatcher) ;
 
     return (ioxDestroy (dispatcher) ? sc->F : sc->T) ;
 
@@ -655,17 +1493,17 @@ static  pointer  func_IOX_DISPATCHER (
 #    endif
 
 {    /* Local variables. */
-    IoxCallback  callback ;
     IoxDispatcher  dispatcher ;
     pointer  argument ;
+    SoxCallback  *sox ;
 
 
 
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        callback = (IoxCallback) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueCallback)) {
+        sox = (SoxCallback *) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_IOX_DISPATCHER) Argument is not a callback: ") ;
@@ -674,12 +1512,13 @@ static  pointer  func_IOX_DISPATCHER (
 
 /* Get the callback's dispatcher. */
 
-    dispatcher = ioxDispatcher (callback) ;
+    dispatcher = sox->dispatcher ;
 
 /* Return the dispatcher to the caller. */
 
     return ((dispatcher == NULL) ? sc->F
-                                 : mk_opaque (sc, (opaque) dispatcher)) ;
+                                 : mk_opaque (sc, (opaque) dispatcher,
+                                              OpaqueDispatcher)) ;
 
 }
 
@@ -759,8 +1598,8 @@ static  pointer  func_IOX_EVERY (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        dispatcher = (IoxDispatcher) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_IOX_EVERY) Invalid dispatcher specification: ") ;
@@ -810,17 +1649,28 @@ static  pointer  func_IOX_EVERY (
     }
 
     sox->callback = NULL ;
+    sox->timer = NULL ;
+    sox->signal = NULL ;
+    sox->process = NULL ;
+    sox->native = NULL ;
+    sox->pinned = false ;
+    sox->dispatcher = dispatcher ;
     sox->sc = sc ;
-
-/* Register the timer with the dispatcher.  When the specified interval has
-   elapsed, the dispatcher will call funcIOXCB(), which, in turn, will call
-   the Scheme function in the SoxCallback structure. */
-
-    sox->callback = ioxEvery (dispatcher, funcIOXCB, sox, delay, interval) ;
-    if (sox->callback == NULL) {
-        LGE "(func_IOX_EVERY) Error registering callback.\nioxEvery: ") ;
-        PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
-        return (sc->F) ;
+    sox->group = NULL ;
+    sox->nextPending = NULL ;
+    sox->pendingReason = 0 ;
+
+/* Register the timer with the dispatcher's timing wheel.  When the specified
+   interval has elapsed, the wheel will call funcTWLCB(), which, in turn, will
+   call the Scheme function in the SoxCallback structure. */
+
+    if (!trcReplaying (sc, dispatcher)) {
+        sox->timer = soxEvery (dispatcher, funcTWLCB, sox, delay, interval) ;
+        if (sox->timer == NULL) {
+            LGE "(func_IOX_EVERY) Error registering callback.\nsoxEvery: ") ;
+            PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
+            return (sc->F) ;
+        }
     }
 
 /* Save the function object and the user-supplied data so that they remain
@@ -829,9 +1679,11 @@ static  pointer  func_IOX_EVERY (
     sox->functionID = gc_protect (sc, function) ;
     sox->userDataID = gc_protect (sc, userData) ;
 
+    funcSoxLink (sox, "iox-every") ;
+
 /* Return the callback to the caller. */
 
-    return (mk_opaque (sc, (opaque) sox->callback)) ;
+    return (mk_opaque (sc, (opaque) sox, OpaqueCallback)) ;
 
 }
 
@@ -839,48 +1691,57 @@ static  pointer  func_IOX_EVERY (
 
 Procedure:
 
-    func_IOX_MONITOR ()
+    func_IOX_IDLE_GC ()
 
-    Monitor I/O Events.
+    Register an Idle-Time Garbage Collector.
 
 
 Purpose:
 
-    Function func_IOX_MONITOR() passes control to a dispatcher to monitor I/O events, timers, and
-    idle tasks.
+    Function func_IOX_IDLE_GC() registers an idle task with an I/O event
+    dispatcher that runs the garbage collector while the program is idle.
 
-        (iox-monitor <dispatcher> [<timeout>])
+        (iox-idle-gc <dispatcher> <occupancy> [<budget>])
 
-        Monitor and dispatch I/O events, timers, and idle tasks for
-        <timeout> seconds using <dispatcher>.  If the timeout argument
-        is not present or is less than zero, the dispatcher will monitor
-        events forever.  When the timeout interval is complete, IOX-MONITOR
-        returns #t.  In the event of an error (usually no more events to
-        monitor), #f is returned.
+        TinyScheme collects garbage when its cell heap runs out, which, in
+        a server, tends to be in the middle of a burst of I/O callbacks.
+        IOX-IDLE-GC has the collector run in quiet periods instead: when
+        <dispatcher> is idle and the fraction of the heap in use has reached
+        <occupancy> (e.g., 0.75), a collection is run.  If the optional
+        <budget> is given, a collection whose pause, estimated from the
+        last idle collection, would exceed <budget> seconds is skipped and
+        left to the heap running out.  (The collector cannot be stopped
+        partway through.)  If the live data alone fills more than
+        <occupancy> of the heap, collections wait until the heap is half
+        way from the live data to full.  An opaque handle for the idle
+        task is returned to the caller and can be used to cancel the
+        task with IOX-CANCEL.
+
+        The idle collections appear in IOX-STATS as the calls of the idle
+        task; see GC-PAUSES for the counts and pause times of the idle and
+        the other (allocation-triggered) collections.
 
 
     Invocation:
 
-        status = func_IOX_MONITOR (sc, args) ;
+        callback = func_IOX_IDLE_GC (sc, args) ;
 
     where
 
         <sc>		- I
             is the Scheme interpreter.
         <args>		- I
-            is a list of the arguments: the dispatcher doing the monitoring
-            and an optional timeout in seconds after which the dispatcher
-            returns to the caller.
-        <status>	- O
-            returns true (#t) if the dispatcher was monitoring events without
-            errors and false (#f) otherwise.  NOTE that IOX-MONITOR only returns
-            if the timeout period elapses (so the status would be #t) or if an
-            error was detected (so status would be #f).
+            is a list of the arguments: the dispatcher, the fraction of the
+            heap in use at which to collect, and, optionally, the longest
+            acceptable pause in seconds.
+        <callback>	- O
+            returns a callback handle if the idle task was successfully
+            registered and #f if there was an error.
 
 *******************************************************************************/
 
 
-static  pointer  func_IOX_MONITOR (
+static  pointer  func_IOX_IDLE_GC (
 
 #    if PROTOTYPES
         scheme  *sc,
@@ -893,105 +1754,141 @@ static  pointer  func_IOX_MONITOR (
 #    endif
 
 {    /* Local variables. */
-    double  timeout ;
+    double  budget, occupancy ;
     IoxDispatcher  dispatcher ;
     pointer  argument ;
+    SoxCallback  *sox ;
 
 
 
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        dispatcher = (IoxDispatcher) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
-        LGE "(func_IOX_MONITOR) Argument is not a dispatcher: ") ;
+        LGE "(func_IOX_IDLE_GC) Invalid dispatcher specification: ") ;
         return (sc->F) ;
     }
 
     args = cdr (args) ;
-    if (args == sc->NIL) {
-        timeout = -1.0 ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        occupancy = (double) ivalue (argument) ;
+    } else if (isReal (argument)) {
+        occupancy = rvalue (argument) ;
     } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_IDLE_GC) Invalid occupancy specification: ") ;
+        return (sc->F) ;
+    }
+
+    budget = 0.0 ;
+    args = cdr (args) ;
+    if (args != sc->NIL) {
         argument = car (args) ;
         if (isInteger (argument)) {
-            timeout = (double) ivalue (argument) ;
+            budget = (double) ivalue (argument) ;
         } else if (isReal (argument)) {
-            timeout = rvalue (argument) ;
+            budget = rvalue (argument) ;
         } else {
             SET_ERRNO (EINVAL) ;
-            LGE "(func_IOX_MONITOR) Invalid timeout specification: ") ;
+            LGE "(func_IOX_IDLE_GC) Invalid budget specification: ") ;
             return (sc->F) ;
         }
     }
 
-/* Monitor events for the specified interval. */
+/* Allocate a structure to hold the collection policy; a pointer to this
+   structure will be passed to funcIdleGCCB() when the dispatcher is idle.
+   There is no Scheme function; the policy is kept as the user data. */
 
-    return (ioxMonitor (dispatcher, timeout) ? sc->F : sc->T) ;
+    sox = (SoxCallback *) malloc (sizeof (SoxCallback)) ;
+    if (sox == NULL) {
+        LGE "(func_IOX_IDLE_GC) Error allocating SoxCallback structure.\nmalloc: ") ;
+        return (sc->F) ;
+    }
+
+    sox->callback = NULL ;
+    sox->timer = NULL ;
+    sox->signal = NULL ;
+    sox->process = NULL ;
+    sox->native = NULL ;
+    sox->pinned = false ;
+    sox->dispatcher = dispatcher ;
+    sox->sc = sc ;
+    sox->group = NULL ;
+    sox->nextPending = NULL ;
+    sox->pendingReason = 0 ;
+
+/* Register the idle task with the dispatcher.  Nothing is collected during
+   a replay, which has no idle periods. */
+
+    if (!trcReplaying (sc, dispatcher)) {
+        sox->callback = ioxWhenIdle (dispatcher, funcIdleGCCB, sox) ;
+        if (sox->callback == NULL) {
+            LGE "(func_IOX_IDLE_GC) Error registering callback.\nioxWhenIdle: ") ;
+            PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
+            return (sc->F) ;
+        }
+    }
+
+    sox->functionID = 0 ;
+    sox->userDataID = gc_protect (sc, cons (sc, mk_real (sc, occupancy),
+                                            mk_real (sc, budget))) ;
+
+    funcSoxLink (sox, "iox-idle-gc") ;
+
+/* Return the callback to the caller. */
+
+    return (mk_opaque (sc, (opaque) sox, OpaqueCallback)) ;
 
 }
-
+
 /*!*****************************************************************************
 
 Procedure:
 
-    func_IOX_ONIO ()
+    func_IOX_LAG ()
 
-    Register an I/O Source.
+    Get a Dispatcher's Event-Loop Lag.
 
 
 Purpose:
 
-    Function func_IOX_ONIO() registers an I/O source (e.g., a network
-    connection) with an I/O event dispatcher.
-
-        (iox-onio <dispatcher> <function> <userData> <reason> <fd>)
-
-        Register I/O file descriptor <fd> with <dispatcher>.  Mask <reason>
-        is the bit-wise OR of the types of I/O events to monitor: IOX_READ
-        for input-pending, IOX_WRITE for output-ready, and IOX_EXCEPT for
-        OOB-input-pending.  An opaque handle for the registered callback
-        is returned to the caller and can be used to cancel the callback
-        with IOX-CANCEL.
+    Function func_IOX_LAG() returns a dispatcher's event-loop lag statistics.
 
-        When an event of the monitored types is detected on the I/O source,
-        <function> is called with 3 arguments: the callback handle, the
-        application-supplied <userData>, and the reason (IOX_READ, IOX_WRITE,
-        or IOX_EXCEPT) the callback is being invoked.
+        (iox-lag <dispatcher> [<probe>])
 
-        To register a callback for a TCP/IP listening socket (created by
-        TCP-LISTEN), specify IOX_READ as the event type to be monitored.
-        When a connection request is received from a client, the listening
-        socket becomes readable.  The callback should then execute TCP-ANSWER
-        to accept the connection request.
+        Return a list, (<count> <p50> <p99> <max>), giving the number of lag
+        samples taken and the median, 99th-percentile, and maximum lag in
+        seconds.  The lag is how late the dispatcher fires its timers; it
+        is sampled whenever IOX-AFTER or IOX-EVERY timers fire.  If <probe>
+        is specified, a periodic probe timer is set up to sample the lag
+        every <probe> seconds whether or not the program has timers of its
+        own; a <probe> of zero removes the probe.  (Note that a dispatcher
+        with a probe timer always has something to monitor.)
 
 
     Invocation:
 
-        callback = func_IOX_ONIO (sc, args) ;
+        list = func_IOX_LAG (sc, args) ;
 
     where
 
         <sc>		- I
             is the Scheme interpreter.
         <args>		- I
-            is a list of the arguments: the dispatcher, a function to be called
-            when a specified type of event is detected on the I/O source,
-            a user-supplied value to pass to the callback function, the type
-            of event (IOX_READ, IOX_WRITE, IOX_EXCEPT, or IOX_IO) for which
-            the I/O source is to be monitored, and the file descriptor for the
-            I/O source.  The user-supplied value can be an arbitrary Scheme
-            value, so you can use CONS or LIST to pass multiple values to the
-            callback.
-        <callback>	- O
-            returns a callback handle if the callback was successfully
-            registered and #f if there was an error.
+            is a list of the arguments: the dispatcher and, optionally,
+            the probe interval.
+        <list>		- O
+            returns the lag statistics; #f is returned in the event of
+            an error.
 
 *******************************************************************************/
-
 
-static  pointer  func_IOX_ONIO (
+
+static  pointer  func_IOX_LAG (
 
 #    if PROTOTYPES
         scheme  *sc,
@@ -1004,140 +1901,112 @@ static  pointer  func_IOX_ONIO (
 #    endif
 
 {    /* Local variables. */
-    IoFd  fd ;
+    double  interval ;
     IoxDispatcher  dispatcher ;
-    IoxReason  reason ;
-    pointer  argument, function, userData ;
-    SoxCallback  *sox ;
-
+    pointer  argument, list ;
+    SoxLag  lag ;
 
 
 
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        dispatcher = (IoxDispatcher) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
-        LGE "(func_IOX_ONIO) Invalid dispatcher specification: ") ;
+        LGE "(func_IOX_LAG) Argument is not a dispatcher: ") ;
         return (sc->F) ;
     }
 
     args = cdr (args) ;
-    argument = car (args) ;
-    function = argument ;
+    if (args != sc->NIL) {
+        argument = car (args) ;
+        if (isInteger (argument)) {
+            interval = (double) ivalue (argument) ;
+        } else if (isReal (argument)) {
+            interval = rvalue (argument) ;
+        } else {
+            SET_ERRNO (EINVAL) ;
+            LGE "(func_IOX_LAG) Invalid probe interval: ") ;
+            return (sc->F) ;
+        }
+        if (soxProbe (dispatcher, interval))  return (sc->F) ;
+    }
 
-    args = cdr (args) ;
-    argument = car (args) ;
-    userData = argument ;
+/* Get the statistics. */
 
-    args = cdr (args) ;
-    argument = car (args) ;
-    if (isInteger (argument)) {
-        reason = (IoxReason) ivalue (argument) ;
-    } else {
-        SET_ERRNO (EINVAL) ;
-        LGE "(func_IOX_ONIO) Invalid reason specification: ") ;
-        return (sc->F) ;
-    }
-
-    args = cdr (args) ;
-    argument = car (args) ;
-    if (isInteger (argument)) {
-        fd = (IoFd) ivalue (argument) ;
-    } else {
-        SET_ERRNO (EINVAL) ;
-        LGE "(func_IOX_ONIO) Invalid file descriptor specification: ") ;
-        return (sc->F) ;
-    }
-
-/* Allocate a structure to hold the Scheme callback function and the user
-   parameter; a pointer to this structure will be passed to funcIOXCB()
-   when it is invoked for a callback. */
-
-    sox = (SoxCallback *) malloc (sizeof (SoxCallback)) ;
-    if (sox == NULL) {
-        LGE "(func_IOX_ONIO) Error allocating SoxCallback structure.\nmalloc: ") ;
-        return (sc->F) ;
-    }
-
-    sox->callback = NULL ;
-    sox->sc = sc ;
-
-/* Register the I/O source with the dispatcher.  When an I/O event of the
-   specified type is detected on the source, the dispatcher will call
-   funcIOXCB(), which, in turn, will call the Scheme function in the
-   SoxCallback structure. */
-
-    sox->callback = ioxOnIO (dispatcher, funcIOXCB, sox, reason, fd) ;
-    if (sox->callback == NULL) {
-        LGE "(func_IOX_ONIO) Error registering callback.\nioxOnIO: ") ;
-        PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
-        return (sc->F) ;
-    }
-
-/* Save the function object and the user-supplied data so that they remain
-   visible to the garbage collector and are, thus, not garbage collected. */
-
-    sox->functionID = gc_protect (sc, function) ;
-    sox->userDataID = gc_protect (sc, userData) ;
+    if (soxLag (dispatcher, &lag))  return (sc->F) ;
 
-/* Return the callback to the caller. */
+    list = cons (sc, mk_real (sc, lag.max), sc->NIL) ;
+    list = cons (sc, mk_real (sc, lag.p99), list) ;
+    list = cons (sc, mk_real (sc, lag.p50), list) ;
+    list = cons (sc, mk_integer (sc, (long) lag.count), list) ;
 
-    return (mk_opaque (sc, (opaque) sox->callback)) ;
+    return (list) ;
 
 }
-
+
 /*!*****************************************************************************
 
 Procedure:
 
-    func_IOX_WHENIDLE ()
+    func_IOX_MONITOR ()
 
-    Register an Idle Task.
+    Monitor I/O Events.
 
 
 Purpose:
 
-    Function func_IOX_WHENIDLE() registers an idle task with an I/O event
-    dispatcher.
+    Function func_IOX_MONITOR() passes control to a dispatcher to monitor I/O events, timers, and
+    idle tasks.
 
-        (iox-whenidle <dispatcher> <function> <userData>)
+        (iox-monitor <dispatcher> [<timeout>])
 
-        Register an idle task with dispatcher.  An opaque handle for the
-        registered callback is returned to the caller and can be used to
-        cancel the callback with IOX-CANCEL.  When the dispatcher is idle
-        (i.e., no I/O or timers immediately pending), <function> is called
-        with 3 arguments: the callback handle, the application-supplied
-        <userData>, and the reason (IOX_IDLE) the callback is being invoked.
-        After <function> completes, <dispatcher> re-queues the idle task for
-        later processing.  The application is responsible for explicitly
-        canceling the callback using IOX-CANCEL.
+        Monitor and dispatch I/O events, timers, and idle tasks for
+        <timeout> seconds using <dispatcher>.  If the timeout argument
+        is not present or is less than zero, the dispatcher will monitor
+        events forever.  When the timeout interval is complete, IOX-MONITOR
+        returns #t.  In the event of an error (usually no more events to
+        monitor), #f is returned.
+
+        (iox-monitor <dispatcher> <timeout> <events>)
+
+        Monitor and dispatch events until <events> callbacks have been
+        called or <timeout> seconds have elapsed, whichever comes first.
+        Either budget can be -1 for no limit, but not both; a timeout of
+        zero makes one pass over the ready events without waiting.  A pair
+        is returned: the number of callbacks called and the number of
+        seconds until the dispatcher's timers next need servicing (#f if
+        there are no timers), by which time IOX-MONITOR should be called
+        again.  Timers are fired when due even if the event budget
+        has been spent; I/O events detected after it has been spent are
+        left for the next call.  #f is returned in the event of an error.
 
 
     Invocation:
 
-        callback = func_IOX_WHENIDLE (sc, args) ;
+        status = func_IOX_MONITOR (sc, args) ;
 
     where
 
         <sc>		- I
             is the Scheme interpreter.
         <args>		- I
-            is a list of the arguments: the dispatcher, a function to be called
-            when the dispatcher is idle, and a user-supplied value to pass to
-            the callback function.  The user-supplied value can be an arbitrary
-            Scheme value, so you can use CONS or LIST to pass multiple values
-            to the callback.
-        <callback>	- O
-            returns a callback handle if the callback was successfully
-            registered and #f if there was an error.
+            is a list of the arguments: the dispatcher doing the monitoring,
+            an optional timeout in seconds after which the dispatcher
+            returns to the caller, and an optional event budget.
+        <status>	- O
+            returns true (#t) if the dispatcher was monitoring events without
+            errors and false (#f) otherwise.  NOTE that IOX-MONITOR only returns
+            if the timeout period elapses (so the status would be #t) or if an
+            error was detected (so status would be #f).  With an event budget,
+            the pair described above is returned instead of #t.
 
 *******************************************************************************/
-
 
-static  pointer  func_IOX_WHENIDLE (
+
+static  pointer  func_IOX_MONITOR (
 
 #    if PROTOTYPES
         scheme  *sc,
@@ -1150,65 +2019,65 @@ static  pointer  func_IOX_WHENIDLE (
 #    endif
 
 {    /* Local variables. */
+    double  next, timeout ;
     IoxDispatcher  dispatcher ;
-    pointer  argument, function, userData ;
-    SoxCallback  *sox ;
-
+    long  events, handled ;
+    pointer  argument ;
 
 
 
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        dispatcher = (IoxDispatcher) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
-        LGE "(func_IOX_WHENIDLE) Invalid dispatcher specification: ") ;
+        LGE "(func_IOX_MONITOR) Argument is not a dispatcher: ") ;
         return (sc->F) ;
     }
 
-    args = cdr (args) ;
-    argument = car (args) ;
-    function = argument ;
+    events = -2 ;			/* No event budget. */
 
     args = cdr (args) ;
-    argument = car (args) ;
-    userData = argument ;
-
-/* Allocate a structure to hold the Scheme callback function and the user
-   parameter; a pointer to this structure will be passed to funcIOXCB()
-   when it is invoked for a callback. */
-
-    sox = (SoxCallback *) malloc (sizeof (SoxCallback)) ;
-    if (sox == NULL) {
-        LGE "(func_IOX_WHENIDLE) Error allocating SoxCallback structure.\nmalloc: ") ;
-        return (sc->F) ;
+    if (args == sc->NIL) {
+        timeout = -1.0 ;
+    } else {
+        argument = car (args) ;
+        if (isInteger (argument)) {
+            timeout = (double) ivalue (argument) ;
+        } else if (isReal (argument)) {
+            timeout = rvalue (argument) ;
+        } else {
+            SET_ERRNO (EINVAL) ;
+            LGE "(func_IOX_MONITOR) Invalid timeout specification: ") ;
+            return (sc->F) ;
+        }
+        args = cdr (args) ;
+        if (args != sc->NIL) {
+            argument = car (args) ;
+            if (isInteger (argument)) {
+                events = (long) ivalue (argument) ;
+            } else {
+                SET_ERRNO (EINVAL) ;
+                LGE "(func_IOX_MONITOR) Invalid event budget: ") ;
+                return (sc->F) ;
+            }
+        }
     }
 
-    sox->callback = NULL ;
-    sox->sc = sc ;
-
-/* Register the idle task with the dispatcher.  When the dispatcher is idle,
-   it will call funcIOXCB(), which, in turn, will call the Scheme function in
-   the SoxCallback structure. */
-
-    sox->callback = ioxWhenIdle (dispatcher, funcIOXCB, sox) ;
-    if (sox->callback == NULL) {
-        LGE "(func_IOX_WHENIDLE) Error registering callback.\nioxWhenIdle: ") ;
-        PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
-        return (sc->F) ;
-    }
+/* Monitor events for the specified interval. */
 
-/* Save the function object and the user-supplied data so that they remain
-   visible to the garbage collector and are, thus, not garbage collected. */
+    if (events == -2)
+        return (ioxMonitor (dispatcher, timeout) ? sc->F : sc->T) ;
 
-    sox->functionID = gc_protect (sc, function) ;
-    sox->userDataID = gc_protect (sc, userData) ;
+/* Or run a slice within the event and time budgets. */
 
-/* Return the callback to the caller. */
+    if (soxRunSlice (dispatcher, events, timeout, &handled, &next))
+        return (sc->F) ;
 
-    return (mk_opaque (sc, (opaque) sox->callback)) ;
+    return (cons (sc, mk_integer (sc, handled),
+                  (next < 0.0) ? sc->F : mk_real (sc, next))) ;
 
 }
 
@@ -1216,95 +2085,3540 @@ static  pointer  func_IOX_WHENIDLE (
 
 Procedure:
 
-    funcIOXCB ()
+    func_IOX_NATIVE_LINES ()
 
-    Handle an I/O Event Dispatcher Callback.
+    Take Lines off a Native Handler's Queue.
 
 
 Purpose:
 
-    Function funcIOXCB() is a generic IOX handler function assigned to IOX
-    callbacks when a to-be-monitored event is registered using an IOX function.
-    At the time the event was registered, a SoxCallback structure was created
-    containing a Scheme function to be executed when the callback is invoked
-    and the user data to be passed to the function.
+    Function func_IOX_NATIVE_LINES() takes the complete lines queued by a
+    LINES handler attached with IOX-ATTACH-NATIVE.
 
-    When the callback is invoked by the I/O event dispatcher, funcIOXCB()
-    calls the Scheme function, passing it the callback handle, the user
-    data, and the callback reason.
+        (iox-native-lines <callback> [<count>])
+
+        Take up to <count> (default: all) lines off the queue of the handler
+        whose handle is <callback> and return them, without their line
+        terminators, as a list of strings in the order received.  The
+        handler stops reading its source while the queue is full, so the
+        lines should be taken regularly; e.g., from a timer.  After the
+        handler has stopped (e.g., in its IOX_CLOSE callback), an
+        unterminated last line is returned too.  An empty list is returned
+        if no lines are queued and #f is returned in the event of an error.
 
 
     Invocation:
 
-        status = funcIOXCB (callback, reason, userData) ;
+        result = func_IOX_NATIVE_LINES (sc, args) ;
 
-    where:
+    where
 
-        <callback>	- I
-            is the handle assigned to the callback by one of the IOX
-            registration functions.
-        <reason>	- I
-            is the reason (e.g., IoxRead, IoxFire) the callback is being
-            invoked.
-        <userData>	- I
-            is the address of the SoxCallback structure created when the
-            callback was registered with the dispatcher.
-        <status>	- O
-            returns the status of handling the callback, zero if there were
-            no errors and ERRNO otherwise.  The status value is ignored by the
-            IOX dispatcher, but it may be useful if the application calls
-            funcIOXCB() directly.
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the handler's callback handle and the
+            optional maximum number of lines to take.
+        <result>	- O
+            returns the list of lines.
 
 *******************************************************************************/
 
 
-static  errno_t  funcIOXCB (
+static  pointer  func_IOX_NATIVE_LINES (
 
 #    if PROTOTYPES
-        IoxCallback  callback,
-        IoxReason  reason,
-        void  *userData)
+        scheme  *sc,
+        pointer  args)
 #    else
-        dispatcher, reason, userData)
+        sc, args)
 
-        IoxCallback  callback ;
-        IoxReason  reason ;
-        void  *userData ;
+        scheme  *sc ;
+        pointer  args ;
 #    endif
 
 {    /* Local variables. */
-    pointer  args, function, userSupplied ;
-    SoxCallback  *sox = (SoxCallback *) userData ;
+    const  char  *line ;
+    long  count, maxLines ;
+    pointer  argument, first, last, result ;
+    size_t  length ;
+    SoxCallback  *sox ;
 
 
 
-/* If the callback is being cancelled, then deallocate the SoxCallback
-   structure. */
+/* Get the argument(s). */
 
-    if (reason == IoxCancel) {
-        gc_unprotect (sox->sc, sox->functionID) ;
-        gc_unprotect (sox->sc, sox->userDataID) ;
-        sox->callback = NULL ;
-        sox->sc = NULL ;
-        free (sox) ;
-        return (0) ;
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueCallback) &&
+        (strcmp (((SoxCallback *) opaque_value (sc, argument))->kind,
+                 "iox-attach-native") == 0)) {
+        sox = (SoxCallback *) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_NATIVE_LINES) Argument is not a native handler: ") ;
+        return (sc->F) ;
     }
 
-/* Otherwise, call the Scheme function bound to the callback, passing it the
-   callback handle, the callback reason, and the user-supplied argument(s). */
+    args = cdr (args) ;
+    if (args == sc->NIL) {
+        maxLines = -1 ;
+    } else if (isInteger (car (args))) {
+        maxLines = ivalue (car (args)) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_NATIVE_LINES) Invalid count: ") ;
+        return (sc->F) ;
+    }
 
-    function = gc_retrieve (sox->sc, sox->functionID) ;
-    userSupplied = gc_retrieve (sox->sc, sox->userDataID) ;
+/* Build the list of lines in order, appending to its tail. */
+
+    result = sc->NIL ;
+    if (sox->dead || (sox->native == NULL))  return (result) ;
+
+    last = sc->NIL ;
+    for (count = 0 ;  (maxLines < 0) || (count < maxLines) ;  count++) {
+        line = ntvNextLine (sox->native, &length) ;
+        if (line == NULL)  break ;
+        first = cons (sc, mk_bstring (sc, line, length), sc->NIL) ;
+        if (last == sc->NIL)
+            result = first ;
+        else
+            set_cdr (last, first) ;
+        last = first ;
+    }
 
-				/* One or more user-supplied parameters. */
-    args = cons (sox->sc, userSupplied, sox->sc->NIL) ;
-				/* Reason for callback. */
-    args = cons (sox->sc, mk_integer (sox->sc, (long) reason), args) ;
-				/* Callback handle. */
-    args = cons (sox->sc, mk_opaque (sox->sc, (void *) callback), args) ;
+    return (result) ;
 
-    scheme_call (sox->sc, function, args) ;
+}
 
-    return (0) ;
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_ONIO ()
+
+    Register an I/O Source.
+
+
+Purpose:
+
+    Function func_IOX_ONIO() registers an I/O source (e.g., a network
+    connection) with an I/O event dispatcher.
+
+        (iox-onio <dispatcher> <function> <userData> <reason> <fd>)
+
+        Register I/O file descriptor <fd> with <dispatcher>.  Mask <reason>
+        is the bit-wise OR of the types of I/O events to monitor: IOX_READ
+        for input-pending, IOX_WRITE for output-ready, and IOX_EXCEPT for
+        OOB-input-pending.  An opaque handle for the registered callback
+        is returned to the caller and can be used to cancel the callback
+        with IOX-CANCEL.
+
+        When an event of the monitored types is detected on the I/O source,
+        <function> is called with 3 arguments: the callback handle, the
+        application-supplied <userData>, and the reason (IOX_READ, IOX_WRITE,
+        or IOX_EXCEPT) the callback is being invoked.
+
+        To register a callback for a TCP/IP listening socket (created by
+        TCP-LISTEN), specify IOX_READ as the event type to be monitored.
+        When a connection request is received from a client, the listening
+        socket becomes readable.  The callback should then execute TCP-ANSWER
+        to accept the connection request.
+
+
+    Invocation:
+
+        callback = func_IOX_ONIO (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher, a function to be called
+            when a specified type of event is detected on the I/O source,
+            a user-supplied value to pass to the callback function, the type
+            of event (IOX_READ, IOX_WRITE, IOX_EXCEPT, or IOX_IO) for which
+            the I/O source is to be monitored, and the file descriptor for the
+            I/O source.  The user-supplied value can be an arbitrary Scheme
+            value, so you can use CONS or LIST to pass multiple values to the
+            callback.
+        <callback>	- O
+            returns a callback handle if the callback was successfully
+            registered and #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_ONIO (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    IoFd  fd ;
+    IoxDispatcher  dispatcher ;
+    IoxReason  reason ;
+    pointer  argument, function, userData ;
+    SoxCallback  *sox ;
+
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ONIO) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    function = argument ;
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    userData = argument ;
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        reason = (IoxReason) ivalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ONIO) Invalid reason specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        fd = (IoFd) ivalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ONIO) Invalid file descriptor specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Allocate a structure to hold the Scheme callback function and the user
+   parameter; a pointer to this structure will be passed to funcIOXCB()
+   when it is invoked for a callback. */
+
+    sox = (SoxCallback *) malloc (sizeof (SoxCallback)) ;
+    if (sox == NULL) {
+        LGE "(func_IOX_ONIO) Error allocating SoxCallback structure.\nmalloc: ") ;
+        return (sc->F) ;
+    }
+
+    sox->callback = NULL ;
+    sox->timer = NULL ;
+    sox->signal = NULL ;
+    sox->process = NULL ;
+    sox->native = NULL ;
+    sox->pinned = false ;
+    sox->dispatcher = dispatcher ;
+    sox->sc = sc ;
+    sox->group = NULL ;
+    sox->nextPending = NULL ;
+    sox->pendingReason = 0 ;
+
+/* Register the I/O source with the dispatcher.  When an I/O event of the
+   specified type is detected on the source, the dispatcher will call
+   funcIOXCB(), which, in turn, will call the Scheme function in the
+   SoxCallback structure. */
+
+    if (!trcReplaying (sc, dispatcher)) {
+        sox->callback = ioxOnIO (dispatcher, funcIOXCB, sox, reason, fd) ;
+        if (sox->callback == NULL) {
+            LGE "(func_IOX_ONIO) Error registering callback.\nioxOnIO: ") ;
+            PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
+            return (sc->F) ;
+        }
+    }
+
+/* Save the function object and the user-supplied data so that they remain
+   visible to the garbage collector and are, thus, not garbage collected. */
+
+    sox->functionID = gc_protect (sc, function) ;
+    sox->userDataID = gc_protect (sc, userData) ;
+
+    funcSoxLink (sox, "iox-onio") ;
+
+/* Return the callback to the caller. */
+
+    return (mk_opaque (sc, (opaque) sox, OpaqueCallback)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_ONIO_GROUP ()
+
+    Register an I/O Source as a Member of a Group.
+
+
+Purpose:
+
+    Function func_IOX_ONIO_GROUP() registers an I/O source with an I/O event
+    dispatcher as a member of a group.  All the I/O sources registered with
+    the same dispatcher and the same function are members of one group.
+
+        (iox-onio-group <dispatcher> <function> <userData> <reason> <fd>)
+
+        Register I/O file descriptor <fd> with <dispatcher> as a member of
+        <function>'s group.  The arguments are the same as for IOX-ONIO and
+        an opaque handle for the member is likewise returned to the caller;
+        the handle can be used with IOX-CANCEL and IOX-DISPATCHER.
+
+        The difference is in how <function> is called.  When an event of the
+        monitored types is detected on a member, the event is recorded rather
+        than delivered immediately.  At the start of the dispatcher's next
+        iteration (after all the I/O events detected in the current iteration
+        have been handled), <function> is called once with a single argument:
+        a list of (<callback> <reason> <userData>) records, one for each
+        member with pending events, in the order the events were detected.
+        If more than one type of event was detected on a member, <reason> is
+        the bit-wise OR of the types.  For example,
+
+            (define (ready-clients records)
+                (for-each (lambda (record)
+                              (apply echo-client record))
+                          records))
+            ...
+            (iox-onio-group dispatcher ready-clients client IOX_READ
+                            (tcp-fd client))
+
+        A member that is canceled before its events are delivered is dropped
+        from the list.
+
+
+    Invocation:
+
+        callback = func_IOX_ONIO_GROUP (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher, the group's function,
+            a user-supplied value to pass back in the member's records, the
+            type of event (IOX_READ, IOX_WRITE, IOX_EXCEPT, or IOX_IO) for
+            which the I/O source is to be monitored, and the file descriptor
+            for the I/O source.
+        <callback>	- O
+            returns a callback handle if the member was successfully
+            registered and #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_ONIO_GROUP (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    IoFd  fd ;
+    IoxDispatcher  dispatcher ;
+    IoxReason  reason ;
+    pointer  argument, function, userData ;
+    SoxCallback  *sox ;
+    SoxGroup  *group ;
+
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ONIO_GROUP) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    function = argument ;
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    userData = argument ;
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        reason = (IoxReason) ivalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ONIO_GROUP) Invalid reason specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        fd = (IoFd) ivalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ONIO_GROUP) Invalid file descriptor specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Look up the group for this dispatcher and function; create it if this is
+   the first member. */
+
+    for (group = groupList ;  group != NULL ;  group = group->next) {
+        if ((group->dispatcher == dispatcher) && (group->sc == sc) &&
+            (group->function == function))  break ;
+    }
+
+    if (group == NULL) {
+        group = (SoxGroup *) calloc (1, sizeof (SoxGroup)) ;
+        if (group == NULL) {
+            LGE "(func_IOX_ONIO_GROUP) Error allocating SoxGroup structure.\ncalloc: ") ;
+            return (sc->F) ;
+        }
+        group->dispatcher = dispatcher ;
+        group->sc = sc ;
+        group->function = function ;
+        group->functionID = gc_protect (sc, function) ;
+        group->numMembers = 0 ;
+        group->pending = group->lastPending = NULL ;
+        group->flush.func = funcGroupFlush ;
+        group->flush.userData = group ;
+        group->flush.queued = false ;
+        group->busy = 0 ;
+        memset (&group->stats, 0, sizeof (SoxStats)) ;
+        group->next = groupList ;
+        groupList = group ;
+    }
+
+/* Allocate a structure to hold the member's user parameter; a pointer to
+   this structure will be passed to funcGroupCB() when it is invoked for
+   a callback. */
+
+    sox = (SoxCallback *) malloc (sizeof (SoxCallback)) ;
+    if (sox == NULL) {
+        LGE "(func_IOX_ONIO_GROUP) Error allocating SoxCallback structure.\nmalloc: ") ;
+        return (sc->F) ;
+    }
+
+    sox->callback = NULL ;
+    sox->timer = NULL ;
+    sox->signal = NULL ;
+    sox->process = NULL ;
+    sox->native = NULL ;
+    sox->pinned = false ;
+    sox->dispatcher = dispatcher ;
+    sox->sc = sc ;
+    sox->group = group ;
+    sox->nextPending = NULL ;
+    sox->pendingReason = 0 ;
+
+/* Register the I/O source with the dispatcher.  When an I/O event of the
+   specified type is detected on the source, the dispatcher will call
+   funcGroupCB(), which records the event for later delivery by
+   funcGroupFlush(). */
+
+    if (!trcReplaying (sc, dispatcher)) {
+        sox->callback = ioxOnIO (dispatcher, funcGroupCB, sox, reason, fd) ;
+        if (sox->callback == NULL) {
+            LGE "(func_IOX_ONIO_GROUP) Error registering callback.\nioxOnIO: ") ;
+            PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
+            return (sc->F) ;
+        }
+    }
+
+    group->numMembers++ ;
+
+/* Save the user-supplied data so that it remains visible to the garbage
+   collector; the group holds the function. */
+
+    sox->functionID = 0 ;
+    sox->userDataID = gc_protect (sc, userData) ;
+
+    funcSoxLink (sox, "iox-onio-group") ;
+
+/* Return the callback to the caller. */
+
+    return (mk_opaque (sc, (opaque) sox, OpaqueCallback)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_ONSIGNAL ()
+
+    Register a Signal Callback.
+
+
+Purpose:
+
+    Function func_IOX_ONSIGNAL() registers a callback to be invoked by an
+    I/O event dispatcher when a signal is received.
+
+        (iox-onsignal <dispatcher> <function> <userData> <signal>)
+
+        Watch for <signal> (e.g., SIGTERM, SIGHUP, SIGCHLD, SIGUSR1) on
+        <dispatcher>.  An opaque handle for the registered callback is
+        returned to the caller and can be used to cancel the callback with
+        IOX-CANCEL, after which the signal's original handling is restored.
+
+        When the signal is received, <function> is called with 3 arguments:
+        the callback handle, the application-supplied <userData>, and the
+        reason (IOX_SIGNAL) the callback is being invoked.  The call is made
+        by the dispatcher like any other callback, not from a signal handler.
+        If the signal is received several times before the dispatcher gets
+        to it, <function> is called once.  A signal should only be watched
+        through one dispatcher.
+
+
+    Invocation:
+
+        callback = func_IOX_ONSIGNAL (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher, a function to be called
+            when the signal is received, a user-supplied value to pass to the
+            callback function, and the signal number.
+        <callback>	- O
+            returns a callback handle if the callback was successfully
+            registered and #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_ONSIGNAL (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    int  signo ;
+    IoxDispatcher  dispatcher ;
+    pointer  argument, function, userData ;
+    SoxCallback  *sox ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ONSIGNAL) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    function = argument ;
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    userData = argument ;
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        signo = (int) ivalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_ONSIGNAL) Invalid signal specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Allocate a structure to hold the Scheme callback function and the user
+   parameter; a pointer to this structure will be passed to funcIOXCB()
+   when it is invoked for a callback. */
+
+    sox = (SoxCallback *) malloc (sizeof (SoxCallback)) ;
+    if (sox == NULL) {
+        LGE "(func_IOX_ONSIGNAL) Error allocating SoxCallback structure.\nmalloc: ") ;
+        return (sc->F) ;
+    }
+
+    sox->callback = NULL ;
+    sox->timer = NULL ;
+    sox->signal = NULL ;
+    sox->process = NULL ;
+    sox->native = NULL ;
+    sox->pinned = false ;
+    sox->dispatcher = dispatcher ;
+    sox->sc = sc ;
+    sox->group = NULL ;
+    sox->nextPending = NULL ;
+    sox->pendingReason = 0 ;
+
+/* Watch for the signal.  When the signal is received, the dispatcher will
+   call funcSignalCB(), which, in turn, will call the Scheme function in the
+   SoxCallback structure. */
+
+    if (!trcReplaying (sc, dispatcher)) {
+        sox->signal = soxOnSignal (dispatcher, signo, funcSignalCB, sox) ;
+        if (sox->signal == NULL) {
+            LGE "(func_IOX_ONSIGNAL) Error registering callback.\nsoxOnSignal: ") ;
+            PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
+            return (sc->F) ;
+        }
+    }
+
+/* Protect the function object and the user-supplied data from the garbage
+   collector. */
+
+    sox->functionID = gc_protect (sc, function) ;
+    sox->userDataID = gc_protect (sc, userData) ;
+
+    funcSoxLink (sox, "iox-onsignal") ;
+
+/* Return the callback to the caller. */
+
+    return (mk_opaque (sc, (opaque) sox, OpaqueCallback)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_POST ()
+
+    Post a Function Call to a Dispatcher.
+
+
+Purpose:
+
+    Function func_IOX_POST() posts a function call to a dispatcher's
+    mailbox.
+
+        (iox-post <dispatcher> <function> <userData>)
+
+        Queue a call to <function> in <dispatcher>'s mailbox.  When the
+        dispatcher next checks its mailbox, <function> is called with one
+        argument, <userData>.  Calls are made in the order posted, and
+        all the calls posted before the dispatcher checks its mailbox are
+        made together.  The mailbox is opened by the first post; thereafter,
+        the dispatcher always has something to monitor.  The status of
+        posting the call, #t or #f, is returned to the caller.  If the
+        dispatcher is destroyed before the call is made, the call is
+        discarded.
+
+
+    Invocation:
+
+        status = func_IOX_POST (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher, the function to be
+            called, and a user-supplied value to pass to the function.
+        <status>	- O
+            returns true (#t) if the call was posted successfully
+            and false (#f) otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_POST (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    IoxDispatcher  dispatcher ;
+    pointer  argument, function, userData ;
+    SoxPosted  *posted ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_POST) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    function = car (args) ;
+
+    args = cdr (args) ;
+    userData = car (args) ;
+
+/* Open the dispatcher's mailbox, if necessary, and post the call. */
+
+    if (soxMailbox (dispatcher))  return (sc->F) ;
+
+    posted = (SoxPosted *) malloc (sizeof (SoxPosted)) ;
+    if (posted == NULL) {
+        LGE "(func_IOX_POST) Error allocating SoxPosted structure.\nmalloc: ") ;
+        return (sc->F) ;
+    }
+
+    posted->dispatcher = dispatcher ;
+    posted->sc = sc ;
+    posted->functionID = gc_protect (sc, function) ;
+    posted->userDataID = gc_protect (sc, userData) ;
+
+    if (soxPost (dispatcher, funcPostCB, (void *) posted)) {
+        PUSH_ERRNO ;
+        gc_unprotect (sc, posted->functionID) ;
+        gc_unprotect (sc, posted->userDataID) ;
+        free (posted) ;
+        POP_ERRNO ;
+        return (sc->F) ;
+    }
+
+    return (sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_REPLAY ()
+
+    Replay an Event Trace.
+
+
+Purpose:
+
+    Function func_IOX_REPLAY() replays a trace recorded with IOX-TRACE
+    through the callbacks registered with a dispatcher.
+
+        (iox-replay <dispatcher> <pathname>)
+
+        Replay the events recorded in trace file <pathname> through
+        <dispatcher>'s callbacks, as fast as the callbacks can handle them,
+        and return a list of statistics:
+
+            (<events> <results> <mismatches> <recorded> <elapsed>)
+
+        where <events> is the number of callback events replayed, <results>
+        is the number of recorded I/O results returned to the program,
+        <mismatches> is the number of times the program's I/O calls didn't
+        match the recording, <recorded> is the time in seconds spanned by
+        the recording, and <elapsed> is the time in seconds taken by the
+        replay.  #f is returned if the trace could not be opened.
+
+        IOX-REPLAY is called in place of IOX-MONITOR, after the program has
+        set up its dispatcher in the same way it did for the recording:
+
+            (define dispatcher (iox-create))
+            (define listener (tcp-listen 10234))
+            (iox-onio dispatcher answer-client listener IOX_READ
+                      (tcp-fd listener))
+            (display (iox-replay dispatcher "echod.trc"))
+
+        While the trace is replayed, callbacks registered with <dispatcher>
+        are not registered with the dispatcher itself; instead, each recorded
+        event is delivered directly to the callback with the same serial
+        number.  TCP and LFN I/O functions return the recorded results, and
+        new connections are represented by fake handles, so no network I/O
+        is performed.  Timers don't wait: a single-shot timer's event is
+        delivered, and the timer canceled, when its turn in the trace comes.
+
+        Deferred work (e.g., the delivery of I/O group events) is run before
+        each event, except between consecutive events for I/O group members,
+        which are batched together as they would have been by the dispatcher.
+        The batching can differ from the recording when group events and
+        other events were detected in the same iteration of the dispatcher.
+        Calls posted with IOX-POST wait in the mailbox until the dispatcher
+        is next monitored.
+
+
+    Invocation:
+
+        list = func_IOX_REPLAY (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher and the pathname of
+            the trace file.
+        <list>		- O
+            returns a list of the replay's statistics; #f is returned in
+            the event of an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_REPLAY (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    bool  inGroup, oneShot ;
+    errno_t  status ;
+    IoxDispatcher  dispatcher ;
+    IoxReason  reason ;
+    long  count ;
+    pointer  argument, extra, result ;
+    SoxCallback  *sox ;
+    struct  timeval  startTime ;
+    TrcStats  stats ;
+    UniqueID  extraID ;
+    unsigned  long  id ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_REPLAY) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (!is_string (argument)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_REPLAY) Invalid pathname specification: ") ;
+        return (sc->F) ;
+    }
+
+    if (trcStart (sc, dispatcher, strvalue (argument), true)) {
+        LGE "(func_IOX_REPLAY) Error opening trace %s.\ntrcStart: ",
+            strvalue (argument)) ;
+        return (sc->F) ;
+    }
+
+/* Deliver each event in the trace to its callback.  If the program hasn't
+   consumed all the results recorded before the event, run the deferred work
+   that would have consumed them before skipping them. */
+
+    startTime = tvTOD () ;
+    inGroup = false ;
+
+    for ( ; ; ) {
+
+        status = trcNextEvent (sc, false, &id, &reason, &extra) ;
+        if (status == EAGAIN) {
+            do {
+                soxFlush (dispatcher, &count) ;
+            } while (count > 0) ;
+            inGroup = false ;
+            status = trcNextEvent (sc, true, &id, &reason, &extra) ;
+        }
+        if (status)  break ;
+
+        sox = funcSoxFind (dispatcher, id) ;
+        if ((sox == NULL) || sox->dead) {
+            LGI "(func_IOX_REPLAY) Callback %lu not found; event skipped.\n",
+                id) ;
+            continue ;
+        }
+
+        extraID = (extra == NULL) ? 0 : gc_protect (sc, extra) ;
+
+        if ((sox->group == NULL) || !inGroup) {
+            do {
+                soxFlush (dispatcher, &count) ;
+            } while (count > 0) ;
+        }
+        inGroup = (sox->group != NULL) ;
+
+	/* The event's callback may have been canceled by the deferred work. */
+        sox = funcSoxFind (dispatcher, id) ;
+        if ((sox == NULL) || sox->dead) {
+            if (extraID != 0)  gc_unprotect (sc, extraID) ;
+            continue ;
+        }
+
+        if (sox->group != NULL) {
+            funcGroupCB (NULL, reason, sox) ;
+        } else {
+            oneShot = (reason == SPX_EXIT) || (reason == NTV_CLOSE) ||
+                      ((reason == IoxFire) &&
+                       (strcmp (sox->kind, "iox-after") == 0)) ;
+            funcSoxCall (sox, reason, extra) ;
+            if (oneShot && ((sox = funcSoxFind (dispatcher, id)) != NULL))
+                funcSoxCall (sox, IoxCancel, NULL) ;
+        }
+
+        if (extraID != 0)  gc_unprotect (sc, extraID) ;
+
+    }
+
+    do {
+        soxFlush (dispatcher, &count) ;
+    } while (count > 0) ;
+
+    trcStop (sc, &stats) ;
+
+/* Return the statistics to the caller. */
+
+    result = cons (sc, mk_real (sc, tvFloat (tvSubtract (tvTOD (),
+                                                         startTime))),
+                   sc->NIL) ;
+    result = cons (sc, mk_real (sc, stats.recorded), result) ;
+    result = cons (sc, mk_integer (sc, (long) stats.mismatches), result) ;
+    result = cons (sc, mk_integer (sc, (long) stats.results), result) ;
+    result = cons (sc, mk_integer (sc, (long) stats.events), result) ;
+
+    return (result) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_RESCHEDULE ()
+
+    Reschedule a Timer.
+
+
+Purpose:
+
+    Function func_IOX_RESCHEDULE() reschedules a timer registered with
+    IOX-AFTER or IOX-EVERY.
+
+        (iox-reschedule <callback> <delay>)
+
+        Reschedule timer <callback>, where <callback> is the opaque handle
+        returned when the timer was registered, to fire <delay> seconds
+        from now.  The delay can include a fractional number of seconds.
+        A periodic timer resumes its regular interval after the rescheduled
+        firing.  A single-shot timer can reschedule itself from within its
+        callback function, in which case it is not automatically canceled.
+        Rescheduling is a constant-time operation, so it is well-suited
+        for pushing back per-connection idle timers on activity.  The
+        status of rescheduling the timer, #t or #f, is returned to the
+        caller.
+
+
+    Invocation:
+
+        status = func_IOX_RESCHEDULE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the timer to be rescheduled and the
+            new delay in seconds.
+        <status>	- O
+            returns true (#t) if the timer was rescheduled successfully
+            and false (#f) otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_RESCHEDULE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    double  delay ;
+    pointer  argument ;
+    SoxCallback  *sox ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueCallback)) {
+        sox = (SoxCallback *) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_RESCHEDULE) Argument is not a callback: ") ;
+        return (sc->F) ;
+    }
+
+    if (sox->traced)  return (sc->T) ;	/* Registered during a replay? */
+
+    if (sox->timer == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_RESCHEDULE) Callback is not a timer: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        delay = (double) ivalue (argument) ;
+    } else if (isReal (argument)) {
+        delay = rvalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_RESCHEDULE) Invalid delay specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Reschedule the timer. */
+
+    return (soxReschedule (sox->dispatcher, sox->timer, delay) ? sc->F
+                                                               : sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_SLOW ()
+
+    Set the Slow-Callback Threshold.
+
+
+Purpose:
+
+    Function func_IOX_SLOW() sets a dispatcher's slow-callback threshold.
+
+        (iox-slow <dispatcher> <seconds>)
+
+        Log any call to a Scheme callback function registered with
+        <dispatcher> that takes longer than <seconds> (fractional seconds
+        allowed; e.g., 0.050 for 50 milliseconds).  A line is written to
+        standard error giving the time taken, the IOX function with which
+        the callback was registered (e.g., "iox-onio"), and the name of
+        the global variable, if any, bound to the callback function.
+        A threshold of zero disables logging, which is the default.
+        The status of setting the threshold, #t or #f, is returned to
+        the caller.
+
+
+    Invocation:
+
+        status = func_IOX_SLOW (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher and the threshold
+            in seconds.
+        <status>	- O
+            returns true (#t) if the threshold was set successfully
+            and false (#f) otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_SLOW (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    double  threshold ;
+    IoxDispatcher  dispatcher ;
+    pointer  argument ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_SLOW) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        threshold = (double) ivalue (argument) ;
+    } else if (isReal (argument)) {
+        threshold = rvalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_SLOW) Invalid threshold specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Set the threshold. */
+
+    return (soxSetSlow (dispatcher, threshold) ? sc->F : sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_SPAWN ()
+
+    Spawn a Child Process.
+
+
+Purpose:
+
+    Function func_IOX_SPAWN() runs a program as a child process monitored
+    by an I/O event dispatcher.
+
+        (iox-spawn <dispatcher> <function> <userData> <argv>)
+
+        Run the program named by the first string in list <argv>, with the
+        remaining strings as its arguments; the program is located using
+        the PATH environment variable.  The child's standard input, output,
+        and error are pipes monitored by <dispatcher>.  An opaque handle for
+        the process is returned to the caller and can be used to feed input
+        to the child with IOX-SPAWN-WRITE, to signal it with IOX-SPAWN-KILL,
+        or to cancel the callback with IOX-CANCEL (which closes the pipes but
+        leaves the child running).  If the program can't be executed, #f is
+        returned.
+
+        <function> is called with 4 arguments: the process handle, the
+        reason the callback is being invoked, the application-supplied
+        <userData>, and a value depending on the reason.  For reasons
+        IOX_STDOUT and IOX_STDERR, the value is a string of output from the
+        child; output is delivered in chunks as it arrives, not in lines.
+        After the child has exited and all its output has been delivered,
+        <function> is called a final time with reason IOX_EXIT and the
+        child's exit code or, if the child was killed by a signal, the
+        negated signal number.
+
+
+    Invocation:
+
+        callback = func_IOX_SPAWN (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher, a function to be called
+            with the process's output and exit code, a user-supplied value to
+            pass to the callback function, and a list of the program name and
+            arguments.
+        <callback>	- O
+            returns a callback handle if the process was successfully spawned
+            and #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_SPAWN (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    char  **argv ;
+    int  i, numArgs ;
+    IoxDispatcher  dispatcher ;
+    pointer  argument, function, list, userData ;
+    SoxCallback  *sox ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_SPAWN) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    function = argument ;
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    userData = argument ;
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    numArgs = 0 ;
+    for (list = argument ;  is_pair (list) ;  list = cdr (list)) {
+        if (!is_string (car (list)))  break ;
+        numArgs++ ;
+    }
+    if ((numArgs == 0) || (list != sc->NIL)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_SPAWN) Invalid argument list: ") ;
+        return (sc->F) ;
+    }
+
+/* Construct the NULL-terminated argument array for execvp(3). */
+
+    argv = (char **) malloc ((numArgs + 1) * sizeof (char *)) ;
+    if (argv == NULL) {
+        LGE "(func_IOX_SPAWN) Error allocating %d-argument array.\nmalloc: ",
+            numArgs) ;
+        return (sc->F) ;
+    }
+
+    for (i = 0, list = argument ;  i < numArgs ;  i++, list = cdr (list))
+        argv[i] = strvalue (car (list)) ;
+    argv[numArgs] = NULL ;
+
+/* Allocate a structure to hold the Scheme callback function and the user
+   parameter; a pointer to this structure will be passed to funcSpawnCB()
+   when it is invoked for the process. */
+
+    sox = (SoxCallback *) malloc (sizeof (SoxCallback)) ;
+    if (sox == NULL) {
+        LGE "(func_IOX_SPAWN) Error allocating SoxCallback structure.\nmalloc: ") ;
+        PUSH_ERRNO ;  free (argv) ;  POP_ERRNO ;
+        return (sc->F) ;
+    }
+
+    sox->callback = NULL ;
+    sox->timer = NULL ;
+    sox->signal = NULL ;
+    sox->process = NULL ;
+    sox->native = NULL ;
+    sox->pinned = false ;
+    sox->dispatcher = dispatcher ;
+    sox->sc = sc ;
+    sox->group = NULL ;
+    sox->nextPending = NULL ;
+    sox->pendingReason = 0 ;
+
+/* Spawn the process.  When the process produces output or exits, the
+   dispatcher will call funcSpawnCB(), which, in turn, will call the Scheme
+   function in the SoxCallback structure. */
+
+    if (!trcReplaying (sc, dispatcher)) {
+        sox->process = spxSpawn (dispatcher, argv, funcSpawnCB, sox) ;
+        if (sox->process == NULL) {
+            LGE "(func_IOX_SPAWN) Error spawning process.\nspxSpawn: ") ;
+            PUSH_ERRNO ;  free (argv) ;  free (sox) ;  POP_ERRNO ;
+            return (sc->F) ;
+        }
+    }
+    free (argv) ;
+
+/* Protect the function object and the user-supplied data from the garbage
+   collector. */
+
+    sox->functionID = gc_protect (sc, function) ;
+    sox->userDataID = gc_protect (sc, userData) ;
+
+    funcSoxLink (sox, "iox-spawn") ;
+
+/* Return the callback to the caller. */
+
+    return (mk_opaque (sc, (opaque) sox, OpaqueCallback)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_SPAWN_KILL ()
+
+    Send a Signal to a Spawned Process.
+
+
+Purpose:
+
+    Function func_IOX_SPAWN_KILL() sends a signal to a process spawned by
+    IOX-SPAWN.
+
+        (iox-spawn-kill <callback> <signal>)
+
+        Send <signal> (e.g., SIGTERM) to the process spawned with callback
+        handle <callback>.  The process's callback function will be called
+        with reason IOX_EXIT when the process exits.  The status of sending
+        the signal, #t or #f, is returned to the caller.
+
+
+    Invocation:
+
+        status = func_IOX_SPAWN_KILL (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the process's callback handle and
+            the signal number.
+        <status>	- O
+            returns true (#t) if the signal was sent successfully
+            and false (#f) otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_SPAWN_KILL (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    int  signo ;
+    pointer  argument ;
+    SoxCallback  *sox ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueCallback) &&
+        ((((SoxCallback *) opaque_value (sc, argument))->process != NULL) ||
+         ((SoxCallback *) opaque_value (sc, argument))->traced)) {
+        sox = (SoxCallback *) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_SPAWN_KILL) Argument is not a process: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        signo = (int) ivalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_SPAWN_KILL) Invalid signal specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Send the signal. */
+
+    if (sox->dead)  return (sc->F) ;
+    if (sox->traced)  return (sc->T) ;	/* Registered during a replay? */
+
+    return (spxKill (sox->process, signo) ? sc->F : sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_SPAWN_WRITE ()
+
+    Write to a Spawned Process's Standard Input.
+
+
+Purpose:
+
+    Function func_IOX_SPAWN_WRITE() writes a string to the standard input
+    of a process spawned by IOX-SPAWN.
+
+        (iox-spawn-write <callback> <string>)
+        (iox-spawn-write <callback> #f)
+
+        Write <string> to the standard input of the process spawned with
+        callback handle <callback>.  The string is written as fast as the
+        process reads it, without blocking the caller; any number of strings
+        can be queued.  Passing #f instead of a string closes the process's
+        standard input (after any queued strings have been written), so the
+        process sees end-of-file.  The status, #t or #f, is returned to the
+        caller.
+
+
+    Invocation:
+
+        status = func_IOX_SPAWN_WRITE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the process's callback handle and
+            the string to write or #f.
+        <status>	- O
+            returns true (#t) if the string was queued (or the input closed)
+            successfully and false (#f) otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_SPAWN_WRITE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    pointer  argument ;
+    SoxCallback  *sox ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueCallback) &&
+        ((((SoxCallback *) opaque_value (sc, argument))->process != NULL) ||
+         ((SoxCallback *) opaque_value (sc, argument))->traced)) {
+        sox = (SoxCallback *) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_SPAWN_WRITE) Argument is not a process: ") ;
+        return (sc->F) ;
+    }
+
+    if (sox->dead)  return (sc->F) ;
+    if (sox->traced)  return (sc->T) ;	/* Registered during a replay? */
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (argument == sc->F) {
+        return (spxCloseInput (sox->process) ? sc->F : sc->T) ;
+    } else if (is_string (argument)) {
+        return (spxWrite (sox->process, strvalue (argument),
+                          (size_t) strlength (argument)) ? sc->F : sc->T) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_SPAWN_WRITE) Invalid data specification: ") ;
+        return (sc->F) ;
+    }
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_STATS ()
+
+    Get Callback Statistics.
+
+
+Purpose:
+
+    Function func_IOX_STATS() returns the timing statistics for the Scheme
+    callbacks registered with a dispatcher.
+
+        (iox-stats <dispatcher>)
+
+        Return a list with an entry for each callback currently registered
+        with <dispatcher>.  Each entry is a list:
+
+            (<callback> <kind> <name> <count> <total> <max> <histogram>)
+
+        where <callback> is the callback handle, <kind> is the name of the
+        registering IOX function (e.g., "iox-onio"), <name> is the name of
+        the global variable bound to the callback function (#f if none),
+        <count> is the number of calls made to the function, <total> and
+        <max> are the total and maximum times in seconds spent in those
+        calls, and <histogram> is a list of 7 call counts: calls taking
+        under 10 microseconds, under 100 microseconds, under 1 millisecond,
+        under 10 milliseconds, under 100 milliseconds, under 1 second, and
+        1 second or longer.
+
+        The members of an I/O group (see IOX-ONIO-GROUP) are not listed
+        individually; instead, there is one entry for each group, with #f
+        as the callback handle.
+
+
+    Invocation:
+
+        list = func_IOX_STATS (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher.
+        <list>		- O
+            returns a list of statistics entries; #f is returned in the
+            event of an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_STATS (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    IoxDispatcher  dispatcher ;
+    pointer  argument, entry, list ;
+    SoxCallback  *sox ;
+    SoxGroup  *group ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_STATS) Argument is not a dispatcher: ") ;
+        return (sc->F) ;
+    }
+
+/* Construct an entry for each of the dispatcher's callbacks and groups. */
+
+    list = sc->NIL ;
+
+    for (sox = soxList ;  sox != NULL ;  sox = sox->next) {
+        if ((sox->dispatcher != dispatcher) || (sox->sc != sc) ||
+            (sox->group != NULL) || sox->dead)  continue ;
+        entry = funcStatsList (sc, mk_opaque (sc, (opaque) sox,
+                                              OpaqueCallback), sox->kind,
+                               (sox->functionID == 0) ? NULL
+                               : gc_retrieve (sc, sox->functionID),
+                               &sox->stats) ;
+        list = cons (sc, entry, list) ;
+    }
+
+    for (group = groupList ;  group != NULL ;  group = group->next) {
+        if ((group->dispatcher != dispatcher) || (group->sc != sc))  continue ;
+        entry = funcStatsList (sc, sc->F, "iox-onio-group", group->function,
+                               &group->stats) ;
+        list = cons (sc, entry, list) ;
+    }
+
+    return (list) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_TIMELINE ()
+
+    Record a Timeline.
+
+
+Purpose:
+
+    Function func_IOX_TIMELINE() starts or stops recording a timeline of the
+    program's activity in the Chrome trace-event format.
+
+        (iox-timeline <pathname> [<capacity>])
+        (iox-timeline #f)
+
+        Start recording a timeline to JSON file <pathname>; the status, #t
+        or #f, is returned to the caller.  The timeline has a span for each
+        callback (named after the callback's Scheme function), for each call
+        to a foreign function (named after its global variable), and for the
+        time the dispatchers spend waiting between callbacks or, when run in
+        slices, in each pass; garbage collections are marked when detected.
+        The file can be loaded into Perfetto (ui.perfetto.dev) or Chrome's
+        about:tracing viewer.  Events are buffered in memory and written by
+        a background thread; <capacity> is the number of events that can be
+        buffered (default: 65536) before new events are dropped.  Passing #f
+        instead of a pathname stops the recording and returns a list of
+        statistics:
+
+            (<recorded> <dropped> <written>)
+
+        Only one timeline at a time can be recorded.
+
+
+    Invocation:
+
+        result = func_IOX_TIMELINE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the pathname of the timeline file or
+            #f, and the optional capacity.
+        <result>	- O
+            returns true (#t) if recording was started and false (#f) if
+            there was an error; when recording is stopped, the statistics
+            list is returned.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_TIMELINE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    long  capacity ;
+    pointer  argument, pathname, result ;
+    TevStats  stats ;
+
+
+
+/* Get the argument(s). */
+
+    pathname = car (args) ;
+
+/* Stop the recording and return its statistics. */
+
+    if (pathname == sc->F) {
+        if (!tevActive ()) {
+            SET_ERRNO (EINVAL) ;
+            LGE "(func_IOX_TIMELINE) No timeline is being recorded.\n") ;
+            return (sc->F) ;
+        }
+        if (tevStop (&stats)) {
+            LGE "(func_IOX_TIMELINE) Error closing timeline.\ntevStop: ") ;
+            return (sc->F) ;
+        }
+        result = cons (sc, mk_integer (sc, (long) stats.written), sc->NIL) ;
+        result = cons (sc, mk_integer (sc, (long) stats.dropped), result) ;
+        result = cons (sc, mk_integer (sc, (long) stats.recorded), result) ;
+        return (result) ;
+    }
+
+    if (!is_string (pathname)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_TIMELINE) Invalid pathname specification: ") ;
+        return (sc->F) ;
+    }
+
+    capacity = 0 ;
+    args = cdr (args) ;
+    if (args != sc->NIL) {
+        argument = car (args) ;
+        if (isInteger (argument) && (ivalue (argument) > 0)) {
+            capacity = ivalue (argument) ;
+        } else {
+            SET_ERRNO (EINVAL) ;
+            LGE "(func_IOX_TIMELINE) Invalid capacity: ") ;
+            return (sc->F) ;
+        }
+    }
+
+/* Start the recording. */
+
+    if (tevStart (sc, strvalue (pathname), (size_t) capacity)) {
+        LGE "(func_IOX_TIMELINE) Error creating timeline %s.\ntevStart: ",
+            strvalue (pathname)) ;
+        return (sc->F) ;
+    }
+
+    return (sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_TRACE ()
+
+    Record an Event Trace.
+
+
+Purpose:
+
+    Function func_IOX_TRACE() starts or stops recording a trace of the events
+    handled by a dispatcher's callbacks.
+
+        (iox-trace <dispatcher> <pathname>)
+        (iox-trace <dispatcher> #f)
+
+        Start recording the events delivered to <dispatcher>'s callbacks,
+        along with the results of the TCP and LFN I/O functions called by the
+        program, to trace file <pathname>; the status, #t or #f, is returned
+        to the caller.  Passing #f instead of a pathname stops the recording
+        and returns a list of statistics:
+
+            (<events> <results> <seconds>)
+
+        where <events> is the number of callback events recorded, <results>
+        is the number of I/O results recorded, and <seconds> is the time
+        spanned by the recording.  The trace can then be replayed, against
+        the same program, with IOX-REPLAY.
+
+        To replay correctly, the program must set up its callbacks in the
+        same order on the replay as it did for the recording, and the
+        recording should be started before any callbacks are registered.
+        Only one trace at a time can be recorded or replayed.
+
+
+    Invocation:
+
+        result = func_IOX_TRACE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher and the pathname of
+            the trace file or #f.
+        <result>	- O
+            returns true (#t) if recording was started and false (#f) if
+            there was an error; when recording is stopped, the statistics
+            list is returned.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_TRACE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    IoxDispatcher  dispatcher ;
+    pointer  argument, result ;
+    TrcStats  stats ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_TRACE) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+
+/* Stop the recording and return its statistics. */
+
+    if (argument == sc->F) {
+        if (!trcRecording (sc, dispatcher)) {
+            SET_ERRNO (EINVAL) ;
+            LGE "(func_IOX_TRACE) Dispatcher %p is not being traced.\n",
+                (void *) dispatcher) ;
+            return (sc->F) ;
+        }
+        if (trcStop (sc, &stats)) {
+            LGE "(func_IOX_TRACE) Error closing trace.\ntrcStop: ") ;
+            return (sc->F) ;
+        }
+        result = cons (sc, mk_real (sc, stats.recorded), sc->NIL) ;
+        result = cons (sc, mk_integer (sc, (long) stats.results), result) ;
+        result = cons (sc, mk_integer (sc, (long) stats.events), result) ;
+        return (result) ;
+    }
+
+/* Start the recording. */
+
+    if (!is_string (argument)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_TRACE) Invalid pathname specification: ") ;
+        return (sc->F) ;
+    }
+
+    if (trcStart (sc, dispatcher, strvalue (argument), false)) {
+        LGE "(func_IOX_TRACE) Error creating trace %s.\ntrcStart: ",
+            strvalue (argument)) ;
+        return (sc->F) ;
+    }
+
+    return (sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_WATCHDOG ()
+
+    Set the Stall Threshold.
+
+
+Purpose:
+
+    Function func_IOX_WATCHDOG() sets a dispatcher's stall threshold.
+
+        (iox-watchdog <dispatcher> <seconds>)
+
+        Report any callback invoked by <dispatcher> that runs for longer
+        than <seconds> without returning to the dispatcher.  The report is
+        made by a separate watchdog thread while the callback is still
+        running, so a callback stuck in an endless loop or a blocking call
+        is caught in the act.  A line is written to standard error giving
+        how long the dispatcher has been busy, the IOX function with which
+        the callback was registered, the name of the callback function, and,
+        if the interpreter is executing one, the name of the foreign (C)
+        function.  (The interpreter's foreign functions are wrapped so as to
+        note their names; functions defined afterwards are not named.)  A
+        threshold of zero disables the watchdog, which is the default.  The status of setting the threshold, #t or #f, is returned
+        to the caller; #f is returned on platforms without threads.
+
+
+    Invocation:
+
+        status = func_IOX_WATCHDOG (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher and the threshold
+            in seconds.
+        <status>	- O
+            returns true (#t) if the threshold was set successfully
+            and false (#f) otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_WATCHDOG (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    double  threshold ;
+    IoxDispatcher  dispatcher ;
+    pointer  argument ;
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_WATCHDOG) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    if (isInteger (argument)) {
+        threshold = (double) ivalue (argument) ;
+    } else if (isReal (argument)) {
+        threshold = rvalue (argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_WATCHDOG) Invalid threshold specification: ") ;
+        return (sc->F) ;
+    }
+
+/* Set the threshold and have the interpreter's foreign functions note their
+   names for the watchdog. */
+
+    if (soxSetWatchdog (dispatcher, threshold))  return (sc->F) ;
+
+    if ((threshold > 0.0) && tevNameForeign (sc, true)) {
+        LGE "(func_IOX_WATCHDOG) Error wrapping foreign functions.\ntevNameForeign: ") ;
+    }
+
+    return (sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_IOX_WHENIDLE ()
+
+    Register an Idle Task.
+
+
+Purpose:
+
+    Function func_IOX_WHENIDLE() registers an idle task with an I/O event
+    dispatcher.
+
+        (iox-whenidle <dispatcher> <function> <userData>)
+
+        Register an idle task with dispatcher.  An opaque handle for the
+        registered callback is returned to the caller and can be used to
+        cancel the callback with IOX-CANCEL.  When the dispatcher is idle
+        (i.e., no I/O or timers immediately pending), <function> is called
+        with 3 arguments: the callback handle, the application-supplied
+        <userData>, and the reason (IOX_IDLE) the callback is being invoked.
+        After <function> completes, <dispatcher> re-queues the idle task for
+        later processing.  The application is responsible for explicitly
+        canceling the callback using IOX-CANCEL.
+
+
+    Invocation:
+
+        callback = func_IOX_WHENIDLE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the dispatcher, a function to be called
+            when the dispatcher is idle, and a user-supplied value to pass to
+            the callback function.  The user-supplied value can be an arbitrary
+            Scheme value, so you can use CONS or LIST to pass multiple values
+            to the callback.
+        <callback>	- O
+            returns a callback handle if the callback was successfully
+            registered and #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_IOX_WHENIDLE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    IoxDispatcher  dispatcher ;
+    pointer  argument, function, userData ;
+    SoxCallback  *sox ;
+
+
+
+
+/* Get the argument(s). */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueDispatcher)) {
+        dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_IOX_WHENIDLE) Invalid dispatcher specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    function = argument ;
+
+    args = cdr (args) ;
+    argument = car (args) ;
+    userData = argument ;
+
+/* Allocate a structure to hold the Scheme callback function and the user
+   parameter; a pointer to this structure will be passed to funcIOXCB()
+   when it is invoked for a callback. */
+
+    sox = (SoxCallback *) malloc (sizeof (SoxCallback)) ;
+    if (sox == NULL) {
+        LGE "(func_IOX_WHENIDLE) Error allocating SoxCallback structure.\nmalloc: ") ;
+        return (sc->F) ;
+    }
+
+    sox->callback = NULL ;
+    sox->timer = NULL ;
+    sox->signal = NULL ;
+    sox->process = NULL ;
+    sox->native = NULL ;
+    sox->pinned = false ;
+    sox->dispatcher = dispatcher ;
+    sox->sc = sc ;
+    sox->group = NULL ;
+    sox->nextPending = NULL ;
+    sox->pendingReason = 0 ;
+
+/* Register the idle task with the dispatcher.  When the dispatcher is idle,
+   it will call funcIOXCB(), which, in turn, will call the Scheme function in
+   the SoxCallback structure. */
+
+    if (!trcReplaying (sc, dispatcher)) {
+        sox->callback = ioxWhenIdle (dispatcher, funcIOXCB, sox) ;
+        if (sox->callback == NULL) {
+            LGE "(func_IOX_WHENIDLE) Error registering callback.\nioxWhenIdle: ") ;
+            PUSH_ERRNO ;  free (sox) ;  POP_ERRNO ;
+            return (sc->F) ;
+        }
+    }
+
+/* Save the function object and the user-supplied data so that they remain
+   visible to the garbage collector and are, thus, not garbage collected. */
+
+    sox->functionID = gc_protect (sc, function) ;
+    sox->userDataID = gc_protect (sc, userData) ;
+
+    funcSoxLink (sox, "iox-whenidle") ;
+
+/* Return the callback to the caller. */
+
+    return (mk_opaque (sc, (opaque) sox, OpaqueCallback)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcGroupCB ()
+
+    Record an Event for a Member of an I/O Group.
+
+
+Purpose:
+
+    Function funcGroupCB() is the IOX handler function assigned to the
+    members of I/O groups.  When an event is detected on a member, the
+    event is added to the member's pending events and, if the member had
+    no events pending, the member is appended to the group's pending list.
+    The group is then queued for delivery by funcGroupFlush() at the start
+    of the dispatcher's next iteration.
+
+    When a member is canceled, it is removed from the group's pending list
+    and its SoxCallback structure is deallocated.  When the last member of
+    a group is canceled, the group itself is deallocated.
+
+
+    Invocation:
+
+        status = funcGroupCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the member's IOX callback.
+        <reason>	- I
+            is the reason (e.g., IoxRead, IoxCancel) the callback is being
+            invoked.
+        <userData>	- I
+            is the address of the member's SoxCallback structure.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcGroupCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    SoxCallback  *prev, *sox = (SoxCallback *) userData ;
+    SoxGroup  *group = sox->group ;
+
+
+
+/* If the member is being cancelled, drop any pending events, deallocate
+   the SoxCallback structure, and, if this was the group's last member,
+   deallocate the group. */
+
+    if (reason == IoxCancel) {
+
+        if (sox->pendingReason != 0) {
+            if (group->pending == sox) {
+                group->pending = sox->nextPending ;
+                prev = NULL ;
+            } else {
+                for (prev = group->pending ;  prev->nextPending != sox ;
+                     prev = prev->nextPending)
+                    ;
+                prev->nextPending = sox->nextPending ;
+            }
+            if (group->lastPending == sox)  group->lastPending = prev ;
+        }
+
+        funcSoxFree (sox) ;
+
+	/* If the group is in the middle of a call, funcGroupFlush()
+	   deallocates it afterwards. */
+        if ((--group->numMembers == 0) && (group->busy == 0))
+            funcGroupFree (group) ;
+
+        return (0) ;
+
+    }
+
+/* If a slice's budget has been spent, leave the event for the next slice;
+   the source is still ready. */
+
+    if (soxSliceDone (group->dispatcher))  return (0) ;
+
+    if (trcRecording (sox->sc, sox->dispatcher))
+        trcEvent (sox->sc, sox->traceID, reason, NULL) ;
+
+/* Otherwise, record the event and queue the group for delivery. */
+
+    if (sox->pendingReason == 0) {
+        sox->nextPending = NULL ;
+        if (group->lastPending == NULL)
+            group->pending = sox ;
+        else
+            group->lastPending->nextPending = sox ;
+        group->lastPending = sox ;
+    }
+    sox->pendingReason |= reason ;
+
+    return (soxDefer (group->dispatcher, &group->flush)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcGroupFlush ()
+
+    Deliver an I/O Group's Pending Events.
+
+
+Purpose:
+
+    Function funcGroupFlush() is the deferred function that delivers the
+    events recorded for an I/O group's members.  The group's Scheme function
+    is called once with a list of (<callback> <reason> <userData>) records,
+    one for each member with pending events.
+
+
+    Invocation:
+
+        status = funcGroupFlush (userData) ;
+
+    where:
+
+        <userData>	- I
+            is the address of the SoxGroup structure.
+        <status>	- O
+            returns the status of delivering the events, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcGroupFlush (
+
+#    if PROTOTYPES
+        void  *userData)
+#    else
+        userData)
+
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    double  elapsed ;
+    pointer  function, record, records, tail ;
+    scheme  *sc ;
+    SoxActivity  activity ;
+    SoxCallback  *sox ;
+    SoxGroup  *group = (SoxGroup *) userData ;
+
+
+
+    sc = group->sc ;
+    function = gc_retrieve (sc, group->functionID) ;
+
+/* Build the list of records, emptying the pending list as we go.  Since the
+   pending list is emptied before the Scheme function is called, the function
+   can freely cancel members or register new ones. */
+
+    records = tail = sc->NIL ;
+
+    while ((sox = group->pending) != NULL) {
+        group->pending = sox->nextPending ;
+				/* (<callback> <reason> <userData>) */
+        record = cons (sc, gc_retrieve (sc, sox->userDataID), sc->NIL) ;
+        record = cons (sc, mk_integer (sc, (long) sox->pendingReason), record) ;
+        record = cons (sc, mk_opaque (sc, (void *) sox, OpaqueCallback),
+                       record) ;
+        record = cons (sc, record, sc->NIL) ;
+        if (tail == sc->NIL)
+            records = record ;
+        else
+            set_cdr (tail, record) ;
+        tail = record ;
+        sox->nextPending = NULL ;
+        sox->pendingReason = 0 ;
+    }
+    group->lastPending = NULL ;
+
+    if (records == sc->NIL)  return (0) ;
+
+/* Call the group's Scheme function with the list of records.  If the last
+   member of the group is canceled during the call, deallocate the group
+   afterwards. */
+
+    activity.kind = "iox-onio-group" ;
+    activity.name = ((soxWatchdog (group->dispatcher) > 0.0) ||
+                      (soxProfiling (group->dispatcher) > 0) ||
+                      tevActive ())
+                    ? funcName (sc, function) : NULL ;
+    activity.sc = sc ;
+
+    group->busy++ ;
+    soxEnter (group->dispatcher, &activity) ;
+
+    scheme_call (sc, function, cons (sc, records, sc->NIL)) ;
+
+    soxLeave (group->dispatcher, &activity) ;
+    elapsed = tvFloat (tvSubtract (tvTOD (), activity.start)) ;
+    group->busy-- ;
+
+    if (gc_detect (sc, elapsed))  opaque_collect (sc) ;
+
+    funcStats (&group->stats, elapsed, sc, group->dispatcher,
+               "iox-onio-group", function) ;
+
+    if ((group->numMembers == 0) && (group->busy == 0))
+        funcGroupFree (group) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcGroupFree ()
+
+    Deallocate an I/O Group.
+
+
+Purpose:
+
+    Function funcGroupFree() removes an I/O group with no members from the
+    list of groups and deallocates it.
+
+
+    Invocation:
+
+        funcGroupFree (group) ;
+
+    where:
+
+        <group>		- I
+            is the group to be deallocated.
+
+*******************************************************************************/
+
+
+static  void  funcGroupFree (
+
+#    if PROTOTYPES
+        SoxGroup  *group)
+#    else
+        group)
+
+        SoxGroup  *group ;
+#    endif
+
+{    /* Local variables. */
+    SoxGroup  *prev ;
+
+
+
+    soxUndefer (group->dispatcher, &group->flush) ;
+
+    if (groupList == group) {
+        groupList = group->next ;
+    } else {
+        for (prev = groupList ;  prev->next != group ;  prev = prev->next)
+            ;
+        prev->next = group->next ;
+    }
+
+    gc_unprotect (group->sc, group->functionID) ;
+    free (group) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcIdleGCCB ()
+
+    Run an Idle-Time Garbage Collection.
+
+
+Purpose:
+
+    Function funcIdleGCCB() is the IOX handler function assigned to idle
+    tasks registered with IOX-IDLE-GC.  When the dispatcher is idle, the
+    function has gc_idle() run a collection if the heap is full enough.
+    A collection is recorded in the task's statistics, and any objects
+    whose handles were collected are finalized.  If the task is being
+    canceled, the SoxCallback structure is deallocated.
+
+
+    Invocation:
+
+        status = funcIdleGCCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle assigned to the idle task by the dispatcher.
+        <reason>	- I
+            is the reason (IoxIdle or IoxCancel) the function is being
+            invoked.
+        <userData>	- I
+            is the address of the SoxCallback structure created when the
+            idle task was registered.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcIdleGCCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    double  pause ;
+    pointer  policy ;
+    SoxCallback  *sox = (SoxCallback *) userData ;
+
+
+
+    if (reason == IoxCancel)  return (funcSoxCall (sox, IoxCancel, NULL)) ;
+
+    policy = gc_retrieve (sox->sc, sox->userDataID) ;
+
+    if (gc_idle (sox->sc, rvalue (car (policy)), rvalue (cdr (policy)),
+                 &pause)) {
+        funcStats (&sox->stats, pause, sox->sc, sox->dispatcher,
+                   sox->kind, NULL) ;
+        opaque_collect (sox->sc) ;
+    }
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcIOXCB ()
+
+    Handle an I/O Event Dispatcher Callback.
+
+
+Purpose:
+
+    Function funcIOXCB() is a generic IOX handler function assigned to IOX
+    callbacks when a to-be-monitored event is registered using an IOX function.
+    At the time the event was registered, a SoxCallback structure was created
+    containing a Scheme function to be executed when the callback is invoked
+    and the user data to be passed to the function.
+
+    When the callback is invoked by the I/O event dispatcher, funcIOXCB()
+    has funcSoxCall() call the Scheme function, passing it the callback
+    handle, the callback reason, and the user data.
+    I/O events arriving after the budget of a slice (see IOX-MONITOR) has
+    been spent are ignored; the source remains ready.
+
+
+    Invocation:
+
+        status = funcIOXCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle assigned to the callback by one of the IOX
+            registration functions.
+        <reason>	- I
+            is the reason (e.g., IoxRead, IoxFire) the callback is being
+            invoked.
+        <userData>	- I
+            is the address of the SoxCallback structure created when the
+            callback was registered with the dispatcher.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.  The status value is ignored by the
+            IOX dispatcher, but it may be useful if the application calls
+            funcIOXCB() directly.
+
+*******************************************************************************/
+
+
+static  errno_t  funcIOXCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        dispatcher, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    SoxCallback  *sox = (SoxCallback *) userData ;
+
+
+
+/* If a slice's budget has been spent, leave an I/O event for the next
+   slice; the source is still ready. */
+
+    if ((reason & (IoxRead | IoxWrite | IoxExcept)) &&
+        soxSliceDone (sox->dispatcher))
+        return (0) ;
+
+    return (funcSoxCall (sox, reason, NULL)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcName ()
+
+    Look Up the Name of a Callback Function.
+
+
+Purpose:
+
+    Function funcName() returns the name of the global variable bound to
+    a callback function.  Names are cached by function, so the global
+    environment is only searched the first time a function is looked up.
+    (A name cached for a function that is later garbage-collected could
+    be reported for a new function allocated in the same cell; since the
+    name is only used in diagnostics, this is tolerated.)
+
+
+    Invocation:
+
+        name = funcName (sc, function) ;
+
+    where:
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <function>	- I
+            is the callback function.
+        <name>		- O
+            returns the name of the function; NULL is returned if the
+            function is not bound to a global variable.
+
+*******************************************************************************/
+
+
+static  const  char  *funcName (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  function)
+#    else
+        sc, function)
+
+        scheme  *sc ;
+        pointer  function ;
+#    endif
+
+{    /* Local variables. */
+    size_t  slot ;
+
+
+
+    slot = (size_t) (((unsigned long) function) >> 4) % SOX_NAME_CACHE ;
+
+    if ((nameCache[slot].sc != sc) || (nameCache[slot].function != function)) {
+        nameCache[slot].sc = sc ;
+        nameCache[slot].function = function ;
+        nameCache[slot].name = global_name (sc, function) ;
+    }
+
+    return (nameCache[slot].name) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcNativeCB ()
+
+    Handle the Stopping of a Native Handler.
+
+
+Purpose:
+
+    Function funcNativeCB() is the NTV_UTIL close function assigned to
+    handlers attached with IOX-ATTACH-NATIVE.  The event is passed on to
+    funcSoxCall(), along with the error number as the Scheme function's
+    extra argument.  If no Scheme function was given, the handler's
+    endpoints are destroyed instead.  Either way, the handler is done with
+    the endpoints, so they are unpinned (see funcNativePin()) first.
+
+
+    Invocation:
+
+        status = funcNativeCB (handler, reason, error, userData) ;
+
+    where:
+
+        <handler>	- I
+            is the handle of the native handler.
+        <reason>	- I
+            is the reason (NTV_CLOSE or IoxCancel) the function is being
+            invoked.
+        <error>		- I
+            is the error, for NTV_CLOSE, that stopped the handler.
+        <userData>	- I
+            is the address of the SoxCallback structure created when the
+            handler was attached.
+        <status>	- O
+            returns the status of handling the event, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcNativeCB (
+
+#    if PROTOTYPES
+        NtvHandler  handler,
+        IoxReason  reason,
+        errno_t  error,
+        void  *userData)
+#    else
+        handler, reason, error, userData)
+
+        NtvHandler  handler ;
+        IoxReason  reason ;
+        errno_t  error ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    SoxCallback  *sox = (SoxCallback *) userData ;
+    TcpEndpoint  sink, source ;
+
+
+
+    funcNativePin (sox, false) ;
+
+    if (reason == IoxCancel) {
+        sox->native = NULL ;
+        return (funcSoxCall (sox, IoxCancel, NULL)) ;
+    }
+
+    if (sox->functionID == 0) {
+        source = ntvSource (handler) ;
+        sink = ntvSink (handler) ;
+        opaque_release (sox->sc, (opaque) source) ;
+        tcpDestroy (source) ;
+        if ((sink != NULL) && (sink != source)) {
+            opaque_release (sox->sc, (opaque) sink) ;
+            tcpDestroy (sink) ;
+        }
+        return (0) ;
+    }
+
+    return (funcSoxCall (sox, reason, mk_integer (sox->sc, (long) error))) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcNativePin ()
+
+    Pin/Unpin a Native Handler's Endpoints.
+
+
+Purpose:
+
+    Function funcNativePin() pins or unpins the endpoints of a native handler
+    attached with IOX-ATTACH-NATIVE.  While the handler runs, it uses the
+    endpoints even if the program has dropped its handles for them, so they
+    are pinned to keep them from being finalized (see "opaque.c").  Pinning
+    or unpinning twice in a row has no effect.
+
+
+    Invocation:
+
+        funcNativePin (sox, pin) ;
+
+    where:
+
+        <sox>		- I
+            is the address of the SoxCallback structure created when the
+            handler was attached.
+        <pin>		- I
+            pins (true) or unpins (false) the endpoints.
+
+*******************************************************************************/
+
+
+static  void  funcNativePin (
+
+#    if PROTOTYPES
+        SoxCallback  *sox,
+        bool  pin)
+#    else
+        sox, pin)
+
+        SoxCallback  *sox ;
+        bool  pin ;
+#    endif
+
+{    /* Local variables. */
+    TcpEndpoint  sink, source ;
+
+
+
+    if ((sox->native == NULL) || (sox->pinned == pin))  return ;
+
+    source = ntvSource (sox->native) ;
+    sink = ntvSink (sox->native) ;
+
+    opaque_pin (sox->sc, (opaque) source, pin) ;
+    if ((sink != NULL) && (sink != source))
+        opaque_pin (sox->sc, (opaque) sink, pin) ;
+
+    sox->pinned = pin ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcPostCB ()
+
+    Call a Posted Scheme Function.
+
+
+Purpose:
+
+    Function funcPostCB() is the SOX_UTIL post function for calls posted
+    with IOX-POST.  It calls the Scheme function with the user-supplied
+    argument and then releases the posted call.  The call is timed and
+    watched like any other callback, but, having no callback handle, it
+    doesn't show up in IOX-STATS.
+
+
+    Invocation:
+
+        status = funcPostCB (reason, userData) ;
+
+    where:
+
+        <reason>	- I
+            is the reason (IoxFire or IoxCancel) the function is being
+            invoked.
+        <userData>	- I
+            is the address of the SoxPosted structure.
+        <status>	- O
+            returns the status of making the call, zero if there were no
+            errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcPostCB (
+
+#    if PROTOTYPES
+        IoxReason  reason,
+        void  *userData)
+#    else
+        reason, userData)
+
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    double  elapsed ;
+    pointer  function ;
+    scheme  *sc ;
+    SoxActivity  activity ;
+    SoxPosted  *posted = (SoxPosted *) userData ;
+    SoxStats  stats ;
+
+
+
+    sc = posted->sc ;
+
+    if (reason != IoxCancel) {
+
+        function = gc_retrieve (sc, posted->functionID) ;
+
+        activity.kind = "iox-post" ;
+        activity.name = ((soxWatchdog (posted->dispatcher) > 0.0) ||
+                          (soxProfiling (posted->dispatcher) > 0) ||
+                          tevActive ())
+                        ? funcName (sc, function) : NULL ;
+        activity.sc = sc ;
+
+        soxEnter (posted->dispatcher, &activity) ;
+        scheme_call (sc, function,
+                     cons (sc, gc_retrieve (sc, posted->userDataID), sc->NIL)) ;
+        soxLeave (posted->dispatcher, &activity) ;
+        elapsed = tvFloat (tvSubtract (tvTOD (), activity.start)) ;
+        if (gc_detect (sc, elapsed))  opaque_collect (sc) ;
+
+        memset (&stats, 0, sizeof stats) ;
+        funcStats (&stats, elapsed, sc, posted->dispatcher,
+                   "iox-post", function) ;
+
+    }
+
+    gc_unprotect (sc, posted->functionID) ;
+    gc_unprotect (sc, posted->userDataID) ;
+    free (posted) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcSignalCB ()
+
+    Handle a Signal.
+
+
+Purpose:
+
+    Function funcSignalCB() is the SOX_UTIL signal handler function assigned
+    to signals watched with IOX-ONSIGNAL.  Like funcTWLCB(), it simply passes
+    the event on to funcIOXCB().
+
+
+    Invocation:
+
+        status = funcSignalCB (watcher, reason, userData) ;
+
+    where:
+
+        <watcher>	- I
+            is the handle of the signal watcher.
+        <reason>	- I
+            is the reason (SOX_SIGNAL or IoxCancel) the handler is being
+            invoked.
+        <userData>	- I
+            is the address of the SoxCallback structure created when the
+            signal watcher was registered.
+        <status>	- O
+            returns the status of handling the signal, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcSignalCB (
+
+#    if PROTOTYPES
+        SoxSignal  watcher,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        watcher, reason, userData)
+
+        SoxSignal  watcher ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{
+
+    return (funcIOXCB (NULL, reason, userData)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcSoxCall ()
+
+    Call the Scheme Function Bound to a Callback.
+
+
+Purpose:
+
+    Function funcSoxCall() calls the Scheme function bound to a callback,
+    passing it the callback handle, the callback reason, the user data, and,
+    optionally, an extra argument that depends on the reason.  The call is
+    timed and bracketed for the stall watchdog.  If the reason is IoxCancel,
+    the SoxCallback structure is deallocated instead.
+
+
+    Invocation:
+
+        status = funcSoxCall (sox, reason, extra) ;
+
+    where:
+
+        <sox>		- I
+            is the address of the SoxCallback structure created when the
+            callback was registered with the dispatcher.
+        <reason>	- I
+            is the reason (e.g., IoxRead, IoxFire) the callback is being
+            invoked.
+        <extra>		- I
+            is an extra argument to pass to the Scheme function after the
+            user data; NULL if none.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcSoxCall (
+
+#    if PROTOTYPES
+        SoxCallback  *sox,
+        IoxReason  reason,
+        pointer  extra)
+#    else
+        sox, reason, extra)
+
+        SoxCallback  *sox ;
+        IoxReason  reason ;
+        pointer  extra ;
+#    endif
+
+{    /* Local variables. */
+    double  elapsed ;
+    pointer  args, function, userSupplied ;
+    SoxActivity  activity ;
+
+
+
+/* If the callback is being cancelled, then deallocate the SoxCallback
+   structure - unless the callback was canceled from within its own Scheme
+   function, in which case the structure is deallocated when the function
+   returns. */
+
+    if (reason == IoxCancel) {
+        if (sox->busy > 0)
+            sox->dead = true ;
+        else
+            funcSoxFree (sox) ;
+        return (0) ;
+    }
+
+/* Record the event if a trace is being recorded.  Cancellations are not
+   recorded; they are made by the program itself or follow from recorded
+   events (see IOX-REPLAY). */
+
+    if (trcRecording (sox->sc, sox->dispatcher))
+        trcEvent (sox->sc, sox->traceID, reason, extra) ;
+
+/* Otherwise, call the Scheme function bound to the callback, passing it the
+   callback handle, the callback reason, and the user-supplied argument(s). */
+
+    function = gc_retrieve (sox->sc, sox->functionID) ;
+    userSupplied = gc_retrieve (sox->sc, sox->userDataID) ;
+
+				/* Extra argument, if any. */
+    args = (extra == NULL) ? sox->sc->NIL : cons (sox->sc, extra, sox->sc->NIL) ;
+				/* One or more user-supplied parameters. */
+    args = cons (sox->sc, userSupplied, args) ;
+				/* Reason for callback. */
+    args = cons (sox->sc, mk_integer (sox->sc, (long) reason), args) ;
+				/* Callback handle. */
+    args = cons (sox->sc,
+                 mk_opaque (sox->sc, (void *) sox, OpaqueCallback), args) ;
+
+    activity.kind = sox->kind ;
+    activity.name = ((soxWatchdog (sox->dispatcher) > 0.0) ||
+                      (soxProfiling (sox->dispatcher) > 0) ||
+                      tevActive ())
+                    ? funcName (sox->sc, function) : NULL ;
+    activity.sc = sox->sc ;
+
+    sox->busy++ ;
+    soxEnter (sox->dispatcher, &activity) ;
+
+    scheme_call (sox->sc, function, args) ;
+
+    soxLeave (sox->dispatcher, &activity) ;
+    elapsed = tvFloat (tvSubtract (tvTOD (), activity.start)) ;
+    sox->busy-- ;
+
+/* If the garbage collector ran during the call, count the collection (see
+   GC_UTIL) and finalize the objects whose handles it reclaimed. */
+
+    if (gc_detect (sox->sc, elapsed))  opaque_collect (sox->sc) ;
+
+    funcStats (&sox->stats, elapsed, sox->sc, sox->dispatcher,
+               sox->kind, function) ;
+
+    if (sox->dead && (sox->busy == 0))  funcSoxFree (sox) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcSoxFind ()
+
+    Find a Callback Registered During a Replay.
+
+
+Purpose:
+
+    Function funcSoxFind() looks up a callback, registered with a dispatcher
+    during a replay, by its serial number.
+
+
+    Invocation:
+
+        sox = funcSoxFind (dispatcher, id) ;
+
+    where:
+
+        <dispatcher>	- I
+            is the dispatcher with which the callback was registered.
+        <id>		- I
+            is the callback's serial number.
+        <sox>		- O
+            returns the callback's SoxCallback structure; NULL is returned
+            if the callback was not found.
+
+*******************************************************************************/
+
+
+static  SoxCallback  *funcSoxFind (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        unsigned  long  id)
+#    else
+        dispatcher, id)
+
+        IoxDispatcher  dispatcher ;
+        unsigned  long  id ;
+#    endif
+
+{    /* Local variables. */
+    SoxCallback  *sox ;
+
+
+
+    for (sox = traceIndex[id % SOX_TRACE_BUCKETS] ;  sox != NULL ;
+         sox = sox->nextTraced) {
+        if ((sox->traceID == id) && (sox->dispatcher == dispatcher))  break ;
+    }
+
+    return (sox) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcSoxFree ()
+
+    Deallocate a SoxCallback Structure.
+
+
+Purpose:
+
+    Function funcSoxFree() removes a SoxCallback structure from the list of
+    callbacks, releases its protected Scheme values, and deallocates it.
+
+
+    Invocation:
+
+        funcSoxFree (sox) ;
+
+    where:
+
+        <sox>		- I
+            is the structure to be deallocated.
+
+*******************************************************************************/
+
+
+static  void  funcSoxFree (
+
+#    if PROTOTYPES
+        SoxCallback  *sox)
+#    else
+        sox)
+
+        SoxCallback  *sox ;
+#    endif
+
+{    /* Local variables. */
+    SoxCallback  **link ;
+
+
+
+    if (sox->prev == NULL)
+        soxList = sox->next ;
+    else
+        sox->prev->next = sox->next ;
+    if (sox->next != NULL)  sox->next->prev = sox->prev ;
+
+    if (sox->traced) {
+        link = &traceIndex[sox->traceID % SOX_TRACE_BUCKETS] ;
+        while (*link != sox)  link = &(*link)->nextTraced ;
+        *link = sox->nextTraced ;
+    }
+
+    if (sox->functionID != 0)  gc_unprotect (sox->sc, sox->functionID) ;
+    gc_unprotect (sox->sc, sox->userDataID) ;
+    opaque_release (sox->sc, (opaque) sox) ;
+
+    sox->callback = NULL ;
+    sox->timer = NULL ;
+    sox->signal = NULL ;
+    sox->process = NULL ;
+    sox->native = NULL ;
+    sox->sc = NULL ;
+    free (sox) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcSoxLink ()
+
+    Add a SoxCallback Structure to the List of Callbacks.
+
+
+Purpose:
+
+    Function funcSoxLink() initializes the bookkeeping fields of a newly
+    registered SoxCallback structure, numbers it for event traces, and adds
+    the structure to the list of callbacks scanned by IOX-STATS.
+
+
+    Invocation:
+
+        funcSoxLink (sox, kind) ;
+
+    where:
+
+        <sox>		- I
+            is the structure.
+        <kind>		- I
+            is the name of the registering IOX function; e.g., "iox-onio".
+            The string must be static.
+
+*******************************************************************************/
+
+
+static  void  funcSoxLink (
+
+#    if PROTOTYPES
+        SoxCallback  *sox,
+        const  char  *kind)
+#    else
+        sox, kind)
+
+        SoxCallback  *sox ;
+        char  *kind ;
+#    endif
+
+{
+
+    sox->kind = kind ;
+    sox->busy = 0 ;
+    sox->dead = false ;
+    memset (&sox->stats, 0, sizeof (SoxStats)) ;
+
+/* Number the callback for event traces.  Callbacks registered during a
+   replay are indexed for the replay's lookups. */
+
+    sox->traceID = soxSerial (sox->dispatcher) ;
+    sox->traced = trcReplaying (sox->sc, sox->dispatcher) ;
+    if (sox->traced) {
+        sox->nextTraced = traceIndex[sox->traceID % SOX_TRACE_BUCKETS] ;
+        traceIndex[sox->traceID % SOX_TRACE_BUCKETS] = sox ;
+    } else {
+        sox->nextTraced = NULL ;
+    }
+
+    sox->prev = NULL ;
+    sox->next = soxList ;
+    if (soxList != NULL)  soxList->prev = sox ;
+    soxList = sox ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcSpawnCB ()
+
+    Handle a Spawned Process Event.
+
+
+Purpose:
+
+    Function funcSpawnCB() is the SPX_UTIL process handler function assigned
+    to processes spawned with IOX-SPAWN.  The event is passed on to
+    funcSoxCall(), along with the output string (for SPX_STDOUT and
+    SPX_STDERR) or the exit code (for SPX_EXIT) as the Scheme function's
+    extra argument.
+
+
+    Invocation:
+
+        status = funcSpawnCB (process, reason, data, length, userData) ;
+
+    where:
+
+        <process>	- I
+            is the handle of the process.
+        <reason>	- I
+            is the reason (SPX_STDOUT, SPX_STDERR, SPX_EXIT, or IoxCancel)
+            the handler is being invoked.
+        <data>		- I
+            is the output, for SPX_STDOUT and SPX_STDERR.
+        <length>	- I
+            is the length of the output.
+        <userData>	- I
+            is the address of the SoxCallback structure created when the
+            process was spawned.
+        <status>	- O
+            returns the status of handling the event, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcSpawnCB (
+
+#    if PROTOTYPES
+        SpxProcess  process,
+        IoxReason  reason,
+        const  char  *data,
+        size_t  length,
+        void  *userData)
+#    else
+        process, reason, data, length, userData)
+
+        SpxProcess  process ;
+        IoxReason  reason ;
+        char  *data ;
+        size_t  length ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    int  code ;
+    pointer  extra ;
+    SoxCallback  *sox = (SoxCallback *) userData ;
+
+
+
+    if ((reason == SPX_STDOUT) || (reason == SPX_STDERR)) {
+        extra = mk_counted_string (sox->sc, data, (int) length) ;
+    } else if (reason == SPX_EXIT) {
+        code = spxExitCode (process) ;
+        extra = (code == INT_MIN) ? sox->sc->F
+                                  : mk_integer (sox->sc, (long) code) ;
+    } else {
+        extra = NULL ;
+    }
+
+    return (funcSoxCall (sox, reason, extra)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcStats ()
+
+    Record the Timing of a Scheme Call.
+
+
+Purpose:
+
+    Function funcStats() adds the time taken by a call to a Scheme callback
+    function to the callback's statistics and, if the dispatcher has a
+    slow-callback threshold and the call exceeded it, logs the call to
+    standard error.
+
+
+    Invocation:
+
+        funcStats (stats, elapsed, sc, dispatcher, kind, function) ;
+
+    where:
+
+        <stats>		- I/O
+            is the callback's statistics.
+        <elapsed>	- I
+            is the time in seconds taken by the call.
+        <sc>		- I
+            is the Scheme interpreter.
+        <dispatcher>	- I
+            is the dispatcher that invoked the callback.
+        <kind>		- I
+            is the name of the registering IOX function.
+        <function>	- I
+            is the Scheme function that was called.
+
+*******************************************************************************/
+
+
+static  void  funcStats (
+
+#    if PROTOTYPES
+        SoxStats  *stats,
+        double  elapsed,
+        scheme  *sc,
+        IoxDispatcher  dispatcher,
+        const  char  *kind,
+        pointer  function)
+#    else
+        stats, elapsed, sc, dispatcher, kind, function)
+
+        SoxStats  *stats ;
+        double  elapsed ;
+        scheme  *sc ;
+        IoxDispatcher  dispatcher ;
+        char  *kind ;
+        pointer  function ;
+#    endif
+
+{    /* Local variables. */
+    double  bound, threshold ;
+    int  i ;
+    const  char  *name ;
+
+
+
+    stats->count++ ;
+    stats->total += elapsed ;
+    if (elapsed > stats->max)  stats->max = elapsed ;
+
+    for (i = 0, bound = 0.00001 ;
+         (i < (SOX_BUCKETS - 1)) && (elapsed >= bound) ;
+         i++, bound *= 10.0)
+        ;
+    stats->histogram[i]++ ;
+
+/* Log the call if it was slow. */
+
+    threshold = soxSlow (dispatcher) ;
+    if ((threshold <= 0.0) || (elapsed < threshold))  return ;
+
+    name = funcName (sc, function) ;
+    fprintf (stderr, "(iox) Slow callback: %.3f ms in %s function %s.\n",
+             elapsed * 1000.0, kind, (name == NULL) ? "<anonymous>" : name) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcStatsList ()
+
+    Format a Callback's Statistics as a Scheme List.
+
+
+Purpose:
+
+    Function funcStatsList() constructs an IOX-STATS entry for a callback.
+
+
+    Invocation:
+
+        entry = funcStatsList (sc, handle, kind, function, stats) ;
+
+    where:
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <handle>	- I
+            is the callback's handle (or #f).
+        <kind>		- I
+            is the name of the registering IOX function.
+        <function>	- I
+            is the callback's Scheme function.
+        <stats>		- I
+            is the callback's statistics.
+        <entry>		- O
+            returns the list (<callback> <kind> <name> <count> <total> <max>
+            <histogram>).
+
+*******************************************************************************/
+
+
+static  pointer  funcStatsList (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  handle,
+        const  char  *kind,
+        pointer  function,
+        SoxStats  *stats)
+#    else
+        sc, handle, kind, function, stats)
+
+        scheme  *sc ;
+        pointer  handle ;
+        char  *kind ;
+        pointer  function ;
+        SoxStats  *stats ;
+#    endif
+
+{    /* Local variables. */
+    int  i ;
+    const  char  *name ;
+    pointer  entry, histogram ;
+
+
+
+    histogram = sc->NIL ;
+    for (i = SOX_BUCKETS ;  i-- > 0 ; )
+        histogram = cons (sc, mk_integer (sc, (long) stats->histogram[i]),
+                          histogram) ;
+
+    name = funcName (sc, function) ;
+
+    entry = cons (sc, histogram, sc->NIL) ;
+    entry = cons (sc, mk_real (sc, stats->max), entry) ;
+    entry = cons (sc, mk_real (sc, stats->total), entry) ;
+    entry = cons (sc, mk_integer (sc, (long) stats->count), entry) ;
+    entry = cons (sc, (name == NULL) ? sc->F : mk_string (sc, name), entry) ;
+    entry = cons (sc, mk_string (sc, kind), entry) ;
+    entry = cons (sc, handle, entry) ;
+
+    return (entry) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcTWLCB ()
+
+    Handle a Timing Wheel Timer.
+
+
+Purpose:
+
+    Function funcTWLCB() is the TWL handler function assigned to timers
+    registered with IOX-AFTER and IOX-EVERY.  The timer handler is simply
+    passed on to funcIOXCB(), which calls the Scheme function bound to the
+    timer or, if the timer is being canceled, deallocates the SoxCallback
+    structure.
+
+
+    Invocation:
+
+        status = funcTWLCB (timer, reason, userData) ;
+
+    where:
+
+        <timer>		- I
+            is the handle of the wheel timer.
+        <reason>	- I
+            is the reason (IoxFire or IoxCancel) the handler is being invoked.
+        <userData>	- I
+            is the address of the SoxCallback structure created when the
+            timer was registered.
+        <status>	- O
+            returns the status of handling the timer, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcTWLCB (
+
+#    if PROTOTYPES
+        TwlTimer  timer,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        timer, reason, userData)
+
+        TwlTimer  timer ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{
+
+    return (funcIOXCB (NULL, reason, userData)) ;
 
 }
@@ -25,14 +25,20 @@ Purpose:
         (lfn-putline <stream> <string>
                      [<crlf> [<timeout>]])	=> <status>   (#t|#f)
         (lfn-read <stream> <length>
-                  [<timeout>])			=> <string>|#f
+                  [<timeout> [<bytevector?>]])	=> <string>|<bytevector>|#f
         (lfn-readable? <stream>)		=> <flag>
         (lfn-up? <stream>)			=> <flag>
-        (lfn-write <stream> <string>
+        (lfn-write <stream> <string>|<bytevector>
                    [<timeout>])			=> <status>   (#t|#f)
         (lfn-writeable? <stream>)		=> <flag>
 
 
+    If a stream's handles are all garbage-collected before LFN-DESTROY is
+    called, the stream (and its endpoint) is destroyed automatically (see
+    "opaque.c"); a program should not count on this to close its connections
+    promptly.
+
+
 Public Procedures:
 
     addFuncsLFN() - registers the functions with the Scheme intepreter.
@@ -51,6 +57,7 @@ Private Procedures:
     func_LFN_UPp() - implements the LFN-UP? function.
     func_LFN_WRITE() - implements the LFN-WRITE function.
     func_LFN_WRITEABLEp() - implements the LFN-WRITEABLE? function.
+    funcLfnFinalize() - destroys a leaked LF-terminated stream.
 
 *******************************************************************************/
 
@@ -63,6 +70,7 @@ Private Procedures:
 #include  "lfn_util.h"			/* LF-terminated network I/O. */
 #include  "str_util.h"			/* String manipulation functions. */
 #include  "tsion.h"			/* TinyScheme I/O Network functions. */
+#include  "trc_util.h"			/* Event trace record/replay. */
 
 
 /*******************************************************************************
@@ -81,6 +89,8 @@ static  pointer  func_LFN_READABLEp P_((scheme *sc, pointer args)) ;
 static  pointer  func_LFN_UPp P_((scheme *sc, pointer args)) ;
 static  pointer  func_LFN_WRITE P_((scheme *sc, pointer args)) ;
 static  pointer  func_LFN_WRITEABLEp P_((scheme *sc, pointer args)) ;
+
+static  errno_t  funcLfnFinalize P_((opaque value)) ;
 
 /*!*****************************************************************************
 
@@ -169,6 +179,8 @@ void  addFuncsLFN (
                    mk_symbol (sc, "lfn-writeable?"),
                    mk_foreign_func (sc, func_LFN_WRITEABLEp)) ;
 
+    opaque_finalizer (sc, OpaqueLfnStream, funcLfnFinalize) ;
+
     return ;
 
 }
@@ -249,8 +261,8 @@ static  pointer  func_LFN_CREATE (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        dataPoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        dataPoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_CREATE) Invalid datapoint specification: ") ;
@@ -265,16 +277,24 @@ static  pointer  func_LFN_CREATE (
         options = strvalue (argument) ;
     }
 
-/* Create the stream. */
+/* Create the stream.  A fake endpoint from a replay gets a fake stream.
+   The stream takes over the endpoint, whose handle is no longer valid. */
+
+    if (trcIsFake ((void *) dataPoint)) {
+        opaque_release (sc, (opaque) dataPoint) ;
+        return (mk_opaque (sc, (opaque) trcMakeFake (), OpaqueLfnStream)) ;
+    }
 
     if (lfnCreate (dataPoint, options, &stream)) {
         LGE "(func_LFN_CREATE) Error creating LF-terminated network stream.\nlfnCreate: ") ;
         return (sc->F) ;
     }
 
+    opaque_release (sc, (opaque) dataPoint) ;
+
 /* Return the stream to the caller. */
 
-    return (mk_opaque (sc, (opaque) stream)) ;
+    return (mk_opaque (sc, (opaque) stream, OpaqueLfnStream)) ;
 
 }
 
@@ -409,15 +429,19 @@ static  pointer  func_LFN_DESTROY (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        stream = (LfnStream) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueLfnStream)) {
+        stream = (LfnStream) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_DESTROY) Argument is not a stream: ") ;
         return (sc->F) ;
     }
 
-/* Close the stream. */
+/* Close the stream, invalidating any remaining handles for it. */
+
+    opaque_release (sc, (opaque) stream) ;
+
+    if (trcIsFake ((void *) stream))  return (sc->T) ;
 
     return (lfnDestroy (stream) ? sc->F : sc->T) ;
 
@@ -480,8 +504,8 @@ static  pointer  func_LFN_FD (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        stream = (LfnStream) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueLfnStream)) {
+        stream = (LfnStream) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_FD) Argument is not a stream: ") ;
@@ -490,6 +514,9 @@ static  pointer  func_LFN_FD (
 
 /* Return the stream's socket to the caller. */
 
+    if (trcIsFake ((void *) stream))
+        return (mk_integer (sc, trcFakeFd ((void *) stream))) ;
+
     return (mk_integer (sc, (long) lfnFd (stream))) ;
 
 }
@@ -569,8 +596,8 @@ static  pointer  func_LFN_GETLINE (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        stream = (LfnStream) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueLfnStream)) {
+        stream = (LfnStream) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_GETLINE) Invalid stream specification: ") ;
@@ -595,17 +622,20 @@ static  pointer  func_LFN_GETLINE (
 
 /* Read the next input line from the network stream. */
 
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcLfnGetLine, NULL)) ;
+
     if (lfnGetLine (stream, timeout, &string)) {
         LGE "(func_LFN_GETLINE) Error reading input line from %s.\nlfnGetLine: ",
             lfnName (stream)) ;
-        return (sc->F) ;
+        return (trcResult (sc, TrcLfnGetLine, sc->F)) ;
     }
 
 /* Return the input line to the caller. */
 
     data = mk_string (sc, (const char *) string) ;
 
-    return (data) ;
+    return (trcResult (sc, TrcLfnGetLine, data)) ;
 
 }
 
@@ -669,8 +699,8 @@ static  pointer  func_LFN_NAME (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        stream = (LfnStream) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueLfnStream)) {
+        stream = (LfnStream) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_NAME) Argument is not a stream: ") ;
@@ -679,6 +709,8 @@ static  pointer  func_LFN_NAME (
 
 /* Return the stream's name to the caller. */
 
+    if (trcIsFake ((void *) stream))  return (mk_string (sc, "replay")) ;
+
     return (mk_string (sc, lfnName (stream))) ;
 
 }
@@ -772,8 +804,8 @@ static  pointer  func_LFN_PUTLINE (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        stream = (LfnStream) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueLfnStream)) {
+        stream = (LfnStream) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_PUTLINE) Invalid stream specification: ") ;
@@ -820,6 +852,9 @@ static  pointer  func_LFN_PUTLINE (
 
 /* Append the line terminators, if any. */
 
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcLfnPutLine, NULL)) ;
+
     string = strndup (string, length+2) ;
     if (string == NULL) {
         LGE "(func_LFN_PUTLINE) Error duplicating %ld-bye output string.\nstrndup: ",
@@ -836,12 +871,12 @@ static  pointer  func_LFN_PUTLINE (
     if (lfnWrite (stream, timeout, numBytesToWrite, string, &numBytesWritten)) {
         LGE "(func_LFN_PUTLINE) Error writing output line to %s.\nlfnWrite: ",
             lfnName (stream)) ;
-        return (sc->F) ;
+        return (trcResult (sc, TrcLfnPutLine, sc->F)) ;
     }
 
 /* Return a successfull status to the caller. */
 
-    return (sc->T) ;
+    return (trcResult (sc, TrcLfnPutLine, sc->T)) ;
 
 }
 
@@ -859,11 +894,13 @@ Purpose:
     Function func_LFN_READ() reads unformatted data from a LF-terminated
     network stream.
 
-        (lfn-read <stream> <length> [<timeout>])
+        (lfn-read <stream> <length> [<timeout> [<bytevector?>]])
 
         Read <length> bytes of arbitrary data from <stream> into a string
         buffer and return the buffer to the caller.  The data can be arbitrary
-        binary data and can contain embedded NULs.
+        binary data and can contain embedded NULs.  If <bytevector?> is
+        present and true, the data is returned in a bytevector instead
+        (see "funcs_bvr.c"); pass a negative <timeout> to wait indefinitely.
 
         Because of the way network I/O works, a single record written to a
         connection by one task may be read in multiple "chunks" by the task
@@ -898,12 +935,14 @@ Purpose:
             is a list of the arguments: the LF-terminated network stream
             returned by LFN-CREATE, a timeout value representing the number
             of seconds to wait for the desired amount of data to be read,
-            and the number of bytes to read.
+            the number of bytes to read, and, optionally, a flag requesting
+            a bytevector.
         <data>		- O
             returns the input data in a *counted* string; i.e., the number of
             bytes of data in the "string" is stored internally in the Scheme
             cell and is *not* dependent upon being a NUL-terminated string.
-            If an error occurs, #f is returned.
+            The data is returned in a bytevector if requested.  If an error
+            occurs, #f is returned.
 
 *******************************************************************************/
 
@@ -921,6 +960,7 @@ static  pointer  func_LFN_READ (
 #    endif
 
 {    /* Local variables. */
+    bool  binary ;
     char  *buffer ;
     double  timeout ;
     pointer  argument, data ;
@@ -934,8 +974,8 @@ static  pointer  func_LFN_READ (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        stream = (LfnStream) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueLfnStream)) {
+        stream = (LfnStream) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_READ) Invalid stream specification: ") ;
@@ -968,30 +1008,41 @@ static  pointer  func_LFN_READ (
         }
     }
 
+    binary = (args != sc->NIL) && (cdr (args) != sc->NIL) &&
+             !is_false (sc, cadr (args)) ;
+
 /* Read the data from the network stream. */
 
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcLfnRead, NULL)) ;
+
+/* The data is read directly into a Scheme string (or bytevector) allocated
+   for the maximum length, which is then cut down to the number of bytes
+   actually read. */
+
     length = (numBytesToRead < 0) ? -numBytesToRead : numBytesToRead ;
-    buffer = calloc (length, 1) ;
-    if (buffer == NULL) {
-        LGE "(func_LFN_READ) Error allocating %lu-byte buffer.\ncalloc: ",
+    data = binary ? mk_bytevector (sc, NULL, length) : mk_ustring (sc, length) ;
+    if (data == NULL) {
+        LGE "(func_LFN_READ) Error allocating %lu-byte buffer.\n",
             (unsigned long) length) ;
         return (sc->F) ;
     }
+    buffer = binary ? (char *) bytevector_data (data) : strvalue (data) ;
 
     if (lfnRead (stream, timeout, numBytesToRead, buffer, &numBytesRead)) {
         LGE "(func_LFN_READ) Error reading %lu bytes from %s.\nlfnRead: ",
             (unsigned long) length, lfnName (stream)) ;
-        PUSH_ERRNO ;  free (buffer) ;  POP_ERRNO ;
-        return (sc->F) ;
+        return (trcResult (sc, TrcLfnRead, sc->F)) ;
     }
 
-/* Return the input data to the caller as a *counted* string. */
-
-    data = mk_bstring (sc, (const char *) buffer, numBytesRead) ;
+/* Return the input data to the caller as a *counted* string or bytevector. */
 
-    free (buffer) ;
+    if (binary)
+        bytevector_shrink (sc, data, numBytesRead) ;
+    else
+        string_shrink (sc, data, numBytesRead) ;
 
-    return (data) ;
+    return (trcResult (sc, TrcLfnRead, data)) ;
 
 }
 
@@ -1056,8 +1107,8 @@ static  pointer  func_LFN_READABLEp (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        stream = (LfnStream) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueLfnStream)) {
+        stream = (LfnStream) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_READABLEp) Argument is not a stream: ") ;
@@ -1066,7 +1117,11 @@ static  pointer  func_LFN_READABLEp (
 
 /* Check if the stream is readable. */
 
-    return (lfnIsReadable (stream) ? sc->T : sc->F) ;
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcLfnReadable, NULL)) ;
+
+    return (trcResult (sc, TrcLfnReadable,
+                       lfnIsReadable (stream) ? sc->T : sc->F)) ;
 
 }
 
@@ -1127,8 +1182,8 @@ static  pointer  func_LFN_UPp (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        stream = (LfnStream) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueLfnStream)) {
+        stream = (LfnStream) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_UPp) Argument is not a stream: ") ;
@@ -1137,7 +1192,11 @@ static  pointer  func_LFN_UPp (
 
 /* Check if the stream is up. */
 
-    return (lfnIsUp (stream) ? sc->T : sc->F) ;
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcLfnUp, NULL)) ;
+
+    return (trcResult (sc, TrcLfnUp,
+                       lfnIsUp (stream) ? sc->T : sc->F)) ;
 
 }
 
@@ -1155,9 +1214,9 @@ Purpose:
     Function func_LFN_WRITE() writes unformatted data to a LF-terminated
     network stream.
 
-        (lfn-write <stream> <string> [<timeout>])
+        (lfn-write <stream> <string>|<bytevector> [<timeout>])
 
-        Write arbitrary data from <string> to <stream>.
+        Write arbitrary data from <string> or <bytevector> to <stream>.
 
         Because of the way network I/O works, attempting to output a given
         amount of data to a network connection may require multiple network
@@ -1188,9 +1247,10 @@ Purpose:
             is the Scheme interpreter.
         <args>		- I
             is a list of the arguments: the LF-terminated network stream
-            returned by LFN-CREATE, a *counted* string of data to be output,
-            and an optional timeout value representing the number of seconds
-            to wait for the desired amount of data to be written.
+            returned by LFN-CREATE, a *counted* string or a bytevector of
+            data to be output, and an optional timeout value representing
+            the number of seconds to wait for the desired amount of data to
+            be written.
         <status>	- O
             returns true (#t) if the data was successfully written and
             false (#f) otherwise.
@@ -1223,8 +1283,8 @@ static  pointer  func_LFN_WRITE (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        stream = (LfnStream) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueLfnStream)) {
+        stream = (LfnStream) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_WRITE) Invalid stream specification: ") ;
@@ -1236,6 +1296,9 @@ static  pointer  func_LFN_WRITE (
     if (is_string (argument)) {
         buffer = strvalue (argument) ;
         numBytesToWrite = (size_t) strlength (argument) ;
+    } else if (is_bytevector (argument)) {
+        buffer = (char *) bytevector_data (argument) ;
+        numBytesToWrite = bytevector_length (argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_WRITE) Invalid data specification: ") ;
@@ -1260,13 +1323,16 @@ static  pointer  func_LFN_WRITE (
 
 /* Write the data to the network connection. */
 
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcLfnWrite, NULL)) ;
+
     if (lfnWrite (stream, timeout, numBytesToWrite, buffer, &numBytesWritten)) {
         LGE "(func_LFN_WRITE) Error writing %lu bytes to %s.\nlfnWrite: ",
             (unsigned long) numBytesToWrite, lfnName (stream)) ;
-        return (sc->F) ;
+        return (trcResult (sc, TrcLfnWrite, sc->F)) ;
     }
 
-    return (sc->T) ;
+    return (trcResult (sc, TrcLfnWrite, sc->T)) ;
 
 }
 
@@ -1327,8 +1393,8 @@ static  pointer  func_LFN_WRITEABLEp (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        stream = (LfnStream) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueLfnStream)) {
+        stream = (LfnStream) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_LFN_WRITEABLEp) Argument is not a stream: ") ;
@@ -1337,6 +1403,64 @@ static  pointer  func_LFN_WRITEABLEp (
 
 /* Check if the stream is writeable. */
 
-    return (lfnIsWriteable (stream) ? sc->T : sc->F) ;
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcLfnWriteable, NULL)) ;
+
+    return (trcResult (sc, TrcLfnWriteable,
+                       lfnIsWriteable (stream) ? sc->T : sc->F)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcLfnFinalize ()
+
+    Destroy a Leaked LF-Terminated Stream.
+
+
+Purpose:
+
+    Function funcLfnFinalize() is registered with the OPAQUE package as the
+    finalizer for LF-terminated streams.  It destroys a stream, closing the
+    stream's endpoint, when the stream's handles were all garbage-collected
+    before LFN-DESTROY was called.  Fake streams made during a replay are
+    ignored.
+
+
+    Invocation:
+
+        status = funcLfnFinalize (value) ;
+
+    where
+
+        <value>		- I
+            is the LF-terminated stream, as an opaque value.
+        <status>	- O
+            returns the status of destroying the stream, zero if there were no
+            errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcLfnFinalize (
+
+#    if PROTOTYPES
+        opaque  value)
+#    else
+        value)
+
+        opaque  value ;
+#    endif
+
+{    /* Local variables. */
+    LfnStream  stream = (LfnStream) value ;
+
+
+
+    if (trcIsFake (value))  return (0) ;
+
+    return (lfnDestroy (stream) ? errno : 0) ;
 
 }
@@ -16,8 +16,14 @@ Purpose:
     The FUNCS_MISC package defines a miscellaneous collection of unrelated
     functions:
 
+        (finalize-handles)	=> <count>   (# of leaked objects finalized)
+        (gc-pauses)		=> <list>    (Collection counts and pauses)
+        (gc-stats)		=> <alist>   (Heap size and collection totals)
         (getenv "<name>")	=> <string>  (Environment variable's value)
         (grab <value>)		=> <value>   (Scheme value)
+        (heap-profile)		=> <list>    (Census of cells by type)
+        (log-leaked-handles <flag>)
+        			=> <flag>    (Previous setting)
         (tv-tod)		=> <pair>    (Time of day in secs and usecs)
 
 
@@ -27,8 +33,14 @@ Public Procedures:
 
 Private Procedures:
 
+    func_MISC_FINALIZE_HANDLES() - implements the FINALIZE-HANDLES function.
+    func_MISC_GC_PAUSES() - implements the GC-PAUSES function.
+    func_MISC_GC_STATS() - implements the GC-STATS function.
     func_MISC_GETENV() - implements the GETENV function.
     func_MISC_GRAB() - implements the GRAB function.
+    func_MISC_HEAP_PROFILE() - implements the HEAP-PROFILE function.
+    func_MISC_LOG_LEAKED_HANDLES() - implements the LOG-LEAKED-HANDLES
+        function.
     func_MISC_TV_TOD() - implements the TV-TOD function.
 
 *******************************************************************************/
@@ -40,6 +52,7 @@ Private Procedures:
 #include  <stdlib.h>			/* Standard C Library definitions. */
 #include  "tv_util.h"			/* "timeval" manipulation functions. */
 #include  "tsion.h"			/* TinyScheme I/O Network functions. */
+#include  "gc_util.h"			/* Garbage collection utilities. */
 #include  "plist_util.h"		/* TinyScheme property lists. */
 
 
@@ -47,8 +60,13 @@ Private Procedures:
     Private functions.
 *******************************************************************************/
 
+static  pointer  func_MISC_FINALIZE_HANDLES P_((scheme *sc, pointer args)) ;
+static  pointer  func_MISC_GC_PAUSES P_((scheme *sc, pointer args)) ;
+static  pointer  func_MISC_GC_STATS P_((scheme *sc, pointer args)) ;
 static  pointer  func_MISC_GETENV P_((scheme *sc, pointer args)) ;
 static  pointer  func_MISC_GRAB P_((scheme *sc, pointer args)) ;
+static  pointer  func_MISC_HEAP_PROFILE P_((scheme *sc, pointer args)) ;
+static  pointer  func_MISC_LOG_LEAKED_HANDLES P_((scheme *sc, pointer args)) ;
 static  pointer  func_MISC_TV_TOD P_((scheme *sc, pointer args)) ;
 
 /*!*****************************************************************************
@@ -90,6 +108,18 @@ void  addFuncsMISC (
 
 {
 
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "finalize-handles"),
+                   mk_foreign_func (sc, func_MISC_FINALIZE_HANDLES)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "gc-pauses"),
+                   mk_foreign_func (sc, func_MISC_GC_PAUSES)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "gc-stats"),
+                   mk_foreign_func (sc, func_MISC_GC_STATS)) ;
+
     scheme_define (sc, sc->global_env,
                    mk_symbol (sc, "getenv"),
                    mk_foreign_func (sc, func_MISC_GETENV)) ;
@@ -98,6 +128,14 @@ void  addFuncsMISC (
                    mk_symbol (sc, "grab"),
                    mk_foreign_func (sc, func_MISC_GRAB)) ;
 
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "heap-profile"),
+                   mk_foreign_func (sc, func_MISC_HEAP_PROFILE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "log-leaked-handles"),
+                   mk_foreign_func (sc, func_MISC_LOG_LEAKED_HANDLES)) ;
+
     scheme_define (sc, sc->global_env,
                    mk_symbol (sc, "tv-tod"),
                    mk_foreign_func (sc, func_MISC_TV_TOD)) ;
@@ -108,6 +146,248 @@ void  addFuncsMISC (
 
 /*!*****************************************************************************
 
+Procedure:
+
+    func_MISC_FINALIZE_HANDLES ()
+
+    Finalize the Objects Whose Handles Were Garbage-Collected.
+
+
+Purpose:
+
+    Function func_MISC_FINALIZE_HANDLES() finalizes the TCP endpoints,
+    LF-terminated streams, compiled patterns, and directory scans whose
+    handles have all been reclaimed by the garbage collector without the
+    objects having been destroyed.
+
+        (finalize-handles)
+
+        Destroy each leaked object (see "opaque.c") and return the number
+        of objects destroyed.  An object's handles are only reclaimed when
+        the garbage collector runs, so a program that wants its leaks
+        cleaned up right away should call (gc) first.  The dispatcher calls
+        this function automatically after any callback during which the
+        garbage collector ran.
+
+
+    Invocation:
+
+        count = func_MISC_FINALIZE_HANDLES (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments to the function, which are ignored.
+        <count>		- O
+            returns the number of objects finalized.
+
+*******************************************************************************/
+
+
+static  pointer  func_MISC_FINALIZE_HANDLES (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return (mk_integer (sc, opaque_collect (sc))) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_MISC_GC_PAUSES ()
+
+    Get Garbage Collection Counts and Pause Times.
+
+
+Purpose:
+
+    Function func_MISC_GC_PAUSES() returns the number of garbage collections
+    run and the time spent in them, for tuning the idle-time collector (see
+    IOX-IDLE-GC).
+
+        (gc-pauses)
+
+        Return a list of two entries, one for the collections run by the
+        idle-time collector and one for all other collections (those
+        triggered by the heap running out and explicit calls to GC):
+
+            ((requested <count> <seconds> <max>)
+             (other <count> <seconds> <max>))
+
+        where <seconds> is the total time spent in the collections and <max>
+        is the longest single pause.  The other collections can't be timed
+        directly; they are noticed after each dispatcher callback and their
+        pauses are bounded by the length of the callback during which they
+        ran, so their times are upper bounds.  Collections run outside of a
+        callback are counted with no time.
+
+
+    Invocation:
+
+        list = func_MISC_GC_PAUSES (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments to the function, which are ignored.
+        <list>		- O
+            returns the list of statistics described above.
+
+*******************************************************************************/
+
+
+static  pointer  func_MISC_GC_PAUSES (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    GcPauses  other, requested ;
+    pointer  list ;
+
+
+
+    gc_detect (sc, 0.0) ;		/* Count any collection not yet seen. */
+    gc_pauses (sc, &requested, &other) ;
+
+    list = cons (sc, mk_real (sc, other.max), sc->NIL) ;
+    list = cons (sc, mk_real (sc, other.total), list) ;
+    list = cons (sc, mk_integer (sc, other.count), list) ;
+    list = cons (sc, mk_symbol (sc, "other"), list) ;
+    list = cons (sc, list, sc->NIL) ;
+
+    args = cons (sc, mk_real (sc, requested.max), sc->NIL) ;
+    args = cons (sc, mk_real (sc, requested.total), args) ;
+    args = cons (sc, mk_integer (sc, requested.count), args) ;
+    args = cons (sc, mk_symbol (sc, "requested"), args) ;
+
+    return (cons (sc, args, list)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_MISC_GC_STATS ()
+
+    Get Heap Statistics.
+
+
+Purpose:
+
+    Function func_MISC_GC_STATS() returns the size and occupancy of the
+    interpreter's cell heap and the collector's totals, for watching the
+    memory use of a long-lived session.
+
+        (gc-stats)
+
+        Return an association list:
+
+            ((cells . <total>)
+             (used . <count>)
+             (free . <count>)
+             (segments . <count>)
+             (max-segments . <count>)
+             (collections . <count>)
+             (gc-seconds . <seconds>))
+
+        where <total> is the number of cells in the heap, "used" counts the
+        live cells plus any garbage not yet collected, "free" counts the
+        cells on the free list, "segments" is the number of cell segments
+        allocated out of a maximum of "max-segments", and "collections" and
+        "gc-seconds" are the number of collections run and the total time
+        spent in them (see GC-PAUSES for the breakdown).  Call (gc) first
+        if "used" should count only live cells.
+
+
+    Invocation:
+
+        alist = func_MISC_GC_STATS (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments to the function, which are ignored.
+        <alist>		- O
+            returns the association list of statistics described above.
+
+*******************************************************************************/
+
+
+static  pointer  func_MISC_GC_STATS (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    GcStats  stats ;
+    pointer  alist ;
+
+
+
+    gc_stats (sc, &stats) ;
+
+    alist = cons (sc, cons (sc, mk_symbol (sc, "gc-seconds"),
+                            mk_real (sc, stats.gcTime)),
+                  sc->NIL) ;
+    alist = cons (sc, cons (sc, mk_symbol (sc, "collections"),
+                            mk_integer (sc, stats.collections)),
+                  alist) ;
+    alist = cons (sc, cons (sc, mk_symbol (sc, "max-segments"),
+                            mk_integer (sc, stats.maxSegments)),
+                  alist) ;
+    alist = cons (sc, cons (sc, mk_symbol (sc, "segments"),
+                            mk_integer (sc, stats.segments)),
+                  alist) ;
+    alist = cons (sc, cons (sc, mk_symbol (sc, "free"),
+                            mk_integer (sc, stats.freeCells)),
+                  alist) ;
+    alist = cons (sc, cons (sc, mk_symbol (sc, "used"),
+                            mk_integer (sc, stats.usedCells)),
+                  alist) ;
+    alist = cons (sc, cons (sc, mk_symbol (sc, "cells"),
+                            mk_integer (sc, stats.cells)),
+                  alist) ;
+
+    return (alist) ;
+
+}
+
+/*!*****************************************************************************
+
 Procedure:
 
     func_MISC_GETENV ()
@@ -208,6 +488,11 @@ Purpose:
         (1) Call scheme_load_string() with a "(grab ...)" command.
         (2) Retrieve the list of arguments using the TS(sc,grabValue) macro.
 
+    New code should instead use eval_expression(), apply_function(), or
+    call_function() (see "scm_util.c"), which evaluate an expression or call
+    a procedure without formatting and parsing a command string and return
+    the result directly, along with an error status.
+
         (grab <value>)
 
         This function stores a pointer to value internally for use by C code.
@@ -254,6 +539,165 @@ static  pointer  func_MISC_GRAB (
 
 /*!*****************************************************************************
 
+Procedure:
+
+    func_MISC_HEAP_PROFILE ()
+
+    Count the Cells in the Heap by Type.
+
+
+Purpose:
+
+    Function func_MISC_HEAP_PROFILE() takes a census of the interpreter's
+    cell heap, counting the occupied cells by type, to show which types
+    of objects dominate the heap.
+
+        (heap-profile)
+
+        Return a list with one entry for each type of cell found in the
+        heap, in a fixed order:
+
+            ((string <count> <bytes>)
+             (number <count>)
+             (symbol <count>)
+             (pair <count>)
+             (closure <count>)
+             (vector <count> <cells>)
+             (opaque <count>)
+             (bytevector <count>)
+             ...)
+
+        The string entry also gives the total bytes of string storage and
+        the vector entry also gives the number of extra cells holding the
+        vectors' elements; a bytevector's bytes are held in a string cell
+        and are counted with the strings.  Types with no cells are omitted.
+        The census counts every occupied cell, including garbage not yet
+        collected, so call (gc) first to count only the live cells.
+
+
+    Invocation:
+
+        list = func_MISC_HEAP_PROFILE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments to the function, which are ignored.
+        <list>		- O
+            returns the census described above.
+
+*******************************************************************************/
+
+
+static  pointer  func_MISC_HEAP_PROFILE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    GcCensus  census ;
+    int  kind ;
+    pointer  entry, list ;
+
+
+
+    gc_census (sc, &census) ;
+
+/* Build the list backwards, so the types end up in order. */
+
+    list = sc->NIL ;
+
+    for (kind = GC_NUM_TYPES - 1 ;  kind >= 0 ;  kind--) {
+        if (census.count[kind] == 0)  continue ;
+        entry = sc->NIL ;
+        if (kind == T_STRING)
+            entry = cons (sc, mk_integer (sc, (long) census.stringBytes),
+                          entry) ;
+        else if (kind == T_VECTOR)
+            entry = cons (sc, mk_integer (sc, census.vectorCells), entry) ;
+        entry = cons (sc, mk_integer (sc, census.count[kind]), entry) ;
+        entry = cons (sc, mk_symbol (sc, gc_type_name (kind)), entry) ;
+        list = cons (sc, entry, list) ;
+    }
+
+    return (list) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_MISC_LOG_LEAKED_HANDLES ()
+
+    Enable/Disable the Logging of Leaked Objects.
+
+
+Purpose:
+
+    Function func_MISC_LOG_LEAKED_HANDLES() enables or disables the logging
+    of the objects that are finalized because the program dropped their
+    handles without destroying them.
+
+        (log-leaked-handles <flag>)
+
+        If <flag> is true, each leaked object is reported on stderr when it
+        is finalized; if <flag> is #f, leaked objects are finalized quietly,
+        which is the default.  The previous setting is returned.
+
+
+    Invocation:
+
+        previous = func_MISC_LOG_LEAKED_HANDLES (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments to the function: the flag.
+        <previous>	- O
+            returns the previous setting, #t or #f.
+
+*******************************************************************************/
+
+
+static  pointer  func_MISC_LOG_LEAKED_HANDLES (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    bool  flag ;
+
+
+
+/* Get the argument(s). */
+
+    flag = (args != sc->NIL) && (car (args) != sc->F) ;
+
+    return (opaque_log_leaks (sc, flag) ? sc->T : sc->F) ;
+
+}
+
+/*!*****************************************************************************
+
 Procedure:
 
     func_MISC_TV_TOD ()
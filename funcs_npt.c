@@ -0,0 +1,1408 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    funcs_npt.c
+
+    Network Port Functions.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The FUNCS_NPT package defines Scheme ports whose data comes from or goes
+    to a network connection, either a TCP endpoint (see FUNCS_TCP) or an
+    LF-terminated stream (see FUNCS_LFN).  The standard input and output
+    functions - READ, READ-CHAR, PEEK-CHAR, WRITE, DISPLAY, WRITE-CHAR, etc.
+    - can then be applied directly to a connection, without wrapping its
+    socket in a FILE * stream with fdopen(3) or building strings for
+    TCP-WRITE a piece at a time:
+
+        (define in (npt-open-input endpoint))
+        (define out (npt-open-output endpoint))
+        ...
+        (npt-fill in 5.0)			; Wait up to 5 seconds for input.
+        (let ((request (read in)))
+            (write (eval request) out)
+            (newline out)
+            (npt-flush out dispatcher))		; Write in the background.
+        ...
+        (npt-close in)
+        (npt-close out)
+
+    The "scheme.c" core has no hook for adding a new kind of port, so a
+    network port is a TinyScheme string port whose buffer is managed by this
+    package rather than by the interpreter:
+
+        Input - NPT-FILL reads whatever data is available from the network
+            directly into the free space at the end of the buffer, after
+            discarding the characters already consumed; the buffer is
+            doubled if it is full.  The interpreter's readers simply see
+            a longer string.
+
+        Output - the interpreter's writers append characters to the buffer
+            (which the interpreter grows, if necessary, as it does for
+            OPEN-OUTPUT-STRING ports).  NPT-FLUSH hands the buffer itself
+            to tcpWrite() or lfnWrite() - nothing is copied - and shifts
+            any unwritten data to the front.  Given a timeout, NPT-FLUSH
+            writes synchronously; given a dispatcher, it writes what the
+            connection will take without waiting and registers a write
+            callback with the dispatcher that keeps writing as the
+            connection drains, canceling itself when the buffer is empty.
+
+    Buffers are 64 KB by default; a different size can be specified when
+    the port is opened.  Some things to be aware of:
+
+        - The interpreter treats a NUL character in an input buffer as end
+          of input, so network ports are for text.  Use TCP-READ, TCP-WRITE,
+          and bytevectors for binary data.
+
+        - The characters of a datum must all be in the buffer before READ
+          is called; an end of input in the middle of a datum is an error,
+          not a wait for more data.  Line- or length-delimited protocols
+          should check that a complete request has arrived.
+
+        - A network port must be closed with NPT-CLOSE, which frees its
+          buffer and releases its endpoint or stream.  Any output not yet
+          flushed is discarded.  An open network port is never garbage
+          collected.  The endpoint or stream must not be destroyed while
+          ports are open on it.
+
+    Network port I/O is not recorded or replayed by the event tracer (see
+    "trc_util.c").
+
+        (npt-buffered <port>)			=> <count>
+        (npt-close <port>)			=> <status>   (#t|#f)
+        (npt-fill <port> [<timeout>])		=> <count>|#f
+        (npt-flush <port> [<timeout>|<dp>])	=> <count>|#f
+        (npt-open-input <endpoint>|<stream>
+                        [<size>])		=> <port>|#f
+        (npt-open-output <endpoint>|<stream>
+                         [<size>])		=> <port>|#f
+        (npt-port? <object>)			=> <flag>
+
+
+Public Procedures:
+
+    addFuncsNPT() - registers the functions with the Scheme intepreter.
+    releaseFuncsNPT() - closes an interpreter's network ports.
+
+Private Procedures:
+
+    func_NPT_BUFFERED() - implements the NPT-BUFFERED function.
+    func_NPT_CLOSE() - implements the NPT-CLOSE function.
+    func_NPT_FILL() - implements the NPT-FILL function.
+    func_NPT_FLUSH() - implements the NPT-FLUSH function.
+    func_NPT_OPEN_INPUT() - implements the NPT-OPEN-INPUT function.
+    func_NPT_OPEN_OUTPUT() - implements the NPT-OPEN-OUTPUT function.
+    func_NPT_PORTp() - implements the NPT-PORT? function.
+    nptClose() - closes a network port.
+    nptFind() - finds the network port record for a Scheme port.
+    nptOpen() - opens a network port.
+    nptWrite() - writes a network port's buffered output.
+    nptWriteCB() - is an IOX callback that writes buffered output as the
+        connection becomes writeable.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <string.h>			/* C Library string functions. */
+#include  "iox_util.h"			/* I/O event dispatcher definitions. */
+#include  "lfn_util.h"			/* LF-terminated network I/O. */
+#include  "tcp_util.h"			/* TCP/IP network utilities. */
+#include  "tsion.h"			/* TinyScheme I/O Network functions. */
+#include  "gc_util.h"			/* Garbage collection utilities. */
+#include  "sox_util.h"			/* Scheme dispatcher utilities. */
+
+
+#ifndef NPT_BUFSIZ
+#    define  NPT_BUFSIZ  65536		/* Default buffer size. */
+#endif
+
+
+/*******************************************************************************
+    NptPort - is the C side of an open network port.  The Scheme port is kept
+        protected from the garbage collector until the port is closed.  The
+        port's buffer pointers are always fetched from the port structure,
+        since the interpreter may reallocate an output buffer.
+*******************************************************************************/
+
+typedef  struct  NptPort {
+    struct  NptPort  *next ;	/* Link in list of open ports. */
+    scheme  *sc ;		/* Scheme interpreter. */
+    port  *pyort ;		/* Scheme port structure. */
+    UniqueID  portID ;		/* Protected ID of Scheme port cell. */
+    TcpEndpoint  endpoint ;	/* Network connection ... */
+    LfnStream  stream ;		/* ... or LF-terminated stream. */
+    size_t  size ;		/* Capacity of input buffer. */
+    IoxDispatcher  dispatcher ;	/* Dispatcher for background output. */
+    IoxCallback  callback ;	/* Write callback, if output pending. */
+    errno_t  error ;		/* Error in background output. */
+}  NptPort ;
+
+static  NptPort  *portList = NULL ;
+
+/* Closed ports are left pointing to an empty buffer. */
+
+static  char  emptyBuffer[1] = "" ;
+
+
+/*******************************************************************************
+    Private functions.
+*******************************************************************************/
+
+static  pointer  func_NPT_BUFFERED P_((scheme *sc, pointer args)) ;
+static  pointer  func_NPT_CLOSE P_((scheme *sc, pointer args)) ;
+static  pointer  func_NPT_FILL P_((scheme *sc, pointer args)) ;
+static  pointer  func_NPT_FLUSH P_((scheme *sc, pointer args)) ;
+static  pointer  func_NPT_OPEN_INPUT P_((scheme *sc, pointer args)) ;
+static  pointer  func_NPT_OPEN_OUTPUT P_((scheme *sc, pointer args)) ;
+static  pointer  func_NPT_PORTp P_((scheme *sc, pointer args)) ;
+
+static  void  nptClose P_((NptPort *record)) ;
+
+static  NptPort  *nptFind P_((scheme *sc,
+                              pointer cell)) ;
+
+static  pointer  nptOpen P_((scheme *sc,
+                             pointer args,
+                             bool output)) ;
+
+static  errno_t  nptWrite P_((NptPort *record,
+                              double timeout)) ;
+
+static  errno_t  nptWriteCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+/*!*****************************************************************************
+
+Procedure:
+
+    addFuncsNPT ()
+
+    Register the Network Port Functions with the Scheme Interpreter.
+
+
+Purpose:
+
+    Function addFuncsNPT() registers the network port functions as foreign
+    functions with the Scheme interpreter.
+
+
+    Invocation:
+
+        addFuncsNPT (sc) ;
+
+    where
+
+        <sc>	- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+void  addFuncsNPT (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "npt-buffered"),
+                   mk_foreign_func (sc, func_NPT_BUFFERED)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "npt-close"),
+                   mk_foreign_func (sc, func_NPT_CLOSE)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "npt-fill"),
+                   mk_foreign_func (sc, func_NPT_FILL)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "npt-flush"),
+                   mk_foreign_func (sc, func_NPT_FLUSH)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "npt-open-input"),
+                   mk_foreign_func (sc, func_NPT_OPEN_INPUT)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "npt-open-output"),
+                   mk_foreign_func (sc, func_NPT_OPEN_OUTPUT)) ;
+
+    scheme_define (sc, sc->global_env,
+                   mk_symbol (sc, "npt-port?"),
+                   mk_foreign_func (sc, func_NPT_PORTp)) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    releaseFuncsNPT ()
+
+    Close an Interpreter's Network Ports.
+
+
+Purpose:
+
+    Function releaseFuncsNPT() closes the network ports still open in an
+    interpreter, as if by NPT-CLOSE; any output not yet flushed is
+    discarded.  A background write would otherwise be left registered
+    with its dispatcher, pointing to a port freed by the interpreter.
+    The function is called by tsion_release() before the interpreter
+    is destroyed.
+
+
+    Invocation:
+
+        releaseFuncsNPT (sc) ;
+
+    where
+
+        <sc>	- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+void  releaseFuncsNPT (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{    /* Local variables. */
+    NptPort  *next, *record ;
+
+
+
+    for (record = portList ;  record != NULL ;  record = next) {
+        next = record->next ;
+        if (record->sc == sc)  nptClose (record) ;
+    }
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_NPT_BUFFERED ()
+
+    Get the Amount of Data Buffered in a Network Port.
+
+
+Purpose:
+
+    Function func_NPT_BUFFERED() returns the number of characters in a
+    network port's buffer: for an input port, the characters received but
+    not yet read; for an output port, the characters written but not yet
+    sent.
+
+        (npt-buffered <port>)
+
+        Return the number of characters buffered in <port>.
+
+
+    Invocation:
+
+        result = func_NPT_BUFFERED (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the port.
+        <result>	- O
+            returns the number of characters buffered, or #f if the
+            argument is not an open network port.
+
+*******************************************************************************/
+
+
+static  pointer  func_NPT_BUFFERED (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    NptPort  *record ;
+    port  *pyort ;
+
+
+
+/* Get the argument. */
+
+    record = nptFind (sc, car (args)) ;
+    if (record == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_NPT_BUFFERED) Not a network port: ") ;
+        return (sc->F) ;
+    }
+
+/* Return the amount of data in the buffer. */
+
+    pyort = record->pyort ;
+
+    if (pyort->kind & port_input)
+        return (mk_integer (sc, (long) (pyort->rep.string.past_the_end -
+                                        pyort->rep.string.curr))) ;
+    else
+        return (mk_integer (sc, (long) (pyort->rep.string.curr -
+                                        pyort->rep.string.start))) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_NPT_CLOSE ()
+
+    Close a Network Port.
+
+
+Purpose:
+
+    Function func_NPT_CLOSE() closes a network port.  Any output still in
+    the port's buffer is discarded and any background write is canceled;
+    call NPT-FLUSH with a timeout first if the output must be delivered.
+    The port's buffer is freed and the port is left closed; its endpoint or
+    stream is *not* closed.
+
+        (npt-close <port>)
+
+        Close network port <port>.
+
+
+    Invocation:
+
+        status = func_NPT_CLOSE (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the port.
+        <status>	- O
+            returns true (#t) if the port was closed and false (#f) if the
+            argument is not an open network port.
+
+*******************************************************************************/
+
+
+static  pointer  func_NPT_CLOSE (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    NptPort  *record ;
+
+
+
+/* Get the argument. */
+
+    record = nptFind (sc, car (args)) ;
+    if (record == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_NPT_CLOSE) Not a network port: ") ;
+        return (sc->F) ;
+    }
+
+    nptClose (record) ;
+
+    return (sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_NPT_FILL ()
+
+    Read Network Input into an Input Port.
+
+
+Purpose:
+
+    Function func_NPT_FILL() reads the data available from a network port's
+    connection into the port's buffer, waiting up to a timeout for data to
+    arrive.  Characters already read from the port are discarded to make
+    room and, if the buffer is full of unread characters, the buffer is
+    doubled in size.
+
+        (npt-fill <port> [<timeout>])
+
+        Read the data available from <port>'s connection into the port's
+        buffer.  If no data is available, wait up to <timeout> seconds for
+        some to arrive; if <timeout> is not specified or is negative, wait
+        as long as it takes.
+
+
+    Invocation:
+
+        result = func_NPT_FILL (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the port and an optional timeout.
+        <result>	- O
+            returns the number of characters read or #f if there was an
+            error (e.g., a timeout or a broken connection).
+
+*******************************************************************************/
+
+
+static  pointer  func_NPT_FILL (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    char  *buffer ;
+    double  timeout ;
+    errno_t  status ;
+    NptPort  *record ;
+    pointer  argument ;
+    port  *pyort ;
+    size_t  numBytesRead, space, unread ;
+
+
+
+/* Get the arguments. */
+
+    record = nptFind (sc, car (args)) ;
+    if ((record == NULL) || !(record->pyort->kind & port_input)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_NPT_FILL) Not a network input port: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    if (args == sc->NIL) {
+        timeout = -1.0 ;
+    } else {
+        argument = car (args) ;
+        if (isInteger (argument)) {
+            timeout = (double) ivalue (argument) ;
+        } else if (isReal (argument)) {
+            timeout = rvalue (argument) ;
+        } else {
+            SET_ERRNO (EINVAL) ;
+            LGE "(func_NPT_FILL) Invalid timeout specification: ") ;
+            return (sc->F) ;
+        }
+    }
+
+/* Shift the unread characters to the front of the buffer. */
+
+    pyort = record->pyort ;
+    unread = pyort->rep.string.past_the_end - pyort->rep.string.curr ;
+    if (pyort->rep.string.curr > pyort->rep.string.start) {
+        memmove (pyort->rep.string.start, pyort->rep.string.curr, unread) ;
+        pyort->rep.string.curr = pyort->rep.string.start ;
+        pyort->rep.string.past_the_end = pyort->rep.string.start + unread ;
+    }
+
+/* If the buffer is full, double its size. */
+
+    if (unread >= record->size) {
+        buffer = (char *) sc->malloc (record->size * 2 + 1) ;
+        if (buffer == NULL) {
+            LGE "(func_NPT_FILL) Error expanding buffer to %lu bytes.\nmalloc: ",
+                (unsigned long) record->size * 2) ;
+            return (sc->F) ;
+        }
+        memcpy (buffer, pyort->rep.string.start, unread) ;
+        sc->free (pyort->rep.string.start) ;
+        pyort->rep.string.start = buffer ;
+        pyort->rep.string.curr = buffer ;
+        pyort->rep.string.past_the_end = buffer + unread ;
+        record->size *= 2 ;
+    }
+
+/* Read the available data directly into the free space at the end of the
+   buffer. */
+
+    space = record->size - unread ;
+    numBytesRead = 0 ;
+
+    if (record->stream == NULL)
+        status = tcpRead (record->endpoint, timeout, -((ssize_t) space),
+                          pyort->rep.string.past_the_end, &numBytesRead) ;
+    else
+        status = lfnRead (record->stream, timeout, -((ssize_t) space),
+                          pyort->rep.string.past_the_end, &numBytesRead) ;
+
+    if (numBytesRead > space)  numBytesRead = space ;
+    pyort->rep.string.past_the_end += numBytesRead ;
+    *pyort->rep.string.past_the_end = '\0' ;
+    pyort->kind &= ~port_saw_EOF ;
+
+    if (status) {
+        LGE "(func_NPT_FILL) Error reading from %s.\n%s: ",
+            (record->stream == NULL) ? tcpName (record->endpoint)
+                                     : lfnName (record->stream),
+            (record->stream == NULL) ? "tcpRead" : "lfnRead") ;
+        return (sc->F) ;
+    }
+
+    return (mk_integer (sc, (long) numBytesRead)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_NPT_FLUSH ()
+
+    Write a Network Port's Buffered Output.
+
+
+Purpose:
+
+    Function func_NPT_FLUSH() writes the output buffered in a network port
+    to the port's connection, either synchronously or in the background.
+
+        (npt-flush <port> [<timeout>|<dispatcher>])
+
+        Write the output buffered in <port> to the port's connection.  If
+        a <timeout> is specified, wait up to that many seconds for the
+        output to be written; if neither a timeout nor a dispatcher is
+        specified, wait as long as it takes.  If a <dispatcher> is
+        specified, write as much of the output as the connection will take
+        without waiting and, if some remains, register a write callback
+        with the dispatcher to write the rest as the connection becomes
+        writeable.  The callback cancels itself once the buffer is empty.
+        Output written to the port in the meantime is sent along with it.
+
+
+    Invocation:
+
+        result = func_NPT_FLUSH (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the port and an optional timeout
+            or dispatcher.
+        <result>	- O
+            returns the number of characters still buffered (zero if all
+            of the output has been written) or #f if there was an error,
+            including an error in an earlier background write.
+
+*******************************************************************************/
+
+
+static  pointer  func_NPT_FLUSH (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    double  timeout ;
+    IoFd  fd ;
+    IoxDispatcher  dispatcher ;
+    NptPort  *record ;
+    pointer  argument ;
+    size_t  pending ;
+
+
+
+/* Get the arguments. */
+
+    record = nptFind (sc, car (args)) ;
+    if ((record == NULL) || !(record->pyort->kind & port_output)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(func_NPT_FLUSH) Not a network output port: ") ;
+        return (sc->F) ;
+    }
+
+    dispatcher = NULL ;
+    args = cdr (args) ;
+    if (args == sc->NIL) {
+        timeout = -1.0 ;
+    } else {
+        argument = car (args) ;
+        if (isInteger (argument)) {
+            timeout = (double) ivalue (argument) ;
+        } else if (isReal (argument)) {
+            timeout = rvalue (argument) ;
+        } else if (is_opaque (sc, argument, OpaqueDispatcher)) {
+            dispatcher = (IoxDispatcher) opaque_value (sc, argument) ;
+            timeout = 0.0 ;
+        } else {
+            SET_ERRNO (EINVAL) ;
+            LGE "(func_NPT_FLUSH) Invalid timeout or dispatcher specification: ") ;
+            return (sc->F) ;
+        }
+    }
+
+/* Report any error in a previous background write. */
+
+    if (record->error) {
+        SET_ERRNO (record->error) ;
+        record->error = 0 ;
+        LGE "(func_NPT_FLUSH) Error in background write.\nnptWriteCB: ") ;
+        return (sc->F) ;
+    }
+
+/* Write as much of the buffered output as possible. */
+
+    if (nptWrite (record, timeout)) {
+        LGE "(func_NPT_FLUSH) Error flushing port %p.\nnptWrite: ",
+            (void *) record->pyort) ;
+        PUSH_ERRNO ;
+        if (record->callback != NULL)  ioxCancel (record->callback) ;
+        POP_ERRNO ;
+        return (sc->F) ;
+    }
+
+    pending = record->pyort->rep.string.curr - record->pyort->rep.string.start ;
+
+/* If all of the output was written, background output is no longer needed.
+   Otherwise, if a dispatcher was specified, write the rest in the background. */
+
+    if (pending == 0) {
+        if (record->callback != NULL)  ioxCancel (record->callback) ;
+    } else if ((dispatcher != NULL) &&
+               ((record->callback == NULL) ||
+                (record->dispatcher != dispatcher))) {
+        if (record->callback != NULL)  ioxCancel (record->callback) ;
+        fd = (record->stream == NULL) ? tcpFd (record->endpoint)
+                                      : lfnFd (record->stream) ;
+        record->dispatcher = dispatcher ;
+        record->callback = ioxOnIO (dispatcher, nptWriteCB, record,
+                                    IoxWrite, fd) ;
+        if (record->callback == NULL) {
+            LGE "(func_NPT_FLUSH) Error registering port %p for output.\nioxOnIO: ",
+                (void *) record->pyort) ;
+            return (sc->F) ;
+        }
+    }
+
+    return (mk_integer (sc, (long) pending)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_NPT_OPEN_INPUT ()
+
+    Open a Network Input Port.
+
+
+Purpose:
+
+    Function func_NPT_OPEN_INPUT() opens an input port on a network
+    connection.  The port is initially empty; NPT-FILL reads data from
+    the connection into the port.
+
+        (npt-open-input <endpoint>|<stream> [<size>])
+
+        Open an input port on a TCP <endpoint> or an LF-terminated <stream>
+        with an initial buffer size of <size> bytes (64 KB by default).
+
+
+    Invocation:
+
+        result = func_NPT_OPEN_INPUT (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the endpoint or stream and an
+            optional buffer size.
+        <result>	- O
+            returns the new port or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_NPT_OPEN_INPUT (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return (nptOpen (sc, args, false)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_NPT_OPEN_OUTPUT ()
+
+    Open a Network Output Port.
+
+
+Purpose:
+
+    Function func_NPT_OPEN_OUTPUT() opens an output port on a network
+    connection.  Output written to the port is buffered until NPT-FLUSH
+    is called.
+
+        (npt-open-output <endpoint>|<stream> [<size>])
+
+        Open an output port on a TCP <endpoint> or an LF-terminated <stream>
+        with an initial buffer size of <size> bytes (64 KB by default).  If
+        more output than that is written before the port is flushed, the
+        interpreter grows the buffer.
+
+
+    Invocation:
+
+        result = func_NPT_OPEN_OUTPUT (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the endpoint or stream and an
+            optional buffer size.
+        <result>	- O
+            returns the new port or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  func_NPT_OPEN_OUTPUT (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return (nptOpen (sc, args, true)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    func_NPT_PORTp ()
+
+    Check if an Object is a Network Port.
+
+
+Purpose:
+
+    Function func_NPT_PORTp() checks if a Scheme object is an open network
+    port.
+
+        (npt-port? <object>)
+
+        Return #t if <object> is an open network port and #f otherwise.
+
+
+    Invocation:
+
+        result = func_NPT_PORTp (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the object.
+        <result>	- O
+            returns true (#t) if the object is an open network port and
+            false (#f) otherwise.
+
+*******************************************************************************/
+
+
+static  pointer  func_NPT_PORTp (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{
+
+    return ((nptFind (sc, car (args)) == NULL) ? sc->F : sc->T) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    nptClose ()
+
+    Close a Network Port.
+
+
+Purpose:
+
+    Function nptClose() does the work for NPT-CLOSE.  It cancels any
+    background output, frees the port's buffer, leaves the Scheme port
+    closed and empty, releases the endpoint or stream, and frees the
+    port's record.
+
+
+    Invocation:
+
+        nptClose (record) ;
+
+    where
+
+        <record>	- I
+            is the port's record.
+
+*******************************************************************************/
+
+
+static  void  nptClose (
+
+#    if PROTOTYPES
+        NptPort  *record)
+#    else
+        record)
+
+        NptPort  *record ;
+#    endif
+
+{    /* Local variables. */
+    NptPort  *prev ;
+    port  *pyort ;
+    scheme  *sc = record->sc ;
+
+
+
+/* Cancel any background output; the callback clears its own field. */
+
+    if (record->callback != NULL)  ioxCancel (record->callback) ;
+
+/* Free the buffer and leave the Scheme port closed and empty. */
+
+    pyort = record->pyort ;
+    if (pyort->rep.string.start != emptyBuffer)
+        sc->free (pyort->rep.string.start) ;
+    pyort->kind = port_free ;
+    pyort->rep.string.start = emptyBuffer ;
+    pyort->rep.string.past_the_end = emptyBuffer ;
+    pyort->rep.string.curr = emptyBuffer ;
+
+/* Unlink the record from the list of open ports and release the port
+   and the connection. */
+
+    if (portList == record) {
+        portList = record->next ;
+    } else {
+        for (prev = portList ;  prev->next != record ;  prev = prev->next)
+            ;
+        prev->next = record->next ;
+    }
+
+    if (record->stream == NULL)
+        opaque_pin (sc, (opaque) record->endpoint, false) ;
+    else
+        opaque_pin (sc, (opaque) record->stream, false) ;
+
+    LGI "(nptClose) Closed port %p on %s.\n",
+        (void *) pyort, (record->stream == NULL) ? tcpName (record->endpoint)
+                                                 : lfnName (record->stream)) ;
+
+    gc_unprotect (sc, record->portID) ;
+    free (record) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    nptFind ()
+
+    Find the Network Port Record for a Scheme Port.
+
+
+Purpose:
+
+    Function nptFind() looks up the record for an open network port.
+
+
+    Invocation:
+
+        record = nptFind (sc, cell) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <cell>		- I
+            is a Scheme object, presumably a port.
+        <record>	- O
+            returns the port's record or NULL if the object is not an open
+            network port.
+
+*******************************************************************************/
+
+
+static  NptPort  *nptFind (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  cell)
+#    else
+        sc, cell)
+
+        scheme  *sc ;
+        pointer  cell ;
+#    endif
+
+{    /* Local variables. */
+    NptPort  *record ;
+
+
+
+    if (!is_port (cell))  return (NULL) ;
+
+    for (record = portList ;  record != NULL ;  record = record->next) {
+        if ((record->sc == sc) && (record->pyort == cell->_object._port))
+            break ;
+    }
+
+    return (record) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    nptOpen ()
+
+    Open a Network Port.
+
+
+Purpose:
+
+    Function nptOpen() does the work for NPT-OPEN-INPUT and NPT-OPEN-OUTPUT.
+    It allocates the port's buffer and a string port structure with the
+    interpreter's allocator, so that the interpreter can grow an output
+    buffer and free the port structure when the port is collected.  Output
+    ports are marked as SRFI-6 ports, which the interpreter grows rather
+    than truncating.
+
+
+    Invocation:
+
+        result = nptOpen (sc, args, output) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is a list of the arguments: the endpoint or stream and an
+            optional buffer size.
+        <output>	- I
+            specifies whether to open an output (true) or input (false) port.
+        <result>	- O
+            returns the new port or #f if there was an error.
+
+*******************************************************************************/
+
+
+static  pointer  nptOpen (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args,
+        bool  output)
+#    else
+        sc, args, output)
+
+        scheme  *sc ;
+        pointer  args ;
+        bool  output ;
+#    endif
+
+{    /* Local variables. */
+    char  *buffer ;
+    LfnStream  stream ;
+    NptPort  *record ;
+    pointer  argument, cell ;
+    port  *pyort ;
+    size_t  size ;
+    TcpEndpoint  endpoint ;
+
+
+
+/* Get the arguments. */
+
+    argument = car (args) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        endpoint = (TcpEndpoint) opaque_value (sc, argument) ;
+        stream = NULL ;
+    } else if (is_opaque (sc, argument, OpaqueLfnStream)) {
+        endpoint = NULL ;
+        stream = (LfnStream) opaque_value (sc, argument) ;
+    } else {
+        SET_ERRNO (EINVAL) ;
+        LGE "(nptOpen) Invalid endpoint or stream specification: ") ;
+        return (sc->F) ;
+    }
+
+    args = cdr (args) ;
+    if (args == sc->NIL) {
+        size = NPT_BUFSIZ ;
+    } else {
+        argument = car (args) ;
+        if (isInteger (argument) && (ivalue (argument) > 0)) {
+            size = (size_t) ivalue (argument) ;
+        } else {
+            SET_ERRNO (EINVAL) ;
+            LGE "(nptOpen) Invalid buffer size specification: ") ;
+            return (sc->F) ;
+        }
+    }
+
+/* Allocate the record, the port structure, and the buffer. */
+
+    record = (NptPort *) calloc (1, sizeof (NptPort)) ;
+    if (record == NULL) {
+        LGE "(nptOpen) Error allocating NptPort structure.\ncalloc: ") ;
+        return (sc->F) ;
+    }
+
+    pyort = (port *) sc->malloc (sizeof (port)) ;
+    buffer = (char *) sc->malloc (size + 1) ;
+    if ((pyort == NULL) || (buffer == NULL)) {
+        LGE "(nptOpen) Error allocating %lu-byte port.\nmalloc: ",
+            (unsigned long) size) ;
+        PUSH_ERRNO ;
+        if (pyort != NULL)  sc->free (pyort) ;
+        if (buffer != NULL)  sc->free (buffer) ;
+        free (record) ;
+        POP_ERRNO ;
+        return (sc->F) ;
+    }
+
+/* An input buffer starts out empty; an output buffer starts out as all
+   free space.  The interpreter grows an output buffer with strcpy(3), so
+   the free space is kept zeroed. */
+
+    memset (buffer, '\0', size + 1) ;
+    pyort->rep.string.start = buffer ;
+    pyort->rep.string.curr = buffer ;
+    if (output) {
+        pyort->kind = port_output | port_string | port_srfi6 ;
+        pyort->rep.string.past_the_end = buffer + size ;
+    } else {
+        pyort->kind = port_input | port_string ;
+        pyort->rep.string.past_the_end = buffer ;
+    }
+
+/* Create the Scheme port and keep it from being collected while open. */
+
+    cell = mk_port (sc, pyort) ;
+
+    record->sc = sc ;
+    record->pyort = pyort ;
+    record->endpoint = endpoint ;
+    record->stream = stream ;
+    record->size = size ;
+
+    record->portID = gc_protect (sc, cell) ;
+    if (record->portID == 0) {
+        LGE "(nptOpen) Error protecting port %p.\ngc_protect: ",
+            (void *) pyort) ;
+        PUSH_ERRNO ;
+        sc->free (buffer) ;
+        pyort->kind = port_free ;
+        pyort->rep.string.start = emptyBuffer ;
+        pyort->rep.string.past_the_end = emptyBuffer ;
+        pyort->rep.string.curr = emptyBuffer ;
+        free (record) ;
+        POP_ERRNO ;
+        return (sc->F) ;
+    }
+
+    opaque_pin (sc, (stream == NULL) ? (opaque) endpoint : (opaque) stream,
+                true) ;
+
+    record->next = portList ;
+    portList = record ;
+
+    LGI "(nptOpen) Opened %s port %p on %s.\n",
+        output ? "output" : "input", (void *) pyort,
+        (stream == NULL) ? tcpName (endpoint) : lfnName (stream)) ;
+
+    return (cell) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    nptWrite ()
+
+    Write a Network Port's Buffered Output.
+
+
+Purpose:
+
+    Function nptWrite() writes a network output port's buffered output
+    directly from the port's buffer and shifts whatever wasn't written to
+    the front of the buffer.  Running out of time is not an error; the
+    caller checks how much output remains.
+
+
+    Invocation:
+
+        status = nptWrite (record, timeout) ;
+
+    where
+
+        <record>	- I
+            is the port's record.
+        <timeout>	- I
+            is the number of seconds to wait for the output to be written.
+            A timeout of zero writes only what the connection will take
+            without waiting; a negative timeout waits as long as it takes.
+        <status>	- O
+            returns the status of writing the output, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  nptWrite (
+
+#    if PROTOTYPES
+        NptPort  *record,
+        double  timeout)
+#    else
+        record, timeout)
+
+        NptPort  *record ;
+        double  timeout ;
+#    endif
+
+{    /* Local variables. */
+    char  *start ;
+    errno_t  status ;
+    port  *pyort ;
+    size_t  length, written ;
+
+
+
+    pyort = record->pyort ;
+    start = pyort->rep.string.start ;
+    length = pyort->rep.string.curr - start ;
+    if (length == 0)  return (0) ;
+
+    written = 0 ;
+    if (record->stream == NULL)
+        status = tcpWrite (record->endpoint, timeout, length, start,
+                           &written) ;
+    else
+        status = lfnWrite (record->stream, timeout, (ssize_t) length, start,
+                           &written) ;
+    if (written > length)  written = length ;
+
+/* Shift the unwritten output to the front of the buffer, zeroing the space
+   it vacates. */
+
+    if (written > 0) {
+        memmove (start, start + written, length - written) ;
+        memset (start + length - written, '\0', written) ;
+        pyort->rep.string.curr -= written ;
+    }
+
+    if (status && (status != EWOULDBLOCK) && (status != EAGAIN)) {
+        LGE "(nptWrite) Error writing to %s.\n%s: ",
+            (record->stream == NULL) ? tcpName (record->endpoint)
+                                     : lfnName (record->stream),
+            (record->stream == NULL) ? "tcpWrite" : "lfnWrite") ;
+        return (status) ;
+    }
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    nptWriteCB ()
+
+    Write Buffered Output when a Connection is Writeable.
+
+
+Purpose:
+
+    Function nptWriteCB() is the IOX callback registered by NPT-FLUSH to
+    write a port's output in the background.  Each time the connection is
+    writeable, the callback writes what the connection will take; once the
+    buffer is empty or an error occurs, the callback cancels itself.  An
+    error is saved and reported by the next NPT-FLUSH.  If the dispatcher
+    is running a bounded slice whose budget is spent, the write is left
+    for the next slice.
+
+
+    Invocation:
+
+        status = nptWriteCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the IOX callback.
+        <reason>	- I
+            is the reason (e.g., IoxWrite, IoxCancel) the callback is being
+            invoked.
+        <userData>	- I
+            is the address of the port's NptPort record.
+        <status>	- O
+            returns the status of handling the event, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  nptWriteCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    errno_t  status ;
+    NptPort  *record = (NptPort *) userData ;
+
+
+
+/* The callback is canceled when the buffer empties, when the port is
+   closed, or when the dispatcher is destroyed. */
+
+    if (reason == IoxCancel) {
+        if (callback == record->callback)  record->callback = NULL ;
+        return (0) ;
+    }
+
+    if (soxSliceDone (record->dispatcher))  return (0) ;
+
+    status = nptWrite (record, 0.0) ;
+    if (status) {
+        record->error = status ;
+        return (ioxCancel (callback)) ;
+    }
+
+    if (record->pyort->rep.string.curr == record->pyort->rep.string.start)
+        return (ioxCancel (callback)) ;
+
+    return (0) ;
+
+}
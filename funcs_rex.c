@@ -30,6 +30,10 @@ Purpose:
         (rex-wild "<wildcard>")			=> "<regexp>"
 
 
+    Compiled patterns not deleted with REX-DESTROY are deleted once the
+    garbage collector has reclaimed their handles (see "opaque.c").
+
+
 Public Procedures:
 
     addFuncsREX() - registers the functions with the Scheme intepreter.
@@ -43,6 +47,7 @@ Private Procedures:
     func_REX_MATCH() - implements the REX-MATCH function.
     func_REX_REPLACE() - implements the REX-REPLACE function.
     func_REX_WILD() - implements the REX-WILD function.
+    funcRexFinalize() - deletes a leaked compiled pattern.
 
 *******************************************************************************/
 
@@ -67,6 +72,8 @@ static  pointer  func_REX_ERROR P_((scheme *sc, pointer args)) ;
 static  pointer  func_REX_MATCH P_((scheme *sc, pointer args)) ;
 static  pointer  func_REX_REPLACE P_((scheme *sc, pointer args)) ;
 static  pointer  func_REX_WILD P_((scheme *sc, pointer args)) ;
+
+static  errno_t  funcRexFinalize P_((opaque value)) ;
 
 /*!*****************************************************************************
 
@@ -135,6 +142,8 @@ void  addFuncsREX (
                    mk_symbol (sc, "rex-wild"),
                    mk_foreign_func (sc, func_REX_WILD)) ;
 
+    opaque_finalizer (sc, OpaquePattern, funcRexFinalize) ;
+
     return ;
 
 }
@@ -219,7 +228,7 @@ static  pointer  func_REX_CREATE (
 
 /* Return the compiled RE to the caller. */
 
-    return (mk_opaque (sc, (opaque) pattern)) ;
+    return (mk_opaque (sc, (opaque) pattern, OpaquePattern)) ;
 
 }
 
@@ -350,15 +359,18 @@ static  pointer  func_REX_DESTROY (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        pattern = (CompiledRE) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaquePattern)) {
+        pattern = (CompiledRE) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_REX_DESTROY) Argument is not a pattern: ") ;
         return (sc->F) ;
     }
 
-/* Destroy the compiled regular expression. */
+/* Destroy the compiled regular expression, invalidating any remaining
+   handles for it. */
+
+    opaque_release (sc, (opaque) pattern) ;
 
     return (rex_delete (pattern) ? sc->F : sc->T) ;
 
@@ -490,8 +502,8 @@ static  pointer  func_REX_MATCH (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        pattern = (CompiledRE) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaquePattern)) {
+        pattern = (CompiledRE) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_REX_MATCH) Argument is not a pattern: ") ;
@@ -628,8 +640,8 @@ static  pointer  func_REX_REPLACE (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        pattern = (CompiledRE) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaquePattern)) {
+        pattern = (CompiledRE) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_REX_REPLACE) Argument is not a pattern: ") ;
@@ -787,3 +799,53 @@ static  pointer  func_REX_WILD (
     return (mk_string (sc, regexp)) ;
 
 }
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcRexFinalize ()
+
+    Delete a Leaked Compiled Pattern.
+
+
+Purpose:
+
+    Function funcRexFinalize() is registered with the OPAQUE package as the
+    finalizer for compiled patterns.  It deletes a pattern whose handles
+    were all garbage-collected before REX-DESTROY was called.
+
+
+    Invocation:
+
+        status = funcRexFinalize (value) ;
+
+    where
+
+        <value>		- I
+            is the compiled pattern, as an opaque value.
+        <status>	- O
+            returns the status of deleting the pattern, zero if there were no
+            errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcRexFinalize (
+
+#    if PROTOTYPES
+        opaque  value)
+#    else
+        value)
+
+        opaque  value ;
+#    endif
+
+{    /* Local variables. */
+    CompiledRE  pattern = (CompiledRE) value ;
+
+
+
+    return (rex_delete (pattern) ? errno : 0) ;
+
+}
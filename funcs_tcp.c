@@ -29,14 +29,19 @@ Purpose:
         (tcp-name <endpoint>)			=> <string>   (Connection name)
         (tcp-pending? <endpoint>)		=> <flag>
         (tcp-read <endpoint> <length>
-                  [<timeout>])			=> <string>
+                  [<timeout> [<bytevector?>]])	=> <string>|<bytevector>
         (tcp-readable? <endpoint>)		=> <flag>
         (tcp-up? <endpoint>)			=> <flag>
-        (tcp-write <endpoint> <string>
+        (tcp-write <endpoint> <string>|<bytevector>
                    [<timeout>])			=> <status>   (#t|#f)
         (tcp-writeable? <endpoint>)		=> <flag>
 
 
+    An endpoint whose handles have all been garbage-collected without a call
+    to TCP-DESTROY is closed automatically (see "opaque.c"), but not until
+    the collector happens to run.
+
+
 Public Procedures:
 
     addFuncsTCP() - registers the functions with the Scheme intepreter.
@@ -57,6 +62,7 @@ Private Procedures:
     func_TCP_UPp() - implements the TCP-UP? function.
     func_TCP_WRITE() - implements the TCP-WRITE function.
     func_TCP_WRITEABLEp() - implements the TCP-WRITEABLE? function.
+    funcTcpFinalize() - closes a leaked endpoint.
 
 *******************************************************************************/
 
@@ -68,6 +74,7 @@ Private Procedures:
 #include  <string.h>			/* C Library string functions. */
 #include  "tcp_util.h"			/* TCP/IP networking utilities. */
 #include  "tsion.h"			/* TinyScheme I/O Network functions. */
+#include  "trc_util.h"			/* Event trace record/replay. */
 
 
 /*******************************************************************************
@@ -88,6 +95,8 @@ static  pointer  func_TCP_READABLEp P_((scheme *sc, pointer args)) ;
 static  pointer  func_TCP_UPp P_((scheme *sc, pointer args)) ;
 static  pointer  func_TCP_WRITE P_((scheme *sc, pointer args)) ;
 static  pointer  func_TCP_WRITEABLEp P_((scheme *sc, pointer args)) ;
+
+static  errno_t  funcTcpFinalize P_((opaque value)) ;
 
 /*!*****************************************************************************
 
@@ -184,6 +193,8 @@ void  addFuncsTCP (
                    mk_symbol (sc, "tcp-writeable?"),
                    mk_foreign_func (sc, func_TCP_WRITEABLEp)) ;
 
+    opaque_finalizer (sc, OpaqueTcpEndpoint, funcTcpFinalize) ;
+
     return ;
 
 }
@@ -254,8 +265,8 @@ static  pointer  func_TCP_ANSWER (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        listeningPoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        listeningPoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_ANSWER) Invalid endpoint specification: ") ;
@@ -280,14 +291,18 @@ static  pointer  func_TCP_ANSWER (
 
 /* Wait for and answer the next connection request from a client. */
 
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcTcpAnswer, NULL)) ;
+
     if (tcpAnswer (listeningPoint, timeout, &dataPoint)) {
         LGE "(func_TCP_ANSWER) Error answering connection request.\ntcpAnswer: ") ;
-        return (sc->F) ;
+        return (trcResult (sc, TrcTcpAnswer, sc->F)) ;
     }
 
 /* Return the data endpoint to the caller. */
 
-    return (mk_opaque (sc, (opaque) dataPoint)) ;
+    return (trcResult (sc, TrcTcpAnswer,
+                       mk_opaque (sc, (opaque) dataPoint, OpaqueTcpEndpoint))) ;
 
 }
 
@@ -383,15 +398,19 @@ static  pointer  func_TCP_CALL (
 
 /* Attempt to establish a connection to the server. */
 
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcTcpCall, NULL)) ;
+
     if (tcpCall (server, noWait, &dataPoint)) {
         LGE "(func_TCP_CALL) Error attempting to connect to \"%s\".\ntcpCall: ",
             server) ;
-        return (sc->F) ;
+        return (trcResult (sc, TrcTcpCall, sc->F)) ;
     }
 
 /* Return the data endpoint to the caller. */
 
-    return (mk_opaque (sc, (opaque) dataPoint)) ;
+    return (trcResult (sc, TrcTcpCall,
+                       mk_opaque (sc, (opaque) dataPoint, OpaqueTcpEndpoint))) ;
 
 }
 
@@ -480,8 +499,8 @@ static  pointer  func_TCP_COMPLETE (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        dataPoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        dataPoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_COMPLETE) Invalid endpoint specification: ") ;
@@ -513,14 +532,18 @@ static  pointer  func_TCP_COMPLETE (
 
 /* Wait for the connection to be established. */
 
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcTcpComplete, NULL)) ;
+
     if (tcpComplete (dataPoint, timeout, destroyOnError)) {
         LGE "(func_TCP_COMPLETE) Error attempting to complete connection.\ntcpComplete: ") ;
-        return (sc->F) ;
+        if (destroyOnError)  opaque_release (sc, (opaque) dataPoint) ;
+        return (trcResult (sc, TrcTcpComplete, sc->F)) ;
     }
 
 /* The connection was successfully established.  Return #t to the caller. */
 
-    return (sc->T) ;
+    return (trcResult (sc, TrcTcpComplete, sc->T)) ;
 
 }
 
@@ -654,15 +677,20 @@ static  pointer  func_TCP_DESTROY (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        endpoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        endpoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_DESTROY) Argument is not an endpoint: ") ;
         return (sc->F) ;
     }
 
-/* Close the endpoint. */
+/* Close the endpoint.  (Fake endpoints from a replay have nothing to close.)
+   Any remaining handles for the endpoint are invalidated. */
+
+    opaque_release (sc, (opaque) endpoint) ;
+
+    if (trcIsFake ((void *) endpoint))  return (sc->T) ;
 
     return (tcpDestroy (endpoint) ? sc->F : sc->T) ;
 
@@ -725,8 +753,8 @@ static  pointer  func_TCP_FD (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        endpoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        endpoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_FD) Argument is not an endpoint: ") ;
@@ -735,6 +763,9 @@ static  pointer  func_TCP_FD (
 
 /* Return the endpoint's socket to the caller. */
 
+    if (trcIsFake ((void *) endpoint))
+        return (mk_integer (sc, trcFakeFd ((void *) endpoint))) ;
+
     return (mk_integer (sc, (long) tcpFd (endpoint))) ;
 
 }
@@ -838,7 +869,7 @@ static  pointer  func_TCP_LISTEN (
 
 /* Return the endpoint to the caller. */
 
-    return (mk_opaque (sc, (opaque) listeningPoint)) ;
+    return (mk_opaque (sc, (opaque) listeningPoint, OpaqueTcpEndpoint)) ;
 
 }
 
@@ -904,8 +935,8 @@ static  pointer  func_TCP_NAME (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        endpoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        endpoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_NAME) Argument is not an endpoint: ") ;
@@ -914,6 +945,8 @@ static  pointer  func_TCP_NAME (
 
 /* Return the endpoint's name to the caller. */
 
+    if (trcIsFake ((void *) endpoint))  return (mk_string (sc, "replay")) ;
+
     return (mk_string (sc, tcpName (endpoint))) ;
 
 }
@@ -976,8 +1009,8 @@ static  pointer  func_TCP_PENDINGp (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        endpoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        endpoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_PENDINGp) Argument is not an endpoint: ") ;
@@ -986,7 +1019,11 @@ static  pointer  func_TCP_PENDINGp (
 
 /* Check if the endpoint has pending connection requests. */
 
-    return (tcpRequestPending (endpoint) ? sc->T : sc->F) ;
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcTcpPending, NULL)) ;
+
+    return (trcResult (sc, TrcTcpPending,
+                       tcpRequestPending (endpoint) ? sc->T : sc->F)) ;
 
 }
 
@@ -1003,11 +1040,14 @@ Purpose:
 
     Function func_TCP_READ() reads data from a network connection.
 
-        (tcp-read <endpoint> <length> [<timeout>])
+        (tcp-read <endpoint> <length> [<timeout> [<bytevector?>]])
 
         Read <length> bytes of arbitrary data from endpoint into a
         string buffer and return the buffer to the caller.  The data
         can be arbitrary binary data and can contain embedded NULs.
+        If <bytevector?> is present and true, the data is returned in
+        a bytevector instead (see "funcs_bvr.c"); pass a negative
+        <timeout> to wait indefinitely.
 
         Because of the way network I/O works, a single record written to a
         connection by one task may be read in multiple "chunks" by the task
@@ -1042,12 +1082,13 @@ Purpose:
             is a list of the arguments: the data endpoint returned by TCP-CALL,
             the number of bytes to read, and, optionally, a timeout value
             representing the number of seconds to wait for the desired amount
-            of data to be read.
+            of data to be read and a flag requesting a bytevector.
         <data>		- O
             returns the input data in a *counted* string; i.e., the number of
             bytes of data in the "string" is stored internally in the Scheme
             cell and is *not* dependent upon being a NUL-terminated string.
-            If an error occurs, #f is returned.
+            The data is returned in a bytevector if requested.  If an error
+            occurs, #f is returned.
 
 *******************************************************************************/
 
@@ -1065,6 +1106,7 @@ static  pointer  func_TCP_READ (
 #    endif
 
 {    /* Local variables. */
+    bool  binary ;
     char  *buffer ;
     double  timeout ;
     pointer  argument, data ;
@@ -1078,8 +1120,8 @@ static  pointer  func_TCP_READ (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        dataPoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        dataPoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_READ) Invalid endpoint specification: ") ;
@@ -1112,30 +1154,41 @@ static  pointer  func_TCP_READ (
         }
     }
 
+    binary = (args != sc->NIL) && (cdr (args) != sc->NIL) &&
+             !is_false (sc, cadr (args)) ;
+
 /* Read the data from the network connection. */
 
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcTcpRead, NULL)) ;
+
+/* The data is read directly into a Scheme string (or bytevector) allocated
+   for the maximum length, which is then cut down to the number of bytes
+   actually read. */
+
     length = (numBytesToRead < 0) ? -numBytesToRead : numBytesToRead ;
-    buffer = calloc (length, 1) ;
-    if (buffer == NULL) {
-        LGE "(func_TCP_READ) Error allocating %lu-byte buffer.\ncalloc: ",
+    data = binary ? mk_bytevector (sc, NULL, length) : mk_ustring (sc, length) ;
+    if (data == NULL) {
+        LGE "(func_TCP_READ) Error allocating %lu-byte buffer.\n",
             (unsigned long) length) ;
         return (sc->F) ;
     }
+    buffer = binary ? (char *) bytevector_data (data) : strvalue (data) ;
 
     if (tcpRead (dataPoint, timeout, numBytesToRead, buffer, &numBytesRead)) {
         LGE "(func_TCP_READ) Error reading %lu bytes from %s.\ntcpRead: ",
             (unsigned long) length, tcpName (dataPoint)) ;
-        PUSH_ERRNO ;  free (buffer) ;  POP_ERRNO ;
-        return (sc->F) ;
+        return (trcResult (sc, TrcTcpRead, sc->F)) ;
     }
 
-/* Return the input data to the caller as a *counted* string. */
+/* Return the input data to the caller as a *counted* string or bytevector. */
 
-    data = mk_bstring (sc, (const char *) buffer, numBytesRead) ;
+    if (binary)
+        bytevector_shrink (sc, data, numBytesRead) ;
+    else
+        string_shrink (sc, data, numBytesRead) ;
 
-    free (buffer) ;
-
-    return (data) ;
+    return (trcResult (sc, TrcTcpRead, data)) ;
 
 }
 
@@ -1196,8 +1249,8 @@ static  pointer  func_TCP_READABLEp (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        endpoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        endpoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_READABLEp) Argument is not an endpoint: ") ;
@@ -1206,7 +1259,11 @@ static  pointer  func_TCP_READABLEp (
 
 /* Check if the endpoint is readable. */
 
-    return (tcpIsReadable (endpoint) ? sc->T : sc->F) ;
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcTcpReadable, NULL)) ;
+
+    return (trcResult (sc, TrcTcpReadable,
+                       tcpIsReadable (endpoint) ? sc->T : sc->F)) ;
 
 }
 
@@ -1266,8 +1323,8 @@ static  pointer  func_TCP_UPp (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        endpoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        endpoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_UPp) Argument is not an endpoint: ") ;
@@ -1276,7 +1333,11 @@ static  pointer  func_TCP_UPp (
 
 /* Check if the endpoint is up. */
 
-    return (tcpIsUp (endpoint) ? sc->T : sc->F) ;
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcTcpUp, NULL)) ;
+
+    return (trcResult (sc, TrcTcpUp,
+                       tcpIsUp (endpoint) ? sc->T : sc->F)) ;
 
 }
 
@@ -1293,9 +1354,9 @@ Purpose:
 
     Function func_TCP_WRITE() writes data to a network connection.
 
-        (tcp-write <endpoint> <string> [<timeout>])
+        (tcp-write <endpoint> <string>|<bytevector> [<timeout>])
 
-        Write arbitrary data from <string> to <endpoint>.
+        Write arbitrary data from <string> or <bytevector> to <endpoint>.
 
         Because of the way network I/O works, attempting to output a given
         amount of data to a network connection may require multiple network
@@ -1326,9 +1387,9 @@ Purpose:
             is the Scheme interpreter.
         <args>		- I
             is a list of the arguments: the data endpoint returned by TCP-CALL,
-            a *counted* string of data to be output, and, optionally, a timeout
-            value representing the number of seconds to wait for the desired
-            amount of data to be written.
+            a *counted* string or a bytevector of data to be output, and,
+            optionally, a timeout value representing the number of seconds
+            to wait for the desired amount of data to be written.
         <length>	- O
             returns the number of bytes successfully written, given any timeout
             contraint; false (#f) is returned if there was an error.
@@ -1361,8 +1422,8 @@ static  pointer  func_TCP_WRITE (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        dataPoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        dataPoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_WRITE) Invalid endpoint specification: ") ;
@@ -1374,6 +1435,9 @@ static  pointer  func_TCP_WRITE (
     if (is_string (argument)) {
         buffer = strvalue (argument) ;
         numBytesToWrite = (size_t) strlength (argument) ;
+    } else if (is_bytevector (argument)) {
+        buffer = (char *) bytevector_data (argument) ;
+        numBytesToWrite = bytevector_length (argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_WRITE) Invalid data specification: ") ;
@@ -1398,17 +1462,21 @@ static  pointer  func_TCP_WRITE (
 
 /* Write the data to the network connection. */
 
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcTcpWrite, NULL)) ;
+
     if (tcpWrite (dataPoint, timeout, numBytesToWrite, buffer,
                   &numBytesWritten)
         && (errno != EWOULDBLOCK)) {
         LGE "(func_TCP_WRITE) Error writing %lu bytes to %s.\ntcpWrite: ",
             (unsigned long) numBytesToWrite, tcpName (dataPoint)) ;
-        return (sc->F) ;
+        return (trcResult (sc, TrcTcpWrite, sc->F)) ;
     }
 
 /* Return the number of bytes actually written. */
 
-    return (mk_integer (sc, (long) numBytesWritten)) ;
+    return (trcResult (sc, TrcTcpWrite,
+                       mk_integer (sc, (long) numBytesWritten))) ;
 
 }
 
@@ -1469,8 +1537,8 @@ static  pointer  func_TCP_WRITEABLEp (
 /* Get the argument(s). */
 
     argument = car (args) ;
-    if (is_opaque (argument)) {
-        endpoint = (TcpEndpoint) opaque_value (argument) ;
+    if (is_opaque (sc, argument, OpaqueTcpEndpoint)) {
+        endpoint = (TcpEndpoint) opaque_value (sc, argument) ;
     } else {
         SET_ERRNO (EINVAL) ;
         LGE "(func_TCP_WRITEABLEp) Argument is not an endpoint: ") ;
@@ -1479,6 +1547,63 @@ static  pointer  func_TCP_WRITEABLEp (
 
 /* Check if the endpoint is writeable. */
 
-    return (tcpIsWriteable (endpoint) ? sc->T : sc->F) ;
+    if (trcReplaying (sc, NULL))
+        return (trcResult (sc, TrcTcpWriteable, NULL)) ;
+
+    return (trcResult (sc, TrcTcpWriteable,
+                       tcpIsWriteable (endpoint) ? sc->T : sc->F)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    funcTcpFinalize ()
+
+    Close a Leaked Endpoint.
+
+
+Purpose:
+
+    Function funcTcpFinalize() is registered with the OPAQUE package as the
+    finalizer for TCP endpoints.  It closes an endpoint whose handles were
+    all garbage-collected before TCP-DESTROY was called.  Fake endpoints
+    made during a replay have nothing to close and are ignored.
+
+
+    Invocation:
+
+        status = funcTcpFinalize (value) ;
+
+    where
+
+        <value>		- I
+            is the endpoint, as an opaque value.
+        <status>	- O
+            returns the status of closing the endpoint, zero if there were no
+            errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  funcTcpFinalize (
+
+#    if PROTOTYPES
+        opaque  value)
+#    else
+        value)
+
+        opaque  value ;
+#    endif
+
+{    /* Local variables. */
+    TcpEndpoint  endpoint = (TcpEndpoint) value ;
+
+
+
+    if (trcIsFake (value))  return (0) ;
+
+    return (tcpDestroy (endpoint) ? errno : 0) ;
 
 }
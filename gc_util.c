@@ -19,42 +19,648 @@ Purpose:
     in an associative list (indexed by unique numerical IDs), thus making
     the values again visible to GC.
 
+    To keep protecting, retrieving, and unprotecting values constant-time
+    operations, the TSION-specific structure also keeps an array of pointers
+    to the bindings in the associative list, indexed by ID.  When a value is
+    unprotected, its binding is not removed from the list; instead, the
+    binding's value is set to the binding itself, marking the ID released,
+    and the ID is pushed on a free stack for reuse by a later gc_protect().
+    Retrieving or unprotecting a released ID is an error, so a stale ID
+    can't pick up another owner's value or be pushed on the stack twice.
+
         [The following "problem" addressed by the GC_UTIL package
         turns out not to be a problem, but a misunderstanding on
         my part.  In an E-mail exchange, Dr. Jonathan Shapiro,
         the author of TinyScheme's garbage collector, informed
         me that objects are *not* relocated during GC.]
 
-    Scheme values may also be relocated during GC.  The indirection provided
-    by the associative list solves this problem.  When an application needs
-    a cached Scheme value, the application retrieves it up ID from the
-    associative list.  Since GC adjusts the pointers in the associative list
-    if an value is relocated, the application can be sure of receiving the
-    correct value.
+    Scheme values may also be relocated during GC.  The indirection provided
+    by the associative list solves this problem.  When an application needs
+    a cached Scheme value, the application retrieves it up ID from the
+    associative list.  Since GC adjusts the pointers in the associative list
+    if an value is relocated, the application can be sure of receiving the
+    correct value.
+
+    The GC_UTIL functions also keep statistics on the collector.  TinyScheme
+    collects when its cell heap runs out, which in a server usually means in
+    the middle of a burst of I/O callbacks.  A program can instead collect
+    in quiet periods with gc_idle() (see IOX-IDLE-GC), which runs a timed
+    collection once the heap fills past a threshold.  The collections that
+    still happen on their own are detected after the fact by gc_detect(),
+    which the dispatcher calls after each Scheme callback.
+
+    Finally, for chasing memory growth, gc_stats() reports the size of the
+    cell heap and the collector's totals, and gc_census() walks the heap,
+    counting the occupied cells by type.  The census can't tell live cells
+    from garbage, so it should be taken right after a collection.
+
+
+Public Procedures:
+
+    gc_census() - count the cells in the heap by type.
+    gc_collect() - run a timed garbage collection.
+    gc_collections() - count the garbage collections run so far.
+    gc_detect() - detect a garbage collection run since the last check.
+    gc_idle() - run an idle-time garbage collection if warranted.
+    gc_occupancy() - get the fraction of the cell heap in use.
+    gc_pauses() - get garbage collection statistics.
+    gc_protect() - protect a Scheme value from being collected as garbage.
+    gc_release() - free an interpreter's GC_UTIL storage.
+    gc_retrieve() - retrieve a protected Scheme value by ID.
+    gc_stats() - get heap statistics.
+    gc_type_name() - get the name of a cell type.
+    gc_unprotect() - allow a Scheme value to be collected as garbage.
+
+Private Procedures:
+
+    gcPlant() - plants a canary for detecting garbage collections.
+    gcState() - gets an interpreter's GC_UTIL state.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <string.h>			/* C Library string functions. */
+#include  "tv_util.h"			/* "timeval" manipulation functions. */
+#include  "plist_util.h"		/* TinyScheme property lists. */
+#include  "gc_util.h"			/* Garbage collection utilities. */
+
+
+int  gc_util_debug = 0 ;		/* Global debug switch (1/0 = yes/no). */
+#undef  I_DEFAULT_GUARD
+#define  I_DEFAULT_GUARD  gc_util_debug
+
+
+/*******************************************************************************
+    GC_UTIL State - the collection statistics and the canary used to detect
+        collections (see gc_detect()), one per interpreter.
+*******************************************************************************/
+
+typedef  struct  _GcState {
+    pointer  canary ;			/* Unreferenced cell; NULL if none. */
+    long  tag ;				/* Canary's character code. */
+    GcPauses  requested ;		/* Collections run by gc_collect(). */
+    GcPauses  other ;			/* Allocation-triggered, etc. */
+    double  lastPause ;			/* Pause of last gc_collect(). */
+    long  lastCells ;			/* Heap size at last gc_collect(). */
+    double  liveAfter ;			/* Heap in use after last collection. */
+}  _GcState, *GcState ;
+
+					/* Canary tags are beyond Unicode. */
+#define  GC_CANARY_BASE  0x110000L
+					/* Total cells in the heap. */
+#define  GC_CELLS(sc)  ((long) ((sc)->last_cell_seg + 1) * CELL_SEGSIZE)
+					/* Is an ID's binding released? */
+#define  GC_RELEASED(binding)  (cdr (binding) == (binding))
+
+					/* Cell type names, indexed by type. */
+static  const  char  *gcTypeNames[GC_NUM_TYPES] = {
+    "unknown", "string", "number", "symbol", "procedure", "pair",
+    "closure", "continuation", "foreign", "character", "port", "vector",
+    "macro", "promise", "environment", "opaque", "bytevector"
+} ;
+
+
+/*******************************************************************************
+    Private functions.
+*******************************************************************************/
+
+static  void  gcPlant P_((scheme *sc,
+                          GcState state)) ;
+
+static  GcState  gcState P_((scheme *sc)) ;
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gc_census ()
+
+    Count the Cells in the Heap by Type.
+
+
+Purpose:
+
+    The gc_census() function walks the interpreter's cell heap and counts
+    the occupied cells by type.  Free cells have a type of zero and aren't
+    counted; neither are the cells following a vector's header, which hold
+    the vector's elements and are tallied separately.  The collector only
+    clears a cell when it sweeps it, so the census includes any garbage not
+    yet collected; run gc_collect() (or Scheme's GC) first for an exact count
+    of the live cells.
+
+
+    Invocation:
+
+        gc_census (sc, &census) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <census>	- O
+            returns the cell counts by type (see gc_type_name()), the total
+            number of bytes allocated for strings, and the number of cells
+            holding vector elements.
+
+*******************************************************************************/
+
+
+void  gc_census (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        GcCensus  *census)
+#    else
+        sc, census)
+
+        scheme  *sc ;
+        GcCensus  *census ;
+#    endif
+
+{    /* Local variables. */
+    int  i, kind ;
+    long  elements ;
+    pointer  cell, last ;
+
+
+
+    memset (census, 0, sizeof (GcCensus)) ;
+
+    for (i = 0 ;  i <= sc->last_cell_seg ;  i++) {
+        last = sc->cell_seg[i] + CELL_SEGSIZE ;
+        for (cell = sc->cell_seg[i] ;  cell < last ;  cell++) {
+            if (typeflag (cell) == 0)  continue ;	/* Free cell? */
+            kind = type (cell) ;
+            if (kind >= GC_NUM_TYPES)  kind = 0 ;
+            census->count[kind]++ ;
+            if (kind == T_STRING) {
+                census->stringBytes += strlength (cell) + 1 ;
+            } else if (kind == T_VECTOR) {
+					/* Skip over the element cells. */
+                elements = vector_length (cell) / 2
+                           + vector_length (cell) % 2 ;
+                census->vectorCells += elements ;
+                cell += elements ;
+            }
+        }
+    }
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gc_collect ()
+
+    Run a Garbage Collection.
+
+
+Purpose:
+
+    The gc_collect() function runs a full garbage collection by calling
+    TinyScheme's GC procedure, timing the collection and counting it among
+    the requested collections.  The interpreter's own collector is "static"
+    in "scheme.c", so it can only be reached through the Scheme procedure.
+
+
+    Invocation:
+
+        status = gc_collect (sc, &pause) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <pause>		- O
+            returns the length of the collection in seconds.  NULL can be
+            specified if this value is not needed.
+        <status>	- O
+            returns the status of running the collection, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  gc_collect (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        double  *pause)
+#    else
+        sc, pause)
+
+        scheme  *sc ;
+        double  *pause ;
+#    endif
+
+{    /* Local variables. */
+    double  elapsed ;
+    GcState  state ;
+    pointer  function ;
+    struct  timeval  start ;
+
+
+
+    state = gcState (sc) ;
+    if (state == NULL)  return (errno) ;
+
+/* Charge any collection run since the last check to the other collections,
+   before this collection kills the canary. */
+
+    gc_detect (sc, 0.0) ;
+
+    function = scheme_eval (sc, mk_symbol (sc, "gc")) ;
+    if (!is_proc (function)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(gc_collect) GC is not a built-in procedure.\n") ;
+        return (errno) ;
+    }
+
+    start = tvTOD () ;
+    scheme_call (sc, function, sc->NIL) ;
+    elapsed = tvFloat (tvSubtract (tvTOD (), start)) ;
+
+    state->requested.count++ ;
+    state->requested.total += elapsed ;
+    if (state->requested.max < elapsed)  state->requested.max = elapsed ;
+
+    state->lastPause = elapsed ;
+    state->lastCells = GC_CELLS (sc) ;
+    state->liveAfter = gc_occupancy (sc) ;
+
+    gcPlant (sc, state) ;
+
+    LGI "(gc_collect) %.6f seconds, %ld cells free.\n",
+        elapsed, (long) sc->fcells) ;
+
+    if (pause != NULL)  *pause = elapsed ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gc_collections ()
+
+    Count the Garbage Collections Run So Far.
+
+
+Purpose:
+
+    The gc_collections() function returns the number of garbage collections
+    the interpreter has run, including one run since the last check (see
+    gc_detect()) but not yet counted.  Unlike gc_detect(), it leaves that
+    collection to be counted by the next check, so a caller can compare
+    counts taken at two points in time to learn whether the collector ran
+    in between, without stealing the detection from gc_detect()'s callers.
+
+
+    Invocation:
+
+        count = gc_collections (sc) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <count>		- O
+            returns the number of collections run so far; zero if the
+            interpreter has no GC_UTIL state.
+
+*******************************************************************************/
+
+
+long  gc_collections (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{    /* Local variables. */
+    GcState  state ;
+    long  count ;
+
+
+
+    state = gcState (sc) ;
+    if (state == NULL)  return (0) ;
+
+    count = state->requested.count + state->other.count ;
+
+    if (state->canary == NULL)			/* First check? */
+        gcPlant (sc, state) ;
+    else if (!is_character (state->canary) ||
+             (charvalue (state->canary) != state->tag))
+        count++ ;				/* Collected, not yet counted. */
+
+    return (count) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gc_detect ()
+
+    Detect a Garbage Collection.
+
+
+Purpose:
+
+    The gc_detect() function checks if the garbage collector has run (other
+    than by gc_collect()) since the last check and, if so, counts the
+    collection among the other collections.  A collection cannot be timed
+    from outside of "scheme.c", so the caller supplies the length of the
+    Scheme call during which the collection ran, an upper bound on the pause.
+
+    The check is made with a canary: an unreferenced character cell, with a
+    character code beyond Unicode's, that the collector reclaims (zeroing
+    its type) on its next run.  (Comparing counts of free cells would miss
+    a collection that recovered fewer cells than were allocated since the
+    last check.)
+
+
+    Invocation:
+
+        collected = gc_detect (sc, elapsed) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <elapsed>	- I
+            is the length in seconds of the interval, if known, in which the
+            collection would have run; zero if not known.
+        <collected>	- O
+            returns true if the collector ran since the last check and false
+            otherwise.
+
+*******************************************************************************/
+
+
+bool  gc_detect (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        double  elapsed)
+#    else
+        sc, elapsed)
+
+        scheme  *sc ;
+        double  elapsed ;
+#    endif
+
+{    /* Local variables. */
+    GcState  state ;
+
+
+
+    state = gcState (sc) ;
+    if (state == NULL)  return (false) ;
+
+    if (state->canary == NULL) {		/* First check? */
+        gcPlant (sc, state) ;
+        return (false) ;
+    }
+
+    if (is_character (state->canary) &&
+        (charvalue (state->canary) == state->tag))
+        return (false) ;			/* Canary still alive. */
+
+    state->other.count++ ;
+    state->other.total += elapsed ;
+    if (state->other.max < elapsed)  state->other.max = elapsed ;
+
+    state->liveAfter = gc_occupancy (sc) ;	/* An upper bound. */
+
+    gcPlant (sc, state) ;
+
+    return (true) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gc_idle ()
+
+    Run an Idle-Time Garbage Collection If Warranted.
+
+
+Purpose:
+
+    The gc_idle() function is intended to be called when a program is idle.
+    It runs a garbage collection (see gc_collect()) if the fraction of the
+    cell heap in use has reached a threshold, so that the collection is run
+    now rather than when the heap runs out in the middle of a burst of work.
+
+    If the live cells left by the last collection were already above the
+    threshold, collecting again at the threshold would recover little, so
+    the threshold is raised to halfway between the live cells and a full
+    heap.  If a pause budget is given, the collection is skipped if the
+    pause, estimated from the last requested collection and scaled by the
+    growth of the heap since, would exceed the budget; TinyScheme's
+    collector can't be stopped partway through.
+
+
+    Invocation:
+
+        collected = gc_idle (sc, threshold, budget, &pause) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <threshold>	- I
+            is the fraction (0.0 .. 1.0) of the heap that must be in use
+            before a collection is run.
+        <budget>	- I
+            is the longest acceptable pause in seconds; zero or less if
+            there is no limit.
+        <pause>		- O
+            returns the length of the collection in seconds; zero if there
+            was no collection.  NULL can be specified if this value is not
+            needed.
+        <collected>	- O
+            returns true if a collection was run and false otherwise.
+
+*******************************************************************************/
+
+
+bool  gc_idle (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        double  threshold,
+        double  budget,
+        double  *pause)
+#    else
+        sc, threshold, budget, pause)
+
+        scheme  *sc ;
+        double  threshold ;
+        double  budget ;
+        double  *pause ;
+#    endif
+
+{    /* Local variables. */
+    double  estimate, occupancy ;
+    GcState  state ;
+
+
+
+    if (pause != NULL)  *pause = 0.0 ;
+
+    state = gcState (sc) ;
+    if (state == NULL)  return (false) ;
+
+    occupancy = gc_occupancy (sc) ;
+    if (state->liveAfter >= threshold)
+        threshold = (state->liveAfter + 1.0) / 2.0 ;
+    if (occupancy < threshold)  return (false) ;
+
+    if ((budget > 0.0) && (state->lastCells > 0)) {
+        estimate = state->lastPause * (double) GC_CELLS (sc)
+                                    / (double) state->lastCells ;
+        if (estimate > budget) {
+            LGI "(gc_idle) Estimated pause %.6f exceeds budget %.6f.\n",
+                estimate, budget) ;
+            return (false) ;
+        }
+    }
+
+    return (gc_collect (sc, pause) == 0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gc_occupancy ()
+
+    Get the Fraction of the Cell Heap in Use.
+
+
+Purpose:
+
+    The gc_occupancy() function returns the fraction of the interpreter's
+    cell heap that is in use, whether by live cells or by garbage not yet
+    collected.
+
+
+    Invocation:
+
+        occupancy = gc_occupancy (sc) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <occupancy>	- O
+            returns the fraction (0.0 .. 1.0) of the cell heap in use.
+
+*******************************************************************************/
+
+
+double  gc_occupancy (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{
+
+    return ((double) (GC_CELLS (sc) - sc->fcells) / (double) GC_CELLS (sc)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gc_pauses ()
+
+    Get Garbage Collection Statistics.
+
 
+Purpose:
 
-Public Procedures:
+    The gc_pauses() function returns the counts and pause times of the
+    collections run by gc_collect() and of the other collections detected
+    by gc_detect().
 
-    gc_protect() - protect a Scheme value from being collected as garbage.
-    gc_retrieve() - retrieve a protected Scheme value by ID.
-    gc_unprotect() - allow a Scheme value to be collected as garbage.
+
+    Invocation:
+
+        gc_pauses (sc, &requested, &other) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <requested>	- O
+            returns the statistics for the collections run by gc_collect().
+        <other>		- O
+            returns the statistics for the other collections.  The pauses
+            are upper bounds; see gc_detect().
 
 *******************************************************************************/
 
 
-#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+void  gc_pauses (
 
-#include  <stdio.h>			/* Standard I/O definitions. */
-#include  <stdlib.h>			/* Standard C Library definitions. */
-#include  <string.h>			/* C Library string functions. */
-#include  "plist_util.h"		/* TinyScheme property lists. */
-#include  "gc_util.h"			/* Garbage collection utilities. */
+#    if PROTOTYPES
+        scheme  *sc,
+        GcPauses  *requested,
+        GcPauses  *other)
+#    else
+        sc, requested, other)
 
+        scheme  *sc ;
+        GcPauses  *requested ;
+        GcPauses  *other ;
+#    endif
+
+{    /* Local variables. */
+    GcState  state ;
+
+
+
+    state = gcState (sc) ;
+    if (state == NULL) {
+        memset (requested, 0, sizeof (GcPauses)) ;
+        memset (other, 0, sizeof (GcPauses)) ;
+        return ;
+    }
+
+    *requested = state->requested ;
+    *other = state->other ;
+
+    return ;
+
+}
 
-int  gc_util_debug = 0 ;		/* Global debug switch (1/0 = yes/no). */
-#undef  I_DEFAULT_GUARD
-#define  I_DEFAULT_GUARD  gc_util_debug
-
 /*!*****************************************************************************
 
 Procedure:
@@ -84,7 +690,9 @@ Purpose:
             is the Scheme value to be protected.
         <id>		- O
             returns a unique numeric ID for the protected value.  The program
-            can later retrieve the value via its ID; see gc_retrieve().
+            can later retrieve the value via its ID; see gc_retrieve().  IDs
+            start at 1 and are reused after gc_unprotect(); zero is returned
+            in the event of an error.
 
 *******************************************************************************/
 
@@ -102,34 +710,138 @@ UniqueID  gc_protect (
 #    endif
 
 {    /* Local variables. */
-    pointer  alist ;
+    pointer  alist, binding ;
+    size_t  max ;
     UniqueID  id ;
+    void  *array ;
+
+
 
+/* If a previously released ID is available, reuse its binding. */
 
+    if (TS (sc, idNumFree) > 0) {
+        id = TS (sc, idFree)[--TS (sc, idNumFree)] ;
+        set_cdr (TS (sc, idBindings)[id-1], value) ;
+        LGI "(gc_protect)   ID: %ld  Value: %p\n", (long) id, (void *) value) ;
+        return (id) ;
+    }
+
+/* Otherwise, allocate a new ID, expanding the binding and free arrays
+   if necessary. */
+
+    if (TS (sc, idCount) >= TS (sc, idMax)) {
+        max = (TS (sc, idMax) == 0) ? 64 : (TS (sc, idMax) * 2) ;
+        array = realloc (TS (sc, idBindings), max * sizeof (pointer)) ;
+        if (array == NULL) {
+            LGE "(gc_protect) Error expanding ID bindings to %lu entries.\nrealloc: ",
+                (unsigned long) max) ;
+            return (0) ;
+        }
+        TS (sc, idBindings) = (pointer *) array ;
+        array = realloc (TS (sc, idFree), max * sizeof (UniqueID)) ;
+        if (array == NULL) {
+            LGE "(gc_protect) Error expanding ID free stack to %lu entries.\nrealloc: ",
+                (unsigned long) max) ;
+            return (0) ;
+        }
+        TS (sc, idFree) = (UniqueID *) array ;
+        TS (sc, idMax) = max ;
+    }
 
-/* Get the value of the TSION ID map. */
+/* Get the value of the TSION ID map.  The map's symbol and property cells
+   are looked up once and cached, so that they needn't be looked up by name
+   on every call. */
+
+    if (TS (sc, idMapSymbol) == NULL) {
+        TS (sc, idMapSymbol) = plistSymbol (sc, "*tsion-id-map*") ;
+        TS (sc, idMapProperty) = plistSymbol (sc, "alist") ;
+        if ((TS (sc, idMapSymbol) == NULL) ||
+            (TS (sc, idMapProperty) == NULL)) {
+            LGE "(gc_protect) Error looking up symbol *tsion-id-map*.\nplistSymbol: ") ;
+            TS (sc, idMapSymbol) = NULL ;
+            return (0) ;
+        }
+    }
 
-    alist = plistGet (sc, "*tsion-id-map*", "alist") ;
+    alist = plistGetSym (sc, TS (sc, idMapSymbol), TS (sc, idMapProperty)) ;
     if (alist == NULL) {
-        LGE "(gc_protect) Symbol *tsion-id-map*, property alist not found.\nplistGet: ") ;
+        LGE "(gc_protect) Symbol *tsion-id-map*, property alist not found.\nplistGetSym: ") ;
         return (0) ;
     }
 
-/* Prepend the new ID-to-value mapping. */
+/* Prepend the new ID-to-value mapping and remember where its binding is. */
 
-    id = TS (sc, idCounter++) ;
-    alist = acons (sc, mk_integer (sc, id), value, alist) ;
+    id = (UniqueID) ++TS (sc, idCount) ;
+    binding = cons (sc, mk_integer (sc, id), value) ;
+    TS (sc, idBindings)[id-1] = binding ;
+    alist = cons (sc, binding, alist) ;
 
 /* Assign the new associative list to its variable. */
 
-    plistPut (sc, "*tsion-id-map*", "alist", alist) ;
+    plistPutSym (sc, TS (sc, idMapSymbol), TS (sc, idMapProperty), alist) ;
 
     LGI "(gc_protect)   ID: %ld  Value: %p\n", (long) id, (void *) value) ;
 
     return (id) ;
 
 }
-
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gc_release ()
+
+    Free an Interpreter's GC_UTIL Storage.
+
+
+Purpose:
+
+    The gc_release() function frees the ID binding array, the stack of
+    released IDs, and the collection statistics of an interpreter that is
+    being destroyed.  The bindings themselves are cells in the interpreter's
+    heap and are reclaimed by scheme_deinit().  Any IDs still outstanding
+    are invalid afterwards.
+
+
+    Invocation:
+
+        gc_release (sc) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+void  gc_release (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{
+
+    if (TS (sc, idBindings) != NULL)  free (TS (sc, idBindings)) ;
+    TS (sc, idBindings) = NULL ;
+    if (TS (sc, idFree) != NULL)  free (TS (sc, idFree)) ;
+    TS (sc, idFree) = NULL ;
+    TS (sc, idCount) = TS (sc, idMax) = TS (sc, idNumFree) = 0 ;
+    TS (sc, idMapSymbol) = TS (sc, idMapProperty) = NULL ;
+
+    if (TS (sc, gcState) != NULL)  free (TS (sc, gcState)) ;
+    TS (sc, gcState) = NULL ;
+
+    return ;
+
+}
+
 /*!*****************************************************************************
 
 Procedure:
@@ -157,7 +869,8 @@ Purpose:
             is the unique numeric ID assigned to the protected value by
             gc_protect().
         <value>		- O
-            returns the Scheme value bound to the ID.
+            returns the Scheme value bound to the ID; NULL is returned if
+            the ID is invalid or has been released.
 
 *******************************************************************************/
 
@@ -175,26 +888,14 @@ pointer  gc_retrieve (
 #    endif
 
 {    /* Local variables. */
-    pointer  alist, binding, current, value ;
-
-
+    pointer  value ;
 
-/* Get the value of the TSION ID map. */
-
-    alist = plistGet (sc, "*tsion-id-map*", "alist") ;
-    if (alist == NULL) {
-        LGE "(gc_retrieve) Symbol *tsion-id-map*, property alist not found.\nplistGet: ") ;
-        return (NULL) ;
-    }
 
-/* Traverse the list, looking for the element with the target ID. */
 
-    for (current = alist ;  current != sc->NIL ;  current = cdr (current)) {
-        binding = car (current) ;
-        if (ivalue (car (binding)) == (long) id)  break ;
-    }
+/* Look up the binding for the target ID. */
 
-    if (current == sc->NIL) {
+    if ((id < 1) || ((size_t) id > TS (sc, idCount)) ||
+        GC_RELEASED (TS (sc, idBindings)[id-1])) {
         SET_ERRNO (EINVAL) ;
         LGE "(gc_retrieve) ID %ld not found: ", (long) id) ;
         return (NULL) ;
@@ -202,14 +903,128 @@ pointer  gc_retrieve (
 
 /* Return the value to the caller. */
 
-    value = cdar (current) ;
+    value = cdr (TS (sc, idBindings)[id-1]) ;
 
     LGI "(gc_retrieve)  ID: %ld  Value: %p\n", (long) id, (void *) value) ;
 
     return (value) ;
 
 }
-
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gc_stats ()
+
+    Get Heap Statistics.
+
+
+Purpose:
+
+    The gc_stats() function returns the size and occupancy of the
+    interpreter's cell heap, along with the total number of collections
+    and the total time spent in them.  Any collection run since the last
+    check is counted first (see gc_detect()).  The total time includes the
+    upper-bound pauses of the collections that weren't run by gc_collect()
+    (see gc_pauses()).
+
+
+    Invocation:
+
+        gc_stats (sc, &stats) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <stats>		- O
+            returns the heap statistics.
+
+*******************************************************************************/
+
+
+void  gc_stats (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        GcStats  *stats)
+#    else
+        sc, stats)
+
+        scheme  *sc ;
+        GcStats  *stats ;
+#    endif
+
+{    /* Local variables. */
+    GcPauses  other, requested ;
+
+
+
+    gc_detect (sc, 0.0) ;
+    gc_pauses (sc, &requested, &other) ;
+
+    stats->cells = GC_CELLS (sc) ;
+    stats->freeCells = sc->fcells ;
+    stats->usedCells = stats->cells - stats->freeCells ;
+    stats->segments = sc->last_cell_seg + 1 ;
+    stats->maxSegments = CELL_NSEGMENT ;
+    stats->collections = requested.count + other.count ;
+    stats->gcTime = requested.total + other.total ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gc_type_name ()
+
+    Get the Name of a Cell Type.
+
+
+Purpose:
+
+    The gc_type_name() function returns the name of a cell type, for
+    labeling the counts returned by gc_census().
+
+
+    Invocation:
+
+        name = gc_type_name (type) ;
+
+    where
+
+        <type>		- I
+            is the cell type, T_STRING through T_BYTEVECTOR.
+        <name>		- O
+            returns the type's name, e.g., "pair".  The name of type zero
+            or of an out-of-range type is "unknown".  The string is static
+            and should not be modified or freed.
+
+*******************************************************************************/
+
+
+const  char  *gc_type_name (
+
+#    if PROTOTYPES
+        int  type)
+#    else
+        type)
+
+        int  type ;
+#    endif
+
+{
+
+    if ((type < 0) || (type >= GC_NUM_TYPES))  type = 0 ;
+
+    return (gcTypeNames[type]) ;
+
+}
+
 /*!*****************************************************************************
 
 Procedure:
@@ -223,7 +1038,9 @@ Purpose:
 
     The gc_unprotect() function removes a previously protected Scheme value
     from the TSION ID map, thus making the value eligible for garbage
-    collection.
+    collection.  The ID may be reused by a later gc_protect(); releasing an
+    ID that is not in use (e.g., releasing an ID twice) is an error that is
+    logged and otherwise ignored.
 
 
     Invocation:
@@ -254,44 +1071,139 @@ void  gc_unprotect (
 #    endif
 
 {    /* Local variables. */
-    pointer  alist, binding, current, previous ;
+    pointer  binding ;
 
 
 
-/* Get the value of the TSION ID map. */
+/* Look up the binding for the target ID. */
 
-    alist = plistGet (sc, "*tsion-id-map*", "alist") ;
-    if (alist == NULL) {
-        LGE "(gc_unprotect) Symbol *tsion-id-map*, property alist not found.\nplistGet: ") ;
+    if ((id < 1) || ((size_t) id > TS (sc, idCount)) ||
+        GC_RELEASED (TS (sc, idBindings)[id-1])) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(gc_unprotect) ID %ld not found: ", (long) id) ;
         return ;
     }
 
-/* Traverse the list, looking for the element with the target ID. */
+/* Release the value, mark the binding released, and push the ID on the
+   free stack for reuse. */
 
-    previous = NULL ;  current = alist ;
+    binding = TS (sc, idBindings)[id-1] ;
 
-    while (current != sc->NIL) {
-        binding = car (current) ;
-        if (ivalue (car (binding)) == (long) id)  break ;
-        previous = current ;  current = cdr (current) ;
-    }
+    LGI "(gc_unprotect) ID: %ld  Value: %p\n",
+        (long) id, (void *) cdr (binding)) ;
 
-    if (current == sc->NIL) {
-        SET_ERRNO (EINVAL) ;
-        LGE "(gc_unprotect) ID %ld not found: ", (long) id) ;
-        return ;
-    }
+    set_cdr (binding, binding) ;
+    TS (sc, idFree)[TS (sc, idNumFree)++] = id ;
 
-    if (previous == NULL) {
-        alist = cdr (current) ;
-        plistPut (sc, "*tsion-id-map*", "alist", alist) ;
-    } else {
-        set_cdr (previous, cdr (current)) ;
-    }
+    return ;
 
-    LGI "(gc_unprotect) ID: %ld  Value: %p\n",
-        (long) id, (void *) cdar (current)) ;
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gcPlant ()
+
+    Plant a Canary for Detecting Garbage Collections.
+
+
+Purpose:
+
+    Function gcPlant() allocates a new, unreferenced canary cell (see
+    gc_detect()) with a new tag.
+
+
+    Invocation:
+
+        gcPlant (sc, state) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <state>		- I
+            is the interpreter's GC_UTIL state.
+
+*******************************************************************************/
+
+
+static  void  gcPlant (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        GcState  state)
+#    else
+        sc, state)
+
+        scheme  *sc ;
+        GcState  state ;
+#    endif
+
+{
+
+    state->tag = GC_CANARY_BASE + ((state->tag + 1) & 0xFFFFF) ;
+    state->canary = mk_character (sc, (int) state->tag) ;
 
     return ;
 
 }
+
+/*!*****************************************************************************
+
+Procedure:
+
+    gcState ()
+
+    Get an Interpreter's GC_UTIL State.
+
+
+Purpose:
+
+    Function gcState() returns an interpreter's collection statistics and
+    canary, creating them if they don't exist yet.
+
+
+    Invocation:
+
+        state = gcState (sc) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <state>		- O
+            returns the interpreter's GC_UTIL state; NULL is returned in the
+            event of an error.
+
+*******************************************************************************/
+
+
+static  GcState  gcState (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{    /* Local variables. */
+    GcState  state ;
+
+
+
+    if (TS (sc, gcState) != NULL)  return (TS (sc, gcState)) ;
+
+    state = (GcState) calloc (1, sizeof (_GcState)) ;
+    if (state == NULL) {
+        LGE "(gcState) Error allocating GC state.\ncalloc: ") ;
+        return (NULL) ;
+    }
+
+    TS (sc, gcState) = state ;
+
+    return (state) ;
+
+}
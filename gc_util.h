@@ -19,6 +19,46 @@ extern  "C"  {
 #include  "tsion.h"			/* TinyScheme I/O Network functions. */
 
 
+/*******************************************************************************
+    Collection Statistics - collections are counted in two classes: those
+        run by gc_collect() (e.g., for the dispatcher's idle-time collector)
+        and all others (mostly those triggered when the cell heap runs out,
+        but also explicit calls to GC from Scheme code).
+*******************************************************************************/
+
+typedef  struct  GcPauses {
+    long  count ;			/* # of collections. */
+    double  total ;			/* Cumulative pause in seconds. */
+    double  max ;			/* Longest pause in seconds. */
+}  GcPauses ;
+
+
+/*******************************************************************************
+    Heap Statistics - the size of the cell heap and a census of its cells by
+        type.  The census counts every occupied cell, so, unless it is taken
+        right after a collection, it includes garbage not yet collected.
+*******************************************************************************/
+
+typedef  struct  GcStats {
+    long  cells ;			/* Total # of cells in the heap. */
+    long  usedCells ;			/* Live cells + uncollected garbage. */
+    long  freeCells ;			/* Cells on the free list. */
+    int  segments ;			/* # of cell segments allocated. */
+    int  maxSegments ;			/* Maximum # of cell segments. */
+    long  collections ;			/* # of collections (all classes). */
+    double  gcTime ;			/* Cumulative collection time (secs). */
+}  GcStats ;
+
+					/* Cell types, T_STRING .. T_BYTEVECTOR. */
+#define  GC_NUM_TYPES  (T_BYTEVECTOR + 1)
+
+typedef  struct  GcCensus {
+    long  count[GC_NUM_TYPES] ;		/* # of cells by type (0 = unknown). */
+    size_t  stringBytes ;		/* Bytes of string storage. */
+    long  vectorCells ;			/* Cells holding vector elements. */
+}  GcCensus ;
+
+
 /*******************************************************************************
     Miscellaneous declarations.
 *******************************************************************************/
@@ -31,14 +71,53 @@ extern  int  gc_util_debug  OCD ("gc_util") ;
     Public functions.
 *******************************************************************************/
 
+extern  void  gc_census P_((scheme *sc,
+                            GcCensus *census))
+    OCD ("gc_util") ;
+
+extern  errno_t  gc_collect P_((scheme *sc,
+                                double *pause))
+    OCD ("gc_util") ;
+
+extern  long  gc_collections P_((scheme *sc))
+    OCD ("gc_util") ;
+
+extern  bool  gc_detect P_((scheme *sc,
+                            double elapsed))
+    OCD ("gc_util") ;
+
+extern  bool  gc_idle P_((scheme *sc,
+                          double threshold,
+                          double budget,
+                          double *pause))
+    OCD ("gc_util") ;
+
+extern  double  gc_occupancy P_((scheme *sc))
+    OCD ("gc_util") ;
+
+extern  void  gc_pauses P_((scheme *sc,
+                            GcPauses *requested,
+                            GcPauses *other))
+    OCD ("gc_util") ;
+
 extern  UniqueID  gc_protect P_((scheme *sc,
                                  pointer value))
     OCD ("gc_util") ;
 
+extern  void  gc_release P_((scheme *sc))
+    OCD ("gc_util") ;
+
 extern  pointer  gc_retrieve P_((scheme *sc,
                                  UniqueID id))
     OCD ("gc_util") ;
 
+extern  void  gc_stats P_((scheme *sc,
+                           GcStats *stats))
+    OCD ("gc_util") ;
+
+extern  const  char  *gc_type_name P_((int type))
+    OCD ("gc_util") ;
+
 extern  void  gc_unprotect P_((scheme *sc,
                                UniqueID id))
     OCD ("gc_util") ;
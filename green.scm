@@ -0,0 +1,168 @@
+; $Id$
+;*******************************************************************************
+;
+;    GREEN - is a library of green threads (coroutines) scheduled by an I/O
+;        event dispatcher, so that network code can be written in a straight
+;        line instead of as a chain of callbacks.
+;
+;        (spawn thunk) starts a coroutine that calls THUNK.  Within a
+;        coroutine, (wait-readable fd) and (wait-writable fd) park the
+;        coroutine until the file descriptor is ready, (sleep seconds)
+;        parks it for a time, and (yield) lets the other coroutines run.
+;        Everything else - computation and non-blocking I/O - runs as
+;        usual.  A coroutine ends when its thunk returns or signals an
+;        error.  (green-run) runs the dispatcher until all the coroutines
+;        have ended.
+;
+;            (load "green.scm")
+;            (green-init (iox-create))
+;            (spawn (lambda ()
+;                (let loop ()
+;                    (wait-readable (tcp-fd client))
+;                    (let ((buffer (tcp-read client -1024)))
+;                        (if buffer
+;                            (begin (tcp-write client buffer) (loop))
+;                            (tcp-destroy client))))))
+;            (green-run)
+;
+;        Coroutines are built on continuations.  A coroutine parks by
+;        capturing its continuation, registering a dispatcher callback that
+;        will invoke the continuation, and escaping back to the callback
+;        that resumed it.  Thus, a coroutine only ever runs inside a
+;        dispatcher callback, and a parked coroutine costs a continuation
+;        and one registered callback; thousands of clients can be served
+;        by one dispatcher.  New and yielding coroutines are run through
+;        the dispatcher's mailbox (see IOX-POST) rather than by timers, so
+;        they run in the dispatcher's next iteration instead of waiting
+;        for the next tick of the timing wheel.
+;
+;        Coroutines are cooperative: a coroutine that loops without parking,
+;        or that calls a blocking function (e.g., LFN-GETLINE on a socket
+;        without input), stalls all the others.  See IOX-WATCHDOG for finding
+;        such stalls.  The parking functions may only be called from within
+;        a coroutine.
+;
+;*******************************************************************************
+
+
+(define green-dispatcher #f)		; Dispatcher scheduling the coroutines.
+(define green-return #f)		; Escape from the running coroutine.
+(define green-count 0)			; Number of live coroutines.
+(define green-slice 0.05)		; Longest wait between checks of count.
+
+
+;*******************************************************************************
+;    green-init - sets the dispatcher that schedules the coroutines.
+;    green-run - monitors the dispatcher until all the coroutines have ended
+;        or until an optional timeout (in seconds) expires.  #t is returned
+;        if the coroutines have all ended and #f otherwise.  The mailbox
+;        always gives the dispatcher something to monitor, so the dispatcher
+;        is run in slices of GREEN-SLICE seconds, between which the count of
+;        live coroutines is checked.
+;*******************************************************************************
+
+(define (green-init dispatcher)
+    (set! green-dispatcher dispatcher)
+    dispatcher)
+
+(define (green-run . timeout)
+    (let loop ((remaining (if (null? timeout) -1 (car timeout))))
+        (green-reap)
+        (cond ((<= green-count 0) #t)
+              ((and (>= remaining 0) (<= remaining green-slice))
+                  (iox-monitor green-dispatcher remaining -1)
+                  (green-reap)
+                  (<= green-count 0))
+              ((iox-monitor green-dispatcher green-slice -1)
+                  (loop (if (< remaining 0) remaining (- remaining green-slice))))
+              (else #f))))
+
+
+;*******************************************************************************
+;    Coroutine control.  GREEN-START and GREEN-RESUME run a coroutine from a
+;        dispatcher callback, saving the callback's continuation in
+;        GREEN-RETURN.  GREEN-PARK captures the coroutine's continuation,
+;        hands it to a function that registers a callback to resume it, and
+;        escapes through GREEN-RETURN.  When a coroutine's thunk returns, the
+;        coroutine escapes through the GREEN-RETURN of whichever callback
+;        resumed it last, not the one that started it.
+;
+;        A coroutine that signals an error never escapes, so the callback
+;        that ran it never resets GREEN-RETURN.  GREEN-REAP, called before a
+;        coroutine is started or resumed and by GREEN-RUN, finds the stale
+;        escape, discards it, and counts the coroutine as ended.
+;*******************************************************************************
+
+(define (green-reap)
+    (if green-return
+        (begin
+            (set! green-return #f)
+            (set! green-count (- green-count 1)))))
+
+(define (green-start thunk)
+    (green-reap)
+    (call/cc
+        (lambda (return)
+            (set! green-return return)
+            (thunk)
+            (set! green-count (- green-count 1))
+            (green-return #f)))
+    (set! green-return #f))
+
+(define (green-resume k value)
+    (green-reap)
+    (call/cc
+        (lambda (return)
+            (set! green-return return)
+            (k value)))
+    (set! green-return #f))
+
+(define (green-park register)
+    (if (not green-return)
+        (error "green: not called from within a coroutine"))
+    (call/cc
+        (lambda (k)
+            (register k)
+            (green-return #f))))
+
+
+;*******************************************************************************
+;    Dispatcher callbacks that resume parked coroutines.
+;*******************************************************************************
+
+(define (green-io-ready callback reason k)
+    (iox-cancel callback)
+    (green-resume k reason))
+
+(define (green-timer callback reason k)
+    (green-resume k #t))
+
+(define (green-posted k)
+    (green-resume k #t))
+
+
+;*******************************************************************************
+;    Public functions.
+;*******************************************************************************
+
+(define (spawn thunk)
+    (if (not green-dispatcher)
+        (green-init (iox-create)))
+    (set! green-count (+ green-count 1))
+    (iox-post green-dispatcher green-start thunk))
+
+(define (wait-readable fd)
+    (green-park
+        (lambda (k) (iox-onio green-dispatcher green-io-ready k IOX_READ fd))))
+
+(define (wait-writable fd)
+    (green-park
+        (lambda (k) (iox-onio green-dispatcher green-io-ready k IOX_WRITE fd))))
+
+(define (sleep seconds)
+    (green-park
+        (lambda (k) (iox-after green-dispatcher green-timer k seconds))))
+
+(define (yield)
+    (green-park
+        (lambda (k) (iox-post green-dispatcher green-posted k))))
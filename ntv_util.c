@@ -0,0 +1,1101 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    ntv_util.c
+
+    Native Stream Handler Utilities.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The NTV_UTIL package provides built-in C handlers for fixed-function
+    data paths on TCP/IP connections monitored by an I/O event dispatcher.
+    A Scheme program sets up the connections and attaches a handler; from
+    then on the data moves entirely in C, through a preallocated buffer,
+    without Scheme strings or Scheme calls, until the connection closes or
+    an error occurs.  The kinds of handlers are:
+
+        NtvDiscard - reads and drops the input from the source.
+
+        NtvEcho - writes the input from the source back to the source.
+
+        NtvRelay - writes the input from the source to a sink endpoint.
+
+        NtvLines - splits the input from the source into lines and queues
+            them; the application takes the lines off the queue with
+            ntvNextLine() whenever it likes (e.g., from a timer).
+
+    Writes never block the dispatcher.  If the sink can't take all of a
+    chunk of input, the remainder is kept in the buffer, the handler stops
+    reading the source, and the rest is written when the sink becomes
+    writeable; so a slow sink slows down the source rather than filling
+    memory.  Likewise, an NtvLines handler stops reading when NTV_MAX_QUEUE
+    bytes are waiting to be taken off its queue.
+
+        #include  "ntv_util.h"			-- Native stream handlers.
+        NtvHandler  handler ;
+        ...
+        handler = ntvAttach (dispatcher, NtvRelay, client, server,
+                             myCloseFunc, myData) ;
+        ...
+        ioxMonitor (dispatcher, -1.0) ;	-- Data flows client to server.
+
+    When the source closes its connection or an I/O error occurs, the
+    handler's close function is called with reason NTV_CLOSE and the error
+    (zero if the source closed), then with reason IoxCancel, after which
+    the handler is released.  ntvCancel() stops a handler early, calling
+    the close function with reason IoxCancel only.  The endpoints belong
+    to the application, which should destroy them after the handler has
+    stopped.
+
+
+Public Procedures:
+
+    ntvAttach() - attaches a native handler to an endpoint.
+    ntvBytes() - returns the number of bytes a handler has read.
+    ntvCancel() - stops a handler.
+    ntvNextLine() - takes the next line off a handler's queue.
+    ntvSink() - returns a handler's sink endpoint.
+    ntvSource() - returns a handler's source endpoint.
+
+Private Procedures:
+
+    ntvCheck() - frees a handler if it is finished.
+    ntvClose() - stops a handler after an I/O error or end-of-file.
+    ntvFlush() - writes buffered input to the sink.
+    ntvOrphan() - handles the destruction of a handler's dispatcher.
+    ntvReadCB() - reads input from the source.
+    ntvWatch() - selects the I/O event a handler waits for.
+    ntvWriteCB() - resumes writing to the sink.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <string.h>			/* C Library string functions. */
+#include  "sox_util.h"			/* Scheme dispatcher utilities. */
+#include  "ntv_util.h"			/* Native stream handlers. */
+
+
+int  ntv_util_debug = 0 ;		/* Global debug switch (1/0 = yes/no). */
+#undef  I_DEFAULT_GUARD
+#define  I_DEFAULT_GUARD  ntv_util_debug
+
+
+/*******************************************************************************
+    Native Handler (Internal View) and Definitions.
+*******************************************************************************/
+
+typedef  struct  _NtvHandler {
+    IoxDispatcher  dispatcher ;		/* Dispatcher monitoring endpoints. */
+    NtvKind  kind ;			/* Kind of handler. */
+    TcpEndpoint  source ;		/* Endpoint read from ... */
+    TcpEndpoint  sink ;			/* ... and written to, if any. */
+    IoxCallback  cbRead ;		/* IOX callback for the source ... */
+    IoxCallback  cbWrite ;		/* ... or for the sink. */
+    char  *buffer ;			/* Input buffer ... */
+    size_t  size ;			/* ... its size ... */
+    size_t  start ;			/* ... and the data not yet written */
+    size_t  length ;			/* or taken off the queue. */
+    unsigned  long  bytes ;		/* Number of bytes read. */
+    bool  closed ;			/* Has the handler stopped? */
+    bool  reported ;			/* Has close function seen IoxCancel? */
+    int  busy ;				/* Number of active close calls. */
+    NtvCloseFunc  closeF ;		/* Function to call on close. */
+    void  *userData ;			/* Arbitrary data passed to closeF. */
+}  _NtvHandler ;
+
+
+/*******************************************************************************
+    Private functions.
+*******************************************************************************/
+
+static  void  ntvCheck P_((NtvHandler handler)) ;
+
+static  void  ntvClose P_((NtvHandler handler,
+                           errno_t error)) ;
+
+static  void  ntvFlush P_((NtvHandler handler)) ;
+
+static  void  ntvOrphan P_((NtvHandler handler,
+                            IoxCallback *callback)) ;
+
+static  errno_t  ntvReadCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+static  errno_t  ntvWatch P_((NtvHandler handler,
+                              IoxReason mode)) ;
+
+static  errno_t  ntvWriteCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvAttach ()
+
+    Attach a Native Handler to an Endpoint.
+
+
+Purpose:
+
+    Function ntvAttach() attaches a native handler to a TCP/IP data
+    connection.  The handler begins reading the source when the dispatcher
+    is next monitored.
+
+
+    Invocation:
+
+        handler = ntvAttach (dispatcher, kind, source, sink,
+                             closeF, userData) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher that will monitor the endpoints.
+        <kind>		- I
+            is the kind of handler: NtvDiscard, NtvEcho, NtvLines, or
+            NtvRelay.
+        <source>	- I
+            is the endpoint from which input is read.
+        <sink>		- I
+            is the endpoint to which an NtvRelay handler writes the input;
+            it is ignored for the other kinds of handlers.
+        <closeF>	- I
+            is the function to call when the handler stops.
+        <userData>	- I
+            is an arbitrary value passed to the close function.
+        <handler>	- O
+            returns a handle for the handler; NULL is returned in the event
+            of an error.
+
+*******************************************************************************/
+
+
+NtvHandler  ntvAttach (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        NtvKind  kind,
+        TcpEndpoint  source,
+        TcpEndpoint  sink,
+        NtvCloseFunc  closeF,
+        void  *userData)
+#    else
+        dispatcher, kind, source, sink, closeF, userData)
+
+        IoxDispatcher  dispatcher ;
+        NtvKind  kind ;
+        TcpEndpoint  source ;
+        TcpEndpoint  sink ;
+        NtvCloseFunc  closeF ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    NtvHandler  handler ;
+
+
+
+    if ((dispatcher == NULL) || (source == NULL) || (closeF == NULL) ||
+        ((kind == NtvRelay) && (sink == NULL))) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(ntvAttach) NULL dispatcher, endpoint, or close function: ") ;
+        return (NULL) ;
+    }
+
+    handler = (NtvHandler) calloc (1, sizeof (_NtvHandler)) ;
+    if (handler == NULL) {
+        LGE "(ntvAttach) Error allocating handler for %s.\ncalloc: ",
+            tcpName (source)) ;
+        return (NULL) ;
+    }
+
+    handler->dispatcher = dispatcher ;
+    handler->kind = kind ;
+    handler->source = source ;
+    if (kind == NtvRelay)
+        handler->sink = sink ;
+    else if (kind == NtvEcho)
+        handler->sink = source ;
+    else
+        handler->sink = NULL ;
+    handler->closeF = closeF ;
+    handler->userData = userData ;
+
+/* Allocate the buffer.  An NtvLines handler's buffer holds its queue and
+   grows, as needed, up to NTV_MAX_QUEUE bytes. */
+
+    handler->size = NTV_CHUNK ;
+    handler->buffer = malloc (handler->size) ;
+    if (handler->buffer == NULL) {
+        LGE "(ntvAttach) Error allocating %lu-byte buffer for %s.\nmalloc: ",
+            (unsigned long) handler->size, tcpName (source)) ;
+        PUSH_ERRNO ;  free (handler) ;  POP_ERRNO ;
+        return (NULL) ;
+    }
+
+    if (ntvWatch (handler, IoxRead)) {
+        LGE "(ntvAttach) Error registering %s.\nntvWatch: ",
+            tcpName (source)) ;
+        PUSH_ERRNO ;  free (handler->buffer) ;  free (handler) ;  POP_ERRNO ;
+        return (NULL) ;
+    }
+
+    LGI "(ntvAttach) Handler %p (kind %d) attached to %s.\n",
+        (void *) handler, (int) kind, tcpName (source)) ;
+
+    return (handler) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvBytes ()
+
+    Get the Number of Bytes a Handler Has Read.
+
+
+Purpose:
+
+    Function ntvBytes() returns the number of bytes a handler has read from
+    its source.
+
+
+    Invocation:
+
+        count = ntvBytes (handler) ;
+
+    where
+
+        <handler>	- I
+            is the handler handle returned by ntvAttach().
+        <count>		- O
+            returns the number of bytes read; zero is returned for a NULL
+            handle.
+
+*******************************************************************************/
+
+
+unsigned  long  ntvBytes (
+
+#    if PROTOTYPES
+        NtvHandler  handler)
+#    else
+        handler)
+
+        NtvHandler  handler ;
+#    endif
+
+{
+
+    return ((handler == NULL) ? 0 : handler->bytes) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvCancel ()
+
+    Stop a Handler.
+
+
+Purpose:
+
+    Function ntvCancel() stops a handler, discarding any input not yet
+    written or taken off the queue, and calls the handler's close function
+    with reason IoxCancel; the close function is not called again.  The
+    endpoints are left open.
+
+
+    Invocation:
+
+        status = ntvCancel (handler) ;
+
+    where
+
+        <handler>	- I
+            is the handler handle returned by ntvAttach().
+        <status>	- O
+            returns the status of canceling the handler, zero if there were
+            no errors and ERRNO otherwise.  Canceling a handler whose close
+            function has already seen IoxCancel has no effect.
+
+*******************************************************************************/
+
+
+errno_t  ntvCancel (
+
+#    if PROTOTYPES
+        NtvHandler  handler)
+#    else
+        handler)
+
+        NtvHandler  handler ;
+#    endif
+
+{
+
+    if (handler == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(ntvCancel) NULL handler handle: ") ;
+        return (errno) ;
+    }
+
+    if (handler->reported)  return (0) ;
+
+    LGI "(ntvCancel) Handler %p.\n", (void *) handler) ;
+
+    handler->closed = true ;
+    ntvWatch (handler, 0) ;
+
+    handler->reported = true ;
+    handler->busy++ ;
+    handler->closeF (handler, IoxCancel, 0, handler->userData) ;
+    handler->busy-- ;
+
+    ntvCheck (handler) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvNextLine ()
+
+    Take the Next Line off a Handler's Queue.
+
+
+Purpose:
+
+    Function ntvNextLine() takes the next complete line off an NtvLines
+    handler's queue.  The line terminator (LF or CR/LF) is stripped.  After
+    the handler has stopped, an unterminated last line is returned as is;
+    so is a full queue without a line terminator.  The line is returned in
+    place, so it remains valid only until control returns to the
+    dispatcher.
+
+
+    Invocation:
+
+        line = ntvNextLine (handler, &length) ;
+
+    where
+
+        <handler>	- I
+            is the handler handle returned by ntvAttach().
+        <length>	- O
+            returns the length of the line.
+        <line>		- O
+            returns a pointer to the (not NUL-terminated) line; NULL is
+            returned if no complete line is queued.
+
+*******************************************************************************/
+
+
+const  char  *ntvNextLine (
+
+#    if PROTOTYPES
+        NtvHandler  handler,
+        size_t  *length)
+#    else
+        handler, length)
+
+        NtvHandler  handler ;
+        size_t  *length ;
+#    endif
+
+{    /* Local variables. */
+    char  *line, *nl ;
+    size_t  taken ;
+
+
+
+    *length = 0 ;
+    if ((handler == NULL) || (handler->kind != NtvLines) ||
+        (handler->length == 0))
+        return (NULL) ;
+
+    line = handler->buffer + handler->start ;
+    nl = memchr (line, '\n', handler->length) ;
+
+    if (nl != NULL) {
+        taken = (size_t) (nl - line) + 1 ;
+        *length = taken - 1 ;
+        if ((*length > 0) && (line[*length - 1] == '\r'))  (*length)-- ;
+    } else if (handler->closed ||
+               (handler->length >= NTV_MAX_QUEUE)) {
+        taken = handler->length ;
+        *length = taken ;
+    } else {
+        return (NULL) ;
+    }
+
+    handler->start += taken ;
+    handler->length -= taken ;
+
+/* Resume reading if the handler stopped because the queue was full. */
+
+    if (!handler->closed && (handler->cbRead == NULL) &&
+        (handler->length < NTV_MAX_QUEUE)) {
+        if (ntvWatch (handler, IoxRead)) {
+            LGE "(ntvNextLine) Error resuming %s.\nntvWatch: ",
+                tcpName (handler->source)) ;
+        }
+    }
+
+    return (line) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvSink ()
+
+    Get a Handler's Sink Endpoint.
+
+
+Purpose:
+
+    Function ntvSink() returns the endpoint to which a handler writes its
+    input.
+
+
+    Invocation:
+
+        sink = ntvSink (handler) ;
+
+    where
+
+        <handler>	- I
+            is the handler handle returned by ntvAttach().
+        <sink>		- O
+            returns the sink endpoint (the source itself for an NtvEcho
+            handler); NULL is returned for handlers that write nothing.
+
+*******************************************************************************/
+
+
+TcpEndpoint  ntvSink (
+
+#    if PROTOTYPES
+        NtvHandler  handler)
+#    else
+        handler)
+
+        NtvHandler  handler ;
+#    endif
+
+{
+
+    return ((handler == NULL) ? NULL : handler->sink) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvSource ()
+
+    Get a Handler's Source Endpoint.
+
+
+Purpose:
+
+    Function ntvSource() returns the endpoint from which a handler reads
+    its input.
+
+
+    Invocation:
+
+        source = ntvSource (handler) ;
+
+    where
+
+        <handler>	- I
+            is the handler handle returned by ntvAttach().
+        <source>	- O
+            returns the source endpoint; NULL is returned for a NULL handle.
+
+*******************************************************************************/
+
+
+TcpEndpoint  ntvSource (
+
+#    if PROTOTYPES
+        NtvHandler  handler)
+#    else
+        handler)
+
+        NtvHandler  handler ;
+#    endif
+
+{
+
+    return ((handler == NULL) ? NULL : handler->source) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvCheck ()
+
+    Free a Handler If It Is Finished.
+
+
+Purpose:
+
+    Function ntvCheck() frees a handler once its close function has seen
+    IoxCancel - unless a close function call is still in progress, in which
+    case the caller of the close function calls ntvCheck() again afterwards.
+
+
+    Invocation:
+
+        ntvCheck (handler) ;
+
+    where:
+
+        <handler>	- I
+            is the handler.
+
+*******************************************************************************/
+
+
+static  void  ntvCheck (
+
+#    if PROTOTYPES
+        NtvHandler  handler)
+#    else
+        handler)
+
+        NtvHandler  handler ;
+#    endif
+
+{
+
+    if (!handler->reported || (handler->busy > 0))  return ;
+
+    LGI "(ntvCheck) Handler %p freed after %lu bytes.\n",
+        (void *) handler, handler->bytes) ;
+
+    ntvWatch (handler, 0) ;
+    free (handler->buffer) ;
+    free (handler) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvClose ()
+
+    Stop a Handler After an I/O Error or End-of-File.
+
+
+Purpose:
+
+    Function ntvClose() stops a handler and calls its close function with
+    reason NTV_CLOSE and then, unless the close function canceled the
+    handler itself, with reason IoxCancel.  The handler may be freed before
+    ntvClose() returns.
+
+
+    Invocation:
+
+        ntvClose (handler, error) ;
+
+    where:
+
+        <handler>	- I
+            is the handler.
+        <error>		- I
+            is the error that stopped the handler; zero if the source closed
+            its connection.
+
+*******************************************************************************/
+
+
+static  void  ntvClose (
+
+#    if PROTOTYPES
+        NtvHandler  handler,
+        errno_t  error)
+#    else
+        handler, error)
+
+        NtvHandler  handler ;
+        errno_t  error ;
+#    endif
+
+{
+
+    if (handler->closed)  return ;
+
+    LGI "(ntvClose) Handler %p on %s stopped (error %d).\n",
+        (void *) handler, tcpName (handler->source), (int) error) ;
+
+    handler->closed = true ;
+    ntvWatch (handler, 0) ;
+    if (handler->kind != NtvLines)  handler->length = 0 ;
+
+    handler->busy++ ;
+    handler->closeF (handler, NTV_CLOSE, error, handler->userData) ;
+    if (!handler->reported) {
+        handler->reported = true ;
+        handler->closeF (handler, IoxCancel, 0, handler->userData) ;
+    }
+    handler->busy-- ;
+
+    ntvCheck (handler) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvFlush ()
+
+    Write Buffered Input to the Sink.
+
+
+Purpose:
+
+    Function ntvFlush() writes as much of a handler's buffered input to its
+    sink as the sink will take without waiting.  If all of it is written,
+    the handler goes back to reading its source; otherwise, it waits for
+    the sink to become writeable.  The handler may be freed (if the write
+    fails) before ntvFlush() returns.
+
+
+    Invocation:
+
+        ntvFlush (handler) ;
+
+    where:
+
+        <handler>	- I
+            is the handler.
+
+*******************************************************************************/
+
+
+static  void  ntvFlush (
+
+#    if PROTOTYPES
+        NtvHandler  handler)
+#    else
+        handler)
+
+        NtvHandler  handler ;
+#    endif
+
+{    /* Local variables. */
+    errno_t  status ;
+    size_t  written ;
+
+
+
+    written = 0 ;
+    status = tcpWrite (handler->sink, 0.0, handler->length,
+                       handler->buffer + handler->start, &written) ;
+    if (written > handler->length)  written = handler->length ;
+    handler->start += written ;
+    handler->length -= written ;
+
+    if (status && (status != EWOULDBLOCK) && (status != EAGAIN)) {
+        LGE "(ntvFlush) Error writing to %s.\ntcpWrite: ",
+            tcpName (handler->sink)) ;
+        ntvClose (handler, status) ;
+        return ;
+    }
+
+    if (handler->length == 0)  handler->start = 0 ;
+
+    if (ntvWatch (handler, (handler->length == 0) ? IoxRead : IoxWrite)) {
+        LGE "(ntvFlush) Error registering %s.\nntvWatch: ",
+            tcpName (handler->sink)) ;
+        ntvClose (handler, errno) ;
+    }
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvOrphan ()
+
+    Handle the Destruction of a Handler's Dispatcher.
+
+
+Purpose:
+
+    Function ntvOrphan() is called when the dispatcher cancels one of a
+    handler's IOX callbacks, which only happens when the dispatcher is being
+    destroyed.  The handler is canceled.
+
+
+    Invocation:
+
+        ntvOrphan (handler, &callback) ;
+
+    where:
+
+        <handler>	- I
+            is the handler.
+        <callback>	- I/O
+            is the address of the canceled callback's field; the field is
+            set to NULL.
+
+*******************************************************************************/
+
+
+static  void  ntvOrphan (
+
+#    if PROTOTYPES
+        NtvHandler  handler,
+        IoxCallback  *callback)
+#    else
+        handler, callback)
+
+        NtvHandler  handler ;
+        IoxCallback  *callback ;
+#    endif
+
+{
+
+    *callback = NULL ;
+
+    LGI "(ntvOrphan) Handler %p orphaned.\n", (void *) handler) ;
+
+    ntvCancel (handler) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvReadCB ()
+
+    Read Input from the Source.
+
+
+Purpose:
+
+    Function ntvReadCB() is the IOX callback invoked when a handler's source
+    is readable.  One chunk of up to NTV_CHUNK bytes is read and dropped,
+    written to the sink, or added to the queue, depending on the kind of
+    handler.  At end-of-file or on an error, the handler is stopped.
+
+
+    Invocation:
+
+        status = ntvReadCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the IOX callback.
+        <reason>	- I
+            is the reason (IoxRead or IoxCancel) the callback is being
+            invoked.
+        <userData>	- I
+            is the handler.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  ntvReadCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    char  *buffer ;
+    NtvHandler  handler = (NtvHandler) userData ;
+    size_t  available, numBytesRead, size ;
+
+
+
+    if (reason == IoxCancel) {
+        if (callback == handler->cbRead)	/* Dispatcher destroyed. */
+            ntvOrphan (handler, &handler->cbRead) ;
+        return (0) ;
+    }
+
+/* If a slice's budget has been spent, leave the input for the next slice
+   (see soxRunSlice()). */
+
+    if (soxSliceDone (handler->dispatcher))  return (0) ;
+
+/* Make room in the buffer.  Only a queue has data in the buffer while the
+   source is being read; it is moved to the front of the buffer and, if
+   need be, the buffer is enlarged. */
+
+    if ((handler->start > 0) &&
+        ((handler->start + handler->length + NTV_CHUNK) > handler->size)) {
+        memmove (handler->buffer, handler->buffer + handler->start,
+                 handler->length) ;
+        handler->start = 0 ;
+    }
+
+    if (((handler->length + NTV_CHUNK) > handler->size) &&
+        (handler->size < NTV_MAX_QUEUE)) {
+        size = handler->size * 2 ;
+        if (size > NTV_MAX_QUEUE)  size = NTV_MAX_QUEUE ;
+        buffer = realloc (handler->buffer, size) ;
+        if (buffer != NULL) {
+            handler->buffer = buffer ;
+            handler->size = size ;
+        }
+    }
+
+    available = handler->size - handler->start - handler->length ;
+    if (available > NTV_CHUNK)  available = NTV_CHUNK ;
+    if (available == 0) {			/* Queue is full. */
+        ntvWatch (handler, 0) ;
+        return (0) ;
+    }
+
+/* Read what is available.  The TCP_UTIL package reports the source closing
+   its connection as a broken connection. */
+
+    numBytesRead = 0 ;
+    if (tcpRead (handler->source, -1.0, -((ssize_t) available),
+                 handler->buffer + handler->start + handler->length,
+                 &numBytesRead)) {
+        ntvClose (handler, (errno == EPIPE) ? 0 : errno) ;
+        return (0) ;
+    }
+
+    handler->bytes += numBytesRead ;
+
+    switch (handler->kind) {
+    case NtvLines:
+        handler->length += numBytesRead ;
+        if (handler->length >= NTV_MAX_QUEUE)  ntvWatch (handler, 0) ;
+        break ;
+    case NtvEcho:
+    case NtvRelay:
+        handler->length = numBytesRead ;
+        if (handler->length > 0)  ntvFlush (handler) ;
+        break ;
+    default:
+        break ;
+    }
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvWatch ()
+
+    Select the I/O Event a Handler Waits For.
+
+
+Purpose:
+
+    Function ntvWatch() registers a handler with its dispatcher for either
+    input from its source or output to its sink, canceling the other IOX
+    callback; a handler never waits for both.  The callback fields are
+    cleared before the callbacks are canceled, so the callback functions
+    can tell these cancellations from those made by the dispatcher.
+
+
+    Invocation:
+
+        status = ntvWatch (handler, mode) ;
+
+    where:
+
+        <handler>	- I
+            is the handler.
+        <mode>		- I
+            is IoxRead to wait for input, IoxWrite to wait for output, or
+            zero to wait for nothing.
+        <status>	- O
+            returns the status of registering the handler, zero if there
+            were no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  ntvWatch (
+
+#    if PROTOTYPES
+        NtvHandler  handler,
+        IoxReason  mode)
+#    else
+        handler, mode)
+
+        NtvHandler  handler ;
+        IoxReason  mode ;
+#    endif
+
+{    /* Local variables. */
+    IoxCallback  previous ;
+
+
+
+    if ((mode != IoxRead) && (handler->cbRead != NULL)) {
+        previous = handler->cbRead ;
+        handler->cbRead = NULL ;
+        ioxCancel (previous) ;
+    }
+
+    if ((mode != IoxWrite) && (handler->cbWrite != NULL)) {
+        previous = handler->cbWrite ;
+        handler->cbWrite = NULL ;
+        ioxCancel (previous) ;
+    }
+
+    if ((mode == IoxRead) && (handler->cbRead == NULL)) {
+        handler->cbRead = ioxOnIO (handler->dispatcher, ntvReadCB, handler,
+                                   IoxRead, tcpFd (handler->source)) ;
+        if (handler->cbRead == NULL) {
+            LGE "(ntvWatch) Error registering %s for input.\nioxOnIO: ",
+                tcpName (handler->source)) ;
+            return (errno) ;
+        }
+    }
+
+    if ((mode == IoxWrite) && (handler->cbWrite == NULL)) {
+        handler->cbWrite = ioxOnIO (handler->dispatcher, ntvWriteCB, handler,
+                                    IoxWrite, tcpFd (handler->sink)) ;
+        if (handler->cbWrite == NULL) {
+            LGE "(ntvWatch) Error registering %s for output.\nioxOnIO: ",
+                tcpName (handler->sink)) ;
+            return (errno) ;
+        }
+    }
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    ntvWriteCB ()
+
+    Resume Writing to the Sink.
+
+
+Purpose:
+
+    Function ntvWriteCB() is the IOX callback invoked when a handler's sink,
+    which couldn't take all the buffered input before, becomes writeable.
+
+
+    Invocation:
+
+        status = ntvWriteCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the IOX callback.
+        <reason>	- I
+            is the reason (IoxWrite or IoxCancel) the callback is being
+            invoked.
+        <userData>	- I
+            is the handler.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  ntvWriteCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    NtvHandler  handler = (NtvHandler) userData ;
+
+
+
+    if (reason == IoxCancel) {
+        if (callback == handler->cbWrite)	/* Dispatcher destroyed. */
+            ntvOrphan (handler, &handler->cbWrite) ;
+        return (0) ;
+    }
+
+    if (soxSliceDone (handler->dispatcher))  return (0) ;
+
+    ntvFlush (handler) ;
+
+    return (0) ;
+
+}
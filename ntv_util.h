@@ -0,0 +1,100 @@
+/* $Id$ */
+/*******************************************************************************
+
+    ntv_util.h
+
+    Native Stream Handler Utility Definitions.
+
+*******************************************************************************/
+
+#ifndef  NTV_UTIL_H		/* Has the file been INCLUDE'd already? */
+#define  NTV_UTIL_H  yes
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+extern  "C"  {
+#endif
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+#include  "iox_util.h"			/* I/O event dispatcher definitions. */
+#include  "tcp_util.h"			/* TCP/IP networking utilities. */
+
+
+/*******************************************************************************
+    Native Handler (Client View) and Definitions.
+*******************************************************************************/
+
+typedef  struct  _NtvHandler  *NtvHandler ;	/* Handler handle. */
+
+typedef  enum  NtvKind {
+    NtvDiscard = 0,			/* Read and drop the input. */
+    NtvEcho,				/* Write the input back to the source. */
+    NtvLines,				/* Queue the input's lines. */
+    NtvRelay				/* Write the input to another endpoint. */
+}  NtvKind ;
+
+/* Close function.  The function is invoked with reason NTV_CLOSE and the
+   error that stopped the handler (zero if the source simply closed its
+   connection) and then, finally, with reason IoxCancel when the handler is
+   released. */
+
+typedef  errno_t  (*NtvCloseFunc) P_((NtvHandler handler,
+                                      IoxReason reason,
+                                      errno_t error,
+                                      void *userData)) ;
+
+					/* Reason beyond IOX's own. */
+#define  NTV_CLOSE  ((IoxReason) 2048)	/* Handler stopped. */
+
+				/* Maximum input read per callback. */
+#ifndef NTV_CHUNK
+#    define  NTV_CHUNK  16384
+#endif
+				/* Maximum input queued by an NtvLines handler. */
+#ifndef NTV_MAX_QUEUE
+#    define  NTV_MAX_QUEUE  (1024 * 1024)
+#endif
+
+
+/*******************************************************************************
+    Miscellaneous declarations.
+*******************************************************************************/
+
+					/* Global debug switch (1/0 = yes/no). */
+extern  int  ntv_util_debug  OCD ("ntv_util") ;
+
+
+/*******************************************************************************
+    Public functions.
+*******************************************************************************/
+
+extern  NtvHandler  ntvAttach P_((IoxDispatcher dispatcher,
+                                  NtvKind kind,
+                                  TcpEndpoint source,
+                                  TcpEndpoint sink,
+                                  NtvCloseFunc closeF,
+                                  void *userData))
+    OCD ("ntv_util") ;
+
+extern  unsigned  long  ntvBytes P_((NtvHandler handler))
+    OCD ("ntv_util") ;
+
+extern  errno_t  ntvCancel P_((NtvHandler handler))
+    OCD ("ntv_util") ;
+
+extern  const  char  *ntvNextLine P_((NtvHandler handler,
+                                      size_t *length))
+    OCD ("ntv_util") ;
+
+extern  TcpEndpoint  ntvSink P_((NtvHandler handler))
+    OCD ("ntv_util") ;
+
+extern  TcpEndpoint  ntvSource P_((NtvHandler handler))
+    OCD ("ntv_util") ;
+
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+}
+#endif
+
+#endif				/* If this file was not INCLUDE'd previously. */
@@ -0,0 +1,75 @@
+; $Id$
+;*******************************************************************************
+;
+;    OPAQB - is a benchmark for the overhead of passing opaque handles to
+;        and receiving them from foreign functions.
+;
+;        OPAQB times CALL-COUNT calls (1,000,000 by default) of each of:
+;
+;            (tv-tod)			- a foreign call with no handle, the
+;					  baseline.
+;            (drs-count scan)		- a foreign call that decodes a handle.
+;            (iox-after ...) +
+;            (iox-cancel timer)		- foreign calls that make a handle and
+;					  decode it again.
+;
+;        and reports the cost of each in microseconds per call, less the
+;        cost of an empty loop iteration.  Run it against builds before and
+;        after a change to the OPAQUE package (see "opaque.c") to measure
+;        the change; the difference between the first two lines is the cost
+;        of decoding a handle.
+;
+;        Invocation:
+;
+;            % tsion opaqb.scm
+;
+;*******************************************************************************
+
+
+(define call-count 1000000)		; Calls per measurement.
+
+
+;*******************************************************************************
+;    Utilities - floating-point time of day and the timing loop.
+;*******************************************************************************
+
+(define (now)
+    (let ((tod (tv-tod)))
+        (+ (car tod) (/ (cdr tod) 1000000.0))))
+
+(define (time-loop thunk)
+    (let ((start (now)))
+        (do ((i 0 (+ i 1)))
+            ((>= i call-count))
+            (thunk))
+        (- (now) start)))
+
+(define (report label seconds)
+    (display label)
+    (display (/ (* (- seconds empty-time) 1000000.0) call-count))
+    (display " microseconds/call.")
+    (newline))
+
+
+;*******************************************************************************
+;    MAIN.
+;*******************************************************************************
+
+(define dispatcher (iox-create))
+(define scan (drs-create "."))
+
+(define (expire callback reason unused) #t)
+
+(define empty-time (time-loop (lambda () #t)))
+
+(report "No handle (tv-tod):           "
+        (time-loop (lambda () (tv-tod))))
+(report "Decode (drs-count):           "
+        (time-loop (lambda () (drs-count scan))))
+(report "Make + decode (after/cancel): "
+        (time-loop (lambda () (iox-cancel (iox-after dispatcher expire
+                                                     '() 60.0)))))
+
+(drs-destroy scan)
+(iox-destroy dispatcher)
+(exit)
@@ -13,24 +13,92 @@ Author:    Alex Measday
 
 Purpose:
 
-    The OPAQUE package implements an opaque (void *) data type.  Data types
-    are defined internally in the "scheme.c" core; note that the enumerated
-    type, "scheme_types", is not visible outside of "scheme.c".  To avoid
-    having to modify the core file, the OPAQUE package encodes (void *)
-    pointers in ASCII strings - slow, but portable to platforms that support
-    the "%p" sprintf/sscanf format.
+    The OPAQUE package implements an opaque (void *) data type, the handles
+    through which Scheme code refers to TCP endpoints, LF-terminated streams,
+    dispatchers, and the other C objects created by the TSION functions.
+    Data types are defined internally in the "scheme.c" core, which has no
+    type for raw C pointers.  The package originally encoded the pointers in
+    ASCII strings ("OPAQ%p"); now an opaque value is a cell of its own type,
+    T_OPAQUE, marked as an atom so that the garbage collector never looks
+    inside it.
+
+    The cell does not hold the C pointer itself.  Instead, each interpreter
+    has a handle table of typed slots and the cell holds the index of a slot
+    and the slot's generation number.  A slot records the object's pointer
+    and type (see "OpaqueType" in "tsion.h").  When a function destroys an
+    object, it calls opaque_release(), which frees the object's slot and
+    bumps the slot's generation.  As a result,
+
+        - passing a handle to a function expecting another type of object
+          (e.g., a TCP endpoint to REX-MATCH) is rejected, and
+
+        - passing the handle of a destroyed object (e.g., to LFN-GETLINE
+          after LFN-DESTROY) is rejected, rather than crashing the server
+          on a dangling pointer, even if the object's memory has since been
+          reused.
+
+    Checking a handle is an index and two compares; there is no string
+    formatting or parsing.  The table also maps pointers back to slots, so
+    making a handle for an object that already has one (as the dispatcher
+    does on every callback) reuses the slot.  The slot also remembers the
+    cell made for the object and, as long as the garbage collector hasn't
+    reclaimed it, returns the same cell again, so two handles for the same
+    object are EQ?, EQV?, and EQUAL?, as the "OPAQ%p" strings were EQUAL?;
+    ASSOC, MEMBER, and hash tables of any kind match them.
+
+        pointer  cell = mk_opaque (sc, (opaque) scan, OpaqueDirectoryScan) ;
+        ...
+        if (is_opaque (sc, argument, OpaqueDirectoryScan))
+            scan = (DirectoryScan) opaque_value (sc, argument) ;
+        ...
+        opaque_release (sc, (opaque) scan) ;
+        drsDestroy (scan) ;
+
+    Handles are not strings: STRING? returns #f for them and DISPLAY prints
+    them as "#<ERROR>", TinyScheme's rendering of a type it doesn't know.
+
+    A package whose objects hold external resources (sockets, file
+    descriptors, memory) can register a finalizer for its type of object
+    with opaque_finalizer().  opaque_collect() then finalizes the objects of
+    that type whose cells have been reclaimed by the garbage collector: the
+    slot is released and the finalizer (e.g., tcpDestroy()) is called.  The
+    "scheme.c" collector has no hook for foreign cells, so opaque_collect()
+    is called after the collector runs rather than by it; a reclaimed cell
+    is one whose type field no longer reads T_OPAQUE for the slot (the sweep
+    zeroes it).
+    Explicitly destroying an object releases its slot, so there is nothing
+    left to finalize.  Objects held by C code rather than by Scheme values
+    (e.g., the endpoints of a native handler) must be pinned with
+    opaque_pin() while C code holds them.
+
+        opaque_finalizer (sc, OpaqueTcpEndpoint, funcTcpFinalize) ;
+        ...
+        (gc)
+        (finalize-handles)		; Called automatically by the dispatcher.
+
+    If leak logging is enabled with opaque_log_leaks(), each object that is
+    finalized is reported on stderr, since a script that depends on the
+    finalizer to close its connections is probably missing a destroy call.
 
 
 Public Procedures:
 
-    is_opaque() - returns true if a Scheme cell is an opaque value.
+    is_opaque() - checks if a Scheme cell is a live opaque value.
     mk_opaque() - makes a Scheme cell containing an opaque value.
+    opaque_collect() - finalizes the objects whose handles were collected.
+    opaque_finalizer() - registers the finalizer for a type of object.
+    opaque_free() - frees an interpreter's handle table.
+    opaque_key() - returns a key identifying an opaque value's object.
+    opaque_log_leaks() - enables/disables the logging of finalized objects.
+    opaque_pin() - pins/unpins an object held by C code.
+    opaque_release() - invalidates the opaque values for an object.
     opaque_value() - returns the opaque value from a Scheme cell.
 
 Private Procedures:
 
-    decodeOpaque() - decodes an opaque value from a string.
-    encodeOpaque() - encodes an opaque value as a string.
+    opqFind() - finds an object's slot in the handle table.
+    opqLive() - checks if a slot's cell is still live.
+    opqTable() - gets an interpreter's handle table.
 
 *******************************************************************************/
 
@@ -44,39 +112,95 @@ Private Procedures:
 #include  "scheme-private.h"		/* TinyScheme internals. */
 
 
+/*******************************************************************************
+    Handle Table - the slots are kept in an array that is doubled in size
+        when it fills.  Free slots are chained through their NEXT fields;
+        used slots are chained, by the same field, in the hash buckets that
+        map object pointers to slots.  Each used slot also remembers the cell
+        made for its object, until the garbage collector reclaims the cell.
+*******************************************************************************/
+
+typedef  struct  OpaqueSlot {
+    opaque  value ;			/* NULL if the slot is free. */
+    OpaqueType  type ;			/* Type of object. */
+    int  generation ;			/* Bumped when the slot is freed. */
+    long  next ;			/* Next slot in bucket or free list. */
+    pointer  cell ;			/* Object's cell; NULL if none. */
+    int  pins ;				/* Nonzero if held by C code. */
+}  OpaqueSlot ;
+
+typedef  struct  _OpaqueTable {
+    OpaqueSlot  *slots ;		/* Array of slots. */
+    long  numSlots ;			/* # of slots allocated. */
+    long  freeList ;			/* First free slot; -1 if none. */
+    long  *buckets ;			/* Pointer-to-slot hash buckets. */
+    OpaqueFinalizer  finalizers[OpaqueNumTypes] ;
+    bool  logLeaks ;			/* Report finalized objects? */
+}  _OpaqueTable, *OpaqueTable ;
+
+					/* Initial number of slots; the number
+					   of buckets is always the same. */
+#define  OPAQUE_INITIAL  64
+
+static  const  char  *opaqueTypeNames[OpaqueNumTypes] = {
+    "object", "callback", "directory scan", "dispatcher",
+    "LF-terminated stream", "compiled pattern", "TCP endpoint"
+} ;
+
+/* The slot's index and generation are kept in a string cell's fields; the
+   cell's type keeps TinyScheme from treating them as a string. */
+
+#define  opaque_index(p)  ((long) (size_t) (p)->_object._string._svalue)
+#define  opaque_generation(p)  ((p)->_object._string._length)
+
+#define  OPAQUE_HASH(value, numSlots)	\
+	((long) (((size_t) (value) >> 4) & (size_t) ((numSlots) - 1)))
+
+
 /*******************************************************************************
     Private functions.
 *******************************************************************************/
 
-static  opaque  decodeOpaque P_((const char *stringValue)) ;
-static  char  *encodeOpaque P_((opaque value)) ;
-
+static  long  opqFind P_((OpaqueTable table,
+                          opaque value,
+                          long **link)) ;
+
+static  bool  opqLive P_((OpaqueTable table,
+                          long index)) ;
+
+static  OpaqueTable  opqTable P_((scheme *sc)) ;
+
 /*!*****************************************************************************
 
 Procedure:
 
     is_opaque ()
 
-    Check if a Scheme Cell is an Opaque Value.
+    Check if a Scheme Cell is a Live Opaque Value.
 
 
 Purpose:
 
-    Function is_opaque() returns true if a Scheme cell contains an encoded
-    opaque value and false otherwise.
+    Function is_opaque() returns true if a Scheme cell contains an opaque
+    value of a given type whose object has not been released, and false
+    otherwise.
 
 
     Invocation:
 
-        flag = is_opaque (cell) ;
+        flag = is_opaque (sc, cell, type) ;
 
     where
 
+        <sc>		- I
+            is the Scheme interpreter.
         <cell>		- I
             is a Scheme cell.
+        <type>		- I
+            is the expected type of object; OpaqueAny accepts any type.
         <flag>		- I
-            returns true if the Scheme cell contains an encoded opaque value
-            and false otherwise.
+            returns true if the Scheme cell contains a live opaque value
+            of the expected type and false otherwise.
 
 *******************************************************************************/
 
@@ -84,19 +208,39 @@ Purpose:
 bool  is_opaque (
 
 #    if PROTOTYPES
-        pointer  cell)
+        scheme  *sc,
+        pointer  cell,
+        OpaqueType  type)
 #    else
-        cell)
+        sc, cell, type)
 
+        scheme  *sc ;
         pointer  cell ;
+        OpaqueType  type ;
 #    endif
 
-{
+{    /* Local variables. */
+    long  index ;
+    OpaqueSlot  *slot ;
+    OpaqueTable  table ;
+
+
+
+    if ((typeflag (cell) & T_MASKTYPE) != T_OPAQUE)  return (false) ;
+
+    table = TS (sc, handles) ;
+    index = opaque_index (cell) ;
+    if ((table == NULL) || (index < 0) || (index >= table->numSlots))
+        return (false) ;
 
-    return (is_string (cell) && (strncmp (strvalue (cell), "OPAQ", 4) == 0)) ;
+    slot = &table->slots[index] ;
+
+    return ((slot->value != NULL) &&
+            (slot->generation == opaque_generation (cell)) &&
+            ((type == OpaqueAny) || (slot->type == type))) ;
 
 }
-
+
 /*!*****************************************************************************
 
 Procedure:
@@ -108,13 +252,16 @@ Procedure:
 
 Purpose:
 
-    Function mk_opaque() creates a new Scheme cell containing an encoded
-    opaque value.
+    Function mk_opaque() returns a Scheme cell containing an opaque value.
+    If the object does not already have a slot in the handle table, one is
+    assigned to it.  If the cell last made for the object has not been
+    reclaimed by the garbage collector, that cell is returned; otherwise, a
+    new cell is made.
 
 
     Invocation:
 
-        cell = mk_opaque (sc, value) ;
+        cell = mk_opaque (sc, value, type) ;
 
     where
 
@@ -122,14 +269,555 @@ Purpose:
             is the Scheme interpreter.
         <value>		- I
             is the opaque (void *) value.
+        <type>		- I
+            is the type of object.
         <cell>		- O
-            returns a new Scheme cell containing the encoded opaque value.
+            returns the Scheme cell containing the opaque value; #f is
+            returned in the event of an error.
 
 *******************************************************************************/
 
 
 pointer  mk_opaque (
 
+#    if PROTOTYPES
+        scheme  *sc,
+        opaque  value,
+        OpaqueType  type)
+#    else
+        sc, value, type)
+
+        scheme  *sc ;
+        opaque  value ;
+        OpaqueType  type ;
+#    endif
+
+{    /* Local variables. */
+    long  bucket, i, index, *link, numSlots ;
+    OpaqueSlot  *slot, *slots ;
+    OpaqueTable  table ;
+    pointer  cell ;
+
+
+
+    table = opqTable (sc) ;
+    if (table == NULL)  return (sc->F) ;
+
+/* If the object already has a slot, reuse it.  A slot of a different type
+   belongs to an earlier object, at the same address, whose destruction
+   went unreported; release it and start over. */
+
+    index = opqFind (table, value, &link) ;
+    if ((index >= 0) && (table->slots[index].type != type)) {
+        LGI "(mk_opaque) Releasing stale slot %ld for %p.\n",
+            index, value) ;
+        opaque_release (sc, value) ;
+        index = -1 ;
+    }
+
+    if (index < 0) {
+
+/* Otherwise, allocate a slot, doubling the table if necessary.  The used
+   slots are then rehashed into the new, larger set of buckets. */
+
+        if (table->freeList < 0) {
+            numSlots = table->numSlots * 2 ;
+            slots = (OpaqueSlot *) realloc (table->slots,
+                                            numSlots * sizeof (OpaqueSlot)) ;
+            if (slots == NULL) {
+                LGE "(mk_opaque) Error expanding handle table to %ld slots.\nrealloc: ",
+                    numSlots) ;
+                return (sc->F) ;
+            }
+            table->slots = slots ;
+            link = (long *) realloc (table->buckets, numSlots * sizeof (long)) ;
+            if (link == NULL) {
+                LGE "(mk_opaque) Error expanding handle table to %ld buckets.\nrealloc: ",
+                    numSlots) ;
+                return (sc->F) ;
+            }
+            table->buckets = link ;
+            for (i = 0 ;  i < numSlots ;  i++)
+                table->buckets[i] = -1 ;
+            for (i = 0 ;  i < table->numSlots ;  i++) {
+                bucket = OPAQUE_HASH (slots[i].value, numSlots) ;
+                slots[i].next = table->buckets[bucket] ;
+                table->buckets[bucket] = i ;
+            }
+            for (i = numSlots - 1 ;  i >= table->numSlots ;  i--) {
+                slots[i].value = NULL ;
+                slots[i].type = OpaqueAny ;
+                slots[i].generation = 0 ;
+                slots[i].cell = NULL ;
+                slots[i].pins = 0 ;
+                slots[i].next = table->freeList ;
+                table->freeList = i ;
+            }
+            table->numSlots = numSlots ;
+        }
+
+        index = table->freeList ;
+        slot = &table->slots[index] ;
+        table->freeList = slot->next ;
+
+        slot->value = value ;
+        slot->type = type ;
+        bucket = OPAQUE_HASH (value, table->numSlots) ;
+        slot->next = table->buckets[bucket] ;
+        table->buckets[bucket] = index ;
+
+        LGI "(mk_opaque) Slot %ld (generation %d) for %p, type %d.\n",
+            index, slot->generation, value, (int) type) ;
+
+    }
+
+/* If the object's cell is still live, return it. */
+
+    if (opqLive (table, index))  return (table->slots[index].cell) ;
+
+/* TinyScheme's get_cell() function is declared "static" in "scheme.c",
+   so use mk_character to get a cell and then convert it to an opaque cell
+   (as mk_port() does for ports). */
+
+    cell = mk_character (sc, '\0') ;
+
+    typeflag (cell) = T_OPAQUE | T_ATOM ;
+    cell->_object._string._svalue = (char *) (size_t) index ;
+    opaque_generation (cell) = table->slots[index].generation ;
+
+    table->slots[index].cell = cell ;
+
+    return (cell) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    opaque_collect ()
+
+    Finalize the Objects Whose Handles Were Collected.
+
+
+Purpose:
+
+    Function opaque_collect() finalizes each object (i) that has a finalizer,
+    (ii) that is not pinned, and (iii) whose cell did not survive the last
+    run of the garbage collector.  The object's slot is released and then
+    the finalizer for the object's type is called.  Since an object is only
+    finalized after the collector has reclaimed its cells, opaque_collect()
+    does nothing useful unless the collector has run since the last call.
+
+
+    Invocation:
+
+        count = opaque_collect (sc) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <count>		- O
+            returns the number of objects finalized.
+
+*******************************************************************************/
+
+
+long  opaque_collect (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{    /* Local variables. */
+    long  count, index ;
+    OpaqueFinalizer  finalizer ;
+    OpaqueSlot  *slot ;
+    OpaqueTable  table ;
+    OpaqueType  type ;
+    opaque  value ;
+
+
+
+    table = TS (sc, handles) ;
+    if (table == NULL)  return (0) ;
+
+    count = 0 ;
+
+    for (index = 0 ;  index < table->numSlots ;  index++) {
+
+        slot = &table->slots[index] ;
+        if ((slot->value == NULL) || (slot->pins > 0))  continue ;
+        finalizer = table->finalizers[slot->type] ;
+        if ((finalizer == NULL) || opqLive (table, index))  continue ;
+
+/* Release the slot before calling the finalizer, so that the object can't
+   be finalized twice. */
+
+        value = slot->value ;
+        type = slot->type ;
+        opaque_release (sc, value) ;
+
+        if (table->logLeaks)
+            fprintf (stderr, "(opaque) Finalizing leaked %s %p.\n",
+                     opaqueTypeNames[type], value) ;
+        LGI "(opaque_collect) Finalizing %s %p.\n",
+            opaqueTypeNames[type], value) ;
+
+        if (finalizer (value)) {
+            LGE "(opaque_collect) Error finalizing %s %p.\n",
+                opaqueTypeNames[type], value) ;
+        }
+
+        count++ ;
+
+    }
+
+    return (count) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    opaque_finalizer ()
+
+    Register the Finalizer for a Type of Object.
+
+
+Purpose:
+
+    Function opaque_finalizer() registers the function that destroys an
+    object of a given type when Scheme code has dropped all of the object's
+    handles without destroying the object.  The finalizer is passed the
+    object's opaque value and returns zero if there were no errors and ERRNO
+    otherwise.
+
+
+    Invocation:
+
+        opaque_finalizer (sc, type, finalizer) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <type>		- I
+            is the type of object.
+        <finalizer>	- I
+            is the function to call to finalize an object of the given type;
+            NULL disables finalization of the type.
+
+*******************************************************************************/
+
+
+void  opaque_finalizer (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        OpaqueType  type,
+        OpaqueFinalizer  finalizer)
+#    else
+        sc, type, finalizer)
+
+        scheme  *sc ;
+        OpaqueType  type ;
+        OpaqueFinalizer  finalizer ;
+#    endif
+
+{    /* Local variables. */
+    OpaqueTable  table ;
+
+
+
+    table = opqTable (sc) ;
+    if ((table == NULL) || (type <= OpaqueAny) || (type >= OpaqueNumTypes))
+        return ;
+
+    table->finalizers[type] = finalizer ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    opaque_free ()
+
+    Free an Interpreter's Handle Table.
+
+
+Purpose:
+
+    Function opaque_free() frees an interpreter's handle table when the
+    interpreter is being destroyed.  The finalizers are *not* called for
+    the objects still in the table: an object may be shared with C code or
+    with other interpreters (e.g., the dispatcher), and the program, which
+    created the objects, is responsible for destroying them.
+
+
+    Invocation:
+
+        opaque_free (sc) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+void  opaque_free (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{    /* Local variables. */
+    OpaqueTable  table = TS (sc, handles) ;
+
+
+
+    if (table == NULL)  return ;
+
+    TS (sc, handles) = NULL ;
+
+    free (table->slots) ;
+    free (table->buckets) ;
+    free (table) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    opaque_key ()
+
+    Get a Key Identifying an Opaque Value's Object.
+
+
+Purpose:
+
+    Function opaque_key() returns a number that identifies the object
+    referred to by an opaque value.  All live handles for the same object
+    have the same key, and no live handles for different objects do.
+    (Live handles for the same object are usually the same cell, but a
+    handle for a destroyed object is not.)
+
+
+    Invocation:
+
+        key = opaque_key (cell) ;
+
+    where
+
+        <cell>		- I
+            is the Scheme cell containing the opaque value.
+        <key>		- O
+            returns the key.
+
+*******************************************************************************/
+
+
+unsigned  long  opaque_key (
+
+#    if PROTOTYPES
+        pointer  cell)
+#    else
+        cell)
+
+        pointer  cell ;
+#    endif
+
+{
+
+    return (((unsigned long) opaque_generation (cell) << 20) ^
+            (unsigned long) opaque_index (cell)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    opaque_log_leaks ()
+
+    Enable/Disable the Logging of Finalized Objects.
+
+
+Purpose:
+
+    Function opaque_log_leaks() enables or disables the reporting, on
+    stderr, of each object finalized by opaque_collect().  An object that is
+    finalized was leaked by the Scheme code that created it.
+
+
+    Invocation:
+
+        previous = opaque_log_leaks (sc, flag) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <flag>		- I
+            enables (true) or disables (false) the logging of leaks.
+        <previous>	- O
+            returns the previous setting.
+
+*******************************************************************************/
+
+
+bool  opaque_log_leaks (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        bool  flag)
+#    else
+        sc, flag)
+
+        scheme  *sc ;
+        bool  flag ;
+#    endif
+
+{    /* Local variables. */
+    bool  previous ;
+    OpaqueTable  table ;
+
+
+
+    table = opqTable (sc) ;
+    if (table == NULL)  return (false) ;
+
+    previous = table->logLeaks ;
+    table->logLeaks = flag ;
+
+    return (previous) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    opaque_pin ()
+
+    Pin/Unpin an Object Held by C Code.
+
+
+Purpose:
+
+    Function opaque_pin() pins or unpins an object.  A pinned object is not
+    finalized even if all of its handles are collected; objects taken over
+    by C code that Scheme code may later drop (e.g., the endpoints of a
+    native handler) should be pinned until C code is done with them.  Pins
+    are counted, so each pin must be matched by an unpin.  Pinning an object
+    that has no slot is harmless.
+
+
+    Invocation:
+
+        opaque_pin (sc, value, pin) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <value>		- I
+            is the opaque (void *) value.
+        <pin>		- I
+            pins (true) or unpins (false) the object.
+
+*******************************************************************************/
+
+
+void  opaque_pin (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        opaque  value,
+        bool  pin)
+#    else
+        sc, value, pin)
+
+        scheme  *sc ;
+        opaque  value ;
+        bool  pin ;
+#    endif
+
+{    /* Local variables. */
+    long  index, *link ;
+    OpaqueSlot  *slot ;
+    OpaqueTable  table ;
+
+
+
+    table = TS (sc, handles) ;
+    if (table == NULL)  return ;
+
+    index = opqFind (table, value, &link) ;
+    if (index < 0)  return ;
+
+    slot = &table->slots[index] ;
+    if (pin)
+        slot->pins++ ;
+    else if (slot->pins > 0)
+        slot->pins-- ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    opaque_release ()
+
+    Invalidate the Opaque Values for an Object.
+
+
+Purpose:
+
+    Function opaque_release() frees an object's slot in the handle table,
+    so that any remaining handles for the object are rejected.  It should
+    be called whenever a TSION function destroys an object (or hands it off
+    to another object that will destroy it).  Releasing an object that has
+    no slot is harmless.
+
+
+    Invocation:
+
+        opaque_release (sc, value) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <value>		- I
+            is the opaque (void *) value.
+
+*******************************************************************************/
+
+
+void  opaque_release (
+
 #    if PROTOTYPES
         scheme  *sc,
         opaque  value)
@@ -140,12 +828,36 @@ pointer  mk_opaque (
         opaque  value ;
 #    endif
 
-{
+{    /* Local variables. */
+    long  index, *link ;
+    OpaqueSlot  *slot ;
+    OpaqueTable  table ;
+
 
-    return (mk_string (sc, encodeOpaque (value))) ;
+
+    table = TS (sc, handles) ;
+    if (table == NULL)  return ;
+
+    index = opqFind (table, value, &link) ;
+    if (index < 0)  return ;
+
+    slot = &table->slots[index] ;
+    *link = slot->next ;			/* Unlink from bucket. */
+
+    LGI "(opaque_release) Slot %ld (generation %d) for %p.\n",
+        index, slot->generation, value) ;
+
+    slot->value = NULL ;
+    slot->generation = (slot->generation + 1) & 0x7FFFFFFF ;
+    slot->cell = NULL ;
+    slot->pins = 0 ;
+    slot->next = table->freeList ;
+    table->freeList = index ;
+
+    return ;
 
 }
-
+
 /*!*****************************************************************************
 
 Procedure:
@@ -157,19 +869,23 @@ Procedure:
 
 Purpose:
 
-    Function opaque_value() returns the decoded opaque value from a Scheme cell.
+    Function opaque_value() returns the opaque value from a Scheme cell.
+    The caller should first check the cell's type with is_opaque().
 
 
     Invocation:
 
-        value = opaque_value (cell) ;
+        value = opaque_value (sc, cell) ;
 
     where
 
+        <sc>		- I
+            is the Scheme interpreter.
         <cell>		- I
-            is the Scheme cell containing the encoded opaque value.
-        <value>		- I
-            is the opaque (void *) value.
+            is the Scheme cell containing the opaque value.
+        <value>		- O
+            returns the opaque (void *) value; NULL is returned if the cell
+            does not contain a live opaque value.
 
 *******************************************************************************/
 
@@ -177,130 +893,234 @@ Purpose:
 opaque  opaque_value (
 
 #    if PROTOTYPES
+        scheme  *sc,
         pointer  cell)
 #    else
-        cell)
+        sc, cell)
 
+        scheme  *sc ;
         pointer  cell ;
 #    endif
 
 {
 
-    if (is_opaque (cell)) {
-        return (decodeOpaque (strvalue (cell))) ;
+    if (is_opaque (sc, cell, OpaqueAny)) {
+        return (TS (sc, handles)->slots[opaque_index (cell)].value) ;
     } else {
         SET_ERRNO (EINVAL) ;
-        LGE "(opaque_value) Not an opaque value: ") ;
+        LGE "(opaque_value) Not a live opaque value: ") ;
         return (NULL) ;
     }
 
 }
-
+
 /*!*****************************************************************************
 
 Procedure:
 
-    decodeOpaque ()
+    opqFind ()
 
-    Decode an Opaque Value from a String.
+    Find an Object's Slot in the Handle Table.
 
 
 Purpose:
 
-    Function decodeOpaque() decodes an opaque value from a string;
-    see encodeOpaque() for the encoding scheme.
+    Function opqFind() looks up the slot assigned to an object.
 
 
     Invocation:
 
-        value = decodeOpaque (stringValue) ;
+        index = opqFind (table, value, &link) ;
 
     where
 
-        <stringValue>	- I
-            returns a string containing the encoded opaque value.
-        <value>		- O
-            returns the opaque (void *) value decoded from the string;
-            NULL is returned in the event of an error.
+        <table>		- I
+            is the handle table.
+        <value>		- I
+            is the opaque (void *) value.
+        <link>		- O
+            returns the address of the bucket-chain link pointing to the
+            slot, for unlinking it.
+        <index>		- O
+            returns the index of the object's slot; -1 is returned if the
+            object has no slot.
 
 *******************************************************************************/
 
 
-static  opaque  decodeOpaque (
+static  long  opqFind (
 
 #    if PROTOTYPES
-        const  char  *stringValue)
+        OpaqueTable  table,
+        opaque  value,
+        long  **link)
 #    else
-        stringValue)
+        table, value, link)
 
-        char  *stringValue ;
+        OpaqueTable  table ;
+        opaque  value ;
+        long  **link ;
 #    endif
 
 {    /* Local variables. */
-    int  numItems ;
-    opaque  value ;
+    long  index ;
 
 
 
-    numItems = sscanf (stringValue, "OPAQ%p", &value) ;
-    if (numItems < 1) {
-        SET_ERRNO (EINVAL) ;
-        LGE "(decodeOpaque) Invalid string: \"%s\"\nsscanf: ", stringValue) ;
-        value = NULL ;		/* Conversion error? */
+    *link = &table->buckets[OPAQUE_HASH (value, table->numSlots)] ;
+
+    for (index = **link ;  index >= 0 ;  index = **link) {
+        if (table->slots[index].value == value)  break ;
+        *link = &table->slots[index].next ;
     }
 
-    return (value) ;
+    return (index) ;
 
 }
-
+
 /*!*****************************************************************************
 
 Procedure:
 
-    encodeOpaque ()
+    opqLive ()
 
-    Encode an Opaque Value in a String.
+    Check if a Slot's Cell is Still Live.
 
 
 Purpose:
 
-    Function encodeOpaque() encodes an opaque value in a string using a format
-    of "OPAQ%p", where "%p" is the sprintf() specifier for formatting pointers.
+    Function opqLive() checks if the cell made for a slot's object has
+    survived the garbage collector.  The cell is still live if it is an
+    opaque cell for the slot's current generation; the collector's sweep
+    zeroes the type of the cells it reclaims, and a reclaimed cell reused
+    for something else no longer refers to the slot.  If the cell is not
+    live, the slot forgets it.
 
 
     Invocation:
 
-        stringValue = encodeOpaque (value) ;
+        isLive = opqLive (table, index) ;
 
     where
 
-        <value>		- I
-            is the opaque (void *) value to be encoded.
-        <stringValue>	- O
-            returns a string containing the encoded opaque value.  Storage for
-            the string belongs to encodeOpaque(); the string should be used or
-            duplicated before calling encodeOpaque() again.
+        <table>		- I
+            is the handle table.
+        <index>		- I
+            is the index of the slot.
+        <isLive>	- O
+            returns true if the slot's cell is live and false otherwise.
 
 *******************************************************************************/
 
 
-static  char  *encodeOpaque (
+static  bool  opqLive (
 
 #    if PROTOTYPES
-        opaque  value)
+        OpaqueTable  table,
+        long  index)
 #    else
-        value)
+        table, index)
 
-        opaque  value ;
+        OpaqueTable  table ;
+        long  index ;
+#    endif
+
+{    /* Local variables. */
+    OpaqueSlot  *slot ;
+    pointer  cell ;
+
+
+
+    slot = &table->slots[index] ;
+    cell = slot->cell ;
+
+    if ((cell != NULL) &&
+        ((typeflag (cell) & T_MASKTYPE) == T_OPAQUE) &&
+        (opaque_index (cell) == index) &&
+        (opaque_generation (cell) == slot->generation))
+        return (true) ;
+
+    slot->cell = NULL ;
+
+    return (false) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    opqTable ()
+
+    Get an Interpreter's Handle Table.
+
+
+Purpose:
+
+    Function opqTable() returns an interpreter's handle table, creating the
+    table if it doesn't exist yet.
+
+
+    Invocation:
+
+        table = opqTable (sc) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <table>		- O
+            returns the handle table; NULL is returned in the event of an
+            error.
+
+*******************************************************************************/
+
+
+static  OpaqueTable  opqTable (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
 #    endif
 
 {    /* Local variables. */
-    static  char  stringValue[32] ;
+    long  i ;
+    OpaqueTable  table ;
+
+
+
+    if (TS (sc, handles) != NULL)  return (TS (sc, handles)) ;
 
+    table = (OpaqueTable) calloc (1, sizeof (_OpaqueTable)) ;
+    if (table == NULL) {
+        LGE "(opqTable) Error allocating handle table.\ncalloc: ") ;
+        return (NULL) ;
+    }
+
+    table->slots = (OpaqueSlot *) calloc (OPAQUE_INITIAL, sizeof (OpaqueSlot)) ;
+    table->buckets = (long *) calloc (OPAQUE_INITIAL, sizeof (long)) ;
+    if ((table->slots == NULL) || (table->buckets == NULL)) {
+        LGE "(opqTable) Error allocating %d-slot handle table.\ncalloc: ",
+            OPAQUE_INITIAL) ;
+        PUSH_ERRNO ;
+        free (table->slots) ;  free (table->buckets) ;  free (table) ;
+        POP_ERRNO ;
+        return (NULL) ;
+    }
 
+    table->numSlots = OPAQUE_INITIAL ;
+    table->freeList = -1 ;
+    for (i = OPAQUE_INITIAL - 1 ;  i >= 0 ;  i--) {
+        table->buckets[i] = -1 ;
+        table->slots[i].next = table->freeList ;
+        table->freeList = i ;
+    }
 
-    sprintf (stringValue, "OPAQ%p", value) ;
+    TS (sc, handles) = table ;
 
-    return (stringValue) ;
+    return (table) ;
 
 }
@@ -41,11 +41,27 @@ Purpose:
     stored in lower-case, "schemerocks", although "(get 'xyz 'SchemeRocks)"
     still returns the correct value.
 
+    Looking up a symbol's T_SYMBOL cell by name is the expensive part of a
+    property access: the name must be copied, converted to lower-case, and
+    then searched for in TinyScheme's symbol table.  Programs that access the
+    same property repeatedly can look the cells up once with plistSymbol()
+    and then call plistGetSym() and plistPutSym(), which take the cells
+    rather than names and go straight to the property list.  (Symbols are
+    never garbage-collected, so the cells can be kept indefinitely.)
+
+        pointer  symbol = plistSymbol (sc, "*tsion-id-map*") ;
+        pointer  property = plistSymbol (sc, "alist") ;
+        ...
+        alist = plistGetSym (sc, symbol, property) ;
+
 
 Public Procedures:
 
     plistGet() - gets the value of a symbol's property.
+    plistGetSym() - gets the value of a symbol's property, by symbol cell.
     plistPut() - sets the value of a symbol's property.
+    plistPutSym() - sets the value of a symbol's property, by symbol cell.
+    plistSymbol() - looks up the symbol cell for a name.
 
 Private Procedures:
 
@@ -58,6 +74,7 @@ Private Procedures:
 
 #include  <stdio.h>			/* Standard I/O definitions. */
 #include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <ctype.h>			/* Standard character functions. */
 #include  "str_util.h"			/* String manipulation functions. */
 #include  "tsion.h"			/* TinyScheme I/O Network functions. */
 #include  "plist_util.h"		/* TinyScheme property lists. */
@@ -131,42 +148,85 @@ pointer  plistGet (
 #    endif
 
 {    /* Local variables. */
-    char  *s ;
-    pointer  pair, propCell, symCell ;
+    pointer  propCell, symCell ;
 
 
 
-/* Convert the symbol and property names to all lower-case.  The names are
-   stored that way internally and mk_symbol() will return the wrong pointers
-   if the names are not in all lower-case. */
+/* Look up the symbol and property cells. */
+
+    symCell = plistSymbol (sc, symbol) ;
+    if (symCell == NULL)  return (NULL) ;
+    propCell = plistSymbol (sc, property) ;
+    if (propCell == NULL)  return (NULL) ;
+
+/* Return the property's value to the caller. */
+
+    return (plistGetSym (sc, symCell, propCell)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    plistGetSym ()
+
+    Get the Value of a Symbol's Property, by Symbol Cell.
+
+
+Purpose:
+
+    Function plistGetSym() gets the value of the desired property of a
+    symbol; it is plistGet() without the look-up of the symbol and property
+    names.
+
+
+    Invocation:
+
+        value = plistGetSym (sc, symbol, property) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <symbol>	- I
+            is a pointer to the symbol's T_SYMBOL cell; see plistSymbol().
+        <property>	- I
+            is a pointer to the property's T_SYMBOL cell.
+        <value>		- O
+            returns a pointer to the Scheme cell whose contents are the value
+            of the symbol's property; NULL is returned if the symbol has no
+            such property.
+
+*******************************************************************************/
+
+
+pointer  plistGetSym (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  symbol,
+        pointer  property)
+#    else
+        sc, symbol, property)
+
+        scheme  *sc ;
+        pointer  symbol ;
+        pointer  property ;
+#    endif
+
+{    /* Local variables. */
+    pointer  pair ;
 
-    s = strdup (symbol) ;
-    if (s == NULL) {
-        LGE "(plistPut) Error duplicating symbol name: \"%s\"\nstrdup: ",
-            symbol) ;
-        return (NULL) ;
-    }
-    strlwr (s) ;
-    symCell = mk_symbol (sc, s) ;
-    free (s) ;
 
-    s = strdup (property) ;
-    if (s == NULL) {
-        LGE "(plistFind) Error duplicating property name: \"%s\"\nstrdup: ",
-            property) ;
-        return (NULL) ;
-    }
-    strlwr (s) ;
-    propCell = mk_symbol (sc, s) ;
-    free (s) ;
 
 /* Verify that the property is in the symbol's property list. */
 
-    pair = plistFind (sc, symCell, propCell) ;
+    pair = plistFind (sc, symbol, property) ;
     if (pair == NULL) {
         SET_ERRNO (EINVAL) ;
-        LGI "(plistGet) Symbol %s, property %s was not found.\nplistFind: ",
-            symbol, property) ;
+        LGI "(plistGetSym) Symbol %s, property %s was not found.\nplistFind: ",
+            strvalue (car (symbol)), strvalue (car (property))) ;
         return (NULL) ;
     }
 
@@ -175,7 +235,7 @@ pointer  plistGet (
     return (cdr (pair)) ;
 
 }
-
+
 /*!*****************************************************************************
 
 Procedure:
@@ -231,45 +291,92 @@ errno_t  plistPut (
 #    endif
 
 {    /* Local variables. */
-    char  *s ;
-    pointer  pair, propCell, symCell ;
+    pointer  propCell, symCell ;
 
 
 
-/* Convert the symbol and property names to all lower-case.  The names are
-   stored that way internally and mk_symbol() will return the wrong pointers
-   if the names are not in all lower-case. */
+/* Look up the symbol and property cells. */
+
+    symCell = plistSymbol (sc, symbol) ;
+    if (symCell == NULL)  return (errno) ;
+    propCell = plistSymbol (sc, property) ;
+    if (propCell == NULL)  return (errno) ;
+
+/* Set the property's value. */
+
+    return (plistPutSym (sc, symCell, propCell, value)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    plistPutSym ()
+
+    Set the Value of a Symbol's Property, by Symbol Cell.
+
+
+Purpose:
+
+    Function plistPutSym() sets the value of the desired property of a
+    symbol; it is plistPut() without the look-up of the symbol and property
+    names.
+
+
+    Invocation:
+
+        status = plistPutSym (sc, symbol, property, value) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <symbol>	- I
+            is a pointer to the symbol's T_SYMBOL cell; see plistSymbol().
+        <property>	- I
+            is a pointer to the property's T_SYMBOL cell.
+        <value>		- I
+            is a pointer to the Scheme cell whose contents are the new value of
+            the symbol's property.
+        <status>	- O
+            returns the status of setting or adding the symbol's property value,
+            zero if there were no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  plistPutSym (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  symbol,
+        pointer  property,
+        pointer  value)
+#    else
+        sc, symbol, property, value)
+
+        scheme  *sc ;
+        pointer  symbol ;
+        pointer  property ;
+        pointer  value ;
+#    endif
+
+{    /* Local variables. */
+    pointer  pair ;
 
-    s = strdup (symbol) ;
-    if (s == NULL) {
-        LGE "(plistPut) Error duplicating symbol name: \"%s\"\nstrdup: ",
-            symbol) ;
-        return (errno) ;
-    }
-    strlwr (s) ;
-    symCell = mk_symbol (sc, s) ;
-    free (s) ;
 
-    s = strdup (property) ;
-    if (s == NULL) {
-        LGE "(plistFind) Error duplicating property name: \"%s\"\nstrdup: ",
-            property) ;
-        return (errno) ;
-    }
-    strlwr (s) ;
-    propCell = mk_symbol (sc, s) ;
-    free (s) ;
 
 /* Check if the property is already in the symbol's property list. */
 
-    pair = plistFind (sc, symCell, propCell) ;	/* Property/value pair. */
+    pair = plistFind (sc, symbol, property) ;	/* Property/value pair. */
 
 /* If the property is not yet in the symbol's property list, then add it. */
 
     if (pair == NULL) {
-        pair = cons (sc, propCell, sc->NIL) ;	/* Property/value pair. */
-        pair = cons (sc, pair, cdr (symCell)) ;	/* Property list entry. */
-        cdr (symCell) = pair ;			/* Prepend entry to list. */
+        pair = cons (sc, property, sc->NIL) ;	/* Property/value pair. */
+        pair = cons (sc, pair, cdr (symbol)) ;	/* Property list entry. */
+        cdr (symbol) = pair ;			/* Prepend entry to list. */
         pair = car (pair) ;			/* Back to property/value pair. */
     }
 
@@ -280,7 +387,83 @@ errno_t  plistPut (
     return (0) ;
 
 }
-
+
+/*!*****************************************************************************
+
+Procedure:
+
+    plistSymbol ()
+
+    Look Up the Symbol Cell for a Name.
+
+
+Purpose:
+
+    Function plistSymbol() returns the T_SYMBOL cell for a symbol or property
+    name, creating the symbol if it doesn't exist yet.  The cell can be saved
+    and passed to plistGetSym() and plistPutSym() on later calls.
+
+
+    Invocation:
+
+        cell = plistSymbol (sc, name) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <name>		- I
+            is the symbol's name.  As with TinyScheme's symbol implementation,
+            the name is converted to all lower-case internally.
+        <cell>		- O
+            returns a pointer to the symbol's T_SYMBOL cell; NULL is returned
+            in the event of an error.
+
+*******************************************************************************/
+
+
+pointer  plistSymbol (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        const  char  *name)
+#    else
+        sc, name)
+
+        scheme  *sc ;
+        const  char  *name ;
+#    endif
+
+{    /* Local variables. */
+    char  *s ;
+    const  char  *t ;
+    pointer  cell ;
+
+
+
+/* Convert the name to all lower-case.  The names are stored that way
+   internally and mk_symbol() will return the wrong pointers if the names
+   are not in all lower-case.  Names that are already lower-case (as are
+   most names passed in by C code) need not be copied. */
+
+    for (t = name ;  *t != '\0' ;  t++)
+        if (isupper ((unsigned char) *t))  break ;
+
+    if (*t == '\0')  return (mk_symbol (sc, name)) ;
+
+    s = strdup (name) ;
+    if (s == NULL) {
+        LGE "(plistSymbol) Error duplicating name: \"%s\"\nstrdup: ", name) ;
+        return (NULL) ;
+    }
+    strlwr (s) ;
+    cell = mk_symbol (sc, s) ;
+    free (s) ;
+
+    return (cell) ;
+
+}
+
 /*!*****************************************************************************
 
 Procedure:
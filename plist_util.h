@@ -37,12 +37,27 @@ extern  pointer  plistGet P_((scheme *sc,
                               const char *property))
     OCD ("plist_ut") ;
 
+extern  pointer  plistGetSym P_((scheme *sc,
+                                 pointer symbol,
+                                 pointer property))
+    OCD ("plist_ut") ;
+
 extern  errno_t  plistPut P_((scheme *sc,
                               const char *symbol,
                               const char *property,
                               pointer value))
     OCD ("plist_ut") ;
 
+extern  errno_t  plistPutSym P_((scheme *sc,
+                                 pointer symbol,
+                                 pointer property,
+                                 pointer value))
+    OCD ("plist_ut") ;
+
+extern  pointer  plistSymbol P_((scheme *sc,
+                                 const char *name))
+    OCD ("plist_ut") ;
+
 
 #ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
 }
@@ -16,18 +16,38 @@ Purpose:
     The SCM_UTIL functions fill various shortcomings in the core TinyScheme
     interpreter.
 
+    apply_function(), call_function(), and eval_expression() let C code call
+    the interpreter and get a result back.  The TSION foreign functions
+    follow one rule about such nested calls: a foreign function calls back
+    into the interpreter only for work that the interpreter alone can do,
+    such as allocating a vector (see FUNCS_HTB) or calling a function passed
+    to it by the program, and only through these functions, which preserve
+    the interpreter's return code.  A nested call overwrites the registers
+    holding the foreign function's arguments, so any cells the function
+    still needs afterwards must be protected from the garbage collector
+    beforehand.  Work that the Scheme caller can do itself, such as running
+    the garbage collector before a heap census (see HEAP-PROFILE), is left
+    to the caller.
+
 
 Public Procedures:
 
+    apply_function() - call a Scheme function and return its result.
+    call_function() - call a global Scheme function by name.
+    eval_expression() - evaluate an expression and return its value.
+    global_name() - find the global variable bound to a value.
     mk_bstring() - make a binary string cell.
     mk_port() - make a port cell.
+    mk_ustring() - make an uninitialized string cell.
     string_push() - push a command string onto the input stack.
+    string_shrink() - shorten a string cell in place.
 
 *******************************************************************************/
 
 
 #include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
 
+#include  <limits.h>			/* Maximum/minimum value definitions. */
 #include  <stdio.h>			/* Standard I/O definitions. */
 #include  <stdlib.h>			/* Standard C Library definitions. */
 #include  <string.h>			/* C Library string functions. */
@@ -41,6 +61,378 @@ int  scm_util_debug = 0 ;		/* Global debug switch (1/0 = yes/no). */
 
 /*!*****************************************************************************
 
+Procedure:
+
+    apply_function ()
+
+    Apply a Scheme Function to Arguments.
+
+
+Purpose:
+
+    The apply_function() function calls a Scheme procedure with a list of
+    arguments constructed in C and returns the procedure's result directly
+    to the C caller.  TinyScheme's scheme_call() returns a result, but gives
+    no indication of whether an error occurred; apply_function() checks the
+    interpreter's return code and reports an error as an error status.  The
+    interpreter's return code is left unchanged if the call succeeds.
+
+        args = cons (sc, mk_integer (sc, 1),
+                     cons (sc, mk_integer (sc, 2), sc->NIL)) ;
+        if (apply_function (sc, function, args, &result) == 0)
+            ... use the result ...
+
+    The result is not protected from the garbage collector; it must be put
+    somewhere visible to the collector before the caller allocates any more
+    cells if it is to be kept.
+
+
+    Invocation:
+
+        status = apply_function (sc, function, args, &result) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <function>	- I
+            is the procedure (closure, foreign function, etc.) to call.
+        <args>		- I
+            is the list of arguments to pass to the procedure.
+        <result>	- O
+            returns the value returned by the procedure; NULL is returned
+            if there was an error.
+        <status>	- O
+            returns the status of calling the procedure, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  apply_function (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  function,
+        pointer  args,
+        pointer  *result)
+#    else
+        sc, function, args, result)
+
+        scheme  *sc ;
+        pointer  function ;
+        pointer  args ;
+        pointer  *result ;
+#    endif
+
+{    /* Local variables. */
+    int  retcode ;
+    pointer  value ;
+
+
+
+    *result = NULL ;
+
+    retcode = sc->retcode ;
+    sc->retcode = 0 ;
+
+/* scheme_call() allocates cells before it loads the function and arguments
+   into the interpreter's registers, so load them first to keep them visible
+   to the garbage collector. */
+
+    sc->code = function ;
+    sc->args = args ;
+
+    value = scheme_call (sc, function, args) ;
+
+    if (sc->retcode != 0) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(apply_function) Error calling function %p.\nscheme_call: ",
+            (void *) function) ;
+        return (errno) ;
+    }
+
+    sc->retcode = retcode ;
+    *result = value ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    call_function ()
+
+    Call a Global Scheme Function by Name.
+
+
+Purpose:
+
+    The call_function() function looks up the procedure bound to a global
+    variable and calls it with a list of arguments constructed in C (see
+    apply_function()).  This replaces formatting a "(grab (f ...))" command,
+    loading it with scheme_load_string(), and retrieving the result from
+    TS(sc,grabValue): the arguments need not be converted to text and parsed
+    again, and the result is returned directly, so calls may be nested.
+
+        if (call_function (sc, "assoc",
+                           cons (sc, key, cons (sc, alist, sc->NIL)),
+                           &result) == 0)
+            ... use the result ...
+
+    The argument list is kept visible to the garbage collector (in the
+    interpreter's argument register) while the name is looked up, so the
+    caller can construct the arguments in the call itself, as above.  A C
+    caller that makes the same call repeatedly can look the procedure up
+    once with scheme_eval() and use apply_function() directly.
+
+
+    Invocation:
+
+        status = call_function (sc, name, args, &result) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <name>		- I
+            is the name of the global variable bound to the procedure.
+        <args>		- I
+            is the list of arguments to pass to the procedure.
+        <result>	- O
+            returns the value returned by the procedure; NULL is returned
+            if there was an error.
+        <status>	- O
+            returns the status of calling the procedure, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  call_function (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        const  char  *name,
+        pointer  args,
+        pointer  *result)
+#    else
+        sc, name, args, result)
+
+        scheme  *sc ;
+        char  *name ;
+        pointer  args ;
+        pointer  *result ;
+#    endif
+
+{    /* Local variables. */
+    pointer  function ;
+
+
+
+/* Look up the procedure.  Evaluating a symbol allocates cells only on
+   entry to the evaluator (and on an error), while the argument register
+   is still a garbage collection root. */
+
+    sc->args = args ;
+
+    if (eval_expression (sc, mk_symbol (sc, name), &function)) {
+        *result = NULL ;
+        LGE "(call_function) Error looking up function \"%s\".\neval_expression: ",
+            name) ;
+        return (errno) ;
+    }
+
+/* Call it. */
+
+    if (apply_function (sc, function, args, result)) {
+        LGE "(call_function) Error calling function \"%s\".\napply_function: ",
+            name) ;
+        return (errno) ;
+    }
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    eval_expression ()
+
+    Evaluate a Scheme Expression.
+
+
+Purpose:
+
+    The eval_expression() function evaluates an already-constructed Scheme
+    expression in the global environment and returns its value directly to
+    the C caller.  Like apply_function(), eval_expression() reports an error
+    in the evaluation as an error status and leaves the interpreter's return
+    code unchanged if the evaluation succeeds.
+
+        expression = cons (sc, mk_symbol (sc, "length"),
+                           cons (sc, mk_symbol (sc, "*servers*"), sc->NIL)) ;
+        if (eval_expression (sc, expression, &result) == 0)
+            ... use the result ...
+
+    The result is not protected from the garbage collector (see
+    apply_function()).
+
+
+    Invocation:
+
+        status = eval_expression (sc, expression, &result) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <expression>	- I
+            is the expression to evaluate.
+        <result>	- O
+            returns the value of the expression; NULL is returned if there
+            was an error.
+        <status>	- O
+            returns the status of evaluating the expression, zero if there
+            were no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  eval_expression (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  expression,
+        pointer  *result)
+#    else
+        sc, expression, result)
+
+        scheme  *sc ;
+        pointer  expression ;
+        pointer  *result ;
+#    endif
+
+{    /* Local variables. */
+    int  retcode ;
+    pointer  value ;
+
+
+
+    *result = NULL ;
+
+    retcode = sc->retcode ;
+    sc->retcode = 0 ;
+
+/* As in apply_function(), keep the expression visible to the garbage
+   collector until scheme_eval() loads it. */
+
+    sc->code = expression ;
+
+    value = scheme_eval (sc, expression) ;
+
+    if (sc->retcode != 0) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(eval_expression) Error evaluating expression %p.\nscheme_eval: ",
+            (void *) expression) ;
+        return (errno) ;
+    }
+
+    sc->retcode = retcode ;
+    *result = value ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    global_name ()
+
+    Find the Global Variable Bound to a Value.
+
+
+Purpose:
+
+    The global_name() function searches the interpreter's global environment
+    for a variable bound to a value and returns the variable's name.  Since
+    "(define (f ...) ...)" binds a closure to F, this is useful for putting a
+    name to a procedure in diagnostic output.  The search is linear in the
+    number of global variables, so it should not be used on a fast path.
+
+
+    Invocation:
+
+        name = global_name (sc, value) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <value>		- I
+            is the value to look for.
+        <name>		- O
+            returns the name of the first global variable found bound to the
+            value; NULL is returned if the value is not bound to any global
+            variable.  The name is stored in the variable's symbol cell and
+            should not be modified or freed by the caller.
+
+*******************************************************************************/
+
+
+const  char  *global_name (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  value)
+#    else
+        sc, value)
+
+        scheme  *sc ;
+        pointer  value ;
+#    endif
+
+{    /* Local variables. */
+    long  i, length ;
+    pointer  frame, list, slot ;
+
+
+
+/* The global environment's frame is either a hash table (a vector of
+   association lists) or a single association list of (symbol . value)
+   slots. */
+
+    frame = car (sc->global_env) ;
+
+    if (is_vector (frame)) {
+        length = ivalue (frame) ;
+        for (i = 0 ;  i < length ;  i++) {
+            list = (i % 2) ? cdr (frame + 1 + (i / 2))
+                           : car (frame + 1 + (i / 2)) ;
+            for ( ;  list != sc->NIL ;  list = cdr (list)) {
+                slot = car (list) ;
+                if (cdr (slot) == value)  return (symname (car (slot))) ;
+            }
+        }
+    } else {
+        for (list = frame ;  list != sc->NIL ;  list = cdr (list)) {
+            slot = car (list) ;
+            if (cdr (slot) == value)  return (symname (car (slot))) ;
+        }
+    }
+
+    return (NULL) ;
+
+}
+
+/*!*****************************************************************************
+
 Procedure:
 
     mk_bstring ()
@@ -58,9 +450,12 @@ Purpose:
     immediately after its last character, store_string() will write past
     the end of the allocated string.
 
-    To fix this, mk_bstring() uses memmove(3) instead of strcpy(3).  The
+    To fix this, mk_bstring() allocates an uninitialized string with
+    mk_ustring() and copies the source string into it with memcpy(3).  The
     resulting Scheme value is still a counted string, but the string can
-    contain NUL characters and need not be NUL-terminated.
+    contain NUL characters and need not be NUL-terminated.  (Callers that
+    would fill a temporary buffer just to pass it to mk_bstring() can use
+    mk_ustring() directly and fill the Scheme string itself.)
 
 
     Invocation:
@@ -77,7 +472,8 @@ Purpose:
         <length>	- I
             is the number of bytes in the string.
         <cell>		- O
-            returns a Scheme string containing only the LENGTH bytes of STRING.
+            returns a Scheme string containing only the LENGTH bytes of STRING;
+            #f is returned if the string could not be allocated.
 
 *******************************************************************************/
 
@@ -96,19 +492,15 @@ pointer  mk_bstring (
         size_t  length ;
 #    endif
 
-{
+{    /* Local variables. */
+    pointer  cell ;
 
-/* TinyScheme's get_cell() function is declared "static" in "scheme.c",
-   so a straightforward implementation of mk_bstring() is not possible.
-   Instead, make a counted string using "" as the source string; then
-   copy the actual source string to the Scheme string. */
 
-    pointer  cell = mk_counted_string (sc, "", (int) length) ;
 
-    memmove (strvalue (cell), string, length) ;
+    cell = mk_ustring (sc, length) ;
+    if (cell == NULL)  return (sc->F) ;
 
-    (strvalue (cell))[length] = '\0' ;		/* mk_counted_string() allocates
-						   length + 1 bytes. */
+    memcpy (strvalue (cell), string, length) ;
 
     return (cell) ;
 
@@ -173,6 +565,100 @@ pointer  mk_port (
 
 /*!*****************************************************************************
 
+Procedure:
+
+    mk_ustring ()
+
+    Make an Uninitialized String Cell.
+
+
+Purpose:
+
+    The mk_ustring() function allocates a Scheme string of a given length
+    whose contents are left uninitialized, so that C code can fill in the
+    string directly; e.g., by reading from a network connection into it.
+    If the string turns out to be too long, it can be cut down to size
+    with string_shrink():
+
+        data = mk_ustring (sc, maxLength) ;
+        ... read N (<= maxLength) bytes into strvalue (data) ...
+        string_shrink (sc, data, N) ;
+
+    TinyScheme's get_cell() function is declared "static" in "scheme.c",
+    so a string cell can't be allocated directly.  Instead, mk_ustring()
+    makes a counted string using "" as the source string, which allocates
+    LENGTH+1 bytes without filling them.  The string is NUL-terminated after
+    its last byte; the caller may overwrite any of the LENGTH bytes before
+    the terminator.  If the interpreter fails to allocate the bytes, it
+    substitutes an internal 256-byte buffer; mk_ustring() detects this and
+    detaches the buffer from the new cell, which is left for the garbage
+    collector.
+
+    Since the new cell is not referenced by anything else, it must be put
+    somewhere visible to the garbage collector before the caller allocates
+    any more cells.
+
+
+    Invocation:
+
+        cell = mk_ustring (sc, length) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <length>	- I
+            is the number of bytes in the string.
+        <cell>		- O
+            returns a Scheme string of LENGTH uninitialized bytes; NULL is
+            returned if the string could not be allocated.
+
+*******************************************************************************/
+
+
+pointer  mk_ustring (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        size_t  length)
+#    else
+        sc, length)
+
+        scheme  *sc ;
+        size_t  length ;
+#    endif
+
+{    /* Local variables. */
+    pointer  cell ;
+
+
+
+    if (length > (size_t) INT_MAX - 1) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(mk_ustring) %lu-byte string is too long.\n",
+            (unsigned long) length) ;
+        return (NULL) ;
+    }
+
+    cell = mk_counted_string (sc, "", (int) length) ;
+
+    if (strvalue (cell) == sc->strbuff) {	/* Out of memory? */
+        strvalue (cell) = NULL ;		/* Nothing for GC to free. */
+        strlength (cell) = 0 ;
+        SET_ERRNO (ENOMEM) ;
+        LGE "(mk_ustring) Error allocating %lu-byte string.\n",
+            (unsigned long) length) ;
+        return (NULL) ;
+    }
+
+    (strvalue (cell))[length] = '\0' ;
+
+    return (cell) ;
+
+}
+
+/*!*****************************************************************************
+
 Procedure:
 
     string_push ()
@@ -233,3 +719,84 @@ bool  string_push (
     return (true) ;
 
 }
+
+/*!*****************************************************************************
+
+Procedure:
+
+    string_shrink ()
+
+    Shorten a String Cell in Place.
+
+
+Purpose:
+
+    The string_shrink() function cuts a Scheme string down to its first
+    LENGTH bytes and NUL-terminates it; it is meant for strings allocated
+    by mk_ustring() and only partially filled.  If more than SCM_SHRINK_SLACK
+    bytes are freed up and the interpreter allocates memory with malloc(3),
+    the string's storage is also reallocated to its new size, so that a
+    short read into a large buffer doesn't tie up the whole buffer for the
+    life of the string.  (TinyScheme has no reallocation hook, so strings
+    allocated by a custom allocator keep their storage.)
+
+
+    Invocation:
+
+        status = string_shrink (sc, cell, length) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <cell>		- I
+            is the Scheme string.
+        <length>	- I
+            is the new length of the string, which must not exceed the
+            string's current length.
+        <status>	- O
+            returns the status of shortening the string, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  string_shrink (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  cell,
+        size_t  length)
+#    else
+        sc, cell, length)
+
+        scheme  *sc ;
+        pointer  cell ;
+        size_t  length ;
+#    endif
+
+{    /* Local variables. */
+    char  *storage ;
+
+
+
+    if (!is_string (cell) || (length > (size_t) strlength (cell))) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(string_shrink) Invalid string or length %lu.\n",
+            (unsigned long) length) ;
+        return (errno) ;
+    }
+
+    if ((((size_t) strlength (cell) - length) > SCM_SHRINK_SLACK) &&
+        (sc->malloc == (func_alloc) malloc) &&
+        (sc->free == (func_dealloc) free)) {
+        storage = (char *) realloc (strvalue (cell), length + 1) ;
+        if (storage != NULL)  strvalue (cell) = storage ;
+    }
+
+    strlength (cell) = (int) length ;
+    (strvalue (cell))[length] = '\0' ;
+
+    return (0) ;
+
+}
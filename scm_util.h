@@ -43,6 +43,17 @@ extern  "C"  {
 #define  strvalue(p)  ((p)->_object._string._svalue)
 #define  strlength(p)  ((p)->_object._string._length)
 
+/* A vector's length is stored in its first cell and its elements in the CARs
+   and CDRs of the consecutive cells that follow. */
+
+#define  vector_length(v)  ((v)->_object._number.value.ivalue)
+#define  vector_cell(v, i)  ((v) + 1 + ((i) / 2))
+#define  vector_elem(v, i)	\
+	(((i) % 2) ? cdr (vector_cell ((v), (i))) : car (vector_cell ((v), (i))))
+#define  set_vector_elem(v, i, x)	\
+	(*(((i) % 2) ? &cdr (vector_cell ((v), (i)))	\
+	             : &car (vector_cell ((v), (i)))) = (x))
+
 typedef  enum  scheme_types {
     T_STRING=1,
     T_NUMBER=2,
@@ -89,6 +100,12 @@ typedef  enum  scheme_types {
         (cons ((sc), cons ((sc), (x), (y)), (z)))
 
 
+				/* Unused bytes string_shrink() leaves in place. */
+#ifndef SCM_SHRINK_SLACK
+#    define  SCM_SHRINK_SLACK  256
+#endif
+
+
 /*******************************************************************************
     Miscellaneous declarations.
 *******************************************************************************/
@@ -101,6 +118,27 @@ extern  int  scm_util_debug  OCD ("scm_util") ;
     Public functions.
 *******************************************************************************/
 
+extern  errno_t  apply_function P_((scheme *sc,
+                                    pointer function,
+                                    pointer args,
+                                    pointer *result))
+    OCD ("scm_util") ;
+
+extern  errno_t  call_function P_((scheme *sc,
+                                   const char *name,
+                                   pointer args,
+                                   pointer *result))
+    OCD ("scm_util") ;
+
+extern  errno_t  eval_expression P_((scheme *sc,
+                                     pointer expression,
+                                     pointer *result))
+    OCD ("scm_util") ;
+
+extern  const  char  *global_name P_((scheme *sc,
+                                      pointer value))
+    OCD ("scm_util") ;
+
 extern  pointer  mk_bstring P_((scheme *sc,
                                 const char *string,
                                 size_t length))
@@ -110,10 +148,19 @@ extern  pointer  mk_port P_((scheme *sc,
                              port *pyort))
     OCD ("scm_util") ;
 
+extern  pointer  mk_ustring P_((scheme *sc,
+                                size_t length))
+    OCD ("scm_util") ;
+
 extern  bool  string_push P_((scheme *sc,
                               const char *command))
     OCD ("scm_util") ;
 
+extern  errno_t  string_shrink P_((scheme *sc,
+                                   pointer cell,
+                                   size_t length))
+    OCD ("scm_util") ;
+
 
 #ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
 }
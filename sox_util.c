@@ -0,0 +1,4026 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    sox_util.c
+
+    Scheme I/O Event Dispatcher Utilities.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The SOX_UTIL package keeps TSION's per-dispatcher state alongside the
+    IOX_UTIL I/O event dispatchers created by Scheme programs.  Foremost,
+    this state is a hierarchical timing wheel (see TWL_UTIL) that takes the
+    place of the dispatcher's own timer list for IOX-AFTER and IOX-EVERY
+    timers, so that registering, canceling, and rescheduling a timer take
+    constant time no matter how many timers are outstanding.
+
+    The wheel is driven by a single IOX timer, the "tick", which is armed
+    for the wheel's next expiration.  When the tick fires, the wheel's
+    expired timers are fired and the tick is re-armed.  Registering a timer
+    only re-arms the tick if the new timer expires before the tick does.
+    Because the wheel rounds expirations to its resolution, timers that
+    expire close together are fired by the same tick.
+
+    The per-dispatcher state also holds a queue of deferred work (see
+    soxDefer()).  Callbacks that only need to note that something happened,
+    such as the members of an IOX-ONIO-GROUP, queue a node; the queue is
+    flushed by a zero-delay IOX timer, which the dispatcher fires at the
+    start of its next iteration, after all the I/O events detected in the
+    current iteration have been dispatched.
+
+        #include  "sox_util.h"			-- Scheme dispatcher utilities.
+        TwlTimer  timer ;
+        ...
+        timer = soxAfter (dispatcher, myHandler, myData, 2.5) ;
+        ...
+        soxReschedule (dispatcher, timer, 5.0) ;
+        ...
+        soxDetach (dispatcher) ;
+        ioxDestroy (dispatcher) ;
+
+    Each time the tick fires, its lateness - the time between when it was
+    due and when the dispatcher actually got around to firing it - is
+    recorded as a sample of the dispatcher's event-loop lag.  soxLag()
+    returns the median, 99th percentile, and maximum lag.  A dispatcher
+    without application timers can be given a periodic "probe" timer
+    (see soxProbe()) so that lag is sampled regularly.
+
+    Stalls - the event loop not getting back to the dispatcher for a long
+    time - are caught by a watchdog thread.  Applications bracket each
+    callback with soxEnter() and soxLeave(); if a dispatcher has a watchdog
+    threshold (see soxSetWatchdog()) and its innermost callback has been
+    running longer than the threshold, the watchdog writes a report to
+    standard error naming the callback and, if the interpreter is inside
+    one, the foreign (C) function being executed.  The watchdog never looks
+    at the interpreter itself; the foreign function is known only if its
+    name was noted on the dispatcher's thread with soxForeign(), which the
+    TEV_UTIL trampoline does for every foreign function it wraps (see
+    tevNameForeign()).  (Platforms without POSIX threads get the lag
+    statistics, but not the watchdog.)
+
+    Finally, a dispatcher can be given a mailbox (see soxMailbox()) through
+    which other threads hand work to the thread running the dispatcher.
+    soxPost(), which may be called from any thread, queues a function and
+    its argument in the mailbox and, if the mailbox was empty, wakes the
+    dispatcher by writing to an eventfd(2) (a pipe on systems without
+    eventfd).  When the dispatcher sees the wakeup, it runs everything
+    posted so far, in order, so a burst of posts costs a single wakeup.
+
+        soxMailbox (dispatcher) ;		-- In the dispatcher's thread.
+        ...
+        soxPost (dispatcher, lookupDoneCB, request) ;	-- In a helper thread.
+
+    Signals are also delivered through the dispatcher (see soxOnSignal()).
+    A watched signal is blocked and read from a signalfd(2) registered with
+    the dispatcher; on systems without signalfd, a signal handler writes the
+    signal number to a non-blocking pipe instead.  Either way, the watchers'
+    handlers run in the dispatcher's thread, between other callbacks, and
+    any number of deliveries of a signal detected in one iteration of the
+    dispatcher are coalesced into one call to each watcher.  Since a signal
+    is delivered to a process only once, a signal should be watched through
+    a single dispatcher.  Threads created by the application should block
+    the watched signals; the SOX_UTIL watchdog thread and the TEV_UTIL writer
+    thread block all signals.
+
+    The activities also drive a sampling allocation profiler (see
+    soxProfile()).  TinyScheme's cell allocator is internal to the
+    interpreter and has no hook, so the profiler checks the interpreter's
+    count of free cells whenever an activity is entered or left, charging
+    the cells allocated since the last check to the stack of activities in
+    progress.  Every <period> cells, the stack is sampled: it is folded into
+    a string such as "iox-post:start-lookup;iox-onio:handle-reply" and the
+    cells are added to the stack's total.  The totals can be written out in the
+    "folded stacks" format read by flame-graph tools:
+
+        soxProfile (dispatcher, 10000) ;	-- Sample every 10,000 cells.
+        ... run the dispatcher ...
+        soxProfileWrite (dispatcher, file) ;
+
+    The allocations of a callback during which the garbage collector runs
+    can't be counted exactly, since the collection returns cells to the
+    free list; only the cells allocated before the collection are charged.
+
+    An application with its own main loop can run a dispatcher in bounded
+    slices with soxRunSlice(), which returns after a given number of events
+    (callbacks bracketed with soxEnter()) or a given time, whichever comes
+    first, along with the time until the dispatcher's next timer is due.
+    IOX_UTIL dispatches every ready source in an iteration, so a callback
+    for a level-triggered I/O source should check soxSliceDone() and simply
+    return if the slice's budget is spent; the source is still ready and is
+    dispatched again in the next slice.
+
+        while (running) {
+            soxRunSlice (dispatcher, 100, 0.002, &handled, &next) ;
+            ... render a frame ...
+        }
+
+    The per-dispatcher state is created on demand and must be released by
+    calling soxDetach() before the dispatcher itself is destroyed.
+
+
+Public Procedures:
+
+    soxAfter() - registers a single-shot wheel timer.
+    soxCancelSignal() - stops watching a signal.
+    soxDefer() - queues deferred work.
+    soxDetach() - releases a dispatcher's TSION state.
+    soxEnter() - notes the start of a callback.
+    soxEvery() - registers a periodic wheel timer.
+    soxFlush() - runs the deferred work queued so far.
+    soxForeign() - notes the foreign function being executed.
+    soxLag() - returns a dispatcher's event-loop lag statistics.
+    soxLeave() - notes the end of a callback.
+    soxMailbox() - opens a dispatcher's mailbox.
+    soxOnSignal() - watches for a signal.
+    soxPost() - posts work to a dispatcher's mailbox.
+    soxProbe() - sets up a periodic timer for sampling lag.
+    soxProfile() - starts or stops the allocation profiler.
+    soxProfileStack() - returns a stack sampled by the allocation profiler.
+    soxProfileWrite() - writes the allocation profile as folded stacks.
+    soxProfiling() - returns a dispatcher's allocation sampling period.
+    soxReschedule() - reschedules a wheel timer.
+    soxRunSlice() - monitors a dispatcher within event and time budgets.
+    soxSerial() - issues a serial number.
+    soxSetSlow() - sets a dispatcher's slow-callback threshold.
+    soxSetWatchdog() - sets a dispatcher's stall threshold.
+    soxSliceDone() - checks if a slice's budget has been spent.
+    soxSlow() - returns a dispatcher's slow-callback threshold.
+    soxUndefer() - removes deferred work from the queue.
+    soxWatchdog() - returns a dispatcher's stall threshold.
+    soxWheel() - returns a dispatcher's timing wheel.
+
+Private Procedures:
+
+    soxArm() - arms the dispatcher timer that drives the wheel.
+    soxCharge() - charges an activity's allocations to the profile.
+    soxCompare() - compares two lag samples for qsort(3).
+    soxFind() - looks up (or creates) a dispatcher's TSION state.
+    soxFlushCB() - runs the deferred work queued before the flush.
+    soxMailboxCB() - runs the work posted to a mailbox.
+    soxProbeCB() - handles the lag probe timer.
+    soxReport() - reports a stalled dispatcher.
+    soxSample() - records a sample of the stack of activities.
+    soxSignalCB() - delivers the signals received by a dispatcher.
+    soxSignalFree() - deallocates a signal watcher.
+    soxSignalHandler() - forwards a signal to a dispatcher's pipe.
+    soxTickCB() - runs the wheel when the dispatcher timer fires.
+    soxWatchdogThread() - watches dispatchers for stalls.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <signal.h>			/* Signal definitions. */
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <string.h>			/* C Library string functions. */
+#ifndef HAVE_PTHREADS			/* Watchdog thread supported? */
+#    if defined(_WIN32) || defined(NDS)
+#        define  HAVE_PTHREADS  0
+#    else
+#        define  HAVE_PTHREADS  1
+#    endif
+#endif
+#ifndef HAVE_EVENTFD			/* Mailbox wakeup via eventfd(2)? */
+#    if defined(__linux__)
+#        define  HAVE_EVENTFD  1
+#    else
+#        define  HAVE_EVENTFD  0
+#    endif
+#endif
+#ifndef HAVE_SIGNALFD			/* Signals via signalfd(2)? */
+#    if defined(__linux__)
+#        define  HAVE_SIGNALFD  1
+#    else
+#        define  HAVE_SIGNALFD  0
+#    endif
+#endif
+#if HAVE_PTHREADS
+#    include  <fcntl.h>			/* File control definitions. */
+#    include  <pthread.h>		/* POSIX threads. */
+#    include  <unistd.h>		/* UNIX-specific definitions. */
+#    if HAVE_EVENTFD
+#        include  <sys/eventfd.h>	/* Event file descriptors. */
+#    endif
+#    if HAVE_SIGNALFD
+#        include  <sys/signalfd.h>	/* Signal file descriptors. */
+#    endif
+#endif
+#include  "tv_util.h"			/* "timeval" manipulation functions. */
+#include  "gc_util.h"			/* Garbage collection utilities. */
+#include  "scm_util.h"			/* Scheme utilities. */
+#include  "sox_util.h"			/* Scheme dispatcher utilities. */
+#include  "tev_util.h"			/* Trace-event timelines. */
+
+
+int  sox_util_debug = 0 ;		/* Global debug switch (1/0 = yes/no). */
+#undef  I_DEFAULT_GUARD
+#define  I_DEFAULT_GUARD  sox_util_debug
+
+
+/*******************************************************************************
+    SoxPost - work posted to a dispatcher's mailbox.
+*******************************************************************************/
+
+typedef  struct  SoxPost {
+    struct  SoxPost  *next ;		/* Link in mailbox. */
+    SoxPostFunc  func ;			/* Function to run. */
+    void  *userData ;			/* Arbitrary data passed to function. */
+}  SoxPost ;
+
+
+/*******************************************************************************
+    SoxSignal - a watcher for a signal.
+*******************************************************************************/
+
+typedef  struct  _SoxSignal {
+    struct  _SoxSignal  *next ;		/* Link in dispatcher's watchers. */
+    struct  _SoxDispatcher  *sd ;	/* Dispatcher state. */
+    int  signo ;			/* Signal being watched. */
+    SoxSignalFunc  handler ;		/* Function to call on signal. */
+    void  *userData ;			/* Arbitrary data passed to handler. */
+    bool  dead ;			/* Canceled during delivery? */
+}  _SoxSignal ;
+
+					/* Signals numbered 1..SOX_SIGNALS-1. */
+#ifdef NSIG
+#    define  SOX_SIGNALS  NSIG
+#else
+#    define  SOX_SIGNALS  65
+#endif
+
+/* Per-process signal state: the number of watchers of each signal (across
+   all dispatchers) and, for the signal-handler fallback, the pipe to which
+   each signal is forwarded and the signal's original disposition. */
+
+#if HAVE_PTHREADS
+    static  int  signalWatchers[SOX_SIGNALS] ;
+#    if !HAVE_SIGNALFD
+    static  volatile  int  signalPipe[SOX_SIGNALS] ;
+    static  struct  sigaction  signalAction[SOX_SIGNALS] ;
+#    endif
+#endif
+
+
+/*******************************************************************************
+    SoxStack - a stack of activities sampled by the allocation profiler and
+        the cells charged to it.
+*******************************************************************************/
+
+typedef  struct  SoxStack {
+    char  *frames ;			/* Folded stack, "<outer>;...;<inner>". */
+    unsigned  long  cells ;		/* Cells charged to the stack. */
+    unsigned  long  samples ;		/* Number of samples. */
+}  SoxStack ;
+
+
+/*******************************************************************************
+    SoxDispatcher - TSION state attached to an IOX dispatcher.
+*******************************************************************************/
+
+typedef  struct  _SoxDispatcher {
+    struct  _SoxDispatcher  *next ;	/* Link in list of dispatchers. */
+    IoxDispatcher  dispatcher ;		/* IOX dispatcher. */
+    TwlWheel  wheel ;			/* Timing wheel for IOX-AFTER/EVERY. */
+    IoxCallback  tick ;			/* IOX timer driving the wheel. */
+    struct  timeval  tickTime ;		/* Time at which tick is due. */
+    IoxCallback  ticking ;		/* IOX timer that last ran the wheel. */
+    bool  running ;			/* Running the wheel? */
+    bool  detached ;			/* Detached while running the wheel? */
+    SoxDeferred  *deferred ;		/* Queue of deferred work ... */
+    SoxDeferred  *lastDeferred ;	/* ... in order of queueing. */
+    IoxCallback  flush ;		/* IOX timer flushing the queue. */
+    unsigned  long  generation ;	/* Flush counter. */
+    double  slow ;			/* Slow-callback threshold (seconds). */
+    TwlTimer  probe ;			/* Periodic timer for sampling lag. */
+    double  lag[SOX_LAG_SAMPLES] ;	/* Ring of recent lag samples. */
+    unsigned  long  lagCount ;		/* Number of samples taken. */
+    double  lagMax ;			/* Maximum lag sampled. */
+    SoxActivity  *active ;		/* Innermost callback in progress. */
+    double  watchdog ;			/* Stall threshold (seconds). */
+    bool  mailboxOpen ;			/* Is the mailbox open? */
+    int  wakeup[2] ;			/* Wakeup descriptors (read, write). */
+    IoxCallback  mailbox ;		/* IOX callback for wakeups. */
+    SoxPost  *posts ;			/* Queue of posted work ... */
+    SoxPost  *lastPost ;		/* ... in order of posting. */
+    SoxSignal  signals ;		/* Signal watchers. */
+    int  signalFd[2] ;			/* Signal descriptors (read, write). */
+    IoxCallback  signalCB ;		/* IOX callback for signals. */
+    bool  delivering ;			/* Delivering signals? */
+    unsigned  long  events ;		/* Number of callbacks entered. */
+    bool  slicing ;			/* Running in soxRunSlice()? */
+    long  sliceEvents ;			/* Event budget; -1 if none. */
+    unsigned  long  sliceFirst ;	/* Event count when slice began. */
+    double  sliceTime ;			/* Time budget; -1.0 if none. */
+    struct  timeval  sliceEnd ;		/* Time at which slice ends. */
+    struct  timeval  idleSince ;	/* Time last top-level callback left. */
+    unsigned  long  serial ;		/* Last serial number issued. */
+    long  profPeriod ;			/* Cells per sample; 0 if not profiling. */
+    long  profCountdown ;		/* Cells until the next sample. */
+    SoxStack  *stacks ;			/* Stacks sampled so far. */
+    long  numStacks ;			/* # of stacks sampled. */
+    long  maxStacks ;			/* Size of stack array. */
+}  _SoxDispatcher, *SoxDispatcher ;
+
+					/* Longest wait in one pass of a slice. */
+#ifndef SOX_SLICE_QUANTUM
+#    define  SOX_SLICE_QUANTUM  0.001
+#endif
+
+static  SoxDispatcher  dispatcherList = NULL ;
+static  SoxDispatcher  lastFound = NULL ;
+
+/* The watchdog thread scans the dispatcher list and the dispatchers' stacks
+   of activities, and soxPost() scans the list and queues work in mailboxes.
+   The main thread holds the mutex when changing any of these; the fast path
+   of soxFind(), through the last-found cache, is only used by the main
+   thread and needs no locking. */
+
+#if HAVE_PTHREADS
+    static  pthread_mutex_t  soxMutex = PTHREAD_MUTEX_INITIALIZER ;
+    static  bool  watchdogStarted = false ;
+#    define  SOX_LOCK  pthread_mutex_lock (&soxMutex)
+#    define  SOX_UNLOCK  pthread_mutex_unlock (&soxMutex)
+#else
+#    define  SOX_LOCK
+#    define  SOX_UNLOCK
+#endif
+
+
+/*******************************************************************************
+    Private functions.
+*******************************************************************************/
+
+static  void  soxArm P_((SoxDispatcher sd)) ;
+
+static  void  soxCharge P_((SoxDispatcher sd,
+                            SoxActivity *activity)) ;
+
+static  int  soxCompare P_((const void *p1,
+                            const void *p2)) ;
+
+static  SoxDispatcher  soxFind P_((IoxDispatcher dispatcher,
+                                   bool create)) ;
+
+static  errno_t  soxFlushCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+static  errno_t  soxMailboxCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+static  errno_t  soxProbeCB P_((TwlTimer timer,
+                                IoxReason reason,
+                                void *userData)) ;
+
+static  void  soxReport P_((SoxDispatcher sd,
+                            SoxActivity *activity,
+                            double elapsed)) ;
+
+static  void  soxSample P_((SoxDispatcher sd,
+                            SoxActivity *activity,
+                            long samples)) ;
+
+static  errno_t  soxSignalCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+static  void  soxSignalFree P_((SoxSignal watcher)) ;
+
+#if HAVE_PTHREADS && !HAVE_SIGNALFD
+    static  void  soxSignalHandler P_((int signo)) ;
+#endif
+
+static  errno_t  soxTickCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+#if HAVE_PTHREADS
+    static  void  *soxWatchdogThread P_((void *arg)) ;
+#endif
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxAfter ()
+
+    Register a Single-Shot Wheel Timer.
+
+
+Purpose:
+
+    Function soxAfter() registers a single-shot timer with a dispatcher's
+    timing wheel.  See twlAfter() for the handler's calling sequence.
+
+
+    Invocation:
+
+        timer = soxAfter (dispatcher, handler, userData, delay) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <handler>	- I
+            is the function to be called when the timer fires.
+        <userData>	- I
+            is an arbitrary (VOID *) value passed to the handler.
+        <delay>		- I
+            is the delay in seconds (fractional seconds allowed).
+        <timer>		- O
+            returns a handle for the timer; NULL is returned in the event
+            of an error.
+
+*******************************************************************************/
+
+
+TwlTimer  soxAfter (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        TwlHandler  handler,
+        void  *userData,
+        double  delay)
+#    else
+        dispatcher, handler, userData, delay)
+
+        IoxDispatcher  dispatcher ;
+        TwlHandler  handler ;
+        void  *userData ;
+        double  delay ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+    TwlTimer  timer ;
+
+
+
+    sd = soxFind (dispatcher, true) ;
+    if (sd == NULL) {
+        LGE "(soxAfter) Error attaching to dispatcher %p.\nsoxFind: ",
+            (void *) dispatcher) ;
+        return (NULL) ;
+    }
+
+    timer = twlAfter (sd->wheel, handler, userData, delay) ;
+    if (timer == NULL) {
+        LGE "(soxAfter) Error registering timer.\ntwlAfter: ") ;
+        return (NULL) ;
+    }
+
+    soxArm (sd) ;
+
+    return (timer) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxCancelSignal ()
+
+    Stop Watching a Signal.
+
+
+Purpose:
+
+    Function soxCancelSignal() cancels a signal watcher; the watcher's
+    handler is called with reason IoxCancel.  If the watcher is canceled
+    while signals are being delivered (e.g., from within a handler), the
+    handler is not called again and the watcher is deallocated after the
+    delivery is complete.  When the last watcher of a signal is canceled,
+    the signal's original handling is restored.
+
+
+    Invocation:
+
+        status = soxCancelSignal (watcher) ;
+
+    where
+
+        <watcher>	- I
+            is the handle returned by soxOnSignal().
+        <status>	- O
+            returns the status of canceling the watcher, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxCancelSignal (
+
+#    if PROTOTYPES
+        SoxSignal  watcher)
+#    else
+        watcher)
+
+        SoxSignal  watcher ;
+#    endif
+
+{
+
+    if ((watcher == NULL) || watcher->dead) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(soxCancelSignal) Invalid or canceled watcher.\n") ;
+        return (errno) ;
+    }
+
+    if (watcher->sd->delivering)
+        watcher->dead = true ;
+    else
+        soxSignalFree (watcher) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxDefer ()
+
+    Queue Deferred Work.
+
+
+Purpose:
+
+    Function soxDefer() queues a node of deferred work with a dispatcher.
+    At the start of the dispatcher's next iteration, the node is removed
+    from the queue and its function is called with the node's user data.
+    Queueing a node that is already queued has no effect.  Nodes queued
+    by a deferred function are run in the following iteration, so work
+    that keeps requeueing itself does not starve I/O.
+
+
+    Invocation:
+
+        status = soxDefer (dispatcher, node) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <node>		- I
+            is the caller-allocated node, whose function and user data
+            fields have been filled in.  The node must remain allocated
+            until it has run or been removed with soxUndefer().
+        <status>	- O
+            returns the status of queueing the node, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxDefer (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        SoxDeferred  *node)
+#    else
+        dispatcher, node)
+
+        IoxDispatcher  dispatcher ;
+        SoxDeferred  *node ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    if (node->queued)  return (0) ;
+
+    sd = soxFind (dispatcher, true) ;
+    if (sd == NULL) {
+        LGE "(soxDefer) Error attaching to dispatcher %p.\nsoxFind: ",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+/* Arm the flush timer if it isn't already. */
+
+    if (sd->flush == NULL) {
+        sd->flush = ioxAfter (dispatcher, soxFlushCB, sd, 0.0) ;
+        if (sd->flush == NULL) {
+            LGE "(soxDefer) Error arming flush for dispatcher %p.\nioxAfter: ",
+                (void *) dispatcher) ;
+            return (errno) ;
+        }
+    }
+
+/* Append the node to the queue. */
+
+    node->next = NULL ;
+    node->prev = sd->lastDeferred ;
+    if (sd->lastDeferred == NULL)
+        sd->deferred = node ;
+    else
+        sd->lastDeferred->next = node ;
+    sd->lastDeferred = node ;
+    node->queued = true ;
+    node->generation = sd->generation ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxDetach ()
+
+    Release a Dispatcher's TSION State.
+
+
+Purpose:
+
+    Function soxDetach() cancels the timers in a dispatcher's timing wheel
+    (their handlers are invoked with reason IoxCancel), cancels the timer
+    driving the wheel, discards any queued deferred work (without running
+    it, but calling the discard functions of the nodes that have them),
+    closes the mailbox (calling the functions posted to it with reason
+    IoxCancel), cancels the dispatcher's signal watchers, and releases the
+    TSION state attached to the dispatcher.  soxDetach() should be called
+    before ioxDestroy() destroys the dispatcher.  Other threads must not
+    post to the dispatcher once it is being destroyed; posts that arrive
+    after soxDetach() are rejected.  If soxDetach() is called from a timer
+    handler while the dispatcher's wheel is running, freeing the state is
+    deferred until the wheel stops running.
+
+
+    Invocation:
+
+        status = soxDetach (dispatcher) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <status>	- O
+            returns the status of detaching from the dispatcher, zero if
+            there were no errors and ERRNO otherwise.  Detaching from a
+            dispatcher without any TSION state is not an error.
+
+*******************************************************************************/
+
+
+errno_t  soxDetach (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher)
+#    else
+        dispatcher)
+
+        IoxDispatcher  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    IoxCallback  tick ;
+    SoxDeferred  *node ;
+    SoxDispatcher  prev, sd ;
+    SoxPost  *post ;
+
+
+
+    sd = soxFind (dispatcher, false) ;
+    if (sd == NULL)  return (0) ;
+
+    LGI "(soxDetach) Dispatcher %p, %lu timers.\n",
+        (void *) dispatcher, (unsigned long) twlCount (sd->wheel)) ;
+
+/* Cancel the wheel's timers. */
+
+    twlDestroy (sd->wheel) ;
+    sd->wheel = NULL ;
+
+/* Cancel the IOX timer driving the wheel. */
+
+    tick = sd->tick ;
+    sd->tick = NULL ;
+    if (tick != NULL)  ioxCancel (tick) ;
+
+/* Discard the queue of deferred work; the nodes belong to the application,
+   which may free a node in its discard function. */
+
+    while ((node = sd->deferred) != NULL) {
+        sd->deferred = node->next ;
+        node->next = node->prev = NULL ;
+        node->queued = false ;
+        if (node->discard != NULL)  node->discard (node->userData) ;
+    }
+    sd->lastDeferred = NULL ;
+
+    tick = sd->flush ;
+    sd->flush = NULL ;
+    if (tick != NULL)  ioxCancel (tick) ;
+
+/* Unlink the dispatcher state, after which no more work can be posted to
+   the mailbox. */
+
+    SOX_LOCK ;
+    if (dispatcherList == sd) {
+        dispatcherList = sd->next ;
+    } else {
+        for (prev = dispatcherList ;  prev->next != sd ;  prev = prev->next)
+            ;
+        prev->next = sd->next ;
+    }
+    SOX_UNLOCK ;
+
+/* Close the mailbox and discard the work posted to it; each function is
+   called with reason IoxCancel so that it can release its data. */
+
+    tick = sd->mailbox ;
+    sd->mailbox = NULL ;
+    if (tick != NULL)  ioxCancel (tick) ;
+
+#if HAVE_PTHREADS
+    if (sd->wakeup[0] >= 0)  close (sd->wakeup[0]) ;
+    if ((sd->wakeup[1] >= 0) && (sd->wakeup[1] != sd->wakeup[0]))
+        close (sd->wakeup[1]) ;
+#endif
+
+    while ((post = sd->posts) != NULL) {
+        sd->posts = post->next ;
+        post->func (IoxCancel, post->userData) ;
+        free (post) ;
+    }
+
+/* Stop watching signals. */
+
+    while (sd->signals != NULL)
+        soxSignalFree (sd->signals) ;
+
+    tick = sd->signalCB ;
+    sd->signalCB = NULL ;
+    if (tick != NULL)  ioxCancel (tick) ;
+
+#if HAVE_PTHREADS
+    if (sd->signalFd[0] >= 0)  close (sd->signalFd[0]) ;
+    if ((sd->signalFd[1] >= 0) && (sd->signalFd[1] != sd->signalFd[0]))
+        close (sd->signalFd[1]) ;
+#endif
+
+/* Discard the allocation profile. */
+
+    while (sd->numStacks > 0)
+        free (sd->stacks[--sd->numStacks].frames) ;
+    if (sd->stacks != NULL)  free (sd->stacks) ;
+
+/* Free the dispatcher state, unless the wheel is running, in which case
+   soxTickCB() frees it (see the notes there). */
+
+    if (lastFound == sd)  lastFound = NULL ;
+
+    if (sd->running)
+        sd->detached = true ;
+    else
+        free (sd) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxEnter ()
+
+    Note the Start of a Callback.
+
+
+Purpose:
+
+    Function soxEnter() pushes a record describing a callback onto the
+    dispatcher's stack of callbacks in progress, where the stall watchdog
+    can see it.  The caller fills in the kind, name, and interpreter fields
+    of the record; soxEnter() sets the rest.  The record must remain valid
+    until the matching call to soxLeave().
+
+
+    Invocation:
+
+        status = soxEnter (dispatcher, activity) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <activity>	- I/O
+            is the record describing the callback.
+        <status>	- O
+            returns the status of noting the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxEnter (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        SoxActivity  *activity)
+#    else
+        dispatcher, activity)
+
+        IoxDispatcher  dispatcher ;
+        SoxActivity  *activity ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, true) ;
+    if (sd == NULL) {
+        LGE "(soxEnter) Error attaching to dispatcher %p.\nsoxFind: ",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+    activity->start = tvTOD () ;
+    activity->cells = (activity->sc == NULL) ? 0 : activity->sc->fcells ;
+    activity->mark = activity->cells ;
+    activity->collections = (activity->sc == NULL)
+                            ? 0 : gc_collections (activity->sc) ;
+    activity->foreign = NULL ;
+    activity->reported = false ;
+    sd->events++ ;
+
+/* If the allocation profiler is running, charge the enclosing activity for
+   its allocations up to this point; the new activity is charged from here
+   on. */
+
+    if ((sd->profPeriod > 0) && (sd->active != NULL))
+        soxCharge (sd, sd->active) ;
+
+/* When a timeline is being recorded, the gap between top-level callbacks
+   outside of a slice is time spent in the dispatcher, mostly waiting. */
+
+    if ((sd->active == NULL) && !sd->slicing &&
+        (sd->idleSince.tv_sec != 0) && tevActive ())
+        tevSpan ("dispatcher", "wait", sd->idleSince, -1) ;
+
+    SOX_LOCK ;
+    activity->prev = sd->active ;
+    sd->active = activity ;
+    SOX_UNLOCK ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxEvery ()
+
+    Register a Periodic Wheel Timer.
+
+
+Purpose:
+
+    Function soxEvery() registers a periodic timer with a dispatcher's
+    timing wheel.  See twlEvery() for the handler's calling sequence.
+
+
+    Invocation:
+
+        timer = soxEvery (dispatcher, handler, userData, delay, interval) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <handler>	- I
+            is the function to be called when the timer fires.
+        <userData>	- I
+            is an arbitrary (VOID *) value passed to the handler.
+        <delay>		- I
+            is the initial delay in seconds.
+        <interval>	- I
+            is the periodic interval in seconds.
+        <timer>		- O
+            returns a handle for the timer; NULL is returned in the event
+            of an error.
+
+*******************************************************************************/
+
+
+TwlTimer  soxEvery (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        TwlHandler  handler,
+        void  *userData,
+        double  delay,
+        double  interval)
+#    else
+        dispatcher, handler, userData, delay, interval)
+
+        IoxDispatcher  dispatcher ;
+        TwlHandler  handler ;
+        void  *userData ;
+        double  delay ;
+        double  interval ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+    TwlTimer  timer ;
+
+
+
+    sd = soxFind (dispatcher, true) ;
+    if (sd == NULL) {
+        LGE "(soxEvery) Error attaching to dispatcher %p.\nsoxFind: ",
+            (void *) dispatcher) ;
+        return (NULL) ;
+    }
+
+    timer = twlEvery (sd->wheel, handler, userData, delay, interval) ;
+    if (timer == NULL) {
+        LGE "(soxEvery) Error registering timer.\ntwlEvery: ") ;
+        return (NULL) ;
+    }
+
+    soxArm (sd) ;
+
+    return (timer) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxFlush ()
+
+    Run the Deferred Work Queued So Far.
+
+
+Purpose:
+
+    Function soxFlush() runs the deferred work queued with a dispatcher,
+    without waiting for the dispatcher's next iteration.  As with the flush
+    at the start of an iteration, only the nodes queued before the call are
+    run; nodes queued by the functions being run are left for the next
+    flush.  soxFlush() is intended for drivers, such as a trace replay,
+    that call an application's callbacks directly rather than through the
+    dispatcher.
+
+
+    Invocation:
+
+        status = soxFlush (dispatcher, &count) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <count>		- O
+            returns the number of nodes run; NULL can be specified if the
+            count is not needed.
+        <status>	- O
+            returns the status of running the work, zero if there were no
+            errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxFlush (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        long  *count)
+#    else
+        dispatcher, count)
+
+        IoxDispatcher  dispatcher ;
+        long  *count ;
+#    endif
+
+{    /* Local variables. */
+    long  numRun ;
+    SoxDeferred  *node ;
+    SoxDispatcher  sd ;
+    unsigned  long  generation ;
+
+
+
+    if (count != NULL)  *count = 0 ;
+
+    sd = soxFind (dispatcher, false) ;
+    if (sd == NULL)  return (0) ;
+
+/* Run the nodes queued before this flush.  Each node is unlinked before its
+   function is called, so the function may requeue it or remove other nodes. */
+
+    generation = sd->generation++ ;
+    numRun = 0 ;
+
+    while (((node = sd->deferred) != NULL) && (node->generation == generation)) {
+        sd->deferred = node->next ;
+        if (sd->deferred == NULL)
+            sd->lastDeferred = NULL ;
+        else
+            sd->deferred->prev = NULL ;
+        node->next = node->prev = NULL ;
+        node->queued = false ;
+        node->func (node->userData) ;
+        numRun++ ;
+    }
+
+    if (count != NULL)  *count = numRun ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxForeign ()
+
+    Note the Foreign Function Being Executed.
+
+
+Purpose:
+
+    Function soxForeign() records the name of the foreign (C) function that
+    an interpreter is about to execute in the innermost callback running the
+    interpreter, so that the stall watchdog can name the function without
+    examining the interpreter from its own thread.  The caller restores the
+    previous name when the function returns:
+
+        previous = soxForeign (sc, "tcp-call") ;
+        result = function (sc, args) ;
+        soxForeign (sc, previous) ;
+
+    The name is not copied and must remain valid until it is replaced (the
+    name of an interned symbol, for example).  If no callback is running the
+    interpreter, nothing is recorded.
+
+
+    Invocation:
+
+        previous = soxForeign (sc, name) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <name>		- I
+            is the name of the foreign function; NULL if none.
+        <previous>	- O
+            returns the name previously recorded, NULL if none.
+
+*******************************************************************************/
+
+
+const  char  *soxForeign (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        const  char  *name)
+#    else
+        sc, name)
+
+        scheme  *sc ;
+        const  char  *name ;
+#    endif
+
+{    /* Local variables. */
+    const  char  *previous ;
+    SoxDispatcher  sd ;
+
+
+
+    previous = NULL ;
+
+    SOX_LOCK ;
+    for (sd = dispatcherList ;  sd != NULL ;  sd = sd->next) {
+        if ((sd->active != NULL) && (sd->active->sc == sc)) {
+            previous = sd->active->foreign ;
+            sd->active->foreign = name ;
+            break ;
+        }
+    }
+    SOX_UNLOCK ;
+
+    return (previous) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxLag ()
+
+    Get a Dispatcher's Event-Loop Lag Statistics.
+
+
+Purpose:
+
+    Function soxLag() returns the lag statistics for a dispatcher.  The
+    percentiles are computed from the most recent SOX_LAG_SAMPLES samples;
+    the maximum covers all samples since the dispatcher state was created.
+
+
+    Invocation:
+
+        status = soxLag (dispatcher, &lag) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <lag>		- O
+            returns the lag statistics.  All fields are zero if no samples
+            have been taken.
+        <status>	- O
+            returns the status of getting the statistics, zero if there
+            were no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxLag (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        SoxLag  *lag)
+#    else
+        dispatcher, lag)
+
+        IoxDispatcher  dispatcher ;
+        SoxLag  *lag ;
+#    endif
+
+{    /* Local variables. */
+    double  samples[SOX_LAG_SAMPLES] ;
+    size_t  numSamples ;
+    SoxDispatcher  sd ;
+
+
+
+    memset (lag, 0, sizeof (SoxLag)) ;
+
+    sd = soxFind (dispatcher, false) ;
+    if ((sd == NULL) || (sd->lagCount == 0))  return (0) ;
+
+    numSamples = (sd->lagCount < SOX_LAG_SAMPLES)
+                 ? (size_t) sd->lagCount : SOX_LAG_SAMPLES ;
+    memcpy (samples, sd->lag, numSamples * sizeof (double)) ;
+    qsort (samples, numSamples, sizeof (double), soxCompare) ;
+
+    lag->count = sd->lagCount ;
+    lag->p50 = samples[(numSamples - 1) / 2] ;
+    lag->p99 = samples[((numSamples * 99) + 99) / 100 - 1] ;
+    lag->max = sd->lagMax ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxLeave ()
+
+    Note the End of a Callback.
+
+
+Purpose:
+
+    Function soxLeave() pops a callback's record off the dispatcher's stack
+    of callbacks in progress.  If the callback detached the dispatcher's
+    TSION state (e.g., by destroying the dispatcher), there is nothing to
+    pop and soxLeave() quietly returns.
+
+
+    Invocation:
+
+        status = soxLeave (dispatcher, activity) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <activity>	- I
+            is the record passed to soxEnter().
+        <status>	- O
+            returns the status of noting the end of the callback, zero if
+            there were no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxLeave (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        SoxActivity  *activity)
+#    else
+        dispatcher, activity)
+
+        IoxDispatcher  dispatcher ;
+        SoxActivity  *activity ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, false) ;
+    if (sd == NULL)  return (0) ;		/* Detached during callback. */
+    if (sd->active != activity) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(soxLeave) Activity %p is not current on dispatcher %p.\n",
+            (void *) activity, (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+    if (sd->profPeriod > 0)  soxCharge (sd, activity) ;
+
+    SOX_LOCK ;
+    sd->active = activity->prev ;
+    SOX_UNLOCK ;
+
+/* The enclosing activity resumes being charged from here on. */
+
+    if ((sd->profPeriod > 0) && (sd->active != NULL) &&
+        (sd->active->sc != NULL)) {
+        sd->active->mark = sd->active->sc->fcells ;
+        sd->active->collections = gc_collections (sd->active->sc) ;
+    }
+
+/* Record the callback in the timeline, if any.  The interpreter's count of
+   free cells only goes up when the garbage collector has run. */
+
+    if (tevActive ()) {
+        if ((activity->sc != NULL) && (activity->sc->fcells > activity->cells))
+            tevInstant ("gc", "gc", activity->sc->fcells) ;
+        tevSpan (activity->kind,
+                 (activity->name == NULL) ? activity->kind : activity->name,
+                 activity->start, -1) ;
+    }
+
+    if (sd->active == NULL)  sd->idleSince = tvTOD () ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxMailbox ()
+
+    Open a Dispatcher's Mailbox.
+
+
+Purpose:
+
+    Function soxMailbox() opens a dispatcher's mailbox, registering the
+    mailbox's wakeup descriptor with the dispatcher.  soxMailbox() must be
+    called in the thread running the dispatcher before any other thread
+    posts to the mailbox; opening an open mailbox has no effect.  Note
+    that, while the mailbox is open, ioxMonitor() always has something
+    to monitor.
+
+
+    Invocation:
+
+        status = soxMailbox (dispatcher) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <status>	- O
+            returns the status of opening the mailbox, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxMailbox (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher)
+#    else
+        dispatcher)
+
+        IoxDispatcher  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, true) ;
+    if (sd == NULL) {
+        LGE "(soxMailbox) Error attaching to dispatcher %p.\nsoxFind: ",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+    if (sd->mailboxOpen)  return (0) ;
+
+#if HAVE_PTHREADS
+
+/* Create the wakeup descriptor(s) and register the read end with the
+   dispatcher.  Both ends are non-blocking: a wakeup is never worth
+   blocking a helper thread for, and the dispatcher drains the descriptor
+   until it would block. */
+
+#    if HAVE_EVENTFD
+    sd->wakeup[0] = sd->wakeup[1] = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC) ;
+    if (sd->wakeup[0] < 0) {
+        LGE "(soxMailbox) Error creating wakeup descriptor.\neventfd: ") ;
+        return (errno) ;
+    }
+#    else
+    if (pipe (sd->wakeup)) {
+        LGE "(soxMailbox) Error creating wakeup descriptors.\npipe: ") ;
+        sd->wakeup[0] = sd->wakeup[1] = -1 ;
+        return (errno) ;
+    }
+    fcntl (sd->wakeup[0], F_SETFL, O_NONBLOCK) ;
+    fcntl (sd->wakeup[1], F_SETFL, O_NONBLOCK) ;
+#    endif
+
+    sd->mailbox = ioxOnIO (dispatcher, soxMailboxCB, sd, IoxRead,
+                           sd->wakeup[0]) ;
+    if (sd->mailbox == NULL) {
+        LGE "(soxMailbox) Error registering wakeup descriptor %d.\nioxOnIO: ",
+            sd->wakeup[0]) ;
+        PUSH_ERRNO ;
+        close (sd->wakeup[0]) ;
+        if (sd->wakeup[1] != sd->wakeup[0])  close (sd->wakeup[1]) ;
+        sd->wakeup[0] = sd->wakeup[1] = -1 ;
+        POP_ERRNO ;
+        return (errno) ;
+    }
+
+#endif
+
+    SOX_LOCK ;
+    sd->mailboxOpen = true ;
+    SOX_UNLOCK ;
+
+    LGI "(soxMailbox) Dispatcher %p, wakeup descriptor %d.\n",
+        (void *) dispatcher, sd->wakeup[0]) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxOnSignal ()
+
+    Watch for a Signal.
+
+
+Purpose:
+
+    Function soxOnSignal() registers a handler to be called, in the thread
+    running the dispatcher, when a signal is received.  The handler is
+    called with reason SOX_SIGNAL when the signal has been received one or
+    more times since the last call, and with reason IoxCancel when the
+    watcher is canceled.  The signal is blocked (or, on systems without
+    signalfd(2), caught) until its last watcher is canceled.
+
+
+    Invocation:
+
+        watcher = soxOnSignal (dispatcher, signo, handler, userData) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <signo>		- I
+            is the number of the signal to watch; e.g., SIGTERM.
+        <handler>	- I
+            is the function to be called when the signal is received.
+        <userData>	- I
+            is an arbitrary (VOID *) value passed to the handler.
+        <watcher>	- O
+            returns a handle for the watcher; NULL is returned in the event
+            of an error.  ENOSYS is returned on platforms without POSIX
+            signals.
+
+*******************************************************************************/
+
+
+SoxSignal  soxOnSignal (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        int  signo,
+        SoxSignalFunc  handler,
+        void  *userData)
+#    else
+        dispatcher, signo, handler, userData)
+
+        IoxDispatcher  dispatcher ;
+        int  signo ;
+        SoxSignalFunc  handler ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+#if HAVE_PTHREADS
+    sigset_t  mask ;
+    SoxDispatcher  sd ;
+    SoxSignal  watcher ;
+#    if !HAVE_SIGNALFD
+    struct  sigaction  action ;
+#    endif
+#endif
+
+
+
+#if HAVE_PTHREADS
+
+    if ((signo <= 0) || (signo >= SOX_SIGNALS)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(soxOnSignal) Invalid signal number: %d\n", signo) ;
+        return (NULL) ;
+    }
+
+    sd = soxFind (dispatcher, true) ;
+    if (sd == NULL) {
+        LGE "(soxOnSignal) Error attaching to dispatcher %p.\nsoxFind: ",
+            (void *) dispatcher) ;
+        return (NULL) ;
+    }
+
+/* Create the dispatcher's signal descriptor(s) on first use.  The signalfd
+   starts with an empty mask; signals are added as they are watched. */
+
+    if (sd->signalFd[0] < 0) {
+#    if HAVE_SIGNALFD
+        sigemptyset (&mask) ;
+        sd->signalFd[0] = sd->signalFd[1] =
+            signalfd (-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC) ;
+        if (sd->signalFd[0] < 0) {
+            LGE "(soxOnSignal) Error creating signal descriptor.\nsignalfd: ") ;
+            return (NULL) ;
+        }
+#    else
+        if (pipe (sd->signalFd)) {
+            LGE "(soxOnSignal) Error creating signal pipe.\npipe: ") ;
+            sd->signalFd[0] = sd->signalFd[1] = -1 ;
+            return (NULL) ;
+        }
+        fcntl (sd->signalFd[0], F_SETFL, O_NONBLOCK) ;
+        fcntl (sd->signalFd[1], F_SETFL, O_NONBLOCK) ;
+#    endif
+        sd->signalCB = ioxOnIO (dispatcher, soxSignalCB, sd, IoxRead,
+                                sd->signalFd[0]) ;
+        if (sd->signalCB == NULL) {
+            LGE "(soxOnSignal) Error registering signal descriptor %d.\nioxOnIO: ",
+                sd->signalFd[0]) ;
+            PUSH_ERRNO ;
+            close (sd->signalFd[0]) ;
+            if (sd->signalFd[1] != sd->signalFd[0])  close (sd->signalFd[1]) ;
+            sd->signalFd[0] = sd->signalFd[1] = -1 ;
+            POP_ERRNO ;
+            return (NULL) ;
+        }
+    }
+
+    watcher = (SoxSignal) malloc (sizeof (_SoxSignal)) ;
+    if (watcher == NULL) {
+        LGE "(soxOnSignal) Error allocating watcher.\nmalloc: ") ;
+        return (NULL) ;
+    }
+
+    watcher->sd = sd ;
+    watcher->signo = signo ;
+    watcher->handler = handler ;
+    watcher->userData = userData ;
+    watcher->dead = false ;
+    watcher->next = sd->signals ;
+    sd->signals = watcher ;
+
+/* If this is the signal's first watcher in the process, take over the
+   signal.  With signalfd, the signal is blocked so that it stays pending
+   until read from the descriptor.  Otherwise, a handler is installed that
+   forwards the signal to the dispatcher's pipe. */
+
+    if (signalWatchers[signo]++ == 0) {
+        sigemptyset (&mask) ;
+        sigaddset (&mask, signo) ;
+#    if HAVE_SIGNALFD
+        pthread_sigmask (SIG_BLOCK, &mask, NULL) ;
+#    else
+        action.sa_handler = soxSignalHandler ;
+        action.sa_mask = mask ;
+        action.sa_flags = SA_RESTART ;
+        sigaction (signo, &action, &signalAction[signo]) ;
+#    endif
+    }
+
+#    if HAVE_SIGNALFD
+    sigemptyset (&mask) ;
+    for (watcher = sd->signals ;  watcher != NULL ;  watcher = watcher->next)
+        sigaddset (&mask, watcher->signo) ;
+    signalfd (sd->signalFd[0], &mask, 0) ;
+    watcher = sd->signals ;
+#    else
+    signalPipe[signo] = sd->signalFd[1] ;
+#    endif
+
+    LGI "(soxOnSignal) Dispatcher %p, signal %d, watcher %p.\n",
+        (void *) dispatcher, signo, (void *) watcher) ;
+
+    return (watcher) ;
+
+#else
+
+    SET_ERRNO (ENOSYS) ;
+    LGE "(soxOnSignal) Signals not supported for dispatcher %p.\n",
+        (void *) dispatcher) ;
+    return (NULL) ;
+
+#endif
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxPost ()
+
+    Post Work to a Dispatcher's Mailbox.
+
+
+Purpose:
+
+    Function soxPost() queues a function in a dispatcher's mailbox, to be
+    run by the thread running the dispatcher.  soxPost() can be called from
+    any thread, including the dispatcher's own.  The function is called
+    with reason IoxFire when it is run, or with reason IoxCancel if the
+    dispatcher is destroyed before it can be run; either way, it is called
+    exactly once.
+
+    On platforms without POSIX threads, there are no other threads to post
+    from; the mailbox is emptied by a zero-delay IOX timer instead.
+
+
+    Invocation:
+
+        status = soxPost (dispatcher, func, userData) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <func>		- I
+            is the function to run.
+        <userData>	- I
+            is an arbitrary (VOID *) value passed to the function.
+        <status>	- O
+            returns the status of posting the work, zero if there were no
+            errors and ERRNO otherwise.  If the dispatcher's mailbox is not
+            open, EINVAL is returned and the function is not called.
+
+*******************************************************************************/
+
+
+errno_t  soxPost (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        SoxPostFunc  func,
+        void  *userData)
+#    else
+        dispatcher, func, userData)
+
+        IoxDispatcher  dispatcher ;
+        SoxPostFunc  func ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    bool  wasEmpty ;
+    SoxDispatcher  sd ;
+    SoxPost  *post ;
+#if HAVE_PTHREADS
+#    if HAVE_EVENTFD
+    uint64_t  one = 1 ;
+#    else
+    char  one = 1 ;
+#    endif
+#endif
+
+
+
+    post = (SoxPost *) malloc (sizeof (SoxPost)) ;
+    if (post == NULL) {
+        LGE "(soxPost) Error allocating post for dispatcher %p.\nmalloc: ",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+    post->next = NULL ;
+    post->func = func ;
+    post->userData = userData ;
+
+/* Look up the dispatcher without touching the last-found cache, which
+   belongs to the dispatcher's thread, and queue the work. */
+
+    SOX_LOCK ;
+
+    for (sd = dispatcherList ;  sd != NULL ;  sd = sd->next) {
+        if (sd->dispatcher == dispatcher)  break ;
+    }
+
+    if ((sd == NULL) || !sd->mailboxOpen) {
+        SOX_UNLOCK ;
+        free (post) ;
+        SET_ERRNO (EINVAL) ;
+        LGE "(soxPost) Dispatcher %p has no open mailbox.\n",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+    wasEmpty = (sd->posts == NULL) ;
+    if (wasEmpty)
+        sd->posts = post ;
+    else
+        sd->lastPost->next = post ;
+    sd->lastPost = post ;
+
+/* If the mailbox was empty, wake up the dispatcher.  (If it wasn't, a wakeup
+   is already pending and the dispatcher will take this post along with the
+   others.)  A full pipe means a wakeup is already pending, so a failure to
+   write is ignored. */
+
+    if (wasEmpty) {
+#if HAVE_PTHREADS
+        if (write (sd->wakeup[1], &one, sizeof one) < 0) {
+            LGI "(soxPost) Wakeup already pending on %d.\n", sd->wakeup[1]) ;
+        }
+#else
+        if (sd->mailbox == NULL)
+            sd->mailbox = ioxAfter (dispatcher, soxMailboxCB, sd, 0.0) ;
+#endif
+    }
+
+    SOX_UNLOCK ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxProbe ()
+
+    Set Up a Periodic Timer for Sampling Lag.
+
+
+Purpose:
+
+    Function soxProbe() registers a periodic wheel timer that does nothing
+    but ensure the dispatcher's lag is sampled at least once per interval.
+    Calling soxProbe() again replaces the interval; an interval of zero
+    removes the probe.  Note that, while it is registered, the probe keeps
+    ioxMonitor() from running out of things to monitor.
+
+
+    Invocation:
+
+        status = soxProbe (dispatcher, interval) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <interval>	- I
+            is the interval in seconds between probes; zero or less removes
+            the probe.
+        <status>	- O
+            returns the status of setting up the probe, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxProbe (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        double  interval)
+#    else
+        dispatcher, interval)
+
+        IoxDispatcher  dispatcher ;
+        double  interval ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+    TwlTimer  probe ;
+
+
+
+    sd = soxFind (dispatcher, interval > 0.0) ;
+    if (sd == NULL)  return ((interval > 0.0) ? errno : 0) ;
+
+    probe = sd->probe ;
+    sd->probe = NULL ;
+    if (probe != NULL)  twlCancel (probe) ;
+
+    if (interval <= 0.0)  return (0) ;
+
+    sd->probe = twlEvery (sd->wheel, soxProbeCB, sd, interval, interval) ;
+    if (sd->probe == NULL) {
+        LGE "(soxProbe) Error registering probe for dispatcher %p.\ntwlEvery: ",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+    soxArm (sd) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxProfile ()
+
+    Start or Stop the Allocation Profiler.
+
+
+Purpose:
+
+    Function soxProfile() starts sampling the interpreters' cell allocations
+    in a dispatcher's callbacks, taking a sample of the stack of callbacks
+    in progress every <period> cells (see the description of the profiler
+    at the top of this file).  Starting the profiler discards the previous
+    profile; stopping it keeps the profile, which can then be retrieved with
+    soxProfileStack() or soxProfileWrite().
+
+
+    Invocation:
+
+        status = soxProfile (dispatcher, period) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <period>	- I
+            is the number of cells allocated between samples; zero or less
+            stops the profiler.
+        <status>	- O
+            returns the status of starting or stopping the profiler, zero
+            if there were no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxProfile (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        long  period)
+#    else
+        dispatcher, period)
+
+        IoxDispatcher  dispatcher ;
+        long  period ;
+#    endif
+
+{    /* Local variables. */
+    SoxActivity  *activity ;
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, period > 0) ;
+    if (sd == NULL)  return ((period > 0) ? errno : 0) ;
+
+    if (period <= 0) {
+        sd->profPeriod = 0 ;
+        return (0) ;
+    }
+
+    while (sd->numStacks > 0)
+        free (sd->stacks[--sd->numStacks].frames) ;
+
+/* Start charging the callbacks already in progress (if soxProfile() was
+   called from within a callback) from here on. */
+
+    for (activity = sd->active ;  activity != NULL ;  activity = activity->prev) {
+        if (activity->sc == NULL)  continue ;
+        activity->mark = activity->sc->fcells ;
+        activity->collections = gc_collections (activity->sc) ;
+    }
+
+    sd->profPeriod = period ;
+    sd->profCountdown = period ;
+
+    LGI "(soxProfile) Dispatcher %p, sampling every %ld cells.\n",
+        (void *) dispatcher, period) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxProfileStack ()
+
+    Get a Stack Sampled by the Allocation Profiler.
+
+
+Purpose:
+
+    Function soxProfileStack() returns one of the stacks sampled by a
+    dispatcher's allocation profiler, along with the number of cells charged
+    to it.  The stacks are indexed from zero in the order in which they were
+    first sampled.
+
+
+    Invocation:
+
+        frames = soxProfileStack (dispatcher, index, &cells, &samples) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <index>		- I
+            is the index, 0..N-1, of the desired stack.
+        <cells>		- O
+            returns the number of cells charged to the stack.
+        <samples>	- O
+            returns the number of samples of the stack.
+        <frames>	- O
+            returns the folded stack, "<outer>;...;<inner>"; NULL is returned
+            if the index is out of range.  The string is owned by the profiler
+            and is only valid until the profiler is restarted.
+
+*******************************************************************************/
+
+
+const  char  *soxProfileStack (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        long  index,
+        unsigned  long  *cells,
+        unsigned  long  *samples)
+#    else
+        dispatcher, index, cells, samples)
+
+        IoxDispatcher  dispatcher ;
+        long  index ;
+        unsigned  long  *cells ;
+        unsigned  long  *samples ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, false) ;
+    if ((sd == NULL) || (index < 0) || (index >= sd->numStacks))
+        return (NULL) ;
+
+    *cells = sd->stacks[index].cells ;
+    *samples = sd->stacks[index].samples ;
+
+    return (sd->stacks[index].frames) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxProfileWrite ()
+
+    Write the Allocation Profile as Folded Stacks.
+
+
+Purpose:
+
+    Function soxProfileWrite() writes a dispatcher's allocation profile
+    to a file in the "folded stacks" format read by flame-graph tools
+    (e.g., Brendan Gregg's "flamegraph.pl" or speedscope):  one line per
+    stack, giving the folded stack and the number of cells charged to it.
+
+        iox-post:start-lookup;iox-onio:handle-reply 1250000
+
+
+    Invocation:
+
+        status = soxProfileWrite (dispatcher, file) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <file>		- I
+            is the file to write to.
+        <status>	- O
+            returns the status of writing the profile, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxProfileWrite (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        FILE  *file)
+#    else
+        dispatcher, file)
+
+        IoxDispatcher  dispatcher ;
+        FILE  *file ;
+#    endif
+
+{    /* Local variables. */
+    long  i ;
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, false) ;
+    if (sd == NULL)  return (0) ;
+
+    for (i = 0 ;  i < sd->numStacks ;  i++) {
+        if (fprintf (file, "%s %lu\n",
+                     sd->stacks[i].frames, sd->stacks[i].cells) < 0) {
+            LGE "(soxProfileWrite) Error writing profile of dispatcher %p.\nfprintf: ",
+                (void *) dispatcher) ;
+            return (errno) ;
+        }
+    }
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxProfiling ()
+
+    Get a Dispatcher's Allocation Sampling Period.
+
+
+Purpose:
+
+    Function soxProfiling() returns the number of cells between samples
+    taken by a dispatcher's allocation profiler.  Callers of soxEnter()
+    can use it, like soxWatchdog(), to decide whether to name their
+    callbacks.
+
+
+    Invocation:
+
+        period = soxProfiling (dispatcher) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <period>	- O
+            returns the sampling period in cells; zero is returned if the
+            profiler is not running.
+
+*******************************************************************************/
+
+
+long  soxProfiling (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher)
+#    else
+        dispatcher)
+
+        IoxDispatcher  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, false) ;
+
+    return ((sd == NULL) ? 0 : sd->profPeriod) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxReschedule ()
+
+    Reschedule a Wheel Timer.
+
+
+Purpose:
+
+    Function soxReschedule() changes a wheel timer's expiration time to
+    the specified number of seconds from now.  See twlReschedule().
+
+
+    Invocation:
+
+        status = soxReschedule (dispatcher, timer, delay) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher with which the timer is registered.
+        <timer>		- I
+            is the timer handle returned by soxAfter() or soxEvery().
+        <delay>		- I
+            is the new delay in seconds.
+        <status>	- O
+            returns the status of rescheduling the timer, zero if there
+            were no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxReschedule (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        TwlTimer  timer,
+        double  delay)
+#    else
+        dispatcher, timer, delay)
+
+        IoxDispatcher  dispatcher ;
+        TwlTimer  timer ;
+        double  delay ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, false) ;
+    if (sd == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(soxReschedule) Dispatcher %p has no timing wheel: ",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+    if (twlReschedule (timer, delay)) {
+        LGE "(soxReschedule) Error rescheduling timer %p.\ntwlReschedule: ",
+            (void *) timer) ;
+        return (errno) ;
+    }
+
+    soxArm (sd) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxRunSlice ()
+
+    Monitor a Dispatcher within Event and Time Budgets.
+
+
+Purpose:
+
+    Function soxRunSlice() runs a dispatcher until it has handled a maximum
+    number of events or until a maximum time has elapsed, whichever comes
+    first, and returns the number of events handled and the time until the
+    dispatcher's next wheel timer is due.  It is meant for applications that
+    interleave TSION's I/O with their own main loop; e.g., one driven by
+    video frames.
+
+    The dispatcher is run in passes of ioxMonitor().  While events are being
+    handled, each pass polls without waiting; when the dispatcher is idle, a
+    pass waits up to SOX_SLICE_QUANTUM (1 millisecond by default) or the
+    time left in the slice.  The budgets are checked after each pass;
+    within a pass, see soxSliceDone().  Events are the callbacks bracketed with soxEnter(),
+    which includes all the Scheme callbacks.  Timers that come due are
+    always fired, even if the budget has been spent, so they are never
+    lost; the budget then only delays the dispatching of I/O.
+
+    With a time budget of zero, the dispatcher makes one non-blocking pass
+    over its sources.  soxRunSlice() also returns early if a pass handles
+    no events and returns at once, which means the dispatcher has nothing
+    to monitor.
+
+
+    Invocation:
+
+        status = soxRunSlice (dispatcher, maxEvents, maxTime,
+                              &handled, &next) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <maxEvents>	- I
+            is the maximum number of events to handle; -1 for no limit.
+        <maxTime>	- I
+            is the maximum time in seconds to run; -1.0 for no limit.  At
+            least one of the budgets must be given.
+        <handled>	- O
+            returns the number of events handled.  (NULL can be passed if
+            this value is not needed.)
+        <next>		- O
+            returns the time in seconds until the dispatcher's timing wheel
+            next needs servicing (zero if overdue), or -1.0 if no timers are
+            pending.  The application should run another slice by then.  (NULL can be passed if this value is not needed.)
+        <status>	- O
+            returns the status of running the dispatcher, zero if there
+            were no errors and ERRNO otherwise.  EBUSY is returned if the
+            dispatcher is already running a slice.
+
+*******************************************************************************/
+
+
+errno_t  soxRunSlice (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        long  maxEvents,
+        double  maxTime,
+        long  *handled,
+        double  *next)
+#    else
+        dispatcher, maxEvents, maxTime, handled, next)
+
+        IoxDispatcher  dispatcher ;
+        long  maxEvents ;
+        double  maxTime ;
+        long  *handled ;
+        double  *next ;
+#    endif
+
+{    /* Local variables. */
+    double  remaining, quantum ;
+    errno_t  status ;
+    SoxDispatcher  sd ;
+    struct  timeval  passStart ;
+    unsigned  long  passFirst ;
+    bool  waiting ;
+
+
+
+    if (handled != NULL)  *handled = 0 ;
+    if (next != NULL)  *next = -1.0 ;
+
+    if ((maxEvents < 0) && (maxTime < 0.0)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(soxRunSlice) No event or time budget for dispatcher %p.\n",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+    sd = soxFind (dispatcher, true) ;
+    if (sd == NULL) {
+        LGE "(soxRunSlice) Error attaching to dispatcher %p.\nsoxFind: ",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+    if (sd->slicing) {
+        SET_ERRNO (EBUSY) ;
+        LGE "(soxRunSlice) Dispatcher %p is already running a slice.\n",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+/* Run the dispatcher in short passes until a budget is spent. */
+
+    sd->slicing = true ;
+    sd->sliceEvents = (maxEvents < 0) ? -1 : maxEvents ;
+    sd->sliceFirst = sd->events ;
+    sd->sliceTime = (maxTime < 0.0) ? -1.0 : maxTime ;
+    if (maxTime >= 0.0)
+        sd->sliceEnd = tvAdd (tvTOD (), tvCreateF (maxTime)) ;
+
+    status = 0 ;
+    waiting = false ;
+
+    for ( ; ; ) {
+
+        quantum = waiting ? SOX_SLICE_QUANTUM : 0.0 ;
+        if (maxTime >= 0.0) {
+            remaining = tvFloat (tvSubtract (sd->sliceEnd, tvTOD ())) ;
+            if (remaining < quantum)
+                quantum = (remaining > 0.0) ? remaining : 0.0 ;
+        }
+
+        passStart = tvTOD () ;
+        passFirst = sd->events ;
+
+        status = ioxMonitor (dispatcher, quantum) ;
+        if (tevActive ())
+            tevSpan ("dispatcher", "iteration", passStart,
+                     (long) (sd->events - passFirst)) ;
+        if (status)  break ;
+
+        if (soxSliceDone (dispatcher) || (maxTime == 0.0))  break ;
+
+        if (sd->events != passFirst) {
+            waiting = false ;		/* Busy: keep polling. */
+        } else if (!waiting) {
+            waiting = true ;		/* Idle: wait for something. */
+        } else if (tvFloat (tvSubtract (tvTOD (), passStart)) <
+                   (quantum / 2.0)) {
+            break ;			/* Nothing to monitor. */
+        }
+
+    }
+
+    sd->slicing = false ;
+
+/* Return the number of events handled and the time until the next timer. */
+
+    if (handled != NULL)  *handled = (long) (sd->events - sd->sliceFirst) ;
+
+    if ((next != NULL) && (sd->tick != NULL)) {
+        remaining = tvFloat (tvSubtract (sd->tickTime, tvTOD ())) ;
+        *next = (remaining > 0.0) ? remaining : 0.0 ;
+    }
+
+    LGI "(soxRunSlice) Dispatcher %p: %lu events.\n",
+        (void *) dispatcher, sd->events - sd->sliceFirst) ;
+
+    return (status) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxSerial ()
+
+    Issue a Serial Number.
+
+
+Purpose:
+
+    Function soxSerial() issues the next in a dispatcher's sequence of serial
+    numbers.  Applications number the callbacks they register so that they
+    can be identified across runs of the same program; see TRC_UTIL.
+
+
+    Invocation:
+
+        number = soxSerial (dispatcher) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <number>	- O
+            returns the serial number, starting with 1; zero is returned
+            in the event of an error.
+
+*******************************************************************************/
+
+
+unsigned  long  soxSerial (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher)
+#    else
+        dispatcher)
+
+        IoxDispatcher  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, true) ;
+    if (sd == NULL) {
+        LGE "(soxSerial) Error attaching to dispatcher %p.\nsoxFind: ",
+            (void *) dispatcher) ;
+        return (0) ;
+    }
+
+    return (++sd->serial) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxSetSlow ()
+
+    Set a Dispatcher's Slow-Callback Threshold.
+
+
+Purpose:
+
+    Function soxSetSlow() sets the threshold above which the Scheme callbacks
+    invoked by a dispatcher are considered slow.  (What is done about slow
+    callbacks is up to the caller of soxSlow(); FUNCS_IOX logs them.)
+
+
+    Invocation:
+
+        status = soxSetSlow (dispatcher, threshold) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <threshold>	- I
+            is the threshold in seconds; zero or less disables the check.
+        <status>	- O
+            returns the status of setting the threshold, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxSetSlow (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        double  threshold)
+#    else
+        dispatcher, threshold)
+
+        IoxDispatcher  dispatcher ;
+        double  threshold ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, true) ;
+    if (sd == NULL) {
+        LGE "(soxSetSlow) Error attaching to dispatcher %p.\nsoxFind: ",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+    sd->slow = (threshold > 0.0) ? threshold : 0.0 ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxSetWatchdog ()
+
+    Set a Dispatcher's Stall Threshold.
+
+
+Purpose:
+
+    Function soxSetWatchdog() sets the time a callback may run before the stall
+    watchdog reports the dispatcher as stalled.  The watchdog thread is
+    started the first time a threshold is set.
+
+
+    Invocation:
+
+        status = soxSetWatchdog (dispatcher, threshold) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <threshold>	- I
+            is the threshold in seconds; zero or less disables the check.
+        <status>	- O
+            returns the status of setting the threshold, zero if there were
+            no errors and ERRNO otherwise.  ENOSYS is returned on platforms
+            without POSIX threads.
+
+*******************************************************************************/
+
+
+errno_t  soxSetWatchdog (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        double  threshold)
+#    else
+        dispatcher, threshold)
+
+        IoxDispatcher  dispatcher ;
+        double  threshold ;
+#    endif
+
+{    /* Local variables. */
+#if HAVE_PTHREADS
+    SoxDispatcher  sd ;
+    pthread_t  thread ;
+#endif
+
+
+
+#if HAVE_PTHREADS
+
+    sd = soxFind (dispatcher, true) ;
+    if (sd == NULL) {
+        LGE "(soxSetWatchdog) Error attaching to dispatcher %p.\nsoxFind: ",
+            (void *) dispatcher) ;
+        return (errno) ;
+    }
+
+    SOX_LOCK ;
+    sd->watchdog = (threshold > 0.0) ? threshold : 0.0 ;
+    SOX_UNLOCK ;
+
+    if ((threshold <= 0.0) || watchdogStarted)  return (0) ;
+
+    errno = pthread_create (&thread, NULL, soxWatchdogThread, NULL) ;
+    if (errno) {
+        LGE "(soxSetWatchdog) Error starting watchdog thread.\npthread_create: ") ;
+        return (errno) ;
+    }
+    pthread_detach (thread) ;
+    watchdogStarted = true ;
+
+    return (0) ;
+
+#else
+
+    SET_ERRNO (ENOSYS) ;
+    LGE "(soxSetWatchdog) Watchdog not supported for dispatcher %p.\n",
+        (void *) dispatcher) ;
+    return (errno) ;
+
+#endif
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxSliceDone ()
+
+    Check If a Slice's Budget Has Been Spent.
+
+
+Purpose:
+
+    Function soxSliceDone() checks if a dispatcher is running a slice (see
+    soxRunSlice()) whose event or time budget has been spent.  Callbacks for
+    level-triggered I/O sources can call soxSliceDone() and, if it returns
+    true, return without handling the event; the source remains ready and
+    the event is dispatched again in the next slice.
+
+
+    Invocation:
+
+        done = soxSliceDone (dispatcher) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <done>		- O
+            returns true if the dispatcher is running a slice and the slice's
+            budget has been spent, and false otherwise.
+
+*******************************************************************************/
+
+
+bool  soxSliceDone (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher)
+#    else
+        dispatcher)
+
+        IoxDispatcher  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, false) ;
+    if ((sd == NULL) || !sd->slicing)  return (false) ;
+
+    if ((sd->sliceEvents >= 0) &&
+        ((sd->events - sd->sliceFirst) >= (unsigned long) sd->sliceEvents))
+        return (true) ;
+
+    return ((sd->sliceTime > 0.0) &&
+            (tvCompare (tvTOD (), sd->sliceEnd) >= 0)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxSlow ()
+
+    Get a Dispatcher's Slow-Callback Threshold.
+
+
+Purpose:
+
+    Function soxSlow() returns a dispatcher's slow-callback threshold.
+
+
+    Invocation:
+
+        threshold = soxSlow (dispatcher) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <threshold>	- O
+            returns the threshold in seconds; zero is returned if no
+            threshold has been set.
+
+*******************************************************************************/
+
+
+double  soxSlow (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher)
+#    else
+        dispatcher)
+
+        IoxDispatcher  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, false) ;
+
+    return ((sd == NULL) ? 0.0 : sd->slow) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxUndefer ()
+
+    Remove Deferred Work from the Queue.
+
+
+Purpose:
+
+    Function soxUndefer() removes a node from a dispatcher's queue of
+    deferred work, if the node is queued.  The application must call
+    soxUndefer() before deallocating a queued node.
+
+
+    Invocation:
+
+        status = soxUndefer (dispatcher, node) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <node>		- I
+            is the node to be removed.
+        <status>	- O
+            returns the status of removing the node, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  soxUndefer (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        SoxDeferred  *node)
+#    else
+        dispatcher, node)
+
+        IoxDispatcher  dispatcher ;
+        SoxDeferred  *node ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    if (!node->queued)  return (0) ;
+
+    sd = soxFind (dispatcher, false) ;
+    if (sd == NULL) {			/* Queue was discarded by soxDetach(). */
+        node->queued = false ;
+        return (0) ;
+    }
+
+    if (node->prev == NULL)
+        sd->deferred = node->next ;
+    else
+        node->prev->next = node->next ;
+    if (node->next == NULL)
+        sd->lastDeferred = node->prev ;
+    else
+        node->next->prev = node->prev ;
+
+    node->next = node->prev = NULL ;
+    node->queued = false ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxWatchdog ()
+
+    Get a Dispatcher's Stall Threshold.
+
+
+Purpose:
+
+    Function soxWatchdog() returns a dispatcher's stall threshold.  Callers
+    of soxEnter() can use it to skip filling in details of the activity
+    that only the watchdog needs.
+
+
+    Invocation:
+
+        threshold = soxWatchdog (dispatcher) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <threshold>	- O
+            returns the threshold in seconds; zero is returned if no
+            threshold has been set.
+
+*******************************************************************************/
+
+
+double  soxWatchdog (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher)
+#    else
+        dispatcher)
+
+        IoxDispatcher  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, false) ;
+
+    return ((sd == NULL) ? 0.0 : sd->watchdog) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxWheel ()
+
+    Get a Dispatcher's Timing Wheel.
+
+
+Purpose:
+
+    Function soxWheel() returns the timing wheel attached to a dispatcher.
+
+
+    Invocation:
+
+        wheel = soxWheel (dispatcher) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <wheel>		- O
+            returns the dispatcher's timing wheel; NULL is returned if no
+            wheel timers have been registered with the dispatcher.
+
+*******************************************************************************/
+
+
+TwlWheel  soxWheel (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher)
+#    else
+        dispatcher)
+
+        IoxDispatcher  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    sd = soxFind (dispatcher, false) ;
+
+    return ((sd == NULL) ? NULL : sd->wheel) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxArm ()
+
+    Arm the Dispatcher Timer that Drives the Wheel.
+
+
+Purpose:
+
+    Function soxArm() ensures that the IOX timer driving a timing wheel
+    will fire no later than the wheel's next expiration.  If the timer is
+    already armed for that time or earlier, it is left alone; otherwise,
+    it is canceled and a new timer is registered.
+
+
+    Invocation:
+
+        soxArm (sd) ;
+
+    where
+
+        <sd>		- I
+            is the dispatcher state.
+
+*******************************************************************************/
+
+
+static  void  soxArm (
+
+#    if PROTOTYPES
+        SoxDispatcher  sd)
+#    else
+        sd)
+
+        SoxDispatcher  sd ;
+#    endif
+
+{    /* Local variables. */
+    double  next ;
+    IoxCallback  tick ;
+    struct  timeval  due ;
+
+
+
+    next = twlNext (sd->wheel) ;
+    if (next < 0.0)  return ;			/* No timers. */
+
+    due = tvAdd (tvTOD (), tvCreateF (next)) ;
+
+    if ((sd->tick != NULL) && (tvCompare (sd->tickTime, due) <= 0))
+        return ;				/* Already armed in time. */
+
+    tick = sd->tick ;
+    sd->tick = NULL ;
+    if (tick != NULL)  ioxCancel (tick) ;
+
+    sd->tick = ioxAfter (sd->dispatcher, soxTickCB, sd, next) ;
+    if (sd->tick == NULL) {
+        LGE "(soxArm) Error arming wheel for dispatcher %p.\nioxAfter: ",
+            (void *) sd->dispatcher) ;
+        return ;
+    }
+    sd->tickTime = due ;
+
+    LGI "(soxArm) Dispatcher %p, wheel due in %g seconds.\n",
+        (void *) sd->dispatcher, next) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxCharge ()
+
+    Charge an Activity's Allocations to the Profile.
+
+
+Purpose:
+
+    Function soxCharge() charges the cells allocated by an activity's
+    interpreter since the last check to the allocation profile, taking
+    a sample of the stack of activities for each multiple of the sampling
+    period crossed.  Whether the garbage collector ran in the meantime is
+    learned from GC_UTIL's canary (see gc_collections()); a rise in the
+    count of free cells is no test, since a collection may recover fewer
+    cells than were allocated since the last check.  Assuming a collection
+    was triggered by the free list running out, the cells allocated before
+    it were all of the free cells at the last check; those allocated after
+    it can't be accounted for.  (An explicit call to GC breaks the
+    assumption and overstates the callback's allocations.)
+
+
+    Invocation:
+
+        soxCharge (sd, activity) ;
+
+    where
+
+        <sd>		- I
+            is the dispatcher state.
+        <activity>	- I/O
+            is the activity to be charged; it must be the innermost
+            activity in progress.
+
+*******************************************************************************/
+
+
+static  void  soxCharge (
+
+#    if PROTOTYPES
+        SoxDispatcher  sd,
+        SoxActivity  *activity)
+#    else
+        sd, activity)
+
+        SoxDispatcher  sd ;
+        SoxActivity  *activity ;
+#    endif
+
+{    /* Local variables. */
+    long  allocated, collections, fcells, samples ;
+
+
+
+    if (activity->sc == NULL)  return ;
+
+    fcells = activity->sc->fcells ;
+    collections = gc_collections (activity->sc) ;
+    if (collections != activity->collections)
+        allocated = activity->mark ;		/* Collected. */
+    else
+        allocated = activity->mark - fcells ;
+    if (allocated < 0)  allocated = 0 ;
+    activity->mark = fcells ;
+    activity->collections = collections ;
+
+    sd->profCountdown -= allocated ;
+    if (sd->profCountdown > 0)  return ;
+
+    samples = 1 + (-sd->profCountdown / sd->profPeriod) ;
+    sd->profCountdown += samples * sd->profPeriod ;
+
+    soxSample (sd, activity, samples) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxCompare ()
+
+    Compare Two Lag Samples.
+
+
+Purpose:
+
+    Function soxCompare() is the qsort(3) comparison function used to sort
+    lag samples.
+
+
+    Invocation:
+
+        comparison = soxCompare (p1, p2) ;
+
+    where
+
+        <p1>, <p2>	- I
+            are pointers to the two samples.
+        <comparison>	- O
+            returns -1, 0, or +1 if the first sample is less than, equal to,
+            or greater than the second sample.
+
+*******************************************************************************/
+
+
+static  int  soxCompare (
+
+#    if PROTOTYPES
+        const  void  *p1,
+        const  void  *p2)
+#    else
+        p1, p2)
+
+        void  *p1 ;
+        void  *p2 ;
+#    endif
+
+{
+    double  d1 = *((const double *) p1) ;
+    double  d2 = *((const double *) p2) ;
+
+    return ((d1 < d2) ? -1 : ((d1 > d2) ? 1 : 0)) ;
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxFind ()
+
+    Look Up a Dispatcher's TSION State.
+
+
+Purpose:
+
+    Function soxFind() looks up the TSION state attached to a dispatcher,
+    optionally creating it if it doesn't exist.  Since programs typically
+    have only one or two dispatchers, the state is kept in a short list
+    fronted by a cache of the most recently found entry.
+
+
+    Invocation:
+
+        sd = soxFind (dispatcher, create) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <create>	- I
+            specifies whether (true) or not (false) to create the state if
+            the dispatcher doesn't already have it.
+        <sd>		- O
+            returns the dispatcher state; NULL is returned if the state
+            was not found and not created.
+
+*******************************************************************************/
+
+
+static  SoxDispatcher  soxFind (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        bool  create)
+#    else
+        dispatcher, create)
+
+        IoxDispatcher  dispatcher ;
+        bool  create ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+
+
+
+    if (dispatcher == NULL) {
+        SET_ERRNO (EINVAL) ;
+        return (NULL) ;
+    }
+
+    if ((lastFound != NULL) && (lastFound->dispatcher == dispatcher))
+        return (lastFound) ;
+
+    for (sd = dispatcherList ;  sd != NULL ;  sd = sd->next) {
+        if (sd->dispatcher == dispatcher) {
+            lastFound = sd ;
+            return (sd) ;
+        }
+    }
+
+    if (!create)  return (NULL) ;
+
+/* Create the state for a new dispatcher. */
+
+    sd = (SoxDispatcher) calloc (1, sizeof (_SoxDispatcher)) ;
+    if (sd == NULL) {
+        LGE "(soxFind) Error allocating dispatcher state.\ncalloc: ") ;
+        return (NULL) ;
+    }
+
+    sd->dispatcher = dispatcher ;
+    sd->tick = NULL ;
+    sd->deferred = sd->lastDeferred = NULL ;
+    sd->flush = NULL ;
+    sd->generation = 0 ;
+    sd->slow = 0.0 ;
+    sd->probe = NULL ;
+    sd->lagCount = 0 ;
+    sd->lagMax = 0.0 ;
+    sd->active = NULL ;
+    sd->watchdog = 0.0 ;
+    sd->mailboxOpen = false ;
+    sd->wakeup[0] = sd->wakeup[1] = -1 ;
+    sd->mailbox = NULL ;
+    sd->posts = sd->lastPost = NULL ;
+    sd->signals = NULL ;
+    sd->signalFd[0] = sd->signalFd[1] = -1 ;
+    sd->signalCB = NULL ;
+    sd->delivering = false ;
+    sd->events = 0 ;
+    sd->slicing = false ;
+
+    if (twlCreate (TWL_RESOLUTION, &sd->wheel)) {
+        LGE "(soxFind) Error creating timing wheel.\ntwlCreate: ") ;
+        PUSH_ERRNO ;  free (sd) ;  POP_ERRNO ;
+        return (NULL) ;
+    }
+
+    SOX_LOCK ;
+    sd->next = dispatcherList ;
+    dispatcherList = sd ;
+    SOX_UNLOCK ;
+    lastFound = sd ;
+
+    LGI "(soxFind) Attached to dispatcher %p.\n", (void *) dispatcher) ;
+
+    return (sd) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxFlushCB ()
+
+    Run the Deferred Work Queued Before the Flush.
+
+
+Purpose:
+
+    Function soxFlushCB() is the IOX callback for the zero-delay timer that
+    flushes a dispatcher's queue of deferred work.  The nodes that were
+    queued before the flush began are removed from the queue and run in
+    order; nodes queued while the flush is in progress are left for the
+    next flush.
+
+
+    Invocation:
+
+        status = soxFlushCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the IOX timer.
+        <reason>	- I
+            is the reason (IoxFire or IoxCancel) the callback is being invoked.
+        <userData>	- I
+            is the address of the dispatcher state.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  soxFlushCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd = (SoxDispatcher) userData ;
+
+
+
+    if (callback == sd->flush)  sd->flush = NULL ;
+    if (reason == IoxCancel)  return (0) ;
+
+    soxFlush (sd->dispatcher, NULL) ;
+
+/* If work was queued during the flush, make sure another flush is armed. */
+
+    if ((sd->deferred != NULL) && (sd->flush == NULL)) {
+        sd->flush = ioxAfter (sd->dispatcher, soxFlushCB, sd, 0.0) ;
+        if (sd->flush == NULL) {
+            LGE "(soxFlushCB) Error arming flush for dispatcher %p.\nioxAfter: ",
+                (void *) sd->dispatcher) ;
+        }
+    }
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxMailboxCB ()
+
+    Run the Work Posted to a Mailbox.
+
+
+Purpose:
+
+    Function soxMailboxCB() is the IOX callback invoked when a dispatcher's
+    mailbox is woken up.  The wakeup descriptor is drained, everything
+    posted to the mailbox so far is taken from the mailbox in one step, and
+    the posted functions are run in order.  Work posted while the functions
+    are running is left for the next wakeup.
+
+
+    Invocation:
+
+        status = soxMailboxCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the IOX callback.
+        <reason>	- I
+            is the reason (IoxRead, IoxFire, or IoxCancel) the callback is
+            being invoked.
+        <userData>	- I
+            is the address of the dispatcher state.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  soxMailboxCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd = (SoxDispatcher) userData ;
+    SoxPost  *post, *posts ;
+#if HAVE_PTHREADS
+    char  buffer[64] ;
+#endif
+
+
+
+    if (reason == IoxCancel) {
+        if (callback == sd->mailbox)  sd->mailbox = NULL ;
+        return (0) ;
+    }
+
+/* Drain the wakeup descriptor before emptying the mailbox; a post that
+   arrives in between finds the mailbox non-empty and doesn't write, but
+   it is taken along with the rest. */
+
+#if HAVE_PTHREADS
+    while (read (sd->wakeup[0], buffer, sizeof buffer) > 0)
+        ;
+#else
+    SOX_LOCK ;
+    if (callback == sd->mailbox)  sd->mailbox = NULL ;
+    SOX_UNLOCK ;
+#endif
+
+    SOX_LOCK ;
+    posts = sd->posts ;
+    sd->posts = sd->lastPost = NULL ;
+    SOX_UNLOCK ;
+
+    while ((post = posts) != NULL) {
+        posts = post->next ;
+        post->func (IoxFire, post->userData) ;
+        free (post) ;
+    }
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxProbeCB ()
+
+    Handle the Lag Probe Timer.
+
+
+Purpose:
+
+    Function soxProbeCB() is the handler for the periodic wheel timer set
+    up by soxProbe().  The timer's only purpose is to make the timer driving
+    the wheel fire (and be sampled) regularly, so firing is ignored.
+
+
+    Invocation:
+
+        status = soxProbeCB (timer, reason, userData) ;
+
+    where:
+
+        <timer>		- I
+            is the probe timer.
+        <reason>	- I
+            is the reason (IoxFire or IoxCancel) the handler is being invoked.
+        <userData>	- I
+            is the address of the dispatcher state.
+        <status>	- O
+            always returns zero.
+
+*******************************************************************************/
+
+
+static  errno_t  soxProbeCB (
+
+#    if PROTOTYPES
+        TwlTimer  timer,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        timer, reason, userData)
+
+        TwlTimer  timer ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd = (SoxDispatcher) userData ;
+
+
+
+    if ((reason == IoxCancel) && (timer == sd->probe))  sd->probe = NULL ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxReport ()
+
+    Report a Stalled Dispatcher.
+
+
+Purpose:
+
+    Function soxReport() writes a report of a stalled dispatcher to standard
+    error.  It is called from the watchdog thread with the mutex held, so
+    the activity record is valid, but the interpreter is still running (or,
+    more likely, stuck) in the main thread.  The interpreter is therefore
+    not examined; only the names recorded in the activity by the main thread
+    (the callback's name and, see soxForeign(), the foreign function's) are
+    reported.
+
+
+    Invocation:
+
+        soxReport (sd, activity, elapsed) ;
+
+    where:
+
+        <sd>		- I
+            is the dispatcher state.
+        <activity>	- I
+            is the innermost callback in progress.
+        <elapsed>	- I
+            is the time in seconds the callback has been running.
+
+*******************************************************************************/
+
+
+static  void  soxReport (
+
+#    if PROTOTYPES
+        SoxDispatcher  sd,
+        SoxActivity  *activity,
+        double  elapsed)
+#    else
+        sd, activity, elapsed)
+
+        SoxDispatcher  sd ;
+        SoxActivity  *activity ;
+        double  elapsed ;
+#    endif
+
+{    /* Local variables. */
+    const  char  *foreign = activity->foreign ;
+
+
+
+    fprintf (stderr,
+             "(iox) Stall: dispatcher %p busy for %.3f seconds in %s callback %s%s%s.\n",
+             (void *) sd->dispatcher, elapsed, activity->kind,
+             (activity->name == NULL) ? "<anonymous>" : activity->name,
+             (foreign == NULL) ? "" : ", foreign function ",
+             (foreign == NULL) ? "" : foreign) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxSample ()
+
+    Record a Sample of the Stack of Activities.
+
+
+Purpose:
+
+    Function soxSample() folds the stack of activities, from the outermost
+    in to the given activity, into a string and adds the sampled cells to
+    the stack's entry in the allocation profile, creating the entry if the
+    stack hasn't been seen before.  Spaces and semicolons in the names of
+    the frames, which would confuse flame-graph tools, are replaced by
+    underscores.  Stacks deeper than SOX_PROFILE_DEPTH lose their outermost
+    frames.
+
+
+    Invocation:
+
+        soxSample (sd, activity, samples) ;
+
+    where
+
+        <sd>		- I
+            is the dispatcher state.
+        <activity>	- I
+            is the innermost activity in the stack.
+        <samples>	- I
+            is the number of samples being taken; the stack is charged
+            with <samples> times the sampling period.
+
+*******************************************************************************/
+
+
+static  void  soxSample (
+
+#    if PROTOTYPES
+        SoxDispatcher  sd,
+        SoxActivity  *activity,
+        long  samples)
+#    else
+        sd, activity, samples)
+
+        SoxDispatcher  sd ;
+        SoxActivity  *activity ;
+        long  samples ;
+#    endif
+
+{    /* Local variables. */
+    char  *s, frames[SOX_PROFILE_WIDTH] ;
+    int  depth ;
+    long  i ;
+    size_t  length ;
+    SoxActivity  *stack[SOX_PROFILE_DEPTH] ;
+    SoxStack  *entry ;
+
+
+
+/* Fold the stack, outermost activity first. */
+
+    for (depth = 0 ;  (activity != NULL) && (depth < SOX_PROFILE_DEPTH) ;
+         activity = activity->prev)
+        stack[depth++] = activity ;
+
+    length = 0 ;
+    frames[0] = '\0' ;
+    while (depth-- > 0) {
+        activity = stack[depth] ;
+        snprintf (&frames[length], sizeof frames - length, "%s%s%s%s",
+                  (length == 0) ? "" : ";", activity->kind,
+                  (activity->name == NULL) ? "" : ":",
+                  (activity->name == NULL) ? "" : activity->name) ;
+        for (s = &frames[(length == 0) ? 0 : length + 1] ;  *s != '\0' ;  s++)
+            if ((*s == ' ') || (*s == ';'))  *s = '_' ;
+        length += strlen (&frames[length]) ;
+    }
+
+/* Look up the stack's entry in the profile, adding it if necessary. */
+
+    for (i = 0 ;  i < sd->numStacks ;  i++)
+        if (strcmp (sd->stacks[i].frames, frames) == 0)  break ;
+
+    if (i == sd->numStacks) {
+        if (sd->numStacks >= sd->maxStacks) {
+            entry = (SoxStack *) realloc (sd->stacks,
+                                          (sd->maxStacks + 16) *
+                                          sizeof (SoxStack)) ;
+            if (entry == NULL) {
+                LGE "(soxSample) Error expanding profile of dispatcher %p.\nrealloc: ",
+                    (void *) sd->dispatcher) ;
+                return ;
+            }
+            sd->stacks = entry ;
+            sd->maxStacks += 16 ;
+        }
+        entry = &sd->stacks[i] ;
+        entry->frames = strdup (frames) ;
+        if (entry->frames == NULL) {
+            LGE "(soxSample) Error duplicating stack \"%s\".\nstrdup: ",
+                frames) ;
+            return ;
+        }
+        entry->cells = 0 ;
+        entry->samples = 0 ;
+        sd->numStacks++ ;
+    }
+
+    sd->stacks[i].cells += (unsigned long) (samples * sd->profPeriod) ;
+    sd->stacks[i].samples += (unsigned long) samples ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxSignalCB ()
+
+    Deliver the Signals Received by a Dispatcher.
+
+
+Purpose:
+
+    Function soxSignalCB() is the IOX callback invoked when a dispatcher's
+    signal descriptor becomes readable.  All the pending signals are read,
+    duplicates are coalesced, and each watcher of each signal received is
+    called once, in increasing order of signal number.
+
+
+    Invocation:
+
+        status = soxSignalCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the IOX callback.
+        <reason>	- I
+            is the reason (IoxRead or IoxCancel) the callback is being
+            invoked.
+        <userData>	- I
+            is the address of the dispatcher state.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  soxSignalCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd = (SoxDispatcher) userData ;
+#if HAVE_PTHREADS
+    bool  received[SOX_SIGNALS] ;
+    int  i, signo ;
+    ssize_t  length ;
+    SoxSignal  next, watcher ;
+#    if HAVE_SIGNALFD
+    struct  signalfd_siginfo  buffer[16] ;
+#    else
+    unsigned  char  buffer[64] ;
+#    endif
+#endif
+
+
+
+    if (reason == IoxCancel) {
+        if (callback == sd->signalCB)  sd->signalCB = NULL ;
+        return (0) ;
+    }
+
+#if HAVE_PTHREADS
+
+/* Read the pending signals. */
+
+    memset (received, 0, sizeof received) ;
+
+    while ((length = read (sd->signalFd[0], buffer, sizeof buffer)) > 0) {
+        for (i = 0 ;  i < (int) (length / sizeof buffer[0]) ;  i++) {
+#    if HAVE_SIGNALFD
+            signo = (int) buffer[i].ssi_signo ;
+#    else
+            signo = (int) buffer[i] ;
+#    endif
+            if ((signo > 0) && (signo < SOX_SIGNALS))  received[signo] = true ;
+        }
+    }
+
+/* Call the watchers.  Watchers canceled along the way are only marked as
+   dead, so the list stays intact; they are deallocated afterwards. */
+
+    sd->delivering = true ;
+
+    for (signo = 1 ;  signo < SOX_SIGNALS ;  signo++) {
+        if (!received[signo])  continue ;
+        LGI "(soxSignalCB) Dispatcher %p, signal %d.\n",
+            (void *) sd->dispatcher, signo) ;
+        for (watcher = sd->signals ;  watcher != NULL ;  watcher = watcher->next) {
+            if ((watcher->signo == signo) && !watcher->dead)
+                watcher->handler (watcher, SOX_SIGNAL, watcher->userData) ;
+        }
+    }
+
+    sd->delivering = false ;
+
+    for (watcher = sd->signals ;  watcher != NULL ;  watcher = next) {
+        next = watcher->next ;
+        if (watcher->dead)  soxSignalFree (watcher) ;
+    }
+
+#endif
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxSignalFree ()
+
+    Deallocate a Signal Watcher.
+
+
+Purpose:
+
+    Function soxSignalFree() removes a watcher from its dispatcher's list of
+    watchers, calls the watcher's handler with reason IoxCancel, and frees
+    the watcher.  If this was the signal's last watcher in the dispatcher,
+    the signal is no longer read through the dispatcher; if it was the last
+    in the process, the signal's original handling is restored.  (With
+    signalfd(2), the signal is unblocked, so any instance of the signal
+    still pending is then handled as it would have been without watchers.)
+
+
+    Invocation:
+
+        soxSignalFree (watcher) ;
+
+    where:
+
+        <watcher>	- I
+            is the watcher.
+
+*******************************************************************************/
+
+
+static  void  soxSignalFree (
+
+#    if PROTOTYPES
+        SoxSignal  watcher)
+#    else
+        watcher)
+
+        SoxSignal  watcher ;
+#    endif
+
+{    /* Local variables. */
+    SoxDispatcher  sd ;
+    SoxSignal  prev ;
+#if HAVE_PTHREADS
+    bool  watched ;
+    int  signo ;
+#    if HAVE_SIGNALFD
+    sigset_t  mask ;
+#    endif
+#endif
+
+
+
+    sd = watcher->sd ;
+#if HAVE_PTHREADS
+    signo = watcher->signo ;
+#endif
+
+    if (sd->signals == watcher) {
+        sd->signals = watcher->next ;
+    } else {
+        for (prev = sd->signals ;  prev->next != watcher ;  prev = prev->next)
+            ;
+        prev->next = watcher->next ;
+    }
+
+    watcher->dead = true ;
+    watcher->handler (watcher, IoxCancel, watcher->userData) ;
+    free (watcher) ;
+
+#if HAVE_PTHREADS
+
+/* Stop reading the signal if the dispatcher no longer watches it. */
+
+    watched = false ;
+    for (prev = sd->signals ;  prev != NULL ;  prev = prev->next) {
+        if (prev->signo == signo)  watched = true ;
+    }
+
+#    if HAVE_SIGNALFD
+    if (!watched) {
+        sigemptyset (&mask) ;
+        for (prev = sd->signals ;  prev != NULL ;  prev = prev->next)
+            sigaddset (&mask, prev->signo) ;
+        signalfd (sd->signalFd[0], &mask, 0) ;
+    }
+#    else
+    if (!watched && (signalPipe[signo] == sd->signalFd[1]))
+        signalPipe[signo] = -1 ;
+#    endif
+
+/* Restore the original handling if the process no longer watches it. */
+
+    if (--signalWatchers[signo] == 0) {
+#    if HAVE_SIGNALFD
+        sigemptyset (&mask) ;
+        sigaddset (&mask, signo) ;
+        pthread_sigmask (SIG_UNBLOCK, &mask, NULL) ;
+#    else
+        sigaction (signo, &signalAction[signo], NULL) ;
+#    endif
+    }
+#endif
+
+    return ;
+
+}
+
+#if HAVE_PTHREADS && !HAVE_SIGNALFD
+/*!*****************************************************************************
+
+Procedure:
+
+    soxSignalHandler ()
+
+    Forward a Signal to a Dispatcher's Pipe.
+
+
+Purpose:
+
+    Function soxSignalHandler() is the signal handler installed for watched
+    signals on systems without signalfd(2).  It writes the signal number to
+    the pipe of the dispatcher watching the signal; if the pipe is full, the
+    signal is already pending there and nothing is lost by dropping it.
+
+
+    Invocation:
+
+        soxSignalHandler (signo) ;
+
+    where:
+
+        <signo>		- I
+            is the number of the signal received.
+
+*******************************************************************************/
+
+
+static  void  soxSignalHandler (
+
+#    if PROTOTYPES
+        int  signo)
+#    else
+        signo)
+
+        int  signo ;
+#    endif
+
+{    /* Local variables. */
+    int  fd, savedErrno ;
+    unsigned  char  byte ;
+
+
+
+    savedErrno = errno ;
+
+    fd = signalPipe[signo] ;
+    byte = (unsigned char) signo ;
+    if ((fd >= 0) && (write (fd, &byte, 1) < 0))
+        byte = 0 ;
+
+    errno = savedErrno ;
+
+    return ;
+
+}
+#endif
+
+/*!*****************************************************************************
+
+Procedure:
+
+    soxTickCB ()
+
+    Run the Wheel when the Dispatcher Timer Fires.
+
+
+Purpose:
+
+    Function soxTickCB() is the IOX callback for the timer driving a timing
+    wheel.  When the timer fires, the wheel's expired timers are fired and
+    the timer is re-armed for the wheel's next expiration.
+
+
+    Invocation:
+
+        status = soxTickCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the IOX timer.
+        <reason>	- I
+            is the reason (IoxFire or IoxCancel) the callback is being invoked.
+        <userData>	- I
+            is the address of the dispatcher state.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  soxTickCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    double  lag ;
+    SoxDispatcher  sd = (SoxDispatcher) userData ;
+
+
+
+/* A single-shot IOX timer is canceled after it fires, by which time the
+   wheel may have been re-armed with a different timer; only forget the
+   current timer. */
+
+    if (reason == IoxCancel) {
+        if (callback == sd->tick)  sd->tick = NULL ;
+        if (callback == sd->ticking) {
+            sd->ticking = NULL ;
+            if (sd->detached && !sd->running)  free (sd) ;	/* See below. */
+        }
+        return (0) ;
+    }
+
+    if (callback != sd->tick)  return (0) ;	/* Stale timer. */
+    sd->tick = NULL ;
+
+/* Sample the lateness of the timer. */
+
+    lag = tvFloat (tvSubtract (tvTOD (), sd->tickTime)) ;
+    if (lag < 0.0)  lag = 0.0 ;
+    sd->lag[sd->lagCount++ % SOX_LAG_SAMPLES] = lag ;
+    if (lag > sd->lagMax)  sd->lagMax = lag ;
+
+/* Run the wheel.  A timer handler may detach the dispatcher (e.g., with
+   IOX-DESTROY), in which case soxDetach() leaves the state for this
+   function to free.  The state is freed once the wheel stops running or,
+   if this IOX timer is still to be canceled (as a single-shot timer is
+   after it fires), when the cancellation arrives, since it is delivered
+   with the state as user data. */
+
+    sd->ticking = callback ;
+    sd->running = true ;
+
+    twlRun (sd->wheel) ;
+
+    sd->running = false ;
+
+    if (sd->detached) {
+        if (sd->ticking == NULL)  free (sd) ;	/* Already canceled. */
+        return (0) ;
+    }
+
+    sd->ticking = NULL ;
+
+    soxArm (sd) ;
+
+    return (0) ;
+
+}
+
+#if HAVE_PTHREADS
+/*!*****************************************************************************
+
+Procedure:
+
+    soxWatchdogThread ()
+
+    Watch Dispatchers for Stalls.
+
+
+Purpose:
+
+    Function soxWatchdogThread() is the body of the watchdog thread.  The
+    thread wakes up periodically - a quarter of the smallest threshold,
+    but no more than once every 10 milliseconds - and checks the innermost
+    callback in progress on each dispatcher with a threshold.  A callback
+    that has been running longer than the threshold is reported once.
+
+
+    Invocation:
+
+        soxWatchdogThread (arg) ;
+
+    where:
+
+        <arg>		- I
+            is unused.
+
+*******************************************************************************/
+
+
+static  void  *soxWatchdogThread (
+
+#    if PROTOTYPES
+        void  *arg)
+#    else
+        arg)
+
+        void  *arg ;
+#    endif
+
+{    /* Local variables. */
+    double  elapsed, period ;
+    sigset_t  mask ;
+    SoxActivity  *activity ;
+    SoxDispatcher  sd ;
+    struct  timeval  now ;
+
+
+
+/* Leave all signals to the main thread. */
+
+    sigfillset (&mask) ;
+    pthread_sigmask (SIG_BLOCK, &mask, NULL) ;
+
+    period = 1.0 ;
+
+    for ( ; ; ) {
+
+        usleep ((useconds_t) (period * 1000000.0)) ;
+
+        SOX_LOCK ;
+        now = tvTOD () ;
+        period = 1.0 ;
+        for (sd = dispatcherList ;  sd != NULL ;  sd = sd->next) {
+            if (sd->watchdog <= 0.0)  continue ;
+            if ((sd->watchdog / 4.0) < period)  period = sd->watchdog / 4.0 ;
+            activity = sd->active ;
+            if ((activity == NULL) || activity->reported)  continue ;
+            elapsed = tvFloat (tvSubtract (now, activity->start)) ;
+            if (elapsed < sd->watchdog)  continue ;
+            soxReport (sd, activity, elapsed) ;
+            activity->reported = true ;
+        }
+        SOX_UNLOCK ;
+
+        if (period < 0.010)  period = 0.010 ;
+
+    }
+
+    return (NULL) ;
+
+}
+#endif
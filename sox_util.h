@@ -0,0 +1,267 @@
+/* $Id$ */
+/*******************************************************************************
+
+    sox_util.h
+
+    Scheme I/O Event Dispatcher Utility Definitions.
+
+*******************************************************************************/
+
+#ifndef  SOX_UTIL_H		/* Has the file been INCLUDE'd already? */
+#define  SOX_UTIL_H  yes
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+extern  "C"  {
+#endif
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+#include  <scheme.h>			/* TinyScheme definitions. */
+#include  "scheme-private.h"		/* TinyScheme internals. */
+#include  "iox_util.h"			/* I/O event dispatcher definitions. */
+#include  "tv_util.h"			/* "timeval" manipulation functions. */
+#include  "twl_util.h"			/* Timing wheels. */
+
+
+/*******************************************************************************
+    Deferred work - an application embeds a SoxDeferred node in its own
+        structure, fills in the function and user data, and queues the node
+        with soxDefer().  Queued nodes are run, in the order queued, at the
+        start of the dispatcher's next iteration.  A node is queued at most
+        once, no matter how many times soxDefer() is called before it runs.
+        If soxDetach() discards the queue, the node's discard function, if
+        any, is called instead; it must not queue work with the dispatcher.
+*******************************************************************************/
+
+typedef  errno_t  (*SoxDeferFunc) P_((void *userData)) ;
+
+typedef  struct  _SoxDeferred {
+    struct  _SoxDeferred  *next ;	/* Links in dispatcher's queue. */
+    struct  _SoxDeferred  *prev ;
+    SoxDeferFunc  func ;		/* Function to run. */
+    SoxDeferFunc  discard ;		/* Called if discarded; NULL if none. */
+    void  *userData ;			/* Arbitrary data passed to function. */
+    bool  queued ;			/* Is the node in a queue? */
+    unsigned  long  generation ;	/* Flush in which node was queued. */
+}  SoxDeferred ;
+
+
+/*******************************************************************************
+    Posted work - a function and argument posted to a dispatcher's mailbox
+        by soxPost().  The function is called in the dispatcher's thread with
+        reason IoxFire, or with reason IoxCancel if the dispatcher is
+        destroyed first.
+*******************************************************************************/
+
+typedef  errno_t  (*SoxPostFunc) P_((IoxReason reason,
+                                     void *userData)) ;
+
+
+/*******************************************************************************
+    Signal watchers - a handler registered by soxOnSignal() is called in the
+        dispatcher's thread with reason SOX_SIGNAL when the signal has been
+        received, and with reason IoxCancel when the watcher is canceled.
+*******************************************************************************/
+
+typedef  struct  _SoxSignal  *SoxSignal ;	/* Watcher handle. */
+
+typedef  errno_t  (*SoxSignalFunc) P_((SoxSignal watcher,
+                                       IoxReason reason,
+                                       void *userData)) ;
+
+					/* Reason: signal received. */
+#define  SOX_SIGNAL  ((IoxReason) 64)
+
+
+/*******************************************************************************
+    Activities - an application brackets each callback it dispatches with
+        soxEnter() and soxLeave(), passing an SoxActivity record (usually
+        on the stack) that describes the callback.  The dispatcher's stall
+        watchdog reports the innermost activity when the event loop has
+        not returned to the dispatcher for too long, and the allocation
+        profiler charges the cells allocated by the interpreter to the
+        stack of activities in progress.
+*******************************************************************************/
+
+typedef  struct  _SoxActivity {
+    struct  _SoxActivity  *prev ;	/* Enclosing activity, if any. */
+    const  char  *kind ;		/* Kind of callback; e.g., "iox-onio". */
+    const  char  *name ;		/* Name of callback function (or NULL). */
+    scheme  *sc ;			/* Interpreter running the callback. */
+    const  char  *foreign ;		/* Foreign function executing (or NULL). */
+    struct  timeval  start ;		/* Time callback was entered. */
+    long  cells ;			/* Free cells when callback was entered. */
+    long  mark ;			/* Free cells at last profiler check. */
+    long  collections ;			/* GCs run as of last profiler check. */
+    bool  reported ;			/* Has the watchdog reported a stall? */
+}  SoxActivity ;
+
+
+/*******************************************************************************
+    Event-loop lag - the lateness of the timer driving a dispatcher's timing
+        wheel, sampled each time the timer fires.
+*******************************************************************************/
+
+typedef  struct  SoxLag {
+    unsigned  long  count ;		/* Number of samples taken. */
+    double  p50 ;			/* Median of recent samples (seconds). */
+    double  p99 ;			/* 99th percentile of recent samples. */
+    double  max ;			/* Maximum of all samples. */
+}  SoxLag ;
+
+					/* Number of recent samples kept. */
+#define  SOX_LAG_SAMPLES  1024
+
+
+/*******************************************************************************
+    Allocation profile - the stacks of activities sampled by the allocation
+        profiler (see soxProfile()), each folded into a single string of the
+        form "<outer>;...;<inner>", where each frame is "<kind>" or, for
+        named callbacks, "<kind>:<name>".
+*******************************************************************************/
+
+					/* Deepest stack recorded. */
+#ifndef SOX_PROFILE_DEPTH
+#    define  SOX_PROFILE_DEPTH  32
+#endif
+					/* Longest folded stack kept. */
+#ifndef SOX_PROFILE_WIDTH
+#    define  SOX_PROFILE_WIDTH  512
+#endif
+
+
+/*******************************************************************************
+    Miscellaneous declarations.
+*******************************************************************************/
+
+					/* Global debug switch (1/0 = yes/no). */
+extern  int  sox_util_debug  OCD ("sox_util") ;
+
+
+/*******************************************************************************
+    Public functions.
+*******************************************************************************/
+
+extern  TwlTimer  soxAfter P_((IoxDispatcher dispatcher,
+                               TwlHandler handler,
+                               void *userData,
+                               double delay))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxCancelSignal P_((SoxSignal watcher))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxDefer P_((IoxDispatcher dispatcher,
+                              SoxDeferred *node))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxDetach P_((IoxDispatcher dispatcher))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxEnter P_((IoxDispatcher dispatcher,
+                              SoxActivity *activity))
+    OCD ("sox_util") ;
+
+extern  TwlTimer  soxEvery P_((IoxDispatcher dispatcher,
+                               TwlHandler handler,
+                               void *userData,
+                               double delay,
+                               double interval))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxFlush P_((IoxDispatcher dispatcher,
+                              long *count))
+    OCD ("sox_util") ;
+
+extern  const  char  *soxForeign P_((scheme *sc,
+                                     const char *name))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxLag P_((IoxDispatcher dispatcher,
+                            SoxLag *lag))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxLeave P_((IoxDispatcher dispatcher,
+                              SoxActivity *activity))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxMailbox P_((IoxDispatcher dispatcher))
+    OCD ("sox_util") ;
+
+extern  SoxSignal  soxOnSignal P_((IoxDispatcher dispatcher,
+                                   int signo,
+                                   SoxSignalFunc handler,
+                                   void *userData))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxPost P_((IoxDispatcher dispatcher,
+                             SoxPostFunc func,
+                             void *userData))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxProbe P_((IoxDispatcher dispatcher,
+                              double interval))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxProfile P_((IoxDispatcher dispatcher,
+                                long period))
+    OCD ("sox_util") ;
+
+extern  const  char  *soxProfileStack P_((IoxDispatcher dispatcher,
+                                          long index,
+                                          unsigned long *cells,
+                                          unsigned long *samples))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxProfileWrite P_((IoxDispatcher dispatcher,
+                                     FILE *file))
+    OCD ("sox_util") ;
+
+extern  long  soxProfiling P_((IoxDispatcher dispatcher))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxReschedule P_((IoxDispatcher dispatcher,
+                                   TwlTimer timer,
+                                   double delay))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxRunSlice P_((IoxDispatcher dispatcher,
+                                 long maxEvents,
+                                 double maxTime,
+                                 long *handled,
+                                 double *next))
+    OCD ("sox_util") ;
+
+extern  unsigned  long  soxSerial P_((IoxDispatcher dispatcher))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxSetSlow P_((IoxDispatcher dispatcher,
+                                double threshold))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxSetWatchdog P_((IoxDispatcher dispatcher,
+                                    double threshold))
+    OCD ("sox_util") ;
+
+extern  bool  soxSliceDone P_((IoxDispatcher dispatcher))
+    OCD ("sox_util") ;
+
+extern  double  soxSlow P_((IoxDispatcher dispatcher))
+    OCD ("sox_util") ;
+
+extern  errno_t  soxUndefer P_((IoxDispatcher dispatcher,
+                                SoxDeferred *node))
+    OCD ("sox_util") ;
+
+extern  double  soxWatchdog P_((IoxDispatcher dispatcher))
+    OCD ("sox_util") ;
+
+extern  TwlWheel  soxWheel P_((IoxDispatcher dispatcher))
+    OCD ("sox_util") ;
+
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+}
+#endif
+
+#endif				/* If this file was not INCLUDE'd previously. */
@@ -0,0 +1,1734 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    spx_util.c
+
+    Spawned Process Utilities.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The SPX_UTIL package runs child processes under the control of an I/O
+    event dispatcher.  spxSpawn() forks and executes a program with its
+    standard input, output, and error connected to non-blocking pipes.
+    The output pipes are registered with the dispatcher, and output is
+    delivered to the application's handler in chunks as it arrives; input
+    written with spxWrite() is buffered and fed to the child as fast as the
+    child reads it.  None of this ever blocks the dispatcher, so any number
+    of children can run concurrently with the rest of the application.
+
+    When the child exits, the handler is called once more, after all the
+    child's output has been delivered, with the exit status.  The exit is
+    detected through a pidfd(2), where available, or else by watching for
+    SIGCHLD through the dispatcher (see soxOnSignal()).  Only the children
+    spawned by SPX_UTIL are reaped, by process ID, so other children of the
+    application are unaffected.
+
+        #include  "spx_util.h"			-- Spawned processes.
+        char  *argv[] = { "sort", "-n", NULL } ;
+        SpxProcess  process ;
+        ...
+        process = spxSpawn (dispatcher, argv, myHandler, myData) ;
+        spxWrite (process, "3\n1\n2\n", 6) ;
+        spxCloseInput (process) ;
+        ...
+        ioxMonitor (dispatcher, -1.0) ;	-- myHandler() gets the output.
+
+    A process handle is released after the handler is called with reason
+    IoxCancel: either after the exit has been delivered or when the process
+    is canceled with spxCancel().  A canceled child is not killed; it is
+    still reaped when it exits.  Processes should be canceled (or allowed
+    to finish) before their dispatcher is destroyed.
+
+
+Public Procedures:
+
+    spxCancel() - stops delivering a process's events.
+    spxCloseInput() - closes a process's standard input.
+    spxExitCode() - returns a process's exit code.
+    spxKill() - sends a signal to a process.
+    spxPid() - returns a process's process ID.
+    spxSpawn() - spawns a child process.
+    spxStatus() - returns a process's raw exit status.
+    spxWrite() - writes data to a process's standard input.
+
+Private Procedures:
+
+    spxCheck() - delivers a process's exit or frees the process.
+    spxClose() - closes one of a process's pipes.
+    spxExitCB() - handles the exit of a process with a pidfd.
+    spxFree() - deallocates a process.
+    spxInputCB() - feeds buffered input to a process.
+    spxOrphan() - handles the destruction of a process's dispatcher.
+    spxOutputCB() - delivers a process's output.
+    spxPipe() - creates a close-on-exec pipe.
+    spxReap() - checks if a process has exited.
+    spxReaperCB() - reaps processes when SIGCHLD is received.
+    spxSweep() - checks all of a dispatcher's processes.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <limits.h>			/* Maximum/minimum value definitions. */
+#include  <signal.h>			/* Signal definitions. */
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <string.h>			/* C Library string functions. */
+#ifndef HAVE_FORK			/* Spawning supported? */
+#    if defined(_WIN32) || defined(NDS)
+#        define  HAVE_FORK  0
+#    else
+#        define  HAVE_FORK  1
+#    endif
+#endif
+#if HAVE_FORK
+#    include  <fcntl.h>			/* File control definitions. */
+#    include  <unistd.h>		/* UNIX-specific definitions. */
+#    include  <sys/wait.h>		/* Process wait definitions. */
+#    if defined(__linux__)
+#        include  <sys/syscall.h>	/* System call numbers. */
+#    endif
+#endif
+#include  "sox_util.h"			/* Scheme dispatcher utilities. */
+#include  "spx_util.h"			/* Spawned processes. */
+
+
+int  spx_util_debug = 0 ;		/* Global debug switch (1/0 = yes/no). */
+#undef  I_DEFAULT_GUARD
+#define  I_DEFAULT_GUARD  spx_util_debug
+
+
+/*******************************************************************************
+    Spawned Process (Internal View) and Definitions.
+*******************************************************************************/
+
+typedef  struct  _SpxProcess {
+    struct  _SpxProcess  *next ;	/* Link in list of processes. */
+    IoxDispatcher  dispatcher ;		/* Dispatcher monitoring process. */
+    long  pid ;				/* Process ID. */
+    int  fdIn, fdOut, fdErr ;		/* Parent's ends of the pipes. */
+    int  fdExit ;			/* Process's pidfd; -1 if none. */
+    IoxCallback  cbIn, cbOut, cbErr ;	/* IOX callbacks for the pipes ... */
+    IoxCallback  cbExit ;		/* ... and for the pidfd. */
+    char  *pending ;			/* Input not yet written to child. */
+    size_t  pendingLength ;
+    bool  closeInput ;			/* Close input when pending written? */
+    bool  exited ;			/* Has the process been reaped? */
+    int  status ;			/* Exit status from waitpid(2). */
+    bool  reported ;			/* Has handler seen IoxCancel? */
+    bool  orphaned ;			/* Was dispatcher destroyed? */
+    int  busy ;				/* Number of active handler calls. */
+    SpxHandler  handler ;		/* Function to call on events. */
+    void  *userData ;			/* Arbitrary data passed to handler. */
+}  _SpxProcess ;
+
+static  SpxProcess  processList = NULL ;
+
+/* Dispatchers on which SIGCHLD is watched for processes without pidfds. */
+
+typedef  struct  SpxReaper {
+    struct  SpxReaper  *next ;		/* Link in list of reapers. */
+    IoxDispatcher  dispatcher ;		/* Dispatcher watching SIGCHLD. */
+    SoxSignal  watcher ;		/* SIGCHLD watcher. */
+}  SpxReaper ;
+
+static  SpxReaper  *reaperList = NULL ;
+
+
+/*******************************************************************************
+    Private functions.
+*******************************************************************************/
+
+static  bool  spxCheck P_((SpxProcess process)) ;
+
+static  void  spxClose P_((IoxCallback *callback,
+                           int *fd)) ;
+
+static  errno_t  spxExitCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+static  void  spxFree P_((SpxProcess process)) ;
+
+static  errno_t  spxInputCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+static  void  spxOrphan P_((SpxProcess process,
+                            IoxCallback *callback,
+                            int *fd)) ;
+
+static  errno_t  spxOutputCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
+static  errno_t  spxPipe P_((int fds[2])) ;
+
+static  bool  spxReap P_((SpxProcess process)) ;
+
+static  errno_t  spxReaperCB P_((SoxSignal watcher,
+                                 IoxReason reason,
+                                 void *userData)) ;
+
+static  void  spxSweep P_((IoxDispatcher dispatcher)) ;
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxCancel ()
+
+    Stop Delivering a Process's Events.
+
+
+Purpose:
+
+    Function spxCancel() closes the pipes to and from a process, discards
+    any input not yet written to it, and calls the process's handler with
+    reason IoxCancel; the handler is not called again.  The process itself
+    is left running and is reaped, without notice, when it exits.
+
+
+    Invocation:
+
+        status = spxCancel (process) ;
+
+    where
+
+        <process>	- I
+            is the process handle returned by spxSpawn().
+        <status>	- O
+            returns the status of canceling the process, zero if there were
+            no errors and ERRNO otherwise.  Canceling a process whose
+            handler has already seen IoxCancel has no effect.
+
+*******************************************************************************/
+
+
+errno_t  spxCancel (
+
+#    if PROTOTYPES
+        SpxProcess  process)
+#    else
+        process)
+
+        SpxProcess  process ;
+#    endif
+
+{
+
+    if (process == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(spxCancel) NULL process handle: ") ;
+        return (errno) ;
+    }
+
+    if (process->reported)  return (0) ;
+
+    LGI "(spxCancel) Process %ld.\n", process->pid) ;
+
+    spxClose (&process->cbIn, &process->fdIn) ;
+    spxClose (&process->cbOut, &process->fdOut) ;
+    spxClose (&process->cbErr, &process->fdErr) ;
+    free (process->pending) ;
+    process->pending = NULL ;
+    process->pendingLength = 0 ;
+
+    process->reported = true ;
+    process->busy++ ;
+    process->handler (process, IoxCancel, NULL, 0, process->userData) ;
+    process->busy-- ;
+
+    spxCheck (process) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxCloseInput ()
+
+    Close a Process's Standard Input.
+
+
+Purpose:
+
+    Function spxCloseInput() closes the pipe to a process's standard input,
+    so that the process sees end-of-file.  If input written with spxWrite()
+    is still waiting to be fed to the process, the pipe is closed after the
+    last of it has been written.
+
+
+    Invocation:
+
+        status = spxCloseInput (process) ;
+
+    where
+
+        <process>	- I
+            is the process handle returned by spxSpawn().
+        <status>	- O
+            returns the status of closing the input, zero if there were no
+            errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  spxCloseInput (
+
+#    if PROTOTYPES
+        SpxProcess  process)
+#    else
+        process)
+
+        SpxProcess  process ;
+#    endif
+
+{
+
+    if (process == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(spxCloseInput) NULL process handle: ") ;
+        return (errno) ;
+    }
+
+    if (process->pendingLength > 0)
+        process->closeInput = true ;
+    else
+        spxClose (&process->cbIn, &process->fdIn) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxExitCode ()
+
+    Get a Process's Exit Code.
+
+
+Purpose:
+
+    Function spxExitCode() returns the exit code of a process that exited
+    normally or, negated, the number of the signal that killed a process.
+
+
+    Invocation:
+
+        code = spxExitCode (process) ;
+
+    where
+
+        <process>	- I
+            is the process handle returned by spxSpawn().
+        <code>		- O
+            returns the process's exit code (0..255) or the negated number
+            of the signal that terminated it; INT_MIN is returned if the
+            process has not exited or its status is unknown.
+
+*******************************************************************************/
+
+
+int  spxExitCode (
+
+#    if PROTOTYPES
+        SpxProcess  process)
+#    else
+        process)
+
+        SpxProcess  process ;
+#    endif
+
+{
+
+    if ((process == NULL) || !process->exited || (process->status == -1))
+        return (INT_MIN) ;
+
+#if HAVE_FORK
+    if (WIFEXITED (process->status))
+        return (WEXITSTATUS (process->status)) ;
+    if (WIFSIGNALED (process->status))
+        return (-WTERMSIG (process->status)) ;
+#endif
+
+    return (INT_MIN) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxKill ()
+
+    Send a Signal to a Process.
+
+
+Purpose:
+
+    Function spxKill() sends a signal to a process.
+
+
+    Invocation:
+
+        status = spxKill (process, signo) ;
+
+    where
+
+        <process>	- I
+            is the process handle returned by spxSpawn().
+        <signo>		- I
+            is the signal to send; e.g., SIGTERM.
+        <status>	- O
+            returns the status of sending the signal, zero if there were no
+            errors and ERRNO otherwise.  ESRCH is returned if the process
+            has already exited.
+
+*******************************************************************************/
+
+
+errno_t  spxKill (
+
+#    if PROTOTYPES
+        SpxProcess  process,
+        int  signo)
+#    else
+        process, signo)
+
+        SpxProcess  process ;
+        int  signo ;
+#    endif
+
+{
+
+    if (process == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(spxKill) NULL process handle: ") ;
+        return (errno) ;
+    }
+
+#if HAVE_FORK
+    if (process->exited) {
+        SET_ERRNO (ESRCH) ;
+        LGE "(spxKill) Process %ld has exited.\n", process->pid) ;
+        return (errno) ;
+    }
+
+    if (kill ((pid_t) process->pid, signo)) {
+        LGE "(spxKill) Error sending signal %d to process %ld.\nkill: ",
+            signo, process->pid) ;
+        return (errno) ;
+    }
+
+    return (0) ;
+#else
+    SET_ERRNO (ENOSYS) ;
+    return (errno) ;
+#endif
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxPid ()
+
+    Get a Process's Process ID.
+
+
+Purpose:
+
+    Function spxPid() returns a process's process ID.
+
+
+    Invocation:
+
+        pid = spxPid (process) ;
+
+    where
+
+        <process>	- I
+            is the process handle returned by spxSpawn().
+        <pid>		- O
+            returns the process ID; -1 is returned for a NULL handle.
+
+*******************************************************************************/
+
+
+long  spxPid (
+
+#    if PROTOTYPES
+        SpxProcess  process)
+#    else
+        process)
+
+        SpxProcess  process ;
+#    endif
+
+{
+
+    return ((process == NULL) ? -1L : process->pid) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxSpawn ()
+
+    Spawn a Child Process.
+
+
+Purpose:
+
+    Function spxSpawn() forks a child process that executes a program, with
+    the child's standard input, output, and error connected to pipes that
+    are monitored by an I/O event dispatcher.  The program is located using
+    the PATH environment variable, as with execvp(3).  The child starts with
+    no signals blocked and with SIGPIPE handled by default, regardless of
+    the parent's settings.
+
+    If the program cannot be executed, spxSpawn() reaps the child and fails
+    with the error from execvp(3), so a misspelled program name is reported
+    to the caller rather than as an exit status.
+
+
+    Invocation:
+
+        process = spxSpawn (dispatcher, argv, handler, userData) ;
+
+    where
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+        <argv>		- I
+            is a NULL-terminated array of the program name and arguments.
+        <handler>	- I
+            is the function to be called with the process's output and exit
+            status; see SpxHandler in "spx_util.h".
+        <userData>	- I
+            is an arbitrary (VOID *) value passed to the handler.
+        <process>	- O
+            returns a handle for the process; NULL is returned in the event
+            of an error.
+
+*******************************************************************************/
+
+
+SpxProcess  spxSpawn (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher,
+        char  *const  argv[],
+        SpxHandler  handler,
+        void  *userData)
+#    else
+        dispatcher, argv, handler, userData)
+
+        IoxDispatcher  dispatcher ;
+        char  *argv[] ;
+        SpxHandler  handler ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+#if HAVE_FORK
+    int  error, execPipe[2], inPipe[2], errPipe[2], outPipe[2] ;
+    pid_t  pid ;
+    sigset_t  mask ;
+    ssize_t  length ;
+    SpxProcess  process ;
+    SpxReaper  *reaper ;
+#endif
+
+
+
+    if ((dispatcher == NULL) || (argv == NULL) || (argv[0] == NULL)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(spxSpawn) NULL dispatcher or program: ") ;
+        return (NULL) ;
+    }
+
+#if HAVE_FORK
+
+    process = (SpxProcess) calloc (1, sizeof (_SpxProcess)) ;
+    if (process == NULL) {
+        LGE "(spxSpawn) Error allocating process structure for %s.\ncalloc: ",
+            argv[0]) ;
+        return (NULL) ;
+    }
+
+    process->dispatcher = dispatcher ;
+    process->fdIn = process->fdOut = process->fdErr = process->fdExit = -1 ;
+    process->handler = handler ;
+    process->userData = userData ;
+
+/* Create the pipes.  All the descriptors are close-on-exec; the child's
+   ends are duplicated onto its standard I/O descriptors, which aren't.
+   The exec pipe reports a failure to execute the program: if it is closed
+   without any data, the exec succeeded. */
+
+    inPipe[0] = inPipe[1] = outPipe[0] = outPipe[1] = -1 ;
+    errPipe[0] = errPipe[1] = execPipe[0] = execPipe[1] = -1 ;
+
+    if (spxPipe (inPipe) || spxPipe (outPipe) ||
+        spxPipe (errPipe) || spxPipe (execPipe)) {
+        LGE "(spxSpawn) Error creating pipes for %s.\nspxPipe: ", argv[0]) ;
+        goto onError ;
+    }
+
+/* Without a pidfd, the process is reaped when SIGCHLD is received.  Whether
+   a pidfd can be had isn't known until after the fork, by which time an
+   early exit could be missed, so the signal is watched regardless. */
+
+    for (reaper = reaperList ;  reaper != NULL ;  reaper = reaper->next) {
+        if (reaper->dispatcher == dispatcher)  break ;
+    }
+    if (reaper == NULL) {
+        reaper = (SpxReaper *) malloc (sizeof (SpxReaper)) ;
+        if (reaper == NULL) {
+            LGE "(spxSpawn) Error allocating reaper.\nmalloc: ") ;
+            goto onError ;
+        }
+        reaper->dispatcher = dispatcher ;
+        reaper->watcher = soxOnSignal (dispatcher, SIGCHLD, spxReaperCB,
+                                       reaper) ;
+        if (reaper->watcher == NULL) {
+            LGE "(spxSpawn) Error watching SIGCHLD.\nsoxOnSignal: ") ;
+            PUSH_ERRNO ;  free (reaper) ;  POP_ERRNO ;
+            goto onError ;
+        }
+        reaper->next = reaperList ;
+        reaperList = reaper ;
+    }
+
+/* Fork the child.  Between the fork and the exec, the child only calls
+   async-signal-safe functions. */
+
+    pid = fork () ;
+
+    if (pid < 0) {
+        LGE "(spxSpawn) Error forking %s.\nfork: ", argv[0]) ;
+        goto onError ;
+    }
+
+    if (pid == 0) {				/* Child process. */
+        dup2 (inPipe[0], 0) ;
+        dup2 (outPipe[1], 1) ;
+        dup2 (errPipe[1], 2) ;
+        sigemptyset (&mask) ;
+        sigprocmask (SIG_SETMASK, &mask, NULL) ;
+        signal (SIGPIPE, SIG_DFL) ;
+        execvp (argv[0], argv) ;
+        error = errno ;
+        if (write (execPipe[1], &error, sizeof error) < 0)
+            error = 0 ;
+        _exit (127) ;
+    }
+
+    process->pid = (long) pid ;				/* Parent process. */
+
+    close (inPipe[0]) ;  inPipe[0] = -1 ;
+    close (outPipe[1]) ;  outPipe[1] = -1 ;
+    close (errPipe[1]) ;  errPipe[1] = -1 ;
+    close (execPipe[1]) ;  execPipe[1] = -1 ;
+
+    do {
+        length = read (execPipe[0], &error, sizeof error) ;
+    } while ((length < 0) && (errno == EINTR)) ;
+    close (execPipe[0]) ;  execPipe[0] = -1 ;
+
+    if (length == (ssize_t) sizeof error) {
+        while ((waitpid (pid, NULL, 0) < 0) && (errno == EINTR))
+            ;
+        errno = error ;
+        LGE "(spxSpawn) Error executing %s.\nexecvp: ", argv[0]) ;
+        process->pid = 0 ;
+        goto onError ;
+    }
+
+/* Register the pipes (and the pidfd, if available) with the dispatcher. */
+
+    process->fdIn = inPipe[1] ;  inPipe[1] = -1 ;
+    process->fdOut = outPipe[0] ;  outPipe[0] = -1 ;
+    process->fdErr = errPipe[0] ;  errPipe[0] = -1 ;
+    fcntl (process->fdIn, F_SETFL, O_NONBLOCK) ;
+    fcntl (process->fdOut, F_SETFL, O_NONBLOCK) ;
+    fcntl (process->fdErr, F_SETFL, O_NONBLOCK) ;
+
+    process->cbOut = ioxOnIO (dispatcher, spxOutputCB, process, IoxRead,
+                              process->fdOut) ;
+    process->cbErr = ioxOnIO (dispatcher, spxOutputCB, process, IoxRead,
+                              process->fdErr) ;
+    if ((process->cbOut == NULL) || (process->cbErr == NULL)) {
+        LGE "(spxSpawn) Error registering pipes for process %ld.\nioxOnIO: ",
+            process->pid) ;
+        PUSH_ERRNO ;
+        kill (pid, SIGKILL) ;
+        while ((waitpid (pid, NULL, 0) < 0) && (errno == EINTR))
+            ;
+        POP_ERRNO ;
+        process->pid = 0 ;
+        goto onError ;
+    }
+
+#if defined(SYS_pidfd_open)
+    process->fdExit = (int) syscall (SYS_pidfd_open, pid, 0) ;
+    if (process->fdExit >= 0) {
+        fcntl (process->fdExit, F_SETFD, FD_CLOEXEC) ;
+        process->cbExit = ioxOnIO (dispatcher, spxExitCB, process, IoxRead,
+                                   process->fdExit) ;
+        if (process->cbExit == NULL) {
+            close (process->fdExit) ;
+            process->fdExit = -1 ;
+        }
+    }
+#endif
+
+    process->next = processList ;
+    processList = process ;
+
+    LGI "(spxSpawn) Spawned %s, process %ld%s.\n", argv[0], process->pid,
+        (process->fdExit < 0) ? "" : " (pidfd)") ;
+
+    return (process) ;
+
+/* Clean up after an error. */
+
+onError:
+    PUSH_ERRNO ;
+    if (inPipe[0] >= 0)  close (inPipe[0]) ;
+    if (inPipe[1] >= 0)  close (inPipe[1]) ;
+    if (outPipe[0] >= 0)  close (outPipe[0]) ;
+    if (outPipe[1] >= 0)  close (outPipe[1]) ;
+    if (errPipe[0] >= 0)  close (errPipe[0]) ;
+    if (errPipe[1] >= 0)  close (errPipe[1]) ;
+    if (execPipe[0] >= 0)  close (execPipe[0]) ;
+    if (execPipe[1] >= 0)  close (execPipe[1]) ;
+    spxClose (&process->cbOut, &process->fdOut) ;
+    spxClose (&process->cbErr, &process->fdErr) ;
+    if (process->fdIn >= 0)  close (process->fdIn) ;
+    free (process) ;
+    POP_ERRNO ;
+    return (NULL) ;
+
+#else
+
+    SET_ERRNO (ENOSYS) ;
+    LGE "(spxSpawn) Spawning not supported: %s\n", argv[0]) ;
+    return (NULL) ;
+
+#endif
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxStatus ()
+
+    Get a Process's Raw Exit Status.
+
+
+Purpose:
+
+    Function spxStatus() returns the exit status of a process.  The status
+    is that returned by waitpid(2); use WIFEXITED(), WEXITSTATUS(), etc. to
+    decode it.
+
+
+    Invocation:
+
+        status = spxStatus (process) ;
+
+    where
+
+        <process>	- I
+            is the process handle returned by spxSpawn().
+        <status>	- O
+            returns the exit status; -1 is returned if the process has not
+            exited.
+
+*******************************************************************************/
+
+
+int  spxStatus (
+
+#    if PROTOTYPES
+        SpxProcess  process)
+#    else
+        process)
+
+        SpxProcess  process ;
+#    endif
+
+{
+
+    return (((process == NULL) || !process->exited) ? -1 : process->status) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxWrite ()
+
+    Write Data to a Process's Standard Input.
+
+
+Purpose:
+
+    Function spxWrite() writes data to a process's standard input.  As much
+    of the data as the pipe will take is written immediately; the rest is
+    buffered and written as the process reads its input.  spxWrite() never
+    blocks.
+
+
+    Invocation:
+
+        status = spxWrite (process, data, length) ;
+
+    where
+
+        <process>	- I
+            is the process handle returned by spxSpawn().
+        <data>		- I
+            is the data to write.
+        <length>	- I
+            is the number of bytes of data to write.
+        <status>	- O
+            returns the status of writing the data, zero if there were no
+            errors and ERRNO otherwise.  EPIPE is returned if the input has
+            been closed (by spxCloseInput() or by the process).
+
+*******************************************************************************/
+
+
+errno_t  spxWrite (
+
+#    if PROTOTYPES
+        SpxProcess  process,
+        const  char  *data,
+        size_t  length)
+#    else
+        process, data, length)
+
+        SpxProcess  process ;
+        char  *data ;
+        size_t  length ;
+#    endif
+
+{    /* Local variables. */
+#if HAVE_FORK
+    char  *buffer ;
+    ssize_t  written ;
+#endif
+
+
+
+    if (process == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(spxWrite) NULL process handle: ") ;
+        return (errno) ;
+    }
+
+    if ((process->fdIn < 0) || process->closeInput) {
+        SET_ERRNO (EPIPE) ;
+        LGE "(spxWrite) Input to process %ld is closed.\n", process->pid) ;
+        return (errno) ;
+    }
+
+#if HAVE_FORK
+
+/* If nothing is waiting to be written, try writing the data directly. */
+
+    written = 0 ;
+    if (process->pendingLength == 0) {
+        written = write (process->fdIn, data, length) ;
+        if (written < 0) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) {
+                LGE "(spxWrite) Error writing to process %ld.\nwrite: ",
+                    process->pid) ;
+                PUSH_ERRNO ;
+                spxClose (&process->cbIn, &process->fdIn) ;
+                POP_ERRNO ;
+                return (errno) ;
+            }
+            written = 0 ;
+        }
+    }
+
+    if ((size_t) written == length)  return (0) ;
+
+/* Buffer the rest and have the dispatcher say when the pipe can take it. */
+
+    buffer = (char *) realloc (process->pending,
+                               process->pendingLength + length - written) ;
+    if (buffer == NULL) {
+        LGE "(spxWrite) Error buffering %lu bytes for process %ld.\nrealloc: ",
+            (unsigned long) (length - written), process->pid) ;
+        return (errno) ;
+    }
+    memcpy (buffer + process->pendingLength, data + written, length - written) ;
+    process->pending = buffer ;
+    process->pendingLength += length - written ;
+
+    if (process->cbIn == NULL) {
+        process->cbIn = ioxOnIO (process->dispatcher, spxInputCB, process,
+                                 IoxWrite, process->fdIn) ;
+        if (process->cbIn == NULL) {
+            LGE "(spxWrite) Error registering input for process %ld.\nioxOnIO: ",
+                process->pid) ;
+            return (errno) ;
+        }
+    }
+
+    return (0) ;
+
+#else
+
+    SET_ERRNO (ENOSYS) ;
+    return (errno) ;
+
+#endif
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxCheck ()
+
+    Deliver a Process's Exit or Free the Process.
+
+
+Purpose:
+
+    Function spxCheck() moves a process along once something has happened
+    to it.  If the process has exited and all its output has been delivered,
+    the handler is called with reason SPX_EXIT and then with IoxCancel.  If
+    the handler has seen IoxCancel and the process has been reaped (or has
+    been orphaned by its dispatcher), the process is freed -
+    unless a handler call is still in progress, in which case the caller of
+    the handler calls spxCheck() again afterwards.
+
+
+    Invocation:
+
+        acted = spxCheck (process) ;
+
+    where:
+
+        <process>	- I
+            is the process.
+        <acted>		- O
+            returns true if the process's exit was delivered or the process
+            was freed, and false otherwise.
+
+*******************************************************************************/
+
+
+static  bool  spxCheck (
+
+#    if PROTOTYPES
+        SpxProcess  process)
+#    else
+        process)
+
+        SpxProcess  process ;
+#    endif
+
+{    /* Local variables. */
+    bool  acted = false ;
+
+
+
+    if (process->busy > 0)  return (false) ;
+
+    if (!process->reported && process->exited &&
+        (process->fdOut < 0) && (process->fdErr < 0)) {
+        LGI "(spxCheck) Process %ld exited with status 0x%X.\n",
+            process->pid, process->status) ;
+        process->reported = true ;
+        process->busy++ ;
+        process->handler (process, SPX_EXIT, NULL, 0, process->userData) ;
+        process->handler (process, IoxCancel, NULL, 0, process->userData) ;
+        process->busy-- ;
+        acted = true ;
+    }
+
+/* An orphaned process is freed only after the dispatcher has canceled all
+   its callbacks; canceling them here would disturb the dispatcher while it
+   is being destroyed. */
+
+    if (process->reported) {
+        if (process->orphaned ? ((process->cbIn == NULL) &&
+                                 (process->cbOut == NULL) &&
+                                 (process->cbErr == NULL) &&
+                                 (process->cbExit == NULL))
+                              : process->exited) {
+            spxFree (process) ;
+            acted = true ;
+        }
+    }
+
+    return (acted) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxClose ()
+
+    Close One of a Process's Pipes.
+
+
+Purpose:
+
+    Function spxClose() cancels the IOX callback, if any, for one of a
+    process's descriptors and closes the descriptor.  The callback field is
+    cleared before the callback is canceled, so the callback function can
+    tell this cancellation from one made by the dispatcher.
+
+
+    Invocation:
+
+        spxClose (&callback, &fd) ;
+
+    where:
+
+        <callback>	- I/O
+            is the address of the IOX callback field; the field is set to
+            NULL.
+        <fd>		- I/O
+            is the address of the descriptor field; the field is set to -1.
+
+*******************************************************************************/
+
+
+static  void  spxClose (
+
+#    if PROTOTYPES
+        IoxCallback  *callback,
+        int  *fd)
+#    else
+        callback, fd)
+
+        IoxCallback  *callback ;
+        int  *fd ;
+#    endif
+
+{    /* Local variables. */
+    IoxCallback  previous ;
+
+
+
+    previous = *callback ;
+    *callback = NULL ;
+    if (previous != NULL)  ioxCancel (previous) ;
+
+#if HAVE_FORK
+    if (*fd >= 0)  close (*fd) ;
+#endif
+    *fd = -1 ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxExitCB ()
+
+    Handle the Exit of a Process with a Pidfd.
+
+
+Purpose:
+
+    Function spxExitCB() is the IOX callback for a process's pidfd, which
+    becomes readable when the process exits.
+
+
+    Invocation:
+
+        status = spxExitCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the IOX callback.
+        <reason>	- I
+            is the reason (IoxRead or IoxCancel) the callback is being
+            invoked.
+        <userData>	- I
+            is the process.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  spxExitCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    SpxProcess  process = (SpxProcess) userData ;
+
+
+
+    if (reason == IoxCancel) {
+        if (callback == process->cbExit)	/* Dispatcher destroyed. */
+            spxOrphan (process, &process->cbExit, &process->fdExit) ;
+        return (0) ;
+    }
+
+    if (spxReap (process)) {
+        spxClose (&process->cbExit, &process->fdExit) ;
+        spxCheck (process) ;
+    }
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxFree ()
+
+    Deallocate a Process.
+
+
+Purpose:
+
+    Function spxFree() removes a process from the list of processes, closes
+    any descriptors still open, and frees the process.
+
+
+    Invocation:
+
+        spxFree (process) ;
+
+    where:
+
+        <process>	- I
+            is the process.
+
+*******************************************************************************/
+
+
+static  void  spxFree (
+
+#    if PROTOTYPES
+        SpxProcess  process)
+#    else
+        process)
+
+        SpxProcess  process ;
+#    endif
+
+{    /* Local variables. */
+    SpxProcess  prev ;
+
+
+
+    if (processList == process) {
+        processList = process->next ;
+    } else {
+        for (prev = processList ;  prev != NULL ;  prev = prev->next) {
+            if (prev->next == process) {
+                prev->next = process->next ;
+                break ;
+            }
+        }
+    }
+
+    spxClose (&process->cbIn, &process->fdIn) ;
+    spxClose (&process->cbOut, &process->fdOut) ;
+    spxClose (&process->cbErr, &process->fdErr) ;
+    spxClose (&process->cbExit, &process->fdExit) ;
+
+    free (process->pending) ;
+    free (process) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxInputCB ()
+
+    Feed Buffered Input to a Process.
+
+
+Purpose:
+
+    Function spxInputCB() is the IOX callback invoked when a process's input
+    pipe can take more data.  As much buffered input as possible is written;
+    when the buffer is empty, the callback is canceled (and, if requested,
+    the pipe is closed).
+
+
+    Invocation:
+
+        status = spxInputCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the IOX callback.
+        <reason>	- I
+            is the reason (IoxWrite or IoxCancel) the callback is being
+            invoked.
+        <userData>	- I
+            is the process.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  spxInputCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    SpxProcess  process = (SpxProcess) userData ;
+#if HAVE_FORK
+    ssize_t  written ;
+#endif
+
+
+
+    if (reason == IoxCancel) {
+        if (callback == process->cbIn)		/* Dispatcher destroyed. */
+            spxOrphan (process, &process->cbIn, &process->fdIn) ;
+        return (0) ;
+    }
+
+#if HAVE_FORK
+    written = write (process->fdIn, process->pending, process->pendingLength) ;
+    if (written < 0) {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+            return (0) ;
+        LGE "(spxInputCB) Error writing to process %ld.\nwrite: ",
+            process->pid) ;
+        written = (ssize_t) process->pendingLength ;	/* Discard input. */
+        process->closeInput = true ;
+    }
+
+    process->pendingLength -= (size_t) written ;
+    memmove (process->pending, process->pending + written,
+             process->pendingLength) ;
+#endif
+
+    if (process->pendingLength == 0) {
+        if (process->closeInput) {
+            spxClose (&process->cbIn, &process->fdIn) ;
+        } else {
+            callback = process->cbIn ;
+            process->cbIn = NULL ;
+            ioxCancel (callback) ;
+        }
+    }
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxOrphan ()
+
+    Handle the Destruction of a Process's Dispatcher.
+
+
+Purpose:
+
+    Function spxOrphan() is called when the dispatcher cancels one of a
+    process's IOX callbacks, which only happens when the dispatcher is being
+    destroyed.  The descriptor is closed, the process is marked as orphaned,
+    and the handler, if it hasn't already, is called with reason IoxCancel.
+    The process itself is left running and is never reaped.
+
+
+    Invocation:
+
+        spxOrphan (process, &callback, &fd) ;
+
+    where:
+
+        <process>	- I
+            is the process.
+        <callback>	- I/O
+            is the address of the canceled callback's field; the field is
+            set to NULL.
+        <fd>		- I/O
+            is the address of the callback's descriptor field; the
+            descriptor is closed and the field is set to -1.
+
+*******************************************************************************/
+
+
+static  void  spxOrphan (
+
+#    if PROTOTYPES
+        SpxProcess  process,
+        IoxCallback  *callback,
+        int  *fd)
+#    else
+        process, callback, fd)
+
+        SpxProcess  process ;
+        IoxCallback  *callback ;
+        int  *fd ;
+#    endif
+
+{
+
+    *callback = NULL ;
+    spxClose (callback, fd) ;
+
+    process->orphaned = true ;
+
+    if (!process->reported) {
+        LGI "(spxOrphan) Process %ld orphaned.\n", process->pid) ;
+        process->reported = true ;
+        process->busy++ ;
+        process->handler (process, IoxCancel, NULL, 0, process->userData) ;
+        process->busy-- ;
+    }
+
+    spxCheck (process) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxOutputCB ()
+
+    Deliver a Process's Output.
+
+
+Purpose:
+
+    Function spxOutputCB() is the IOX callback invoked when a process's
+    standard output or error pipe is readable.  One chunk of up to SPX_CHUNK
+    bytes is read and passed to the handler; if more is available, the
+    dispatcher calls spxOutputCB() again on its next iteration, so a chatty
+    process doesn't starve the dispatcher's other sources.  At end-of-file,
+    the pipe is closed.
+
+
+    Invocation:
+
+        status = spxOutputCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle of the IOX callback.
+        <reason>	- I
+            is the reason (IoxRead or IoxCancel) the callback is being
+            invoked.
+        <userData>	- I
+            is the process.
+        <status>	- O
+            returns the status of handling the callback, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  spxOutputCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    bool  isOut ;
+    char  buffer[SPX_CHUNK] ;
+    SpxProcess  process = (SpxProcess) userData ;
+    ssize_t  length ;
+
+
+
+    isOut = (callback == process->cbOut) ;
+
+    if (reason == IoxCancel) {			/* Dispatcher destroyed? */
+        if (isOut)
+            spxOrphan (process, &process->cbOut, &process->fdOut) ;
+        else if (callback == process->cbErr)
+            spxOrphan (process, &process->cbErr, &process->fdErr) ;
+        return (0) ;
+    }
+
+/* If a slice's budget has been spent, leave the output for the next slice
+   (see soxRunSlice()). */
+
+    if (soxSliceDone (process->dispatcher))  return (0) ;
+
+#if HAVE_FORK
+    length = read (isOut ? process->fdOut : process->fdErr,
+                   buffer, sizeof buffer) ;
+#else
+    length = 0 ;
+#endif
+
+    if (length > 0) {
+        process->busy++ ;
+        process->handler (process, isOut ? SPX_STDOUT : SPX_STDERR,
+                          buffer, (size_t) length, process->userData) ;
+        process->busy-- ;
+    } else if ((length < 0) &&
+               ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))) {
+        return (0) ;
+    } else if (isOut) {				/* End-of-file or error. */
+        spxClose (&process->cbOut, &process->fdOut) ;
+    } else {
+        spxClose (&process->cbErr, &process->fdErr) ;
+    }
+
+    spxCheck (process) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxPipe ()
+
+    Create a Close-on-Exec Pipe.
+
+
+Purpose:
+
+    Function spxPipe() creates a pipe whose descriptors are both marked
+    close-on-exec.
+
+
+    Invocation:
+
+        status = spxPipe (fds) ;
+
+    where:
+
+        <fds>		- O
+            returns the read and write descriptors of the pipe.
+        <status>	- O
+            returns the status of creating the pipe, zero if there were no
+            errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  spxPipe (
+
+#    if PROTOTYPES
+        int  fds[2])
+#    else
+        fds)
+
+        int  fds[2] ;
+#    endif
+
+{
+
+#if HAVE_FORK
+    if (pipe (fds))  return (errno) ;
+    fcntl (fds[0], F_SETFD, FD_CLOEXEC) ;
+    fcntl (fds[1], F_SETFD, FD_CLOEXEC) ;
+    return (0) ;
+#else
+    fds[0] = fds[1] = -1 ;
+    SET_ERRNO (ENOSYS) ;
+    return (errno) ;
+#endif
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxReap ()
+
+    Check If a Process Has Exited.
+
+
+Purpose:
+
+    Function spxReap() checks, without waiting, if a process has exited
+    and, if so, reaps it and saves its exit status.
+
+
+    Invocation:
+
+        exited = spxReap (process) ;
+
+    where:
+
+        <process>	- I
+            is the process.
+        <exited>	- O
+            returns true if the process has exited and false otherwise.
+
+*******************************************************************************/
+
+
+static  bool  spxReap (
+
+#    if PROTOTYPES
+        SpxProcess  process)
+#    else
+        process)
+
+        SpxProcess  process ;
+#    endif
+
+{
+#if HAVE_FORK
+    int  status ;
+    pid_t  pid ;
+#endif
+
+    if (process->exited)  return (true) ;
+
+#if HAVE_FORK
+    do {
+        pid = waitpid ((pid_t) process->pid, &status, WNOHANG) ;
+    } while ((pid < 0) && (errno == EINTR)) ;
+
+    if (pid == (pid_t) process->pid) {
+        process->exited = true ;
+        process->status = status ;
+    } else if ((pid < 0) && (errno == ECHILD)) {	/* Reaped elsewhere. */
+        process->exited = true ;
+        process->status = -1 ;
+    }
+#endif
+
+    return (process->exited) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxReaperCB ()
+
+    Reap Processes when SIGCHLD is Received.
+
+
+Purpose:
+
+    Function spxReaperCB() is the SOX_UTIL signal handler for SIGCHLD.  It
+    checks each of the dispatcher's processes that doesn't have a pidfd.
+    If the watcher is canceled (because the dispatcher is being destroyed),
+    the reaper is deallocated and those processes are orphaned.
+
+
+    Invocation:
+
+        status = spxReaperCB (watcher, reason, userData) ;
+
+    where:
+
+        <watcher>	- I
+            is the SIGCHLD watcher.
+        <reason>	- I
+            is the reason (SOX_SIGNAL or IoxCancel) the handler is being
+            invoked.
+        <userData>	- I
+            is the reaper.
+        <status>	- O
+            returns the status of handling the signal, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  spxReaperCB (
+
+#    if PROTOTYPES
+        SoxSignal  watcher,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        watcher, reason, userData)
+
+        SoxSignal  watcher ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    IoxDispatcher  dispatcher ;
+    SpxProcess  process ;
+    SpxReaper  *prev, *reaper = (SpxReaper *) userData ;
+
+
+
+    dispatcher = reaper->dispatcher ;
+
+    if (reason == IoxCancel) {
+        if (reaperList == reaper) {
+            reaperList = reaper->next ;
+        } else {
+            for (prev = reaperList ;  prev->next != reaper ;  prev = prev->next)
+                ;
+            prev->next = reaper->next ;
+        }
+        free (reaper) ;
+        for (process = processList ;  process != NULL ;  process = process->next) {
+            if ((process->dispatcher == dispatcher) && (process->fdExit < 0))
+                process->orphaned = true ;
+        }
+    } else {
+        for (process = processList ;  process != NULL ;  process = process->next) {
+            if ((process->dispatcher == dispatcher) && (process->fdExit < 0))
+                spxReap (process) ;
+        }
+    }
+
+    spxSweep (dispatcher) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    spxSweep ()
+
+    Check All of a Dispatcher's Processes.
+
+
+Purpose:
+
+    Function spxSweep() calls spxCheck() for each of a dispatcher's
+    processes.  Since a handler called by spxCheck() can spawn or cancel
+    other processes, the scan starts over whenever spxCheck() does
+    something.
+
+
+    Invocation:
+
+        spxSweep (dispatcher) ;
+
+    where:
+
+        <dispatcher>	- I
+            is the I/O event dispatcher.
+
+*******************************************************************************/
+
+
+static  void  spxSweep (
+
+#    if PROTOTYPES
+        IoxDispatcher  dispatcher)
+#    else
+        dispatcher)
+
+        IoxDispatcher  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    SpxProcess  process ;
+
+
+
+    process = processList ;
+    while (process != NULL) {
+        if ((process->dispatcher == dispatcher) && spxCheck (process))
+            process = processList ;
+        else
+            process = process->next ;
+    }
+
+    return ;
+
+}
@@ -0,0 +1,98 @@
+/* $Id$ */
+/*******************************************************************************
+
+    spx_util.h
+
+    Spawned Process Utility Definitions.
+
+*******************************************************************************/
+
+#ifndef  SPX_UTIL_H		/* Has the file been INCLUDE'd already? */
+#define  SPX_UTIL_H  yes
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+extern  "C"  {
+#endif
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+#include  "iox_util.h"			/* I/O event dispatcher definitions. */
+
+
+/*******************************************************************************
+    Spawned Process (Client View) and Definitions.
+*******************************************************************************/
+
+typedef  struct  _SpxProcess  *SpxProcess ;	/* Process handle. */
+
+/* Process handler function.  The handler is invoked with reason SPX_STDOUT
+   or SPX_STDERR and a chunk of output when the child writes to its standard
+   output or error, with reason SPX_EXIT (and no data) after the child has
+   exited and all its output has been delivered, and, finally, with reason
+   IoxCancel when the process handle is released. */
+
+typedef  errno_t  (*SpxHandler) P_((SpxProcess process,
+                                    IoxReason reason,
+                                    const char *data,
+                                    size_t length,
+                                    void *userData)) ;
+
+					/* Reasons beyond IOX's own. */
+#define  SPX_STDOUT  ((IoxReason) 256)	/* Output on child's stdout. */
+#define  SPX_STDERR  ((IoxReason) 512)	/* Output on child's stderr. */
+#define  SPX_EXIT  ((IoxReason) 1024)	/* Child has exited. */
+
+				/* Maximum output delivered per callback. */
+#ifndef SPX_CHUNK
+#    define  SPX_CHUNK  16384
+#endif
+
+
+/*******************************************************************************
+    Miscellaneous declarations.
+*******************************************************************************/
+
+					/* Global debug switch (1/0 = yes/no). */
+extern  int  spx_util_debug  OCD ("spx_util") ;
+
+
+/*******************************************************************************
+    Public functions.
+*******************************************************************************/
+
+extern  errno_t  spxCancel P_((SpxProcess process))
+    OCD ("spx_util") ;
+
+extern  errno_t  spxCloseInput P_((SpxProcess process))
+    OCD ("spx_util") ;
+
+extern  errno_t  spxKill P_((SpxProcess process,
+                             int signo))
+    OCD ("spx_util") ;
+
+extern  int  spxExitCode P_((SpxProcess process))
+    OCD ("spx_util") ;
+
+extern  long  spxPid P_((SpxProcess process))
+    OCD ("spx_util") ;
+
+extern  SpxProcess  spxSpawn P_((IoxDispatcher dispatcher,
+                                 char *const argv[],
+                                 SpxHandler handler,
+                                 void *userData))
+    OCD ("spx_util") ;
+
+extern  int  spxStatus P_((SpxProcess process))
+    OCD ("spx_util") ;
+
+extern  errno_t  spxWrite P_((SpxProcess process,
+                              const char *data,
+                              size_t length))
+    OCD ("spx_util") ;
+
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+}
+#endif
+
+#endif				/* If this file was not INCLUDE'd previously. */
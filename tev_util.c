@@ -0,0 +1,1350 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    tev_util.c
+
+    Trace-Event Timeline Utilities.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The TEV_UTIL package records a timeline of what a TSION program spends
+    its time on - dispatcher callbacks, foreign (C) function calls, time
+    spent waiting for events - and writes it as a JSON file in the Chrome
+    trace-event format, which can be loaded into Perfetto (ui.perfetto.dev)
+    or Chrome's about:tracing viewer.  The timeline is meant to be switched
+    on in a running server for a few seconds at a time:
+
+        #include  "tev_util.h"			-- Trace-event timelines.
+        ...
+        tevStart (sc, "/tmp/tsion.json", 0) ;	-- Default capacity.
+        ... run the dispatcher ...
+        tevStop (NULL) ;
+
+    Events are recorded by the thread that started the timeline, which is
+    normally the thread running the dispatcher and the interpreter.  So as
+    to add as little as possible to the time being measured, recording an
+    event only copies a small, fixed-size record into a single-producer/
+    single-consumer ring buffer; a separate thread drains the ring and
+    formats and writes the JSON.  If the writer falls behind and the ring
+    fills up, events are dropped rather than making the recording thread
+    wait; tevStop() returns the number of events dropped.  (On platforms
+    without POSIX threads, the ring is drained when the timeline is stopped,
+    so the capacity should be large enough for the whole recording.)
+
+    The following kinds of events are recorded:
+
+        - SOX_UTIL records a span for each callback bracketed by soxEnter()
+          and soxLeave(), named after the callback function if the caller
+          named it, and categorized by the kind of callback (e.g.,
+          "iox-onio").  The time between top-level callbacks, which is
+          mostly time spent waiting in the dispatcher, is recorded as
+          "wait" spans; when the dispatcher is run in slices (see
+          soxRunSlice()), each pass through the dispatcher is recorded as
+          an "iteration" span.
+
+        - If an interpreter is passed to tevStart(), every foreign function
+          bound to a global variable is timed while the timeline is active.
+          The function cells are temporarily pointed at a trampoline, which
+          looks up the real function from the cell being applied and records
+          a span, named after the variable, around the call.  The cells are
+          restored when the timeline is stopped.
+
+        - TinyScheme has no hook for its garbage collector, but a collection
+          can be detected after the fact from the interpreter's count of free
+          cells, which only rises when the collector runs.  SOX_UTIL records
+          an instant "gc" event at the end of each callback during which the
+          collector ran.
+
+    Times are recorded in microseconds since the timeline was started.
+
+    The same trampoline also notes the name of the foreign function being
+    executed for the SOX_UTIL stall watchdog (see soxForeign()).  An
+    application that sets a watchdog threshold wraps its interpreters'
+    foreign functions for the watchdog with tevNameForeign(), whether or
+    not a timeline is being recorded.  The function cells belong to the
+    interpreter, so an interpreter whose functions are wrapped, for either
+    purpose, must be released with tevRelease() before it is destroyed:
+
+        tevRelease (sc) ;
+        scheme_deinit (sc) ;
+
+
+Public Procedures:
+
+    tevActive() - checks if a timeline is being recorded.
+    tevInstant() - records an instant event.
+    tevNameForeign() - wraps an interpreter's foreign functions for the
+        stall watchdog.
+    tevRelease() - unwraps an interpreter's foreign functions.
+    tevSpan() - records a span.
+    tevStart() - starts recording a timeline.
+    tevStop() - stops recording a timeline.
+
+Private Procedures:
+
+    tevDrain() - writes the events in the ring to the file.
+    tevFlushThread() - periodically drains the ring.
+    tevForeign() - times a call to a foreign function.
+    tevInsert() - adds a foreign function to the table of wrapped functions.
+    tevLookup() - looks up a wrapped foreign function.
+    tevPut() - puts an event in the ring.
+    tevWrap() - wraps or unwraps an interpreter's foreign functions.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <string.h>			/* C Library string functions. */
+#ifndef HAVE_PTHREADS			/* Writer thread supported? */
+#    if defined(_WIN32) || defined(NDS)
+#        define  HAVE_PTHREADS  0
+#    else
+#        define  HAVE_PTHREADS  1
+#    endif
+#endif
+#if HAVE_PTHREADS
+#    include  <pthread.h>		/* POSIX threads. */
+#    include  <signal.h>		/* Signal definitions. */
+#    include  <time.h>			/* Time definitions. */
+#endif
+#include  "scm_util.h"			/* Scheme utilities. */
+#include  "sox_util.h"			/* Scheme dispatcher utilities. */
+#include  "tev_util.h"			/* Trace-event timelines. */
+
+
+int  tev_util_debug = 0 ;		/* Global debug switch (1/0 = yes/no). */
+#undef  I_DEFAULT_GUARD
+#define  I_DEFAULT_GUARD  tev_util_debug
+
+
+/*******************************************************************************
+    Timeline (Private) and Definitions.
+*******************************************************************************/
+
+					/* Longest event name kept. */
+#define  TEV_NAME_SIZE  64
+					/* Writer's sleep between drains. */
+#ifndef TEV_FLUSH_INTERVAL
+#    define  TEV_FLUSH_INTERVAL  0.050
+#endif
+
+typedef  struct  TevEvent {
+    char  phase ;			/* 'X' (span) or 'i' (instant). */
+    const  char  *category ;		/* Static string; e.g., "iox-onio". */
+    char  name[TEV_NAME_SIZE] ;		/* Name of event. */
+    double  timestamp ;			/* Microseconds since start. */
+    double  duration ;			/* Microseconds, for spans. */
+    long  value ;			/* Argument; -1 if none. */
+}  TevEvent ;
+
+/* The ring's head is advanced only by the recording thread and its tail only
+   by the writer.  Each side publishes its index with a release store after
+   touching the slots, and reads the other side's index with an acquire load
+   before touching them. */
+
+#if defined(__GNUC__)
+#    define  TEV_LOAD(p)  __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+#    define  TEV_STORE(p, v)  __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+#else
+#    define  TEV_LOAD(p)  (*(p))
+#    define  TEV_STORE(p, v)  (*(p) = (v))
+#endif
+
+/* The wrapped foreign functions of all the interpreters are kept in one hash
+   table, keyed by cell address, so that the trampoline can find the real
+   function without knowing which interpreter is calling it.  Each wrapped
+   interpreter has a record of who wants its functions wrapped: a timeline,
+   the stall watchdog, or both.  The functions are unwrapped when neither
+   does. */
+
+typedef  struct  TevForeign {
+    pointer  cell ;			/* Foreign function cell ... */
+    foreign_func  original ;		/* ... its real function ... */
+    const  char  *name ;		/* ... its global name ... */
+    scheme  *sc ;			/* ... and its interpreter. */
+}  TevForeign ;
+
+typedef  struct  TevWrapped {
+    struct  TevWrapped  *next ;		/* Link in list of interpreters. */
+    scheme  *sc ;			/* Interpreter with wrapped functions. */
+    int  users ;			/* TEV_TIMELINE and/or TEV_WATCHDOG. */
+}  TevWrapped ;
+
+#define  TEV_TIMELINE  1		/* Users of wrapped functions. */
+#define  TEV_WATCHDOG  2
+
+static  struct  {
+    TevForeign  *table ;		/* Hash table of wrapped functions. */
+    size_t  size ;			/* Size of table (power of 2). */
+    size_t  count ;			/* Number of entries in table. */
+    TevWrapped  *list ;			/* Interpreters with wrapped functions. */
+}  wrapped ;
+
+static  struct  {
+    volatile  int  active ;		/* Recording? */
+    FILE  *file ;			/* JSON output file. */
+    bool  first ;			/* No events written yet? */
+    struct  timeval  start ;		/* Time recording began. */
+    TevEvent  *ring ;			/* Ring buffer of events. */
+    unsigned  long  mask ;		/* Ring capacity - 1. */
+    volatile  unsigned  long  head ;	/* Next slot to fill. */
+    volatile  unsigned  long  tail ;	/* Next slot to write. */
+    volatile  int  stopping ;		/* Tell writer thread to exit. */
+    TevStats  stats ;			/* Counts of events. */
+    scheme  *sc ;			/* Interpreter with timed functions. */
+#if HAVE_PTHREADS
+    pthread_t  owner ;			/* Recording thread. */
+    pthread_t  writer ;			/* Writer thread. */
+    bool  writing ;			/* Writer thread started? */
+#endif
+}  timeline ;
+
+
+/*******************************************************************************
+    Private functions.
+*******************************************************************************/
+
+static  void  tevDrain P_((void)) ;
+
+#if HAVE_PTHREADS
+    static  void  *tevFlushThread P_((void *arg)) ;
+#endif
+
+static  pointer  tevForeign P_((scheme *sc,
+                                pointer args)) ;
+
+static  errno_t  tevInsert P_((pointer cell,
+                               const char *name,
+                               scheme *sc)) ;
+
+static  TevForeign  *tevLookup P_((pointer cell)) ;
+
+static  void  tevPut P_((char phase,
+                         const char *category,
+                         const char *name,
+                         struct timeval start,
+                         struct timeval end,
+                         long value)) ;
+
+static  errno_t  tevWrap P_((scheme *sc,
+                             int user,
+                             bool wrap)) ;
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevActive ()
+
+    Check if a Timeline is Being Recorded.
+
+
+Purpose:
+
+    Function tevActive() checks if a timeline is being recorded.  Code that
+    has to do extra work to describe an event (e.g., look up a callback
+    function's name) can check first.
+
+
+    Invocation:
+
+        isActive = tevActive () ;
+
+    where
+
+        <isActive>	- O
+            returns true if a timeline is being recorded and false otherwise.
+
+*******************************************************************************/
+
+
+bool  tevActive (
+
+#    if PROTOTYPES
+        void)
+#    else
+        )
+#    endif
+
+{
+
+    return (timeline.active ? true : false) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevInstant ()
+
+    Record an Instant Event.
+
+
+Purpose:
+
+    Function tevInstant() records an event that happened at a point in time
+    rather than over a span of time.  Nothing is recorded if no timeline is
+    active.
+
+
+    Invocation:
+
+        tevInstant (category, name, value) ;
+
+    where
+
+        <category>	- I
+            is the category of the event; e.g., "gc".  The string must be
+            static.
+        <name>		- I
+            is the name of the event.  Long names are truncated.
+        <value>		- I
+            is a value recorded with the event; -1 if none.
+
+*******************************************************************************/
+
+
+void  tevInstant (
+
+#    if PROTOTYPES
+        const  char  *category,
+        const  char  *name,
+        long  value)
+#    else
+        category, name, value)
+
+        char  *category ;
+        char  *name ;
+        long  value ;
+#    endif
+
+{    /* Local variables. */
+    struct  timeval  now ;
+
+
+
+    if (!timeline.active)  return ;
+
+    now = tvTOD () ;
+    tevPut ('i', category, name, now, now, value) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevNameForeign ()
+
+    Wrap an Interpreter's Foreign Functions for the Stall Watchdog.
+
+
+Purpose:
+
+    Function tevNameForeign() points the cells of the foreign functions bound
+    to an interpreter's global variables at the TEV_UTIL trampoline, which
+    notes the name of the function being executed for the SOX_UTIL stall
+    watchdog (see soxForeign()).  An application calls it for each
+    interpreter run by a dispatcher that has a watchdog threshold.  The
+    functions stay wrapped until tevNameForeign() is called to unwrap them
+    or until the interpreter is released with tevRelease(); if a timeline
+    is timing the same interpreter, the functions are restored when both
+    are done with them.  Foreign functions defined after the call are not
+    wrapped.
+
+
+    Invocation:
+
+        status = tevNameForeign (sc, name) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <name>		- I
+            specifies whether the functions are to be wrapped (true) or
+            unwrapped (false).
+        <status>	- O
+            returns the status of wrapping the functions, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  tevNameForeign (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        bool  name)
+#    else
+        sc, name)
+
+        scheme  *sc ;
+        bool  name ;
+#    endif
+
+{
+
+    return (tevWrap (sc, TEV_WATCHDOG, name)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevRelease ()
+
+    Unwrap an Interpreter's Foreign Functions.
+
+
+Purpose:
+
+    Function tevRelease() restores the cells of an interpreter's wrapped
+    foreign functions, whether they were wrapped by tevStart() or by
+    tevNameForeign(), and forgets the interpreter.  If a timeline is being
+    recorded, the timeline continues, but no longer times the interpreter's
+    functions.  The function must be called before the interpreter is
+    destroyed with scheme_deinit().
+
+
+    Invocation:
+
+        tevRelease (sc) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+void  tevRelease (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{
+
+    if (timeline.sc == sc)  timeline.sc = NULL ;
+
+    tevWrap (sc, TEV_TIMELINE | TEV_WATCHDOG, false) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevSpan ()
+
+    Record a Span.
+
+
+Purpose:
+
+    Function tevSpan() records an event that began at a given time and ended
+    now.  Nothing is recorded if no timeline is active.
+
+
+    Invocation:
+
+        tevSpan (category, name, start, value) ;
+
+    where
+
+        <category>	- I
+            is the category of the span; e.g., "iox-onio".  The string must
+            be static.
+        <name>		- I
+            is the name of the span; e.g., the name of a callback function.
+            Long names are truncated.
+        <start>		- I
+            is the time at which the span began.
+        <value>		- I
+            is a value recorded with the span; -1 if none.
+
+*******************************************************************************/
+
+
+void  tevSpan (
+
+#    if PROTOTYPES
+        const  char  *category,
+        const  char  *name,
+        struct  timeval  start,
+        long  value)
+#    else
+        category, name, start, value)
+
+        char  *category ;
+        char  *name ;
+        struct  timeval  start ;
+        long  value ;
+#    endif
+
+{
+
+    if (!timeline.active)  return ;
+
+    tevPut ('X', category, name, start, tvTOD (), value) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevStart ()
+
+    Start Recording a Timeline.
+
+
+Purpose:
+
+    Function tevStart() starts recording a timeline to a file.  Only one
+    timeline can be recorded at a time.
+
+
+    Invocation:
+
+        status = tevStart (sc, pathname, capacity) ;
+
+    where
+
+        <sc>		- I
+            is the interpreter whose foreign functions are to be timed;
+            NULL if foreign functions are not to be timed.
+        <pathname>	- I
+            is the pathname of the JSON file, which is overwritten.
+        <capacity>	- I
+            is the number of events the ring buffer can hold, rounded up to
+            a power of two; zero selects the default, TEV_CAPACITY.
+        <status>	- O
+            returns the status of starting the timeline, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  tevStart (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        const  char  *pathname,
+        size_t  capacity)
+#    else
+        sc, pathname, capacity)
+
+        scheme  *sc ;
+        char  *pathname ;
+        size_t  capacity ;
+#    endif
+
+{    /* Local variables. */
+    unsigned  long  size ;
+
+
+
+    if (timeline.active) {
+        SET_ERRNO (EBUSY) ;
+        LGE "(tevStart) A timeline is already being recorded.\n") ;
+        return (errno) ;
+    }
+
+/* Allocate the ring buffer. */
+
+    if (capacity == 0)  capacity = TEV_CAPACITY ;
+    for (size = 1 ;  size < capacity ;  size <<= 1)
+        ;
+
+    timeline.ring = (TevEvent *) calloc (size, sizeof (TevEvent)) ;
+    if (timeline.ring == NULL) {
+        LGE "(tevStart) Error allocating %lu-event ring.\ncalloc: ", size) ;
+        return (errno) ;
+    }
+    timeline.mask = size - 1 ;
+    timeline.head = timeline.tail = 0 ;
+    memset (&timeline.stats, 0, sizeof (TevStats)) ;
+
+/* Create the file and write the opening of the JSON array, including a
+   metadata event naming the process. */
+
+    timeline.file = fopen (pathname, "w") ;
+    if (timeline.file == NULL) {
+        LGE "(tevStart) Error opening %s.\nfopen: ", pathname) ;
+        PUSH_ERRNO ;  free (timeline.ring) ;  POP_ERRNO ;
+        return (errno) ;
+    }
+    setvbuf (timeline.file, NULL, _IOFBF, 65536) ;
+
+    fprintf (timeline.file,
+             "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+             "\"args\":{\"name\":\"tsion\"}}") ;
+    timeline.first = false ;
+
+/* Wrap the interpreter's foreign functions, if requested. */
+
+    timeline.sc = NULL ;
+    if ((sc != NULL) && (tevWrap (sc, TEV_TIMELINE, true) == 0))
+        timeline.sc = sc ;
+
+    timeline.start = tvTOD () ;
+    timeline.stopping = 0 ;
+
+/* Start the writer thread. */
+
+#if HAVE_PTHREADS
+    timeline.owner = pthread_self () ;
+    errno = pthread_create (&timeline.writer, NULL, tevFlushThread, NULL) ;
+    timeline.writing = (errno == 0) ;
+    if (!timeline.writing) {
+        LGE "(tevStart) Error starting writer thread; writing at the end.\npthread_create: ") ;
+    }
+#endif
+
+    timeline.active = 1 ;
+
+    LGI "(tevStart) Recording timeline to %s (%lu events).\n",
+        pathname, size) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevStop ()
+
+    Stop Recording a Timeline.
+
+
+Purpose:
+
+    Function tevStop() stops recording a timeline, writes out the events
+    remaining in the ring buffer, and closes the file.  Foreign functions
+    wrapped by tevStart() are restored, unless they are also wrapped for the
+    stall watchdog.
+
+
+    Invocation:
+
+        status = tevStop (&stats) ;
+
+    where
+
+        <stats>		- O
+            returns the numbers of events recorded, dropped, and written;
+            NULL can be specified if the statistics are not needed.
+        <status>	- O
+            returns the status of stopping the timeline, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  tevStop (
+
+#    if PROTOTYPES
+        TevStats  *stats)
+#    else
+        stats)
+
+        TevStats  *stats ;
+#    endif
+
+{    /* Local variables. */
+    errno_t  status ;
+
+
+
+    if (!timeline.active) {
+        if (stats != NULL)  memset (stats, 0, sizeof (TevStats)) ;
+        return (0) ;
+    }
+
+    timeline.active = 0 ;
+
+    if (timeline.sc != NULL)  tevWrap (timeline.sc, TEV_TIMELINE, false) ;
+    timeline.sc = NULL ;
+
+/* Stop the writer thread and write out what it left behind. */
+
+#if HAVE_PTHREADS
+    if (timeline.writing) {
+        TEV_STORE (&timeline.stopping, 1) ;
+        pthread_join (timeline.writer, NULL) ;
+        timeline.writing = false ;
+    }
+#endif
+
+    tevDrain () ;
+
+    fprintf (timeline.file, "\n]\n") ;
+    status = ferror (timeline.file) ? EIO : 0 ;
+    if (fclose (timeline.file) && (status == 0))  status = errno ;
+    timeline.file = NULL ;
+    if (status) {
+        SET_ERRNO (status) ;
+        LGE "(tevStop) Error writing timeline.\n") ;
+    }
+
+    free (timeline.ring) ;
+    timeline.ring = NULL ;
+
+    if (stats != NULL)  *stats = timeline.stats ;
+
+    LGI "(tevStop) %lu events recorded, %lu dropped.\n",
+        timeline.stats.recorded, timeline.stats.dropped) ;
+
+    return (status) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevDrain ()
+
+    Write the Events in the Ring to the File.
+
+
+Purpose:
+
+    Function tevDrain() formats and writes the events in the ring buffer
+    to the timeline's file, emptying the ring.  It is only called by the
+    consumer: the writer thread or, once the writer has exited, tevStop().
+
+
+    Invocation:
+
+        tevDrain () ;
+
+*******************************************************************************/
+
+
+static  void  tevDrain (
+
+#    if PROTOTYPES
+        void)
+#    else
+        )
+#    endif
+
+{    /* Local variables. */
+    const  char  *s ;
+    TevEvent  *event ;
+    unsigned  long  head, tail ;
+
+
+
+    tail = timeline.tail ;
+    head = TEV_LOAD (&timeline.head) ;
+
+    for ( ;  tail != head ;  tail++) {
+
+        event = &timeline.ring[tail & timeline.mask] ;
+
+        fprintf (timeline.file, "%s{\"name\":\"", timeline.first ? "" : ",\n") ;
+        timeline.first = false ;
+        for (s = event->name ;  *s != '\0' ;  s++) {
+            if ((*s == '"') || (*s == '\\'))
+                fprintf (timeline.file, "\\%c", *s) ;
+            else if ((unsigned char) *s < 0x20)
+                fprintf (timeline.file, "\\u%04x", (unsigned int) *s) ;
+            else
+                putc (*s, timeline.file) ;
+        }
+
+        fprintf (timeline.file, "\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f",
+                 event->category, event->phase, event->timestamp) ;
+        if (event->phase == 'X')
+            fprintf (timeline.file, ",\"dur\":%.3f", event->duration) ;
+        else
+            fprintf (timeline.file, ",\"s\":\"t\"") ;
+        fprintf (timeline.file, ",\"pid\":1,\"tid\":1") ;
+        if (event->value >= 0)
+            fprintf (timeline.file, ",\"args\":{\"value\":%ld}", event->value) ;
+        putc ('}', timeline.file) ;
+
+        timeline.stats.written++ ;
+
+    }
+
+    TEV_STORE (&timeline.tail, tail) ;
+
+    return ;
+
+}
+
+#if HAVE_PTHREADS
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevFlushThread ()
+
+    Periodically Drain the Ring.
+
+
+Purpose:
+
+    Function tevFlushThread() is the writer thread, which drains the ring
+    buffer every TEV_FLUSH_INTERVAL seconds until told to stop.  The thread
+    blocks all signals, so that signals (e.g., those watched through a
+    dispatcher; see soxOnSignal()) are delivered to the main thread.
+
+
+    Invocation:
+
+        tevFlushThread (NULL) ;
+
+*******************************************************************************/
+
+
+static  void  *tevFlushThread (
+
+#    if PROTOTYPES
+        void  *arg)
+#    else
+        arg)
+
+        void  *arg ;
+#    endif
+
+{    /* Local variables. */
+    sigset_t  mask ;
+    struct  timespec  delay ;
+
+
+
+/* Leave all signals to the main thread. */
+
+    sigfillset (&mask) ;
+    pthread_sigmask (SIG_BLOCK, &mask, NULL) ;
+
+    delay.tv_sec = 0 ;
+    delay.tv_nsec = (long) (TEV_FLUSH_INTERVAL * 1000000000.0) ;
+
+    while (!TEV_LOAD (&timeline.stopping)) {
+        tevDrain () ;
+        nanosleep (&delay, NULL) ;
+    }
+
+    return (NULL) ;
+
+}
+
+#endif
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevForeign ()
+
+    Time a Call to a Foreign Function.
+
+
+Purpose:
+
+    Function tevForeign() is the trampoline installed in the cells of the
+    foreign functions wrapped by tevStart() and tevNameForeign().  When the
+    interpreter applies a foreign function, the cell being applied is in
+    the interpreter's code register, so the real function can be looked up
+    from the cell.  tevForeign() notes the function's name for the SOX_UTIL
+    stall watchdog (see soxForeign()) while it calls the real function and,
+    if the interpreter's functions are being timed, records a span around
+    the call.
+
+
+    Invocation:
+
+        result = tevForeign (sc, args) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <args>		- I
+            is the list of arguments to the foreign function.
+        <result>	- O
+            returns the foreign function's result.
+
+*******************************************************************************/
+
+
+static  pointer  tevForeign (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        pointer  args)
+#    else
+        sc, args)
+
+        scheme  *sc ;
+        pointer  args ;
+#    endif
+
+{    /* Local variables. */
+    bool  timed ;
+    const  char  *name, *previous ;
+    foreign_func  original ;
+    pointer  result ;
+    struct  timeval  start ;
+    TevForeign  *entry ;
+
+
+
+    entry = tevLookup (sc->code) ;
+    if (entry == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(tevForeign) Unknown foreign function %p.\n", (void *) sc->code) ;
+        return (sc->F) ;
+    }
+
+/* The timeline may be stopped, and the table freed, during the call (e.g.,
+   from a callback run by IOX-MONITOR), so copy what is needed afterwards. */
+
+    original = entry->original ;
+    name = entry->name ;
+    timed = (timeline.active && (sc == timeline.sc)) ;
+
+    previous = soxForeign (sc, name) ;
+    if (timed)  start = tvTOD () ;
+    result = original (sc, args) ;
+    if (timed)  tevSpan ("foreign", name, start, -1) ;
+    soxForeign (sc, previous) ;
+
+    return (result) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevInsert ()
+
+    Add a Foreign Function to the Table of Wrapped Functions.
+
+
+Purpose:
+
+    Function tevInsert() adds a foreign function cell and its real function
+    to the table of wrapped functions.  The table is grown if it would be
+    more than half full.  An entry already in the table for the same cell,
+    left behind by a collected cell or a released interpreter, is replaced.
+
+
+    Invocation:
+
+        status = tevInsert (cell, name, sc) ;
+
+    where
+
+        <cell>		- I
+            is the foreign function's cell, not yet pointed at tevForeign().
+        <name>		- I
+            is the function's global name.
+        <sc>		- I
+            is the Scheme interpreter to which the cell belongs.
+        <status>	- O
+            returns the status of adding the function, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  tevInsert (
+
+#    if PROTOTYPES
+        pointer  cell,
+        const  char  *name,
+        scheme  *sc)
+#    else
+        cell, name, sc)
+
+        pointer  cell ;
+        char  *name ;
+        scheme  *sc ;
+#    endif
+
+{    /* Local variables. */
+    size_t  i, j, mask, size ;
+    TevForeign  *table ;
+
+
+
+/* Grow the table, dropping the entries of released interpreters. */
+
+    if ((2 * (wrapped.count + 1)) > wrapped.size) {
+        for (size = 64 ;  size < (4 * (wrapped.count + 1)) ;  size <<= 1)
+            ;
+        table = (TevForeign *) calloc (size, sizeof (TevForeign)) ;
+        if (table == NULL) {
+            LGE "(tevInsert) Error allocating %lu-entry table.\ncalloc: ",
+                (unsigned long) size) ;
+            return (errno) ;
+        }
+        mask = size - 1 ;
+        wrapped.count = 0 ;
+        for (i = 0 ;  i < wrapped.size ;  i++) {
+            if (wrapped.table[i].sc == NULL)  continue ;
+            for (j = ((size_t) wrapped.table[i].cell >> 4) & mask ;
+                 table[j].cell != NULL ;  j = (j + 1) & mask)
+                ;
+            table[j] = wrapped.table[i] ;
+            wrapped.count++ ;
+        }
+        free (wrapped.table) ;
+        wrapped.table = table ;
+        wrapped.size = size ;
+    }
+
+/* Add the cell or replace its old entry. */
+
+    mask = wrapped.size - 1 ;
+    for (i = ((size_t) cell >> 4) & mask ;  wrapped.table[i].cell != NULL ;
+         i = (i + 1) & mask) {
+        if (wrapped.table[i].cell == cell)  break ;
+    }
+
+    if (wrapped.table[i].cell == NULL)  wrapped.count++ ;
+    wrapped.table[i].cell = cell ;
+    wrapped.table[i].original = cell->_object._ff ;
+    wrapped.table[i].name = name ;
+    wrapped.table[i].sc = sc ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevLookup ()
+
+    Look Up a Wrapped Foreign Function.
+
+
+Purpose:
+
+    Function tevLookup() looks up a foreign function cell in the table of
+    wrapped functions.
+
+
+    Invocation:
+
+        entry = tevLookup (cell) ;
+
+    where
+
+        <cell>		- I
+            is the foreign function's cell.
+        <entry>		- O
+            returns the cell's entry in the table; NULL is returned if the
+            cell is not in the table.
+
+*******************************************************************************/
+
+
+static  TevForeign  *tevLookup (
+
+#    if PROTOTYPES
+        pointer  cell)
+#    else
+        cell)
+
+        pointer  cell ;
+#    endif
+
+{    /* Local variables. */
+    size_t  i, mask ;
+
+
+
+    if (wrapped.table == NULL)  return (NULL) ;
+
+    mask = wrapped.size - 1 ;
+    for (i = ((size_t) cell >> 4) & mask ;  wrapped.table[i].cell != NULL ;
+         i = (i + 1) & mask) {
+        if (wrapped.table[i].cell == cell)  return (&wrapped.table[i]) ;
+    }
+
+    return (NULL) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevPut ()
+
+    Put an Event in the Ring.
+
+
+Purpose:
+
+    Function tevPut() copies an event into the next free slot of the ring
+    buffer.  If the ring is full, the event is dropped.  Events from threads
+    other than the one that started the timeline are ignored, since the ring
+    has a single producer.
+
+
+    Invocation:
+
+        tevPut (phase, category, name, start, end, value) ;
+
+    where
+
+        <phase>		- I
+            is the Chrome trace-event phase: 'X' for a span or 'i' for an
+            instant event.
+        <category>	- I
+            is the event's category.
+        <name>		- I
+            is the event's name; NULL is recorded as "?".
+        <start>		- I
+            is the time at which the event began.
+        <end>		- I
+            is the time at which the event ended.
+        <value>		- I
+            is a value recorded with the event; -1 if none.
+
+*******************************************************************************/
+
+
+static  void  tevPut (
+
+#    if PROTOTYPES
+        char  phase,
+        const  char  *category,
+        const  char  *name,
+        struct  timeval  start,
+        struct  timeval  end,
+        long  value)
+#    else
+        phase, category, name, start, end, value)
+
+        char  phase ;
+        char  *category ;
+        char  *name ;
+        struct  timeval  start ;
+        struct  timeval  end ;
+        long  value ;
+#    endif
+
+{    /* Local variables. */
+    TevEvent  *event ;
+    unsigned  long  head ;
+
+
+
+#if HAVE_PTHREADS
+    if (!pthread_equal (pthread_self (), timeline.owner))  return ;
+#endif
+
+    head = timeline.head ;
+    if ((head - TEV_LOAD (&timeline.tail)) > timeline.mask) {
+        timeline.stats.dropped++ ;
+        return ;
+    }
+
+    event = &timeline.ring[head & timeline.mask] ;
+    event->phase = phase ;
+    event->category = category ;
+    strncpy (event->name, (name == NULL) ? "?" : name, TEV_NAME_SIZE - 1) ;
+    event->name[TEV_NAME_SIZE - 1] = '\0' ;
+    event->timestamp = tvFloat (tvSubtract (start, timeline.start)) * 1000000.0 ;
+    event->duration = tvFloat (tvSubtract (end, start)) * 1000000.0 ;
+    if (event->timestamp < 0.0) {	/* Began before the timeline? */
+        event->duration += event->timestamp ;
+        event->timestamp = 0.0 ;
+    }
+    event->value = value ;
+
+    TEV_STORE (&timeline.head, head + 1) ;
+    timeline.stats.recorded++ ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tevWrap ()
+
+    Wrap or Unwrap an Interpreter's Foreign Functions.
+
+
+Purpose:
+
+    Function tevWrap() points the cells of the foreign functions bound to an
+    interpreter's global variables at tevForeign(), saving the real functions
+    in the table of wrapped functions, or restores the cells.  The functions
+    are wrapped for a user, a timeline or the stall watchdog, and are only
+    restored when no users remain.
+
+
+    Invocation:
+
+        status = tevWrap (sc, user, wrap) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <user>		- I
+            is the user for whom the functions are wrapped or unwrapped:
+            TEV_TIMELINE and/or TEV_WATCHDOG.
+        <wrap>		- I
+            specifies whether the functions are to be wrapped (true) or
+            unwrapped (false).
+        <status>	- O
+            returns the status of wrapping the functions, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  tevWrap (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        int  user,
+        bool  wrap)
+#    else
+        sc, user, wrap)
+
+        scheme  *sc ;
+        int  user ;
+        bool  wrap ;
+#    endif
+
+{    /* Local variables. */
+    long  i, length ;
+    pointer  frame, list, slot, value ;
+    size_t  count, j ;
+    TevWrapped  *client, *prev ;
+
+
+
+    prev = NULL ;
+    for (client = wrapped.list ;  client != NULL ;  client = client->next) {
+        if (client->sc == sc)  break ;
+        prev = client ;
+    }
+
+/* If the functions are already wrapped, just note the new user. */
+
+    if (wrap && (client != NULL)) {
+        client->users |= user ;
+        return (0) ;
+    }
+
+/* Unwrap the functions if no users remain.  A cell is restored only if it
+   is still a wrapped foreign function; if its global variable was rebound,
+   the cell may have been collected and reused.  The cell's entry is left
+   in the table, without an interpreter, so as not to break the probe
+   sequences of other entries; it is dropped when the table is next grown. */
+
+    if (!wrap) {
+        if (client == NULL)  return (0) ;
+        client->users &= ~user ;
+        if (client->users != 0)  return (0) ;
+        if (prev == NULL)
+            wrapped.list = client->next ;
+        else
+            prev->next = client->next ;
+        free (client) ;
+        for (j = 0 ;  j < wrapped.size ;  j++) {
+            if (wrapped.table[j].sc != sc)  continue ;
+            value = wrapped.table[j].cell ;
+            if (is_foreign (value) && (value->_object._ff == tevForeign))
+                value->_object._ff = wrapped.table[j].original ;
+            wrapped.table[j].sc = NULL ;
+        }
+        if (wrapped.list == NULL) {
+            free (wrapped.table) ;
+            wrapped.table = NULL ;
+            wrapped.size = wrapped.count = 0 ;
+        }
+        return (0) ;
+    }
+
+    client = (TevWrapped *) calloc (1, sizeof (TevWrapped)) ;
+    if (client == NULL) {
+        LGE "(tevWrap) Error allocating interpreter record.\ncalloc: ") ;
+        return (errno) ;
+    }
+    client->sc = sc ;
+    client->users = user ;
+    client->next = wrapped.list ;
+    wrapped.list = client ;
+
+/* Scan the global environment (as in global_name()), wrapping the foreign
+   functions.  A function bound to more than one variable is wrapped once,
+   under the first name found. */
+
+    frame = car (sc->global_env) ;
+    length = is_vector (frame) ? ivalue (frame) : 1 ;
+    count = 0 ;
+
+    for (i = 0 ;  i < length ;  i++) {
+        if (!is_vector (frame))
+            list = frame ;
+        else
+            list = (i % 2) ? cdr (frame + 1 + (i / 2))
+                           : car (frame + 1 + (i / 2)) ;
+        for ( ;  list != sc->NIL ;  list = cdr (list)) {
+            slot = car (list) ;
+            value = cdr (slot) ;
+            if (!is_foreign (value) ||
+                (value->_object._ff == tevForeign))  continue ;
+            if (tevInsert (value, symname (car (slot)), sc)) {
+                LGE "(tevWrap) Error wrapping %s.\ntevInsert: ",
+                    symname (car (slot))) ;
+                PUSH_ERRNO ;  tevWrap (sc, user, false) ;  POP_ERRNO ;
+                return (errno) ;
+            }
+            value->_object._ff = tevForeign ;
+            count++ ;
+        }
+    }
+
+    LGI "(tevWrap) Wrapped %lu foreign functions.\n", (unsigned long) count) ;
+
+    return (0) ;
+
+}
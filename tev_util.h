@@ -0,0 +1,84 @@
+/* $Id$ */
+/*******************************************************************************
+
+    tev_util.h
+
+    Trace-Event Timeline Utility Definitions.
+
+*******************************************************************************/
+
+#ifndef  TEV_UTIL_H		/* Has the file been INCLUDE'd already? */
+#define  TEV_UTIL_H  yes
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+extern  "C"  {
+#endif
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+#include  <scheme.h>			/* TinyScheme definitions. */
+#include  "scheme-private.h"		/* TinyScheme internals. */
+#include  "tv_util.h"			/* "timeval" manipulation functions. */
+
+
+/*******************************************************************************
+    Timeline statistics.
+*******************************************************************************/
+
+typedef  struct  TevStats {
+    unsigned  long  recorded ;		/* Events put in the ring. */
+    unsigned  long  dropped ;		/* Events lost to a full ring. */
+    unsigned  long  written ;		/* Events written to the file. */
+}  TevStats ;
+
+					/* Default ring capacity (events). */
+#define  TEV_CAPACITY  65536
+
+
+/*******************************************************************************
+    Miscellaneous declarations.
+*******************************************************************************/
+
+					/* Global debug switch (1/0 = yes/no). */
+extern  int  tev_util_debug  OCD ("tev_util") ;
+
+
+/*******************************************************************************
+    Public functions.
+*******************************************************************************/
+
+extern  bool  tevActive P_((void))
+    OCD ("tev_util") ;
+
+extern  void  tevInstant P_((const char *category,
+                             const char *name,
+                             long value))
+    OCD ("tev_util") ;
+
+extern  errno_t  tevNameForeign P_((scheme *sc,
+                                   bool name))
+    OCD ("tev_util") ;
+
+extern  void  tevRelease P_((scheme *sc))
+    OCD ("tev_util") ;
+
+extern  void  tevSpan P_((const char *category,
+                          const char *name,
+                          struct timeval start,
+                          long value))
+    OCD ("tev_util") ;
+
+extern  errno_t  tevStart P_((scheme *sc,
+                              const char *pathname,
+                              size_t capacity))
+    OCD ("tev_util") ;
+
+extern  errno_t  tevStop P_((TevStats *stats))
+    OCD ("tev_util") ;
+
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+}
+#endif
+
+#endif				/* If this file was not INCLUDE'd previously. */
@@ -0,0 +1,109 @@
+; $Id$
+;*******************************************************************************
+;
+;    TIMERB - is a benchmark for IOX-AFTER, IOX-RESCHEDULE, and IOX-CANCEL
+;        with a large number of outstanding timers.
+;
+;        TIMERB registers TIMER-COUNT single-shot timers (100,000 by default)
+;        with random delays of up to TIMER-SPAN seconds, simulating per-
+;        connection idle timers.  A periodic CHURN timer then, every tenth
+;        of a second, "touches" CHURN-COUNT randomly selected timers: most
+;        are rescheduled (as an idle timer is pushed back when there is
+;        activity on its connection) and the rest are canceled and replaced
+;        by new timers (as connections close and new ones are opened).
+;
+;        After BENCH-SECONDS, the benchmark reports the time taken to
+;        register the initial timers, the average cost of a churn operation,
+;        and the number of timers that fired.  The dispatcher is then
+;        destroyed, which cancels the remaining timers.
+;
+;        Invocation:
+;
+;            % tsion timerb.scm
+;
+;*******************************************************************************
+
+
+(define timer-count 100000)		; Number of outstanding timers.
+(define timer-span 60)			; Maximum timer delay in seconds.
+(define churn-count 5000)		; Operations per churn interval.
+(define bench-seconds 10)		; Duration of benchmark.
+
+
+;*******************************************************************************
+;    Utilities - a linear congruential random number generator and
+;        floating-point time of day.
+;*******************************************************************************
+
+(define seed 12345)
+
+(define (random n)
+    (set! seed (modulo (+ (* seed 1103515245) 12345) 2147483648))
+    (modulo (quotient seed 65536) n))
+
+(define (now)
+    (let ((tod (tv-tod)))
+        (+ (car tod) (/ (cdr tod) 1000000.0))))
+
+(define (random-delay)
+    (/ (random (* timer-span 1000)) 1000.0))
+
+
+;*******************************************************************************
+;    Callbacks.
+;*******************************************************************************
+
+(define fired 0)
+(define operations 0)
+(define churn-time 0.0)
+
+(define (expire callback reason slot)
+    (if (= reason IOX_FIRE)
+        (begin
+            (set! fired (+ fired 1))
+            (vector-set! timers slot #f))))
+
+(define (churn callback reason unused)
+    (let ((start (now)))
+        (do ((i 0 (+ i 1)))
+            ((>= i churn-count))
+            (let* ((slot (random timer-count))
+                   (timer (vector-ref timers slot)))
+                (cond ((not timer)
+                        (vector-set! timers slot
+                            (iox-after dispatcher expire slot (random-delay))))
+                      ((< (random 10) 8)
+                        (iox-reschedule timer (random-delay)))
+                      (else
+                        (iox-cancel timer)
+                        (vector-set! timers slot
+                            (iox-after dispatcher expire slot (random-delay)))))))
+        (set! churn-time (+ churn-time (- (now) start)))
+        (set! operations (+ operations churn-count))))
+
+
+;*******************************************************************************
+;    MAIN LOOP.
+;*******************************************************************************
+
+(define dispatcher (iox-create))
+(define timers (make-vector timer-count #f))
+
+(define start (now))
+(do ((i 0 (+ i 1)))
+    ((>= i timer-count))
+    (vector-set! timers i (iox-after dispatcher expire i (random-delay))))
+(define setup-time (- (now) start))
+
+(iox-every dispatcher churn '() 0.1 0.1)
+(iox-monitor dispatcher bench-seconds)
+
+(display "Registered ") (display timer-count)
+(display " timers in ") (display setup-time) (display " seconds.") (newline)
+(display "Churn: ") (display operations) (display " operations, ")
+(display (/ (* churn-time 1000000.0) (max operations 1)))
+(display " microseconds/operation.") (newline)
+(display "Fired: ") (display fired) (newline)
+
+(iox-destroy dispatcher)
+(exit)
@@ -0,0 +1,1327 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    trc_util.c
+
+    Event Trace Record/Replay Utilities.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The TRC_UTIL package records the events seen by a Scheme program's
+    dispatcher callbacks to a compact binary trace, and replays the trace
+    through the same callbacks later - without the network, without the
+    timing, and as fast as the callbacks can run.  Replaying a trace taken
+    from a production server thus gives a repeatable benchmark of the
+    server's handler code.
+
+    What a callback does depends on two things from the outside world: the
+    events that cause it to be called (I/O readiness, timers firing, etc.)
+    and the results of the foreign functions it calls to do its I/O (e.g.,
+    the data returned by TCP-READ).  The trace records both, in the order
+    they occurred:
+
+        - An event record holds the callback's serial number (see
+          soxSerial()), the reason for the call, and any extra argument
+          passed to the callback (e.g., the output of a spawned process).
+
+        - A result record holds the kind of foreign function (e.g.,
+          TrcTcpRead) and the value it returned: #f, #t, a string, an
+          integer, or a handle for a new connection.
+
+    FUNCS_IOX records each Scheme callback with trcEvent() just before the
+    callback is called.  The I/O functions in FUNCS_TCP and FUNCS_LFN pass
+    their results through trcResult(), which records them:
+
+        if (trcReplaying (sc, NULL))
+            return (trcResult (sc, TrcTcpRead, NULL)) ;
+        ... read the data ...
+        return (trcResult (sc, TrcTcpRead, data)) ;
+
+    In replay mode, trcResult() ignores the value passed in and returns the
+    next recorded result instead; connection handles are replaced by fake
+    handles (see trcMakeFake()) that the I/O functions recognize and never
+    pass to the networking libraries.  The replay driver (IOX-REPLAY) reads
+    the event records with trcNextEvent() and calls the callbacks directly;
+    callbacks registered during the replay are not registered with the
+    real dispatcher.  Because a deterministic program registers its
+    callbacks in the same order each time it runs, the callbacks' serial
+    numbers match those in the trace.
+
+    The recorded times (microseconds since the start of the trace) drive
+    only the order of events; the replay never waits for them, so time
+    effectively advances as fast as the callbacks complete.  If the program
+    strays from the recording - e.g., a callback calls TCP-READ where the
+    recording has TCP-WRITE - the mismatch is counted and the replay
+    continues as best it can.
+
+    File format: the 9-byte header "TSIONTRC\001", followed by the records.
+    Each record begins with a type byte ('E' or 'R') and the time elapsed
+    since the previous record; integers are written as variable-length
+    (7 bits per byte, least significant first) quantities.
+
+        'E' <delta> <id> <reason> <value>
+        'R' <delta> <kind> <value>
+
+    where <value> is a tag byte followed by the tag's data: none (0), #f (1),
+    #t (2), string (3) <length> <bytes>, integer (4) <zigzag-encoded value>,
+    handle (5), or bytevector (6) <length> <bytes>.
+
+
+Public Procedures:
+
+    trcEvent() - records a callback event.
+    trcFakeFd() - returns the fake file descriptor of a fake handle.
+    trcIsFake() - checks if a handle is a fake handle.
+    trcMakeFake() - creates a fake handle.
+    trcNextEvent() - reads the next event record from a replay.
+    trcRecording() - checks if events are being recorded.
+    trcReplaying() - checks if a trace is being replayed.
+    trcResult() - records or replays a foreign function's result.
+    trcStart() - starts recording or replaying a trace.
+    trcStop() - stops recording or replaying a trace.
+
+Private Procedures:
+
+    trcGetValue() - reads a value from a trace.
+    trcGetVarint() - reads a variable-length integer from a trace.
+    trcPeek() - reads the header of the next record from a trace.
+    trcPutHeader() - writes the header of a record to a trace.
+    trcPutValue() - writes a value to a trace.
+    trcPutVarint() - writes a variable-length integer to a trace.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <string.h>			/* C Library string functions. */
+#include  "tv_util.h"			/* "timeval" manipulation functions. */
+#include  "trc_util.h"			/* Event trace record/replay. */
+
+
+int  trc_util_debug = 0 ;		/* Global debug switch (1/0 = yes/no). */
+#undef  I_DEFAULT_GUARD
+#define  I_DEFAULT_GUARD  trc_util_debug
+
+
+/*******************************************************************************
+    Event Trace (Private View) and Definitions.
+*******************************************************************************/
+
+#define  TRC_MAGIC  "TSIONTRC\001"	/* File header. */
+#define  TRC_MAGIC_LENGTH  9
+
+#define  TRC_EVENT  'E'			/* Record types. */
+#define  TRC_RESULT  'R'
+
+#define  TRC_NONE  0			/* Value tags. */
+#define  TRC_FALSE  1
+#define  TRC_TRUE  2
+#define  TRC_STRING  3
+#define  TRC_INTEGER  4
+#define  TRC_HANDLE  5
+#define  TRC_BYTEVECTOR  6
+
+					/* Size of the trace's I/O buffer. */
+#ifndef TRC_BUFSIZ
+#    define  TRC_BUFSIZ  65536
+#endif
+
+typedef  struct  _TrcTrace {
+    FILE  *file ;			/* Trace file. */
+    bool  replay ;			/* Replaying (or recording)? */
+    IoxDispatcher  dispatcher ;		/* Dispatcher being traced. */
+    struct  timeval  start ;		/* Time recording began. */
+    unsigned  long  long  stamp ;	/* Time of last record (usec). */
+    int  next ;				/* Type of next record; EOF at end. */
+    char  *buffer ;			/* Buffer for strings being read. */
+    size_t  bufferSize ;
+    TrcStats  stats ;			/* Statistics. */
+}  _TrcTrace ;
+
+/* Fake handles are addresses within this array, so they can never be
+   mistaken for the addresses of real objects. */
+
+#ifndef TRC_MAX_FAKES
+#    define  TRC_MAX_FAKES  65536
+#endif
+					/* Fake descriptors start here. */
+#ifndef TRC_FAKE_FD
+#    define  TRC_FAKE_FD  1000000L
+#endif
+
+static  char  fakeSpace[TRC_MAX_FAKES] ;
+static  unsigned  long  fakeCount = 0 ;
+
+
+/*******************************************************************************
+    Private functions.
+*******************************************************************************/
+
+static  pointer  trcGetValue P_((scheme *sc,
+                                 TrcTrace trace)) ;
+
+static  errno_t  trcGetVarint P_((TrcTrace trace,
+                                  unsigned long long *value)) ;
+
+static  int  trcPeek P_((TrcTrace trace)) ;
+
+static  void  trcPutHeader P_((TrcTrace trace,
+                               int type)) ;
+
+static  void  trcPutValue P_((scheme *sc,
+                              TrcTrace trace,
+                              pointer value,
+                              bool handle)) ;
+
+static  void  trcPutVarint P_((TrcTrace trace,
+                               unsigned long long value)) ;
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcEvent ()
+
+    Record a Callback Event.
+
+
+Purpose:
+
+    Function trcEvent() records the invocation of a Scheme callback in the
+    trace being recorded for the callback's interpreter.  Nothing is done
+    if the interpreter isn't recording a trace.
+
+
+    Invocation:
+
+        status = trcEvent (sc, id, reason, extra) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <id>		- I
+            is the callback's serial number.
+        <reason>	- I
+            is the reason the callback is being invoked.
+        <extra>		- I
+            is the extra argument, if any, passed to the callback; NULL
+            if there is none.
+        <status>	- O
+            returns the status of recording the event, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  trcEvent (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        unsigned  long  id,
+        IoxReason  reason,
+        pointer  extra)
+#    else
+        sc, id, reason, extra)
+
+        scheme  *sc ;
+        unsigned  long  id ;
+        IoxReason  reason ;
+        pointer  extra ;
+#    endif
+
+{    /* Local variables. */
+    TrcTrace  trace = TS (sc, trace) ;
+
+
+
+    if ((trace == NULL) || trace->replay)  return (0) ;
+
+    trcPutHeader (trace, TRC_EVENT) ;
+    trcPutVarint (trace, (unsigned long long) id) ;
+    trcPutVarint (trace, (unsigned long long) reason) ;
+    trcPutValue (sc, trace, extra, false) ;
+
+    trace->stats.events++ ;
+
+    return (ferror (trace->file) ? EIO : 0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcFakeFd ()
+
+    Get the Fake File Descriptor of a Fake Handle.
+
+
+Purpose:
+
+    Function trcFakeFd() returns a file descriptor number for a fake handle.
+    The number is well above any real descriptor, and is only meant to be
+    passed back to TSION functions during the replay.
+
+
+    Invocation:
+
+        fd = trcFakeFd (handle) ;
+
+    where
+
+        <handle>	- I
+            is the fake handle.
+        <fd>		- O
+            returns the fake descriptor.
+
+*******************************************************************************/
+
+
+long  trcFakeFd (
+
+#    if PROTOTYPES
+        void  *handle)
+#    else
+        handle)
+
+        void  *handle ;
+#    endif
+
+{
+
+    return (TRC_FAKE_FD + (long) ((char *) handle - fakeSpace)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcIsFake ()
+
+    Check if a Handle is a Fake Handle.
+
+
+Purpose:
+
+    Function trcIsFake() checks if a handle is one of the fake handles that
+    stand in for network connections during a replay.
+
+
+    Invocation:
+
+        isFake = trcIsFake (handle) ;
+
+    where
+
+        <handle>	- I
+            is the handle.
+        <isFake>	- O
+            returns true if the handle is a fake handle and false otherwise.
+
+*******************************************************************************/
+
+
+bool  trcIsFake (
+
+#    if PROTOTYPES
+        void  *handle)
+#    else
+        handle)
+
+        void  *handle ;
+#    endif
+
+{
+
+    return (((char *) handle >= fakeSpace) &&
+            ((char *) handle < (fakeSpace + TRC_MAX_FAKES))) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcMakeFake ()
+
+    Create a Fake Handle.
+
+
+Purpose:
+
+    Function trcMakeFake() returns a new fake handle.  Fake handles have no
+    state; they are recycled after TRC_MAX_FAKES handles have been made.
+
+
+    Invocation:
+
+        handle = trcMakeFake () ;
+
+    where
+
+        <handle>	- O
+            returns the fake handle.
+
+*******************************************************************************/
+
+
+void  *trcMakeFake (
+
+#    if PROTOTYPES
+        void)
+#    else
+        )
+#    endif
+
+{
+
+    return ((void *) &fakeSpace[fakeCount++ % TRC_MAX_FAKES]) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcNextEvent ()
+
+    Read the Next Event Record from a Replay.
+
+
+Purpose:
+
+    Function trcNextEvent() reads the next event record from the trace being
+    replayed for an interpreter.  If the next record is a result the program
+    has not yet consumed, the caller has the choice of running whatever work
+    might consume it (e.g., the dispatcher's deferred work) and trying again,
+    or skipping the unconsumed results, which are counted as mismatches.
+
+
+    Invocation:
+
+        status = trcNextEvent (sc, skip, &id, &reason, &extra) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <skip>		- I
+            specifies whether (true) or not (false) unconsumed results are to
+            be skipped.  If not, EAGAIN is returned when the next record is
+            a result.
+        <id>		- O
+            returns the serial number of the callback.
+        <reason>	- O
+            returns the reason for the callback.
+        <extra>		- O
+            returns the extra argument for the callback, NULL if none.
+        <status>	- O
+            returns the status of reading the event, zero if an event was
+            read, EAGAIN if an unconsumed result was found and not skipped,
+            ENOENT at the end of the trace, and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  trcNextEvent (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        bool  skip,
+        unsigned  long  *id,
+        IoxReason  *reason,
+        pointer  *extra)
+#    else
+        sc, skip, id, reason, extra)
+
+        scheme  *sc ;
+        bool  skip ;
+        unsigned  long  *id ;
+        IoxReason  *reason ;
+        pointer  *extra ;
+#    endif
+
+{    /* Local variables. */
+    pointer  value ;
+    TrcTrace  trace = TS (sc, trace) ;
+    unsigned  long  long  number ;
+
+
+
+    if ((trace == NULL) || !trace->replay) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(trcNextEvent) Not replaying a trace.\n") ;
+        return (errno) ;
+    }
+
+/* Skip unconsumed results, if so requested. */
+
+    if (!skip && (trcPeek (trace) == TRC_RESULT))  return (EAGAIN) ;
+
+    while (trcPeek (trace) == TRC_RESULT) {
+        trace->next = 0 ;
+        if (trcGetVarint (trace, &number) ||
+            (trcGetValue (sc, trace) == NULL))  break ;
+        LGI "(trcNextEvent) Skipping unconsumed result: %d\n", (int) number) ;
+        trace->stats.mismatches++ ;
+    }
+
+    if (trace->next != TRC_EVENT)  return (ENOENT) ;
+
+/* Read the event. */
+
+    trace->next = 0 ;
+
+    if (trcGetVarint (trace, &number))  return (ENOENT) ;
+    *id = (unsigned long) number ;
+    if (trcGetVarint (trace, &number))  return (ENOENT) ;
+    *reason = (IoxReason) number ;
+
+    value = trcGetValue (sc, trace) ;
+    if (value == NULL)  return (ENOENT) ;
+    *extra = (value == sc->NIL) ? NULL : value ;
+
+    trace->stats.events++ ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcRecording ()
+
+    Check if Events are Being Recorded.
+
+
+Purpose:
+
+    Function trcRecording() checks if an interpreter is recording a trace
+    of a dispatcher's events.
+
+
+    Invocation:
+
+        isRecording = trcRecording (sc, dispatcher) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <dispatcher>	- I
+            is the dispatcher; NULL matches the dispatcher being traced,
+            whichever it is.
+        <isRecording>	- O
+            returns true if a trace is being recorded and false otherwise.
+
+*******************************************************************************/
+
+
+bool  trcRecording (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        IoxDispatcher  dispatcher)
+#    else
+        sc, dispatcher)
+
+        scheme  *sc ;
+        IoxDispatcher  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    TrcTrace  trace = TS (sc, trace) ;
+
+
+
+    return ((trace != NULL) && !trace->replay &&
+            ((dispatcher == NULL) || (dispatcher == trace->dispatcher))) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcReplaying ()
+
+    Check if a Trace is Being Replayed.
+
+
+Purpose:
+
+    Function trcReplaying() checks if an interpreter is replaying a trace
+    through a dispatcher's callbacks.
+
+
+    Invocation:
+
+        isReplaying = trcReplaying (sc, dispatcher) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <dispatcher>	- I
+            is the dispatcher; NULL matches the dispatcher being replayed,
+            whichever it is.
+        <isReplaying>	- O
+            returns true if a trace is being replayed and false otherwise.
+
+*******************************************************************************/
+
+
+bool  trcReplaying (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        IoxDispatcher  dispatcher)
+#    else
+        sc, dispatcher)
+
+        scheme  *sc ;
+        IoxDispatcher  dispatcher ;
+#    endif
+
+{    /* Local variables. */
+    TrcTrace  trace = TS (sc, trace) ;
+
+
+
+    return ((trace != NULL) && trace->replay &&
+            ((dispatcher == NULL) || (dispatcher == trace->dispatcher))) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcResult ()
+
+    Record or Replay a Foreign Function's Result.
+
+
+Purpose:
+
+    Function trcResult() passes the result of a foreign function through
+    the trace, if any, for the function's interpreter.
+
+        - When recording, the result is recorded and returned.
+
+        - When replaying, the result passed in is ignored and the next
+          recorded result is returned instead.  If the next record is not
+          a result of the same kind, a mismatch is counted and #f is
+          returned.
+
+        - Otherwise, the result is simply returned.
+
+    Only TCP-ANSWER and TCP-CALL results are recorded as handles; in replay,
+    a fake handle is returned in their place.
+
+
+    Invocation:
+
+        result = trcResult (sc, kind, value) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <kind>		- I
+            is the kind of function returning the result; e.g., TrcTcpRead.
+        <value>		- I
+            is the result being returned by the function; it is ignored,
+            and may be NULL, in replay mode.
+        <result>	- O
+            returns the result.
+
+*******************************************************************************/
+
+
+pointer  trcResult (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        TrcKind  kind,
+        pointer  value)
+#    else
+        sc, kind, value)
+
+        scheme  *sc ;
+        TrcKind  kind ;
+        pointer  value ;
+#    endif
+
+{    /* Local variables. */
+    TrcTrace  trace = TS (sc, trace) ;
+    unsigned  long  long  recorded ;
+
+
+
+    if (trace == NULL)  return (value) ;
+
+/* Record the result. */
+
+    if (!trace->replay) {
+        trcPutHeader (trace, TRC_RESULT) ;
+        trcPutVarint (trace, (unsigned long long) kind) ;
+        trcPutValue (sc, trace, value,
+                     (kind == TrcTcpAnswer) || (kind == TrcTcpCall)) ;
+        trace->stats.results++ ;
+        return (value) ;
+    }
+
+/* Replay the result. */
+
+    if (trcPeek (trace) != TRC_RESULT) {
+        LGI "(trcResult) Kind %d: no result recorded.\n", (int) kind) ;
+        trace->stats.mismatches++ ;
+        return (sc->F) ;
+    }
+
+    trace->next = 0 ;
+    if (trcGetVarint (trace, &recorded))  return (sc->F) ;
+
+    value = trcGetValue (sc, trace) ;
+    if (value == NULL)  return (sc->F) ;
+
+    if (recorded != (unsigned long long) kind) {
+        LGI "(trcResult) Kind %d: recorded kind %d.\n",
+            (int) kind, (int) recorded) ;
+        trace->stats.mismatches++ ;
+        return (sc->F) ;
+    }
+
+    trace->stats.results++ ;
+
+    return (value) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcStart ()
+
+    Start Recording or Replaying a Trace.
+
+
+Purpose:
+
+    Function trcStart() begins recording a trace of a dispatcher's events
+    to a file, or begins replaying a trace from a file.  An interpreter can
+    record or replay one trace at a time.
+
+
+    Invocation:
+
+        status = trcStart (sc, dispatcher, pathname, replay) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <dispatcher>	- I
+            is the dispatcher whose events are recorded or replayed.
+        <pathname>	- I
+            is the pathname of the trace file.
+        <replay>	- I
+            specifies whether the trace is to be replayed (true) or recorded
+            (false).  A recording overwrites the file.
+        <status>	- O
+            returns the status of starting the trace, zero if there were no
+            errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  trcStart (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        IoxDispatcher  dispatcher,
+        const  char  *pathname,
+        bool  replay)
+#    else
+        sc, dispatcher, pathname, replay)
+
+        scheme  *sc ;
+        IoxDispatcher  dispatcher ;
+        const  char  *pathname ;
+        bool  replay ;
+#    endif
+
+{    /* Local variables. */
+    char  header[TRC_MAGIC_LENGTH] ;
+    TrcTrace  trace ;
+
+
+
+    if (TS (sc, trace) != NULL) {
+        SET_ERRNO (EBUSY) ;
+        LGE "(trcStart) Interpreter %p is already tracing.\n", (void *) sc) ;
+        return (errno) ;
+    }
+
+    trace = (TrcTrace) calloc (1, sizeof (_TrcTrace)) ;
+    if (trace == NULL) {
+        LGE "(trcStart) Error allocating trace for %s.\ncalloc: ", pathname) ;
+        return (errno) ;
+    }
+
+    trace->replay = replay ;
+    trace->dispatcher = dispatcher ;
+    trace->start = tvTOD () ;
+
+/* Open the file and write or check its header. */
+
+    trace->file = fopen (pathname, replay ? "rb" : "wb") ;
+    if (trace->file == NULL) {
+        LGE "(trcStart) Error opening %s.\nfopen: ", pathname) ;
+        PUSH_ERRNO ;  free (trace) ;  POP_ERRNO ;
+        return (errno) ;
+    }
+
+    setvbuf (trace->file, NULL, _IOFBF, TRC_BUFSIZ) ;
+
+    if (replay) {
+        if ((fread (header, 1, TRC_MAGIC_LENGTH, trace->file) !=
+             TRC_MAGIC_LENGTH) ||
+            (memcmp (header, TRC_MAGIC, TRC_MAGIC_LENGTH) != 0)) {
+            SET_ERRNO (EINVAL) ;
+            LGE "(trcStart) %s is not a TSION trace.\n", pathname) ;
+            PUSH_ERRNO ;  fclose (trace->file) ;  free (trace) ;  POP_ERRNO ;
+            return (errno) ;
+        }
+    } else {
+        fwrite (TRC_MAGIC, 1, TRC_MAGIC_LENGTH, trace->file) ;
+    }
+
+    TS (sc, trace) = trace ;
+
+    LGI "(trcStart) %s %s.\n", replay ? "Replaying" : "Recording", pathname) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcStop ()
+
+    Stop Recording or Replaying a Trace.
+
+
+Purpose:
+
+    Function trcStop() stops recording or replaying an interpreter's trace
+    and closes the trace file.
+
+
+    Invocation:
+
+        status = trcStop (sc, &stats) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <stats>		- O
+            returns the statistics for the trace: the number of events and
+            results recorded or replayed, the number of mismatches found
+            during a replay, and the time spanned by the recording.  NULL
+            can be specified if the statistics are not needed.
+        <status>	- O
+            returns the status of closing the trace, zero if there were no
+            errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  trcStop (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        TrcStats  *stats)
+#    else
+        sc, stats)
+
+        scheme  *sc ;
+        TrcStats  *stats ;
+#    endif
+
+{    /* Local variables. */
+    errno_t  status ;
+    TrcTrace  trace = TS (sc, trace) ;
+
+
+
+    if (trace == NULL)  return (0) ;
+
+    TS (sc, trace) = NULL ;
+
+    trace->stats.recorded = (double) trace->stamp / 1000000.0 ;
+    if (stats != NULL)  *stats = trace->stats ;
+
+    status = ferror (trace->file) ? EIO : 0 ;
+    if (fclose (trace->file) && (status == 0))  status = errno ;
+    if (status) {
+        SET_ERRNO (status) ;
+        LGE "(trcStop) Error writing trace.\n") ;
+    }
+
+    if (trace->buffer != NULL)  free (trace->buffer) ;
+    free (trace) ;
+
+    return (status) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcGetValue ()
+
+    Read a Value from a Trace.
+
+
+Purpose:
+
+    Function trcGetValue() reads a tagged value from a trace being replayed
+    and converts it to a Scheme value.
+
+
+    Invocation:
+
+        value = trcGetValue (sc, trace) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <trace>		- I
+            is the trace.
+        <value>		- O
+            returns the value; () is returned for the "none" tag and NULL
+            if the value could not be read.
+
+*******************************************************************************/
+
+
+static  pointer  trcGetValue (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        TrcTrace  trace)
+#    else
+        sc, trace)
+
+        scheme  *sc ;
+        TrcTrace  trace ;
+#    endif
+
+{    /* Local variables. */
+    int  tag ;
+    pointer  value ;
+    unsigned  long  long  number ;
+    void  *buffer ;
+
+
+
+    tag = getc (trace->file) ;
+
+    switch (tag) {
+    case TRC_NONE:
+        return (sc->NIL) ;
+    case TRC_FALSE:
+        return (sc->F) ;
+    case TRC_TRUE:
+        return (sc->T) ;
+    case TRC_HANDLE:
+        return (mk_opaque (sc, trcMakeFake (), OpaqueTcpEndpoint)) ;
+    case TRC_INTEGER:
+        if (trcGetVarint (trace, &number))  break ;
+        return (mk_integer (sc, (number & 1) ? -(long) (number >> 1) - 1
+                                             : (long) (number >> 1))) ;
+    case TRC_STRING:
+    case TRC_BYTEVECTOR:
+        if (trcGetVarint (trace, &number))  break ;
+        if (number >= trace->bufferSize) {
+            buffer = realloc (trace->buffer, (size_t) number + 1) ;
+            if (buffer == NULL) {
+                LGE "(trcGetValue) Error allocating %lu-byte buffer.\nrealloc: ",
+                    (unsigned long) number + 1) ;
+                return (NULL) ;
+            }
+            trace->buffer = (char *) buffer ;
+            trace->bufferSize = (size_t) number + 1 ;
+        }
+        if (fread (trace->buffer, 1, (size_t) number, trace->file) != number)
+            break ;
+        if (tag == TRC_STRING)
+            return (mk_bstring (sc, trace->buffer, (size_t) number)) ;
+        value = mk_bytevector (sc, trace->buffer, (size_t) number) ;
+        return ((value == NULL) ? sc->F : value) ;
+    default:
+        break ;
+    }
+
+    SET_ERRNO (EINVAL) ;
+    LGE "(trcGetValue) Truncated or corrupt trace.\n") ;
+    trace->next = EOF ;
+
+    return (NULL) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcGetVarint ()
+
+    Read a Variable-Length Integer from a Trace.
+
+
+Purpose:
+
+    Function trcGetVarint() reads a variable-length unsigned integer from
+    a trace being replayed.
+
+
+    Invocation:
+
+        status = trcGetVarint (trace, &value) ;
+
+    where
+
+        <trace>		- I
+            is the trace.
+        <value>		- O
+            returns the integer.
+        <status>	- O
+            returns the status of reading the integer, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  trcGetVarint (
+
+#    if PROTOTYPES
+        TrcTrace  trace,
+        unsigned  long  long  *value)
+#    else
+        trace, value)
+
+        TrcTrace  trace ;
+        unsigned  long  long  *value ;
+#    endif
+
+{    /* Local variables. */
+    int  byte, shift ;
+
+
+
+    *value = 0 ;
+
+    for (shift = 0 ;  shift < 64 ;  shift += 7) {
+        byte = getc (trace->file) ;
+        if (byte == EOF)  break ;
+        *value |= (unsigned long long) (byte & 0x7F) << shift ;
+        if ((byte & 0x80) == 0)  return (0) ;
+    }
+
+    SET_ERRNO (EINVAL) ;
+    LGE "(trcGetVarint) Truncated or corrupt trace.\n") ;
+    trace->next = EOF ;
+
+    return (errno) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcPeek ()
+
+    Read the Header of the Next Record from a Trace.
+
+
+Purpose:
+
+    Function trcPeek() reads the type and time stamp of the next record in
+    a trace being replayed, if they haven't been read already.  The caller
+    consumes the record by clearing the trace's "next" field and reading
+    the rest of the record.
+
+
+    Invocation:
+
+        type = trcPeek (trace) ;
+
+    where
+
+        <trace>		- I
+            is the trace.
+        <type>		- O
+            returns the type of the next record, TRC_EVENT or TRC_RESULT;
+            EOF is returned at the end of the trace.
+
+*******************************************************************************/
+
+
+static  int  trcPeek (
+
+#    if PROTOTYPES
+        TrcTrace  trace)
+#    else
+        trace)
+
+        TrcTrace  trace ;
+#    endif
+
+{    /* Local variables. */
+    unsigned  long  long  delta ;
+
+
+
+    if (trace->next != 0)  return (trace->next) ;
+
+    trace->next = getc (trace->file) ;
+    if (trace->next == EOF)  return (EOF) ;
+
+    if (((trace->next != TRC_EVENT) && (trace->next != TRC_RESULT)) ||
+        trcGetVarint (trace, &delta)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(trcPeek) Truncated or corrupt trace.\n") ;
+        trace->next = EOF ;
+        return (EOF) ;
+    }
+
+    trace->stamp += delta ;		/* Advance the virtual clock. */
+
+    return (trace->next) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcPutHeader ()
+
+    Write the Header of a Record to a Trace.
+
+
+Purpose:
+
+    Function trcPutHeader() writes the type and time stamp of a new record
+    to a trace being recorded.
+
+
+    Invocation:
+
+        trcPutHeader (trace, type) ;
+
+    where
+
+        <trace>		- I
+            is the trace.
+        <type>		- I
+            is the type of the record, TRC_EVENT or TRC_RESULT.
+
+*******************************************************************************/
+
+
+static  void  trcPutHeader (
+
+#    if PROTOTYPES
+        TrcTrace  trace,
+        int  type)
+#    else
+        trace, type)
+
+        TrcTrace  trace ;
+        int  type ;
+#    endif
+
+{    /* Local variables. */
+    double  elapsed ;
+    unsigned  long  long  stamp ;
+
+
+
+    elapsed = tvFloat (tvSubtract (tvTOD (), trace->start)) ;
+    stamp = (elapsed > 0.0) ? (unsigned long long) (elapsed * 1000000.0) : 0 ;
+    if (stamp < trace->stamp)  stamp = trace->stamp ;
+
+    putc (type, trace->file) ;
+    trcPutVarint (trace, stamp - trace->stamp) ;
+
+    trace->stamp = stamp ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcPutValue ()
+
+    Write a Value to a Trace.
+
+
+Purpose:
+
+    Function trcPutValue() writes a Scheme value to a trace being recorded.
+    Values other than booleans, strings, bytevectors, integers, and handles
+    are recorded as "none".
+
+
+    Invocation:
+
+        trcPutValue (sc, trace, value, handle) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+        <trace>		- I
+            is the trace.
+        <value>		- I
+            is the value; NULL is recorded as "none".
+        <handle>	- I
+            specifies whether (true) or not (false) an opaque value should
+            be recorded as a handle.
+
+*******************************************************************************/
+
+
+static  void  trcPutValue (
+
+#    if PROTOTYPES
+        scheme  *sc,
+        TrcTrace  trace,
+        pointer  value,
+        bool  handle)
+#    else
+        sc, trace, value, handle)
+
+        scheme  *sc ;
+        TrcTrace  trace ;
+        pointer  value ;
+        bool  handle ;
+#    endif
+
+{    /* Local variables. */
+    long  number ;
+
+
+
+    if (value == NULL) {
+        putc (TRC_NONE, trace->file) ;
+    } else if (value == sc->F) {
+        putc (TRC_FALSE, trace->file) ;
+    } else if (value == sc->T) {
+        putc (TRC_TRUE, trace->file) ;
+    } else if (handle && is_opaque (sc, value, OpaqueAny)) {
+        putc (TRC_HANDLE, trace->file) ;
+    } else if (is_string (value)) {
+        putc (TRC_STRING, trace->file) ;
+        trcPutVarint (trace, (unsigned long long) strlength (value)) ;
+        fwrite (strvalue (value), 1, (size_t) strlength (value), trace->file) ;
+    } else if (is_bytevector (value)) {
+        putc (TRC_BYTEVECTOR, trace->file) ;
+        trcPutVarint (trace, (unsigned long long) bytevector_length (value)) ;
+        fwrite (bytevector_data (value), 1, bytevector_length (value),
+                trace->file) ;
+    } else if (isInteger (value)) {
+        number = ivalue (value) ;
+        putc (TRC_INTEGER, trace->file) ;
+        trcPutVarint (trace, (number < 0)
+                             ? ((unsigned long long) (-(number + 1)) << 1) | 1
+                             : (unsigned long long) number << 1) ;
+    } else {
+        LGI "(trcPutValue) Recording unsupported value as none.\n") ;
+        putc (TRC_NONE, trace->file) ;
+    }
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    trcPutVarint ()
+
+    Write a Variable-Length Integer to a Trace.
+
+
+Purpose:
+
+    Function trcPutVarint() writes an unsigned integer to a trace being
+    recorded, 7 bits per byte, least significant bits first; the high bit
+    of each byte is set if more bytes follow.
+
+
+    Invocation:
+
+        trcPutVarint (trace, value) ;
+
+    where
+
+        <trace>		- I
+            is the trace.
+        <value>		- I
+            is the integer.
+
+*******************************************************************************/
+
+
+static  void  trcPutVarint (
+
+#    if PROTOTYPES
+        TrcTrace  trace,
+        unsigned  long  long  value)
+#    else
+        trace, value)
+
+        TrcTrace  trace ;
+        unsigned  long  long  value ;
+#    endif
+
+{
+
+    while (value >= 0x80) {
+        putc ((int) ((value & 0x7F) | 0x80), trace->file) ;
+        value >>= 7 ;
+    }
+    putc ((int) value, trace->file) ;
+
+    return ;
+
+}
@@ -0,0 +1,127 @@
+/* $Id$ */
+/*******************************************************************************
+
+    trc_util.h
+
+    Event Trace Record/Replay Utility Definitions.
+
+*******************************************************************************/
+
+#ifndef  TRC_UTIL_H		/* Has the file been INCLUDE'd already? */
+#define  TRC_UTIL_H  yes
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+extern  "C"  {
+#endif
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+#include  "iox_util.h"			/* I/O event dispatcher definitions. */
+#include  "tsion.h"			/* TinyScheme I/O Network functions. */
+
+
+/*******************************************************************************
+    Event Trace (Client View) and Definitions.
+*******************************************************************************/
+
+typedef  struct  _TrcTrace  *TrcTrace ;	/* Trace handle. */
+
+/* The results of the foreign functions that depend on the outside world are
+   recorded along with the function that returned them.  When a trace is
+   replayed, the functions return the recorded results in the order they
+   were recorded; a mismatch between the function and the recorded kind of
+   result means the replay has diverged from the recording. */
+
+typedef  enum  TrcKind {
+    TrcNone = 0,
+    TrcLfnGetLine,
+    TrcLfnPutLine,
+    TrcLfnRead,
+    TrcLfnReadable,
+    TrcLfnUp,
+    TrcLfnWrite,
+    TrcLfnWriteable,
+    TrcTcpAnswer,
+    TrcTcpCall,
+    TrcTcpComplete,
+    TrcTcpPending,
+    TrcTcpRead,
+    TrcTcpReadable,
+    TrcTcpUp,
+    TrcTcpWrite,
+    TrcTcpWriteable
+}  TrcKind ;
+
+/* Replay statistics. */
+
+typedef  struct  TrcStats {
+    unsigned  long  events ;		/* Number of events replayed. */
+    unsigned  long  results ;		/* Number of results replayed. */
+    unsigned  long  mismatches ;	/* Records that didn't match. */
+    double  recorded ;			/* Time span of the recording. */
+}  TrcStats ;
+
+
+/*******************************************************************************
+    Miscellaneous declarations.
+*******************************************************************************/
+
+					/* Global debug switch (1/0 = yes/no). */
+extern  int  trc_util_debug  OCD ("trc_util") ;
+
+
+/*******************************************************************************
+    Public functions.
+*******************************************************************************/
+
+extern  errno_t  trcEvent P_((scheme *sc,
+                              unsigned long id,
+                              IoxReason reason,
+                              pointer extra))
+    OCD ("trc_util") ;
+
+extern  long  trcFakeFd P_((void *handle))
+    OCD ("trc_util") ;
+
+extern  bool  trcIsFake P_((void *handle))
+    OCD ("trc_util") ;
+
+extern  void  *trcMakeFake P_((void))
+    OCD ("trc_util") ;
+
+extern  errno_t  trcNextEvent P_((scheme *sc,
+                                  bool skip,
+                                  unsigned long *id,
+                                  IoxReason *reason,
+                                  pointer *extra))
+    OCD ("trc_util") ;
+
+extern  bool  trcRecording P_((scheme *sc,
+                               IoxDispatcher dispatcher))
+    OCD ("trc_util") ;
+
+extern  bool  trcReplaying P_((scheme *sc,
+                               IoxDispatcher dispatcher))
+    OCD ("trc_util") ;
+
+extern  pointer  trcResult P_((scheme *sc,
+                               TrcKind kind,
+                               pointer value))
+    OCD ("trc_util") ;
+
+extern  errno_t  trcStart P_((scheme *sc,
+                              IoxDispatcher dispatcher,
+                              const char *pathname,
+                              bool replay))
+    OCD ("trc_util") ;
+
+extern  errno_t  trcStop P_((scheme *sc,
+                             TrcStats *stats))
+    OCD ("trc_util") ;
+
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+}
+#endif
+
+#endif				/* If this file was not INCLUDE'd previously. */
@@ -150,11 +150,15 @@ int  main (
 
 /* Add the TSION extensions. */
 
+    addFuncsBVR (sc) ;
     addFuncsDRS (sc) ;
+    addFuncsFUT (sc) ;
+    addFuncsHTB (sc) ;
     addFuncsIOX (sc) ;
     addFuncsLFN (sc) ;
     addFuncsMISC (sc) ;
     addFuncsNET (sc) ;
+    addFuncsNPT (sc) ;
     addFuncsREX (sc) ;
     addFuncsSKT (sc) ;
     addFuncsTCP (sc) ;
@@ -216,6 +220,7 @@ int  main (
 
     if (!quit)  scheme_load_file (sc, stdin) ;
 
+    tsion_release (sc) ;
     scheme_deinit (sc) ;
 
 
@@ -27,25 +27,73 @@ extern  "C"  {
 
 /* Register foreign functions. */
 
+extern  void  addFuncsBVR P_((scheme *sc)) ;
 extern  void  addFuncsDRS P_((scheme *sc)) ;
+extern  void  addFuncsFUT P_((scheme *sc)) ;
+extern  void  addFuncsHTB P_((scheme *sc)) ;
 extern  void  addFuncsIOX P_((scheme *sc)) ;
 extern  void  addFuncsLFN P_((scheme *sc)) ;
 extern  void  addFuncsMISC P_((scheme *sc)) ;
 extern  void  addFuncsNET P_((scheme *sc)) ;
+extern  void  addFuncsNPT P_((scheme *sc)) ;
 extern  void  addFuncsREX P_((scheme *sc)) ;
 extern  void  addFuncsSKT P_((scheme *sc)) ;
 extern  void  addFuncsTCP P_((scheme *sc)) ;
 
+/* Release per-interpreter state (see tsion_release()). */
+
+extern  void  releaseFuncsFUT P_((scheme *sc)) ;
+extern  void  releaseFuncsNPT P_((scheme *sc)) ;
+
 
 /*******************************************************************************
     Implement opaque data type.
 *******************************************************************************/
 
 typedef  void  *opaque ;
+					/* Cell type beyond TinyScheme's own. */
+#define  T_OPAQUE  (T_LAST_SYSTEM_TYPE + 1)
+
+typedef  enum  OpaqueType {		/* Types of objects behind handles. */
+    OpaqueAny = 0,			/* Any type (is_opaque() only). */
+    OpaqueCallback,			/* SoxCallback * (IOX callbacks). */
+    OpaqueDirectoryScan,		/* DirectoryScan (DRS). */
+    OpaqueDispatcher,			/* IoxDispatcher (IOX). */
+    OpaqueLfnStream,			/* LfnStream (LFN). */
+    OpaquePattern,			/* CompiledRE (REX). */
+    OpaqueTcpEndpoint,			/* TcpEndpoint (TCP). */
+    OpaqueNumTypes			/* Number of types (not a type). */
+}  OpaqueType ;
+					/* Destroys a leaked object. */
+typedef  errno_t  (*OpaqueFinalizer) P_((opaque value)) ;
+
+bool  is_opaque P_((scheme *sc, pointer p, OpaqueType type)) ;
+pointer  mk_opaque P_((scheme *sc, opaque value, OpaqueType type)) ;
+long  opaque_collect P_((scheme *sc)) ;
+void  opaque_finalizer P_((scheme *sc, OpaqueType type,
+                           OpaqueFinalizer finalizer)) ;
+void  opaque_free P_((scheme *sc)) ;
+unsigned  long  opaque_key P_((pointer p)) ;
+bool  opaque_log_leaks P_((scheme *sc, bool flag)) ;
+void  opaque_pin P_((scheme *sc, opaque value, bool pin)) ;
+void  opaque_release P_((scheme *sc, opaque value)) ;
+opaque  opaque_value P_((scheme *sc, pointer p)) ;
+
 
-bool  is_opaque P_((pointer p)) ;
-pointer  mk_opaque P_((scheme *sc, opaque value)) ;
-opaque  opaque_value P_((pointer p)) ;
+/*******************************************************************************
+    Implement bytevector data type.
+*******************************************************************************/
+
+					/* Cell type beyond TinyScheme's own. */
+#define  T_BYTEVECTOR  (T_LAST_SYSTEM_TYPE + 2)
+
+				/* The bytes are held in a string cell. */
+#define  bytevector_data(p)  ((unsigned char *) strvalue (car (p)))
+#define  bytevector_length(p)  ((size_t) strlength (car (p)))
+
+errno_t  bytevector_shrink P_((scheme *sc, pointer p, size_t length)) ;
+bool  is_bytevector P_((pointer p)) ;
+pointer  mk_bytevector P_((scheme *sc, const void *data, size_t length)) ;
 
 
 /*******************************************************************************
@@ -57,14 +105,28 @@ opaque  opaque_value P_((pointer p)) ;
 typedef  long  UniqueID ;
 
 typedef  struct  _TsionSpecific {
-    UniqueID  idCounter ;		/* Unique ID counter. */
+    pointer  *idBindings ;		/* ID map bindings, indexed by ID-1. */
+    size_t  idCount ;			/* # of bindings allocated. */
+    size_t  idMax ;			/* Size of binding array. */
+    UniqueID  *idFree ;			/* Stack of released IDs. */
+    size_t  idNumFree ;			/* # of released IDs on stack. */
+    pointer  idMapSymbol ;		/* Cached *TSION-ID-MAP* symbol cell ... */
+    pointer  idMapProperty ;		/* ... and its ALIST property cell. */
     pointer  grabValue ;		/* Value from most recent GRAB. */
+    struct  _TrcTrace  *trace ;		/* Event trace being recorded/replayed. */
+    struct  _OpaqueTable  *handles ;	/* Opaque value (handle) table. */
+    struct  _GcState  *gcState ;	/* Collection statistics (GC_UTIL). */
+    struct  _FutQueue  *futQueues ;	/* Queued future functions (FUNCS_FUT). */
+    pointer  makeVector ;		/* Built-in MAKE-VECTOR (FUNCS_HTB). */
 }  _TsionSpecific, *TsionSpecific ;
 
 				/* Get or set field. */
 #define  TS(sc, field)		\
 	(((TsionSpecific) ((sc)->ext_data))->field)
 
+				/* Call before scheme_deinit(). */
+void  tsion_release P_((scheme *sc)) ;
+
 
 #ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
 }
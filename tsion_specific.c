@@ -0,0 +1,110 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    tsion_specific.c
+
+    TSION-Specific Interpreter Data.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The TSION_SPECIFIC package manages the TSION-specific structure that
+    hangs off each Scheme interpreter's "ext_data" field (see "tsion.h").
+    The program allocates the structure when it creates an interpreter; the
+    TSION packages then attach their per-interpreter storage to it as it is
+    needed: the ID bindings and collection statistics (GC_UTIL), the handle
+    table (OPAQUE), the event trace (TRC_UTIL), and the queues of future
+    functions (FUNCS_FUT).  scheme_deinit() knows
+    nothing of this storage, so, before destroying an interpreter, the
+    program must release it with tsion_release():
+
+        tsion_release (sc) ;
+        scheme_deinit (sc) ;
+
+    In the daemon, which creates and destroys an interpreter per client
+    connection, storage not released would accumulate over the daemon's
+    lifetime.
+
+
+Public Procedures:
+
+    tsion_release() - releases an interpreter's TSION-specific storage.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  "tsion.h"			/* TinyScheme I/O Network functions. */
+#include  "gc_util.h"			/* Garbage collection utilities. */
+#include  "tev_util.h"			/* Trace-event timelines. */
+#include  "trc_util.h"			/* Event trace record/replay. */
+
+/*!*****************************************************************************
+
+Procedure:
+
+    tsion_release ()
+
+    Release an Interpreter's TSION-Specific Storage.
+
+
+Purpose:
+
+    Function tsion_release() stops an interpreter's event trace, if one is
+    being recorded or replayed, restores any of the interpreter's foreign
+    functions wrapped by a timeline (see tevRelease()), cancels its queued
+    future functions, closes its network ports, frees its handle table and
+    GC_UTIL storage, and frees the TSION-specific structure itself.  The
+    function must be called before the interpreter is destroyed with
+    scheme_deinit(); afterwards, no TSION functions may be called for the
+    interpreter.  The C objects referred to by opaque handles are not
+    destroyed (see opaque_free()).
+
+
+    Invocation:
+
+        tsion_release (sc) ;
+
+    where
+
+        <sc>		- I
+            is the Scheme interpreter.
+
+*******************************************************************************/
+
+
+void  tsion_release (
+
+#    if PROTOTYPES
+        scheme  *sc)
+#    else
+        sc)
+
+        scheme  *sc ;
+#    endif
+
+{
+
+    if (sc->ext_data == NULL)  return ;
+
+    trcStop (sc, NULL) ;
+    tevRelease (sc) ;
+    releaseFuncsFUT (sc) ;
+    releaseFuncsNPT (sc) ;
+    opaque_free (sc) ;
+    gc_release (sc) ;
+
+    free (sc->ext_data) ;
+    scheme_set_external_data (sc, NULL) ;
+
+    return ;
+
+}
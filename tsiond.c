@@ -20,10 +20,23 @@ Purpose:
     Scheme variable G-DISPATCHER.  Clients and scripts should use this
     dispatcher instead of creating their own via the IOX-CREATE function.
 
+    The global dispatcher is given a lag probe, so its event-loop lag is
+    always available via (iox-lag G-DISPATCHER).  The "-watchdog" option
+    sets a stall threshold: if the server spends longer than that in any
+    one callback (e.g., evaluating a client's input), a report naming the
+    client and, if applicable, the foreign function being executed is
+    written to standard error.
+
+    The "-heap" option has each client's interpreter report its heap
+    statistics and a census of its cells by type (see GC-STATS and
+    HEAP-PROFILE) to standard error at a fixed interval, for tracking
+    down memory growth in long-lived sessions.
+
 
     Invocation:
 
-        % tsiond [-debug] [-Debug] [-listen <port>]
+        % tsiond [-debug] [-Debug] [-heap <seconds>] [-listen <port>]
+                 [-watchdog <seconds>]
 
     where:
 
@@ -31,10 +44,16 @@ Purpose:
         "-Debug"
             enables debug output (written to STDOUT).  Capital "-Debug"
             generates more voluminous debug.
+        "-heap <seconds>"
+            specifies the interval at which each client's heap statistics are
+            reported.  By default, they are not reported.
         "-listen <port>"
             specifies a network server port at which TSIOND will listen for and
             accept client connection requests.  A separate TSION interpreter is
             created for each new client and I/O is redirected to the client.
+        "-watchdog <seconds>"
+            specifies the stall threshold for the global dispatcher.  By
+            default, stalls are not reported.
 
 *******************************************************************************/
 
@@ -63,12 +82,33 @@ Purpose:
 #include  "tsion.h"			/* TinyScheme I/O Network functions. */
 #include  "gc_util.h"			/* Garbage collection utilities. */
 #include  "plist_util.h"		/* TinyScheme property lists. */
+#include  "sox_util.h"			/* Scheme dispatcher utilities. */
+#include  "tev_util.h"			/* Trace-event timelines. */
+
+
+					/* Interval between lag probes. */
+#ifndef TSIOND_PROBE
+#    define  TSIOND_PROBE  1.0
+#endif
+
+
+					/* Interval between heap reports;
+					   zero if none. */
+static  double  heapInterval = 0.0 ;
 
 
 /*******************************************************************************
     Private Functions.
 *******************************************************************************/
 
+static  errno_t  heapReportCB (
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData
+#    endif
+    ) ;
+
 static  errno_t  newClientCB (
 #    if PROTOTYPES
         IoxCallback  callback,
@@ -103,13 +143,14 @@ int  main (
 
 {    /* Local variables. */
     char  *argument ;
+    double  watchdog ;
     int  errflg, option ;
     IoxDispatcher  dispatcher ;
     OptContext  scan ;
     TcpEndpoint  server ;
 
     const  char  *optionList[] = {	/* Command line options. */
-        "{Debug}", "{debug}", "{listen:}", NULL
+        "{Debug}", "{debug}", "{heap:}", "{listen:}", "{watchdog:}", NULL
     } ;
 
 
@@ -137,6 +178,7 @@ int  main (
 *******************************************************************************/
 
     server = NULL ;
+    watchdog = 0.0 ;
 
     opt_init (argc, argv, NULL, optionList, &scan) ;
     errflg = 0 ;
@@ -150,13 +192,19 @@ int  main (
             iox_util_debug = 1 ;
             lfn_util_debug = 1 ;
             break ;
-        case 3:			/* "-listen <port>" */
+        case 3:			/* "-heap <seconds>" */
+            heapInterval = strtod (argument, NULL) ;
+            break ;
+        case 4:			/* "-listen <port>" */
             if (tcpListen (argument, -1, &server))
                 errflg++ ;
             else if (NULL == ioxOnIO (dispatcher, newClientCB, (void *) server,
                                       IoxRead, tcpFd (server)))
                 errflg++ ;
             break ;
+        case 5:			/* "-watchdog <seconds>" */
+            watchdog = strtod (argument, NULL) ;
+            break ;
         default:
             errflg++ ;  break ;
         }
@@ -166,11 +214,24 @@ int  main (
     opt_term (scan) ;
 
     if (errflg || (server == NULL)) {
-        fprintf (stderr, "Usage:  tsiond [-debug] [-Debug] [-listen <port>]\n") ;
+        fprintf (stderr, "Usage:  tsiond [-debug] [-Debug] [-heap <seconds>] [-listen <port>] [-watchdog <seconds>]\n") ;
         exit (EINVAL) ;
     }
 
 
+/*******************************************************************************
+    Monitor the global dispatcher's event-loop lag and, if requested, stalls.
+*******************************************************************************/
+
+    if (soxProbe (dispatcher, TSIOND_PROBE)) {
+        LGE "[%s] Error setting up lag probe.\n", argv[0]) ;
+    }
+
+    if ((watchdog > 0.0) && soxSetWatchdog (dispatcher, watchdog)) {
+        LGE "[%s] Error setting stall threshold.\n", argv[0]) ;
+    }
+
+
 /*******************************************************************************
     Loop forever, processing input events as they occur.
 *******************************************************************************/
@@ -183,6 +244,106 @@ int  main (
 
 /*!*****************************************************************************
 
+Procedure:
+
+    heapReportCB ()
+
+    Report a Client's Heap Statistics.
+
+
+Purpose:
+
+    Function heapReportCB() is a periodic timer callback that writes a
+    client's heap statistics and a census of its interpreter's cells by
+    type (see gc_stats() and gc_census()) to standard error.  A timer is
+    registered for each client if the "-heap" option was specified.  The
+    census includes garbage not yet collected; the interpreter is not
+    forced to collect, so as not to add pauses to the client's session.
+
+
+    Invocation:
+
+        status = heapReportCB (callback, reason, userData) ;
+
+    where:
+
+        <callback>	- I
+            is the handle assigned to the callback by ioxEvery().
+        <reason>	- I
+            is the reason, IoxFire or IoxCancel, the callback is being
+            invoked.
+        <userData>	- I
+            is the address of a 2-tuple containing a pointer to the client's
+            Scheme interpreter and the LfnStream for the client's network
+            connection.  The tuple is destroyed when the timer is cancelled.
+        <status>	- O
+            returns the status of reporting the statistics, zero if there
+            were no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+static  errno_t  heapReportCB (
+
+#    if PROTOTYPES
+        IoxCallback  callback,
+        IoxReason  reason,
+        void  *userData)
+#    else
+        callback, reason, userData)
+
+        IoxCallback  callback ;
+        IoxReason  reason ;
+        void  *userData ;
+#    endif
+
+{    /* Local variables. */
+    GcCensus  census ;
+    GcStats  stats ;
+    int  kind ;
+    LfnStream  stream ;
+    scheme  *sc ;
+    Tuple  tuple ;
+
+
+
+
+    tuple = (Tuple) userData ;
+
+    if (reason == IoxCancel) {
+        tplDestroy (tuple) ;
+        return (0) ;
+    }
+
+    sc = tplGet (tuple, 0) ;
+    stream = tplGet (tuple, 1) ;
+
+    gc_stats (sc, &stats) ;
+    gc_census (sc, &census) ;
+
+    fprintf (stderr, "(tsiond) Heap for %s: %ld/%ld cells used, %d/%d segments, %ld collections, %.6f seconds in GC.\n",
+             lfnName (stream), stats.usedCells, stats.cells,
+             stats.segments, stats.maxSegments,
+             stats.collections, stats.gcTime) ;
+
+    fprintf (stderr, "(tsiond)    ") ;
+    for (kind = 0 ;  kind < GC_NUM_TYPES ;  kind++) {
+        if (census.count[kind] == 0)  continue ;
+        fprintf (stderr, " %s %ld", gc_type_name (kind), census.count[kind]) ;
+        if (kind == T_STRING)
+            fprintf (stderr, " (%lu bytes)",
+                     (unsigned long) census.stringBytes) ;
+        else if (kind == T_VECTOR)
+            fprintf (stderr, " (+%ld cells)", census.vectorCells) ;
+    }
+    fprintf (stderr, "\n") ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
 Procedure:
 
     newClientCB ()
@@ -240,6 +401,7 @@ static  errno_t  newClientCB (
 {    /* Local variables. */
     char  *fileName ;
     FILE  *file ;
+    IoxCallback  report ;
     LfnStream  stream ;
 #if !defined(HAVE_DUP) || HAVE_DUP
     port  *inputPort ;
@@ -350,11 +512,15 @@ static  errno_t  newClientCB (
 
 /* Add the TSION extensions. */
 
+    addFuncsBVR (sc) ;
     addFuncsDRS (sc) ;
+    addFuncsFUT (sc) ;
+    addFuncsHTB (sc) ;
     addFuncsIOX (sc) ;
     addFuncsLFN (sc) ;
     addFuncsMISC (sc) ;
     addFuncsNET (sc) ;
+    addFuncsNPT (sc) ;
     addFuncsREX (sc) ;
     addFuncsSKT (sc) ;
     addFuncsTCP (sc) ;
@@ -363,19 +529,54 @@ static  errno_t  newClientCB (
 
     scheme_define (sc, sc->global_env,
                    mk_symbol (sc, "G-DISPATCHER"),
-                   mk_opaque (sc, (void *) ioxDispatcher (callback))) ;
+                   mk_opaque (sc, (void *) ioxDispatcher (callback),
+                              OpaqueDispatcher)) ;
+
+/* If the global dispatcher has a stall threshold, have the client's foreign
+   functions note their names for the watchdog. */
+
+    if ((soxWatchdog (ioxDispatcher (callback)) > 0.0) &&
+        tevNameForeign (sc, true)) {
+        LGE "(newClientCB) Error wrapping foreign functions for %s.\ntevNameForeign: ",
+            tcpName (client)) ;
+    }
 
 /* Print the Scheme command-line prompt. */
 
     putstr (sc, "> ") ;
     fflush (sc->outport->_object._port->rep.stdio.file) ;
 
+/* If requested, set up the periodic heap report for the client.  The report
+   timer has its own tuple, which it destroys when it is cancelled; the timer
+   is cancelled if the client can't be registered below. */
+
+    report = NULL ;
+    if (heapInterval > 0.0) {
+        tuple = tplCreate (2, (void *) sc, (void *) stream) ;
+        if (tuple == NULL) {
+            LGE "(newClientCB) Error creating heap report tuple for %s.\ntplCreate: ",
+                tcpName (client)) ;
+            return (errno) ;
+        }
+        report = ioxEvery (ioxDispatcher (callback), heapReportCB,
+                           (void *) tuple, heapInterval, heapInterval) ;
+        if (report == NULL) {
+            LGE "(newClientCB) Error registering heap report for %s.\nioxEvery: ",
+                tcpName (client)) ;
+            PUSH_ERRNO ;  tplDestroy (tuple) ;  POP_ERRNO ;
+            return (errno) ;
+        }
+    }
+
 /* Register the new client as an input source with the I/O event dispatcher. */
 
-    tuple = tplCreate (2, (void *) sc, (void *) stream) ;
+    tuple = tplCreate (3, (void *) sc, (void *) stream, (void *) report) ;
     if (tuple == NULL) {
         LGE "(newClientCB) Error creating tuple for %s.\ntplCreate: ",
             tcpName (client)) ;
+        PUSH_ERRNO ;
+        if (report != NULL)  ioxCancel (report) ;
+        POP_ERRNO ;
         return (errno) ;
     }
 
@@ -383,6 +584,10 @@ static  errno_t  newClientCB (
                          (void *) tuple, IoxRead, lfnFd (stream))) {
         LGE "(newClientCB) Error registering client with I/O event dispatcher for %s.\nioxOnIO: ",
             tcpName (client)) ;
+        PUSH_ERRNO ;
+        if (report != NULL)  ioxCancel (report) ;
+        tplDestroy (tuple) ;
+        POP_ERRNO ;
         return (errno) ;
     }
 
@@ -422,9 +627,9 @@ Purpose:
         <reason>	- I
             is the reason, IoxRead, the callback is being invoked.
         <userData>	- I
-            is the address of a 2-tuple containing a pointer to the client's
-            Scheme interpreter and the LfnStream for the client's network
-            connection.
+            is the address of a 3-tuple containing a pointer to the client's
+            Scheme interpreter, the LfnStream for the client's network
+            connection, and the client's heap report timer (NULL if none).
         <status>	- O
             returns the status of reading and processing the input, zero if
             there were no errors and ERRNO otherwise.  The status value is
@@ -452,6 +657,7 @@ static  errno_t  readClientCB (
     char  *inbuf ;
     LfnStream  stream ;
     scheme  *sc ;
+    SoxActivity  activity ;
     Tuple  tuple ;
 
 
@@ -471,7 +677,12 @@ static  errno_t  readClientCB (
             break ;
         }
 
+        activity.kind = "client" ;
+        activity.name = lfnName (stream) ;
+        activity.sc = sc ;
+        soxEnter (ioxDispatcher (callback), &activity) ;
         scheme_load_string (sc, inbuf) ;
+        soxLeave (ioxDispatcher (callback), &activity) ;
         putstr (sc, "> ") ;
         fflush (sc->outport->_object._port->rep.stdio.file) ;
 
@@ -487,7 +698,10 @@ static  errno_t  readClientCB (
         PUSH_ERRNO ;
         fclose (sc->outport->_object._port->rep.stdio.file) ;
         ioxCancel (callback) ;
+        if (tplGet (tuple, 2) != NULL)
+            ioxCancel ((IoxCallback) tplGet (tuple, 2)) ;
         lfnDestroy (stream) ;
+        tsion_release (sc) ;
         scheme_deinit (sc) ;
         tplDestroy (tuple) ;
         POP_ERRNO ;
@@ -0,0 +1,1536 @@
+/* $Id$ */
+/*******************************************************************************
+
+File:
+
+    twl_util.c
+
+    Hierarchical Timing Wheel Utilities.
+
+
+Author:    Alex Measday
+
+
+Purpose:
+
+    The TWL_UTIL package implements a hierarchical timing wheel (see Varghese
+    and Lauck, "Hashed and Hierarchical Timing Wheels").  Adding, canceling,
+    and rescheduling a timer are all constant-time operations, regardless of
+    the number of timers registered with the wheel.
+
+    Time is divided into ticks whose length is the wheel's resolution.  The
+    wheel has TWL_LEVELS levels of TWL_SLOTS slots each.  A timer due within
+    TWL_SLOTS ticks is placed in a level-0 slot; a timer due further out is
+    placed in the slot of a higher level that covers its expiration time.
+    When the level-0 index wraps around, the next slot of level 1 is cascaded,
+    i.e., its timers are redistributed among the lower levels, and so on up
+    the hierarchy.
+
+    Expiration times are rounded up to the next tick, so the resolution also
+    serves as the timer slack: all the timers due within the same tick are
+    fired together by a single call to twlRun().
+
+    A timer whose delay is shorter than a tick (in particular, a delay of
+    zero, commonly used to run something as soon as the application gets
+    back to its event loop) is not put in the wheel, whose rounding would
+    hold it for up to a full tick.  Instead, it is kept in a list of ready
+    timers ordered by their exact due times; twlNext() returns the time
+    until the first of them is due and twlRun() fires them when they are.
+    A ready timer registered by a handler during twlRun() is fired by the
+    next call to twlRun(), not the current one, so a timer that keeps
+    re-registering itself with no delay can't monopolize twlRun().
+
+    The wheel does not have its own notion of waiting; the application is
+    responsible for calling twlRun() at or after the time returned by
+    twlNext().  See the SOX_UTIL package, which drives a timing wheel from
+    an I/O event dispatcher.
+
+        #include  "twl_util.h"			-- Timing wheels.
+        TwlWheel  wheel ;
+        ...
+        twlCreate (0.010, &wheel) ;
+        twlAfter (wheel, myHandler, myData, 2.5) ;
+        ...
+        for ( ; ; ) {
+            ... wait twlNext (wheel) seconds ...
+            twlRun (wheel) ;
+        }
+
+
+Public Procedures:
+
+    twlAfter() - registers a single-shot timer.
+    twlCancel() - cancels a timer.
+    twlCount() - returns the number of timers registered with a wheel.
+    twlCreate() - creates a timing wheel.
+    twlDestroy() - destroys a timing wheel.
+    twlEvery() - registers a periodic timer.
+    twlNext() - returns the time until the wheel next needs servicing.
+    twlRemaining() - returns the time remaining until a timer fires.
+    twlReschedule() - reschedules a timer.
+    twlRun() - fires the timers that have expired.
+
+Private Procedures:
+
+    twlCascade() - redistributes the timers in a higher-level slot.
+    twlExpire() - adds a timer to the expired list.
+    twlInsert() - inserts a timer in the wheel.
+    twlNow() - returns the current time in ticks.
+    twlReady() - inserts a timer in the ready list.
+    twlRelease() - releases a timer.
+    twlSchedule() - allocates and inserts a new timer.
+    twlUnlink() - removes a timer from its list.
+
+*******************************************************************************/
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+
+#include  <stdio.h>			/* Standard I/O definitions. */
+#include  <stdlib.h>			/* Standard C Library definitions. */
+#include  <string.h>			/* C Library string functions. */
+#include  "tv_util.h"			/* "timeval" manipulation functions. */
+#include  "twl_util.h"			/* Timing wheels. */
+
+
+int  twl_util_debug = 0 ;		/* Global debug switch (1/0 = yes/no). */
+#undef  I_DEFAULT_GUARD
+#define  I_DEFAULT_GUARD  twl_util_debug
+
+
+/*******************************************************************************
+    Timing Wheel (Internal View) and Definitions.
+*******************************************************************************/
+
+#define  TWL_LEVELS  4			/* Number of levels in the hierarchy. */
+#define  TWL_BITS  8			/* log2 (slots per level). */
+#define  TWL_SLOTS  (1 << TWL_BITS)
+#define  TWL_MASK  (TWL_SLOTS - 1)
+					/* Furthest schedulable expiration. */
+#define  TWL_MAX_DELTA  ((TwlTick) TWL_MASK << (TWL_BITS * (TWL_LEVELS - 1)))
+
+					/* Rounding allowance, in ticks. */
+#define  TWL_EPSILON  1.0e-6
+
+typedef  unsigned  long  TwlTick ;
+
+typedef  enum  TwlState {
+    TwlPending,				/* Waiting in a slot. */
+    TwlExpired,				/* Expired; waiting to be fired. */
+    TwlFiring,				/* Handler is being invoked. */
+    TwlCanceled				/* Canceled while firing. */
+
+/* A timer whose handler is running is the wheel's FIRING timer, whatever
+   its state; only twlRun() releases it.  Its state is TwlFiring unless the
+   handler has rescheduled it (TwlPending) or canceled it (TwlCanceled). */
+
+}  TwlState ;
+
+typedef  struct  _TwlTimer {
+    struct  _TwlTimer  *next ;		/* Links in slot or expired list. */
+    struct  _TwlTimer  *prev ;
+    struct  _TwlTimer  **list ;		/* Head of list containing timer. */
+    TwlWheel  wheel ;			/* Wheel with which registered. */
+    int  level ;			/* Wheel level of slot; -1 if expired. */
+    TwlState  state ;
+    TwlTick  expiration ;		/* Tick at which timer fires. */
+    struct  timeval  due ;		/* Exact due time, if in ready list. */
+    TwlTick  interval ;			/* Periodic interval; 0 if single-shot. */
+    TwlHandler  handler ;		/* Function to call when timer fires. */
+    void  *userData ;			/* Arbitrary data passed to handler. */
+}  _TwlTimer ;
+
+typedef  struct  _TwlWheel {
+    double  resolution ;		/* Length of a tick in seconds. */
+    struct  timeval  epoch ;		/* Time of tick zero. */
+    TwlTick  current ;			/* Next tick to be processed. */
+    size_t  count ;			/* Number of registered timers. */
+    size_t  levelCount[TWL_LEVELS] ;	/* Number of timers in each level. */
+    TwlTimer  slot[TWL_LEVELS][TWL_SLOTS] ;
+    TwlTimer  expired ;			/* Expired timers to be fired ... */
+    TwlTimer  lastExpired ;		/* ... in order of expiration. */
+    TwlTimer  ready ;			/* Timers due within a tick ... */
+    TwlTimer  lastReady ;		/* ... in order of due time. */
+    TwlTimer  firing ;			/* Timer whose handler is running. */
+    bool  destroyed ;			/* Destroyed while firing a timer? */
+}  _TwlWheel ;
+
+
+/*******************************************************************************
+    Private functions.
+*******************************************************************************/
+
+static  void  twlCascade P_((TwlWheel wheel,
+                             int level,
+                             int index)) ;
+
+static  void  twlExpire P_((TwlTimer timer)) ;
+
+static  void  twlInsert P_((TwlTimer timer)) ;
+
+static  TwlTick  twlNow P_((TwlWheel wheel)) ;
+
+static  void  twlReady P_((TwlTimer timer,
+                           double delay)) ;
+
+static  void  twlRelease P_((TwlTimer timer)) ;
+
+static  TwlTimer  twlSchedule P_((TwlWheel wheel,
+                                  TwlHandler handler,
+                                  void *userData,
+                                  double delay,
+                                  double interval)) ;
+
+static  void  twlUnlink P_((TwlTimer timer)) ;
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlAfter ()
+
+    Register a Single-Shot Timer.
+
+
+Purpose:
+
+    Function twlAfter() registers a timer that fires once, after the
+    specified delay.  When the timer fires, the handler function is called
+    with reason IoxFire; afterwards, it is called with reason IoxCancel and
+    the timer is released.
+
+
+    Invocation:
+
+        timer = twlAfter (wheel, handler, userData, delay) ;
+
+    where
+
+        <wheel>		- I
+            is the timing wheel created by twlCreate().
+        <handler>	- I
+            is the function to be called when the timer fires.
+        <userData>	- I
+            is an arbitrary (VOID *) value passed to the handler.
+        <delay>		- I
+            is the delay in seconds (fractional seconds allowed).
+        <timer>		- O
+            returns a handle for the timer; NULL is returned in the event
+            of an error.
+
+*******************************************************************************/
+
+
+TwlTimer  twlAfter (
+
+#    if PROTOTYPES
+        TwlWheel  wheel,
+        TwlHandler  handler,
+        void  *userData,
+        double  delay)
+#    else
+        wheel, handler, userData, delay)
+
+        TwlWheel  wheel ;
+        TwlHandler  handler ;
+        void  *userData ;
+        double  delay ;
+#    endif
+
+{
+
+    return (twlSchedule (wheel, handler, userData, delay, 0.0)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlCancel ()
+
+    Cancel a Timer.
+
+
+Purpose:
+
+    Function twlCancel() cancels a timer.  The timer's handler is called
+    with reason IoxCancel and the timer is released.  If the timer is
+    canceled from within its own handler, the release is deferred until
+    the handler returns, even if the handler rescheduled the timer first.
+
+
+    Invocation:
+
+        status = twlCancel (timer) ;
+
+    where
+
+        <timer>		- I
+            is the timer handle returned by twlAfter() or twlEvery().
+        <status>	- O
+            returns the status of canceling the timer, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  twlCancel (
+
+#    if PROTOTYPES
+        TwlTimer  timer)
+#    else
+        timer)
+
+        TwlTimer  timer ;
+#    endif
+
+{
+
+    if (timer == NULL) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(twlCancel) NULL timer handle: ") ;
+        return (errno) ;
+    }
+
+    LGI "(twlCancel) Timer %p, state %d.\n", (void *) timer, (int) timer->state) ;
+
+/* A timer canceled from within its own handler is left for twlRun() to
+   release; if the handler rescheduled the timer, take it back out of the
+   wheel. */
+
+    if (timer == timer->wheel->firing) {
+        if (timer->state == TwlPending)  twlUnlink (timer) ;
+        timer->state = TwlCanceled ;		/* Released by twlRun(). */
+        return (0) ;
+    }
+
+    switch (timer->state) {
+    case TwlPending:
+    case TwlExpired:
+        twlUnlink (timer) ;
+        twlRelease (timer) ;
+        break ;
+    case TwlFiring:
+    case TwlCanceled:
+    default:
+        break ;
+    }
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlCount ()
+
+    Get the Number of Timers in a Wheel.
+
+
+Purpose:
+
+    Function twlCount() returns the number of timers registered with a wheel.
+
+
+    Invocation:
+
+        count = twlCount (wheel) ;
+
+    where
+
+        <wheel>		- I
+            is the timing wheel created by twlCreate().
+        <count>		- O
+            returns the number of timers pending in the wheel.
+
+*******************************************************************************/
+
+
+size_t  twlCount (
+
+#    if PROTOTYPES
+        TwlWheel  wheel)
+#    else
+        wheel)
+
+        TwlWheel  wheel ;
+#    endif
+
+{
+
+    return ((wheel == NULL) ? 0 : wheel->count) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlCreate ()
+
+    Create a Timing Wheel.
+
+
+Purpose:
+
+    Function twlCreate() creates an empty timing wheel.
+
+
+    Invocation:
+
+        status = twlCreate (resolution, &wheel) ;
+
+    where
+
+        <resolution>	- I
+            is the length of a tick in seconds.  Timer expirations are
+            rounded up to a tick boundary, so the resolution is also the
+            timer slack within which expirations are coalesced; timers
+            due within a tick are not rounded (see twlReady()).  If the
+            resolution is zero or less, TWL_RESOLUTION is used.
+        <wheel>		- O
+            returns a handle for the new timing wheel.
+        <status>	- O
+            returns the status of creating the wheel, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  twlCreate (
+
+#    if PROTOTYPES
+        double  resolution,
+        TwlWheel  *wheel)
+#    else
+        resolution, wheel)
+
+        double  resolution ;
+        TwlWheel  *wheel ;
+#    endif
+
+{
+
+    *wheel = (_TwlWheel *) calloc (1, sizeof (_TwlWheel)) ;
+    if (*wheel == NULL) {
+        LGE "(twlCreate) Error allocating wheel structure.\ncalloc: ") ;
+        return (errno) ;
+    }
+
+    (*wheel)->resolution = (resolution > 0.0) ? resolution : TWL_RESOLUTION ;
+    (*wheel)->epoch = tvTOD () ;
+    (*wheel)->current = 0 ;
+    (*wheel)->count = 0 ;
+    (*wheel)->expired = (*wheel)->lastExpired = NULL ;
+    (*wheel)->ready = (*wheel)->lastReady = NULL ;
+
+    LGI "(twlCreate) Wheel %p, resolution %g seconds.\n",
+        (void *) *wheel, (*wheel)->resolution) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlDestroy ()
+
+    Destroy a Timing Wheel.
+
+
+Purpose:
+
+    Function twlDestroy() cancels all of a wheel's timers (their handlers
+    are invoked with reason IoxCancel) and then destroys the wheel.  If
+    the wheel is destroyed from within one of its handlers, the wheel is
+    not freed until twlRun() regains control; the caller of twlRun() must
+    not use the wheel after that.
+
+
+    Invocation:
+
+        status = twlDestroy (wheel) ;
+
+    where
+
+        <wheel>		- I
+            is the timing wheel created by twlCreate().
+        <status>	- O
+            returns the status of destroying the wheel, zero if there were
+            no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  twlDestroy (
+
+#    if PROTOTYPES
+        TwlWheel  wheel)
+#    else
+        wheel)
+
+        TwlWheel  wheel ;
+#    endif
+
+{    /* Local variables. */
+    int  index, level ;
+
+
+
+    if (wheel == NULL)  return (0) ;
+
+    LGI "(twlDestroy) Wheel %p, %lu timers.\n",
+        (void *) wheel, (unsigned long) wheel->count) ;
+
+    while (wheel->expired != NULL)
+        twlCancel (wheel->expired) ;
+
+    while (wheel->ready != NULL)
+        twlCancel (wheel->ready) ;
+
+    for (level = 0 ;  level < TWL_LEVELS ;  level++) {
+        for (index = 0 ;  index < TWL_SLOTS ;  index++) {
+            while (wheel->slot[level][index] != NULL)
+                twlCancel (wheel->slot[level][index]) ;
+        }
+    }
+
+/* If a timer's handler is destroying the wheel, twlRun() releases the
+   timer and frees the wheel once the handler returns. */
+
+    if (wheel->firing != NULL) {
+        twlCancel (wheel->firing) ;
+        wheel->destroyed = true ;
+        return (0) ;
+    }
+
+    free (wheel) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlEvery ()
+
+    Register a Periodic Timer.
+
+
+Purpose:
+
+    Function twlEvery() registers a timer that first fires after an initial
+    delay and then every interval seconds after that.  The timer remains
+    registered until it is explicitly canceled.  If the wheel falls behind
+    by more than an interval, the missed firings are skipped rather than
+    delivered in a burst.
+
+
+    Invocation:
+
+        timer = twlEvery (wheel, handler, userData, delay, interval) ;
+
+    where
+
+        <wheel>		- I
+            is the timing wheel created by twlCreate().
+        <handler>	- I
+            is the function to be called when the timer fires.
+        <userData>	- I
+            is an arbitrary (VOID *) value passed to the handler.
+        <delay>		- I
+            is the initial delay in seconds.
+        <interval>	- I
+            is the periodic interval in seconds.
+        <timer>		- O
+            returns a handle for the timer; NULL is returned in the event
+            of an error.
+
+*******************************************************************************/
+
+
+TwlTimer  twlEvery (
+
+#    if PROTOTYPES
+        TwlWheel  wheel,
+        TwlHandler  handler,
+        void  *userData,
+        double  delay,
+        double  interval)
+#    else
+        wheel, handler, userData, delay, interval)
+
+        TwlWheel  wheel ;
+        TwlHandler  handler ;
+        void  *userData ;
+        double  delay ;
+        double  interval ;
+#    endif
+
+{
+
+    if (interval <= 0.0) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(twlEvery) Invalid interval: %g seconds\n", interval) ;
+        return (NULL) ;
+    }
+
+    return (twlSchedule (wheel, handler, userData, delay, interval)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlNext ()
+
+    Get the Time Until a Wheel Next Needs Servicing.
+
+
+Purpose:
+
+    Function twlNext() returns the number of seconds until the application
+    should next call twlRun().  The value is a lower bound: it is the due
+    time of the first ready timer, the expiration time of the earliest
+    level-0 timer or, if level 0 is empty, the time of the next cascade
+    that will bring a timer closer, whichever comes first.  Calling twlRun()
+    early is harmless.
+
+
+    Invocation:
+
+        seconds = twlNext (wheel) ;
+
+    where
+
+        <wheel>		- I
+            is the timing wheel created by twlCreate().
+        <seconds>	- O
+            returns the number of seconds until the next servicing of the
+            wheel is due; zero is returned if timers have already expired
+            and -1.0 is returned if no timers are registered.
+
+*******************************************************************************/
+
+
+double  twlNext (
+
+#    if PROTOTYPES
+        TwlWheel  wheel)
+#    else
+        wheel)
+
+        TwlWheel  wheel ;
+#    endif
+
+{    /* Local variables. */
+    double  elapsed, ready ;
+    int  first, index, level, offset, shift ;
+    struct  timeval  now ;
+    TwlTick  block, next ;
+
+
+
+    if (wheel == NULL)  return (-1.0) ;
+    if (wheel->expired != NULL)  return (0.0) ;
+
+/* The ready timers aren't in the wheel; the first of them is due soonest. */
+
+    ready = -1.0 ;
+    if (wheel->ready != NULL) {
+        now = tvTOD () ;
+        if (tvCompare (wheel->ready->due, now) <= 0)  return (0.0) ;
+        ready = tvFloat (tvSubtract (wheel->ready->due, now)) ;
+    }
+
+    if (wheel->count == 0)  return (ready) ;
+
+    next = wheel->current + TWL_MAX_DELTA ;
+
+/* Level 0 holds the timers due within the next TWL_SLOTS ticks. */
+
+    if (wheel->levelCount[0] > 0) {
+        for (offset = 0 ;  offset < TWL_SLOTS ;  offset++) {
+            index = (int) ((wheel->current + offset) & TWL_MASK) ;
+            if (wheel->slot[0][index] != NULL) {
+                next = wheel->current + offset ;
+                break ;
+            }
+        }
+    }
+
+/* For the higher levels, the wheel must be serviced when the first
+   non-empty slot is cascaded.  If the wheel is sitting exactly on a block
+   boundary that hasn't been processed yet, the current block's slot is
+   still to be cascaded. */
+
+    for (level = 1 ;  level < TWL_LEVELS ;  level++) {
+        if (wheel->levelCount[level] == 0)  continue ;
+        shift = TWL_BITS * level ;
+        block = wheel->current >> shift ;
+        first = ((wheel->current & (((TwlTick) 1 << shift) - 1)) == 0) ? 0 : 1 ;
+        for (offset = first ;  offset < (first + TWL_SLOTS) ;  offset++) {
+            index = (int) ((block + offset) & TWL_MASK) ;
+            if (wheel->slot[level][index] != NULL) {
+                if (((block + offset) << shift) < next)
+                    next = (block + offset) << shift ;
+                break ;
+            }
+        }
+    }
+
+/* Convert the tick to a number of seconds from now. */
+
+    elapsed = tvFloat (tvSubtract (tvTOD (), wheel->epoch)) ;
+    elapsed = ((double) next * wheel->resolution) - elapsed ;
+    if ((ready >= 0.0) && (ready < elapsed))  elapsed = ready ;
+
+    return ((elapsed < 0.0) ? 0.0 : elapsed) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlRemaining ()
+
+    Get the Time Remaining Until a Timer Fires.
+
+
+Purpose:
+
+    Function twlRemaining() returns the number of seconds remaining until
+    a timer fires.
+
+
+    Invocation:
+
+        seconds = twlRemaining (timer) ;
+
+    where
+
+        <timer>		- I
+            is the timer handle returned by twlAfter() or twlEvery().
+        <seconds>	- O
+            returns the number of seconds until the timer is due; zero is
+            returned if the timer is already due.
+
+*******************************************************************************/
+
+
+double  twlRemaining (
+
+#    if PROTOTYPES
+        TwlTimer  timer)
+#    else
+        timer)
+
+        TwlTimer  timer ;
+#    endif
+
+{    /* Local variables. */
+    double  remaining ;
+    struct  timeval  now ;
+
+
+
+    if ((timer == NULL) || (timer->state != TwlPending))  return (0.0) ;
+
+    if (timer->list == &timer->wheel->ready) {
+        now = tvTOD () ;
+        if (tvCompare (timer->due, now) <= 0)  return (0.0) ;
+        return (tvFloat (tvSubtract (timer->due, now))) ;
+    }
+
+    remaining = ((double) timer->expiration * timer->wheel->resolution)
+                - tvFloat (tvSubtract (tvTOD (), timer->wheel->epoch)) ;
+
+    return ((remaining < 0.0) ? 0.0 : remaining) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlReschedule ()
+
+    Reschedule a Timer.
+
+
+Purpose:
+
+    Function twlReschedule() changes a timer's expiration time to the
+    specified number of seconds from now.  A periodic timer resumes its
+    regular interval after the rescheduled firing.  A timer may reschedule
+    itself from within its handler; a single-shot timer that does so is
+    not released.
+
+
+    Invocation:
+
+        status = twlReschedule (timer, delay) ;
+
+    where
+
+        <timer>		- I
+            is the timer handle returned by twlAfter() or twlEvery().
+        <delay>		- I
+            is the new delay in seconds.
+        <status>	- O
+            returns the status of rescheduling the timer, zero if there
+            were no errors and ERRNO otherwise.
+
+*******************************************************************************/
+
+
+errno_t  twlReschedule (
+
+#    if PROTOTYPES
+        TwlTimer  timer,
+        double  delay)
+#    else
+        timer, delay)
+
+        TwlTimer  timer ;
+        double  delay ;
+#    endif
+
+{    /* Local variables. */
+    double  ticks ;
+
+
+
+    if ((timer == NULL) || (timer->state == TwlCanceled)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(twlReschedule) Invalid or canceled timer: ") ;
+        return (errno) ;
+    }
+
+    if (timer->state != TwlFiring)  twlUnlink (timer) ;
+
+    ticks = (tvFloat (tvSubtract (tvTOD (), timer->wheel->epoch)) + delay)
+            / timer->wheel->resolution ;
+    timer->expiration = (ticks < 0.0) ? 0 : (TwlTick) (ticks + 0.999999) ;
+    timer->state = TwlPending ;
+
+    if (delay < timer->wheel->resolution)
+        twlReady (timer, delay) ;
+    else
+        twlInsert (timer) ;
+
+    return (0) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlRun ()
+
+    Fire the Expired Timers.
+
+
+Purpose:
+
+    Function twlRun() advances the wheel to the current time, cascading
+    higher-level slots as necessary, and fires all the timers that have
+    expired.  Timers that expired in the same tick are fired together,
+    in the same call.  Handlers may freely add, cancel, and reschedule
+    timers, including themselves.
+
+
+    Invocation:
+
+        numFired = twlRun (wheel) ;
+
+    where
+
+        <wheel>		- I
+            is the timing wheel created by twlCreate().
+        <numFired>	- O
+            returns the number of timers fired.
+
+*******************************************************************************/
+
+
+size_t  twlRun (
+
+#    if PROTOTYPES
+        TwlWheel  wheel)
+#    else
+        wheel)
+
+        TwlWheel  wheel ;
+#    endif
+
+{    /* Local variables. */
+    int  index, level ;
+    size_t  numFired ;
+    TwlTick  next, now ;
+    TwlTimer  timer ;
+    struct  timeval  tod ;
+
+
+
+    if (wheel == NULL)  return (0) ;
+
+    tod = tvTOD () ;
+    now = twlNow (wheel) ;
+
+/* Advance the wheel tick by tick up to the current time, moving the timers
+   in each level-0 slot to the expired list.  While level 0 is empty, skip
+   straight to the next cascade point; if the wheel is empty, skip straight
+   to the current time. */
+
+    if ((wheel->count == 0) && (wheel->current <= now))
+        wheel->current = now + 1 ;
+
+    while (wheel->current <= now) {
+
+        index = (int) (wheel->current & TWL_MASK) ;
+
+        if (index == 0) {
+            for (level = 1 ;  level < TWL_LEVELS ;  level++) {
+                index = (int) ((wheel->current >> (TWL_BITS * level))
+                               & TWL_MASK) ;
+                twlCascade (wheel, level, index) ;
+                if (index != 0)  break ;
+            }
+            index = 0 ;
+        }
+
+        if (wheel->levelCount[0] == 0) {
+            next = (wheel->current | TWL_MASK) + 1 ;
+            wheel->current = (next > now) ? now + 1 : next ;
+            continue ;
+        }
+
+        while ((timer = wheel->slot[0][index]) != NULL) {
+            twlUnlink (timer) ;
+            twlExpire (timer) ;
+        }
+
+        wheel->current++ ;
+
+    }
+
+/* Add the ready timers that are due to the expired list.  Timers made ready
+   by the handlers called below are left for the next call. */
+
+    while (((timer = wheel->ready) != NULL) &&
+           (tvCompare (timer->due, tod) <= 0)) {
+        twlUnlink (timer) ;
+        twlExpire (timer) ;
+    }
+
+/* Fire the expired timers.  Each timer is removed from the expired list
+   before its handler is called, so the handler can cancel any other timer,
+   expired or not. */
+
+    numFired = 0 ;
+
+    while ((timer = wheel->expired) != NULL) {
+
+        twlUnlink (timer) ;
+        timer->state = TwlFiring ;
+        wheel->firing = timer ;
+        numFired++ ;
+
+        timer->handler (timer, IoxFire, timer->userData) ;
+
+        wheel->firing = NULL ;
+
+        switch (timer->state) {
+        case TwlFiring:
+            if (timer->interval > 0) {
+                timer->expiration += timer->interval ;
+                if (timer->expiration <= now)
+                    timer->expiration = now + timer->interval ;
+                timer->state = TwlPending ;
+                twlInsert (timer) ;
+            } else {
+                twlRelease (timer) ;
+            }
+            break ;
+        case TwlCanceled:
+            twlRelease (timer) ;
+            break ;
+        default:				/* Rescheduled by handler. */
+            break ;
+        }
+
+        if (wheel->destroyed) {			/* Destroyed by handler. */
+            LGI "(twlRun) Wheel %p destroyed while firing timers.\n",
+                (void *) wheel) ;
+            free (wheel) ;
+            return (numFired) ;
+        }
+
+    }
+
+    LGI "(twlRun) Wheel %p, tick %lu, fired %lu timers.\n",
+        (void *) wheel, (unsigned long) now, (unsigned long) numFired) ;
+
+    return (numFired) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlCascade ()
+
+    Redistribute the Timers in a Higher-Level Slot.
+
+
+Purpose:
+
+    Function twlCascade() removes the timers from a slot in one of the
+    higher levels and reinserts them in the wheel; since the wheel has
+    advanced, they will be inserted in lower levels.
+
+
+    Invocation:
+
+        twlCascade (wheel, level, index) ;
+
+    where
+
+        <wheel>		- I
+            is the timing wheel.
+        <level>		- I
+            is the level (1..TWL_LEVELS-1) of the slot.
+        <index>		- I
+            is the index of the slot.
+
+*******************************************************************************/
+
+
+static  void  twlCascade (
+
+#    if PROTOTYPES
+        TwlWheel  wheel,
+        int  level,
+        int  index)
+#    else
+        wheel, level, index)
+
+        TwlWheel  wheel ;
+        int  level ;
+        int  index ;
+#    endif
+
+{    /* Local variables. */
+    TwlTimer  list, timer ;
+
+
+
+    list = wheel->slot[level][index] ;
+    wheel->slot[level][index] = NULL ;
+
+    while ((timer = list) != NULL) {
+        list = timer->next ;
+        wheel->levelCount[level]-- ;
+        wheel->count-- ;
+        twlInsert (timer) ;
+    }
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlExpire ()
+
+    Add a Timer to the Expired List.
+
+
+Purpose:
+
+    Function twlExpire() appends a timer to its wheel's list of expired
+    timers, which twlRun() fires in order.  The timer must already have been
+    removed from its slot or from the ready list.
+
+
+    Invocation:
+
+        twlExpire (timer) ;
+
+    where
+
+        <timer>		- I
+            is the timer that has expired.
+
+*******************************************************************************/
+
+
+static  void  twlExpire (
+
+#    if PROTOTYPES
+        TwlTimer  timer)
+#    else
+        timer)
+
+        TwlTimer  timer ;
+#    endif
+
+{    /* Local variables. */
+    TwlWheel  wheel = timer->wheel ;
+
+
+
+    timer->level = -1 ;
+    timer->state = TwlExpired ;
+    timer->list = &wheel->expired ;
+    timer->next = NULL ;
+    timer->prev = wheel->lastExpired ;
+    if (wheel->lastExpired == NULL)
+        wheel->expired = timer ;
+    else
+        wheel->lastExpired->next = timer ;
+    wheel->lastExpired = timer ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlInsert ()
+
+    Insert a Timer in a Wheel.
+
+
+Purpose:
+
+    Function twlInsert() inserts a timer in the slot covering the timer's
+    expiration tick.  Expirations in the past are treated as due on the
+    next tick to be processed; expirations beyond the range of the wheel
+    are clamped to the end of the range.
+
+
+    Invocation:
+
+        twlInsert (timer) ;
+
+    where
+
+        <timer>		- I
+            is the timer to be inserted.
+
+*******************************************************************************/
+
+
+static  void  twlInsert (
+
+#    if PROTOTYPES
+        TwlTimer  timer)
+#    else
+        timer)
+
+        TwlTimer  timer ;
+#    endif
+
+{    /* Local variables. */
+    int  index, level ;
+    TwlTick  delta ;
+    TwlWheel  wheel = timer->wheel ;
+
+
+
+    if (timer->expiration < wheel->current)
+        timer->expiration = wheel->current ;
+    delta = timer->expiration - wheel->current ;
+    if (delta > TWL_MAX_DELTA) {
+        delta = TWL_MAX_DELTA ;
+        timer->expiration = wheel->current + delta ;
+    }
+
+    for (level = 0 ;  level < (TWL_LEVELS - 1) ;  level++) {
+        if (delta < ((TwlTick) 1 << (TWL_BITS * (level + 1))))  break ;
+    }
+    index = (int) ((timer->expiration >> (TWL_BITS * level)) & TWL_MASK) ;
+
+    timer->level = level ;
+    timer->list = &wheel->slot[level][index] ;
+    timer->prev = NULL ;
+    timer->next = *timer->list ;
+    if (timer->next != NULL)  timer->next->prev = timer ;
+    *timer->list = timer ;
+
+    wheel->levelCount[level]++ ;
+    wheel->count++ ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlNow ()
+
+    Get the Current Time in Ticks.
+
+
+Purpose:
+
+    Function twlNow() returns the number of whole ticks elapsed since the
+    wheel was created.
+
+
+    Invocation:
+
+        tick = twlNow (wheel) ;
+
+    where
+
+        <wheel>		- I
+            is the timing wheel.
+        <tick>		- O
+            returns the current tick.
+
+*******************************************************************************/
+
+
+static  TwlTick  twlNow (
+
+#    if PROTOTYPES
+        TwlWheel  wheel)
+#    else
+        wheel)
+
+        TwlWheel  wheel ;
+#    endif
+
+{    /* Local variables. */
+    double  elapsed ;
+
+
+
+    elapsed = tvFloat (tvSubtract (tvTOD (), wheel->epoch)) ;
+    if (elapsed <= 0.0)  return (0) ;
+
+/* Allow for rounding error so that a wakeup scheduled by twlNext() for
+   exactly the start of a tick actually lands in that tick. */
+
+    return ((TwlTick) ((elapsed / wheel->resolution) + TWL_EPSILON)) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlReady ()
+
+    Insert a Timer in the Ready List.
+
+
+Purpose:
+
+    Function twlReady() inserts a timer due within a tick in its wheel's
+    list of ready timers, which is kept in order of the timers' exact due
+    times.  Timers usually become ready in order, so the list is searched
+    from the end.
+
+
+    Invocation:
+
+        twlReady (timer, delay) ;
+
+    where
+
+        <timer>		- I
+            is the timer to be inserted.
+        <delay>		- I
+            is the delay in seconds, less than the wheel's resolution; zero
+            or less if the timer is due immediately.
+
+*******************************************************************************/
+
+
+static  void  twlReady (
+
+#    if PROTOTYPES
+        TwlTimer  timer,
+        double  delay)
+#    else
+        timer, delay)
+
+        TwlTimer  timer ;
+        double  delay ;
+#    endif
+
+{    /* Local variables. */
+    TwlTimer  after ;
+    TwlWheel  wheel = timer->wheel ;
+
+
+
+    timer->due = tvTOD () ;
+    if (delay > 0.0)  timer->due = tvAdd (timer->due, tvCreateF (delay)) ;
+
+    for (after = wheel->lastReady ;  after != NULL ;  after = after->prev) {
+        if (tvCompare (after->due, timer->due) <= 0)  break ;
+    }
+
+    timer->level = -1 ;
+    timer->list = &wheel->ready ;
+    timer->prev = after ;
+    timer->next = (after == NULL) ? wheel->ready : after->next ;
+    if (timer->next == NULL)
+        wheel->lastReady = timer ;
+    else
+        timer->next->prev = timer ;
+    if (after == NULL)
+        wheel->ready = timer ;
+    else
+        after->next = timer ;
+
+    wheel->count++ ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlRelease ()
+
+    Release a Timer.
+
+
+Purpose:
+
+    Function twlRelease() notifies a timer's handler (with reason IoxCancel)
+    that the timer is going away and then frees the timer.  The timer must
+    already have been removed from its list.
+
+
+    Invocation:
+
+        twlRelease (timer) ;
+
+    where
+
+        <timer>		- I
+            is the timer to be released.
+
+*******************************************************************************/
+
+
+static  void  twlRelease (
+
+#    if PROTOTYPES
+        TwlTimer  timer)
+#    else
+        timer)
+
+        TwlTimer  timer ;
+#    endif
+
+{
+
+    timer->state = TwlCanceled ;
+    timer->handler (timer, IoxCancel, timer->userData) ;
+
+    LGI "(twlRelease) Timer %p released.\n", (void *) timer) ;
+
+    free (timer) ;
+
+    return ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlSchedule ()
+
+    Allocate and Insert a New Timer.
+
+
+Purpose:
+
+    Function twlSchedule() allocates a timer and inserts it in a wheel.
+
+
+    Invocation:
+
+        timer = twlSchedule (wheel, handler, userData, delay, interval) ;
+
+    where
+
+        <wheel>		- I
+            is the timing wheel.
+        <handler>	- I
+            is the function to be called when the timer fires.
+        <userData>	- I
+            is an arbitrary (VOID *) value passed to the handler.
+        <delay>		- I
+            is the initial delay in seconds.
+        <interval>	- I
+            is the periodic interval in seconds; zero for a single-shot timer.
+        <timer>		- O
+            returns a handle for the timer; NULL is returned in the event
+            of an error.
+
+*******************************************************************************/
+
+
+static  TwlTimer  twlSchedule (
+
+#    if PROTOTYPES
+        TwlWheel  wheel,
+        TwlHandler  handler,
+        void  *userData,
+        double  delay,
+        double  interval)
+#    else
+        wheel, handler, userData, delay, interval)
+
+        TwlWheel  wheel ;
+        TwlHandler  handler ;
+        void  *userData ;
+        double  delay ;
+        double  interval ;
+#    endif
+
+{    /* Local variables. */
+    double  ticks ;
+    TwlTimer  timer ;
+
+
+
+    if ((wheel == NULL) || (handler == NULL)) {
+        SET_ERRNO (EINVAL) ;
+        LGE "(twlSchedule) NULL wheel or handler: ") ;
+        return (NULL) ;
+    }
+
+    timer = (_TwlTimer *) malloc (sizeof (_TwlTimer)) ;
+    if (timer == NULL) {
+        LGE "(twlSchedule) Error allocating timer structure.\nmalloc: ") ;
+        return (NULL) ;
+    }
+
+    timer->wheel = wheel ;
+    timer->state = TwlPending ;
+    timer->handler = handler ;
+    timer->userData = userData ;
+
+/* Round the expiration up to the next tick boundary and the interval to
+   a whole number of ticks (at least one). */
+
+    ticks = (tvFloat (tvSubtract (tvTOD (), wheel->epoch)) + delay)
+            / wheel->resolution ;
+    timer->expiration = (ticks < 0.0) ? 0 : (TwlTick) (ticks + 0.999999) ;
+
+    if (interval > 0.0) {
+        ticks = interval / wheel->resolution ;
+        timer->interval = (ticks < 1.0) ? 1 : (TwlTick) (ticks + 0.5) ;
+    } else {
+        timer->interval = 0 ;
+    }
+
+    if (delay < wheel->resolution)
+        twlReady (timer, delay) ;
+    else
+        twlInsert (timer) ;
+
+    LGI "(twlSchedule) Timer %p, expiration tick %lu, interval %lu ticks.\n",
+        (void *) timer, (unsigned long) timer->expiration,
+        (unsigned long) timer->interval) ;
+
+    return (timer) ;
+
+}
+
+/*!*****************************************************************************
+
+Procedure:
+
+    twlUnlink ()
+
+    Remove a Timer from its List.
+
+
+Purpose:
+
+    Function twlUnlink() removes a timer from the slot, expired list, or
+    ready list containing it.
+
+
+    Invocation:
+
+        twlUnlink (timer) ;
+
+    where
+
+        <timer>		- I
+            is the timer to be removed.
+
+*******************************************************************************/
+
+
+static  void  twlUnlink (
+
+#    if PROTOTYPES
+        TwlTimer  timer)
+#    else
+        timer)
+
+        TwlTimer  timer ;
+#    endif
+
+{    /* Local variables. */
+    TwlWheel  wheel = timer->wheel ;
+
+
+
+    if (timer->prev == NULL)
+        *timer->list = timer->next ;
+    else
+        timer->prev->next = timer->next ;
+
+    if (timer->next != NULL)
+        timer->next->prev = timer->prev ;
+    else if (timer->list == &wheel->expired)
+        wheel->lastExpired = timer->prev ;
+    else if (timer->list == &wheel->ready)
+        wheel->lastReady = timer->prev ;
+
+    if (timer->level >= 0) {
+        wheel->levelCount[timer->level]-- ;
+        wheel->count-- ;
+    } else if (timer->list == &wheel->ready) {
+        wheel->count-- ;
+    }
+
+    timer->next = timer->prev = NULL ;
+
+    return ;
+
+}
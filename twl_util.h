@@ -0,0 +1,101 @@
+/* $Id$ */
+/*******************************************************************************
+
+    twl_util.h
+
+    Hierarchical Timing Wheel Definitions.
+
+*******************************************************************************/
+
+#ifndef  TWL_UTIL_H		/* Has the file been INCLUDE'd already? */
+#define  TWL_UTIL_H  yes
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+extern  "C"  {
+#endif
+
+
+#include  "pragmatics.h"		/* Compiler, OS, logging definitions. */
+#include  "iox_util.h"			/* I/O event dispatcher definitions. */
+
+
+/*******************************************************************************
+    Timing Wheel (Client View) and Definitions.
+*******************************************************************************/
+
+					/* Wheel and timer handles. */
+typedef  struct  _TwlWheel  *TwlWheel ;
+typedef  struct  _TwlTimer  *TwlTimer ;
+
+/* Timer handler function.  As with IOX callbacks, the handler is invoked
+   with reason IoxFire when the timer fires and with reason IoxCancel when
+   the timer is released (after a single-shot timer fires or when a timer
+   is canceled). */
+
+typedef  errno_t  (*TwlHandler) P_((TwlTimer timer,
+                                    IoxReason reason,
+                                    void *userData)) ;
+
+				/* Default wheel resolution (timer slack). */
+#ifndef TWL_RESOLUTION
+#    define  TWL_RESOLUTION  0.010
+#endif
+
+
+/*******************************************************************************
+    Miscellaneous declarations.
+*******************************************************************************/
+
+					/* Global debug switch (1/0 = yes/no). */
+extern  int  twl_util_debug  OCD ("twl_util") ;
+
+
+/*******************************************************************************
+    Public functions.
+*******************************************************************************/
+
+extern  TwlTimer  twlAfter P_((TwlWheel wheel,
+                               TwlHandler handler,
+                               void *userData,
+                               double delay))
+    OCD ("twl_util") ;
+
+extern  errno_t  twlCancel P_((TwlTimer timer))
+    OCD ("twl_util") ;
+
+extern  size_t  twlCount P_((TwlWheel wheel))
+    OCD ("twl_util") ;
+
+extern  errno_t  twlCreate P_((double resolution,
+                               TwlWheel *wheel))
+    OCD ("twl_util") ;
+
+extern  errno_t  twlDestroy P_((TwlWheel wheel))
+    OCD ("twl_util") ;
+
+extern  TwlTimer  twlEvery P_((TwlWheel wheel,
+                               TwlHandler handler,
+                               void *userData,
+                               double delay,
+                               double interval))
+    OCD ("twl_util") ;
+
+extern  double  twlNext P_((TwlWheel wheel))
+    OCD ("twl_util") ;
+
+extern  double  twlRemaining P_((TwlTimer timer))
+    OCD ("twl_util") ;
+
+extern  errno_t  twlReschedule P_((TwlTimer timer,
+                                   double delay))
+    OCD ("twl_util") ;
+
+extern  size_t  twlRun P_((TwlWheel wheel))
+    OCD ("twl_util") ;
+
+
+#ifdef __cplusplus		/* If this is a C++ compiler, use C linkage */
+}
+#endif
+
+#endif				/* If this file was not INCLUDE'd previously. */